@@ -21,11 +21,16 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+#include <algorithm>
 #include <cctype>
 
 #include <graphene/app/api.hpp>
 #include <graphene/app/api_access.hpp>
+#include <graphene/app/api_rate_limiter.hpp>
 #include <graphene/app/application.hpp>
+#include <graphene/account_history/account_history_plugin.hpp>
+#include <graphene/api_helper_indexes/api_helper_indexes.hpp>
+#include <graphene/history_store/history_store_plugin.hpp>
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/get_config.hpp>
 #include <graphene/utilities/key_conversion.hpp>
@@ -40,6 +45,7 @@
 #include <fc/crypto/hex.hpp>
 #include <fc/rpc/api_connection.hpp>
 #include <fc/thread/future.hpp>
+#include <fc/thread/thread.hpp>
 
 template class fc::api<graphene::app::block_api>;
 template class fc::api<graphene::app::network_broadcast_api>;
@@ -49,11 +55,31 @@ template class fc::api<graphene::app::crypto_api>;
 template class fc::api<graphene::app::asset_api>;
 template class fc::api<graphene::app::orders_api>;
 template class fc::api<graphene::debug_witness::debug_api>;
+template class fc::api<graphene::app::profiling_api>;
 template class fc::api<graphene::app::login_api>;
 
 
 namespace graphene { namespace app {
 
+    namespace {
+       /// @return the archive of the account history plugin, null if the plugin or the archive is not enabled
+       const account_history::account_history_archive* find_account_history_archive( const application& app )
+       {
+          if( !app.is_plugin_enabled( "account_history" ) )
+             return nullptr;
+          return app.get_plugin<account_history::account_history_plugin>( "account_history" )->archive();
+       }
+
+       /// Wraps the methods of api if the API calls are profiled
+       template<typename Api>
+       void profile_api( const application& app, const optional< fc::api<Api> >& api, const string& api_name )
+       {
+          const std::shared_ptr<api_profiler> profiler = app.get_api_profiler();
+          if( profiler && api.valid() )
+             profiler->profile( *api, api_name );
+       }
+    }
+
     login_api::login_api(application& a)
     :_app(a)
     {
@@ -89,47 +115,67 @@ namespace graphene { namespace app {
     {
        if( api_name == "database_api" )
        {
-          _database_api = std::make_shared< database_api >( std::ref( *_app.chain_database() ), &( _app.get_options() ) );
+          _database_api = std::make_shared< database_api >( std::ref( *_app.chain_database() ), &( _app.get_options() ),
+                                                            _app.get_full_account_cache(),
+                                                            _app.get_subscription_registry() );
+          profile_api( _app, _database_api, "database_api" );
        }
        else if( api_name == "block_api" )
        {
-          _block_api = std::make_shared< block_api >( std::ref( *_app.chain_database() ) );
+          _block_api = std::make_shared< block_api >( std::ref( *_app.chain_database() ), &( _app.get_options() ) );
+          profile_api( _app, _block_api, "block_api" );
        }
        else if( api_name == "network_broadcast_api" )
        {
           _network_broadcast_api = std::make_shared< network_broadcast_api >( std::ref( _app ) );
+          profile_api( _app, _network_broadcast_api, "network_broadcast_api" );
        }
        else if( api_name == "history_api" )
        {
           _history_api = std::make_shared< history_api >( _app );
+          profile_api( _app, _history_api, "history_api" );
        }
        else if( api_name == "network_node_api" )
        {
           _network_node_api = std::make_shared< network_node_api >( std::ref(_app) );
+          profile_api( _app, _network_node_api, "network_node_api" );
        }
        else if( api_name == "crypto_api" )
        {
           _crypto_api = std::make_shared< crypto_api >();
+          profile_api( _app, _crypto_api, "crypto_api" );
        }
        else if( api_name == "asset_api" )
        {
           _asset_api = std::make_shared< asset_api >( _app );
+          profile_api( _app, _asset_api, "asset_api" );
        }
        else if( api_name == "orders_api" )
        {
           _orders_api = std::make_shared< orders_api >( std::ref( _app ) );
+          profile_api( _app, _orders_api, "orders_api" );
        }
        else if( api_name == "debug_api" )
        {
           // can only enable this API if the plugin was loaded
           if( _app.get_plugin( "debug_witness" ) )
+          {
              _debug_api = std::make_shared< graphene::debug_witness::debug_api >( std::ref(_app) );
+             profile_api( _app, _debug_api, "debug_api" );
+          }
+       }
+       else if( api_name == "profiling_api" )
+       {
+          // can only enable this API if the calls or the blocks are profiled
+          if( _app.get_api_profiler() || _app.get_block_tracer() )
+             _profiling_api = std::make_shared< profiling_api >( std::ref(_app) );
        }
        return;
     }
 
     // block_api
-    block_api::block_api(graphene::chain::database& db) : _db(db) { }
+    block_api::block_api(graphene::chain::database& db, const application_options* app_options)
+       : _db(db), _app_options(app_options) { }
     block_api::~block_api() { }
 
     vector<optional<signed_block>> block_api::get_blocks(uint32_t block_num_from, uint32_t block_num_to)const
@@ -142,6 +188,71 @@ namespace graphene { namespace app {
        return res;
     }
 
+    vector<optional<vector<operation_history_object>>> block_api::get_applied_operations( uint32_t block_num_from,
+                                                                                          uint32_t block_num_to )const
+    {
+       FC_ASSERT( block_num_to >= block_num_from );
+       static const application_options default_options;
+       const application_options& options = ( _app_options != nullptr ? *_app_options : default_options );
+       FC_ASSERT( uint64_t( block_num_to ) - block_num_from < options.api_limit_get_applied_operations,
+                  "No more than ${n} blocks can be fetched at once", ("n",options.api_limit_get_applied_operations) );
+       vector<optional<vector<operation_history_object>>> res;
+       for( uint64_t block_num = block_num_from; block_num <= block_num_to; ++block_num )
+          res.push_back( _db.fetch_applied_operations( block_num ) );
+       return res;
+    }
+
+    void block_api::stream_blocks( std::function<void(const variant&)> callback, uint32_t block_num_from,
+                                   uint32_t block_num_to, bool packed )const
+    {
+       FC_ASSERT( block_num_to >= block_num_from );
+       static const application_options default_options;
+       const application_options& options = ( _app_options != nullptr ? *_app_options : default_options );
+       FC_ASSERT( _active_streams < options.api_limit_block_streams,
+                  "No more than ${n} block streams can run at a time", ("n",options.api_limit_block_streams) );
+       FC_ASSERT( options.api_limit_stream_blocks > 0, "stream_blocks is disabled" );
+       block_num_to = std::min<uint64_t>( { block_num_to, _db.head_block_num(),
+                                            uint64_t( block_num_from ) + options.api_limit_stream_blocks - 1 } );
+       if( block_num_to < block_num_from )
+          return;
+       ++_active_streams;
+       /// keep the api alive until all blocks are sent even if the connection drops it
+       auto capture_this = shared_from_this();
+       fc::async( [capture_this,callback,block_num_from,block_num_to,packed]() {
+          capture_this->send_blocks( callback, block_num_from, block_num_to, packed );
+          --capture_this->_active_streams;
+       } );
+    }
+
+    void block_api::send_blocks( const std::function<void(const variant&)>& callback, uint32_t block_num_from,
+                                 uint32_t block_num_to, bool packed )const
+    {
+       try
+       {
+          for( uint64_t block_num = block_num_from; block_num <= block_num_to; ++block_num )
+          {
+             streamed_block item;
+             item.block_num = static_cast<uint32_t>( block_num );
+             if( packed )
+                item.packed = _db.fetch_packed_block_by_number( block_num );
+             else
+                item.block = _db.fetch_block_by_number( block_num );
+             callback( fc::variant( item, GRAPHENE_MAX_NESTED_OBJECTS ) );
+             // let blocks be applied and other calls be served between two blocks
+             fc::yield();
+          }
+       }
+       catch( const fc::exception& e )
+       {
+          // most likely the connection was closed
+          dlog( "Stopped streaming blocks: ${e}", ("e",e.to_string()) );
+       }
+       catch( ... )
+       {
+          dlog( "Stopped streaming blocks" );
+       }
+    }
+
     network_broadcast_api::network_broadcast_api(application& a):_app(a)
     {
        _applied_block_connection = _app.chain_database()->applied_block.connect([this](const signed_block& b){ on_applied_block(b); });
@@ -173,8 +284,7 @@ namespace graphene { namespace app {
 
     void network_broadcast_api::broadcast_transaction(const precomputable_transaction& trx)
     {
-       _app.chain_database()->precompute_parallel( trx ).wait();
-       _app.chain_database()->push_transaction(trx);
+       _app.push_transaction( trx );
        if( _app.p2p_node() != nullptr )
           _app.p2p_node()->broadcast_transaction(trx);
     }
@@ -191,6 +301,7 @@ namespace graphene { namespace app {
 
     void network_broadcast_api::broadcast_block( const signed_block& b )
     {
+       FC_ASSERT( !_app.chain_database()->in_read_scope(), "Blocks can not be pushed in an API batch" );
        _app.chain_database()->precompute_parallel( b ).wait();
        _app.chain_database()->push_block(b);
        if( _app.p2p_node() != nullptr )
@@ -199,9 +310,8 @@ namespace graphene { namespace app {
 
     void network_broadcast_api::broadcast_transaction_with_callback(confirmation_callback cb, const precomputable_transaction& trx)
     {
-       _app.chain_database()->precompute_parallel( trx ).wait();
        _callbacks[trx.id()] = cb;
-       _app.chain_database()->push_transaction(trx);
+       _app.push_transaction( trx );
        if( _app.p2p_node() != nullptr )
           _app.p2p_node()->broadcast_transaction(trx);
     }
@@ -242,6 +352,19 @@ namespace graphene { namespace app {
        return _app.p2p_node()->set_advanced_node_parameters(params);
     }
 
+    fc::variant_object network_node_api::get_message_statistics() const
+    {
+       return _app.p2p_node()->get_message_statistics();
+    }
+
+    api_rate_limit_statistics network_node_api::get_api_rate_limit_statistics() const
+    {
+       const std::shared_ptr<api_rate_limiter> limiter = _app.get_api_rate_limiter();
+       if( !limiter )
+          return api_rate_limit_statistics();
+       return limiter->get_statistics();
+    }
+
     fc::api<network_broadcast_api> login_api::network_broadcast()const
     {
        FC_ASSERT(_network_broadcast_api);
@@ -296,6 +419,69 @@ namespace graphene { namespace app {
        return *_debug_api;
     }
 
+    fc::api<profiling_api> login_api::profiling() const
+    {
+       FC_ASSERT(_profiling_api);
+       return *_profiling_api;
+    }
+
+    // profiling_api
+    vector<api_method_statistics> profiling_api::get_method_statistics()const
+    {
+       const std::shared_ptr<api_profiler> profiler = _app.get_api_profiler();
+       FC_ASSERT( profiler, "API calls are not profiled" );
+       return profiler->get_method_statistics();
+    }
+
+    vector<slow_api_call> profiling_api::get_slow_calls()const
+    {
+       const std::shared_ptr<api_profiler> profiler = _app.get_api_profiler();
+       FC_ASSERT( profiler, "API calls are not profiled" );
+       return profiler->get_slow_calls();
+    }
+
+    void profiling_api::reset_statistics()
+    {
+       const std::shared_ptr<api_profiler> profiler = _app.get_api_profiler();
+       FC_ASSERT( profiler, "API calls are not profiled" );
+       profiler->reset();
+    }
+
+    vector<evaluator_statistics> profiling_api::get_evaluator_statistics()const
+    {
+       FC_ASSERT( graphene::chain::database::evaluator_profiling_enabled(),
+                  "Evaluators are only profiled in builds with GRAPHENE_EVALUATOR_PROFILING" );
+       return _app.chain_database()->get_evaluator_statistics();
+    }
+
+    void profiling_api::reset_evaluator_statistics()
+    {
+       FC_ASSERT( graphene::chain::database::evaluator_profiling_enabled(),
+                  "Evaluators are only profiled in builds with GRAPHENE_EVALUATOR_PROFILING" );
+       _app.chain_database()->reset_evaluator_statistics();
+    }
+
+    vector<block_stage_statistics> profiling_api::get_block_statistics()const
+    {
+       const std::shared_ptr<block_tracer> tracer = _app.get_block_tracer();
+       FC_ASSERT( tracer, "Blocks are not traced" );
+       return tracer->get_statistics();
+    }
+
+    vector<block_trace> profiling_api::get_recent_blocks( uint32_t limit )const
+    {
+       const std::shared_ptr<block_tracer> tracer = _app.get_block_tracer();
+       FC_ASSERT( tracer, "Blocks are not traced" );
+       return tracer->get_recent_blocks( limit );
+    }
+
+    void profiling_api::reset_block_statistics()
+    {
+       const std::shared_ptr<block_tracer> tracer = _app.get_block_tracer();
+       FC_ASSERT( tracer, "Blocks are not traced" );
+       tracer->reset();
+    }
+
     vector<order_history_object> history_api::get_fill_order_history( std::string asset_a, std::string asset_b, uint32_t limit  )const
     {
        FC_ASSERT(_app.chain_database());
@@ -353,22 +539,40 @@ namespace graphene { namespace app {
           }
        }
 
-       const auto& hist_idx = db.get_index_type<account_transaction_history_index>();
-       const auto& by_op_idx = hist_idx.indices().get<by_op>();
-       auto index_start = by_op_idx.begin();
-       auto itr = by_op_idx.lower_bound(boost::make_tuple(account, start));
+       return _app.run_read_only_api_call( [&]() {
+          const auto& hist_idx = db.get_index_type<account_transaction_history_index>();
+          const auto& by_op_idx = hist_idx.indices().get<by_op>();
+          auto index_start = by_op_idx.begin();
+          auto itr = by_op_idx.lower_bound(boost::make_tuple(account, start));
 
-       while(itr != index_start && itr->account == account && itr->operation_id.instance.value > stop.instance.value && result.size() < limit)
-       {
-          if(itr->operation_id.instance.value <= start.instance.value)
-             result.push_back(itr->operation_id(db));
-          --itr;
-       }
-       if(stop.instance.value == 0 && result.size() < limit && itr->account == account) {
-         result.push_back(itr->operation_id(db));
-       }
+          while(itr != index_start && itr->account == account && itr->operation_id.instance.value > stop.instance.value && result.size() < limit)
+          {
+             if(itr->operation_id.instance.value <= start.instance.value)
+                result.push_back(itr->operation_id(db));
+             --itr;
+          }
+          if(stop.instance.value == 0 && result.size() < limit && itr->account == account) {
+            result.push_back(itr->operation_id(db));
+          }
 
-       return result;
+          // continue with the entries archived on disk, which are older than those in memory
+          const account_history::account_history_archive* archive = find_account_history_archive( _app );
+          if( archive != nullptr && result.size() < limit )
+          {
+             const auto& by_seq_idx = hist_idx.indices().get<by_seq>();
+             auto oldest = by_seq_idx.lower_bound( boost::make_tuple( account, 0 ) );
+             if( oldest != by_seq_idx.end() && oldest->account == account
+                   && oldest->operation_id.instance.value > 0 )
+             {
+                const uint64_t max_op = std::min( start.instance.value, oldest->operation_id.instance.value - 1 );
+                const uint64_t min_op = ( stop.instance.value == 0 ) ? 0 : stop.instance.value + 1;
+                for( auto& op : archive->get_by_operation( account, max_op, min_op, limit - result.size() ) )
+                   result.push_back( std::move( op ) );
+             }
+          }
+
+          return result;
+       } );
     }
 
     vector<operation_history_object> history_api::get_account_history_operations( const std::string account_id_or_name,
@@ -381,34 +585,60 @@ namespace graphene { namespace app {
        const auto& db = *_app.chain_database();
        uint64_t api_limit_get_account_history_operations=_app.get_options().api_limit_get_account_history_operations;
        FC_ASSERT(limit <= api_limit_get_account_history_operations);
-       vector<operation_history_object> result;
-       account_id_type account;
-       try {
-          account = database_api.get_account_id_from_string(account_id_or_name);
-       } catch(...) { return result; }
-       const auto& stats = account(db).statistics(db);
-       if( stats.most_recent_op == account_transaction_history_id_type() ) return result;
-       const account_transaction_history_object* node = &stats.most_recent_op(db);
-       if( start == operation_history_id_type() )
-          start = node->operation_id;
+       return _app.run_read_only_api_call( [&]() {
+          vector<operation_history_object> result;
+          account_id_type account;
+          try {
+             account = database_api.get_account_id_from_string(account_id_or_name);
+          } catch(...) { return result; }
+          const auto& stats = account(db).statistics(db);
+          if( stats.most_recent_op == account_transaction_history_id_type() ) return result;
+
+          const account_history::account_history_by_type_index* by_type = nullptr;
+          try
+          {
+             by_type = &db.get_index_type< primary_index< account_transaction_history_index > >()
+                          .get_secondary_index< account_history::account_history_by_type_index >();
+          }
+          catch( fc::assert_exception& e ) {} // the history was not tracked by the account_history plugin
+          if( by_type != nullptr )
+          {
+             const std::set<operation_history_id_type>* ops = by_type->find( account, operation_type );
+             if( ops == nullptr )
+                return result;
+             auto itr = ( start == operation_history_id_type() ? ops->end() : ops->upper_bound( start ) );
+             while( itr != ops->begin() && result.size() < limit )
+             {
+                --itr;
+                if( *itr <= stop && stop != operation_history_id_type() )
+                   break;
+                result.push_back( (*itr)(db) );
+             }
+             return result;
+          }
 
-       while(node && node->operation_id.instance.value > stop.instance.value && result.size() < limit)
-       {
-          if( node->operation_id.instance.value <= start.instance.value ) {
+          const account_transaction_history_object* node = &stats.most_recent_op(db);
+          if( start == operation_history_id_type() )
+             start = node->operation_id;
+
+          while(node && node->operation_id.instance.value > stop.instance.value && result.size() < limit)
+          {
+             if( node->operation_id.instance.value <= start.instance.value ) {
 
-             if(node->operation_id(db).op.which() == operation_type)
-               result.push_back( node->operation_id(db) );
+                if(node->operation_id(db).op.which() == operation_type)
+                  result.push_back( node->operation_id(db) );
+             }
+             if( node->next == account_transaction_history_id_type() )
+                node = nullptr;
+             else node = &node->next(db);
           }
-          if( node->next == account_transaction_history_id_type() )
-             node = nullptr;
-          else node = &node->next(db);
-       }
-       if( stop.instance.value == 0 && result.size() < limit ) {
-          auto head = db.find(account_transaction_history_id_type());
-          if (head != nullptr && head->account == account && head->operation_id(db).op.which() == operation_type)
-            result.push_back(head->operation_id(db));
-       }
-       return result;
+          if( stop.instance.value == 0 && result.size() < limit ) {
+             auto head = db.find(account_transaction_history_id_type());
+             if (head != nullptr && head->account == account && head->operation_id(db).op.which() == operation_type)
+               result.push_back(head->operation_id(db));
+          }
+          return result;
+       } );
     }
 
 
@@ -421,33 +651,45 @@ namespace graphene { namespace app {
        const auto& db = *_app.chain_database();
        uint64_t api_limit_get_relative_account_history=_app.get_options().api_limit_get_relative_account_history;
        FC_ASSERT(limit <= api_limit_get_relative_account_history);
-       vector<operation_history_object> result;
-       account_id_type account;
-       try {
-          account = database_api.get_account_id_from_string(account_id_or_name);
-       } catch(...) { return result; }
-       const auto& stats = account(db).statistics(db);
-       if( start == 0 )
-          start = stats.total_ops;
-       else
-          start = std::min( stats.total_ops, start );
+       return _app.run_read_only_api_call( [&]() {
+          vector<operation_history_object> result;
+          account_id_type account;
+          try {
+             account = database_api.get_account_id_from_string(account_id_or_name);
+          } catch(...) { return result; }
+          const auto& stats = account(db).statistics(db);
+          if( start == 0 )
+             start = stats.total_ops;
+          else
+             start = std::min( stats.total_ops, start );
+
+          if( start >= stop && start > stats.removed_ops && limit > 0 )
+          {
+             const auto& hist_idx = db.get_index_type<account_transaction_history_index>();
+             const auto& by_seq_idx = hist_idx.indices().get<by_seq>();
 
-       if( start >= stop && start > stats.removed_ops && limit > 0 )
-       {
-          const auto& hist_idx = db.get_index_type<account_transaction_history_index>();
-          const auto& by_seq_idx = hist_idx.indices().get<by_seq>();
+             auto itr = by_seq_idx.upper_bound( boost::make_tuple( account, start ) );
+             auto itr_stop = by_seq_idx.lower_bound( boost::make_tuple( account, stop ) );
 
-          auto itr = by_seq_idx.upper_bound( boost::make_tuple( account, start ) );
-          auto itr_stop = by_seq_idx.lower_bound( boost::make_tuple( account, stop ) );
+             do
+             {
+                --itr;
+                result.push_back( itr->operation_id(db) );
+             }
+             while ( itr != itr_stop && result.size() < limit );
+          }
 
-          do
+          // continue with the entries archived on disk, those up to removed_ops
+          const account_history::account_history_archive* archive = find_account_history_archive( _app );
+          const uint64_t archive_start = std::min( start, stats.removed_ops );
+          const uint64_t archive_stop = std::max<uint64_t>( stop, 1 );
+          if( archive != nullptr && result.size() < limit && archive_start >= archive_stop )
           {
-             --itr;
-             result.push_back( itr->operation_id(db) );
+             for( auto& op : archive->get_by_sequence( account, archive_start, archive_stop, limit - result.size() ) )
+                result.push_back( std::move( op ) );
           }
-          while ( itr != itr_stop && result.size() < limit );
-       }
-       return result;
+          return result;
+       } );
     }
 
     flat_set<uint32_t> history_api::get_market_history_buckets()const
@@ -457,6 +699,15 @@ namespace graphene { namespace app {
        return hist->tracked_buckets();
     }
 
+    vector<history_store::stored_operation> history_api::query_history_store(
+          const history_store::history_query& query )const
+    {
+       FC_ASSERT( query.limit <= _app.get_options().api_limit_get_account_history );
+       auto plugin = _app.get_plugin<history_store::history_store_plugin>( "history_store" );
+       FC_ASSERT( plugin && plugin->store(), "The history_store plugin is not enabled" );
+       return plugin->store()->query( query );
+    }
+
     history_operation_detail history_api::get_account_history_by_operations(const std::string account_id_or_name, vector<uint16_t> operation_types, uint32_t start, unsigned limit)
     {
        uint64_t api_limit_get_account_history_by_operations=_app.get_options().api_limit_get_account_history_by_operations;
@@ -477,28 +728,11 @@ namespace graphene { namespace app {
                                                            uint32_t bucket_seconds, fc::time_point_sec start, fc::time_point_sec end )const
     { try {
        FC_ASSERT(_app.chain_database());
-       const auto& db = *_app.chain_database();
+       auto hist = _app.get_plugin<market_history_plugin>( "market_history" );
+       FC_ASSERT( hist );
        asset_id_type a = database_api.get_asset_id_from_string( asset_a );
        asset_id_type b = database_api.get_asset_id_from_string( asset_b );
-       vector<bucket_object> result;
-       result.reserve(200);
-
-       if( a > b ) std::swap(a,b);
-
-       const auto& bidx = db.get_index_type<bucket_index>();
-       const auto& by_key_idx = bidx.indices().get<by_key>();
-
-       auto itr = by_key_idx.lower_bound( bucket_key( a, b, bucket_seconds, start ) );
-       while( itr != by_key_idx.end() && itr->key.open <= end && result.size() < 200 )
-       {
-          if( !(itr->key.base == a && itr->key.quote == b && itr->key.seconds == bucket_seconds) )
-          {
-            return result;
-          }
-          result.push_back(*itr);
-          ++itr;
-       }
-       return result;
+       return hist->get_market_history( a, b, bucket_seconds, start, end, 200 );
     } FC_CAPTURE_AND_RETHROW( (asset_a)(asset_b)(bucket_seconds)(start)(end) ) }
 
     crypto_api::crypto_api(){};
@@ -558,6 +792,37 @@ namespace graphene { namespace app {
     }
 
     // asset_api
+    namespace {
+       /// @return the holders tracked by the api_helper_indexes plugin, or null if it is not enabled
+       const graphene::api_helper_indexes::asset_holders_index* find_asset_holders_index( const database& db )
+       {
+          try
+          {
+             return &db.get_index_type< primary_index< account_balance_index > >()
+                       .get_secondary_index< graphene::api_helper_indexes::asset_holders_index >();
+          }
+          catch( fc::assert_exception& e )
+          {
+             return nullptr;
+          }
+       }
+
+       /// @return the collateral aggregates tracked by the api_helper_indexes plugin, or null if it is not enabled
+       const graphene::api_helper_indexes::amount_in_collateral_index* find_amount_in_collateral_index(
+             const database& db )
+       {
+          try
+          {
+             return &db.get_index_type< primary_index< call_order_index > >()
+                       .get_secondary_index< graphene::api_helper_indexes::amount_in_collateral_index >();
+          }
+          catch( fc::assert_exception& e )
+          {
+             return nullptr;
+          }
+       }
+    }
+
     asset_api::asset_api(graphene::app::application& app) :
           _app(app),
           _db( *app.chain_database()),
@@ -568,40 +833,63 @@ namespace graphene { namespace app {
     vector<account_asset_balance> asset_api::get_asset_holders( std::string asset, uint32_t start, uint32_t limit ) const {
        uint64_t api_limit_get_asset_holders=_app.get_options().api_limit_get_asset_holders;
        FC_ASSERT(limit <= api_limit_get_asset_holders);
-       asset_id_type asset_id = database_api.get_asset_id_from_string( asset );
-       const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
-       auto range = bal_idx.equal_range( boost::make_tuple( asset_id ) );
+       return _app.run_read_only_api_call( [&]() {
+          asset_id_type asset_id = database_api.get_asset_id_from_string( asset );
+          vector<account_asset_balance> result;
+
+          const auto* holders_index = find_asset_holders_index( _db );
+          if( holders_index )
+          {
+             for( const auto& holder : holders_index->get_holders( asset_id, start, limit ) )
+             {
+                const account_object& account = holder.owner(_db);
 
-       vector<account_asset_balance> result;
+                account_asset_balance aab;
+                aab.name       = account.name;
+                aab.account_id = account.id;
+                aab.amount     = holder.balance.value;
 
-       uint32_t index = 0;
-       for( const account_balance_object& bal : boost::make_iterator_range( range.first, range.second ) )
-       {
-          if( result.size() >= limit )
-             break;
+                result.push_back(aab);
+             }
+             return result;
+          }
 
-          if( bal.balance.value == 0 )
-             continue;
+          const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
+          auto range = bal_idx.equal_range( boost::make_tuple( asset_id ) );
 
-          if( index++ < start )
-             continue;
+          uint32_t index = 0;
+          for( const account_balance_object& bal : boost::make_iterator_range( range.first, range.second ) )
+          {
+             if( result.size() >= limit )
+                break;
 
-          const auto account = _db.find(bal.owner);
+             if( bal.balance.value == 0 )
+                continue;
 
-          account_asset_balance aab;
-          aab.name       = account->name;
-          aab.account_id = account->id;
-          aab.amount     = bal.balance.value;
+             if( index++ < start )
+                continue;
 
-          result.push_back(aab);
-       }
+             const auto account = _db.find(bal.owner);
 
-       return result;
+             account_asset_balance aab;
+             aab.name       = account->name;
+             aab.account_id = account->id;
+             aab.amount     = bal.balance.value;
+
+             result.push_back(aab);
+          }
+
+          return result;
+       } );
     }
     // get number of asset holders.
     int asset_api::get_asset_holders_count( std::string asset ) const {
-       const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
        asset_id_type asset_id = database_api.get_asset_id_from_string( asset );
+       const auto* holders_index = find_asset_holders_index( _db );
+       if( holders_index )
+          return holders_index->get_holders_count( asset_id );
+
+       const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
        auto range = bal_idx.equal_range( boost::make_tuple( asset_id ) );
 
        int count = boost::distance(range) - 1;
@@ -610,28 +898,67 @@ namespace graphene { namespace app {
     }
     // function to get vector of system assets with holders count.
     vector<asset_holders> asset_api::get_all_asset_holders() const {
-       vector<asset_holders> result;
-       vector<asset_id_type> total_assets;
-       for( const asset_object& asset_obj : _db.get_index_type<asset_index>().indices() )
-       {
-          const auto& dasset_obj = asset_obj.dynamic_asset_data_id(_db);
+       return _app.run_read_only_api_call( [&]() {
+          vector<asset_holders> result;
+          vector<asset_id_type> total_assets;
+          const auto* holders_index = find_asset_holders_index( _db );
+          for( const asset_object& asset_obj : _db.get_index_type<asset_index>().indices() )
+          {
+             const auto& dasset_obj = asset_obj.dynamic_asset_data_id(_db);
 
-          asset_id_type asset_id;
-          asset_id = dasset_obj.id;
+             asset_id_type asset_id;
+             asset_id = dasset_obj.id;
 
-          const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
-          auto range = bal_idx.equal_range( boost::make_tuple( asset_id ) );
+             int count;
+             if( holders_index )
+                count = holders_index->get_holders_count( asset_id );
+             else
+             {
+                const auto& bal_idx = _db.get_index_type< account_balance_index >().indices()
+                                         .get< by_asset_balance >();
+                auto range = bal_idx.equal_range( boost::make_tuple( asset_id ) );
+                count = boost::distance(range) - 1;
+             }
+
+             asset_holders ah;
+             ah.asset_id       = asset_id;
+             ah.count     = count;
 
-          int count = boost::distance(range) - 1;
+             result.push_back(ah);
+          }
 
-          asset_holders ah;
-          ah.asset_id       = asset_id;
-          ah.count     = count;
+          return result;
+       } );
+    }
 
-          result.push_back(ah);
-       }
+    vector<call_order_object> asset_api::get_collateral_positions( std::string asset, uint32_t start,
+                                                                   uint32_t limit )const {
+       uint64_t api_limit_get_call_orders = _app.get_options().api_limit_get_call_orders;
+       FC_ASSERT( limit <= api_limit_get_call_orders );
+       return _app.run_read_only_api_call( [&]() {
+          asset_id_type asset_id = database_api.get_asset_id_from_string( asset );
+          const asset_object& mia = asset_id(_db);
+          FC_ASSERT( mia.is_market_issued(), "Asset ${a} is not market issued", ("a",asset) );
+          vector<call_order_object> result;
 
-       return result;
+          const auto* collateral_index = find_amount_in_collateral_index( _db );
+          if( collateral_index )
+          {
+             for( const auto& position : collateral_index->get_positions( asset_id, start, limit ) )
+                result.push_back( position.call_order(_db) );
+             return result;
+          }
+
+          const auto& call_book = _db.get_call_order_books().get_book( asset_id,
+                                                  mia.bitasset_data(_db).options.short_backing_asset );
+          if( start >= call_book.size() )
+             return result;
+          auto itr = call_book.begin();
+          std::advance( itr, start );
+          for( ; itr != call_book.end() && result.size() < limit; ++itr )
+             result.push_back( *itr->order );
+          return result;
+       } );
     }
 
    // orders_api
@@ -652,23 +979,25 @@ namespace graphene { namespace app {
       FC_ASSERT( limit <= api_limit_get_grouped_limit_orders );
       auto plugin = _app.get_plugin<graphene::grouped_orders::grouped_orders_plugin>( "grouped_orders" );
       FC_ASSERT( plugin );
-      const auto& limit_groups = plugin->limit_order_groups();
       vector< limit_order_group > result;
 
       asset_id_type base_asset_id = database_api.get_asset_id_from_string( base_asset );
       asset_id_type quote_asset_id = database_api.get_asset_id_from_string( quote_asset );
 
-      price max_price = price::max( base_asset_id, quote_asset_id );
-      price min_price = price::min( base_asset_id, quote_asset_id );
-      if( start.valid() && !start->is_null() )
-         max_price = std::max( std::min( max_price, *start ), min_price );
+      const auto* limit_groups = plugin->find_limit_order_groups( base_asset_id, quote_asset_id, group );
+      if( limit_groups == nullptr )
+         return result;
 
-      auto itr = limit_groups.lower_bound( limit_order_group_key( group, max_price ) );
-      // use an end itrator to try to avoid expensive price comparison
-      auto end = limit_groups.upper_bound( limit_order_group_key( group, min_price ) );
-      while( itr != end && result.size() < limit )
+      auto itr = limit_groups->begin();
+      if( start.valid() && !start->is_null() )
+      {
+         price max_price = price::max( base_asset_id, quote_asset_id );
+         price min_price = price::min( base_asset_id, quote_asset_id );
+         itr = limit_groups->lower_bound( price_bucket( std::max( std::min( max_price, *start ), min_price ), group ) );
+      }
+      while( itr != limit_groups->end() && result.size() < limit )
       {
-         result.emplace_back( *itr );
+         result.emplace_back( itr->second );
          ++itr;
       }
       return result;
@@ -31,7 +31,7 @@ market_ticker::market_ticker(const market_ticker_object& mto,
                              const fc::time_point_sec& now,
                              const asset_object& asset_base,
                              const asset_object& asset_quote,
-                             const order_book& orders)
+                             const limit_order_book_index* books)
 {
    time = now;
    base = asset_base.symbol;
@@ -67,10 +67,16 @@ market_ticker::market_ticker(const market_ticker_object& mto,
    base_volume = uint128_amount_to_string( bv, asset_base.precision );
    quote_volume = uint128_amount_to_string( qv, asset_quote.precision );
 
-   if(!orders.asks.empty())
-      lowest_ask = orders.asks[0].price;
-   if(!orders.bids.empty())
-      highest_bid = orders.bids[0].price;
+   if( books != nullptr )
+   {
+      // the first order of each book has the best price
+      const auto& ask_book = books->get_book( asset_quote.id, asset_base.id );
+      if( !ask_book.empty() )
+         lowest_ask = price_to_string( ask_book.begin()->order->sell_price, asset_base, asset_quote );
+      const auto& bid_book = books->get_book( asset_base.id, asset_quote.id );
+      if( !bid_book.empty() )
+         highest_bid = price_to_string( bid_book.begin()->order->sell_price, asset_base, asset_quote );
+   }
 }
 
 market_ticker::market_ticker(const fc::time_point_sec& now,
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/api_profiler.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace app {
+
+namespace {
+   /// The upper bounds of the latency histogram buckets but the last, in microseconds
+   const std::array<uint64_t, api_profiler::histogram_buckets - 1> histogram_bounds_us =
+         {{ 100, 1000, 10000, 100000, 1000000 }};
+}
+
+api_profiler::api_profiler( uint32_t slow_call_threshold_ms )
+   : _slow_call_threshold_us( uint64_t(slow_call_threshold_ms) * 1000 )
+{
+}
+
+std::shared_ptr<api_profiler::method_counters> api_profiler::counters_of( const std::string& api_name,
+                                                                         const std::string& method )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   auto& counters = _counters[ method_key( api_name, method ) ];
+   if( !counters )
+      counters = std::make_shared<method_counters>();
+   return counters;
+}
+
+bool api_profiler::record( method_counters& counters, uint64_t time_us, bool failed )
+{
+   size_t bucket = 0;
+   while( bucket < histogram_bounds_us.size() && time_us >= histogram_bounds_us[bucket] )
+      ++bucket;
+
+   std::lock_guard<std::mutex> guard( _mutex );
+   ++counters.calls;
+   if( failed )
+      ++counters.failures;
+   counters.total_time_us += time_us;
+   counters.max_time_us = std::max( counters.max_time_us, time_us );
+   ++counters.histogram[bucket];
+   return _slow_call_threshold_us > 0 && time_us >= _slow_call_threshold_us;
+}
+
+void api_profiler::record_slow_call( const method_key& method, fc::time_point start, uint64_t time_us, bool failed,
+                                     fc::variants&& params )
+{
+   slow_api_call call;
+   call.time = fc::time_point_sec( start );
+   call.api = method.first;
+   call.method = method.second;
+   call.params = std::move( params );
+   call.time_us = time_us;
+   call.failed = failed;
+
+   std::lock_guard<std::mutex> guard( _mutex );
+   _slow_calls.push_front( std::move( call ) );
+   if( _slow_calls.size() > max_slow_calls )
+      _slow_calls.pop_back();
+}
+
+std::vector<api_method_statistics> api_profiler::get_method_statistics()const
+{
+   std::vector<api_method_statistics> result;
+   std::lock_guard<std::mutex> guard( _mutex );
+   result.reserve( _counters.size() );
+   for( const auto& entry : _counters )
+   {
+      const method_counters& counters = *entry.second;
+      if( counters.calls == 0 )
+         continue;
+      api_method_statistics stats;
+      stats.api = entry.first.first;
+      stats.method = entry.first.second;
+      stats.calls = counters.calls;
+      stats.failures = counters.failures;
+      stats.total_time_us = counters.total_time_us;
+      stats.max_time_us = counters.max_time_us;
+      stats.latency_histogram.assign( counters.histogram.begin(), counters.histogram.end() );
+      result.push_back( std::move( stats ) );
+   }
+   return result;
+}
+
+std::vector<slow_api_call> api_profiler::get_slow_calls()const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   return std::vector<slow_api_call>( _slow_calls.begin(), _slow_calls.end() );
+}
+
+void api_profiler::reset()
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   // the wrapped methods keep their counters, so they are cleared rather than dropped
+   for( auto& entry : _counters )
+      *entry.second = method_counters();
+   _slow_calls.clear();
+}
+
+} } // graphene::app
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/api_rate_limiter.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace app {
+
+namespace {
+   /// The methods scanning more objects than the usual lookup, by the number of simple calls they are worth
+   const std::map<std::string, uint32_t> default_method_costs = {
+      { "get_full_accounts", 10 },
+      { "get_top_markets", 10 },
+      { "get_all_asset_holders", 20 },
+      { "get_blocks", 10 },
+      { "stream_blocks", 10 },
+      { "get_account_history", 5 },
+      { "get_account_history_operations", 5 },
+      { "get_account_history_by_operations", 5 },
+      { "get_relative_account_history", 5 },
+      { "get_fill_order_history", 5 },
+      { "get_market_history", 5 },
+      { "get_trade_history", 5 },
+      { "get_trade_history_by_sequence", 5 },
+      { "get_order_book", 5 },
+      { "get_asset_holders", 5 },
+      { "get_key_references", 3 },
+      { "list_assets", 3 },
+      { "get_limit_orders", 3 },
+      { "get_call_orders", 3 },
+      { "get_settle_orders", 3 },
+      { "get_grouped_limit_orders", 3 },
+      { "lookup_accounts", 2 }
+   };
+
+   /// How often the buckets of the client addresses are checked for ones no longer needed
+   const fc::microseconds address_prune_interval = fc::seconds( 60 );
+}
+
+api_rate_limiter::api_rate_limiter( options_type options ) : _options( std::move( options ) )
+{
+}
+
+uint32_t api_rate_limiter::cost_of( const std::string& method )const
+{
+   auto itr = _options.method_costs.find( method );
+   if( itr != _options.method_costs.end() )
+      return itr->second;
+   itr = default_method_costs.find( method );
+   if( itr != default_method_costs.end() )
+      return itr->second;
+   return 1;
+}
+
+int64_t api_rate_limiter::time_until_available( api_token_bucket& bucket, double rate, double burst, uint32_t cost,
+                                                fc::time_point now )const
+{
+   if( bucket.last_refill == fc::time_point() )
+      bucket.tokens = burst;
+   else
+      bucket.tokens = std::min( burst, bucket.tokens + rate * ( now - bucket.last_refill ).count() / 1000000.0 );
+   bucket.last_refill = now;
+
+   // a call costing more than the bucket holds is admitted when the bucket is full, leaving a debt
+   const double needed = std::min<double>( cost, burst );
+   if( bucket.tokens >= needed )
+      return 0;
+   if( _options.policy == policy_type::reject )
+      return -1;
+   const double wait_us = ( needed - bucket.tokens ) / rate * 1000000.0;
+   if( wait_us > _options.max_delay_ms * 1000.0 )
+      return -1;
+   return std::max<int64_t>( 1, int64_t( wait_us ) );
+}
+
+void api_rate_limiter::prune_addresses( fc::time_point now )
+{
+   if( now - _last_prune < address_prune_interval )
+      return;
+   _last_prune = now;
+   for( auto itr = _addresses.begin(); itr != _addresses.end(); )
+   {
+      const double refilled = itr->second.tokens
+                              + _options.address_rate * ( now - itr->second.last_refill ).count() / 1000000.0;
+      if( refilled >= _options.address_burst )
+         itr = _addresses.erase( itr );
+      else
+         ++itr;
+   }
+}
+
+void api_rate_limiter::admit( api_token_bucket& connection, const std::string& address, uint32_t cost )
+{
+   int64_t wait_us = 0;
+   {
+      std::lock_guard<std::mutex> guard( _mutex );
+      const fc::time_point now = fc::time_point::now();
+
+      int64_t connection_wait_us = 0;
+      if( _options.connection_rate > 0 )
+         connection_wait_us = time_until_available( connection, _options.connection_rate,
+                                                    _options.connection_burst, cost, now );
+      api_token_bucket* address_bucket = nullptr;
+      int64_t address_wait_us = 0;
+      if( _options.address_rate > 0 && !address.empty() )
+      {
+         prune_addresses( now );
+         address_bucket = &_addresses[address];
+         address_wait_us = time_until_available( *address_bucket, _options.address_rate,
+                                                 _options.address_burst, cost, now );
+      }
+
+      if( connection_wait_us < 0 || address_wait_us < 0 )
+      {
+         ++_statistics.rejected_calls;
+         FC_THROW( "API call rate limit exceeded, the call costs ${c}", ("c",cost) );
+      }
+
+      if( _options.connection_rate > 0 )
+         connection.tokens -= cost;
+      if( address_bucket )
+         address_bucket->tokens -= cost;
+      wait_us = std::max( connection_wait_us, address_wait_us );
+      ++_statistics.admitted_calls;
+      if( wait_us > 0 )
+      {
+         ++_statistics.delayed_calls;
+         _statistics.total_delay_ms += wait_us / 1000;
+      }
+   }
+   if( wait_us > 0 )
+      fc::usleep( fc::microseconds( wait_us ) );
+}
+
+api_rate_limit_statistics api_rate_limiter::get_statistics()const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   api_rate_limit_statistics result = _statistics;
+   result.tracked_addresses = _addresses.size();
+   return result;
+}
+
+} } // graphene::app
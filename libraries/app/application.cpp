@@ -24,9 +24,11 @@
 #include <graphene/app/api.hpp>
 #include <graphene/app/api_access.hpp>
 #include <graphene/app/application.hpp>
+#include <graphene/app/rpc_connection.hpp>
 #include <graphene/app/plugin.hpp>
 
 #include <graphene/chain/db_with.hpp>
+#include <graphene/chain/exceptions.hpp>
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/protocol/fee_schedule.hpp>
 #include <graphene/protocol/types.hpp>
@@ -51,6 +53,7 @@
 #include <boost/range/algorithm/reverse.hpp>
 #include <boost/algorithm/string.hpp>
 
+#include <algorithm>
 #include <iostream>
 
 #include <fc/log/file_appender.hpp>
@@ -228,7 +231,21 @@ std::vector<fc::ip::endpoint> application_impl::resolve_string_to_ip_endpoints(c
 
 void application_impl::new_connection( const fc::http::websocket_connection_ptr& c )
 {
-   auto wsc = std::make_shared<fc::rpc::websocket_api_connection>(c, GRAPHENE_NET_MAX_NESTED_OBJECTS);
+   const bool binary = ( c->get_request_header( rpc_connection::encoding_header ) == rpc_connection::encoding_name );
+   std::string client_address;
+   if( _api_rate_limiter && !_api_rate_limit_address_header.empty() )
+   {
+      // The client may send the header itself, only the last entry, appended by the proxy, can be trusted
+      client_address = c->get_request_header( _api_rate_limit_address_header );
+      const auto last_comma = client_address.rfind( ',' );
+      if( last_comma != std::string::npos )
+         client_address = client_address.substr( last_comma + 1 );
+      boost::trim( client_address );
+   }
+   auto wsc = std::make_shared<rpc_connection>( c, GRAPHENE_NET_MAX_NESTED_OBJECTS, binary,
+                                                [this]( const std::function<void()>& batch ) {
+                                                   _self->run_api_batch( batch );
+                                                }, _api_rate_limiter, client_address );
    auto login = std::make_shared<graphene::app::login_api>( std::ref(*_self) );
    login->enable_api("database_api");
 
@@ -349,6 +366,67 @@ void application_impl::set_api_limit() {
    if(_options->count("api-limit-list-htlcs")){
       _app_options.api_limit_list_htlcs = _options->at("api-limit-list-htlcs").as<uint64_t>();
    }
+   if(_options->count("api-limit-get-object-digests")){
+      _app_options.api_limit_get_object_digests = _options->at("api-limit-get-object-digests").as<uint64_t>();
+   }
+   if(_options->count("api-limit-get-changed-objects")){
+      _app_options.api_limit_get_changed_objects = _options->at("api-limit-get-changed-objects").as<uint64_t>();
+   }
+   if(_options->count("api-limit-stream-blocks")){
+      _app_options.api_limit_stream_blocks = _options->at("api-limit-stream-blocks").as<uint64_t>();
+   }
+   if(_options->count("api-limit-block-streams")){
+      _app_options.api_limit_block_streams = _options->at("api-limit-block-streams").as<uint64_t>();
+   }
+   if(_options->count("api-limit-get-applied-operations")){
+      _app_options.api_limit_get_applied_operations = _options->at("api-limit-get-applied-operations").as<uint64_t>();
+   }
+}
+
+void application_impl::set_api_rate_limit()
+{
+   api_rate_limiter::options_type limits;
+   if( _options->count("api-rate-limit") )
+      limits.connection_rate = _options->at("api-rate-limit").as<uint32_t>();
+   if( _options->count("api-rate-limit-address-header") )
+   {
+      _api_rate_limit_address_header = _options->at("api-rate-limit-address-header").as<string>();
+      if( _options->count("api-rate-limit-per-address") )
+         limits.address_rate = _options->at("api-rate-limit-per-address").as<uint32_t>();
+   }
+   else if( _options->count("api-rate-limit-per-address") )
+      wlog( "api-rate-limit-per-address has no effect without api-rate-limit-address-header" );
+   if( limits.connection_rate == 0 && limits.address_rate == 0 )
+      return;
+
+   limits.connection_burst = _options->count("api-rate-limit-burst") ?
+                             _options->at("api-rate-limit-burst").as<uint32_t>() : 10 * limits.connection_rate;
+   limits.address_burst = _options->count("api-rate-limit-per-address-burst") ?
+                          _options->at("api-rate-limit-per-address-burst").as<uint32_t>() : 10 * limits.address_rate;
+   if( _options->count("api-rate-limit-policy") )
+   {
+      const string policy = _options->at("api-rate-limit-policy").as<string>();
+      FC_ASSERT( policy == "reject" || policy == "delay", "Unknown api-rate-limit-policy ${p}", ("p",policy) );
+      if( policy == "delay" )
+         limits.policy = api_rate_limiter::policy_type::delay;
+   }
+   if( _options->count("api-rate-limit-max-delay") )
+      limits.max_delay_ms = _options->at("api-rate-limit-max-delay").as<uint32_t>();
+   if( _options->count("api-method-cost") )
+   {
+      for( const string& method_cost : _options->at("api-method-cost").as<vector<string>>() )
+      {
+         const auto pos = method_cost.find( '=' );
+         FC_ASSERT( pos != string::npos && pos > 0, "Bad api-method-cost ${c}, expected method=cost",
+                    ("c",method_cost) );
+         limits.method_costs[ method_cost.substr( 0, pos ) ] = boost::lexical_cast<uint32_t>(
+                                                                  method_cost.substr( pos + 1 ) );
+      }
+   }
+
+   ilog( "Limiting API calls to ${c} per connection and ${a} per client address per second",
+         ("c",limits.connection_rate)("a",limits.address_rate) );
+   _api_rate_limiter = std::make_shared<api_rate_limiter>( std::move( limits ) );
 }
 
 void application_impl::startup()
@@ -361,7 +439,7 @@ void application_impl::startup()
       {
          std::string genesis_str;
          fc::read_file_contents( _options->at("genesis-json").as<boost::filesystem::path>(), genesis_str );
-         graphene::chain::genesis_state_type genesis = fc::json::from_string( genesis_str ).as<graphene::chain::genesis_state_type>( 20 );
+         graphene::chain::genesis_state_type genesis = graphene::chain::load_genesis_state( genesis_str, 20 );
          bool modified_genesis = false;
          if( _options->count("genesis-timestamp") )
          {
@@ -401,7 +479,7 @@ void application_impl::startup()
          graphene::egenesis::compute_egenesis_json( egenesis_json );
          FC_ASSERT( egenesis_json != "" );
          FC_ASSERT( graphene::egenesis::get_egenesis_json_hash() == fc::sha256::hash( egenesis_json ) );
-         auto genesis = fc::json::from_string( egenesis_json ).as<graphene::chain::genesis_state_type>( 20 );
+         auto genesis = graphene::chain::load_genesis_state( egenesis_json, 20 );
          genesis.initial_chain_id = fc::sha256::hash( egenesis_json );
          return genesis;
       }
@@ -421,6 +499,22 @@ void application_impl::startup()
          loaded_checkpoints[item.first] = item.second;
       }
    }
+   if( _options->count("checkpoint-file") )
+   {
+      const fc::path file = _options->at("checkpoint-file").as<boost::filesystem::path>();
+      FC_ASSERT( fc::exists(file), "Checkpoint file ${f} does not exist", ("f", file) );
+      const auto published = fc::json::from_file( file ).as<signed_checkpoints>( 3 );
+      if( _options->count("checkpoint-file-signer") )
+      {
+         const public_key_type signer( _options->at("checkpoint-file-signer").as<string>() );
+         FC_ASSERT( published.signature.valid(), "Checkpoint file ${f} is not signed", ("f", file) );
+         FC_ASSERT( public_key_type( fc::ecc::public_key( *published.signature, published.digest() ) ) == signer,
+                    "Checkpoint file ${f} is not signed by ${k}", ("f", file)("k", signer) );
+      }
+      for( const auto& item : published.checkpoints )
+         loaded_checkpoints[item.first] = item.second;
+      ilog( "Loaded ${n} checkpoints from ${f}", ("n", published.checkpoints.size())("f", file) );
+   }
    _chain_db->add_checkpoints( loaded_checkpoints );
 
    if( _options->count("enable-standby-votes-tracking") )
@@ -428,9 +522,69 @@ void application_impl::startup()
       _chain_db->enable_standby_votes_tracking( _options->at("enable-standby-votes-tracking").as<bool>() );
    }
 
+   if( _options->count("analyze-transaction-conflicts") )
+      _chain_db->enable_transaction_conflict_analysis( _options->at("analyze-transaction-conflicts").as<bool>() );
+
+   if( _options->count("lazy-load-history") && _options->at("lazy-load-history").as<bool>() )
+   {
+      // Not needed to validate blocks, they are loaded one after another while the rest of the node starts.
+      // A replay, a plugin rebuild or the first block applied blocks the thread until they are loaded.
+      _chain_db->load_in_background( operation_history_object::space_id, operation_history_object::type_id );
+      _chain_db->load_in_background( account_transaction_history_object::space_id,
+                                     account_transaction_history_object::type_id );
+      if( _active_plugins.find( "market_history" ) != _active_plugins.end() )
+      {
+         _chain_db->load_in_background( bucket_object::space_id, bucket_object::type_id );
+         _chain_db->load_in_background( order_history_object::space_id, order_history_object::type_id );
+      }
+   }
+
+   if( _options->count("block-log-retain-blocks") )
+   {
+      const uint32_t retain_blocks = _options->at("block-log-retain-blocks").as<uint32_t>();
+      FC_ASSERT( retain_blocks >= GRAPHENE_MAX_UNDO_HISTORY,
+                 "block-log-retain-blocks must not be less than ${n}", ("n",GRAPHENE_MAX_UNDO_HISTORY) );
+      wlog( "Blocks older than ${n} blocks before the last irreversible block will be deleted", ("n",retain_blocks) );
+      _chain_db->set_block_log_retention( retain_blocks );
+   }
+
+   if( _options->count("applied-operation-log") )
+      _chain_db->enable_applied_operation_log( _options->at("applied-operation-log").as<bool>() );
+
+   if( _options->count("undo-history-max-bytes") )
+      _chain_db->set_undo_history_max_bytes( _options->at("undo-history-max-bytes").as<uint64_t>() );
+
+   if( _options->count("background-threads") )
+      _chain_db->set_background_threads( _options->at("background-threads").as<uint16_t>() );
+
+   if( _options->count("replay-queue-depth") )
+      _chain_db->set_replay_queue_depth( _options->at("replay-queue-depth").as<uint32_t>() );
+
+   if( _options->count("replay-profile") )
+      _chain_db->enable_replay_profile( true );
+
+   if( _options->count("log-index-memory-usage") )
+      _chain_db->enable_memory_usage_log( _options->at("log-index-memory-usage").as<bool>() );
+
+   if( _options->count("pending-tx-reapply-time-limit") )
+      _chain_db->set_pending_tx_reapply_time_limit(
+            fc::milliseconds( _options->at("pending-tx-reapply-time-limit").as<uint32_t>() ) );
+
+   if( _options->count("signature-cache-size") )
+      _chain_db->set_signature_cache_size( _options->at("signature-cache-size").as<uint32_t>() );
+
    if( _options->count("replay-blockchain") || _options->count("revalidate-blockchain") )
       _chain_db->wipe( _data_dir / "blockchain", false );
 
+   if( _options->count("load-snapshot") )
+   {
+      const auto snapshot = _chain_db->load_snapshot( _options->at("load-snapshot").as<boost::filesystem::path>(),
+                                                      _data_dir / "blockchain", GRAPHENE_CURRENT_DB_VERSION,
+                                                      initial_state().initial_chain_id );
+      ilog( "Started from snapshot of block ${n}, syncing the following blocks from the network",
+            ("n",snapshot.head_block.block_num()) );
+   }
+
    try
    {
       // these flags are used in open() only, i. e. during replay
@@ -463,6 +617,27 @@ void application_impl::startup()
       throw;
    }
 
+   if( _options->count("replay-profile") )
+   {
+      _chain_db->enable_replay_profile( false );
+      const auto profile_file = _options->at("replay-profile").as<boost::filesystem::path>();
+      if( _chain_db->get_replay_profile() != nullptr )
+      {
+         fc::json::save_to_file( *_chain_db->get_replay_profile(), profile_file );
+         ilog( "Wrote the replay profile to ${f}", ("f",profile_file.generic_string()) );
+      }
+      else
+         wlog( "No blocks were replayed, not writing a replay profile" );
+   }
+
+   if( _options->count("relay-only") && _options->at("relay-only").as<bool>() )
+   {
+      ilog( "Transactions are relayed without applying them to the pending state" );
+      _relay_only = true;
+      if( _options->count("relay-only-dupe-filter") )
+         _relay_dupe_filter = _options->at("relay-only-dupe-filter").as<bool>();
+   }
+
    if( _options->count("force-validate") )
    {
       ilog( "All transaction signatures will be validated" );
@@ -474,6 +649,36 @@ void application_impl::startup()
 
    set_api_limit();
 
+   if( _options->count("api-full-account-cache-size") )
+   {
+      const uint32_t cache_size = _options->at("api-full-account-cache-size").as<uint32_t>();
+      if( cache_size > 0 )
+         _full_account_cache = std::make_shared<full_account_cache>( *_chain_db, cache_size );
+   }
+   _subscription_registry = std::make_shared<subscription_registry>( *_chain_db );
+
+   if( _options->count("enable-api-profiling") && _options->at("enable-api-profiling").as<bool>() )
+   {
+      const uint32_t threshold = _options->count("api-slow-call-threshold") ?
+                                 _options->at("api-slow-call-threshold").as<uint32_t>() : 1000;
+      _api_profiler = std::make_shared<api_profiler>( threshold );
+   }
+
+   if( ( _options->count("block-tracing") && _options->at("block-tracing").as<bool>() )
+         || _options->count("block-trace-file") )
+   {
+      const uint32_t window = _options->count("block-trace-window") ?
+                              _options->at("block-trace-window").as<uint32_t>() : 1000;
+      const uint32_t threshold = _options->count("slow-block-threshold") ?
+                                 _options->at("slow-block-threshold").as<uint32_t>() : 0;
+      fc::path trace_file;
+      if( _options->count("block-trace-file") )
+         trace_file = _options->at("block-trace-file").as<boost::filesystem::path>();
+      _block_tracer = std::make_shared<block_tracer>( window, threshold, trace_file );
+   }
+
+   set_api_rate_limit();
+
    if( _active_plugins.find( "market_history" ) != _active_plugins.end() )
       _app_options.has_market_history_plugin = true;
 
@@ -541,6 +746,19 @@ bool application_impl::has_item(const net::item_id& id)
    FC_CAPTURE_AND_RETHROW( (id) )
 }
 
+bool application_impl::has_item_concurrently(const net::item_id& id)
+{
+   try
+   {
+      return id.item_type == graphene::net::block_message_type && _chain_db->is_stored_block(id.item_hash);
+   }
+   catch( const fc::exception& e )
+   {
+      dlog( "Unable to look up ${id} concurrently: ${e}", ("id",id)("e",e.to_detail_string()) );
+   }
+   return false;
+}
+
 /**
  * @brief allows the application to validate an item prior to broadcasting to peers.
  *
@@ -553,7 +771,8 @@ bool application_impl::handle_block(const graphene::net::block_message& blk_msg,
                           std::vector<fc::uint160_t>& contained_transaction_message_ids)
 { try {
 
-   auto latency = fc::time_point::now() - blk_msg.block.timestamp;
+   const fc::time_point start = fc::time_point::now();
+   auto latency = start - blk_msg.block.timestamp;
    if (!sync_mode || blk_msg.block.block_num() % 10000 == 0)
    {
       const auto& witness = blk_msg.block.witness(*_chain_db);
@@ -573,17 +792,31 @@ bool application_impl::handle_block(const graphene::net::block_message& blk_msg,
                     "Rejecting block with timestamp in the future", );
 
    try {
-      const uint32_t skip = (_is_block_producer | _force_validate) ?
-                               database::skip_nothing : database::skip_transaction_signatures;
-      bool result = valve.do_serial( [this,&blk_msg,skip] () {
-         _chain_db->precompute_parallel( blk_msg.block, skip ).wait();
-      }, [this,&blk_msg,skip] () {
+      // Blocks up to the last checkpoint are only checked for their linkage and merkle root, the checkpointed
+      // block id vouches for the rest. Skipping the checks here already saves their precomputation.
+      const uint32_t skip = ( (_is_block_producer | _force_validate) ?
+                                 database::skip_nothing : database::skip_transaction_signatures )
+                            | _chain_db->checkpoint_skip_flags( blk_msg.block.block_num() );
+      // The only copy of the block, it is precomputed in place and then shared with the fork database
+      const auto block = std::make_shared<const signed_block>( blk_msg.block );
+      // During sync the P2P code hands up to MAXIMUM_NUMBER_OF_BLOCKS_TO_HANDLE_AT_ONE_TIME blocks to us at once,
+      // each in its own task. Waiting for the precomputation yields, so the following blocks start theirs while
+      // this one is still being computed or applied. The valve makes sure they are pushed in the order they came.
+      fc::time_point precomputed;
+      fc::time_point push_start;
+      bool result = valve.do_serial( [this,&block,skip,&precomputed] () {
+         _chain_db->precompute_parallel( *block, skip ).wait();
+         precomputed = fc::time_point::now();
+      }, [this,&block,skip,&push_start] () {
+         push_start = fc::time_point::now();
          // TODO: in the case where this block is valid but on a fork that's too old for us to switch to,
          // you can help the network code out by throwing a block_older_than_undo_history exception.
          // when the net code sees that, it will stop trying to push blocks from that chain, but
          // leave that peer connected so that they can get sync blocks from us
-         return _chain_db->push_block( blk_msg.block, skip );
+         return _chain_db->push_block( block, skip );
       });
+      if( _block_tracer && !sync_mode )
+         trace_block( *block, start, precomputed, push_start );
 
       // the block was accepted, so we now know all of the transactions contained in the block
       if (!sync_mode)
@@ -621,6 +854,35 @@ bool application_impl::handle_block(const graphene::net::block_message& blk_msg,
    }
 } FC_CAPTURE_AND_RETHROW( (blk_msg)(sync_mode) ) return false; }
 
+void application_impl::trace_block( const signed_block& block, fc::time_point start,
+                                    fc::time_point precomputed, fc::time_point push_start )const
+{
+   const chain::block_timing& timing = _chain_db->get_block_timing();
+   // a block that caused a switch of forks or was only stored in the fork database is not traced
+   if( timing.block_num != block.block_num() || timing.push_ns == 0 || _chain_db->head_block_id() != block.id() )
+      return;
+   const auto us = []( int64_t ns ) { return ns / 1000; };
+   block_trace trace;
+   trace.block_num = timing.block_num;
+   trace.timestamp = block.timestamp;
+   trace.transactions = timing.transactions;
+   trace.start = start;
+   trace.delay_us = ( start - block.timestamp ).count();
+   trace.precompute_us = ( precomputed - start ).count();
+   trace.queue_us = ( push_start - precomputed ).count();
+   trace.header_us = us( timing.header_ns );
+   trace.transactions_us = us( timing.transactions_ns );
+   trace.block_updates_us = us( timing.block_updates_ns );
+   trace.maintenance_us = us( timing.maintenance_ns );
+   trace.expiry_us = us( timing.expiry_ns );
+   trace.batched_indexes_us = us( timing.batched_indexes_ns );
+   trace.applied_block_us = us( timing.applied_block_ns );
+   trace.changed_objects_us = us( timing.changed_objects_ns );
+   trace.undo_us = us( timing.push_ns - timing.apply_ns );
+   trace.total_us = ( push_start - start ).count() + us( timing.push_ns );
+   _block_tracer->record( trace );
+}
+
 void application_impl::handle_transaction(const graphene::net::trx_message& transaction_message)
 { try {
    static fc::time_point last_call;
@@ -633,10 +895,41 @@ void application_impl::handle_transaction(const graphene::net::trx_message& tran
       trx_count = 0;
    }
 
-   _chain_db->precompute_parallel( transaction_message.trx ).wait();
-   _chain_db->push_transaction( transaction_message.trx );
+   // turn away expired, foreign and duplicate transactions before spending time on their signatures
+   _chain_db->precheck_transaction( transaction_message.trx );
+   push_transaction( transaction_message.trx );
 } FC_CAPTURE_AND_RETHROW( (transaction_message) ) }
 
+void application_impl::push_transaction( const chain::precomputable_transaction& trx )
+{
+   if( !_relay_only )
+   {
+      _chain_db->precompute_parallel( trx ).wait();
+      _chain_db->push_transaction( trx );
+      return;
+   }
+   // validates the operations and recovers the keys of all signatures
+   _chain_db->precompute_parallel( trx ).wait();
+   // same limit as in database::push_transaction
+   FC_ASSERT( trx.get_packed_size() + fc::raw::pack_size( trx.signatures ) < (1024 * 1024),
+              "Transaction exceeds maximum transaction size." );
+   if( _relay_dupe_filter )
+      remember_relayed_transaction( trx );
+}
+
+void application_impl::remember_relayed_transaction( const chain::precomputable_transaction& trx )
+{
+   const fc::time_point_sec now = _chain_db->head_block_time();
+   while( !_relayed_trx_expirations.empty() && _relayed_trx_expirations.begin()->first < now )
+   {
+      _relayed_trx_ids.erase( _relayed_trx_expirations.begin()->second );
+      _relayed_trx_expirations.erase( _relayed_trx_expirations.begin() );
+   }
+   GRAPHENE_ASSERT( _relayed_trx_ids.insert( trx.id() ).second, graphene::chain::duplicate_transaction,
+                    "Transaction '${txid}' was relayed already", ("txid",trx.id()) );
+   _relayed_trx_expirations.emplace( trx.expiration, trx.id() );
+}
+
 void application_impl::handle_message(const message& message_to_process)
 {
    // not a transaction, not a block
@@ -695,11 +988,14 @@ std::vector<item_hash_t> application_impl::get_block_ids(const std::vector<item_
        FC_THROW_EXCEPTION( graphene::net::peer_is_on_an_unreachable_fork,
                            "Unable to provide a list of blocks starting at any of the blocks in peer's synopsis" );
    }
-   for( uint32_t num = block_header::num_from_id(last_known_block_id);
-        num <= _chain_db->head_block_num() && result.size() < limit;
-        ++num )
-      if( num > 0 )
-         result.push_back(_chain_db->get_block_id_for_num(num));
+   // we can't help peers that need blocks we have pruned, make them look for an archive node instead
+   if( block_header::num_from_id(last_known_block_id) + 1 < _chain_db->first_available_block_num() )
+      FC_THROW_EXCEPTION( graphene::net::peer_is_on_an_unreachable_fork,
+                          "Blocks before ${n} have been pruned", ("n", _chain_db->first_available_block_num()) );
+   const uint32_t first_block_num = std::max<uint32_t>( block_header::num_from_id(last_known_block_id), 1 );
+   if( first_block_num <= _chain_db->head_block_num() && limit > 0 )
+      result = _chain_db->get_block_ids_for_nums( first_block_num,
+                                                  std::min( limit, _chain_db->head_block_num() - first_block_num + 1 ) );
 
    if( !result.empty() && block_header::num_from_id(result.back()) < _chain_db->head_block_num() )
       remaining_item_count = _chain_db->head_block_num() - block_header::num_from_id(result.back());
@@ -715,17 +1011,36 @@ message application_impl::get_item(const item_id& id)
   // ilog("Request for item ${id}", ("id", id));
    if( id.item_type == graphene::net::block_message_type )
    {
-      auto opt_block = _chain_db->fetch_block_by_id(id.item_hash);
+      if( block_header::num_from_id(id.item_hash) < _chain_db->first_available_block_num() )
+         FC_THROW_EXCEPTION( fc::key_not_found_exception, "Block ${id} has been pruned", ("id", id.item_hash) );
+      // serve the block as stored to avoid unpacking and packing it again
+      auto opt_block = _chain_db->fetch_packed_block_by_id(id.item_hash);
       if( !opt_block )
          elog("Couldn't find block ${id} -- corresponding ID in our chain is ${id2}",
               ("id", id.item_hash)("id2", _chain_db->get_block_id_for_num(block_header::num_from_id(id.item_hash))));
       FC_ASSERT( opt_block.valid() );
-      // ilog("Serving up block #${num}", ("num", opt_block->block_num()));
-      return block_message(std::move(*opt_block));
+      return block_message::from_packed_block( std::move(*opt_block), id.item_hash );
    }
    return trx_message( _chain_db->get_recent_transaction( id.item_hash ) );
 } FC_CAPTURE_AND_RETHROW( (id) ) }
 
+fc::optional<message> application_impl::get_item_concurrently(const item_id& id)
+{
+   if( id.item_type != graphene::net::block_message_type )
+      return fc::optional<message>();
+   try
+   {
+      auto packed_block = _chain_db->fetch_stored_packed_block(id.item_hash);
+      if( packed_block )
+         return block_message::from_packed_block( std::move(*packed_block), id.item_hash );
+   }
+   catch( const fc::exception& e )
+   {
+      dlog( "Unable to fetch ${id} concurrently: ${e}", ("id",id)("e",e.to_detail_string()) );
+   }
+   return fc::optional<message>();
+}
+
 chain_id_type application_impl::get_chain_id() const
 {
    return _chain_db->get_chain_id();
@@ -999,6 +1314,12 @@ void application::set_program_options(boost::program_options::options_descriptio
           "JSON array of P2P nodes to connect to on startup")
          ("checkpoint,c", bpo::value<vector<string>>()->composing(),
           "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
+         ("checkpoint-file", bpo::value<boost::filesystem::path>(),
+          "JSON file with more checkpoints, {\"checkpoints\":[[BLOCK_NUM,BLOCK_ID],...],\"signature\":...}. "
+          "Blocks up to the last checkpoint are synced without checking their signatures and transactions")
+         ("checkpoint-file-signer", bpo::value<string>(),
+          "Public key that must have signed the checkpoint file, the signature is a compact signature of the "
+          "SHA256 hash of the packed checkpoints")
          ("rpc-endpoint", bpo::value<string>()->implicit_value("127.0.0.1:8090"),
           "Endpoint for websocket RPC to listen on")
          ("rpc-tls-endpoint", bpo::value<string>()->implicit_value("127.0.0.1:8089"),
@@ -1009,11 +1330,92 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("dbg-init-key", bpo::value<string>(), "Block signing key to use for init witnesses, overrides genesis file")
          ("api-access", bpo::value<boost::filesystem::path>(), "JSON file specifying API permissions")
          ("io-threads", bpo::value<uint16_t>()->implicit_value(0), "Number of IO threads, default to 0 for auto-configuration")
+         ("api-full-account-cache-size", bpo::value<uint32_t>(),
+          "Number of get_full_accounts results to keep for all API connections, each up to "
+          "api-limit-get-full-accounts-lists entries per list, default 0 to disable the cache")
+         ("api-worker-threads", bpo::value<uint16_t>(),
+          "Number of threads running the heavy read-only API calls of the history and asset APIs concurrently with "
+          "block processing, default 0 to run them in the main thread")
+         ("enable-api-profiling", bpo::value<bool>()->implicit_value(true),
+          "Whether to measure the calls of each API method, reported by profiling_api")
+         ("api-slow-call-threshold", bpo::value<uint32_t>(),
+          "With enable-api-profiling, keep the parameters of the API calls taking at least this many milliseconds, "
+          "default 1000, 0 to keep none")
+         ("block-tracing", bpo::value<bool>()->implicit_value(true),
+          "Whether to measure the stages of handling each block received during normal operation, reported by "
+          "profiling_api")
+         ("block-trace-window", bpo::value<uint32_t>(),
+          "With block tracing, number of recent blocks the block statistics are computed over, default 1000")
+         ("block-trace-file", bpo::value<boost::filesystem::path>(),
+          "Enable block tracing and write the stages of each block to this file as Chrome trace events")
+         ("slow-block-threshold", bpo::value<uint32_t>(),
+          "With block tracing, log the stages of the blocks taking at least this many milliseconds to handle, "
+          "default 0 to log none")
+         ("api-rate-limit", bpo::value<uint32_t>(),
+          "Cost of the API calls each connection may make per second, most calls cost 1, default 0 for no limit")
+         ("api-rate-limit-burst", bpo::value<uint32_t>(),
+          "Cost of the API calls a connection may make at once after being idle, default 10 times api-rate-limit")
+         ("api-rate-limit-per-address", bpo::value<uint32_t>(),
+          "Cost of the API calls the connections of each client address may make per second together, "
+          "requires api-rate-limit-address-header, default 0 for no limit")
+         ("api-rate-limit-per-address-burst", bpo::value<uint32_t>(),
+          "Cost of the API calls the connections of a client address may make at once, "
+          "default 10 times api-rate-limit-per-address")
+         ("api-rate-limit-address-header", bpo::value<string>(),
+          "Request header in which the proxy in front of the node passes the address of the client, "
+          "e.g. X-Forwarded-For. The last address in the header is used, the one added by the proxy")
+         ("api-rate-limit-policy", bpo::value<string>(),
+          "What to do with the calls exceeding the rate limit: reject (default) or delay")
+         ("api-rate-limit-max-delay", bpo::value<uint32_t>(),
+          "With api-rate-limit-policy delay, the maximum number of milliseconds a call waits before it is rejected, "
+          "default 1000")
+         ("api-method-cost", bpo::value<vector<string>>()->composing(),
+          "Rate limit cost of an API method as method=cost, e.g. get_full_accounts=10 (may specify multiple times)")
          ("enable-subscribe-to-all", bpo::value<bool>()->implicit_value(true),
           "Whether allow API clients to subscribe to universal object creation and removal events")
+         ("lazy-load-history", bpo::value<bool>()->implicit_value(true),
+          "Whether to load the operation and market history from the object database in the background at "
+          "startup, default false. Applying the first block waits until the history is loaded")
          ("enable-standby-votes-tracking", bpo::value<bool>()->implicit_value(true),
           "Whether to enable tracking of votes of standby witnesses and committee members. "
           "Set it to true to provide accurate data to API clients, set to false for slightly better performance.")
+         ("analyze-transaction-conflicts", bpo::value<bool>()->implicit_value(true),
+          "Experimental: log for each applied block how many sequential steps its transactions would need if only "
+          "transactions writing the same objects had to be kept in order. Not done during replay.")
+         ("block-log-retain-blocks", bpo::value<uint32_t>(),
+          "If set, delete blocks older than this number of blocks before the last irreversible block from the "
+          "block database, in steps of whole segments. The node can no longer replay the chain nor serve old blocks.")
+         ("applied-operation-log", bpo::value<bool>()->implicit_value(true),
+          "Store the operations applied in each block, with virtual operations and results, next to the block "
+          "database, so that they can be read again without a replay. Blocks applied before are only stored by "
+          "a replay.")
+         ("undo-history-max-bytes", bpo::value<uint64_t>(),
+          "Approximate memory limit of the undo history, blocks are rejected while the undo history of the blocks "
+          "since the last irreversible block exceeds it, default 0 for no limit")
+         ("background-threads", bpo::value<uint16_t>(),
+          "Number of threads writing the chain state and snapshots to disk, so that this does not delay the "
+          "precomputation of blocks in the IO threads, default 0 to use the IO threads")
+         ("replay-queue-depth", bpo::value<uint32_t>(),
+          "Number of blocks that are read and precomputed in parallel ahead of the block being applied during replay, "
+          "default 20")
+         ("replay-profile", bpo::value<boost::filesystem::path>(),
+          "Measure the time spent in each stage of a replay and in the evaluation of each operation type, and "
+          "write the summary to this JSON file when the replay is done")
+         ("relay-only", bpo::value<bool>()->implicit_value(true),
+          "Only do the checks that need no pending state and recover the signature keys of incoming "
+          "transactions before relaying them, instead of applying them to the pending state. For seed and API "
+          "nodes that don't produce blocks, the pending state is empty and API calls don't see pending transactions")
+         ("relay-only-dupe-filter", bpo::value<bool>()->default_value(true),
+          "With relay-only, reject transactions that were relayed before until they expire")
+         ("log-index-memory-usage", bpo::value<bool>()->implicit_value(true),
+          "Log the approximate memory usage of the indexes after each chain maintenance, this walks all objects, "
+          "default false")
+         ("pending-tx-reapply-time-limit", bpo::value<uint32_t>(),
+          "Maximum number of milliseconds spent re-applying pending transactions after each block, the rest is "
+          "tried again after the next block, default 0 for no limit")
+         ("signature-cache-size", bpo::value<uint32_t>(),
+          "Number of public keys recovered from transaction signatures to remember, so that transactions received "
+          "before the block including them need not be verified again, default 65536, 0 to disable")
          ("api-limit-get-account-history-operations",boost::program_options::value<uint64_t>()->default_value(100),
           "For history_api::get_account_history_operations to set its default limit value as 100")
          ("api-limit-get-account-history",boost::program_options::value<uint64_t>()->default_value(100),
@@ -1044,12 +1446,27 @@ void application::set_program_options(boost::program_options::options_descriptio
           "For database_api_impl::get_limit_orders to set its default limit value as 300")
          ("api-limit-get-order-book",boost::program_options::value<uint64_t>()->default_value(50),
           "For database_api_impl::get_order_book to set its default limit value as 50")
+         ("api-limit-get-object-digests",boost::program_options::value<uint64_t>()->default_value(0),
+          "For database_api_impl::get_object_digests to set the maximum number of object instances hashed by one "
+          "call, 0 disables the call")
+         ("api-limit-get-changed-objects",boost::program_options::value<uint64_t>()->default_value(1000),
+          "For database_api_impl::get_objects_changed_since to set the maximum number of object instances examined "
+          "by one call")
+         ("api-limit-stream-blocks",boost::program_options::value<uint64_t>()->default_value(10000),
+          "For block_api::stream_blocks to set the maximum number of blocks sent by one call")
+         ("api-limit-block-streams",boost::program_options::value<uint64_t>()->default_value(4),
+          "For block_api::stream_blocks to set the maximum number of streams running at a time on one connection")
+         ("api-limit-get-applied-operations",boost::program_options::value<uint64_t>()->default_value(100),
+          "For block_api::get_applied_operations to set the maximum number of blocks returned by one call")
          ;
    command_line_options.add(configuration_file_options);
    command_line_options.add_options()
          ("replay-blockchain", "Rebuild object graph by replaying all blocks without validation")
          ("revalidate-blockchain", "Rebuild object graph by replaying all blocks with full validation")
          ("resync-blockchain", "Delete all blocks and re-sync with network from scratch")
+         ("load-snapshot", bpo::value<boost::filesystem::path>(),
+          "Delete all blocks and the object database, and continue from the binary snapshot in the given directory, "
+          "see snapshot-format of the snapshot plugin")
          ("force-validate", "Force validation of all transactions during normal operation")
          ("genesis-timestamp", bpo::value<uint32_t>(),
           "Replace timestamp from genesis.json with current time plus this many seconds (experts only!)")
@@ -1068,6 +1485,13 @@ void application::initialize(const fc::path& data_dir, const boost::program_opti
       const uint16_t num_threads = options["io-threads"].as<uint16_t>();
       fc::asio::default_io_service_scope::set_num_threads(num_threads);
    }
+
+   if( options.count("api-worker-threads") )
+   {
+      const uint16_t num_threads = options["api-worker-threads"].as<uint16_t>();
+      for( uint16_t i = 0; i < num_threads; ++i )
+         my->_api_worker_threads.push_back( std::make_shared<fc::thread>( "api worker " + std::to_string(i) ) );
+   }
 }
 
 void application::startup()
@@ -1115,6 +1539,45 @@ std::shared_ptr<chain::database> application::chain_database() const
    return my->_chain_db;
 }
 
+std::shared_ptr<full_account_cache> application::get_full_account_cache() const
+{
+   return my->_full_account_cache;
+}
+
+std::shared_ptr<subscription_registry> application::get_subscription_registry() const
+{
+   return my->_subscription_registry;
+}
+
+std::shared_ptr<api_profiler> application::get_api_profiler() const
+{
+   return my->_api_profiler;
+}
+
+std::shared_ptr<block_tracer> application::get_block_tracer() const
+{
+   return my->_block_tracer;
+}
+
+std::shared_ptr<api_rate_limiter> application::get_api_rate_limiter() const
+{
+   return my->_api_rate_limiter;
+}
+
+void application::run_api_batch( const std::function<void()>& batch )
+{
+   chain::database::read_scope scope( *my->_chain_db );
+   batch();
+}
+
+std::shared_ptr<fc::thread> application::next_api_worker_thread()
+{
+   if( my->_api_worker_threads.empty() )
+      return std::shared_ptr<fc::thread>();
+   const size_t index = my->_next_api_worker_thread++ % my->_api_worker_threads.size();
+   return my->_api_worker_threads[index];
+}
+
 void application::set_block_production(bool producing_blocks)
 {
    my->_is_block_producer = producing_blocks;
@@ -1130,6 +1593,16 @@ void application::set_api_access_info(const string& username, api_access_info&&
    my->set_api_access_info(username, std::move(permissions));
 }
 
+void application::push_transaction( const chain::precomputable_transaction& trx )
+{
+   // the precomputation yields, the fibers that would apply blocks meanwhile can not while the scope is active
+   FC_ASSERT( !my->_chain_db->in_read_scope(), "Transactions can not be pushed in an API batch" );
+   // the checks of database::push_transaction that need no pending state
+   if( my->_relay_only )
+      my->_chain_db->precheck_transaction( trx );
+   my->push_transaction( trx );
+}
+
 bool application::is_finished_syncing() const
 {
    return my->_is_finished_syncing;
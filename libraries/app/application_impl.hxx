@@ -9,6 +9,9 @@
 #include <graphene/protocol/types.hpp>
 #include <graphene/net/message.hpp>
 
+#include <map>
+#include <unordered_set>
+
 namespace graphene { namespace app { namespace detail {
 
 
@@ -42,6 +45,7 @@ class application_impl : public net::node_delegate
 
       void set_dbg_init_key( graphene::chain::genesis_state_type& genesis, const std::string& init_key );
       void set_api_limit();
+      void set_api_rate_limit();
 
       void startup();
 
@@ -54,6 +58,11 @@ class application_impl : public net::node_delegate
        */
       virtual bool has_item(const net::item_id& id) override;
 
+      /**
+       * Answers for blocks in the block database, which can be read while a block is being applied.
+       */
+      virtual bool has_item_concurrently(const net::item_id& id) override;
+
       /**
        * @brief allows the application to validate an item prior to broadcasting to peers.
        *
@@ -64,6 +73,9 @@ class application_impl : public net::node_delegate
        */
       virtual bool handle_block(const graphene::net::block_message& blk_msg, bool sync_mode,
                                 std::vector<fc::uint160_t>& contained_transaction_message_ids) override;
+      /// Records the stages of handling block in the block tracer, if block was applied on top of the head block
+      void trace_block( const graphene::chain::signed_block& block, fc::time_point start,
+                        fc::time_point precomputed, fc::time_point push_start )const;
 
       virtual void handle_transaction(const graphene::net::trx_message& transaction_message) override;
 
@@ -89,6 +101,11 @@ class application_impl : public net::node_delegate
        */
       virtual graphene::net::message get_item(const graphene::net::item_id& id) override;
 
+      /**
+       * Serves blocks from the block database, which can be read while a block is being applied.
+       */
+      virtual fc::optional<graphene::net::message> get_item_concurrently(const graphene::net::item_id& id) override;
+
       virtual graphene::chain::chain_id_type get_chain_id()const override;
 
       /**
@@ -189,14 +206,40 @@ class application_impl : public net::node_delegate
       api_access _apiaccess;
 
       std::shared_ptr<graphene::chain::database>            _chain_db;
+      /// Declared after _chain_db so that they disconnect from the database signals first
+      std::shared_ptr<full_account_cache>                   _full_account_cache;
+      std::shared_ptr<subscription_registry>                _subscription_registry;
+      std::shared_ptr<api_profiler>                         _api_profiler;
+      std::shared_ptr<block_tracer>                         _block_tracer;
+      std::shared_ptr<api_rate_limiter>                     _api_rate_limiter;
+      /// The request header holding the address of a client, set by a proxy
+      std::string                                           _api_rate_limit_address_header;
       std::shared_ptr<graphene::net::node>                  _p2p_network;
       std::shared_ptr<fc::http::websocket_server>      _websocket_server;
       std::shared_ptr<fc::http::websocket_tls_server>  _websocket_tls_server;
 
+      /// Threads running read-only API calls, used in turn
+      std::vector<std::shared_ptr<fc::thread>>  _api_worker_threads;
+      size_t                                    _next_api_worker_thread = 0;
+
       std::map<string, std::shared_ptr<abstract_plugin>> _active_plugins;
       std::map<string, std::shared_ptr<abstract_plugin>> _available_plugins;
 
       bool _is_finished_syncing = false;
+
+      /// Transactions are only checked and relayed, not applied to the pending state
+      bool _relay_only = false;
+      /// In relay-only mode, turn away transactions that were relayed before and did not expire yet
+      bool _relay_dupe_filter = true;
+      /// IDs of the transactions relayed in relay-only mode
+      std::unordered_set<graphene::chain::transaction_id_type, std::hash<fc::ripemd160>> _relayed_trx_ids;
+      /// Expiration times of the transactions in _relayed_trx_ids, to remove them again
+      std::multimap<fc::time_point_sec, graphene::chain::transaction_id_type> _relayed_trx_expirations;
+
+      /// @see application::push_transaction, the caller has to do database::precheck_transaction in relay-only mode
+      void push_transaction( const graphene::chain::precomputable_transaction& trx );
+      /// Remembers trx in the duplicate filter of relay-only mode, rejects it if it is in the filter already
+      void remember_relayed_transaction( const graphene::chain::precomputable_transaction& trx );
    private:
       fc::serial_valve valve;
    };
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/block_tracer.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/reflect/variant.hpp>
+
+#include <algorithm>
+#include <array>
+
+namespace graphene { namespace app {
+
+namespace {
+   /// The upper bounds of the latency histogram buckets but the last, in microseconds
+   const std::array<int64_t, block_tracer::histogram_buckets - 1> histogram_bounds_us =
+         {{ 100, 1000, 10000, 100000, 1000000 }};
+
+   struct trace_stage
+   {
+      const char*           name;
+      int64_t block_trace::* duration;
+   };
+
+   /// The stages in the order they run, the stages from header to undo make up push_block
+   const std::array<trace_stage, 13> stages = {{
+      { "delay",           &block_trace::delay_us },
+      { "precompute",      &block_trace::precompute_us },
+      { "queue",           &block_trace::queue_us },
+      { "header",          &block_trace::header_us },
+      { "transactions",    &block_trace::transactions_us },
+      { "block_updates",   &block_trace::block_updates_us },
+      { "maintenance",     &block_trace::maintenance_us },
+      { "expiry",          &block_trace::expiry_us },
+      { "batched_indexes", &block_trace::batched_indexes_us },
+      { "applied_block",   &block_trace::applied_block_us },
+      { "changed_objects", &block_trace::changed_objects_us },
+      { "undo",            &block_trace::undo_us },
+      { "total",           &block_trace::total_us }
+   }};
+   const size_t first_push_stage = 3;
+   const size_t last_push_stage = 11;
+}
+
+block_tracer::block_tracer( uint32_t window, uint32_t slow_block_threshold_ms, const fc::path& trace_file )
+   : _window( std::max<uint32_t>( window, 1 ) ),
+     _slow_block_threshold_us( int64_t(slow_block_threshold_ms) * 1000 )
+{
+   if( trace_file.empty() )
+      return;
+   _trace_file.open( trace_file.generic_string(), std::ofstream::out | std::ofstream::trunc );
+   FC_ASSERT( _trace_file.good(), "Unable to open the block trace file ${f}", ("f",trace_file) );
+   // the closing bracket of the JSON array format of trace events is optional, so the file is valid at any time
+   _trace_file << "[\n";
+   _trace_file.flush();
+}
+
+block_tracer::~block_tracer()
+{
+   if( _trace_file.is_open() )
+      _trace_file.close();
+}
+
+void block_tracer::record( const block_trace& trace )
+{
+   if( _slow_block_threshold_us > 0 && trace.total_us >= _slow_block_threshold_us )
+      wlog( "Block #${n} with ${x} transaction(s) took ${t} ms to handle: ${trace}",
+            ("n",trace.block_num)("x",trace.transactions)("t",trace.total_us / 1000)("trace",trace) );
+
+   std::lock_guard<std::mutex> guard( _mutex );
+   _blocks.push_back( trace );
+   if( _blocks.size() > _window )
+      _blocks.pop_front();
+   if( _trace_file.is_open() )
+      write_trace_events( trace );
+}
+
+void block_tracer::write_trace_events( const block_trace& trace )
+{
+   const auto event = [this,&trace]( const char* name, int64_t ts, int64_t dur ) {
+      _trace_file << "{\"name\":\"" << name << "\",\"cat\":\"block\",\"ph\":\"X\",\"ts\":" << ts
+                  << ",\"dur\":" << dur << ",\"pid\":1,\"tid\":1,\"args\":{\"block_num\":" << trace.block_num
+                  << ",\"transactions\":" << trace.transactions << "}},\n";
+   };
+   int64_t ts = trace.start.time_since_epoch().count();
+   event( "handle_block", ts, trace.total_us );
+   event( "precompute", ts, trace.precompute_us );
+   ts += trace.precompute_us;
+   event( "queue", ts, trace.queue_us );
+   ts += trace.queue_us;
+   event( "push_block", ts, trace.total_us - trace.precompute_us - trace.queue_us );
+   for( size_t i = first_push_stage; i <= last_push_stage; ++i )
+   {
+      const int64_t dur = trace.*stages[i].duration;
+      if( dur <= 0 )
+         continue;
+      event( stages[i].name, ts, dur );
+      ts += dur;
+   }
+   _trace_file.flush();
+}
+
+std::vector<block_stage_statistics> block_tracer::get_statistics()const
+{
+   std::vector<block_stage_statistics> result;
+   result.reserve( stages.size() );
+   std::lock_guard<std::mutex> guard( _mutex );
+   for( const trace_stage& stage : stages )
+   {
+      block_stage_statistics stats;
+      stats.stage = stage.name;
+      stats.blocks = _blocks.size();
+      stats.latency_histogram.resize( histogram_buckets );
+      int64_t total_us = 0;
+      for( const block_trace& trace : _blocks )
+      {
+         const int64_t us = trace.*stage.duration;
+         size_t bucket = 0;
+         while( bucket < histogram_bounds_us.size() && us >= histogram_bounds_us[bucket] )
+            ++bucket;
+         ++stats.latency_histogram[bucket];
+         total_us += us;
+         stats.max_us = std::max( stats.max_us, us );
+      }
+      if( !_blocks.empty() )
+         stats.average_us = total_us / int64_t( _blocks.size() );
+      result.push_back( std::move( stats ) );
+   }
+   return result;
+}
+
+std::vector<block_trace> block_tracer::get_recent_blocks( uint32_t limit )const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   const size_t count = std::min<size_t>( limit, _blocks.size() );
+   return std::vector<block_trace>( _blocks.rbegin(), _blocks.rbegin() + count );
+}
+
+void block_tracer::reset()
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   _blocks.clear();
+}
+
+} } // graphene::app
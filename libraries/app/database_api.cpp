@@ -46,34 +46,23 @@ namespace graphene { namespace app {
 //                                                                  //
 //////////////////////////////////////////////////////////////////////
 
-database_api::database_api( graphene::chain::database& db, const application_options* app_options )
-   : my( new database_api_impl( db, app_options ) ) {}
+database_api::database_api( graphene::chain::database& db, const application_options* app_options,
+                            std::shared_ptr<full_account_cache> full_accounts,
+                            std::shared_ptr<subscription_registry> subscriptions )
+   : my( new database_api_impl( db, app_options, std::move(full_accounts), std::move(subscriptions) ) ) {}
 
 database_api::~database_api() {}
 
-database_api_impl::database_api_impl( graphene::chain::database& db, const application_options* app_options )
-:_db(db), _app_options(app_options)
+database_api_impl::database_api_impl( graphene::chain::database& db, const application_options* app_options,
+                                      std::shared_ptr<full_account_cache> full_accounts,
+                                      std::shared_ptr<subscription_registry> subscriptions )
+:_db(db), _app_options(app_options), _full_account_cache(std::move(full_accounts)),
+ _subscriptions(std::move(subscriptions))
 {
    dlog("creating database api ${x}", ("x",int64_t(this)) );
-   _new_connection = _db.new_objects.connect([this](const vector<object_id_type>& ids,
-                                                    const flat_set<account_id_type>& impacted_accounts) {
-                                on_objects_new(ids, impacted_accounts);
-                                });
-   _change_connection = _db.changed_objects.connect([this](const vector<object_id_type>& ids,
-                                                           const flat_set<account_id_type>& impacted_accounts) {
-                                on_objects_changed(ids, impacted_accounts);
-                                });
-   _removed_connection = _db.removed_objects.connect([this](const vector<object_id_type>& ids,
-                                                            const vector<const object*>& objs,
-                                                            const flat_set<account_id_type>& impacted_accounts) {
-                                on_objects_removed(ids, objs, impacted_accounts);
-                                });
+   if( !_subscriptions )
+      _subscriptions = std::make_shared<subscription_registry>( _db );
    _applied_block_connection = _db.applied_block.connect([this](const signed_block&){ on_applied_block(); });
-
-   _pending_trx_connection = _db.on_pending_transaction.connect([this](const signed_transaction& trx ){
-                                if( _pending_trx_callback )
-                                   _pending_trx_callback( fc::variant(trx, GRAPHENE_MAX_NESTED_OBJECTS) );
-                      });
    try
    {
       amount_in_collateral_index = &_db.get_index_type< primary_index< call_order_index > >()
@@ -88,6 +77,7 @@ database_api_impl::database_api_impl( graphene::chain::database& db, const appli
 database_api_impl::~database_api_impl()
 {
    dlog("freeing database api ${x}", ("x",int64_t(this)) );
+   _subscriptions->remove_session( this );
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -122,6 +112,108 @@ fc::variants database_api_impl::get_objects( const vector<object_id_type>& ids,
    return result;
 }
 
+vector<versioned_object> database_api::get_objects_if_changed( const vector<object_id_type>& ids,
+                                                              const vector<uint64_t>& known_versions,
+                                                              optional<bool> subscribe )const
+{
+   return my->get_objects_if_changed( ids, known_versions, subscribe );
+}
+
+vector<versioned_object> database_api_impl::get_objects_if_changed( const vector<object_id_type>& ids,
+                                                                   const vector<uint64_t>& known_versions,
+                                                                   optional<bool> subscribe )const
+{
+   bool to_subscribe = get_whether_to_subscribe( subscribe );
+
+   vector<versioned_object> result;
+   result.reserve( ids.size() );
+   for( size_t i = 0; i < ids.size(); ++i )
+   {
+      const object_id_type id = ids[i];
+      const object* obj = _db.find_object( id );
+      if( obj != nullptr && to_subscribe
+            && !id.is<operation_history_id_type>() && !id.is<account_transaction_history_id_type>() )
+         subscribe_to_item( id );
+      result.push_back( get_versioned_object( obj, i < known_versions.size() ? known_versions[i] : 0 ) );
+   }
+   return result;
+}
+
+fc::variants database_api::get_objects_at_head_block( const vector<object_id_type>& ids )const
+{
+   return my->get_objects_at_head_block( ids );
+}
+
+fc::variants database_api_impl::get_objects_at_head_block( const vector<object_id_type>& ids )const
+{
+   fc::variants result;
+   result.reserve(ids.size());
+
+   unique_ptr<object> holder;
+   for( const object_id_type& id : ids )
+   {
+      const object* obj = _db.find_object_at_head_block( id, holder );
+      result.push_back( obj != nullptr ? obj->to_variant() : fc::variant() );
+   }
+
+   return result;
+}
+
+vector<object_range_digest> database_api::get_object_digests( uint8_t space_id, uint8_t type_id, uint64_t first,
+                                                              uint64_t last, uint32_t parts )const
+{
+   return my->get_object_digests( space_id, type_id, first, last, parts );
+}
+
+vector<object_range_digest> database_api_impl::get_object_digests( uint8_t space_id, uint8_t type_id, uint64_t first,
+                                                                   uint64_t last, uint32_t parts )const
+{
+   FC_ASSERT( parts <= 256 );
+   const graphene::db::index& idx = _db.get_index( space_id, type_id );
+   const uint64_t end = ( last == 0 ? idx.get_next_id().instance() : last );
+   FC_ASSERT( end <= first || end - first <= _app_options->api_limit_get_object_digests,
+              "The range exceeds api-limit-get-object-digests" );
+
+   unique_ptr<object> holder;
+   return idx.digest_ranges( first, end, parts, [this,&holder]( object_id_type id ) {
+      return _db.find_object_at_head_block( id, holder );
+   });
+}
+
+changed_objects database_api::get_objects_changed_since( uint8_t space_id, uint8_t type_id, uint64_t first,
+                                                         uint64_t last, uint32_t since )const
+{
+   return my->get_objects_changed_since( space_id, type_id, first, last, since );
+}
+
+changed_objects database_api_impl::get_objects_changed_since( uint8_t space_id, uint8_t type_id, uint64_t first,
+                                                              uint64_t last, uint32_t since )const
+{
+   const graphene::db::index& idx = _db.get_index( space_id, type_id );
+   const uint64_t end = ( last == 0 ? idx.get_next_id().instance() : last );
+   const uint64_t limit = _app_options->api_limit_get_changed_objects;
+
+   changed_objects result;
+   result.stamp = _db.get_modification_stamp();
+   unique_ptr<object> holder;
+   uint64_t instance = first;
+   for( ; instance < end && instance - first < limit; ++instance )
+   {
+      const object_id_type id( space_id, type_id, instance );
+      // the stamp of the current object is at least the one of its state at the head block; objects removed by
+      // pending transactions are reported, as their stamp is not known
+      const object* current = _db.find_object( id );
+      if( current != nullptr && _db.get_modification_stamp( *current ) <= since )
+         continue;
+      const object* at_head = _db.find_object_at_head_block( id, holder );
+      if( at_head != nullptr )
+         result.objects.push_back( at_head->to_variant() );
+   }
+   if( instance < end )
+      result.next_instance = instance;
+   return result;
+}
+
 //////////////////////////////////////////////////////////////////////
 //                                                                  //
 // Subscriptions                                                    //
@@ -145,6 +237,7 @@ void database_api_impl::set_subscribe_callback( std::function<void(const variant
 
    _subscribe_callback = cb;
    _notify_remove_create = notify_remove_create;
+   _subscriptions->set_notify_remove_create( this, notify_remove_create );
 }
 
 void database_api::set_auto_subscription( bool enable )
@@ -157,14 +250,17 @@ void database_api_impl::set_auto_subscription( bool enable )
    _enabled_auto_subscription = enable;
 }
 
-void database_api::set_pending_transaction_callback( std::function<void(const variant&)> cb )
+void database_api::set_pending_transaction_callback( std::function<void(const variant&)> cb,
+                                                     optional<pending_transaction_filter> filter )
 {
-   my->set_pending_transaction_callback( cb );
+   my->set_pending_transaction_callback( cb, filter );
 }
 
-void database_api_impl::set_pending_transaction_callback( std::function<void(const variant&)> cb )
+void database_api_impl::set_pending_transaction_callback( std::function<void(const variant&)> cb,
+                                                          const optional<pending_transaction_filter>& filter )
 {
    _pending_trx_callback = cb;
+   _subscriptions->set_pending_transaction_subscriber( this, bool(cb), filter );
 }
 
 void database_api::set_block_applied_callback( std::function<void(const variant& block_id)> cb )
@@ -177,6 +273,24 @@ void database_api_impl::set_block_applied_callback( std::function<void(const var
    _block_applied_callback = cb;
 }
 
+void database_api::set_applied_operations_callback( std::function<void(const variant&)> cb,
+                                                    optional<uint32_t> start_block_num )
+{
+   my->set_applied_operations_callback( cb, start_block_num );
+}
+
+void database_api_impl::set_applied_operations_callback( std::function<void(const variant&)> cb,
+                                                         optional<uint32_t> start_block_num )
+{
+   vector<variant> missed;
+   if( cb && start_block_num.valid() )
+      missed = _subscriptions->get_applied_operations( *start_block_num );
+   _applied_operations_callback = cb;
+   _subscriptions->set_applied_operations_subscriber( this, bool(cb) );
+   for( const variant& notice : missed )
+      on_applied_operations( notice );
+}
+
 void database_api::cancel_all_subscriptions()
 {
    my->cancel_all_subscriptions(true, true);
@@ -188,12 +302,16 @@ void database_api_impl::cancel_all_subscriptions( bool reset_callback, bool rese
       _subscribe_callback = std::function<void(const fc::variant&)>();
 
    if ( reset_market_subscriptions )
+   {
       _market_subscriptions.clear();
+      _subscriptions->unsubscribe_from_all_markets( this );
+      _market_depth_subscriptions.clear();
+      _subscriptions->unsubscribe_from_all_market_depths( this );
+   }
 
    _notify_remove_create = false;
    _subscribed_accounts.clear();
-   static fc::bloom_parameters param(10000, 1.0/100, 1024*8*8*2);
-   _subscribe_filter = fc::bloom_filter(param);
+   _subscriptions->unsubscribe_all( this );
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -209,10 +327,7 @@ optional<block_header> database_api::get_block_header(uint32_t block_num)const
 
 optional<block_header> database_api_impl::get_block_header(uint32_t block_num) const
 {
-   auto result = _db.fetch_block_by_number(block_num);
-   if(result)
-      return *result;
-   return {};
+   return _db.fetch_block_header_by_number(block_num);
 }
 map<uint32_t, optional<block_header>> database_api::get_block_header_batch(const vector<uint32_t> block_nums)const
 {
@@ -237,6 +352,9 @@ optional<signed_block> database_api::get_block(uint32_t block_num)const
 
 optional<signed_block> database_api_impl::get_block(uint32_t block_num)const
 {
+   FC_ASSERT( block_num == 0 || block_num >= _db.first_available_block_num(),
+              "Block ${n} has been pruned, this node only keeps blocks since ${f}",
+              ("n",block_num)("f",_db.first_available_block_num()) );
    return _db.fetch_block_by_number(block_num);
 }
 
@@ -318,6 +436,49 @@ dynamic_global_property_object database_api_impl::get_dynamic_global_properties(
    return _db.get(dynamic_global_property_id_type());
 }
 
+vector<graphene::db::index_memory_usage> database_api::get_index_memory_usage()const
+{
+   return my->get_index_memory_usage();
+}
+
+vector<graphene::db::index_memory_usage> database_api_impl::get_index_memory_usage()const
+{
+   return _db.get_memory_usage();
+}
+
+vector<maintenance_timing> database_api::get_maintenance_timings()const
+{
+   return my->get_maintenance_timings();
+}
+
+vector<maintenance_timing> database_api_impl::get_maintenance_timings()const
+{
+   const auto& timings = _db.get_maintenance_timings();
+   return vector<maintenance_timing>( timings.begin(), timings.end() );
+}
+
+graphene::db::undo_history_usage database_api::get_undo_history_usage()const
+{
+   return my->get_undo_history_usage();
+}
+
+graphene::db::undo_history_usage database_api_impl::get_undo_history_usage()const
+{
+   return _db.get_undo_history_usage();
+}
+
+full_account_cache_statistics database_api::get_full_account_cache_statistics()const
+{
+   return my->get_full_account_cache_statistics();
+}
+
+full_account_cache_statistics database_api_impl::get_full_account_cache_statistics()const
+{
+   if( !_full_account_cache )
+      return full_account_cache_statistics();
+   return _full_account_cache->get_statistics();
+}
+
 //////////////////////////////////////////////////////////////////////
 //                                                                  //
 // Keys                                                             //
@@ -336,6 +497,7 @@ vector<flat_set<account_id_type>> database_api_impl::get_key_references( vector<
 {
    uint64_t api_limit_get_key_references=_app_options->api_limit_get_key_references;
    FC_ASSERT(keys.size() <= api_limit_get_key_references);
+   _db.apply_batched_index_changes();
    const auto& idx = _db.get_index_type<account_index>();
    const auto& aidx = dynamic_cast<const base_primary_index&>(idx);
    const auto& refs = aidx.get_secondary_index<graphene::chain::account_member_index>();
@@ -398,6 +560,7 @@ bool database_api_impl::is_public_key_registered(string public_key) const
         // An invalid public key was detected
         return false;
     }
+    _db.apply_batched_index_changes();
     const auto& idx = _db.get_index_type<account_index>();
     const auto& aidx = dynamic_cast<const base_primary_index&>(idx);
     const auto& refs = aidx.get_secondary_index<graphene::chain::account_member_index>();
@@ -442,6 +605,31 @@ vector<optional<account_object>> database_api_impl::get_accounts( const vector<s
    return result;
 }
 
+vector<versioned_object> database_api::get_accounts_if_changed( const vector<std::string>& account_names_or_ids,
+                                                               const vector<uint64_t>& known_versions,
+                                                               optional<bool> subscribe )const
+{
+   return my->get_accounts_if_changed( account_names_or_ids, known_versions, subscribe );
+}
+
+vector<versioned_object> database_api_impl::get_accounts_if_changed(
+      const vector<std::string>& account_names_or_ids,
+      const vector<uint64_t>& known_versions,
+      optional<bool> subscribe )const
+{
+   bool to_subscribe = get_whether_to_subscribe( subscribe );
+   vector<versioned_object> result;
+   result.reserve( account_names_or_ids.size() );
+   for( size_t i = 0; i < account_names_or_ids.size(); ++i )
+   {
+      const account_object* account = get_account_from_string( account_names_or_ids[i], false );
+      if( account != nullptr && to_subscribe )
+         subscribe_to_item( account->id );
+      result.push_back( get_versioned_object( account, i < known_versions.size() ? known_versions[i] : 0 ) );
+   }
+   return result;
+}
+
 std::map<string,full_account> database_api::get_full_accounts( const vector<string>& names_or_ids,
                                                                optional<bool> subscribe )
 {
@@ -470,10 +658,24 @@ std::map<std::string, full_account> database_api_impl::get_full_accounts( const
       {
          if(_subscribed_accounts.size() < 100) {
             _subscribed_accounts.insert( account->get_id() );
+            _subscriptions->subscribe_to_account( this, account->get_id() );
             subscribe_to_item( account->id );
          }
       }
 
+      if( _full_account_cache )
+      {
+         const full_account* cached = _full_account_cache->find( account->get_id() );
+         if( cached != nullptr )
+         {
+            full_account acnt = *cached;
+            acnt.votes = lookup_vote_ids( vector<vote_id_type>( account->options.votes.begin(),
+                                                                account->options.votes.end() ) );
+            results[account_name_or_id] = std::move( acnt );
+            continue;
+         }
+      }
+
       full_account acnt;
       acnt.account = *account;
       acnt.statistics = account->statistics(_db);
@@ -614,6 +816,8 @@ std::map<std::string, full_account> database_api_impl::get_full_accounts( const
          acnt.htlcs_to.emplace_back(*itr);
       }
 
+      if( _full_account_cache )
+         _full_account_cache->insert( acnt );
       results[account_name_or_id] = acnt;
    }
    return results;
@@ -626,7 +830,7 @@ optional<account_object> database_api::get_account_by_name( string name )const
 
 optional<account_object> database_api_impl::get_account_by_name( string name )const
 {
-   const auto& idx = _db.get_index_type<account_index>().indices().get<by_name>();
+   const auto& idx = _db.get_index_type<account_index>().indices().get<by_exact_name>();
    auto itr = idx.find(name);
    if (itr != idx.end())
       return *itr;
@@ -640,6 +844,7 @@ vector<account_id_type> database_api::get_account_references( const std::string
 
 vector<account_id_type> database_api_impl::get_account_references( const std::string account_id_or_name )const
 {
+   _db.apply_batched_index_changes();
    const auto& idx = _db.get_index_type<account_index>();
    const auto& aidx = dynamic_cast<const base_primary_index&>(idx);
    const auto& refs = aidx.get_secondary_index<graphene::chain::account_member_index>();
@@ -662,7 +867,7 @@ vector<optional<account_object>> database_api::lookup_account_names(const vector
 
 vector<optional<account_object>> database_api_impl::lookup_account_names(const vector<string>& account_names)const
 {
-   const auto& accounts_by_name = _db.get_index_type<account_index>().indices().get<by_name>();
+   const auto& accounts_by_name = _db.get_index_type<account_index>().indices().get<by_exact_name>();
    vector<optional<account_object> > result;
    result.reserve(account_names.size());
    std::transform(account_names.begin(), account_names.end(), std::back_inserter(result),
@@ -704,6 +909,19 @@ map<string,account_id_type> database_api_impl::lookup_accounts( const string& lo
    return result;
 }
 
+map<string,account_id_type> database_api::lookup_accounts_by_prefix( const string& prefix, uint32_t limit )const
+{
+   return my->lookup_accounts_by_prefix( prefix, limit );
+}
+
+map<string,account_id_type> database_api_impl::lookup_accounts_by_prefix( const string& prefix,
+                                                                          uint32_t limit )const
+{
+   FC_ASSERT( limit <= 1000 );
+   const auto& accounts_by_name = _db.get_index_type<account_index>().indices().get<by_name>();
+   return lookup_names_by_prefix( accounts_by_name, &account_object::name, prefix, limit );
+}
+
 uint64_t database_api::get_account_count()const
 {
    return my->get_account_count();
@@ -863,6 +1081,21 @@ vector<optional<extended_asset_object>> database_api_impl::get_assets(
    return result;
 }
 
+map<string,asset_id_type> database_api::lookup_asset_symbols_by_prefix( const string& prefix, uint32_t limit )const
+{
+   return my->lookup_asset_symbols_by_prefix( prefix, limit );
+}
+
+map<string,asset_id_type> database_api_impl::lookup_asset_symbols_by_prefix( const string& prefix,
+                                                                            uint32_t limit )const
+{
+   uint64_t api_limit_get_assets = _app_options->api_limit_get_assets;
+   FC_ASSERT( limit <= api_limit_get_assets );
+
+   const auto& assets_by_symbol = _db.get_index_type<asset_index>().indices().get<by_symbol>();
+   return lookup_names_by_prefix( assets_by_symbol, &asset_object::symbol, prefix, limit );
+}
+
 vector<extended_asset_object> database_api::list_assets(const string& lower_bound_symbol, uint32_t limit)const
 {
    return my->list_assets( lower_bound_symbol, limit );
@@ -932,7 +1165,7 @@ vector<optional<extended_asset_object>> database_api::lookup_asset_symbols(
 vector<optional<extended_asset_object>> database_api_impl::lookup_asset_symbols(
                                                          const vector<string>& symbols_or_ids )const
 {
-   const auto& assets_by_symbol = _db.get_index_type<asset_index>().indices().get<by_symbol>();
+   const auto& assets_by_symbol = _db.get_index_type<asset_index>().indices().get<by_exact_symbol>();
    vector<optional<extended_asset_object> > result;
    result.reserve(symbols_or_ids.size());
    std::transform(symbols_or_ids.begin(), symbols_or_ids.end(), std::back_inserter(result),
@@ -1070,17 +1303,13 @@ vector<call_order_object> database_api_impl::get_call_orders(const std::string&
    FC_ASSERT( limit <= api_limit_get_call_orders );
 
    const asset_object* mia = get_asset_from_string(a);
-   const auto& call_index = _db.get_index_type<call_order_index>().indices().get<by_collateral>();
-   price index_price = price::min( mia->bitasset_data(_db).options.short_backing_asset, mia->get_id() );
+   const auto& call_book = _db.get_call_order_books().get_book( mia->get_id(),
+                                                                mia->bitasset_data(_db).options.short_backing_asset );
 
    vector< call_order_object> result;
-   auto itr_min = call_index.lower_bound(index_price);
-   auto itr_max = call_index.upper_bound(index_price.max());
-   while( itr_min != itr_max && result.size() < limit )
-   {
-      result.emplace_back(*itr_min);
-      ++itr_min;
-   }
+   result.reserve( std::min<size_t>( limit, call_book.size() ) );
+   for( auto itr = call_book.begin(); itr != call_book.end() && result.size() < limit; ++itr )
+      result.emplace_back( *itr->order );
    return result;
 }
 
@@ -1236,6 +1465,7 @@ void database_api_impl::subscribe_to_market( std::function<void(const variant&)>
    if(asset_a_id > asset_b_id) std::swap(asset_a_id,asset_b_id);
    FC_ASSERT(asset_a_id != asset_b_id);
    _market_subscriptions[ std::make_pair(asset_a_id,asset_b_id) ] = callback;
+   _subscriptions->subscribe_to_market( this, std::make_pair(asset_a_id,asset_b_id) );
 }
 
 void database_api::unsubscribe_from_market(const std::string& a, const std::string& b)
@@ -1248,9 +1478,70 @@ void database_api_impl::unsubscribe_from_market(const std::string& a, const std:
    auto asset_a_id = get_asset_from_string(a)->id;
    auto asset_b_id = get_asset_from_string(b)->id;
 
-   if(a > b) std::swap(asset_a_id,asset_b_id);
+   if(asset_a_id > asset_b_id) std::swap(asset_a_id,asset_b_id);
    FC_ASSERT(asset_a_id != asset_b_id);
    _market_subscriptions.erase(std::make_pair(asset_a_id,asset_b_id));
+   _subscriptions->unsubscribe_from_market( this, std::make_pair(asset_a_id,asset_b_id) );
+}
+
+void database_api::subscribe_to_market_depth( std::function<void(const variant&)> callback,
+                                              const string& base, const string& quote )
+{
+   my->subscribe_to_market_depth( callback, base, quote );
+}
+
+void database_api_impl::subscribe_to_market_depth( std::function<void(const variant&)> callback,
+                                                   const string& base, const string& quote )
+{
+   auto base_quote = std::make_pair( get_asset_from_string(base)->id, get_asset_from_string(quote)->id );
+   FC_ASSERT( base_quote.first != base_quote.second );
+   _market_depth_subscriptions[ base_quote ] = callback;
+   _subscriptions->subscribe_to_market_depth( this, base_quote );
+}
+
+void database_api::unsubscribe_from_market_depth( const string& base, const string& quote )
+{
+   my->unsubscribe_from_market_depth( base, quote );
+}
+
+void database_api_impl::unsubscribe_from_market_depth( const string& base, const string& quote )
+{
+   auto base_quote = std::make_pair( get_asset_from_string(base)->id, get_asset_from_string(quote)->id );
+   _market_depth_subscriptions.erase( base_quote );
+   _subscriptions->unsubscribe_from_market_depth( this, base_quote );
+}
+
+market_depth_snapshot database_api::get_market_depth( const string& base, const string& quote,
+                                                      unsigned limit )const
+{
+   return my->get_market_depth( base, quote, limit );
+}
+
+market_depth_snapshot database_api_impl::get_market_depth( const string& base, const string& quote,
+                                                           unsigned limit )const
+{
+   uint64_t api_limit_get_order_book=_app_options->api_limit_get_order_book;
+   FC_ASSERT( limit <= api_limit_get_order_book );
+
+   const asset_object* base_asset = get_asset_from_string( base );
+   const asset_object* quote_asset = get_asset_from_string( quote );
+   FC_ASSERT( base_asset->id != quote_asset->id );
+   return _subscriptions->get_market_depth( *base_asset, *quote_asset, limit );
+}
+
+vector<market_depth_update> database_api::get_market_depth_updates( const string& base, const string& quote,
+                                                                    uint64_t since_sequence )const
+{
+   return my->get_market_depth_updates( base, quote, since_sequence );
+}
+
+vector<market_depth_update> database_api_impl::get_market_depth_updates( const string& base, const string& quote,
+                                                                         uint64_t since_sequence )const
+{
+   const asset_object* base_asset = get_asset_from_string( base );
+   const asset_object* quote_asset = get_asset_from_string( quote );
+   FC_ASSERT( base_asset->id != quote_asset->id );
+   return _subscriptions->get_market_depth_updates( *base_asset, *quote_asset, since_sequence );
 }
 
 market_ticker database_api::get_ticker( const string& base, const string& quote )const
@@ -1275,12 +1566,8 @@ market_ticker database_api_impl::get_ticker( const string& base, const string& q
    const fc::time_point_sec now = _db.head_block_time();
    if( itr != ticker_idx.end() )
    {
-      order_book orders;
-      if (!skip_order_book)
-      {
-         orders = get_order_book(assets[0]->symbol, assets[1]->symbol, 1);
-      }
-      return market_ticker(*itr, now, *assets[0], *assets[1], orders);
+      const limit_order_book_index* books = skip_order_book ? nullptr : &_db.get_limit_order_books();
+      return market_ticker(*itr, now, *assets[0], *assets[1], books);
    }
    // if no ticker is found for this market we return an empty ticker
    market_ticker empty_result(now, *assets[0], *assets[1]);
@@ -1316,40 +1603,48 @@ order_book database_api_impl::get_order_book( const string& base, const string&
    uint64_t api_limit_get_order_book=_app_options->api_limit_get_order_book;
    FC_ASSERT( limit <= api_limit_get_order_book );
 
-   order_book result;
-   result.base = base;
-   result.quote = quote;
-
    auto assets = lookup_asset_symbols( {base, quote} );
    FC_ASSERT( assets[0], "Invalid base asset symbol: ${s}", ("s",base) );
    FC_ASSERT( assets[1], "Invalid quote asset symbol: ${s}", ("s",quote) );
 
-   auto base_id = assets[0]->id;
-   auto quote_id = assets[1]->id;
-   auto orders = get_limit_orders( base_id, quote_id, limit );
+   return get_order_book( *assets[0], *assets[1], limit );
+}
 
-   for( const auto& o : orders )
+order_book database_api_impl::get_order_book( const asset_object& base, const asset_object& quote, unsigned limit )const
+{
+   order_book result;
+   result.base = base.symbol;
+   result.quote = quote.symbol;
+
+   // Read the books directly, only the orders that are returned get copied into strings
+   const auto& books = _db.get_limit_order_books();
+
+   const auto& bid_book = books.get_book( base.id, quote.id );
+   result.bids.reserve( std::min<size_t>( limit, bid_book.size() ) );
+   for( auto itr = bid_book.begin(); itr != bid_book.end() && result.bids.size() < limit; ++itr )
    {
-      if( o.sell_price.base.asset_id == base_id )
-      {
-         order ord;
-         ord.price = price_to_string( o.sell_price, *assets[0], *assets[1] );
-         ord.quote = assets[1]->amount_to_string( share_type( fc::uint128_t( o.for_sale.value )
-                                                              * o.sell_price.quote.amount.value
-                                                              / o.sell_price.base.amount.value ) );
-         ord.base = assets[0]->amount_to_string( o.for_sale );
-         result.bids.push_back( ord );
-      }
-      else
-      {
-         order ord;
-         ord.price = price_to_string( o.sell_price, *assets[0], *assets[1] );
-         ord.quote = assets[1]->amount_to_string( o.for_sale );
-         ord.base = assets[0]->amount_to_string( share_type( fc::uint128_t( o.for_sale.value )
-                                                             * o.sell_price.quote.amount.value
-                                                             / o.sell_price.base.amount.value ) );
-         result.asks.push_back( ord );
-      }
+      const limit_order_object& o = *itr->order;
+      order ord;
+      ord.price = price_to_string( o.sell_price, base, quote );
+      ord.quote = quote.amount_to_string( share_type( fc::uint128_t( o.for_sale.value )
+                                                      * o.sell_price.quote.amount.value
+                                                      / o.sell_price.base.amount.value ) );
+      ord.base = base.amount_to_string( o.for_sale );
+      result.bids.push_back( ord );
+   }
+
+   const auto& ask_book = books.get_book( quote.id, base.id );
+   result.asks.reserve( std::min<size_t>( limit, ask_book.size() ) );
+   for( auto itr = ask_book.begin(); itr != ask_book.end() && result.asks.size() < limit; ++itr )
+   {
+      const limit_order_object& o = *itr->order;
+      order ord;
+      ord.price = price_to_string( o.sell_price, base, quote );
+      ord.quote = quote.amount_to_string( o.for_sale );
+      ord.base = base.amount_to_string( share_type( fc::uint128_t( o.for_sale.value )
+                                                    * o.sell_price.quote.amount.value
+                                                    / o.sell_price.base.amount.value ) );
+      result.asks.push_back( ord );
    }
 
    return result;
@@ -1371,15 +1666,14 @@ vector<market_ticker> database_api_impl::get_top_markets(uint32_t limit)const
    vector<market_ticker> result;
    result.reserve(limit);
    const fc::time_point_sec now = _db.head_block_time();
+   const limit_order_book_index& books = _db.get_limit_order_books();
 
    while( itr != volume_idx.rend() && result.size() < limit)
    {
-      const asset_object base = itr->base(_db);
-      const asset_object quote = itr->quote(_db);
-      order_book orders;
-      orders = get_order_book(base.symbol, quote.symbol, 1);
+      const asset_object& base = itr->base(_db);
+      const asset_object& quote = itr->quote(_db);
 
-      result.emplace_back(market_ticker(*itr, now, base, quote, orders));
+      result.emplace_back(market_ticker(*itr, now, base, quote, &books));
       ++itr;
    }
    return result;
@@ -1394,6 +1688,82 @@ vector<market_trade> database_api::get_trade_history( const string& base,
    return my->get_trade_history( base, quote, start, stop, limit );
 }
 
+/**
+ * Turns the order history objects of a market into market trades, shared by get_trade_history() and
+ * get_trade_history_by_sequence(). The fills of a trade usually share the price of the previous trade,
+ * so the last price string is kept instead of formatting it again.
+ */
+struct market_trade_formatter
+{
+   market_trade_formatter( const asset_object& _base, const asset_object& _quote )
+      : base(_base), quote(_quote),
+        base_id( std::min( _base.id, _quote.id ) ), quote_id( std::max( _base.id, _quote.id ) )
+   {}
+
+   /** @return whether next is the other direction of the same trade as o */
+   bool is_other_direction( const order_history_object& o, const order_history_object& next )const
+   {
+      // Trades are usually tracked in each direction, exception: for global settlement only one side is recorded
+      return next.key.base == base_id && next.key.quote == quote_id // FIXME not 100% sure
+             && next.time == o.time && next.op.is_maker != o.op.is_maker;
+   }
+
+   /** Formats the trade at itr, and moves itr to its other direction if it is recorded */
+   template<typename Iterator>
+   market_trade format( Iterator& itr, const Iterator& end )
+   {
+      market_trade trade;
+
+      if( base.id == itr->op.receives.asset_id )
+      {
+         trade.amount = quote.amount_to_string( itr->op.pays );
+         trade.value = base.amount_to_string( itr->op.receives );
+      }
+      else
+      {
+         trade.amount = quote.amount_to_string( itr->op.receives );
+         trade.value = base.amount_to_string( itr->op.pays );
+      }
+
+      trade.date = itr->time;
+      if( !last_price.valid() || !( *last_price == itr->op.fill_price ) )
+      {
+         last_price = itr->op.fill_price;
+         last_price_string = price_to_string( *last_price, base, quote );
+      }
+      trade.price = last_price_string;
+
+      set_side( trade, *itr );
+      auto next_itr = std::next(itr);
+      if( next_itr != end && is_other_direction( *itr, *next_itr ) )
+      {
+         set_side( trade, *next_itr );
+         // skip the other direction
+         itr = next_itr;
+      }
+      return trade;
+   }
+
+   static void set_side( market_trade& trade, const order_history_object& o )
+   {
+      if( o.op.is_maker )
+      {
+         trade.sequence = -o.key.sequence;
+         trade.side1_account_id = o.op.account_id;
+      }
+      else
+         trade.side2_account_id = o.op.account_id;
+   }
+
+   const asset_object& base;
+   const asset_object& quote;
+   /// the assets of the market, ordered by id
+   const asset_id_type base_id;
+   const asset_id_type quote_id;
+   optional<price> last_price;
+   string last_price_string;
+};
+
 vector<market_trade> database_api_impl::get_trade_history( const string& base,
                                                            const string& quote,
                                                            fc::time_point_sec start,
@@ -1408,67 +1778,23 @@ vector<market_trade> database_api_impl::get_trade_history( const string& base,
    FC_ASSERT( assets[0], "Invalid base asset symbol: ${s}", ("s",base) );
    FC_ASSERT( assets[1], "Invalid quote asset symbol: ${s}", ("s",quote) );
 
-   auto base_id = assets[0]->id;
-   auto quote_id = assets[1]->id;
-
-   if( base_id > quote_id ) std::swap( base_id, quote_id );
+   market_trade_formatter formatter( *assets[0], *assets[1] );
+   const auto base_id = formatter.base_id;
+   const auto quote_id = formatter.quote_id;
 
    if ( start.sec_since_epoch() == 0 )
       start = fc::time_point_sec( fc::time_point::now() );
 
-   uint32_t count = 0;
    const auto& history_idx = _db.get_index_type<market_history::history_index>().indices().get<by_market_time>();
    auto itr = history_idx.lower_bound( std::make_tuple( base_id, quote_id, start ) );
+   const auto end = history_idx.end();
    vector<market_trade> result;
+   result.reserve( limit );
 
-   while( itr != history_idx.end() && count < limit
+   while( itr != end && result.size() < limit
           && !( itr->key.base != base_id || itr->key.quote != quote_id || itr->time < stop ) )
    {
-      {
-         market_trade trade;
-
-         if( assets[0]->id == itr->op.receives.asset_id )
-         {
-            trade.amount = assets[1]->amount_to_string( itr->op.pays );
-            trade.value = assets[0]->amount_to_string( itr->op.receives );
-         }
-         else
-         {
-            trade.amount = assets[1]->amount_to_string( itr->op.receives );
-            trade.value = assets[0]->amount_to_string( itr->op.pays );
-         }
-
-         trade.date = itr->time;
-         trade.price = price_to_string( itr->op.fill_price, *assets[0], *assets[1] );
-
-         if( itr->op.is_maker )
-         {
-            trade.sequence = -itr->key.sequence;
-            trade.side1_account_id = itr->op.account_id;
-         }
-         else
-            trade.side2_account_id = itr->op.account_id;
-
-         auto next_itr = std::next(itr);
-         // Trades are usually tracked in each direction, exception: for global settlement only one side is recorded
-         if( next_itr != history_idx.end() && next_itr->key.base == base_id && next_itr->key.quote == quote_id
-             && next_itr->time == itr->time && next_itr->op.is_maker != itr->op.is_maker )
-         {  // next_itr now could be the other direction // FIXME not 100% sure
-            if( next_itr->op.is_maker )
-            {
-               trade.sequence = -next_itr->key.sequence;
-               trade.side1_account_id = next_itr->op.account_id;
-            }
-            else
-               trade.side2_account_id = next_itr->op.account_id;
-            // skip the other direction
-            itr = next_itr;
-         }
-
-         result.push_back( trade );
-         ++count;
-      }
-
+      result.push_back( formatter.format( itr, end ) );
       ++itr;
    }
 
@@ -1502,78 +1828,35 @@ vector<market_trade> database_api_impl::get_trade_history_by_sequence(
    FC_ASSERT( assets[0], "Invalid base asset symbol: ${s}", ("s",base) );
    FC_ASSERT( assets[1], "Invalid quote asset symbol: ${s}", ("s",quote) );
 
-   auto base_id = assets[0]->id;
-   auto quote_id = assets[1]->id;
+   market_trade_formatter formatter( *assets[0], *assets[1] );
+   const auto base_id = formatter.base_id;
+   const auto quote_id = formatter.quote_id;
 
-   if( base_id > quote_id ) std::swap( base_id, quote_id );
    const auto& history_idx = _db.get_index_type<graphene::market_history::history_index>().indices().get<by_key>();
    history_key hkey;
    hkey.base = base_id;
    hkey.quote = quote_id;
    hkey.sequence = start_seq;
 
-   uint32_t count = 0;
    auto itr = history_idx.lower_bound( hkey );
+   const auto end = history_idx.end();
    vector<market_trade> result;
+   result.reserve( limit );
 
-   while( itr != history_idx.end() && count < limit
+   while( itr != end && result.size() < limit
           && !( itr->key.base != base_id || itr->key.quote != quote_id || itr->time < stop ) )
    {
       if( itr->key.sequence == start_seq ) // found the key, should skip this and the other direction if found
       {
          auto next_itr = std::next(itr);
-         if( next_itr != history_idx.end() && next_itr->key.base == base_id && next_itr->key.quote == quote_id
-             && next_itr->time == itr->time && next_itr->op.is_maker != itr->op.is_maker )
-         {  // next_itr now could be the other direction // FIXME not 100% sure
-            // skip the other direction
-            itr = next_itr;
-         }
-      }
-      else
-      {
-         market_trade trade;
-
-         if( assets[0]->id == itr->op.receives.asset_id )
+         if( next_itr != end && formatter.is_other_direction( *itr, *next_itr ) )
          {
-            trade.amount = assets[1]->amount_to_string( itr->op.pays );
-            trade.value = assets[0]->amount_to_string( itr->op.receives );
-         }
-         else
-         {
-            trade.amount = assets[1]->amount_to_string( itr->op.receives );
-            trade.value = assets[0]->amount_to_string( itr->op.pays );
-         }
-
-         trade.date = itr->time;
-         trade.price = price_to_string( itr->op.fill_price, *assets[0], *assets[1] );
-
-         if( itr->op.is_maker )
-         {
-            trade.sequence = -itr->key.sequence;
-            trade.side1_account_id = itr->op.account_id;
-         }
-         else
-            trade.side2_account_id = itr->op.account_id;
-
-         auto next_itr = std::next(itr);
-         // Trades are usually tracked in each direction, exception: for global settlement only one side is recorded
-         if( next_itr != history_idx.end() && next_itr->key.base == base_id && next_itr->key.quote == quote_id
-             && next_itr->time == itr->time && next_itr->op.is_maker != itr->op.is_maker )
-         {  // next_itr now could be the other direction // FIXME not 100% sure
-            if( next_itr->op.is_maker )
-            {
-               trade.sequence = -next_itr->key.sequence;
-               trade.side1_account_id = next_itr->op.account_id;
-            }
-            else
-               trade.side2_account_id = next_itr->op.account_id;
             // skip the other direction
             itr = next_itr;
          }
-
-         result.push_back( trade );
-         ++count;
       }
+      else
+         result.push_back( formatter.format( itr, end ) );
 
       ++itr;
    }
@@ -1659,6 +1942,17 @@ uint64_t database_api_impl::get_witness_count()const
    return _db.get_index_type<witness_index>().indices().size();
 }
 
+vector<std::pair<fc::time_point_sec, witness_id_type>> database_api::get_upcoming_witnesses( uint32_t limit )const
+{
+   return my->get_upcoming_witnesses( limit );
+}
+
+vector<std::pair<fc::time_point_sec, witness_id_type>> database_api_impl::get_upcoming_witnesses(
+                                                                            uint32_t limit )const
+{
+   return _db.get_upcoming_slots( limit );
+}
+
 //////////////////////////////////////////////////////////////////////
 //                                                                  //
 // Committee members                                                //
@@ -2064,12 +2358,38 @@ struct get_required_fees_helper
         max_recursion(_max_recursion)
    {}
 
+   struct set_fee_visitor
+   {
+      typedef void result_type;
+      const asset& fee;
+
+      template<typename OpType>
+      void operator()( OpType& op )const
+      {
+         op.fee = fee;
+      }
+   };
+
    fc::variant set_op_fees( operation& op )
    {
       if( op.is_type<proposal_create_operation>() )
       {
          return set_proposal_create_op_fees( op );
       }
+      else if( fee_schedule::is_fixed_fee( op ) )
+      {
+         auto itr = fixed_fees.find( op.which() );
+         if( itr == fixed_fees.end() )
+         {
+            asset fee = current_fee_schedule.set_fee( op, core_exchange_rate );
+            fc::variant result;
+            fc::to_variant( fee, result, GRAPHENE_NET_MAX_NESTED_OBJECTS );
+            itr = fixed_fees.emplace( op.which(), std::make_pair( fee, result ) ).first;
+         }
+         else // the fee counts into the size of an enclosing proposal
+            op.visit( set_fee_visitor{ itr->second.first } );
+         return itr->second.second;
+      }
       else
       {
          asset fee = current_fee_schedule.set_fee( op, core_exchange_rate );
@@ -2102,6 +2422,8 @@ struct get_required_fees_helper
    const price& core_exchange_rate;
    uint32_t max_recursion;
    uint32_t current_recursion = 0;
+   /// The fees of the operation types with a fixed fee, by operation type, computed once per call
+   flat_map< int64_t, std::pair< asset, fc::variant > > fixed_fees;
 };
 
 vector< fc::variant > database_api_impl::get_required_fees( const vector<operation>& ops,
@@ -2356,7 +2678,7 @@ const account_object* database_api_impl::get_account_from_string( const std::str
       account = _db.find(fc::variant(name_or_id, 1).as<account_id_type>(1));
    else
    {
-      const auto& idx = _db.get_index_type<account_index>().indices().get<by_name>();
+      const auto& idx = _db.get_index_type<account_index>().indices().get<by_exact_name>();
       auto itr = idx.find(name_or_id);
       if (itr != idx.end())
          account = &*itr;
@@ -2376,7 +2698,7 @@ const asset_object* database_api_impl::get_asset_from_string( const std::string&
       asset = _db.find(fc::variant(symbol_or_id, 1).as<asset_id_type>(1));
    else
    {
-      const auto& idx = _db.get_index_type<asset_index>().indices().get<by_symbol>();
+      const auto& idx = _db.get_index_type<asset_index>().indices().get<by_exact_symbol>();
       auto itr = idx.find(symbol_or_id);
       if (itr != idx.end())
          asset = &*itr;
@@ -2412,45 +2734,24 @@ vector<limit_order_object> database_api_impl::get_limit_orders( const asset_id_t
    uint64_t api_limit_get_limit_orders=_app_options->api_limit_get_limit_orders;
    FC_ASSERT( limit <= api_limit_get_limit_orders );
 
-   const auto& limit_order_idx = _db.get_index_type<limit_order_index>();
-   const auto& limit_price_idx = limit_order_idx.indices().get<by_price>();
+   const auto& books = _db.get_limit_order_books();
 
    vector<limit_order_object> result;
    result.reserve(limit*2);
 
    uint32_t count = 0;
-   auto limit_itr = limit_price_idx.lower_bound(price::max(a,b));
-   auto limit_end = limit_price_idx.upper_bound(price::min(a,b));
-   while(limit_itr != limit_end && count < limit)
-   {
-      result.push_back(*limit_itr);
-      ++limit_itr;
-      ++count;
-   }
+   const auto& a_book = books.get_book(a,b);
+   for( auto limit_itr = a_book.begin(); limit_itr != a_book.end() && count < limit; ++limit_itr, ++count )
+      result.push_back(*limit_itr->order);
    count = 0;
-   limit_itr = limit_price_idx.lower_bound(price::max(b,a));
-   limit_end = limit_price_idx.upper_bound(price::min(b,a));
-   while(limit_itr != limit_end && count < limit)
-   {
-      result.push_back(*limit_itr);
-      ++limit_itr;
-      ++count;
-   }
+   const auto& b_book = books.get_book(b,a);
+   for( auto limit_itr = b_book.begin(); limit_itr != b_book.end() && count < limit; ++limit_itr, ++count )
+      result.push_back(*limit_itr->order);
 
    return result;
 }
 
-bool database_api_impl::is_impacted_account( const flat_set<account_id_type>& accounts)
-{
-   if( !_subscribed_accounts.size() || !accounts.size() )
-      return false;
-
-   return std::any_of(accounts.begin(), accounts.end(), [this](const account_id_type& account) {
-      return _subscribed_accounts.find(account) != _subscribed_accounts.end();
-   });
-}
-
-void database_api_impl::broadcast_updates( const vector<variant>& updates )
+void database_api_impl::broadcast_updates( const vector<variant>& updates )const
 {
    if( updates.size() && _subscribe_callback ) {
       auto capture_this = shared_from_this();
@@ -2461,7 +2762,7 @@ void database_api_impl::broadcast_updates( const vector<variant>& updates )
    }
 }
 
-void database_api_impl::broadcast_market_updates( const market_queue_type& queue)
+void database_api_impl::broadcast_market_updates( const market_queue_type& queue)const
 {
    if( queue.size() )
    {
@@ -2477,97 +2778,51 @@ void database_api_impl::broadcast_market_updates( const market_queue_type& queue
    }
 }
 
-void database_api_impl::on_objects_removed( const vector<object_id_type>& ids,
-                                            const vector<const object*>& objs,
-                                            const flat_set<account_id_type>& impacted_accounts )
-{
-   handle_object_changed(_notify_remove_create, false, ids, impacted_accounts,
-      [objs](object_id_type id) -> const object* {
-         auto it = std::find_if(
-               objs.begin(), objs.end(),
-               [id](const object* o) {return o != nullptr && o->id == id;});
-
-         if (it != objs.end())
-            return *it;
-
-         return nullptr;
-      }
-   );
-}
-
-void database_api_impl::on_objects_new( const vector<object_id_type>& ids,
-                                        const flat_set<account_id_type>& impacted_accounts )
+void database_api_impl::broadcast_market_depth_update( const market_type& base_quote, const variant& update )const
 {
-   handle_object_changed(_notify_remove_create, true, ids, impacted_accounts,
-      std::bind(&object_database::find_object, &_db, std::placeholders::_1)
-   );
+   auto capture_this = shared_from_this();
+   fc::async([capture_this, this, base_quote, update](){
+      auto sub = _market_depth_subscriptions.find( base_quote );
+      if( sub != _market_depth_subscriptions.end() )
+         sub->second( update );
+   });
 }
 
-void database_api_impl::on_objects_changed( const vector<object_id_type>& ids,
-                                            const flat_set<account_id_type>& impacted_accounts )
+/** note: this method cannot yield because it is called in the middle of
+ * apply a block. The notices are delivered in the order of the calls, because tasks are run in the order
+ * they are scheduled.
+ */
+void database_api_impl::on_applied_operations( const variant& notice )const
 {
-   handle_object_changed(false, true, ids, impacted_accounts,
-      std::bind(&object_database::find_object, &_db, std::placeholders::_1)
-   );
+   auto capture_this = shared_from_this();
+   fc::async([this,capture_this,notice](){
+      if( _applied_operations_callback )
+         _applied_operations_callback( notice );
+   });
 }
 
-void database_api_impl::handle_object_changed( bool force_notify,
-                                               bool full_object,
-                                               const vector<object_id_type>& ids,
-                                               const flat_set<account_id_type>& impacted_accounts,
-                                               std::function<const object*(object_id_type id)> find_object )
+/** note: this method cannot yield because it is called in the middle of
+ * pushing a transaction.  The transactions are queued and handed to the
+ * subscriber by one task, so that a burst of pending transactions is
+ * delivered outside of push_transaction.
+ */
+void database_api_impl::on_pending_transaction( const variant& trx )const
 {
-   if( _subscribe_callback )
-   {
-      vector<variant> updates;
-
-      for(auto id : ids)
-      {
-         if( force_notify || is_subscribed_to_item(id) || is_impacted_account(impacted_accounts) )
-         {
-            if( full_object )
-            {
-               auto obj = find_object(id);
-               if( obj )
-               {
-                  updates.emplace_back( obj->to_variant() );
-               }
-            }
-            else
-            {
-               updates.emplace_back( fc::variant( id, 1 ) );
-            }
-         }
-      }
-
-      if( updates.size() )
-         broadcast_updates(updates);
-   }
-
-   if( _market_subscriptions.size() )
-   {
-      market_queue_type broadcast_queue;
+   _pending_trx_queue.push_back( trx );
+   if( _pending_trx_queue.size() > 1 ) // the task delivering the queue is already scheduled
+      return;
 
-      for(auto id : ids)
+   auto capture_this = shared_from_this();
+   fc::async([this,capture_this](){
+      vector<variant> queue;
+      queue.swap( _pending_trx_queue );
+      for( const auto& trx : queue )
       {
-         if( id.is<call_order_object>() )
-         {
-            enqueue_if_subscribed_to_market<call_order_object>( find_object(id), broadcast_queue, full_object );
-         }
-         else if( id.is<limit_order_object>() )
-         {
-            enqueue_if_subscribed_to_market<limit_order_object>( find_object(id), broadcast_queue, full_object );
-         }
-         else if( id.is<force_settlement_object>() )
-         {
-            enqueue_if_subscribed_to_market<force_settlement_object>( find_object(id), broadcast_queue,
-                                                                      full_object );
-         }
+         if( !_pending_trx_callback )
+            break;
+         _pending_trx_callback( trx );
       }
-
-      if( broadcast_queue.size() )
-         broadcast_market_updates(broadcast_queue);
-   }
+   });
 }
 
 /** note: this method cannot yield because it is called in the middle of
@@ -2583,48 +2838,6 @@ void database_api_impl::on_applied_block()
          _block_applied_callback(fc::variant(block_id, 1));
       });
    }
-
-   if(_market_subscriptions.size() == 0)
-      return;
-
-   const auto& ops = _db.get_applied_operations();
-   map< std::pair<asset_id_type,asset_id_type>, vector<pair<operation, operation_result>> > subscribed_markets_ops;
-   for(const optional< operation_history_object >& o_op : ops)
-   {
-      if( !o_op.valid() )
-         continue;
-      const operation_history_object& op = *o_op;
-
-      optional< std::pair<asset_id_type,asset_id_type> > market;
-      switch(op.op.which())
-      {
-         /*  This is sent via the object_changed callback
-         case operation::tag<limit_order_create_operation>::value:
-            market = op.op.get<limit_order_create_operation>().get_market();
-            break;
-         */
-         case operation::tag<fill_order_operation>::value:
-            market = op.op.get<fill_order_operation>().get_market();
-            break;
-            /*
-         case operation::tag<limit_order_cancel_operation>::value:
-         */
-         default: break;
-      }
-      if( market.valid() && _market_subscriptions.count(*market) )
-         // FIXME this may cause fill_order_operation be pushed before order creation
-         subscribed_markets_ops[*market].emplace_back(std::make_pair(op.op, op.result));
-   }
-   /// we need to ensure the database_api is not deleted for the life of the async operation
-   auto capture_this = shared_from_this();
-   fc::async([this,capture_this,subscribed_markets_ops](){
-      for(auto item : subscribed_markets_ops)
-      {
-         auto itr = _market_subscriptions.find(item.first);
-         if(itr != _market_subscriptions.end())
-            itr->second(fc::variant(item.second, GRAPHENE_NET_MAX_NESTED_OBJECTS));
-      }
-   });
 }
 
 } } // graphene::app
@@ -23,30 +23,39 @@
  */
 
 #include <graphene/app/database_api.hpp>
-
-#include <fc/bloom_filter.hpp>
+#include <graphene/app/subscription_registry.hpp>
 
 #define GET_REQUIRED_FEES_MAX_RECURSION 4
 
 namespace graphene { namespace app {
 
-typedef std::map< std::pair<graphene::chain::asset_id_type, graphene::chain::asset_id_type>,
-                  std::vector<fc::variant> > market_queue_type;
-
 class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 {
    public:
-      explicit database_api_impl( graphene::chain::database& db, const application_options* app_options );
+      database_api_impl( graphene::chain::database& db, const application_options* app_options,
+                         std::shared_ptr<full_account_cache> full_accounts,
+                         std::shared_ptr<subscription_registry> subscriptions );
       virtual ~database_api_impl();
 
       // Objects
       fc::variants get_objects( const vector<object_id_type>& ids, optional<bool> subscribe )const;
+      vector<versioned_object> get_objects_if_changed( const vector<object_id_type>& ids,
+                                                       const vector<uint64_t>& known_versions,
+                                                       optional<bool> subscribe )const;
+      fc::variants get_objects_at_head_block( const vector<object_id_type>& ids )const;
+      vector<object_range_digest> get_object_digests( uint8_t space_id, uint8_t type_id, uint64_t first,
+                                                      uint64_t last, uint32_t parts )const;
+      changed_objects get_objects_changed_since( uint8_t space_id, uint8_t type_id, uint64_t first, uint64_t last,
+                                                 uint32_t since )const;
 
       // Subscriptions
       void set_subscribe_callback( std::function<void(const variant&)> cb, bool notify_remove_create );
       void set_auto_subscription( bool enable );
-      void set_pending_transaction_callback( std::function<void(const variant&)> cb );
+      void set_pending_transaction_callback( std::function<void(const variant&)> cb,
+                                             const optional<pending_transaction_filter>& filter );
       void set_block_applied_callback( std::function<void(const variant& block_id)> cb );
+      void set_applied_operations_callback( std::function<void(const variant&)> cb,
+                                            optional<uint32_t> start_block_num );
       void cancel_all_subscriptions(bool reset_callback, bool reset_market_subscriptions);
 
       // Blocks and transactions
@@ -61,6 +70,10 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       fc::variant_object get_config()const;
       chain_id_type get_chain_id()const;
       dynamic_global_property_object get_dynamic_global_properties()const;
+      vector<graphene::db::index_memory_usage> get_index_memory_usage()const;
+      vector<maintenance_timing> get_maintenance_timings()const;
+      graphene::db::undo_history_usage get_undo_history_usage()const;
+      full_account_cache_statistics get_full_account_cache_statistics()const;
 
       // Keys
       vector<flat_set<account_id_type>> get_key_references( vector<public_key_type> key )const;
@@ -70,6 +83,9 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       account_id_type get_account_id_from_string(const std::string& name_or_id)const;
       vector<optional<account_object>> get_accounts( const vector<std::string>& account_names_or_ids,
                                                      optional<bool> subscribe )const;
+      vector<versioned_object> get_accounts_if_changed( const vector<std::string>& account_names_or_ids,
+                                                        const vector<uint64_t>& known_versions,
+                                                        optional<bool> subscribe )const;
       std::map<string,full_account> get_full_accounts( const vector<string>& names_or_ids,
                                                        optional<bool> subscribe );
       optional<account_object> get_account_by_name( string name )const;
@@ -78,6 +94,7 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       map<string,account_id_type> lookup_accounts( const string& lower_bound_name,
                                                    uint32_t limit,
                                                    optional<bool> subscribe )const;
+      map<string,account_id_type> lookup_accounts_by_prefix( const string& prefix, uint32_t limit )const;
       uint64_t get_account_count()const;
 
       // Balances
@@ -95,6 +112,8 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
                                                           optional<bool> subscribe )const;
       vector<extended_asset_object>           list_assets(const string& lower_bound_symbol, uint32_t limit)const;
       vector<optional<extended_asset_object>> lookup_asset_symbols(const vector<string>& symbols_or_ids)const;
+      map<string,asset_id_type>               lookup_asset_symbols_by_prefix( const string& prefix,
+                                                                              uint32_t limit )const;
       vector<extended_asset_object>           get_assets_by_issuer(const std::string& issuer_name_or_id,
                                                                    asset_id_type start, uint32_t limit)const;
 
@@ -120,6 +139,13 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       void subscribe_to_market( std::function<void(const variant&)> callback,
                                 const std::string& a, const std::string& b );
       void unsubscribe_from_market(const std::string& a, const std::string& b);
+      void subscribe_to_market_depth( std::function<void(const variant&)> callback,
+                                      const string& base, const string& quote );
+      void unsubscribe_from_market_depth( const string& base, const string& quote );
+      market_depth_snapshot              get_market_depth( const string& base, const string& quote,
+                                                           unsigned limit = 50 )const;
+      vector<market_depth_update>        get_market_depth_updates( const string& base, const string& quote,
+                                                                   uint64_t since_sequence )const;
 
       market_ticker                      get_ticker( const string& base, const string& quote,
                                                      bool skip_order_book = false )const;
@@ -139,6 +165,7 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       fc::optional<witness_object> get_witness_by_account(const std::string account_id_or_name)const;
       map<string, witness_id_type> lookup_witness_accounts(const string& lower_bound_name, uint32_t limit)const;
       uint64_t get_witness_count()const;
+      vector<std::pair<fc::time_point_sec, witness_id_type>> get_upcoming_witnesses( uint32_t limit )const;
 
       // Committee members
       vector<optional<committee_member_object>> get_committee_members(
@@ -203,6 +230,25 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       const account_object* get_account_from_string( const std::string& name_or_id,
                                                      bool throw_if_not_found = true ) const;
 
+      /**
+       * Walks an index ordered by name from the first name starting with prefix, and stops at the first name
+       * that does not, so that only the matching range of the tree is visited
+       */
+      template<typename IndexType, typename ObjectType>
+      map<string,object_id<ObjectType::space_id,ObjectType::type_id>> lookup_names_by_prefix(
+            const IndexType& idx, string ObjectType::* name, const string& prefix, uint32_t limit )const
+      {
+         map<string,object_id<ObjectType::space_id,ObjectType::type_id>> result;
+         for( auto itr = idx.lower_bound( prefix ); limit > 0 && itr != idx.end(); ++itr, --limit )
+         {
+            const string& value = (*itr).*name;
+            if( value.compare( 0, prefix.size(), prefix ) != 0 )
+               break;
+            result.emplace_hint( result.end(), value, itr->get_id() );
+         }
+         return result;
+      }
+
       ////////////////////////////////////////////////
       // Assets
       ////////////////////////////////////////////////
@@ -216,7 +262,11 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
          {
             result.total_in_collateral = amount_in_collateral_index->get_amount_in_collateral( id );
             if( result.bitasset_data_id.valid() )
+            {
                result.total_backing_collateral = amount_in_collateral_index->get_backing_collateral( id );
+               result.total_debt = amount_in_collateral_index->get_total_debt( id );
+               result.total_positions = amount_in_collateral_index->get_positions_count( id );
+            }
          }
          return result;
       }
@@ -234,12 +284,27 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       // helper function
       vector<limit_order_object> get_limit_orders( const asset_id_type a, const asset_id_type b,
                                                    const uint32_t limit )const;
+      // helper function
+      order_book get_order_book( const asset_object& base, const asset_object& quote, unsigned limit )const;
 
       ////////////////////////////////////////////////
       // Subscription
       ////////////////////////////////////////////////
 
       // Decides whether to subscribe using member variables and given parameter
+      /// @return obj, which may be null, as a versioned_object for a client knowing version known
+      versioned_object get_versioned_object( const object* obj, uint64_t known )const
+      {
+         versioned_object result;
+         if( obj == nullptr )
+            return result;
+         result.version = _db.get_object_version( *obj );
+         result.modified = ( known == 0 || known != result.version );
+         if( result.modified )
+            result.value = obj->to_variant();
+         return result;
+      }
+
       bool get_whether_to_subscribe( optional<bool> subscribe )const
       {
          if( !_subscribe_callback )
@@ -249,90 +314,22 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
          return _enabled_auto_subscription;
       }
 
-      // Note:
-      //   Different type of object_id<T> objects could become identical after packed.
-      //   For example, both `account_id_type a=1.2.0` and `asset_id_type b=1.3.0` will become `0` after packed.
-      //   In order to avoid collision, we don't use a template function here, instead, we implicitly convert all
-      //   object IDs to `object_id_type` when subscribing.
-      //
-      //   If need to subscribe to other data types, override this function with the types as parameter.
-      //   For example, we had a `get_subscription_key( const public_key_type& item )` function here, which was
-      //   removed lately since we no longer subscribe to public keys.
-      vector<char> get_subscription_key( const object_id_type& item )const
-      {
-         return fc::raw::pack(item);
-      }
-
-      template<typename T>
-      void subscribe_to_item( const T& item )const
+      // Typed IDs are converted to object_id_type, so that e.g. 1.2.0 and 1.3.0 are kept apart
+      void subscribe_to_item( const object_id_type& item )const
       {
          if( !_subscribe_callback )
             return;
-
-         vector<char> key = get_subscription_key( item );
-         if( !_subscribe_filter.contains( key.data(), key.size() ) )
-         {
-            _subscribe_filter.insert( key.data(), key.size() );
-         }
-      }
-
-      template<typename T>
-      bool is_subscribed_to_item( const T& item )const
-      {
-         if( !_subscribe_callback )
-            return false;
-
-         vector<char> key = get_subscription_key( item );
-         return _subscribe_filter.contains( key.data(), key.size() );
-      }
-
-      // for full-account subscription
-      bool is_impacted_account( const flat_set<account_id_type>& accounts );
-
-      // for market subscription
-      template<typename T>
-      const std::pair<asset_id_type,asset_id_type> get_order_market( const T& order )
-      {
-         return order.get_market();
-      }
-
-      // for market subscription
-      const std::pair<asset_id_type,asset_id_type> get_order_market( const force_settlement_object& order )
-      {
-         // TODO cache the result to avoid repeatly fetching from db
-         asset_id_type backing_id = order.balance.asset_id( _db ).bitasset_data( _db ).options.short_backing_asset;
-         auto tmp = std::make_pair( order.balance.asset_id, backing_id );
-         if( tmp.first > tmp.second ) std::swap( tmp.first, tmp.second );
-         return tmp;
-      }
-
-      template<typename T>
-      void enqueue_if_subscribed_to_market(const object* obj, market_queue_type& queue, bool full_object=true)
-      {
-         const T* order = dynamic_cast<const T*>(obj);
-         FC_ASSERT( order != nullptr);
-
-         const auto& market = get_order_market( *order );
-
-         auto sub = _market_subscriptions.find( market );
-         if( sub != _market_subscriptions.end() ) {
-            queue[market].emplace_back( full_object ? obj->to_variant() : fc::variant(obj->id, 1) );
-         }
+         _subscriptions->subscribe_to_object( this, item );
       }
 
-      void broadcast_updates( const vector<variant>& updates );
-      void broadcast_market_updates( const market_queue_type& queue);
-      void handle_object_changed( bool force_notify,
-                                  bool full_object,
-                                  const vector<object_id_type>& ids,
-                                  const flat_set<account_id_type>& impacted_accounts,
-                                  std::function<const object*(object_id_type id)> find_object );
-
-      /** called every time a block is applied to report the objects that were changed */
-      void on_objects_new(const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts);
-      void on_objects_changed(const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts);
-      void on_objects_removed(const vector<object_id_type>& ids, const vector<const object*>& objs,
-                              const flat_set<account_id_type>& impacted_accounts);
+      /// Called by the subscription_registry with the updates for this session, the variants are shared
+      ///@{
+      void broadcast_updates( const vector<variant>& updates )const;
+      void broadcast_market_updates( const market_queue_type& queue)const;
+      void on_pending_transaction( const variant& trx )const;
+      void broadcast_market_depth_update( const market_type& base_quote, const variant& update )const;
+      void on_applied_operations( const variant& notice )const;
+      ///@}
       void on_applied_block();
 
       ////////////////////////////////////////////////
@@ -342,23 +339,27 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       bool _notify_remove_create = false;
       bool _enabled_auto_subscription = true;
 
-      mutable fc::bloom_filter  _subscribe_filter;
       std::set<account_id_type> _subscribed_accounts;
 
       std::function<void(const fc::variant&)> _subscribe_callback;
       std::function<void(const fc::variant&)> _pending_trx_callback;
       std::function<void(const fc::variant&)> _block_applied_callback;
+      std::function<void(const fc::variant&)> _applied_operations_callback;
+      /// pending transactions not yet passed to _pending_trx_callback, see on_pending_transaction()
+      mutable vector<variant> _pending_trx_queue;
 
-      boost::signals2::scoped_connection _new_connection;
-      boost::signals2::scoped_connection _change_connection;
-      boost::signals2::scoped_connection _removed_connection;
       boost::signals2::scoped_connection _applied_block_connection;
-      boost::signals2::scoped_connection _pending_trx_connection;
 
       map< pair<asset_id_type,asset_id_type>, std::function<void(const variant&)> > _market_subscriptions;
+      /// Keyed by the base and the quote asset
+      map< pair<asset_id_type,asset_id_type>, std::function<void(const variant&)> > _market_depth_subscriptions;
 
       graphene::chain::database& _db;
       const application_options* _app_options = nullptr;
+      /// Shared by all connections, may be null
+      std::shared_ptr<full_account_cache> _full_account_cache;
+      /// Shared by all connections, or owned by this session if none was given
+      std::shared_ptr<subscription_registry> _subscriptions;
 
       const graphene::api_helper_indexes::amount_in_collateral_index* amount_in_collateral_index;
 };
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/full_account_cache.hpp>
+
+#include <graphene/chain/impacted.hpp>
+#include <graphene/chain/proposal_object.hpp>
+
+namespace graphene { namespace app {
+
+full_account_cache::full_account_cache( graphene::chain::database& db, size_t capacity )
+   : _db( db ), _capacity( capacity ), _head_block_id( db.head_block_id() )
+{
+   _new_connection = _db.new_objects.connect( [this]( const vector<object_id_type>& ids,
+                                                      const flat_set<account_id_type>& impacted_accounts ) {
+      invalidate( impacted_accounts );
+      invalidate_objects( ids, vector<const object*>() );
+   });
+   _change_connection = _db.changed_objects.connect( [this]( const vector<object_id_type>& ids,
+                                                             const flat_set<account_id_type>& impacted_accounts ) {
+      invalidate( impacted_accounts );
+      invalidate_objects( ids, vector<const object*>() );
+   });
+   _removed_connection = _db.removed_objects.connect( [this]( const vector<object_id_type>& ids,
+                                                              const vector<const object*>& objs,
+                                                              const flat_set<account_id_type>& impacted_accounts ) {
+      invalidate( impacted_accounts );
+      invalidate_objects( ids, objs );
+   });
+   _applied_block_connection = _db.applied_block.connect( [this]( const signed_block& block ) {
+      on_applied_block( block );
+   });
+   _pending_trx_connection = _db.on_pending_transaction.connect( [this]( const signed_transaction& trx ) {
+      _pending_state = true;
+      flat_set<account_id_type> impacted_accounts;
+      transaction_get_impacted_accounts( trx, impacted_accounts );
+      invalidate( impacted_accounts );
+   });
+}
+
+const full_account* full_account_cache::find( account_id_type account )
+{
+   const auto& by_account_idx = _entries.get<by_account>();
+   auto itr = by_account_idx.find( account );
+   if( itr == by_account_idx.end() )
+   {
+      ++_misses;
+      return nullptr;
+   }
+   ++_hits;
+   auto seq_itr = _entries.project<0>( itr );
+   _entries.relocate( _entries.begin(), seq_itr );
+   return &seq_itr->result;
+}
+
+void full_account_cache::insert( const full_account& result )
+{
+   const account_id_type account = result.account.get_id();
+   const auto& by_account_idx = _entries.get<by_account>();
+   auto itr = by_account_idx.find( account );
+   if( itr != by_account_idx.end() )
+      erase( _entries.project<0>( itr ) );
+
+   entry e;
+   e.account = account;
+   e.result = result;
+   e.result.votes.clear();
+   e.uses_pending_state = _pending_state;
+   _entries.push_front( std::move(e) );
+   for( const object_id_type& id : contained_objects( result ) )
+      _accounts_by_object[id].insert( account );
+
+   while( _entries.size() > _capacity )
+      erase( std::prev( _entries.end() ) );
+}
+
+full_account_cache_statistics full_account_cache::get_statistics()const
+{
+   full_account_cache_statistics result;
+   result.capacity = _capacity;
+   result.size = _entries.size();
+   result.hits = _hits;
+   result.misses = _misses;
+   result.invalidations = _invalidations;
+   return result;
+}
+
+vector<object_id_type> full_account_cache::contained_objects( const full_account& result )
+{
+   vector<object_id_type> ids;
+   ids.push_back( result.account.id );
+   ids.push_back( result.statistics.id );
+   if( result.cashback_balance.valid() )
+      ids.push_back( result.cashback_balance->id );
+   auto add = [&ids]( const auto& objects ) {
+      for( const auto& obj : objects )
+         ids.push_back( obj.id );
+   };
+   add( result.balances );
+   add( result.vesting_balances );
+   add( result.limit_orders );
+   add( result.call_orders );
+   add( result.settle_orders );
+   add( result.proposals );
+   add( result.withdraws_from );
+   add( result.withdraws_to );
+   add( result.htlcs_from );
+   add( result.htlcs_to );
+   for( const asset_id_type& asset : result.assets )
+      ids.push_back( asset );
+   return ids;
+}
+
+void full_account_cache::erase( entry_index_type::iterator itr )
+{
+   for( const object_id_type& id : contained_objects( itr->result ) )
+   {
+      auto accounts_itr = _accounts_by_object.find( id );
+      if( accounts_itr == _accounts_by_object.end() )
+         continue;
+      accounts_itr->second.erase( itr->account );
+      if( accounts_itr->second.empty() )
+         _accounts_by_object.erase( accounts_itr );
+   }
+   _entries.erase( itr );
+}
+
+void full_account_cache::invalidate( account_id_type account )
+{
+   const auto& by_account_idx = _entries.get<by_account>();
+   auto itr = by_account_idx.find( account );
+   if( itr == by_account_idx.end() )
+      return;
+   ++_invalidations;
+   erase( _entries.project<0>( itr ) );
+}
+
+void full_account_cache::invalidate( const flat_set<account_id_type>& accounts )
+{
+   if( _entries.empty() )
+      return;
+   for( const account_id_type& account : accounts )
+      invalidate( account );
+}
+
+void full_account_cache::invalidate_objects( const vector<object_id_type>& ids, const vector<const object*>& objs )
+{
+   if( _entries.empty() )
+      return;
+   for( size_t i = 0; i < ids.size(); ++i )
+   {
+      auto accounts_itr = _accounts_by_object.find( ids[i] );
+      if( accounts_itr != _accounts_by_object.end() )
+      {
+         const flat_set<account_id_type> accounts = accounts_itr->second; // erase() modifies the original
+         invalidate( accounts );
+      }
+
+      // proposals are listed for their proposer and the accounts approving them, which need not be impacted
+      if( ids[i].is<proposal_id_type>() )
+      {
+         const object* obj = i < objs.size() ? objs[i] : _db.find_object( ids[i] );
+         const proposal_object* proposal = dynamic_cast<const proposal_object*>( obj );
+         if( proposal == nullptr )
+            continue;
+         invalidate( proposal->required_active_approvals );
+         invalidate( proposal->required_owner_approvals );
+         invalidate( proposal->available_active_approvals );
+         invalidate( proposal->available_owner_approvals );
+         invalidate( proposal->proposer );
+      }
+   }
+}
+
+void full_account_cache::on_applied_block( const signed_block& block )
+{
+   // after switching forks the objects changed by the popped blocks are unknown
+   if( block.previous != _head_block_id )
+   {
+      _invalidations += _entries.size();
+      _entries.clear();
+      _accounts_by_object.clear();
+   }
+   else
+   {
+      for( auto itr = _entries.begin(); itr != _entries.end(); )
+      {
+         auto next = std::next( itr );
+         if( itr->uses_pending_state )
+         {
+            ++_invalidations;
+            erase( itr );
+         }
+         itr = next;
+      }
+   }
+   _pending_state = false;
+   _head_block_id = block.id();
+}
+
+} } // graphene::app
@@ -23,6 +23,8 @@
  */
 #pragma once
 
+#include <graphene/app/api_profiler.hpp>
+#include <graphene/app/block_tracer.hpp>
 #include <graphene/app/database_api.hpp>
 
 #include <graphene/protocol/types.hpp>
@@ -34,6 +36,8 @@
 
 #include <graphene/elasticsearch/elasticsearch_plugin.hpp>
 
+#include <graphene/history_store/history_store.hpp>
+
 #include <graphene/debug_witness/debug_api.hpp>
 
 #include <graphene/net/node.hpp>
@@ -90,6 +94,16 @@ namespace graphene { namespace app {
       int             count;
    };
 
+   /**
+    * @brief A block delivered by @ref block_api::stream_blocks
+    */
+   struct streamed_block
+   {
+      uint32_t                         block_num = 0;
+      optional<signed_block>           block;  ///< the block, unless it was requested packed
+      optional< vector<char> >         packed; ///< the block serialized as stored, if it was requested packed
+   };
+
    struct history_operation_detail {
       uint32_t total_count = 0;
       vector<operation_history_object> operation_history_objs;
@@ -100,15 +114,15 @@ namespace graphene { namespace app {
     */
    struct limit_order_group
    {
-      limit_order_group( const std::pair<limit_order_group_key,limit_order_group_data>& p )
-         :  min_price( p.first.min_price ),
-            max_price( p.second.max_price ),
-            total_for_sale( p.second.total_for_sale )
+      limit_order_group( const limit_order_group_data& d )
+         :  min_price( d.min_price ),
+            max_price( d.max_price ),
+            total_for_sale( d.total_for_sale )
             {}
       limit_order_group() {}
 
-      price         min_price; ///< possible lowest price in the group
-      price         max_price; ///< possible highest price in the group
+      price         min_price; ///< lowest price of the orders added to the group
+      price         max_price; ///< highest price of the orders added to the group
       share_type    total_for_sale; ///< total amount of asset for sale, asset id is min_price.base.asset_id
    };
 
@@ -218,6 +232,17 @@ namespace graphene { namespace app {
           * it means this API server supports OHLCV data aggregated in 5-minute buckets.
           */
          flat_set<uint32_t> get_market_history_buckets()const;
+
+         /**
+          * @brief Get operations from the history_store plugin, which keeps the full history on disk
+          * @param query The account, asset or operation type whose operations are wanted, if any, the range of
+          * time, blocks and sequence numbers, the operation types to return and the maximum number of results
+          * (must not exceed the limit of get_account_history)
+          * @return A list of operations with their sequence numbers in the store, ordered from most recent to
+          * oldest. To get the next page, query again with max_sequence set to the last sequence number minus one.
+          */
+         vector<history_store::stored_operation> query_history_store(
+            const history_store::history_query& query )const;
       private:
            application& _app;
            graphene::app::database_api database_api;
@@ -226,10 +251,10 @@ namespace graphene { namespace app {
    /**
     * @brief Block api
     */
-   class block_api
+   class block_api : public std::enable_shared_from_this<block_api>
    {
    public:
-      block_api(graphene::chain::database& db);
+      block_api(graphene::chain::database& db, const application_options* app_options = nullptr);
       ~block_api();
 
       /**
@@ -240,8 +265,41 @@ namespace graphene { namespace app {
           */
       vector<optional<signed_block>> get_blocks(uint32_t block_num_from, uint32_t block_num_to)const;
 
+      /**
+          * @brief Send signed blocks one by one as they are read
+          * @param callback Called with a @ref streamed_block for each block from block_num_from till block_num_to,
+          *                 in order. Neither the block nor the packed data is set for blocks that are not available.
+          * @param block_num_from The lowest block number
+          * @param block_num_to The highest block number, lowered to the head block and to at most
+          *                     api_limit_stream_blocks blocks from block_num_from
+          * @param packed @a true to send the blocks serialized as stored, which the node does not unpack and
+          *               JSON clients receive as a hex string
+          *
+          * This returns immediately. Unlike @ref get_blocks the range is not collected in memory, and other
+          * calls on the connection are served while the blocks are being sent. At most api_limit_block_streams
+          * streams run at a time on one connection.
+          */
+      void stream_blocks( std::function<void(const variant&)> callback, uint32_t block_num_from,
+                          uint32_t block_num_to, bool packed )const;
+
+      /**
+          * @brief Get the operations applied in blocks, with virtual operations and operation results
+          * @param block_num_from The lowest block number
+          * @param block_num_to The highest block number, less than block_num_from + api_limit_get_applied_operations
+          * @return For each block from block_num_from till block_num_to the operations applied in it, null if
+          *         they are not stored, which is the case for all blocks unless applied-operation-log is enabled
+          */
+      vector<optional<vector<operation_history_object>>> get_applied_operations( uint32_t block_num_from,
+                                                                                  uint32_t block_num_to )const;
+
    private:
+      void send_blocks( const std::function<void(const variant&)>& callback, uint32_t block_num_from,
+                        uint32_t block_num_to, bool packed )const;
+
       graphene::chain::database& _db;
+      const application_options* _app_options;
+      /// Streams started by stream_blocks that are still sending
+      mutable uint32_t           _active_streams = 0;
    };
 
 
@@ -350,6 +408,17 @@ namespace graphene { namespace app {
           */
          std::vector<net::potential_peer_record> get_potential_peers() const;
 
+         /**
+          * @brief Get statistics about the P2P messages this node received, by message type,
+          *        and the size of the send queue of each connected peer
+          */
+         fc::variant_object get_message_statistics() const;
+
+         /**
+          * @brief Get the number of API calls admitted, delayed and rejected by the rate limits of the node
+          */
+         api_rate_limit_statistics get_api_rate_limit_statistics() const;
+
       private:
          application& _app;
    };
@@ -476,6 +545,15 @@ namespace graphene { namespace app {
           */
          vector<asset_holders> get_all_asset_holders() const;
 
+         /**
+          * @brief Get the margin positions of an MPA, least collateralized first
+          * @param asset The MPA id or symbol
+          * @param start The start index
+          * @param limit Maximum limit must not exceed api_limit_get_call_orders
+          * @return The call orders of the positions
+          */
+         vector<call_order_object> get_collateral_positions( std::string asset, uint32_t start, uint32_t limit )const;
+
       private:
          graphene::app::application& _app;
          graphene::chain::database& _db;
@@ -518,6 +596,71 @@ namespace graphene { namespace app {
          application& _app;
          graphene::app::database_api database_api;
    };
+
+   /**
+    * @brief The profiling_api class reports how long the calls of the other APIs and the handling of blocks take.
+    *
+    * Only available if the node runs with enable-api-profiling, block-tracing or block-trace-file.
+    */
+   class profiling_api
+   {
+      public:
+         profiling_api( application& app ) : _app( app ) {}
+
+         /**
+          * @brief Get the number of calls, the failures and the latency histogram of each API method called
+          *        since the node started or the statistics were reset
+          */
+         vector<api_method_statistics> get_method_statistics()const;
+
+         /**
+          * @brief Get the last calls taking at least api-slow-call-threshold milliseconds, with their parameters
+          * @return The slow calls, most recent first
+          */
+         vector<slow_api_call> get_slow_calls()const;
+
+         /**
+          * @brief Clear the statistics and the slow calls
+          */
+         void reset_statistics();
+
+         /**
+          * @brief Get the number of calls and the total and maximum time of the evaluation and of the application
+          *        of each operation type evaluated since the node started or the statistics were reset
+          *
+          * Only available if the node is built with GRAPHENE_EVALUATOR_PROFILING.
+          */
+         vector<evaluator_statistics> get_evaluator_statistics()const;
+
+         /**
+          * @brief Clear the evaluator statistics
+          */
+         void reset_evaluator_statistics();
+
+         /**
+          * @brief Get the average and maximum time and the latency histogram of each stage of handling the recent
+          *        blocks received during normal operation, from the delay after the block timestamp to the end of
+          *        push_block
+          *
+          * Only available with block-tracing. The statistics cover the last block-trace-window blocks.
+          */
+         vector<block_stage_statistics> get_block_statistics()const;
+
+         /**
+          * @brief Get the stages of handling the recent blocks received during normal operation
+          * @param limit Maximum number of blocks to return
+          * @return The blocks, most recent first
+          */
+         vector<block_trace> get_recent_blocks( uint32_t limit )const;
+
+         /**
+          * @brief Clear the recent blocks and their statistics
+          */
+         void reset_block_statistics();
+
+      private:
+         application& _app;
+   };
 } } // graphene::app
 
 extern template class fc::api<graphene::app::block_api>;
@@ -528,6 +671,7 @@ extern template class fc::api<graphene::app::crypto_api>;
 extern template class fc::api<graphene::app::asset_api>;
 extern template class fc::api<graphene::app::orders_api>;
 extern template class fc::api<graphene::debug_witness::debug_api>;
+extern template class fc::api<graphene::app::profiling_api>;
 
 namespace graphene { namespace app {
    /**
@@ -569,6 +713,8 @@ namespace graphene { namespace app {
          fc::api<orders_api> orders()const;
          /// @brief Retrieve the debug API (if available)
          fc::api<graphene::debug_witness::debug_api> debug()const;
+         /// @brief Retrieve the profiling API (if available)
+         fc::api<profiling_api> profiling()const;
 
          /// @brief Called to enable an API, not reflected.
          void enable_api( const string& api_name );
@@ -584,6 +730,7 @@ namespace graphene { namespace app {
          optional< fc::api<asset_api> > _asset_api;
          optional< fc::api<orders_api> > _orders_api;
          optional< fc::api<graphene::debug_witness::debug_api> > _debug_api;
+         optional< fc::api<profiling_api> > _profiling_api;
    };
 
 }}  // graphene::app
@@ -596,6 +743,8 @@ FC_REFLECT( graphene::app::verify_range_result,
         (success)(min_val)(max_val) )
 FC_REFLECT( graphene::app::verify_range_proof_rewind_result,
         (success)(min_val)(max_val)(value_out)(blind_out)(message_out) )
+FC_REFLECT( graphene::app::streamed_block,
+            (block_num)(block)(packed) )
 FC_REFLECT( graphene::app::history_operation_detail,
             (total_count)(operation_history_objs) )
 FC_REFLECT( graphene::app::limit_order_group,
@@ -614,9 +763,12 @@ FC_API(graphene::app::history_api,
        (get_fill_order_history)
        (get_market_history)
        (get_market_history_buckets)
+       (query_history_store)
      )
 FC_API(graphene::app::block_api,
        (get_blocks)
+       (stream_blocks)
+       (get_applied_operations)
      )
 FC_API(graphene::app::network_broadcast_api,
        (broadcast_transaction)
@@ -631,6 +783,8 @@ FC_API(graphene::app::network_node_api,
        (get_potential_peers)
        (get_advanced_node_parameters)
        (set_advanced_node_parameters)
+       (get_message_statistics)
+       (get_api_rate_limit_statistics)
      )
 FC_API(graphene::app::crypto_api,
        (blind)
@@ -645,11 +799,22 @@ FC_API(graphene::app::asset_api,
        (get_asset_holders)
 	   (get_asset_holders_count)
        (get_all_asset_holders)
+       (get_collateral_positions)
      )
 FC_API(graphene::app::orders_api,
        (get_tracked_groups)
        (get_grouped_limit_orders)
      )
+FC_API(graphene::app::profiling_api,
+       (get_method_statistics)
+       (get_slow_calls)
+       (reset_statistics)
+       (get_evaluator_statistics)
+       (reset_evaluator_statistics)
+       (get_block_statistics)
+       (get_recent_blocks)
+       (reset_block_statistics)
+     )
 FC_API(graphene::app::login_api,
        (login)
        (block)
@@ -661,4 +826,5 @@ FC_API(graphene::app::login_api,
        (asset)
        (orders)
        (debug)
+       (profiling)
      )
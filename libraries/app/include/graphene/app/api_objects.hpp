@@ -30,6 +30,7 @@
 #include <graphene/chain/proposal_object.hpp>
 #include <graphene/chain/withdraw_permission_object.hpp>
 #include <graphene/chain/htlc_object.hpp>
+#include <graphene/chain/operation_history_object.hpp>
 
 #include <graphene/api_helper_indexes/api_helper_indexes.hpp>
 #include <graphene/market_history/market_history_plugin.hpp>
@@ -106,11 +107,12 @@ namespace graphene { namespace app {
       string                     quote_volume;
 
       market_ticker() {}
+      /** @param books to read the best bid and ask from, null to leave them out */
       market_ticker(const market_ticker_object& mto,
                     const fc::time_point_sec& now,
                     const asset_object& asset_base,
                     const asset_object& asset_quote,
-                    const order_book& orders);
+                    const limit_order_book_index* books);
       market_ticker(const fc::time_point_sec& now,
                     const asset_object& asset_base,
                     const asset_object& asset_quote);
@@ -136,6 +138,80 @@ namespace graphene { namespace app {
       account_id_type            side2_account_id = GRAPHENE_NULL_ACCOUNT;
    };
 
+   /**
+    *  The changes of the order book of the market base:quote in one block. Each level is the total of all
+    *  limit orders at its price, a level with zero amounts has been removed from the book.
+    */
+   struct market_depth_update
+   {
+      string                     base;
+      string                     quote;
+      uint64_t                   sequence = 0; ///< one more than the sequence of the previous update of the market
+      uint32_t                   block_num = 0;
+      /// The levels replace the whole book, sent instead of the changes after a chain reorganization
+      bool                       full = false;
+      vector< order >            bids; ///< changed levels, best price first
+      vector< order >            asks; ///< changed levels, best price first
+      vector< market_trade >     trades;
+   };
+
+   /** The order book of the market base:quote aggregated by price, to which market_depth_update are applied */
+   struct market_depth_snapshot
+   {
+      string                     base;
+      string                     quote;
+      uint64_t                   sequence = 0; ///< of the last update included, 0 if there is none
+      uint32_t                   block_num = 0;
+      vector< order >            bids;
+      vector< order >            asks;
+   };
+
+   /**
+    *  All operations applied by one block, including the virtual ones, with their results. After a chain
+    *  reorganization the blocks of the new fork are sent again with block numbers that were already sent.
+    */
+   struct applied_operations_notice
+   {
+      uint32_t                            block_num = 0;
+      block_id_type                       block_id;
+      fc::time_point_sec                  timestamp;
+      vector< operation_history_object >  operations;
+   };
+
+   /// @see database_api::set_pending_transaction_callback
+   struct pending_transaction_filter
+   {
+      /// if not empty, only transactions impacting one of these accounts are sent
+      flat_set< account_id_type >  accounts;
+      /// if not empty, only transactions with an operation of one of these types, by operation::which(), are sent
+      flat_set< int64_t >          operation_types;
+      /// if not empty, only transactions with an operation moving, trading, managing or paying its fee in one of
+      /// these assets are sent
+      flat_set< asset_id_type >    assets;
+   };
+
+   /// @see database_api::get_objects_if_changed
+   struct versioned_object
+   {
+      /// the version of the object, to pass as known version next time, 0 if the object does not exist
+      uint64_t   version = 0;
+      /// false if the object still has the known version, its value is not sent then
+      bool       modified = true;
+      /// the object if it exists and is modified, null otherwise
+      variant    value;
+   };
+
+   /// @see database_api::get_objects_changed_since
+   struct changed_objects
+   {
+      /// to pass as since to the next call, to get the objects changed after this result
+      uint32_t          stamp = 0;
+      /// the changed objects of the range, as of the head block
+      vector<variant>   objects;
+      /// the first instance that was not examined if the range exceeds the limit, 0 if all were examined
+      uint64_t          next_instance = 0;
+   };
+
    struct extended_asset_object : asset_object
    {
       extended_asset_object() {}
@@ -144,6 +220,8 @@ namespace graphene { namespace app {
 
       optional<share_type> total_in_collateral;
       optional<share_type> total_backing_collateral;
+      optional<share_type> total_debt; ///< debt of all margin positions, only for MPAs
+      optional<uint64_t>   total_positions; ///< number of margin positions, only for MPAs
    };
 
 } }
@@ -181,6 +259,13 @@ FC_REFLECT( graphene::app::market_ticker,
             (time)(base)(quote)(latest)(lowest_ask)(highest_bid)(percent_change)(base_volume)(quote_volume) );
 FC_REFLECT( graphene::app::market_volume, (time)(base)(quote)(base_volume)(quote_volume) );
 FC_REFLECT( graphene::app::market_trade, (sequence)(date)(price)(amount)(value)(side1_account_id)(side2_account_id) );
+FC_REFLECT( graphene::app::market_depth_update,
+            (base)(quote)(sequence)(block_num)(full)(bids)(asks)(trades) );
+FC_REFLECT( graphene::app::market_depth_snapshot, (base)(quote)(sequence)(block_num)(bids)(asks) );
+FC_REFLECT( graphene::app::applied_operations_notice, (block_num)(block_id)(timestamp)(operations) );
+FC_REFLECT( graphene::app::pending_transaction_filter, (accounts)(operation_types)(assets) );
+FC_REFLECT( graphene::app::versioned_object, (version)(modified)(value) );
+FC_REFLECT( graphene::app::changed_objects, (stamp)(objects)(next_instance) );
 
 FC_REFLECT_DERIVED( graphene::app::extended_asset_object, (graphene::chain::asset_object),
-                    (total_in_collateral)(total_backing_collateral) );
+                    (total_in_collateral)(total_backing_collateral)(total_debt)(total_positions) );
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/api.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+#include <fc/variant.hpp>
+
+#include <graphene/protocol/config.hpp>
+
+#include <array>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace graphene { namespace app {
+
+   /// Call statistics of one API method
+   struct api_method_statistics
+   {
+      std::string api;
+      std::string method;
+      uint64_t    calls = 0;
+      uint64_t    failures = 0;         ///< calls that threw an exception
+      uint64_t    total_time_us = 0;
+      uint64_t    max_time_us = 0;
+      /// Number of calls taking less than 100us, 1ms, 10ms, 100ms, 1s and longer
+      std::vector<uint64_t> latency_histogram;
+   };
+
+   /// A call that took at least api-slow-call-threshold milliseconds
+   struct slow_api_call
+   {
+      fc::time_point_sec time;          ///< when the call started
+      std::string        api;
+      std::string        method;
+      fc::variants       params;
+      uint64_t           time_us = 0;
+      bool               failed = false;
+   };
+
+   /**
+    *  Measures the API calls of all connections. The methods of an fc::api are wrapped once it is created by
+    *  login_api::enable_api, so that each call through the RPC connection is timed. The calls of each method are
+    *  counted in a latency histogram, and the parameters of the last max_slow_calls calls taking at least the
+    *  slow call threshold are kept. The size of the responses is not measured, since they are only serialized
+    *  by the connection after the call has returned.
+    *
+    *  Only created if enable-api-profiling is set, otherwise the APIs are not wrapped at all.
+    */
+   class api_profiler : public std::enable_shared_from_this<api_profiler>
+   {
+      public:
+         static const size_t max_slow_calls = 100;
+         static const size_t histogram_buckets = 6;
+
+         explicit api_profiler( uint32_t slow_call_threshold_ms );
+
+         /** Wraps the methods of api, the copies of api share the wrapped methods */
+         template<typename Api>
+         void profile( const fc::api<Api>& api, const std::string& api_name )
+         {
+            api->visit( method_wrapper{ shared_from_this(), api_name } );
+         }
+
+         std::vector<api_method_statistics> get_method_statistics()const;
+         /** @return the slow calls kept, most recent first */
+         std::vector<slow_api_call> get_slow_calls()const;
+         void reset();
+
+      private:
+         struct method_counters
+         {
+            uint64_t calls = 0;
+            uint64_t failures = 0;
+            uint64_t total_time_us = 0;
+            uint64_t max_time_us = 0;
+            std::array<uint64_t, histogram_buckets> histogram {};
+         };
+         typedef std::pair<std::string, std::string> method_key;
+
+         template<typename T>
+         static fc::variant param_to_variant( const T& param )
+         {
+            return fc::variant( param, GRAPHENE_MAX_NESTED_OBJECTS );
+         }
+         template<typename Signature>
+         static fc::variant param_to_variant( const std::function<Signature>& )
+         {
+            return fc::variant( "callback" );
+         }
+
+         /// Records the call when it goes out of scope, whether the call returns or throws
+         template<typename... Args>
+         struct call_recorder
+         {
+            api_profiler&                    profiler;
+            const std::shared_ptr<method_counters>& counters;
+            const method_key&                method;
+            const std::tuple<const Args&...> params;
+            const fc::time_point             start = fc::time_point::now();
+
+            ~call_recorder()
+            {
+               const uint64_t time_us = ( fc::time_point::now() - start ).count();
+               const bool failed = std::uncaught_exception();
+               if( !profiler.record( *counters, time_us, failed ) )
+                  return;
+               try
+               {
+                  profiler.record_slow_call( method, start, time_us, failed,
+                                             params_to_variants( std::index_sequence_for<Args...>() ) );
+               }
+               catch( ... )
+               {
+                  // the parameters could not be converted, the call is in the statistics nonetheless
+               }
+            }
+
+            template<size_t... I>
+            fc::variants params_to_variants( std::index_sequence<I...> )const
+            {
+               return fc::variants{ param_to_variant( std::get<I>( params ) )... };
+            }
+         };
+
+         struct method_wrapper
+         {
+            std::shared_ptr<api_profiler> profiler;
+            std::string                   api_name;
+
+            template<typename Result, typename... Args>
+            void operator()( const char* name, std::function<Result(Args...)>& method )const
+            {
+               auto counters = profiler->counters_of( api_name, name );
+               auto profiler_ptr = profiler;
+               auto key = std::make_shared<const method_key>( api_name, name );
+               std::function<Result(Args...)> call = method;
+               method = [profiler_ptr, counters, key, call]( Args... args ) -> Result {
+                  call_recorder<Args...> recorder{ *profiler_ptr, counters, *key, std::tie( args... ) };
+                  return call( args... );
+               };
+            }
+         };
+
+         std::shared_ptr<method_counters> counters_of( const std::string& api_name, const std::string& method );
+         /** @return whether the call is slow */
+         bool record( method_counters& counters, uint64_t time_us, bool failed );
+         void record_slow_call( const method_key& method, fc::time_point start, uint64_t time_us, bool failed,
+                                fc::variants&& params );
+
+         const uint64_t                                         _slow_call_threshold_us;
+         mutable std::mutex                                     _mutex;
+         std::map< method_key, std::shared_ptr<method_counters> > _counters;
+         std::deque<slow_api_call>                              _slow_calls;
+   };
+
+} } // graphene::app
+
+FC_REFLECT( graphene::app::api_method_statistics,
+            (api)(method)(calls)(failures)(total_time_us)(max_time_us)(latency_histogram) )
+FC_REFLECT( graphene::app::slow_api_call, (time)(api)(method)(params)(time_us)(failed) )
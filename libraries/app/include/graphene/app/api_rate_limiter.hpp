@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace graphene { namespace app {
+
+   /// The budget of API call costs of one connection or client address, refilled continuously. Full until used.
+   struct api_token_bucket
+   {
+      double         tokens = 0;
+      fc::time_point last_refill;
+   };
+
+   struct api_rate_limit_statistics
+   {
+      uint64_t admitted_calls = 0;
+      uint64_t delayed_calls = 0;
+      uint64_t rejected_calls = 0;
+      uint64_t total_delay_ms = 0;
+      uint64_t tracked_addresses = 0; ///< client addresses with a budget in use
+   };
+
+   /**
+    *  Limits the cost of the API calls each connection and each client address may make per second. Every
+    *  method costs 1 unless configured otherwise, the heavy lookups cost more by default. Each connection and
+    *  client address has a token bucket holding up to burst units, refilled with rate units per second.
+    *
+    *  A call exceeding the budget is rejected, or with the delay policy it waits until the budget allows it, as
+    *  long as that takes at most max_delay_ms. Waiting calls take their units in advance, so that the calls
+    *  arriving meanwhile queue up behind them.
+    *
+    *  The address of a client is only known if the node runs behind a proxy putting it into a request header,
+    *  see api-rate-limit-address-header, otherwise only the connections are limited.
+    *
+    *  Shared by the connections of all clients.
+    */
+   class api_rate_limiter
+   {
+      public:
+         enum class policy_type { reject, delay };
+
+         struct options_type
+         {
+            double      connection_rate = 0;   ///< units per second per connection, 0 for no limit
+            double      connection_burst = 0;
+            double      address_rate = 0;      ///< units per second per client address, 0 for no limit
+            double      address_burst = 0;
+            policy_type policy = policy_type::reject;
+            uint32_t    max_delay_ms = 1000;
+            /// Costs overriding the defaults, by method name
+            std::map<std::string, uint32_t> method_costs;
+         };
+
+         explicit api_rate_limiter( options_type options );
+
+         uint32_t cost_of( const std::string& method )const;
+
+         /**
+          * Charges cost to the bucket of the connection and to that of address, empty if unknown. Throws if the
+          * call is rejected, waits first if the call is delayed.
+          */
+         void admit( api_token_bucket& connection, const std::string& address, uint32_t cost );
+
+         api_rate_limit_statistics get_statistics()const;
+
+      private:
+         /**
+          * Refills bucket up to now.
+          * @return the microseconds until bucket holds cost units, negative if the call is to be rejected
+          */
+         int64_t time_until_available( api_token_bucket& bucket, double rate, double burst, uint32_t cost,
+                                       fc::time_point now )const;
+         /** Drops the address buckets which have been refilled completely */
+         void prune_addresses( fc::time_point now );
+
+         const options_type                       _options;
+         mutable std::mutex                       _mutex;
+         std::map<std::string, api_token_bucket>  _addresses;
+         fc::time_point                           _last_prune;
+         api_rate_limit_statistics                _statistics;
+   };
+
+} } // graphene::app
+
+FC_REFLECT( graphene::app::api_rate_limit_statistics,
+            (admitted_calls)(delayed_calls)(rejected_calls)(total_delay_ms)(tracked_addresses) )
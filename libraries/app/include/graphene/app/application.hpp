@@ -24,9 +24,16 @@
 #pragma once
 
 #include <graphene/app/api_access.hpp>
+#include <graphene/app/api_profiler.hpp>
+#include <graphene/app/block_tracer.hpp>
+#include <graphene/app/api_rate_limiter.hpp>
+#include <graphene/app/full_account_cache.hpp>
+#include <graphene/app/subscription_registry.hpp>
 #include <graphene/net/node.hpp>
 #include <graphene/chain/database.hpp>
 
+#include <fc/thread/thread.hpp>
+
 #include <boost/program_options.hpp>
 
 namespace graphene { namespace app {
@@ -56,6 +63,23 @@ namespace graphene { namespace app {
          uint64_t api_limit_get_limit_orders = 300;
          uint64_t api_limit_get_order_book = 50;
          uint64_t api_limit_list_htlcs = 100;
+         uint64_t api_limit_get_object_digests = 0;
+         uint64_t api_limit_get_changed_objects = 1000;
+         uint64_t api_limit_stream_blocks = 10000;
+         uint64_t api_limit_block_streams = 4;
+         uint64_t api_limit_get_applied_operations = 100;
+   };
+
+   /**
+    * Checkpoints published by a party the node operator trusts, read from the file given in checkpoint-file.
+    * The signature is a compact signature of digest() by the key given in checkpoint-file-signer.
+    */
+   struct signed_checkpoints
+   {
+      boost::container::flat_map< uint32_t, graphene::chain::block_id_type > checkpoints;
+      fc::optional< fc::ecc::compact_signature >                            signature;
+
+      fc::sha256 digest()const { return fc::sha256::hash( fc::raw::pack( checkpoints ) ); }
    };
 
    class application
@@ -113,11 +137,27 @@ namespace graphene { namespace app {
 
          net::node_ptr                    p2p_node();
          std::shared_ptr<chain::database> chain_database()const;
+         /// @return the cache shared by the database APIs of all connections, null if it is disabled
+         std::shared_ptr<full_account_cache> get_full_account_cache()const;
+         /// @return the registry of the subscriptions of all connections to changed objects
+         std::shared_ptr<subscription_registry> get_subscription_registry()const;
+         /// @return the profiler of the API calls of all connections, null if enable-api-profiling is not set
+         std::shared_ptr<api_profiler> get_api_profiler()const;
+         /// @return the tracer of the blocks handled during normal operation, null if block tracing is not enabled
+         std::shared_ptr<block_tracer> get_block_tracer()const;
+         /// @return the limiter of the API calls of all connections, null if no api-rate-limit is set
+         std::shared_ptr<api_rate_limiter> get_api_rate_limiter()const;
          void set_api_limit();
          void set_block_production(bool producing_blocks);
          fc::optional< api_access_info > get_api_access_info( const string& username )const;
          void set_api_access_info(const string& username, api_access_info&& permissions);
 
+         /**
+          * Checks trx and applies it to the pending state of the chain database. With relay-only set, only
+          * the checks that need no pending state and the recovery of the signature keys are done.
+          */
+         void push_transaction( const chain::precomputable_transaction& trx );
+
          bool is_finished_syncing()const;
          /// Emitted when syncing finishes (is_finished_syncing will return true)
          boost::signals2::signal<void()> syncing_finished;
@@ -130,6 +170,40 @@ namespace graphene { namespace app {
 
          std::shared_ptr<fc::thread> elasticsearch_thread;
 
+         /**
+          * Runs the read-only API call f in one of the api-worker-threads while holding the read lock of the
+          * chain database, so that the call does not occupy the thread processing blocks and other API calls.
+          * In an API batch the read scope of the batch is the lock. Without workers f runs directly in the
+          * calling thread.
+          */
+         template<typename Functor>
+         auto run_read_only_api_call( Functor&& f ) -> decltype( f() )
+         {
+            std::shared_ptr<fc::thread> worker = next_api_worker_thread();
+            if( !worker )
+               return f();
+            const std::shared_ptr<chain::database> db = chain_database();
+            if( db->in_read_scope() )
+            {
+               chain::database::suspend_read_scope suspend( *db );
+               return worker->async( [&f]() { return f(); }, "read-only api call" ).wait();
+            }
+            return worker->async( [&f, &db]() {
+               // other calls queued in this worker go on while a writer holds the lock
+               auto lock = db->yielding_read_lock();
+               return f();
+            }, "read-only api call" ).wait();
+         }
+         /// @return the thread to run the next read-only API call in, null if no api-worker-threads are configured
+         std::shared_ptr<fc::thread> next_api_worker_thread();
+
+         /**
+          * Executes the calls of an API batch in a read scope of the chain database, so that all of them see the
+          * same state. The other API calls and the read-only calls of the batch go on meanwhile, no block is
+          * applied until the batch completes and the calls of the batch can not push transactions.
+          */
+         void run_api_batch( const std::function<void()>& batch );
+
    private:
          void add_available_plugin( std::shared_ptr<abstract_plugin> p );
          std::shared_ptr<detail::application_impl> my;
@@ -139,3 +213,5 @@ namespace graphene { namespace app {
    };
 
 } }
+
+FC_REFLECT( graphene::app::signed_checkpoints, (checkpoints)(signature) )
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/filesystem.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace graphene { namespace app {
+
+   /// The time spent in the stages of handling one block received during normal operation, in microseconds
+   struct block_trace
+   {
+      uint32_t           block_num = 0;
+      fc::time_point_sec timestamp;           ///< of the block
+      uint32_t           transactions = 0;
+      fc::time_point     start;               ///< when the application started handling the block
+      int64_t            delay_us = 0;        ///< from the block timestamp to start
+      int64_t            precompute_us = 0;   ///< precomputing the transactions and signatures of the block
+      int64_t            queue_us = 0;        ///< waiting for the blocks received before it to be pushed
+      int64_t            header_us = 0;
+      int64_t            transactions_us = 0;
+      int64_t            block_updates_us = 0;
+      int64_t            maintenance_us = 0;
+      int64_t            expiry_us = 0;
+      int64_t            batched_indexes_us = 0;
+      int64_t            applied_block_us = 0; ///< applied_block handlers of the plugins and the APIs
+      int64_t            changed_objects_us = 0;
+      int64_t            undo_us = 0;         ///< the rest of push_block: undo session, fork database, block storage
+      int64_t            total_us = 0;        ///< from start to the end of push_block
+   };
+
+   /// Latency of one stage of handling blocks over the recent blocks
+   struct block_stage_statistics
+   {
+      std::string stage;
+      uint64_t    blocks = 0;
+      int64_t     average_us = 0;
+      int64_t     max_us = 0;
+      /// Number of blocks taking less than 100us, 1ms, 10ms, 100ms, 1s and longer in the stage
+      std::vector<uint64_t> latency_histogram;
+   };
+
+   /**
+    *  Keeps the traces of the last blocks handled during normal operation, @see application_impl::handle_block.
+    *  The statistics are computed over these blocks only, so that they follow the current behaviour of the node.
+    *
+    *  If a trace file is given, the stages of each block are also appended to it as Chrome trace events, which can
+    *  be loaded into chrome://tracing or Perfetto. The stages inside push_block are laid out back to back in the
+    *  order they run, the undo and block storage work at both ends of push_block is shown last.
+    *
+    *  Only created if block-tracing or block-trace-file is set.
+    */
+   class block_tracer
+   {
+      public:
+         static const size_t histogram_buckets = 6;
+
+         /**
+          * @param window number of recent blocks kept
+          * @param slow_block_threshold_ms log the stages of blocks taking at least this long to handle, 0 for none
+          * @param trace_file file to write Chrome trace events to, empty for none
+          */
+         block_tracer( uint32_t window, uint32_t slow_block_threshold_ms, const fc::path& trace_file );
+         ~block_tracer();
+
+         void record( const block_trace& trace );
+
+         std::vector<block_stage_statistics> get_statistics()const;
+         /** @return up to limit traces, most recent first */
+         std::vector<block_trace> get_recent_blocks( uint32_t limit )const;
+         void reset();
+
+      private:
+         void write_trace_events( const block_trace& trace );
+
+         const size_t            _window;
+         const int64_t           _slow_block_threshold_us;
+         mutable std::mutex      _mutex;
+         std::deque<block_trace> _blocks;
+         std::ofstream           _trace_file;
+   };
+
+} } // graphene::app
+
+FC_REFLECT( graphene::app::block_trace,
+            (block_num)(timestamp)(transactions)(start)(delay_us)(precompute_us)(queue_us)(header_us)
+            (transactions_us)(block_updates_us)(maintenance_us)(expiry_us)(batched_indexes_us)(applied_block_us)
+            (changed_objects_us)(undo_us)(total_us) )
+FC_REFLECT( graphene::app::block_stage_statistics, (stage)(blocks)(average_us)(max_us)(latency_histogram) )
@@ -24,6 +24,7 @@
 #pragma once
 
 #include <graphene/app/api_objects.hpp>
+#include <graphene/app/full_account_cache.hpp>
 
 #include <graphene/protocol/types.hpp>
 
@@ -58,6 +59,7 @@ using std::vector;
 using std::map;
 
 class database_api_impl;
+class subscription_registry;
 
 /**
  * @brief The database_api class implements the RPC API for the chain database.
@@ -69,7 +71,13 @@ class database_api_impl;
 class database_api
 {
    public:
-      database_api(graphene::chain::database& db, const application_options* app_options = nullptr );
+      /**
+       * @param full_accounts   cache of get_full_accounts results shared with other connections, may be null
+       * @param subscriptions   registry of the object subscriptions of all connections, a private one if null
+       */
+      database_api( graphene::chain::database& db, const application_options* app_options = nullptr,
+                    std::shared_ptr<full_account_cache> full_accounts = nullptr,
+                    std::shared_ptr<subscription_registry> subscriptions = nullptr );
       ~database_api();
 
       /////////////
@@ -91,6 +99,71 @@ class database_api
       fc::variants get_objects( const vector<object_id_type>& ids,
                                 optional<bool> subscribe = optional<bool>() )const;
 
+      /**
+       * @brief Get the objects corresponding to the provided IDs unless the client already has their current version
+       * @param ids IDs of the objects to retrieve
+       * @param known_versions the versions of the objects the client has, by position in ids, 0 or a missing
+       *                       entry for an unknown one
+       * @param subscribe same as in @ref get_objects
+       * @return The versions of the objects, in the order they are mentioned in ids, with the objects that
+       *         changed since the known version
+       *
+       * The version of an object changes whenever it is modified, it is not persistent across objects. Objects
+       * with the known version are not serialized again, which makes polling the same objects cheap.
+       * Like @ref get_objects, the changes made by pending transactions are visible.
+       */
+      vector<versioned_object> get_objects_if_changed( const vector<object_id_type>& ids,
+                                                       const vector<uint64_t>& known_versions,
+                                                       optional<bool> subscribe = optional<bool>() )const;
+
+      /**
+       * @brief Get the objects corresponding to the provided IDs as of the head block
+       * @param ids IDs of the objects to retrieve
+       * @return The objects retrieved, in the order they are mentioned in ids
+       *
+       * Unlike @ref get_objects, changes made by pending transactions which are not yet included in a block
+       * are not visible, so all returned objects consistently reflect the state after the head block.
+       * This function does not subscribe.
+       *
+       * If any of the provided IDs does not map to an object, a null variant is returned in its position.
+       */
+      fc::variants get_objects_at_head_block( const vector<object_id_type>& ids )const;
+
+      /**
+       * @brief Get the hashes of ranges of the objects of an index as of the head block
+       * @param space_id space of the index
+       * @param type_id type of the index
+       * @param first first instance of the range to hash
+       * @param last end of the range to hash, 0 for the next instance of the index
+       * @param parts number of equal parts to split the range into, must not exceed 256
+       * @return The digests of the parts
+       *
+       * Two nodes split the same range in the same way. Descending into the parts whose digests differ
+       * locates the objects in which their states differ in a logarithmic number of calls.
+       * The range must not exceed api-limit-get-object-digests instances.
+       */
+      vector<object_range_digest> get_object_digests( uint8_t space_id, uint8_t type_id, uint64_t first,
+                                                      uint64_t last, uint32_t parts )const;
+
+      /**
+       * @brief Get the objects of a range of an index that changed after a block
+       * @param space_id space of the index
+       * @param type_id type of the index
+       * @param first first instance of the range
+       * @param last end of the range, 0 for the next instance of the index
+       * @param since number of a block, objects that did not change after it are left out. This is the stamp of
+       *        an earlier result to poll for changes, or 0 for all objects changed since the node started
+       * @return The objects created or modified after since, as of the head block, and the stamp to pass next time
+       *
+       * Every object remembers the number of the block it was last created or modified in. After a switch to
+       * another fork, objects are stamped with numbers above the popped blocks, so that no change is missed;
+       * the stamp is then ahead of the head block number. Removed objects are not reported.
+       * At most api-limit-get-changed-objects instances are examined, if the range is larger the result tells
+       * where to continue.
+       */
+      changed_objects get_objects_changed_since( uint8_t space_id, uint8_t type_id, uint64_t first, uint64_t last,
+                                                 uint32_t since )const;
+
       ///////////////////
       // Subscriptions //
       ///////////////////
@@ -127,17 +200,34 @@ class database_api
       /**
        * @brief Register a callback handle which will get notified when a transaction is pushed to database
        * @param cb The callback handle to register
+       * @param filter if given, only the transactions matching all of its non-empty criteria are notified
        *
        * Note: a transaction can be pushed to database and be popped from database several times while
        *   processing, before and after included in a block. Everytime when a push is done, the client will
        *   be notified.
        */
-      void set_pending_transaction_callback( std::function<void(const variant& signed_transaction_object)> cb );
+      void set_pending_transaction_callback( std::function<void(const variant& signed_transaction_object)> cb,
+                                             optional<pending_transaction_filter> filter
+                                                = optional<pending_transaction_filter>() );
       /**
        * @brief Register a callback handle which will get notified when a block is pushed to database
        * @param cb The callback handle to register
        */
       void set_block_applied_callback( std::function<void(const variant& block_id)> cb );
+      /**
+       * @brief Register a callback handle which will get notified of the operations applied by each block
+       * @param cb The callback handle to register, an empty one stops the notifications. It is called with an
+       *           @ref applied_operations_notice for each block, containing the virtual operations as well,
+       *           which does not need the account_history plugin.
+       * @param start_block_num the first block to notify about, to resume after a reconnection. The operations
+       *                        of the last 100 blocks are kept once anybody registered. If omitted, only blocks
+       *                        applied from now on are notified.
+       *
+       * Note: after a chain reorganization the blocks of the new fork are notified with the numbers of the
+       *   blocks they replace, which can be told apart by their IDs.
+       */
+      void set_applied_operations_callback( std::function<void(const variant&)> cb,
+                                            optional<uint32_t> start_block_num = optional<uint32_t>() );
       /**
        * @brief Stop receiving any notifications
        *
@@ -167,6 +257,9 @@ class database_api
        * @brief Retrieve a full, signed block
        * @param block_num Height of the block to be returned
        * @return the referenced block, or null if no matching block was found
+       *
+       * Throws if the block has been pruned from the block database of this node, see the
+       * block-log-retain-blocks option.
        */
       optional<signed_block> get_block(uint32_t block_num)const;
 
@@ -217,6 +310,39 @@ class database_api
        */
       dynamic_global_property_object get_dynamic_global_properties()const;
 
+      /**
+       * @brief Retrieve the approximate memory consumption of all object indexes
+       * @return one entry per index with its object count, the bytes used for storing its objects and
+       *         the bytes used by its secondary indexes
+       *
+       * The numbers are estimates, memory owned by members of objects (e.g. strings) is not included.
+       */
+      vector<graphene::db::index_memory_usage> get_index_memory_usage()const;
+
+      /**
+       * @brief Retrieve how long the phases of the recent chain maintenances took on this node
+       * @return the timings of up to the last 10 maintenances since the node started, oldest first
+       *
+       * Durations are wall clock microseconds measured while applying the maintenance block.
+       */
+      vector<maintenance_timing> get_maintenance_timings()const;
+
+      /**
+       * @brief Retrieve the size of the undo history of this node
+       * @return the number of undo states, their approximate memory use and the configured limit
+       *
+       * The undo history holds the blocks since the last irreversible block and the pending transactions, it grows
+       * when blocks do not become irreversible, e.g. while many witnesses miss their blocks.
+       */
+      graphene::db::undo_history_usage get_undo_history_usage()const;
+
+      /**
+       * @brief Retrieve how well the results of get_full_accounts are cached on this node
+       * @return the size and the hit, miss and invalidation counts since the node started,
+       *         all zero if the api-full-account-cache-size option is not set
+       */
+      full_account_cache_statistics get_full_account_cache_statistics()const;
+
       //////////
       // Keys //
       //////////
@@ -263,6 +389,17 @@ class database_api
       vector<optional<account_object>> get_accounts( const vector<std::string>& account_names_or_ids,
                                                      optional<bool> subscribe = optional<bool>() )const;
 
+      /**
+       * @brief Get a list of accounts by names or IDs unless the client already has their current version
+       * @param account_names_or_ids names or IDs of the accounts to retrieve
+       * @param known_versions the versions of the accounts the client has, @see get_objects_if_changed
+       * @param subscribe same as in @ref get_accounts
+       * @return The versions of the accounts, with the accounts that changed since the known version
+       */
+      vector<versioned_object> get_accounts_if_changed( const vector<std::string>& account_names_or_ids,
+                                                        const vector<uint64_t>& known_versions,
+                                                        optional<bool> subscribe = optional<bool>() )const;
+
       /**
        * @brief Fetch all objects relevant to the specified accounts and optionally subscribe to updates
        * @param names_or_ids Each item must be the name or ID of an account to retrieve
@@ -318,6 +455,17 @@ class database_api
                                                    uint32_t limit,
                                                    optional<bool> subscribe = optional<bool>() )const;
 
+      /**
+       * @brief Get names and IDs of the registered accounts whose names start with a prefix
+       * @param prefix Prefix of the names to return, an empty prefix matches all accounts
+       * @param limit Maximum number of results to return -- must not exceed 1000
+       * @return Map of account names to corresponding IDs, ordered by name
+       *
+       * Unlike @ref lookup_accounts this stops at the last matching name, so that a name completion does not
+       * have to filter the results. This API does not subscribe to the returned accounts.
+       */
+      map<string,account_id_type> lookup_accounts_by_prefix( const string& prefix, uint32_t limit )const;
+
       //////////////
       // Balances //
       //////////////
@@ -393,6 +541,16 @@ class database_api
        */
       vector<extended_asset_object> list_assets(const string& lower_bound_symbol, uint32_t limit)const;
 
+      /**
+       * @brief Get symbols and IDs of the assets whose symbols start with a prefix
+       * @param prefix Prefix of the symbols to return, an empty prefix matches all assets
+       * @param limit Maximum number of results to return (must not exceed 101)
+       * @return Map of asset symbols to corresponding IDs, ordered by symbol
+       *
+       * This returns no asset objects, call @ref lookup_asset_symbols for the details of a chosen asset.
+       */
+      map<string,asset_id_type> lookup_asset_symbols_by_prefix( const string& prefix, uint32_t limit )const;
+
       /**
        * @brief Get a list of assets by symbol names or IDs
        * @param symbols_or_ids symbol names or IDs of the assets to retrieve
@@ -535,6 +693,49 @@ class database_api
        */
       void unsubscribe_from_market( const std::string& a, const std::string& b );
 
+      /**
+       * @brief Request the changes of the order book of the market base:quote, aggregated by price
+       * @param callback Callback method which is called with a @ref market_depth_update for each block
+       *                 which changed the limit orders of the market or filled orders in it
+       * @param base symbol name or ID of the base asset
+       * @param quote symbol name or ID of the quote asset
+       *
+       * The sequence of the updates increases by one from one update of the market to the next. Apply the
+       * updates with a higher sequence than the one of a @ref get_market_depth snapshot to it, replacing the
+       * levels at the prices of the update. On a gap in the sequence, fetch the missed updates with
+       * @ref get_market_depth_updates, or a new snapshot.
+       */
+      void subscribe_to_market_depth( std::function<void(const variant&)> callback,
+                                      const string& base, const string& quote );
+
+      /**
+       * @brief Unsubscribe from the changes of the order book of the market base:quote
+       * @param base symbol name or ID of the base asset
+       * @param quote symbol name or ID of the quote asset
+       */
+      void unsubscribe_from_market_depth( const string& base, const string& quote );
+
+      /**
+       * @brief Returns the limit orders of the market base:quote aggregated by price
+       * @param base symbol name or ID of the base asset
+       * @param quote symbol name or ID of the quote asset
+       * @param limit number of price levels to retrieve, for bids and asks each, capped at 50
+       * @return The price levels and the sequence of the last @ref market_depth_update they include
+       */
+      market_depth_snapshot get_market_depth( const string& base, const string& quote, unsigned limit = 50 )const;
+
+      /**
+       * @brief Returns the recent changes of the order book of the market base:quote
+       * @param base symbol name or ID of the base asset
+       * @param quote symbol name or ID of the quote asset
+       * @param since_sequence sequence of the last update the caller has applied
+       * @return The updates after since_sequence, in order
+       *
+       * Only the latest 100 updates are kept, and only while the market depth is subscribed to.
+       */
+      vector<market_depth_update> get_market_depth_updates( const string& base, const string& quote,
+                                                            uint64_t since_sequence )const;
+
       /**
        * @brief Returns the ticker for the market assetA:assetB
        * @param base symbol name or ID of the base asset
@@ -573,6 +774,7 @@ class database_api
        * Note: Currently, timezone offsets are not supported. The time must be UTC. The range is [stop, start).
        *       In case when there are more than 100 trades occurred in the same second, this API only returns
        *       the first 100 records, can use another API @ref get_trade_history_by_sequence to query for the rest.
+       *       The sequence of the last trade returned is the cursor to pass to it.
        * @param base symbol or ID of the base asset
        * @param quote symbol or ID of the quote asset
        * @param start Start time as a UNIX timestamp, the latest trade to retrieve
@@ -633,6 +835,16 @@ class database_api
        */
       uint64_t get_witness_count()const;
 
+      /**
+       * @brief Get the witnesses scheduled to produce the next blocks
+       * @param limit Maximum number of slots to return
+       * @return The time of each upcoming slot and the witness scheduled for it, starting with the next slot
+       *
+       * The witnesses are shuffled again at the end of each round, so no more slots are returned than there are
+       * blocks left in the current round. A slot is skipped if its witness does not produce a block.
+       */
+      vector<std::pair<fc::time_point_sec, witness_id_type>> get_upcoming_witnesses( uint32_t limit )const;
+
       ///////////////////////
       // Committee members //
       ///////////////////////
@@ -797,9 +1009,9 @@ class database_api
 
       /**
        * @brief return a set of proposed transactions (aka proposals) that the specified account
-       *        can add approval to or remove approval from
+       *        proposed, or can add approval to or remove approval from
        * @param account_name_or_id The name or ID of an account
-       * @return a set of proposed transactions that the specified account can act on
+       * @return a set of proposed transactions that the specified account created or can act on
        */
       vector<proposal_object> get_proposed_transactions( const std::string account_name_or_id )const;
 
@@ -898,12 +1110,17 @@ extern template class fc::api<graphene::app::database_api>;
 FC_API(graphene::app::database_api,
    // Objects
    (get_objects)
+   (get_objects_if_changed)
+   (get_objects_at_head_block)
+   (get_object_digests)
+   (get_objects_changed_since)
 
    // Subscriptions
    (set_subscribe_callback)
    (set_auto_subscription)
    (set_pending_transaction_callback)
    (set_block_applied_callback)
+   (set_applied_operations_callback)
    (cancel_all_subscriptions)
 
    // Blocks and transactions
@@ -919,6 +1136,10 @@ FC_API(graphene::app::database_api,
    (get_config)
    (get_chain_id)
    (get_dynamic_global_properties)
+   (get_index_memory_usage)
+   (get_maintenance_timings)
+   (get_undo_history_usage)
+   (get_full_account_cache_statistics)
 
    // Keys
    (get_key_references)
@@ -927,11 +1148,13 @@ FC_API(graphene::app::database_api,
    // Accounts
    (get_account_id_from_string)
    (get_accounts)
+   (get_accounts_if_changed)
    (get_full_accounts)
    (get_account_by_name)
    (get_account_references)
    (lookup_account_names)
    (lookup_accounts)
+   (lookup_accounts_by_prefix)
    (get_account_count)
 
    // Balances
@@ -945,6 +1168,7 @@ FC_API(graphene::app::database_api,
    (get_assets)
    (list_assets)
    (lookup_asset_symbols)
+   (lookup_asset_symbols_by_prefix)
    (get_asset_count)
    (get_assets_by_issuer)
    (get_asset_id_from_string)
@@ -961,6 +1185,10 @@ FC_API(graphene::app::database_api,
    (get_collateral_bids)
    (subscribe_to_market)
    (unsubscribe_from_market)
+   (subscribe_to_market_depth)
+   (unsubscribe_from_market_depth)
+   (get_market_depth)
+   (get_market_depth_updates)
    (get_ticker)
    (get_24_volume)
    (get_top_markets)
@@ -972,6 +1200,7 @@ FC_API(graphene::app::database_api,
    (get_witness_by_account)
    (lookup_witness_accounts)
    (get_witness_count)
+   (get_upcoming_witnesses)
 
    // Committee members
    (get_committee_members)
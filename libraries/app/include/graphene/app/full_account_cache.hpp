@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/app/api_objects.hpp>
+
+#include <graphene/chain/database.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/signals2/connection.hpp>
+
+#include <map>
+
+namespace graphene { namespace app {
+
+   struct full_account_cache_statistics
+   {
+      uint64_t capacity = 0;      ///< maximum number of accounts kept, 0 if the cache is disabled
+      uint64_t size = 0;          ///< number of accounts kept
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t invalidations = 0; ///< entries dropped because objects of the account have changed
+   };
+
+   /**
+    *  Remembers the results of database_api::get_full_accounts per account for all API connections. An entry is
+    *  dropped when the new_objects, changed_objects or removed_objects signals report the account as impacted or
+    *  report an object the entry contains, and when a pending transaction impacts the account. Entries built
+    *  while transactions were pending are dropped with the next block, because the pending state is rebuilt then.
+    *  Changes a pending transaction makes to accounts it does not name, e.g. filled orders of another account,
+    *  show up with the block including it. The least recently used entries are dropped when the cache is full.
+    *
+    *  The votes of an entry are not cached, since the voted-for objects change with every block.
+    *
+    *  Only to be used in the thread applying blocks.
+    */
+   class full_account_cache
+   {
+      public:
+         full_account_cache( graphene::chain::database& db, size_t capacity );
+
+         /** @return the cached result for account, null if there is none; valid until the cache is changed */
+         const full_account* find( account_id_type account );
+         void insert( const full_account& result );
+
+         full_account_cache_statistics get_statistics()const;
+
+      private:
+         struct entry
+         {
+            account_id_type account;
+            full_account    result;
+            /// Whether transactions were pending while result was built
+            bool            uses_pending_state = false;
+         };
+         struct by_account;
+         typedef boost::multi_index_container<
+            entry,
+            boost::multi_index::indexed_by<
+               boost::multi_index::sequenced<>, // most recently used first
+               boost::multi_index::ordered_unique< boost::multi_index::tag<by_account>,
+                  boost::multi_index::member< entry, account_id_type, &entry::account > >
+            >
+         > entry_index_type;
+
+         static vector<object_id_type> contained_objects( const full_account& result );
+         void erase( entry_index_type::iterator itr );
+         void invalidate( account_id_type account );
+         void invalidate( const flat_set<account_id_type>& accounts );
+         /** Drops the entries containing one of ids, and those of the accounts proposals in ids are listed for */
+         void invalidate_objects( const vector<object_id_type>& ids, const vector<const object*>& objs );
+         void on_applied_block( const signed_block& block );
+
+         graphene::chain::database&  _db;
+         const size_t                _capacity;
+         entry_index_type            _entries;
+         /// The accounts of the entries containing each object
+         std::map< object_id_type, flat_set<account_id_type> > _accounts_by_object;
+
+         /// Whether transactions were pushed since the last block
+         bool                        _pending_state = false;
+         block_id_type               _head_block_id;
+
+         uint64_t                    _hits = 0;
+         uint64_t                    _misses = 0;
+         uint64_t                    _invalidations = 0;
+
+         boost::signals2::scoped_connection _new_connection;
+         boost::signals2::scoped_connection _change_connection;
+         boost::signals2::scoped_connection _removed_connection;
+         boost::signals2::scoped_connection _applied_block_connection;
+         boost::signals2::scoped_connection _pending_trx_connection;
+   };
+
+} } // graphene::app
+
+FC_REFLECT( graphene::app::full_account_cache_statistics, (capacity)(size)(hits)(misses)(invalidations) )
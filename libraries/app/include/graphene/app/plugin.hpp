@@ -24,6 +24,7 @@
 #pragma once
 
 #include <graphene/app/application.hpp>
+#include <graphene/chain/operation_history_object.hpp>
 
 #include <boost/program_options.hpp>
 #include <fc/io/json.hpp>
@@ -88,8 +89,52 @@ class abstract_plugin
          boost::program_options::options_description& command_line_options,
          boost::program_options::options_description& config_file_options
          ) = 0;
+
+      /**
+       * @brief Drop the state of the plugin to build it again from the operation history
+       *
+       * This rebuilds the plugin without replaying the chain. After startup the plugin is given the operations
+       * applied in every block with operations, from the first one to the head block, with
+       * @ref plugin_rebuild_block, then @ref plugin_rebuild_end is called. The undo database is disabled
+       * meanwhile.
+       *
+       * @return false if the state of the plugin can not be built from operations alone
+       */
+      virtual bool plugin_rebuild_start() = 0;
+      /// @brief Process the operations applied in a block, as the plugin does when the block is applied
+      virtual void plugin_rebuild_block( uint32_t block_num, fc::time_point_sec block_time,
+                                         const std::vector<graphene::chain::operation_history_object>& ops ) = 0;
+      virtual void plugin_rebuild_end() = 0;
+};
+
+/// What a block consumer of a plugin gets of an applied block, see @ref plugin::consume_blocks
+struct applied_block_data
+{
+   signed_block                                  block;
+   /// The operations applied in the block, as returned by database::get_applied_operations
+   vector< optional< chain::operation_history_object > > operations;
+   /// When the block was handed to the consumer
+   fc::time_point                                queued;
+};
+
+/// Statistics of the block consumer of a plugin
+struct block_consumer_metrics
+{
+   uint64_t         blocks_processed = 0;
+   uint64_t         blocks_failed = 0;
+   /// Blocks waiting to be processed
+   uint32_t         backlog = 0;
+   uint32_t         max_backlog = 0;
+   /// How often block application waited for the consumer because the queue was full
+   uint64_t         queue_full_waits = 0;
+   fc::microseconds total_processing_time;
+   fc::microseconds max_processing_time;
+   /// Longest time a block waited in the queue
+   fc::microseconds max_queue_time;
 };
 
+namespace detail { class block_consumer; }
+
 /**
  * Provides basic default implementations of abstract_plugin functions.
  */
@@ -110,14 +155,42 @@ class plugin : public abstract_plugin
          boost::program_options::options_description& command_line_options,
          boost::program_options::options_description& config_file_options
          ) override;
+      virtual bool plugin_rebuild_start() override;
+      virtual void plugin_rebuild_block( uint32_t block_num, fc::time_point_sec block_time,
+                                         const std::vector<graphene::chain::operation_history_object>& ops ) override;
+      virtual void plugin_rebuild_end() override;
 
       chain::database& database() { return *app().chain_database(); }
       application& app()const { assert(_app); return *_app; }
+
+      /// @return the statistics of the block consumer, all 0 if the plugin has none, see @ref consume_blocks
+      block_consumer_metrics get_block_consumer_metrics()const;
    protected:
       net::node& p2p_node() { return *app().p2p_node(); }
 
+      /**
+       * @brief Process the applied blocks on the worker thread of the block consumer of this plugin
+       *
+       * Connects to the applied_block signal of the database. The block and its applied operations are copied
+       * to a queue, which handler works off one block at a time in block order, so the block application does
+       * not wait for the plugin. The handler must not access the database, it only gets the copies. Once
+       * max_queue_size blocks are waiting, the block application waits until the handler took the next one.
+       * An exception thrown by the handler is logged and counted, the next blocks are processed anyway.
+       *
+       * Call this once, in plugin_initialize.
+       */
+      void consume_blocks( std::function<void( const applied_block_data& )> handler, uint32_t max_queue_size = 100 );
+      /**
+       * @brief Wait until the blocks queued are processed and stop the block consumer
+       *
+       * Plugins with a block consumer call this in plugin_shutdown, before they release what the handler uses.
+       */
+      void stop_consuming_blocks();
+
    private:
       application* _app = nullptr;
+      std::shared_ptr<detail::block_consumer> _block_consumer;
+      boost::signals2::scoped_connection _block_consumer_connection;
 };
 
 /// @group Some useful tools for boost::program_options arguments using vectors of JSON strings
@@ -145,3 +218,7 @@ if( options.count(name) ) { \
 /// @}
 
 } } //graphene::app
+
+FC_REFLECT( graphene::app::block_consumer_metrics,
+            (blocks_processed)(blocks_failed)(backlog)(max_backlog)(queue_full_waits)
+            (total_processing_time)(max_processing_time)(max_queue_time) )
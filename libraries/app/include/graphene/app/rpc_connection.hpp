@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/app/api_rate_limiter.hpp>
+
+#include <fc/rpc/websocket_api.hpp>
+
+#include <functional>
+#include <memory>
+
+namespace graphene { namespace app {
+
+   /**
+    *  The API connection of a websocket or HTTP client of the node. On top of the websocket_api_connection it
+    *  extends, it
+    *  - accepts JSON-RPC batches, arrays of requests which are answered with one array of responses. The
+    *    requests of a batch are executed one after the other by the batch executor, which the node uses to keep
+    *    blocks from being applied in between, so that all of them see the same head block. Each request is
+    *    answered, with its error if it fails.
+    *  - executes the requests arriving over a websocket concurrently, up to max_pipelined_calls, so that a slow
+    *    call does not hold up the requests sent after it. Their responses are sent as they are ready, clients
+    *    match them to the requests by id.
+    *  - encodes the messages with fc::raw instead of JSON text if the client selects it by sending the request
+    *    header encoding_header with the value encoding_name when opening the connection. Each message then is
+    *    one fc::raw packed variant, holding what would otherwise be sent as JSON, in base64 so that it can be
+    *    sent in a websocket text frame.
+    *  - charges the cost of each call to the budget of the connection and the client address if a rate limiter
+    *    is given. A batch is charged as a whole before it is executed.
+    */
+   class rpc_connection : public fc::rpc::websocket_api_connection
+   {
+      public:
+         static const char* const encoding_header;
+         static const char* const encoding_name;
+         static const size_t max_batch_size = 100;
+         static const uint32_t max_pipelined_calls = 20;
+
+         typedef std::function<void( const std::function<void()>& )> batch_executor_type;
+
+         rpc_connection( const std::shared_ptr<fc::http::websocket_connection>& c, uint32_t max_conversion_depth,
+                         bool binary = false, batch_executor_type batch_executor = batch_executor_type(),
+                         std::shared_ptr<api_rate_limiter> rate_limiter = nullptr,
+                         std::string client_address = std::string() );
+
+         virtual fc::variant send_call( fc::api_id_type api_id, std::string method_name,
+                                        fc::variants args = fc::variants() ) override;
+         virtual fc::variant send_callback( uint64_t callback_id, fc::variants args = fc::variants() ) override;
+         virtual void        send_notice( uint64_t callback_id, fc::variants args = fc::variants() ) override;
+
+         /// The fc::raw encoding of the messages, in base64
+         ///@{
+         static std::string encode_binary( const fc::variant& message, uint32_t max_depth );
+         static fc::variant decode_binary( const std::string& message, uint32_t max_depth );
+         ///@}
+
+      private:
+         std::string encode( const fc::variant& message )const;
+         fc::variant decode( const std::string& message )const;
+
+         /** @return the encoded response to message, empty if the message does not need one */
+         std::string on_rpc_message( const std::string& message, bool send_reply );
+         /** @return the response to a decoded message or batch, nothing if it does not need one */
+         fc::optional<fc::variant> handle_rpc_message( const fc::variant& message );
+         /**
+          * @param charge whether to charge the call to the rate limit budgets
+          * @return the response to a request with an id, nothing for notices and responses
+          */
+         fc::optional<fc::variant> handle_message( const fc::variant& message, bool charge );
+         /** @return the rate limit cost of message, 0 if it is a response */
+         uint32_t cost_of( const fc::variant& message )const;
+
+         const uint32_t      _max_depth;
+         const bool          _binary;
+         batch_executor_type _batch_executor;
+         uint32_t            _calls_in_progress = 0;
+
+         const std::shared_ptr<api_rate_limiter> _rate_limiter;
+         const std::string   _client_address;
+         api_token_bucket    _call_budget;
+   };
+
+} } // graphene::app
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/app/api_objects.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/market_object.hpp>
+
+#include <boost/signals2/connection.hpp>
+
+#include <array>
+#include <deque>
+#include <map>
+
+namespace graphene { namespace app {
+   using namespace graphene::chain;
+
+   class database_api_impl;
+
+   typedef std::pair<asset_id_type, asset_id_type> market_type;
+   typedef std::map< market_type, std::vector<fc::variant> > market_queue_type;
+
+   /**
+    *  Tracks which database API sessions are subscribed to which objects, accounts, markets and pending
+    *  transactions, and hands the objects reported by the new_objects, changed_objects and removed_objects
+    *  signals, the filled orders of applied blocks and the pending transactions to the interested sessions only.
+    *  Each object, operation and transaction is converted to a variant once, however many sessions receive it,
+    *  and the sessions share the storage of that variant. A pending transaction that matches the filter of no
+    *  session is not converted at all.
+    *
+    *  For the markets with market depth subscribers, the limit order price levels changed by a block and the
+    *  trades of the block are collected into one market_depth_update, which is formatted once for each
+    *  orientation of the market that is subscribed to. The last max_market_depth_history updates of each such
+    *  market are kept, so that clients detecting a gap in the sequence numbers can catch up.
+    *
+    *  Once a session has subscribed to the applied operations, the applied_operations_notice of the last
+    *  max_applied_operations_history blocks are kept, so that a client reconnecting can resume where it stopped.
+    *
+    *  A session subscribed to an account impacted by a signal receives all objects of the signal, and a session
+    *  notified of created and removed objects receives all objects of those signals. A session subscribing to
+    *  more than max_objects_per_session objects loses its oldest object subscriptions.
+    *
+    *  Shared by the database APIs of all connections, only to be used in the thread applying blocks.
+    */
+   class subscription_registry : public std::enable_shared_from_this<subscription_registry>
+   {
+      public:
+         explicit subscription_registry( graphene::chain::database& db );
+
+         static const size_t max_objects_per_session = 10000;
+         static const size_t max_market_depth_history = 100;
+         static const size_t max_applied_operations_history = 100;
+
+         void subscribe_to_object( const database_api_impl* session, object_id_type id );
+         void subscribe_to_account( const database_api_impl* session, account_id_type account );
+         void set_notify_remove_create( const database_api_impl* session, bool enable );
+         /** @param market the assets of the market, ordered by id */
+         void subscribe_to_market( const database_api_impl* session, const market_type& market );
+         void unsubscribe_from_market( const database_api_impl* session, const market_type& market );
+         void unsubscribe_from_all_markets( const database_api_impl* session );
+         /** @param filter if given, the session only receives the transactions matching it */
+         void set_pending_transaction_subscriber( const database_api_impl* session, bool enable,
+                                                  const optional<pending_transaction_filter>& filter
+                                                     = optional<pending_transaction_filter>() );
+         /** @param base_quote the base and the quote asset of the market_depth_update the session receives */
+         void subscribe_to_market_depth( const database_api_impl* session, const market_type& base_quote );
+         void unsubscribe_from_market_depth( const database_api_impl* session, const market_type& base_quote );
+         void unsubscribe_from_all_market_depths( const database_api_impl* session );
+         void set_applied_operations_subscriber( const database_api_impl* session, bool enable );
+         /** Removes the object, account and create/remove subscriptions of session */
+         void unsubscribe_all( const database_api_impl* session );
+         /** Forgets session, to be called before it is destroyed */
+         void remove_session( const database_api_impl* session );
+
+         /** @return the number of distinct objects subscribed to by any session */
+         size_t subscribed_object_count()const { return _object_subscribers.size(); }
+
+         /**
+          *  @return the limit orders of the market base:quote aggregated by price, up to limit levels per side, as
+          *  of the last update flushed; the current book with sequence 0 if there is none yet
+          */
+         market_depth_snapshot get_market_depth( const asset_object& base, const asset_object& quote,
+                                                 unsigned limit )const;
+         /**
+          *  @return the updates of the market base:quote with a sequence above since_sequence, the market must
+          *  have market depth subscribers and since_sequence must not be older than the kept updates
+          */
+         vector<market_depth_update> get_market_depth_updates( const asset_object& base, const asset_object& quote,
+                                                               uint64_t since_sequence )const;
+         /**
+          *  @return the kept applied_operations_notice of the blocks from start_block_num on, start_block_num
+          *  must not be older than the kept blocks unless it is above the head block
+          */
+         vector<variant> get_applied_operations( uint32_t start_block_num )const;
+
+      private:
+         typedef flat_set<const database_api_impl*> session_set;
+         struct session_subscriptions
+         {
+            /// oldest first
+            std::deque<object_id_type> objects;
+            vector<account_id_type>    accounts;
+         };
+
+         /** @param objects the objects of ids, null ones are skipped when full objects are sent */
+         void dispatch( bool is_remove_create, bool full_object, const vector<object_id_type>& ids,
+                        const vector<const object*>& objects, const flat_set<account_id_type>& impacted_accounts );
+         void dispatch_market_changes( bool full_object, const vector<const object*>& objects );
+         void dispatch_market_queue( const market_queue_type& queue );
+         void on_applied_block( const signed_block& block );
+         void dispatch_applied_operations( const signed_block& block );
+         void on_pending_transaction( const signed_transaction& trx );
+         struct pending_transaction_summary;
+
+         /// The total of the limit orders at one price, selling sell_price.base
+         struct depth_level
+         {
+            price      sell_price;
+            share_type for_sale;
+            share_type receives;
+         };
+         /// A market_depth_update before formatting, the levels are indexed by the asset sold, first or second
+         struct depth_delta
+         {
+            uint64_t                              sequence = 0;
+            uint32_t                              block_num = 0;
+            time_point_sec                        time;
+            bool                                  full = false;
+            std::array<vector<depth_level>, 2>    levels;
+            vector<fill_order_operation>          fills;
+         };
+         struct market_depth_state
+         {
+            uint64_t                                             sequence = 0;
+            /// Whether the whole book is to be sent, after a chain reorganization
+            bool                                                 reset = false;
+            std::array<std::map<price_sort_key, price>, 2>       touched_levels;
+            /// The levels touched since the last flush, as of the end of the block that last touched them
+            std::array<std::map<price_sort_key, depth_level>, 2> levels;
+            /// Whether levels holds the whole book
+            bool                                                 full = false;
+            uint32_t                                             block_num = 0;
+            time_point_sec                                       time;
+            vector<fill_order_operation>                         fills;
+            std::deque<depth_delta>                              history;
+            /// The whole book as of the last update flushed, known from the first full update on
+            std::array<std::map<price_sort_key, depth_level>, 2> book;
+            bool                                                 book_known = false;
+            uint32_t                                             book_block_num = 0;
+         };
+
+         void touch_market_depth( const limit_order_object& order );
+         /** Computes the touched levels from the state of the block that is being applied. Runs in the signals of
+          *  the block, later tasks would see the pending transactions or a newer block.
+          */
+         void snapshot_market_depths();
+         void schedule_market_depth_flush();
+         /** Turns the changes collected since the last flush into one update per market and delivers them */
+         void flush_market_depths();
+         depth_level get_depth_level( const limit_order_book_index::book_type& book, const price_sort_key& key,
+                                      const price& sell_price )const;
+         vector<depth_level> get_depth_levels( const limit_order_book_index::book_type& book, unsigned limit )const;
+         market_depth_update format_depth_delta( const depth_delta& delta, const asset_object& base,
+                                                 const asset_object& quote )const;
+         static market_type ordered_market( const market_type& market );
+         static order format_depth_level( const depth_level& level, bool is_bid, const asset_object& base,
+                                          const asset_object& quote );
+
+         template<typename T>
+         market_type get_order_market( const T& order )const
+         {
+            return order.get_market();
+         }
+
+         market_type get_order_market( const force_settlement_object& order )const
+         {
+            // TODO cache the result to avoid repeatly fetching from db
+            asset_id_type backing_id = order.balance.asset_id( _db ).bitasset_data( _db ).options.short_backing_asset;
+            auto tmp = std::make_pair( order.balance.asset_id, backing_id );
+            if( tmp.first > tmp.second ) std::swap( tmp.first, tmp.second );
+            return tmp;
+         }
+
+         template<typename T>
+         void enqueue_if_subscribed_to_market( const object* obj, market_queue_type& queue, bool full_object )const
+         {
+            const T* order = dynamic_cast<const T*>( obj );
+            FC_ASSERT( order != nullptr );
+            const market_type market = get_order_market( *order );
+            if( _market_subscribers.find( market ) != _market_subscribers.end() )
+               queue[market].emplace_back( full_object ? obj->to_variant() : fc::variant( obj->id, 1 ) );
+         }
+
+         graphene::chain::database&                    _db;
+         std::map<object_id_type, session_set>         _object_subscribers;
+         std::map<account_id_type, session_set>        _account_subscribers;
+         session_set                                   _remove_create_subscribers;
+         /// Sessions receiving all pending transactions
+         session_set                                   _pending_transaction_subscribers;
+         std::map<const database_api_impl*, pending_transaction_filter> _filtered_pending_transaction_subscribers;
+         session_set                                   _applied_operations_subscribers;
+         /// Whether the applied operations are kept, from the first subscription on
+         bool                                          _keep_applied_operations = false;
+         /// The block numbers and applied_operations_notice of the last blocks
+         std::deque< std::pair<uint32_t, variant> >    _applied_operations_history;
+         std::map<market_type, session_set>            _market_subscribers;
+         std::map<const database_api_impl*, flat_set<market_type>> _session_markets;
+         /// Keyed by the base and the quote asset the sessions receive the updates for
+         std::map<market_type, session_set>            _market_depth_subscribers;
+         std::map<const database_api_impl*, flat_set<market_type>> _session_market_depths;
+         /// Keyed by the assets of the market, ordered by id
+         std::map<market_type, market_depth_state>     _market_depths;
+         bool                                          _market_depth_flush_scheduled = false;
+         block_id_type                                 _head_block_id;
+         std::map<const database_api_impl*, session_subscriptions> _sessions;
+
+         boost::signals2::scoped_connection _new_connection;
+         boost::signals2::scoped_connection _change_connection;
+         boost::signals2::scoped_connection _removed_connection;
+         boost::signals2::scoped_connection _applied_block_connection;
+         boost::signals2::scoped_connection _pending_trx_connection;
+   };
+
+} } // graphene::app
@@ -25,8 +25,140 @@
 #include <graphene/app/plugin.hpp>
 #include <graphene/protocol/fee_schedule.hpp>
 
+#include <fc/thread/thread.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
 namespace graphene { namespace app {
 
+namespace detail {
+
+/**
+ * The queue and the worker thread of @ref plugin::consume_blocks. The threads block on a condition variable
+ * instead of waiting on fc futures, because the applied_block handlers must not yield.
+ */
+class block_consumer
+{
+   public:
+      block_consumer( const std::string& name, std::function<void( const applied_block_data& )> handler,
+                      uint32_t max_queue_size )
+      : _name( name ), _handler( std::move( handler ) ), _max_queue_size( std::max( 1u, max_queue_size ) ),
+        _thread( name + " blocks" )
+      {
+         _worker = _thread.async( [this]() { run(); }, "block consumer" );
+      }
+
+      ~block_consumer()
+      {
+         stop();
+      }
+
+      void push( const signed_block& b, const vector< optional< chain::operation_history_object > >& ops )
+      {
+         std::unique_lock<std::mutex> lock( _mutex );
+         if( _stopping )
+            return;
+         if( _queue.size() >= _max_queue_size )
+         {
+            ++_metrics.queue_full_waits;
+            _space.wait( lock, [this]() { return _queue.size() < _max_queue_size || _stopping; } );
+         }
+         _queue.push_back( applied_block_data{ b, ops, fc::time_point::now() } );
+         _metrics.backlog = _queue.size();
+         _metrics.max_backlog = std::max( _metrics.max_backlog, _metrics.backlog );
+         _work.notify_one();
+      }
+
+      /// processes the blocks queued, then ends the worker
+      void stop()
+      {
+         {
+            std::lock_guard<std::mutex> guard( _mutex );
+            _stopping = true;
+         }
+         _work.notify_one();
+         _space.notify_all();
+         if( _worker.valid() )
+         {
+            _worker.wait();
+            _worker = fc::future<void>();
+            _thread.quit();
+         }
+      }
+
+      block_consumer_metrics metrics()const
+      {
+         std::lock_guard<std::mutex> guard( _mutex );
+         return _metrics;
+      }
+
+   private:
+      void run()
+      {
+         while( true )
+         {
+            applied_block_data data;
+            {
+               std::unique_lock<std::mutex> lock( _mutex );
+               _work.wait( lock, [this]() { return !_queue.empty() || _stopping; } );
+               if( _queue.empty() )
+                  return;
+               data = std::move( _queue.front() );
+               _queue.pop_front();
+               _metrics.backlog = _queue.size();
+            }
+            _space.notify_one();
+
+            const fc::time_point start = fc::time_point::now();
+            bool failed = true;
+            try
+            {
+               _handler( data );
+               failed = false;
+            }
+            catch( const fc::exception& e )
+            {
+               elog( "Plugin ${p} failed to process block ${b}: ${e}",
+                     ("p",_name)("b",data.block.block_num())("e",e.to_detail_string()) );
+            }
+            catch( const std::exception& e )
+            {
+               elog( "Plugin ${p} failed to process block ${b}: ${e}",
+                     ("p",_name)("b",data.block.block_num())("e",e.what()) );
+            }
+            const fc::microseconds took = fc::time_point::now() - start;
+
+            std::lock_guard<std::mutex> guard( _mutex );
+            if( failed )
+               ++_metrics.blocks_failed;
+            else
+               ++_metrics.blocks_processed;
+            _metrics.total_processing_time += took;
+            _metrics.max_processing_time = std::max( _metrics.max_processing_time, took );
+            _metrics.max_queue_time = std::max( _metrics.max_queue_time, start - data.queued );
+         }
+      }
+
+      const std::string                                 _name;
+      const std::function<void( const applied_block_data& )> _handler;
+      const uint32_t                                    _max_queue_size;
+      fc::thread                                        _thread;
+      fc::future<void>                                  _worker;
+
+      mutable std::mutex                                _mutex;
+      /// signalled when a block is queued or the consumer stops
+      std::condition_variable                           _work;
+      /// signalled when a block is taken from a full queue
+      std::condition_variable                           _space;
+      std::deque<applied_block_data>                    _queue;
+      bool                                              _stopping = false;
+      block_consumer_metrics                            _metrics;
+};
+
+} // detail
+
 plugin::plugin()
 {
    _app = nullptr;
@@ -35,7 +167,7 @@ plugin::plugin()
 
 plugin::~plugin()
 {
-   return;
+   stop_consuming_blocks();
 }
 
 std::string plugin::plugin_name()const
@@ -69,6 +201,45 @@ void plugin::plugin_set_app( application* app )
    return;
 }
 
+bool plugin::plugin_rebuild_start()
+{
+   return false;
+}
+
+void plugin::plugin_rebuild_block( uint32_t block_num, fc::time_point_sec block_time,
+                                   const std::vector<graphene::chain::operation_history_object>& ops )
+{
+   return;
+}
+
+void plugin::plugin_rebuild_end()
+{
+   return;
+}
+
+void plugin::consume_blocks( std::function<void( const applied_block_data& )> handler, uint32_t max_queue_size )
+{
+   FC_ASSERT( !_block_consumer, "Plugin ${p} consumes blocks already", ("p",plugin_name()) );
+   _block_consumer = std::make_shared<detail::block_consumer>( plugin_name(), std::move( handler ), max_queue_size );
+   _block_consumer_connection = database().applied_block.connect( [this]( const signed_block& b ) {
+      _block_consumer->push( b, database().get_applied_operations() );
+   } );
+}
+
+void plugin::stop_consuming_blocks()
+{
+   _block_consumer_connection.disconnect();
+   if( _block_consumer )
+      _block_consumer->stop();
+}
+
+block_consumer_metrics plugin::get_block_consumer_metrics()const
+{
+   if( !_block_consumer )
+      return block_consumer_metrics();
+   return _block_consumer->metrics();
+}
+
 void plugin::plugin_set_program_options(
    boost::program_options::options_description& command_line_options,
    boost::program_options::options_description& config_file_options
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/rpc_connection.hpp>
+
+#include <fc/crypto/base64.hpp>
+#include <fc/io/datastream.hpp>
+#include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/io/raw_variant.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/variant_object.hpp>
+
+namespace graphene { namespace app {
+
+const char* const rpc_connection::encoding_header = "X-Graphene-RPC-Encoding";
+const char* const rpc_connection::encoding_name = "fc-raw";
+
+rpc_connection::rpc_connection( const std::shared_ptr<fc::http::websocket_connection>& c,
+                                uint32_t max_conversion_depth, bool binary, batch_executor_type batch_executor,
+                                std::shared_ptr<api_rate_limiter> rate_limiter, std::string client_address )
+: fc::rpc::websocket_api_connection( c, max_conversion_depth ), _max_depth( max_conversion_depth ),
+  _binary( binary ), _batch_executor( std::move(batch_executor) ), _rate_limiter( std::move(rate_limiter) ),
+  _client_address( std::move(client_address) )
+{
+   // replace the handlers installed by the base class, the RPC methods it registered are reused
+   _connection->on_message_handler( [this]( const std::string& msg ) {
+      if( _calls_in_progress >= max_pipelined_calls )
+      {
+         on_rpc_message( msg, true );
+         return;
+      }
+      ++_calls_in_progress;
+      auto self = shared_from_this();
+      fc::async( [this, self, msg]() {
+         try
+         {
+            on_rpc_message( msg, true );
+         }
+         catch( ... )
+         {
+            --_calls_in_progress;
+            throw;
+         }
+         --_calls_in_progress;
+      }, "api call" );
+   });
+   _connection->on_http_handler( [this]( const std::string& msg ){ return on_rpc_message( msg, false ); } );
+}
+
+std::string rpc_connection::encode_binary( const fc::variant& message, uint32_t max_depth )
+{
+   const std::vector<char> data = fc::raw::pack( message, max_depth );
+   // websocket text frames have to be valid UTF-8, clients close the connection on other data
+   return fc::base64_encode( reinterpret_cast<const unsigned char*>( data.data() ), data.size() );
+}
+
+fc::variant rpc_connection::decode_binary( const std::string& message, uint32_t max_depth )
+{
+   const std::string data = fc::base64_decode( message );
+   // the decoder skips what it does not understand, only the canonical encoding of the data is accepted
+   FC_ASSERT( fc::base64_encode( data ) == message, "The message is not valid base64" );
+   fc::datastream<const char*> ds( data.data(), data.size() );
+   fc::variant result;
+   fc::raw::unpack( ds, result, max_depth );
+   FC_ASSERT( ds.remaining() == 0, "Unexpected data after the message" );
+   return result;
+}
+
+std::string rpc_connection::encode( const fc::variant& message )const
+{
+   if( _binary )
+      return encode_binary( message, _max_depth );
+   return fc::json::to_string( message, fc::json::stringify_large_ints_and_doubles, _max_depth );
+}
+
+fc::variant rpc_connection::decode( const std::string& message )const
+{
+   if( _binary )
+      return decode_binary( message, _max_depth );
+   return fc::json::from_string( message, fc::json::legacy_parser, _max_depth );
+}
+
+fc::variant rpc_connection::send_call( fc::api_id_type api_id, std::string method_name, fc::variants args )
+{
+   auto request = _rpc_state.start_remote_call( "call", { api_id, std::move(method_name), std::move(args) } );
+   _connection->send_message( encode( fc::variant( request, _max_depth ) ) );
+   return _rpc_state.wait_for_response( *request.id );
+}
+
+fc::variant rpc_connection::send_callback( uint64_t callback_id, fc::variants args )
+{
+   auto request = _rpc_state.start_remote_call( "callback", { callback_id, std::move(args) } );
+   _connection->send_message( encode( fc::variant( request, _max_depth ) ) );
+   return _rpc_state.wait_for_response( *request.id );
+}
+
+void rpc_connection::send_notice( uint64_t callback_id, fc::variants args )
+{
+   fc::rpc::request request{ fc::optional<uint64_t>(), "notice", { callback_id, std::move(args) } };
+   _connection->send_message( encode( fc::variant( request, _max_depth ) ) );
+}
+
+uint32_t rpc_connection::cost_of( const fc::variant& message )const
+{
+   // an invalid item of a batch is answered with an error without being called
+   if( !message.is_object() )
+      return 0;
+   const fc::variant_object& obj = message.get_object();
+   auto method = obj.find( "method" );
+   if( method == obj.end() )
+      return 0;
+   // calls of the APIs other than the first are sent as "call" with the API id and the method name
+   auto params = obj.find( "params" );
+   if( method->value().as_string() == "call" && params != obj.end() && params->value().is_array()
+         && params->value().get_array().size() >= 2 && params->value().get_array()[1].is_string() )
+      return _rate_limiter->cost_of( params->value().get_array()[1].get_string() );
+   return _rate_limiter->cost_of( method->value().as_string() );
+}
+
+fc::optional<fc::variant> rpc_connection::handle_message( const fc::variant& message, bool charge )
+{
+   if( !message.get_object().contains( "method" ) )
+   {
+      _rpc_state.handle_reply( message.as<fc::rpc::response>( _max_depth ) );
+      return fc::optional<fc::variant>();
+   }
+
+   const auto call = message.as<fc::rpc::request>( _max_depth );
+   fc::exception_ptr optexcept;
+   try
+   {
+      try
+      {
+         if( charge && _rate_limiter )
+            _rate_limiter->admit( _call_budget, _client_address, cost_of( message ) );
+         fc::variant result = _rpc_state.local_call( call.method, call.params );
+         if( !call.id )
+            return fc::optional<fc::variant>();
+         // the same as converting an fc::rpc::response, which would copy the result twice
+         fc::mutable_variant_object response;
+         response.set( "id", fc::variant( *call.id ) );
+         response.set( "result", std::move( result ) );
+         return fc::variant( std::move( response ) );
+      }
+      FC_CAPTURE_AND_RETHROW( (call.method)(call.params) )
+   }
+   catch( const fc::exception& e )
+   {
+      if( call.id )
+         optexcept = e.dynamic_copy_exception();
+   }
+   if( !optexcept )
+      return fc::optional<fc::variant>();
+   const fc::rpc::error_object error{ 1, optexcept->to_string(), fc::variant( *optexcept, _max_depth ) };
+   return fc::variant( fc::rpc::response( *call.id, error ), _max_depth );
+}
+
+std::string rpc_connection::on_rpc_message( const std::string& message, bool send_reply )
+{
+   try
+   {
+      std::string encoded;
+      {
+         // the reply is released before it is sent, so that only the encoded copy of a large result is kept
+         const fc::optional<fc::variant> reply = handle_rpc_message( decode( message ) );
+         if( !reply.valid() )
+            return encoded;
+         encoded = encode( *reply );
+      }
+      if( send_reply )
+         _connection->send_message( encoded );
+      return encoded;
+   }
+   catch( const fc::exception& e )
+   {
+      wdump( (e.to_detail_string()) );
+      return e.to_detail_string();
+   }
+}
+
+fc::optional<fc::variant> rpc_connection::handle_rpc_message( const fc::variant& message )
+{
+   if( !message.is_array() )
+      return handle_message( message, true );
+
+   const fc::variants& batch = message.get_array();
+   FC_ASSERT( !batch.empty() && batch.size() <= max_batch_size,
+              "A batch must contain 1 to ${max} requests", ("max",max_batch_size) );
+   if( _rate_limiter )
+   {
+      uint32_t cost = 0;
+      for( const fc::variant& item : batch )
+         cost += cost_of( item );
+      _rate_limiter->admit( _call_budget, _client_address, cost );
+   }
+   fc::variants responses;
+   responses.reserve( batch.size() );
+   auto execute_batch = [this, &batch, &responses]() {
+      for( const fc::variant& item : batch )
+      {
+         // the errors of the calls are already answered by handle_message, these are of invalid items
+         try
+         {
+            fc::optional<fc::variant> response = handle_message( item, false );
+            if( response.valid() )
+               responses.push_back( std::move( *response ) );
+         }
+         catch( const fc::exception& e )
+         {
+            fc::mutable_variant_object response;
+            response.set( "id", item.is_object() && item.get_object().contains( "id" ) ? item.get_object()["id"]
+                                                                                      : fc::variant() );
+            response.set( "error", fc::variant( fc::rpc::error_object{ 1, e.to_string(),
+                                                                       fc::variant( e, _max_depth ) }, _max_depth ) );
+            responses.push_back( fc::variant( std::move( response ) ) );
+         }
+      }
+   };
+   if( _batch_executor )
+      _batch_executor( execute_batch );
+   else
+      execute_batch();
+   if( responses.empty() )
+      return fc::optional<fc::variant>();
+   return fc::variant( std::move( responses ) );
+}
+
+} } // graphene::app
@@ -0,0 +1,779 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/subscription_registry.hpp>
+
+#include <graphene/app/util.hpp>
+
+#include <graphene/chain/impacted.hpp>
+
+#include "database_api_impl.hxx"
+
+#include <fc/thread/thread.hpp>
+
+namespace graphene { namespace app {
+
+namespace {
+   /// Collects the assets an operation moves, trades, manages or pays its fee in
+   struct operation_assets_visitor
+   {
+      typedef void result_type;
+
+      flat_set<asset_id_type>& assets;
+      explicit operation_assets_visitor( flat_set<asset_id_type>& a ) : assets( a ) {}
+
+      template<typename Op>
+      void operator()( const Op& op )const { assets.insert( op.fee.asset_id ); }
+
+      void operator()( const transfer_operation& op )const { add( op, op.amount.asset_id ); }
+      void operator()( const override_transfer_operation& op )const { add( op, op.amount.asset_id ); }
+      void operator()( const limit_order_create_operation& op )const
+      {
+         add( op, op.amount_to_sell.asset_id, op.min_to_receive.asset_id );
+      }
+      void operator()( const call_order_update_operation& op )const
+      {
+         add( op, op.delta_collateral.asset_id, op.delta_debt.asset_id );
+      }
+      void operator()( const bid_collateral_operation& op )const
+      {
+         add( op, op.additional_collateral.asset_id, op.debt_covered.asset_id );
+      }
+      void operator()( const asset_update_operation& op )const { add( op, op.asset_to_update ); }
+      void operator()( const asset_update_issuer_operation& op )const { add( op, op.asset_to_update ); }
+      void operator()( const asset_update_bitasset_operation& op )const { add( op, op.asset_to_update ); }
+      void operator()( const asset_update_feed_producers_operation& op )const { add( op, op.asset_to_update ); }
+      void operator()( const asset_issue_operation& op )const { add( op, op.asset_to_issue.asset_id ); }
+      void operator()( const asset_reserve_operation& op )const { add( op, op.amount_to_reserve.asset_id ); }
+      void operator()( const asset_fund_fee_pool_operation& op )const { add( op, op.asset_id ); }
+      void operator()( const asset_settle_operation& op )const { add( op, op.amount.asset_id ); }
+      void operator()( const asset_global_settle_operation& op )const { add( op, op.asset_to_settle ); }
+      void operator()( const asset_publish_feed_operation& op )const { add( op, op.asset_id ); }
+      void operator()( const asset_claim_fees_operation& op )const { add( op, op.amount_to_claim.asset_id ); }
+      void operator()( const asset_claim_pool_operation& op )const { add( op, op.asset_id ); }
+      void operator()( const htlc_create_operation& op )const { add( op, op.amount.asset_id ); }
+      void operator()( const vesting_balance_create_operation& op )const { add( op, op.amount.asset_id ); }
+      void operator()( const withdraw_permission_create_operation& op )const
+      {
+         add( op, op.withdrawal_limit.asset_id );
+      }
+
+   private:
+      template<typename Op>
+      void add( const Op& op, asset_id_type a )const
+      {
+         assets.insert( op.fee.asset_id );
+         assets.insert( a );
+      }
+      template<typename Op>
+      void add( const Op& op, asset_id_type a, asset_id_type b )const
+      {
+         add( op, a );
+         assets.insert( b );
+      }
+   };
+
+   /// @return true if wanted is empty or shares an item with present
+   template<typename T>
+   bool passes( const flat_set<T>& wanted, const flat_set<T>& present )
+   {
+      if( wanted.empty() )
+         return true;
+      for( const T& item : wanted )
+         if( present.find( item ) != present.end() )
+            return true;
+      return false;
+   }
+}
+
+/// What a pending transaction is matched against filters by, collected once for all sessions
+struct subscription_registry::pending_transaction_summary
+{
+   flat_set<account_id_type> accounts;
+   flat_set<int64_t>         operation_types;
+   flat_set<asset_id_type>   assets;
+
+   explicit pending_transaction_summary( const signed_transaction& trx )
+   {
+      transaction_get_impacted_accounts( trx, accounts );
+      const operation_assets_visitor visitor( assets );
+      for( const operation& op : trx.operations )
+      {
+         operation_types.insert( op.which() );
+         op.visit( visitor );
+      }
+   }
+
+   bool matches( const pending_transaction_filter& filter )const
+   {
+      return passes( filter.accounts, accounts ) && passes( filter.operation_types, operation_types )
+             && passes( filter.assets, assets );
+   }
+};
+
+subscription_registry::subscription_registry( graphene::chain::database& db ) : _db( db )
+{
+   _new_connection = _db.new_objects.connect( [this]( const vector<object_id_type>& ids,
+                                                      const flat_set<account_id_type>& impacted_accounts ) {
+      vector<const object*> objects;
+      objects.reserve( ids.size() );
+      for( const object_id_type& id : ids )
+         objects.push_back( _db.find_object( id ) );
+      dispatch( true, true, ids, objects, impacted_accounts );
+   });
+   _change_connection = _db.changed_objects.connect( [this]( const vector<object_id_type>& ids,
+                                                             const flat_set<account_id_type>& impacted_accounts ) {
+      vector<const object*> objects;
+      objects.reserve( ids.size() );
+      for( const object_id_type& id : ids )
+         objects.push_back( _db.find_object( id ) );
+      dispatch( false, true, ids, objects, impacted_accounts );
+   });
+   _removed_connection = _db.removed_objects.connect( [this]( const vector<object_id_type>& ids,
+                                                              const vector<const object*>& objs,
+                                                              const flat_set<account_id_type>& impacted_accounts ) {
+      dispatch( true, false, ids, objs, impacted_accounts );
+   });
+   _applied_block_connection = _db.applied_block.connect( [this]( const signed_block& b ) { on_applied_block( b ); } );
+   _pending_trx_connection = _db.on_pending_transaction.connect( [this]( const signed_transaction& trx ) {
+      on_pending_transaction( trx );
+   });
+}
+
+void subscription_registry::subscribe_to_object( const database_api_impl* session, object_id_type id )
+{
+   session_subscriptions& subscriptions = _sessions[session];
+   if( !_object_subscribers[id].insert( session ).second )
+      return;
+   subscriptions.objects.push_back( id );
+   if( subscriptions.objects.size() > max_objects_per_session )
+   {
+      auto subscribers = _object_subscribers.find( subscriptions.objects.front() );
+      subscribers->second.erase( session );
+      if( subscribers->second.empty() )
+         _object_subscribers.erase( subscribers );
+      subscriptions.objects.pop_front();
+   }
+}
+
+void subscription_registry::subscribe_to_account( const database_api_impl* session, account_id_type account )
+{
+   if( _account_subscribers[account].insert( session ).second )
+      _sessions[session].accounts.push_back( account );
+}
+
+void subscription_registry::set_notify_remove_create( const database_api_impl* session, bool enable )
+{
+   if( enable )
+      _remove_create_subscribers.insert( session );
+   else
+      _remove_create_subscribers.erase( session );
+}
+
+void subscription_registry::subscribe_to_market( const database_api_impl* session, const market_type& market )
+{
+   _market_subscribers[market].insert( session );
+   _session_markets[session].insert( market );
+}
+
+void subscription_registry::unsubscribe_from_market( const database_api_impl* session, const market_type& market )
+{
+   auto subscribers = _market_subscribers.find( market );
+   if( subscribers != _market_subscribers.end() )
+   {
+      subscribers->second.erase( session );
+      if( subscribers->second.empty() )
+         _market_subscribers.erase( subscribers );
+   }
+   auto markets = _session_markets.find( session );
+   if( markets != _session_markets.end() )
+   {
+      markets->second.erase( market );
+      if( markets->second.empty() )
+         _session_markets.erase( markets );
+   }
+}
+
+void subscription_registry::unsubscribe_from_all_markets( const database_api_impl* session )
+{
+   auto markets = _session_markets.find( session );
+   if( markets == _session_markets.end() )
+      return;
+   for( const market_type& market : markets->second )
+   {
+      auto subscribers = _market_subscribers.find( market );
+      subscribers->second.erase( session );
+      if( subscribers->second.empty() )
+         _market_subscribers.erase( subscribers );
+   }
+   _session_markets.erase( markets );
+}
+
+void subscription_registry::set_pending_transaction_subscriber( const database_api_impl* session, bool enable,
+                                                                const optional<pending_transaction_filter>& filter )
+{
+   _pending_transaction_subscribers.erase( session );
+   _filtered_pending_transaction_subscribers.erase( session );
+   if( !enable )
+      return;
+   if( filter.valid() )
+      _filtered_pending_transaction_subscribers[session] = *filter;
+   else
+      _pending_transaction_subscribers.insert( session );
+}
+
+void subscription_registry::set_applied_operations_subscriber( const database_api_impl* session, bool enable )
+{
+   if( enable )
+   {
+      _applied_operations_subscribers.insert( session );
+      _keep_applied_operations = true;
+   }
+   else
+      _applied_operations_subscribers.erase( session );
+}
+
+vector<variant> subscription_registry::get_applied_operations( uint32_t start_block_num )const
+{
+   vector<variant> result;
+   if( start_block_num > _db.head_block_num() )
+      return result;
+   FC_ASSERT( !_applied_operations_history.empty() && start_block_num >= _applied_operations_history.front().first,
+              "The operations of block ${n} are no longer available",
+              ("n",start_block_num) );
+   for( const auto& item : _applied_operations_history )
+      if( item.first >= start_block_num )
+         result.push_back( item.second );
+   return result;
+}
+
+void subscription_registry::unsubscribe_all( const database_api_impl* session )
+{
+   _remove_create_subscribers.erase( session );
+
+   auto itr = _sessions.find( session );
+   if( itr == _sessions.end() )
+      return;
+   for( const object_id_type& id : itr->second.objects )
+   {
+      auto subscribers = _object_subscribers.find( id );
+      subscribers->second.erase( session );
+      if( subscribers->second.empty() )
+         _object_subscribers.erase( subscribers );
+   }
+   for( const account_id_type& account : itr->second.accounts )
+   {
+      auto subscribers = _account_subscribers.find( account );
+      subscribers->second.erase( session );
+      if( subscribers->second.empty() )
+         _account_subscribers.erase( subscribers );
+   }
+   _sessions.erase( itr );
+}
+
+void subscription_registry::remove_session( const database_api_impl* session )
+{
+   unsubscribe_all( session );
+   unsubscribe_from_all_markets( session );
+   unsubscribe_from_all_market_depths( session );
+   _pending_transaction_subscribers.erase( session );
+   _filtered_pending_transaction_subscribers.erase( session );
+   _applied_operations_subscribers.erase( session );
+}
+
+market_type subscription_registry::ordered_market( const market_type& market )
+{
+   if( market.first > market.second )
+      return std::make_pair( market.second, market.first );
+   return market;
+}
+
+void subscription_registry::subscribe_to_market_depth( const database_api_impl* session,
+                                                       const market_type& base_quote )
+{
+   _market_depth_subscribers[base_quote].insert( session );
+   _session_market_depths[session].insert( base_quote );
+   // the first update holds the whole book, snapshots are taken from it on
+   auto inserted = _market_depths.emplace( ordered_market( base_quote ), market_depth_state() );
+   if( inserted.second )
+      inserted.first->second.reset = true;
+   if( _head_block_id == block_id_type() )
+      _head_block_id = _db.head_block_id();
+}
+
+void subscription_registry::unsubscribe_from_market_depth( const database_api_impl* session,
+                                                           const market_type& base_quote )
+{
+   auto subscribers = _market_depth_subscribers.find( base_quote );
+   if( subscribers == _market_depth_subscribers.end() || subscribers->second.erase( session ) == 0 )
+      return;
+   if( subscribers->second.empty() )
+   {
+      _market_depth_subscribers.erase( subscribers );
+      const market_type reversed = std::make_pair( base_quote.second, base_quote.first );
+      if( _market_depth_subscribers.find( reversed ) == _market_depth_subscribers.end() )
+         _market_depths.erase( ordered_market( base_quote ) );
+   }
+   auto markets = _session_market_depths.find( session );
+   markets->second.erase( base_quote );
+   if( markets->second.empty() )
+      _session_market_depths.erase( markets );
+}
+
+void subscription_registry::unsubscribe_from_all_market_depths( const database_api_impl* session )
+{
+   auto markets = _session_market_depths.find( session );
+   if( markets == _session_market_depths.end() )
+      return;
+   const flat_set<market_type> base_quotes = markets->second;
+   for( const market_type& base_quote : base_quotes )
+      unsubscribe_from_market_depth( session, base_quote );
+}
+
+void subscription_registry::dispatch( bool is_remove_create, bool full_object, const vector<object_id_type>& ids,
+                                      const vector<const object*>& objects,
+                                      const flat_set<account_id_type>& impacted_accounts )
+{
+   if( !_sessions.empty() || !_remove_create_subscribers.empty() )
+   {
+      // the sessions receiving every object of this signal
+      session_set all_ids_sessions;
+      if( is_remove_create )
+         all_ids_sessions = _remove_create_subscribers;
+      for( const account_id_type& account : impacted_accounts )
+      {
+         auto subscribers = _account_subscribers.find( account );
+         if( subscribers != _account_subscribers.end() )
+            all_ids_sessions.insert( subscribers->second.begin(), subscribers->second.end() );
+      }
+
+      std::map<const database_api_impl*, vector<variant>> updates;
+      for( size_t i = 0; i < ids.size(); ++i )
+      {
+         auto subscribers = _object_subscribers.find( ids[i] );
+         if( all_ids_sessions.empty() && subscribers == _object_subscribers.end() )
+            continue;
+
+         variant update;
+         if( !full_object )
+            update = fc::variant( ids[i], 1 );
+         else if( objects[i] != nullptr )
+            update = objects[i]->to_variant();
+         else
+            continue;
+
+         for( const database_api_impl* session : all_ids_sessions )
+            updates[session].push_back( update );
+         if( subscribers != _object_subscribers.end() )
+            for( const database_api_impl* session : subscribers->second )
+               if( all_ids_sessions.find( session ) == all_ids_sessions.end() )
+                  updates[session].push_back( update );
+      }
+
+      for( const auto& session_updates : updates )
+         session_updates.first->broadcast_updates( session_updates.second );
+   }
+
+   if( !_market_subscribers.empty() || !_market_depths.empty() )
+      dispatch_market_changes( full_object, objects );
+}
+
+void subscription_registry::dispatch_market_changes( bool full_object, const vector<const object*>& objects )
+{
+   market_queue_type queue;
+   for( const object* obj : objects )
+   {
+      if( obj == nullptr )
+         continue;
+      if( obj->id.is<call_order_object>() )
+         enqueue_if_subscribed_to_market<call_order_object>( obj, queue, full_object );
+      else if( obj->id.is<limit_order_object>() )
+      {
+         enqueue_if_subscribed_to_market<limit_order_object>( obj, queue, full_object );
+         if( !_market_depths.empty() )
+            touch_market_depth( static_cast<const limit_order_object&>( *obj ) );
+      }
+      else if( obj->id.is<force_settlement_object>() )
+         enqueue_if_subscribed_to_market<force_settlement_object>( obj, queue, full_object );
+   }
+   if( !_market_depths.empty() )
+      snapshot_market_depths();
+   dispatch_market_queue( queue );
+}
+
+void subscription_registry::dispatch_market_queue( const market_queue_type& queue )
+{
+   std::map<const database_api_impl*, market_queue_type> session_queues;
+   for( const auto& item : queue )
+   {
+      for( const database_api_impl* session : _market_subscribers.at( item.first ) )
+         session_queues[session][item.first] = item.second;
+   }
+   for( const auto& session_queue : session_queues )
+      session_queue.first->broadcast_market_updates( session_queue.second );
+}
+
+/** note: this method cannot yield because it is called in the middle of
+ * apply a block.
+ */
+void subscription_registry::on_applied_block( const signed_block& block )
+{
+   // blocks of the abandoned fork were popped without reporting the orders they changed
+   if( !_market_depths.empty() && block.previous != _head_block_id )
+   {
+      for( auto& item : _market_depths )
+         item.second.reset = true;
+      schedule_market_depth_flush();
+   }
+   _head_block_id = _db.head_block_id();
+
+   if( _keep_applied_operations )
+      dispatch_applied_operations( block );
+
+   if( _market_subscribers.empty() && _market_depths.empty() )
+      return;
+
+   market_queue_type queue;
+   for( const optional< operation_history_object >& o_op : _db.get_applied_operations() )
+   {
+      if( !o_op.valid() || !o_op->op.is_type<fill_order_operation>() )
+         continue;
+      const operation_history_object& op = *o_op;
+      // limit_order_create and limit_order_cancel are sent via the changed objects
+      const fill_order_operation& fill = op.op.get<fill_order_operation>();
+      const market_type market = fill.get_market();
+      if( _market_subscribers.find( market ) != _market_subscribers.end() )
+         // FIXME this may cause fill_order_operation be pushed before order creation
+         queue[market].emplace_back( fc::variant( std::make_pair( op.op, op.result ),
+                                                  GRAPHENE_NET_MAX_NESTED_OBJECTS ) );
+      auto depth = _market_depths.find( market );
+      if( depth != _market_depths.end() )
+      {
+         depth->second.fills.push_back( fill );
+         schedule_market_depth_flush();
+      }
+   }
+   if( !_market_depths.empty() )
+      snapshot_market_depths();
+   dispatch_market_queue( queue );
+}
+
+void subscription_registry::touch_market_depth( const limit_order_object& order )
+{
+   auto depth = _market_depths.find( order.get_market() );
+   if( depth == _market_depths.end() )
+      return;
+   const size_t side = ( order.sell_price.base.asset_id == depth->first.first ? 0 : 1 );
+   depth->second.touched_levels[side].emplace( price_sort_key( order.sell_price ), order.sell_price );
+   schedule_market_depth_flush();
+}
+
+void subscription_registry::snapshot_market_depths()
+{
+   const auto& books = _db.get_limit_order_books();
+   for( auto& item : _market_depths )
+   {
+      const market_type& market = item.first;
+      market_depth_state& state = item.second;
+      if( !state.reset && state.touched_levels[0].empty() && state.touched_levels[1].empty()
+            && state.fills.empty() )
+         continue;
+
+      for( size_t side = 0; side < 2; ++side )
+      {
+         const auto& book = ( side == 0 ? books.get_book( market.first, market.second )
+                                        : books.get_book( market.second, market.first ) );
+         if( state.reset )
+         {
+            state.levels[side].clear();
+            for( auto itr = book.begin(); itr != book.end(); itr = book.upper_bound( itr->key ) )
+               state.levels[side][itr->key] = get_depth_level( book, itr->key, itr->order->sell_price );
+         }
+         else
+            for( const auto& touched : state.touched_levels[side] )
+               state.levels[side][touched.first] = get_depth_level( book, touched.first, touched.second );
+         state.touched_levels[side].clear();
+      }
+      state.full = state.full || state.reset;
+      state.reset = false;
+      state.block_num = _db.head_block_num();
+      state.time = _db.head_block_time();
+      schedule_market_depth_flush();
+   }
+}
+
+/** The orders of a block are reported by up to three signals after the block was applied, the task flushing the
+ * changes runs once all of them are collected. The levels have been computed in the signals already.
+ */
+void subscription_registry::schedule_market_depth_flush()
+{
+   if( _market_depth_flush_scheduled )
+      return;
+   _market_depth_flush_scheduled = true;
+   auto capture_this = shared_from_this();
+   fc::async( [capture_this](){ capture_this->flush_market_depths(); } );
+}
+
+subscription_registry::depth_level subscription_registry::get_depth_level(
+      const limit_order_book_index::book_type& book, const price_sort_key& key, const price& sell_price )const
+{
+   depth_level level;
+   level.sell_price = sell_price;
+   auto range = book.equal_range( key );
+   for( auto itr = range.first; itr != range.second; ++itr )
+   {
+      const limit_order_object& o = *itr->order;
+      level.for_sale += o.for_sale;
+      level.receives += share_type( fc::uint128_t( o.for_sale.value ) * o.sell_price.quote.amount.value
+                                                                      / o.sell_price.base.amount.value );
+   }
+   return level;
+}
+
+vector<subscription_registry::depth_level> subscription_registry::get_depth_levels(
+      const limit_order_book_index::book_type& book, unsigned limit )const
+{
+   vector<depth_level> levels;
+   for( auto itr = book.begin(); itr != book.end() && levels.size() < limit; )
+   {
+      levels.push_back( get_depth_level( book, itr->key, itr->order->sell_price ) );
+      itr = book.upper_bound( itr->key );
+   }
+   return levels;
+}
+
+void subscription_registry::flush_market_depths()
+{
+   _market_depth_flush_scheduled = false;
+   for( auto& item : _market_depths )
+   {
+      const market_type& market = item.first;
+      market_depth_state& state = item.second;
+      if( !state.full && state.levels[0].empty() && state.levels[1].empty() && state.fills.empty() )
+         continue;
+
+      depth_delta delta;
+      delta.sequence = ++state.sequence;
+      delta.block_num = state.block_num;
+      delta.time = state.time;
+      delta.full = state.full;
+      for( size_t side = 0; side < 2; ++side )
+      {
+         // best price first
+         delta.levels[side].reserve( state.levels[side].size() );
+         for( auto itr = state.levels[side].rbegin(); itr != state.levels[side].rend(); ++itr )
+            delta.levels[side].push_back( itr->second );
+
+         if( state.full )
+            state.book[side].clear();
+         for( const auto& level : state.levels[side] )
+         {
+            if( level.second.for_sale == 0 )
+               state.book[side].erase( level.first );
+            else
+               state.book[side][level.first] = level.second;
+         }
+         state.levels[side].clear();
+      }
+      delta.fills.swap( state.fills );
+      state.book_known = state.book_known || state.full;
+      state.book_block_num = state.block_num;
+      state.full = false;
+
+      for( const market_type& base_quote : { market, std::make_pair( market.second, market.first ) } )
+      {
+         auto subscribers = _market_depth_subscribers.find( base_quote );
+         if( subscribers == _market_depth_subscribers.end() )
+            continue;
+         const variant update( format_depth_delta( delta, base_quote.first( _db ), base_quote.second( _db ) ),
+                               GRAPHENE_NET_MAX_NESTED_OBJECTS );
+         for( const database_api_impl* session : subscribers->second )
+            session->broadcast_market_depth_update( base_quote, update );
+      }
+
+      state.history.push_back( std::move( delta ) );
+      if( state.history.size() > max_market_depth_history )
+         state.history.pop_front();
+   }
+}
+
+order subscription_registry::format_depth_level( const depth_level& level, bool is_bid, const asset_object& base,
+                                                  const asset_object& quote )
+{
+   order result;
+   result.price = price_to_string( level.sell_price, base, quote );
+   result.quote = quote.amount_to_string( is_bid ? level.receives : level.for_sale );
+   result.base = base.amount_to_string( is_bid ? level.for_sale : level.receives );
+   return result;
+}
+
+market_depth_update subscription_registry::format_depth_delta( const depth_delta& delta, const asset_object& base,
+                                                               const asset_object& quote )const
+{
+   market_depth_update update;
+   update.base = base.symbol;
+   update.quote = quote.symbol;
+   update.sequence = delta.sequence;
+   update.block_num = delta.block_num;
+   update.full = delta.full;
+
+   const size_t bid_side = ( base.id < quote.id ? 0 : 1 );
+   update.bids.reserve( delta.levels[bid_side].size() );
+   for( const depth_level& level : delta.levels[bid_side] )
+      update.bids.push_back( format_depth_level( level, true, base, quote ) );
+   update.asks.reserve( delta.levels[1 - bid_side].size() );
+   for( const depth_level& level : delta.levels[1 - bid_side] )
+      update.asks.push_back( format_depth_level( level, false, base, quote ) );
+
+   for( size_t i = 0; i < delta.fills.size(); ++i )
+   {
+      const fill_order_operation& fill = delta.fills[i];
+      market_trade trade;
+      if( base.id == fill.receives.asset_id )
+      {
+         trade.amount = quote.amount_to_string( fill.pays );
+         trade.value = base.amount_to_string( fill.receives );
+      }
+      else
+      {
+         trade.amount = quote.amount_to_string( fill.receives );
+         trade.value = base.amount_to_string( fill.pays );
+      }
+      trade.date = delta.time;
+      trade.price = price_to_string( fill.fill_price, base, quote );
+      if( fill.is_maker )
+         trade.side1_account_id = fill.account_id;
+      else
+      {
+         trade.side2_account_id = fill.account_id;
+         // the taker of a match is filled right before the maker
+         if( i + 1 < delta.fills.size() && delta.fills[i+1].is_maker
+               && delta.fills[i+1].fill_price == fill.fill_price )
+            trade.side1_account_id = delta.fills[++i].account_id;
+      }
+      update.trades.push_back( std::move( trade ) );
+   }
+   return update;
+}
+
+market_depth_snapshot subscription_registry::get_market_depth( const asset_object& base, const asset_object& quote,
+                                                               unsigned limit )const
+{
+   market_depth_snapshot result;
+   result.base = base.symbol;
+   result.quote = quote.symbol;
+
+   // the current book may hold changes of pending transactions and of blocks whose update is not flushed yet
+   auto depth = _market_depths.find( ordered_market( std::make_pair( base.id, quote.id ) ) );
+   if( depth != _market_depths.end() && depth->second.book_known )
+   {
+      const market_depth_state& state = depth->second;
+      result.sequence = state.sequence;
+      result.block_num = state.book_block_num;
+      const size_t bid_side = ( base.id < quote.id ? 0 : 1 );
+      // best price first
+      for( auto itr = state.book[bid_side].rbegin();
+           itr != state.book[bid_side].rend() && result.bids.size() < limit; ++itr )
+         result.bids.push_back( format_depth_level( itr->second, true, base, quote ) );
+      for( auto itr = state.book[1 - bid_side].rbegin();
+           itr != state.book[1 - bid_side].rend() && result.asks.size() < limit; ++itr )
+         result.asks.push_back( format_depth_level( itr->second, false, base, quote ) );
+      return result;
+   }
+   result.block_num = _db.head_block_num();
+
+   const auto& books = _db.get_limit_order_books();
+   for( const depth_level& level : get_depth_levels( books.get_book( base.id, quote.id ), limit ) )
+      result.bids.push_back( format_depth_level( level, true, base, quote ) );
+   for( const depth_level& level : get_depth_levels( books.get_book( quote.id, base.id ), limit ) )
+      result.asks.push_back( format_depth_level( level, false, base, quote ) );
+   return result;
+}
+
+vector<market_depth_update> subscription_registry::get_market_depth_updates( const asset_object& base,
+                                                                             const asset_object& quote,
+                                                                             uint64_t since_sequence )const
+{
+   auto depth = _market_depths.find( ordered_market( std::make_pair( base.id, quote.id ) ) );
+   FC_ASSERT( depth != _market_depths.end(), "Nobody subscribes to the market depth of ${b}:${q}",
+              ("b",base.symbol)("q",quote.symbol) );
+   const std::deque<depth_delta>& history = depth->second.history;
+   FC_ASSERT( since_sequence <= depth->second.sequence, "Sequence ${s} is in the future", ("s",since_sequence) );
+   FC_ASSERT( history.empty() || since_sequence + 1 >= history.front().sequence,
+              "The updates after sequence ${s} are no longer available, fetch a snapshot with get_market_depth",
+              ("s",since_sequence) );
+
+   vector<market_depth_update> result;
+   for( const depth_delta& delta : history )
+      if( delta.sequence > since_sequence )
+         result.push_back( format_depth_delta( delta, base, quote ) );
+   return result;
+}
+
+/** note: this method cannot yield because it is called in the middle of
+ * pushing a transaction.
+ */
+void subscription_registry::dispatch_applied_operations( const signed_block& block )
+{
+   applied_operations_notice notice;
+   notice.block_num = block.block_num();
+   notice.block_id = _head_block_id;
+   notice.timestamp = block.timestamp;
+   for( const optional< operation_history_object >& o_op : _db.get_applied_operations() )
+      if( o_op.valid() )
+         notice.operations.push_back( *o_op );
+   const variant v( notice, GRAPHENE_MAX_NESTED_OBJECTS );
+
+   // the blocks of an abandoned fork are replaced
+   while( !_applied_operations_history.empty() && _applied_operations_history.back().first >= notice.block_num )
+      _applied_operations_history.pop_back();
+   _applied_operations_history.emplace_back( notice.block_num, v );
+   while( _applied_operations_history.size() > max_applied_operations_history )
+      _applied_operations_history.pop_front();
+
+   for( const database_api_impl* session : _applied_operations_subscribers )
+      session->on_applied_operations( v );
+}
+
+void subscription_registry::on_pending_transaction( const signed_transaction& trx )
+{
+   if( _pending_transaction_subscribers.empty() && _filtered_pending_transaction_subscribers.empty() )
+      return;
+   // converted when the first session receives it
+   optional<variant> trx_variant;
+   auto get_variant = [&trx,&trx_variant] () -> const variant& {
+      if( !trx_variant.valid() )
+         trx_variant = variant( trx, GRAPHENE_MAX_NESTED_OBJECTS );
+      return *trx_variant;
+   };
+   for( const database_api_impl* session : _pending_transaction_subscribers )
+      session->on_pending_transaction( get_variant() );
+   if( _filtered_pending_transaction_subscribers.empty() )
+      return;
+   const pending_transaction_summary summary( trx );
+   for( const auto& item : _filtered_pending_transaction_subscribers )
+      if( summary.matches( item.second ) )
+         item.first->on_pending_transaction( get_variant() );
+}
+
+} } // graphene::app
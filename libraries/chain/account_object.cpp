@@ -29,6 +29,32 @@
 
 namespace graphene { namespace chain {
 
+namespace {
+   /** approximate size of a node of std::map or std::set, excluding the value */
+   const size_t tree_node_overhead = 4 * sizeof(void*);
+
+   /** @return approximate number of bytes allocated by a map of sets */
+   template< typename Map >
+   size_t map_of_sets_memory_usage( const Map& m )
+   {
+      size_t result = m.size() * ( tree_node_overhead + sizeof( typename Map::value_type ) );
+      for( const auto& item : m )
+         result += item.second.size() * ( tree_node_overhead + sizeof( typename Map::mapped_type::value_type ) );
+      return result;
+   }
+
+   /** @return approximate number of bytes allocated by a hash map of flat sets */
+   template< typename Map >
+   size_t hash_map_of_flat_sets_memory_usage( const Map& m )
+   {
+      size_t result = m.bucket_count() * sizeof(void*)
+                    + m.size() * ( sizeof(void*) + sizeof( typename Map::value_type ) );
+      for( const auto& item : m )
+         result += item.second.capacity() * sizeof( typename Map::mapped_type::value_type );
+      return result;
+   }
+}
+
 share_type cut_fee(share_type a, uint16_t p)
 {
    if( a == 0 || p == 0 )
@@ -112,6 +138,49 @@ void account_statistics_object::pay_fee( share_type core_fee, share_type cashbac
       pending_vested_fees += core_fee;
 }
 
+unique_ptr<object> account_statistics_object::undo_snapshot()const
+{
+   unique_ptr<object> result( new account_statistics_object() );
+   result->copy_undo_snapshot_from( *this );
+   return result;
+}
+
+void account_statistics_object::copy_undo_snapshot_from( const object& obj )
+{
+   const account_statistics_object& s = static_cast<const account_statistics_object&>(obj);
+   id                   = s.id;
+   owner                = s.owner;
+   most_recent_op       = s.most_recent_op;
+   total_ops            = s.total_ops;
+   removed_ops          = s.removed_ops;
+   total_core_in_orders = s.total_core_in_orders;
+   core_in_balance      = s.core_in_balance;
+   has_cashback_vb      = s.has_cashback_vb;
+   is_voting            = s.is_voting;
+   last_vote_time       = s.last_vote_time;
+   lifetime_fees_paid   = s.lifetime_fees_paid;
+   pending_fees         = s.pending_fees;
+   pending_vested_fees  = s.pending_vested_fees;
+   name.clear();
+}
+
+void account_statistics_object::restore_undo_snapshot( object& snapshot )
+{
+   const account_statistics_object& s = static_cast<const account_statistics_object&>(snapshot);
+   owner                = s.owner;
+   most_recent_op       = s.most_recent_op;
+   total_ops            = s.total_ops;
+   removed_ops          = s.removed_ops;
+   total_core_in_orders = s.total_core_in_orders;
+   core_in_balance      = s.core_in_balance;
+   has_cashback_vb      = s.has_cashback_vb;
+   is_voting            = s.is_voting;
+   last_vote_time       = s.last_vote_time;
+   lifetime_fees_paid   = s.lifetime_fees_paid;
+   pending_fees         = s.pending_fees;
+   pending_vested_fees  = s.pending_vested_fees;
+}
+
 set<account_id_type> account_member_index::get_account_members(const account_object& a)const
 {
    set<account_id_type> result;
@@ -142,57 +211,72 @@ set<address> account_member_index::get_address_members(const account_object& a)c
    return result;
 }
 
-void account_member_index::object_inserted(const object& obj)
+void account_member_index::apply_change( const object* before, const object* after )
+{
+   assert( before == nullptr || dynamic_cast<const account_object*>(before) ); // for debug only
+   assert( after == nullptr || dynamic_cast<const account_object*>(after) ); // for debug only
+   if( before == nullptr )
+      insert_members( *static_cast<const account_object*>(after) );
+   else if( after == nullptr )
+      remove_members( *static_cast<const account_object*>(before) );
+   else
+      update_members( *static_cast<const account_object*>(before), *static_cast<const account_object*>(after) );
+}
+
+void account_member_index::clear()
 {
-    assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
-    const account_object& a = static_cast<const account_object&>(obj);
+   account_to_account_memberships.clear();
+   account_to_key_memberships.clear();
+   account_to_address_memberships.clear();
+}
+
+size_t account_member_index::memory_usage()const
+{
+   return map_of_sets_memory_usage( account_to_account_memberships )
+          + hash_map_of_flat_sets_memory_usage( account_to_key_memberships )
+          + map_of_sets_memory_usage( account_to_address_memberships );
+}
+
+void account_member_index::insert_members( const account_object& a )
+{
+    const object_id_type& id = a.id;
 
     auto account_members = get_account_members(a);
     for( auto item : account_members )
-       account_to_account_memberships[item].insert(obj.id);
+       account_to_account_memberships[item].insert(id);
 
     auto key_members = get_key_members(a);
     for( auto item : key_members )
-       account_to_key_memberships[item].insert(obj.id);
+       account_to_key_memberships[item].insert(id);
 
     auto address_members = get_address_members(a);
     for( auto item : address_members )
-       account_to_address_memberships[item].insert(obj.id);
+       account_to_address_memberships[item].insert(id);
 }
 
-void account_member_index::object_removed(const object& obj)
+void account_member_index::remove_members( const account_object& a )
 {
-    assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
-    const account_object& a = static_cast<const account_object&>(obj);
+    const object_id_type& id = a.id;
 
     auto key_members = get_key_members(a);
     for( auto item : key_members )
-       account_to_key_memberships[item].erase( obj.id );
+       remove_key_member( item, id );
 
     auto address_members = get_address_members(a);
     for( auto item : address_members )
-       account_to_address_memberships[item].erase( obj.id );
+       account_to_address_memberships[item].erase( id );
 
     auto account_members = get_account_members(a);
     for( auto item : account_members )
-       account_to_account_memberships[item].erase( obj.id );
-}
-
-void account_member_index::about_to_modify(const object& before)
-{
-   before_key_members.clear();
-   before_account_members.clear();
-   assert( dynamic_cast<const account_object*>(&before) ); // for debug only
-   const account_object& a = static_cast<const account_object&>(before);
-   before_key_members     = get_key_members(a);
-   before_address_members = get_address_members(a);
-   before_account_members = get_account_members(a);
+       account_to_account_memberships[item].erase( id );
 }
 
-void account_member_index::object_modified(const object& after)
+void account_member_index::update_members( const account_object& before, const account_object& a )
 {
-    assert( dynamic_cast<const account_object*>(&after) ); // for debug only
-    const account_object& a = static_cast<const account_object&>(after);
+    const object& after = a;
+    before_key_members     = get_key_members(before);
+    before_address_members = get_address_members(before);
+    before_account_members = get_account_members(before);
 
     {
        set<account_id_type> after_account_members = get_account_members(a);
@@ -223,7 +307,7 @@ void account_member_index::object_modified(const object& after)
                            std::inserter(removed, removed.end()));
 
        for( auto itr = removed.begin(); itr != removed.end(); ++itr )
-          account_to_key_memberships[*itr].erase(after.id);
+          remove_key_member( *itr, after.id );
 
        vector<public_key_type> added; added.reserve(after_key_members.size());
        std::set_difference(after_key_members.begin(), after_key_members.end(),
@@ -256,6 +340,16 @@ void account_member_index::object_modified(const object& after)
 
 }
 
+void account_member_index::remove_key_member( const public_key_type& key, account_id_type account )
+{
+   auto itr = account_to_key_memberships.find( key );
+   if( itr == account_to_key_memberships.end() )
+      return;
+   itr->second.erase( account );
+   if( itr->second.empty() )
+      account_to_key_memberships.erase( itr );
+}
+
 void account_referrer_index::object_inserted( const object& obj )
 {
 }
@@ -269,6 +363,46 @@ void account_referrer_index::object_modified( const object& after  )
 {
 }
 
+void account_authority_index::object_removed( const object& obj )
+{
+   _cache.clear();
+}
+
+void account_authority_index::about_to_modify( const object& before )
+{
+   const account_object& a = static_cast<const account_object&>( before );
+   _owner_before = a.owner;
+   _active_before = a.active;
+}
+
+void account_authority_index::object_modified( const object& after )
+{
+   const account_object& a = static_cast<const account_object&>( after );
+   if( !( a.owner == _owner_before && a.active == _active_before ) )
+      _cache.clear();
+}
+
+void account_whitelist_index::object_removed( const object& obj )
+{
+   _cache.clear();
+}
+
+void account_whitelist_index::about_to_modify( const object& before )
+{
+   const account_object& a = static_cast<const account_object&>( before );
+   _allowed_assets_before = a.allowed_assets;
+   _whitelisting_before = a.whitelisting_accounts;
+   _blacklisting_before = a.blacklisting_accounts;
+}
+
+void account_whitelist_index::object_modified( const object& after )
+{
+   const account_object& a = static_cast<const account_object&>( after );
+   if( !( a.allowed_assets == _allowed_assets_before && a.whitelisting_accounts == _whitelisting_before
+          && a.blacklisting_accounts == _blacklisting_before ) )
+      _cache.clear();
+}
+
 const uint8_t  balances_by_account_index::bits = 20;
 const uint64_t balances_by_account_index::mask = (1ULL << balances_by_account_index::bits) - 1;
 
@@ -302,9 +436,22 @@ void balances_by_account_index::object_modified( const object& after  )
    ids_being_modified.pop();
 }
 
-const map< asset_id_type, const account_balance_object* >& balances_by_account_index::get_account_balances( const account_id_type& acct )const
+size_t balances_by_account_index::memory_usage()const
+{
+   size_t result = balances.capacity() * sizeof( vector< account_balances_type > );
+   for( const auto& chunk : balances )
+   {
+      result += chunk.capacity() * sizeof( account_balances_type );
+      for( const auto& account_balances : chunk )
+         result += account_balances.capacity() * sizeof( account_balances_type::value_type );
+   }
+   return result;
+}
+
+const balances_by_account_index::account_balances_type& balances_by_account_index::get_account_balances(
+      const account_id_type& acct )const
 {
-   static const map< asset_id_type, const account_balance_object* > _empty;
+   static const account_balances_type _empty;
 
    if( balances.size() < (acct.instance.value >> bits) + 1 ) return _empty;
    return balances[acct.instance.value >> bits][acct.instance.value & mask];
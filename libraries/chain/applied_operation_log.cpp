@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/applied_operation_log.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/endian/buffers.hpp>
+
+namespace graphene { namespace chain {
+
+struct applied_operation_log::log_index_entry
+{
+   boost::endian::little_uint64_buf_t position;
+   /// 0 if the operations of the block are not stored
+   boost::endian::little_uint32_buf_t size;
+   block_id_type                      block_id;
+};
+
+applied_operation_log::applied_operation_log() {}
+
+applied_operation_log::~applied_operation_log()
+{
+   close();
+}
+
+void applied_operation_log::open( const fc::path& dir )
+{ try {
+   std::lock_guard<std::mutex> guard( _mutex );
+   fc::create_directories( dir );
+   _operations_filename = dir / "operations";
+   _index_filename = dir / "index";
+   _operations.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+   _index.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+   auto mode = std::fstream::binary | std::fstream::in | std::fstream::out;
+   if( !fc::exists( _index_filename ) || !fc::exists( _operations_filename ) )
+   {
+      // the positions in the index are meaningless without the operations, so both start empty
+      if( fc::exists( _index_filename ) )
+         wlog( "The operations of the applied operation log in ${d} are missing, starting the log again",
+               ("d",dir) );
+      mode |= std::fstream::trunc;
+   }
+   _operations.open( _operations_filename.generic_string().c_str(), mode );
+   _index.open( _index_filename.generic_string().c_str(), mode );
+
+   // drop the entries at the end which were not written completely
+   const uint64_t operations_size = fc::file_size( _operations_filename );
+   uint64_t index_size = fc::file_size( _index_filename ) / sizeof(log_index_entry) * sizeof(log_index_entry);
+   _last_block_num = 0;
+   while( index_size > 0 )
+   {
+      log_index_entry e;
+      _index.seekg( index_size - sizeof(e) );
+      _index.read( (char*)&e, sizeof(e) );
+      if( e.size.value() > 0 && e.position.value() + e.size.value() <= operations_size )
+      {
+         _last_block_num = index_size / sizeof(e) - 1;
+         break;
+      }
+      index_size -= sizeof(e);
+   }
+   if( index_size < fc::file_size( _index_filename ) )
+   {
+      wlog( "Dropping ${n} bytes at the end of the index of the applied operations",
+            ("n",fc::file_size( _index_filename ) - index_size) );
+      _index.close();
+      fc::resize_file( _index_filename, index_size );
+      _index.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+   }
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+bool applied_operation_log::is_open()const
+{
+   return _index.is_open();
+}
+
+void applied_operation_log::flush()
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   if( !_index.is_open() )
+      return;
+   _operations.flush();
+   _index.flush();
+   _unflushed_blocks = 0;
+}
+
+void applied_operation_log::close()
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   if( !_index.is_open() )
+      return;
+   _operations.close();
+   _index.close();
+}
+
+bool applied_operation_log::read_index_entry( uint32_t block_num, log_index_entry& e )const
+{
+   if( block_num == 0 || block_num > _last_block_num )
+      return false;
+   _index.seekg( uint64_t(block_num) * sizeof(e) );
+   _index.read( (char*)&e, sizeof(e) );
+   return e.size.value() > 0;
+}
+
+void applied_operation_log::store( const block_id_type& id, const vector<optional<operation_history_object>>& ops )
+{ try {
+   std::lock_guard<std::mutex> guard( _mutex );
+   const uint32_t block_num = block_header::num_from_id( id );
+   FC_ASSERT( block_num > 0 );
+   log_index_entry e;
+   // a block applied again, e.g. by a replay, has the same operations
+   if( read_index_entry( block_num, e ) && e.block_id == id )
+      return;
+
+   vector<operation_history_object> stored;
+   stored.reserve( ops.size() );
+   for( const auto& op : ops )
+      if( op.valid() )
+         stored.push_back( *op );
+   const auto data = fc::raw::pack( stored );
+   _operations.seekp( 0, _operations.end );
+   e.position = _operations.tellp();
+   e.size = data.size();
+   e.block_id = id;
+   _operations.write( data.data(), data.size() );
+
+   // the entries of a fork popped are dropped
+   if( block_num < _last_block_num )
+   {
+      _index.flush();
+      fc::resize_file( _index_filename, uint64_t(block_num) * sizeof(e) );
+   }
+   else if( block_num > _last_block_num + 1 )
+   {
+      // the log was enabled or pruned at a later block, the blocks in between are not stored
+      log_index_entry empty;
+      empty.position = 0;
+      empty.size = 0;
+      _index.seekp( 0, _index.end );
+      for( uint64_t n = uint64_t(_index.tellp()) / sizeof(e); n < block_num; ++n )
+         _index.write( (char*)&empty, sizeof(empty) );
+   }
+   _index.seekp( uint64_t(block_num) * sizeof(e) );
+   _index.write( (char*)&e, sizeof(e) );
+   _last_block_num = block_num;
+   // the operations first, so that a crash in between leaves no index entry pointing past them
+   if( ++_unflushed_blocks >= blocks_per_flush )
+   {
+      _operations.flush();
+      _index.flush();
+      _unflushed_blocks = 0;
+   }
+} FC_CAPTURE_AND_RETHROW( (id) ) }
+
+optional<vector<char>> applied_operation_log::fetch_packed( uint32_t block_num )const
+{ try {
+   std::lock_guard<std::mutex> guard( _mutex );
+   log_index_entry e;
+   if( !is_open() || !read_index_entry( block_num, e ) )
+      return optional<vector<char>>();
+   vector<char> data( e.size.value() );
+   _operations.seekg( e.position.value() );
+   _operations.read( data.data(), data.size() );
+   return data;
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+optional<vector<operation_history_object>> applied_operation_log::fetch( uint32_t block_num )const
+{
+   const auto data = fetch_packed( block_num );
+   if( !data.valid() )
+      return optional<vector<operation_history_object>>();
+   return fc::raw::unpack<vector<operation_history_object>>( *data );
+}
+
+optional<block_id_type> applied_operation_log::fetch_block_id( uint32_t block_num )const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   log_index_entry e;
+   if( !is_open() || !read_index_entry( block_num, e ) )
+      return optional<block_id_type>();
+   return e.block_id;
+}
+
+uint32_t applied_operation_log::last_block_num()const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   return _last_block_num;
+}
+
+} } // graphene::chain
@@ -24,6 +24,7 @@
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/is_authorized_asset.hpp>
 
 #include <fc/io/raw.hpp>
 #include <fc/uint128.hpp>
@@ -50,6 +51,7 @@ void graphene::chain::asset_bitasset_data_object::update_median_feeds( time_poin
    bool after_core_hardfork_1270 = ( next_maintenance_time > HARDFORK_CORE_1270_TIME ); // call price caching issue
    current_feed_publication_time = current_time;
    vector<std::reference_wrapper<const price_feed>> current_feeds;
+   current_feeds.reserve( feeds.size() );
    // find feeds that were alive at current_time
    for( const pair<account_id_type, pair<time_point_sec,price_feed>>& f : feeds )
    {
@@ -84,6 +86,10 @@ void graphene::chain::asset_bitasset_data_object::update_median_feeds( time_poin
    }
 
    // *** Begin Median Calculations ***
+   // Note: prices with different amounts can compare equal, and which of them ends up in the median position
+   //       is decided by std::nth_element and becomes part of consensus. A container that maintains medians
+   //       across updates would pick differently, so the medians are selected from scratch here. Selection
+   //       is linear in the number of live feeds and runs on references, so no feed is copied.
    price_feed median_feed;
    const auto median_itr = current_feeds.begin() + current_feeds.size() / 2;
 #define CALCULATE_MEDIAN_VALUE(r, data, field_name) \
@@ -162,6 +168,26 @@ asset asset_object::amount_from_string(string amount_string) const
    return amount(satoshis);
 } FC_CAPTURE_AND_RETHROW( (amount_string) ) }
 
+void asset_whitelist_index::object_removed( const object& obj )
+{
+   _cache.clear();
+}
+
+void asset_whitelist_index::about_to_modify( const object& before )
+{
+   const asset_object& a = static_cast<const asset_object&>( before );
+   _whitelist_authorities_before = a.options.whitelist_authorities;
+   _blacklist_authorities_before = a.options.blacklist_authorities;
+}
+
+void asset_whitelist_index::object_modified( const object& after )
+{
+   const asset_object& a = static_cast<const asset_object&>( after );
+   if( !( a.options.whitelist_authorities == _whitelist_authorities_before
+          && a.options.blacklist_authorities == _blacklist_authorities_before ) )
+      _cache.clear();
+}
+
 string asset_object::amount_to_string(share_type amount) const
 {
    share_type scaled_precision = asset::scaled_precision( precision );
@@ -26,6 +26,10 @@
 #include <fc/io/raw.hpp>
 #include <boost/endian/buffers.hpp>
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
 namespace graphene { namespace chain {
 
 struct index_entry
@@ -43,40 +47,198 @@ FC_REFLECT( graphene::chain::index_entry, (block_pos)(block_size)(block_id) );
 
 namespace graphene { namespace chain {
 
-void block_database::open( const fc::path& dbdir )
+struct block_database::segment
+{
+   segment( const fc::path& blocks_file, const fc::path& index_file, uint32_t first )
+   : first_block( first ), blocks_filename( blocks_file ), index_filename( index_file )
+   {
+      block_num_to_pos.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+      blocks.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+      if( !fc::exists( index_filename ) )
+      {
+        block_num_to_pos.open( index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+        blocks.open( blocks_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+      }
+      else
+      {
+        block_num_to_pos.open( index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+        blocks.open( blocks_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+      }
+      index_mapping.reset( new fc::file_mapping( index_filename.generic_string().c_str(), fc::read_only ) );
+      blocks_mapping.reset( new fc::file_mapping( blocks_filename.generic_string().c_str(), fc::read_only ) );
+      index_size = fc::file_size( index_filename );
+      blocks_size = fc::file_size( blocks_filename );
+   }
+
+   uint64_t index_pos( uint32_t block_num )const
+   {
+      return sizeof(index_entry) * uint64_t(block_num - first_block);
+   }
+
+   /** makes all data written so far visible to readers */
+   void flush_writes()
+   {
+      // blocks first, so that readers never see an index entry pointing beyond the visible blocks
+      blocks.flush();
+      blocks.seekp( 0, blocks.end );
+      blocks_size = blocks.tellp();
+      block_num_to_pos.flush();
+      block_num_to_pos.seekp( 0, block_num_to_pos.end );
+      index_size = block_num_to_pos.tellp();
+   }
+
+   const uint32_t    first_block;
+   const fc::path    blocks_filename;
+   const fc::path    index_filename;
+   std::fstream      blocks;
+   std::fstream      block_num_to_pos;
+
+   std::unique_ptr<fc::file_mapping> blocks_mapping;
+   std::unique_ptr<fc::file_mapping> index_mapping;
+   /** sizes of the files as far as readers may access them */
+   std::atomic<uint64_t> blocks_size{0};
+   std::atomic<uint64_t> index_size{0};
+};
+
+block_database::block_database() {}
+
+block_database::~block_database() {}
+
+void block_database::open( const fc::path& dbdir, uint32_t new_blocks_per_segment )
 { try {
+   FC_ASSERT( new_blocks_per_segment > 0 );
    fc::create_directories(dbdir);
-   _block_num_to_pos.exceptions(std::ios_base::failbit | std::ios_base::badbit);
-   _blocks.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+   _dbdir = dbdir;
 
-   _index_filename = dbdir / "index";
-   if( !fc::exists( _index_filename ) )
+   const fc::path segment_config = dbdir / "blocks_per_segment";
+   if( fc::exists( segment_config ) )
    {
-     _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+      std::ifstream in( segment_config.generic_string() );
+      in >> _blocks_per_segment;
+      FC_ASSERT( in && _blocks_per_segment > 0, "Invalid content of ${f}", ("f",segment_config) );
    }
+   else if( fc::exists( dbdir / "index" ) )
+      _blocks_per_segment = 0; // created before segments were introduced
    else
    {
-     _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+      _blocks_per_segment = new_blocks_per_segment;
+      std::ofstream out( segment_config.generic_string() );
+      out << _blocks_per_segment << "\n";
+      FC_ASSERT( out, "Unable to write ${f}", ("f",segment_config) );
    }
-} FC_CAPTURE_AND_RETHROW( (dbdir) ) }
+
+   const uint32_t segment_count = _blocks_per_segment == 0 ? 1
+                                  : std::numeric_limits<uint32_t>::max() / _blocks_per_segment + 1;
+   _segments.clear();
+   _segments.resize( segment_count );
+   for( uint32_t i = 0; i < segment_count; ++i )
+      if( fc::exists( segment_file( "index", i ) ) )
+         _segments[i] = std::make_shared<segment>( segment_file( "blocks", i ), segment_file( "index", i ),
+                                                   i * _blocks_per_segment );
+   if( !_segments[0] )
+      _segments[0] = std::make_shared<segment>( segment_file( "blocks", 0 ), segment_file( "index", 0 ), 0 );
+   _read_segment = 0;
+   _read_pos = 0;
+   _first_available = 0;
+} FC_CAPTURE_AND_RETHROW( (dbdir)(new_blocks_per_segment) ) }
 
 bool block_database::is_open()const
 {
-  return _blocks.is_open();
+  return !_segments.empty();
 }
 
 void block_database::close()
 {
-  _blocks.close();
-  _block_num_to_pos.close();
+  for( auto& seg : _segments )
+     if( seg )
+     {
+        seg->blocks.close();
+        seg->block_num_to_pos.close();
+     }
+  _segments.clear();
 }
 
 void block_database::flush()
 {
-  _blocks.flush();
-  _block_num_to_pos.flush();
+  for( const auto& seg : _segments )
+     if( seg )
+     {
+        seg->blocks.flush();
+        seg->block_num_to_pos.flush();
+     }
+}
+
+uint32_t block_database::segment_number( uint32_t block_num )const
+{
+   return _blocks_per_segment == 0 ? 0 : block_num / _blocks_per_segment;
+}
+
+fc::path block_database::segment_file( const std::string& name, uint32_t segment_num )const
+{
+   if( segment_num == 0 )
+      return _dbdir / name;
+   return _dbdir / ( name + "." + std::to_string( segment_num ) );
+}
+
+std::shared_ptr<block_database::segment> block_database::find_segment( uint32_t block_num )const
+{
+   const uint32_t num = segment_number( block_num );
+   if( num >= _segments.size() )
+      return std::shared_ptr<segment>();
+   return std::atomic_load( &_segments[num] );
+}
+
+std::shared_ptr<block_database::segment> block_database::get_or_create_segment( uint32_t block_num )
+{
+   const uint32_t num = segment_number( block_num );
+   FC_ASSERT( num < _segments.size(), "Block database is not open" );
+   auto seg = std::atomic_load( &_segments[num] );
+   if( !seg )
+   {
+      seg = std::make_shared<segment>( segment_file( "blocks", num ), segment_file( "index", num ),
+                                       num * _blocks_per_segment );
+      std::atomic_store( &_segments[num], seg );
+   }
+   return seg;
+}
+
+bool block_database::read_index_entry( const segment& seg, uint32_t block_num, index_entry& e )const
+{
+   const uint64_t index_pos = seg.index_pos( block_num );
+   if( index_pos + sizeof(e) > seg.index_size )
+      return false;
+   fc::mapped_region region( *seg.index_mapping, fc::read_only, index_pos, sizeof(e) );
+   std::memcpy( (char*)&e, region.get_address(), sizeof(e) );
+   return true;
+}
+
+bool block_database::read_packed( const segment& seg, const index_entry& e, vector<char>& data )const
+{
+   const uint64_t block_end = e.block_pos.value() + e.block_size.value();
+   if( e.block_size.value() == 0 || block_end > seg.blocks_size )
+      return false;
+   fc::mapped_region region( *seg.blocks_mapping, fc::read_only, e.block_pos.value(), e.block_size.value() );
+   const char* begin = (const char*)region.get_address();
+   data.assign( begin, begin + e.block_size.value() );
+   _read_segment = segment_number( seg.first_block );
+   _read_pos = block_end;
+   return true;
+}
+
+optional<signed_block> block_database::read_block( const segment& seg, const index_entry& e )const
+{
+   const uint64_t block_end = e.block_pos.value() + e.block_size.value();
+   if( e.block_size.value() == 0 || block_end > seg.blocks_size )
+      return optional<signed_block>();
+   // unpack straight from the mapping instead of copying the block into a buffer first
+   fc::mapped_region region( *seg.blocks_mapping, fc::read_only, e.block_pos.value(), e.block_size.value() );
+   fc::datastream<const char*> ds( (const char*)region.get_address(), e.block_size.value() );
+   optional<signed_block> result = signed_block();
+   fc::raw::unpack( ds, *result );
+   _read_segment = segment_number( seg.first_block );
+   _read_pos = block_end;
+   FC_ASSERT( result->id() == e.block_id );
+   return result;
 }
 
 void block_database::store( const block_id_type& _id, const signed_block& b )
@@ -87,33 +249,38 @@ void block_database::store( const block_id_type& _id, const signed_block& b )
       id = b.id();
       elog( "id argument of block_database::store() was not initialized for block ${id}", ("id", id) );
    }
-   _block_num_to_pos.seekp( sizeof( index_entry ) * int64_t(block_header::num_from_id(id)) );
+   const uint32_t block_num = block_header::num_from_id(id);
+   auto seg = get_or_create_segment( block_num );
+   seg->block_num_to_pos.seekp( seg->index_pos( block_num ) );
    index_entry e;
-   _blocks.seekp( 0, _blocks.end );
+   seg->blocks.seekp( 0, seg->blocks.end );
    auto vec = fc::raw::pack( b );
-   e.block_pos  = _blocks.tellp();
+   e.block_pos  = seg->blocks.tellp();
    e.block_size = vec.size();
    e.block_id   = id;
-   _blocks.write( vec.data(), vec.size() );
-   _block_num_to_pos.write( (char*)&e, sizeof(e) );
+   seg->blocks.write( vec.data(), vec.size() );
+   seg->block_num_to_pos.write( (char*)&e, sizeof(e) );
+   seg->flush_writes();
+   if( block_num < _first_available )
+      _first_available = block_num;
 }
 
 void block_database::remove( const block_id_type& id )
 { try {
+   const uint32_t block_num = block_header::num_from_id(id);
+   auto seg = find_segment( block_num );
    index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   if( !seg || !read_index_entry( *seg, block_num, e ) )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block ${id} not contained in block database", ("id", id));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
    if( e.block_id == id )
    {
       e.block_size = 0;
-      _block_num_to_pos.seekp( sizeof(e) * int64_t(block_header::num_from_id(id)) );
-      _block_num_to_pos.write( (char*)&e, sizeof(e) );
+      seg->block_num_to_pos.seekp( seg->index_pos( block_num ) );
+      seg->block_num_to_pos.write( (char*)&e, sizeof(e) );
+      seg->flush_writes();
+      if( block_num == _first_available )
+         _first_available = 0;
    }
 } FC_CAPTURE_AND_RETHROW( (id) ) }
 
@@ -122,13 +289,11 @@ bool block_database::contains( const block_id_type& id )const
    if( id == block_id_type() )
       return false;
 
+   const uint32_t block_num = block_header::num_from_id(id);
+   auto seg = find_segment( block_num );
    index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() < int64_t(index_pos + sizeof(e)) )
+   if( !seg || !read_index_entry( *seg, block_num, e ) )
       return false;
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
 
    return e.block_id == id && e.block_size.value() > 0;
 }
@@ -136,41 +301,61 @@ bool block_database::contains( const block_id_type& id )const
 block_id_type block_database::fetch_block_id( uint32_t block_num )const
 {
    assert( block_num != 0 );
+   auto seg = find_segment( block_num );
    index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_num);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   if( !seg || !read_index_entry( *seg, block_num, e ) )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", block_num));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
    FC_ASSERT( e.block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
    return e.block_id;
 }
 
+vector<block_id_type> block_database::fetch_block_ids( uint32_t first_block_num, uint32_t count )const
+{
+   assert( first_block_num != 0 );
+   vector<block_id_type> result;
+   result.reserve( count );
+   uint32_t block_num = first_block_num;
+   while( result.size() < count )
+   {
+      auto seg = find_segment( block_num );
+      // map the wanted part of the segment's index at once instead of one region per entry
+      const uint64_t segment_end = _blocks_per_segment == 0 ? uint64_t(std::numeric_limits<uint32_t>::max()) + 1
+                                   : uint64_t(seg ? seg->first_block : 0) + _blocks_per_segment;
+      const uint64_t index_pos = seg ? seg->index_pos( block_num ) : 0;
+      const uint64_t index_size = seg ? seg->index_size.load() : 0;
+      const uint64_t entries = std::min( { uint64_t(count - result.size()), segment_end - block_num,
+                                           index_size > index_pos ? ( index_size - index_pos ) / sizeof(index_entry)
+                                                                  : uint64_t(0) } );
+      if( entries == 0 )
+         FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", block_num));
+
+      fc::mapped_region region( *seg->index_mapping, fc::read_only, index_pos, entries * sizeof(index_entry) );
+      const char* begin = (const char*)region.get_address();
+      for( uint64_t i = 0; i < entries; ++i, ++block_num )
+      {
+         index_entry e;
+         std::memcpy( (char*)&e, begin + i * sizeof(e), sizeof(e) );
+         FC_ASSERT( e.block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
+         result.push_back( e.block_id );
+      }
+   }
+   return result;
+}
+
 optional<signed_block> block_database::fetch_optional( const block_id_type& id )const
 {
    try
    {
+      const uint32_t block_num = block_header::num_from_id(id);
+      auto seg = find_segment( block_num );
       index_entry e;
-      int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      if( !seg || !read_index_entry( *seg, block_num, e ) )
          return {};
 
-      _block_num_to_pos.seekg( index_pos );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
       if( e.block_id != id ) return optional<signed_block>();
 
-      vector<char> data( e.block_size.value() );
-      _blocks.seekg( e.block_pos.value() );
-      if (e.block_size.value())
-         _blocks.read( data.data(), e.block_size.value() );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
-      return result;
+      return read_block( *seg, e );
    }
    catch (const fc::exception&)
    {
@@ -185,21 +370,12 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
 {
    try
    {
+      auto seg = find_segment( block_num );
       index_entry e;
-      int64_t index_pos = sizeof(e) * int64_t(block_num);
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      if( !seg || !read_index_entry( *seg, block_num, e ) )
          return {};
 
-      _block_num_to_pos.seekg( index_pos, _block_num_to_pos.beg );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
-      vector<char> data( e.block_size.value() );
-      _blocks.seekg( e.block_pos.value() );
-      _blocks.read( data.data(), e.block_size.value() );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
-      return result;
+      return read_block( *seg, e );
    }
    catch (const fc::exception&)
    {
@@ -210,55 +386,168 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
    return optional<signed_block>();
 }
 
-optional<index_entry> block_database::last_index_entry()const {
+optional<block_header> block_database::fetch_header( uint32_t block_num )const
+{
    try
    {
+      auto seg = find_segment( block_num );
       index_entry e;
+      if( !seg || !read_index_entry( *seg, block_num, e ) )
+         return {};
+      const uint64_t block_end = e.block_pos.value() + e.block_size.value();
+      if( e.block_size.value() == 0 || block_end > seg->blocks_size )
+         return {};
+      // the signed header is serialized first, only the pages it occupies are read from the mapping
+      fc::mapped_region region( *seg->blocks_mapping, fc::read_only, e.block_pos.value(), e.block_size.value() );
+      fc::datastream<const char*> ds( (const char*)region.get_address(), e.block_size.value() );
+      signed_block_header header;
+      fc::raw::unpack( ds, header );
+      FC_ASSERT( header.id() == e.block_id );
+      return block_header( std::move( header ) );
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return optional<block_header>();
+}
 
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      std::streampos pos = _block_num_to_pos.tellg();
-      if( pos < long(sizeof(index_entry)) )
-         return optional<index_entry>();
+optional<vector<char>> block_database::fetch_packed( uint32_t block_num )const
+{
+   try
+   {
+      auto seg = find_segment( block_num );
+      index_entry e;
+      vector<char> data;
+      if( seg && read_index_entry( *seg, block_num, e ) && read_packed( *seg, e, data ) )
+         return data;
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return optional<vector<char>>();
+}
 
-      pos -= pos % sizeof(index_entry);
+optional<vector<char>> block_database::fetch_packed( const block_id_type& id )const
+{
+   try
+   {
+      const uint32_t block_num = block_header::num_from_id(id);
+      auto seg = find_segment( block_num );
+      index_entry e;
+      vector<char> data;
+      if( seg && read_index_entry( *seg, block_num, e ) && e.block_id == id && read_packed( *seg, e, data ) )
+         return data;
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return optional<vector<char>>();
+}
 
-      _blocks.seekg( 0, _block_num_to_pos.end );
-      const std::streampos blocks_size = _blocks.tellg();
-      while( pos > 0 )
+optional<index_entry> block_database::last_index_entry()const {
+   // the last segment that contains a valid block, invalid entries at the end of its index are truncated
+   for( uint32_t num = _segments.size(); num > 0; --num )
+   {
+      auto seg = std::atomic_load( &_segments[num-1] );
+      if( !seg ) continue;
+      try
       {
-         pos -= sizeof(index_entry);
-         _block_num_to_pos.seekg( pos );
-         _block_num_to_pos.read( (char*)&e, sizeof(e) );
-         if( _block_num_to_pos.gcount() == sizeof(e) && e.block_size.value() > 0
-                && int64_t(e.block_pos.value() + e.block_size.value()) <= blocks_size )
-            try
-            {
-               vector<char> data( e.block_size.value() );
-               _blocks.seekg( e.block_pos.value() );
-               _blocks.read( data.data(), e.block_size.value() );
-               if( _blocks.gcount() == long(e.block_size.value()) )
+         index_entry e;
+         uint64_t pos = seg->index_size;
+         pos -= pos % sizeof(index_entry);
+         while( pos > 0 )
+         {
+            pos -= sizeof(index_entry);
+            const uint32_t block_num = seg->first_block + uint32_t( pos / sizeof(index_entry) );
+            if( read_index_entry( *seg, block_num, e ) )
+               try
                {
-                  const signed_block block = fc::raw::unpack<signed_block>(data);
-                  if( block.id() == e.block_id )
+                  const auto block = read_block( *seg, e );
+                  if( block.valid() )
                      return e;
                }
-            }
-            catch (const fc::exception&)
-            {
-            }
-            catch (const std::exception&)
-            {
-            }
-         fc::resize_file( _index_filename, pos );
+               catch (const fc::exception&)
+               {
+               }
+               catch (const std::exception&)
+               {
+               }
+            fc::resize_file( seg->index_filename, pos );
+            seg->index_size = pos;
+         }
+      }
+      catch (const fc::exception&)
+      {
+      }
+      catch (const std::exception&)
+      {
       }
    }
-   catch (const fc::exception&)
+   return optional<index_entry>();
+}
+
+void block_database::remove_blocks_before( uint32_t block_num )
+{
+   if( _blocks_per_segment == 0 )
+      return;
+   for( uint32_t num = 0; num < segment_number( block_num ) && num < _segments.size(); ++num )
    {
+      auto seg = std::atomic_load( &_segments[num] );
+      if( !seg ) continue;
+      // readers still holding the segment keep their file handles
+      std::atomic_store( &_segments[num], std::shared_ptr<segment>() );
+      seg->blocks.close();
+      seg->block_num_to_pos.close();
+      try
+      {
+         fc::remove( seg->index_filename );
+         fc::remove( seg->blocks_filename );
+      }
+      catch( const fc::exception& e )
+      {
+         wlog( "Unable to remove block segment ${n}: ${e}", ("n",num)("e",e.to_detail_string()) );
+      }
+      ilog( "Removed blocks ${f} to ${l}", ("f",seg->first_block)("l",seg->first_block + _blocks_per_segment - 1) );
    }
-   catch (const std::exception&)
+   _first_available = 0;
+}
+
+uint32_t block_database::first_available_block_num()const
+{
+   const uint32_t cached = _first_available;
+   if( cached > 0 )
+      return cached;
+   for( const auto& item : _segments )
    {
+      auto seg = std::atomic_load( &item );
+      const uint64_t index_size = seg ? uint64_t(seg->index_size) : 0;
+      if( index_size < sizeof(index_entry) )
+         continue;
+      // the index starts with empty entries if the database was started from a snapshot
+      fc::mapped_region region( *seg->index_mapping, fc::read_only, 0, index_size );
+      const char* entries = (const char*)region.get_address();
+      index_entry e;
+      for( uint64_t pos = 0; pos + sizeof(e) <= index_size; pos += sizeof(e) )
+      {
+         std::memcpy( (char*)&e, entries + pos, sizeof(e) );
+         if( e.block_size.value() > 0 )
+         {
+            const uint32_t result = std::max< uint32_t >( seg->first_block + uint32_t( pos / sizeof(e) ), 1 );
+            _first_available = result;
+            return result;
+         }
+      }
    }
-   return optional<index_entry>();
+   return 0;
 }
 
 optional<signed_block> block_database::last()const
@@ -277,13 +566,27 @@ optional<block_id_type> block_database::last_id()const
 
 size_t block_database::blocks_current_position()const
 {
-   return (size_t)_blocks.tellg();
+   const uint32_t read_segment = _read_segment;
+   size_t result = _read_pos;
+   for( uint32_t num = 0; num < read_segment && num < _segments.size(); ++num )
+   {
+      auto seg = std::atomic_load( &_segments[num] );
+      if( seg )
+         result += seg->blocks_size;
+   }
+   return result;
 }
 
 size_t block_database::total_block_size()const
 {
-   _blocks.seekg( 0, _blocks.end );
-   return (size_t)_blocks.tellg();
+   size_t result = 0;
+   for( const auto& item : _segments )
+   {
+      auto seg = std::atomic_load( &item );
+      if( seg )
+         result += seg->blocks_size;
+   }
+   return result;
 }
 
 } }
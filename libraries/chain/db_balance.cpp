@@ -73,7 +73,7 @@ void database::adjust_balance(account_id_type account, asset delta )
       });
    } else {
       if( delta.amount < 0 )
-         FC_ASSERT( abo->get_balance() >= -delta, "Insufficient Balance: ${a}'s balance of ${b} is less than required ${r}",
+         FC_ASSERT( abo->balance >= -delta.amount, "Insufficient Balance: ${a}'s balance of ${b} is less than required ${r}",
                     ("a",account(*this).name)("b",to_pretty_string(abo->get_balance()))("r",to_pretty_string(-delta)));
       modify(*abo, [delta](account_balance_object& b) {
          b.adjust_balance(delta);
@@ -39,10 +39,47 @@
 #include <graphene/protocol/fee_schedule.hpp>
 
 #include <fc/io/raw.hpp>
+#include <fc/uint128.hpp>
 #include <fc/thread/parallel.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <chrono>
 
 namespace graphene { namespace chain {
 
+namespace {
+   /// Adds the time between laps to the stages of a block_timing and to the counters of a replay_profile, if any
+   class profile_stopwatch
+   {
+      public:
+         profile_stopwatch( block_timing& timing, replay_profile* profile )
+         : _timing( timing ), _profile( profile ), _start( std::chrono::steady_clock::now() ), _last( _start ) {}
+
+         /// Adds the time since the previous lap, or since construction, to stage and counter
+         void lap( int64_t block_timing::* stage, int64_t replay_profile::* counter )
+         {
+            const auto now = std::chrono::steady_clock::now();
+            const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>( now - _last ).count();
+            _timing.*stage += ns;
+            if( _profile )
+               _profile->*counter += ns;
+            _last = now;
+         }
+
+         /// Sets block_timing::apply_ns to the time since construction
+         void finish()
+         {
+            _timing.apply_ns = std::chrono::duration_cast<std::chrono::nanoseconds>( _last - _start ).count();
+         }
+
+      private:
+         block_timing&                         _timing;
+         replay_profile*                       _profile;
+         const std::chrono::steady_clock::time_point _start;
+         std::chrono::steady_clock::time_point _last;
+   };
+}
+
 bool database::is_known_block( const block_id_type& id )const
 {
    return _fork_db.is_known_block(id) || _block_id_to_block.contains(id);
@@ -54,8 +91,7 @@ bool database::is_known_block( const block_id_type& id )const
  */
 bool database::is_known_transaction( const transaction_id_type& id )const
 {
-   const auto& trx_idx = get_index_type<transaction_index>().indices().get<by_trx_id>();
-   return trx_idx.find( id ) != trx_idx.end();
+   return _p_recent_trx_idx->find( id ) != nullptr;
 }
 
 block_id_type  database::get_block_id_for_num( uint32_t block_num )const
@@ -63,29 +99,75 @@ block_id_type  database::get_block_id_for_num( uint32_t block_num )const
    return _block_id_to_block.fetch_block_id( block_num );
 } FC_CAPTURE_AND_RETHROW( (block_num) ) }
 
+vector<block_id_type> database::get_block_ids_for_nums( uint32_t first_block_num, uint32_t count )const
+{ try {
+   return _block_id_to_block.fetch_block_ids( first_block_num, count );
+} FC_CAPTURE_AND_RETHROW( (first_block_num)(count) ) }
+
 optional<signed_block> database::fetch_block_by_id( const block_id_type& id )const
 {
    auto b = _fork_db.fetch_block( id );
    if( !b )
       return _block_id_to_block.fetch_optional(id);
-   return b->data;
+   return *b->data;
+}
+
+optional<vector<char>> database::fetch_packed_block_by_id( const block_id_type& id )const
+{
+   auto b = _fork_db.fetch_block( id );
+   if( !b )
+      return _block_id_to_block.fetch_packed(id);
+   return fc::raw::pack( *b->data );
+}
+
+bool database::is_stored_block( const block_id_type& id )const
+{
+   return _block_id_to_block.contains( id );
+}
+
+optional<vector<char>> database::fetch_stored_packed_block( const block_id_type& id )const
+{
+   return _block_id_to_block.fetch_packed( id );
+}
+
+uint32_t database::first_available_block_num()const
+{
+   const uint32_t result = _block_id_to_block.first_available_block_num();
+   return result > 0 ? result : 1;
 }
 
 optional<signed_block> database::fetch_block_by_number( uint32_t num )const
 {
    auto results = _fork_db.fetch_block_by_number(num);
    if( results.size() == 1 )
-      return results[0]->data;
+      return *results[0]->data;
    else
       return _block_id_to_block.fetch_by_number(num);
 }
 
+optional<block_header> database::fetch_block_header_by_number( uint32_t num )const
+{
+   auto results = _fork_db.fetch_block_by_number(num);
+   if( results.size() == 1 )
+      return block_header( *results[0]->data );
+   else
+      return _block_id_to_block.fetch_header(num);
+}
+
+optional<vector<char>> database::fetch_packed_block_by_number( uint32_t num )const
+{
+   auto results = _fork_db.fetch_block_by_number(num);
+   if( results.size() == 1 )
+      return fc::raw::pack( *results[0]->data );
+   else
+      return _block_id_to_block.fetch_packed(num);
+}
+
 const signed_transaction& database::get_recent_transaction(const transaction_id_type& trx_id) const
 {
-   auto& index = get_index_type<transaction_index>().indices().get<by_trx_id>();
-   auto itr = index.find(trx_id);
-   FC_ASSERT(itr != index.end());
-   return itr->trx;
+   const transaction_history_object* obj = _p_recent_trx_idx->find(trx_id);
+   FC_ASSERT(obj != nullptr);
+   return obj->trx;
 }
 
 std::vector<block_id_type> database::get_block_ids_on_fork(block_id_type head_of_fork) const
@@ -114,7 +196,14 @@ std::vector<block_id_type> database::get_block_ids_on_fork(block_id_type head_of
  */
 bool database::push_block(const signed_block& new_block, uint32_t skip)
 {
-//   idump((new_block.block_num())(new_block.id())(new_block.timestamp)(new_block.previous));
+   return push_block( std::make_shared<const signed_block>( new_block ), skip );
+}
+
+bool database::push_block(const std::shared_ptr<const signed_block>& new_block, uint32_t skip)
+{
+//   idump((new_block->block_num())(new_block->id())(new_block->timestamp)(new_block->previous));
+   write_scope scope( *this );
+   const auto start = std::chrono::steady_clock::now();
    bool result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -124,10 +213,13 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
          result = _push_block(new_block);
       });
    });
+   if( !result && _block_timing.block_num == new_block->block_num() && head_block_id() == new_block->id() )
+      _block_timing.push_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 std::chrono::steady_clock::now() - start ).count();
    return result;
 }
 
-bool database::_push_block(const signed_block& new_block)
+bool database::_push_block(const std::shared_ptr<const signed_block>& new_block)
 { try {
    uint32_t skip = get_node_properties().skip_flags;
    // TODO: If the block is greater than the head block and before the next maintenance interval
@@ -135,17 +227,36 @@ bool database::_push_block(const signed_block& new_block)
 
    shared_ptr<fork_item> new_head = _fork_db.push_block(new_block);
    //If the head block from the longest chain does not build off of the current head, we need to switch forks.
-   if( new_head->data.previous != head_block_id() )
+   if( new_head->data->previous != head_block_id() )
    {
       //If the newly pushed block is the same height as head, we get head back in new_head
       //Only switch forks if new_head is actually higher than head
-      if( new_head->data.block_num() > head_block_num() )
+      if( new_head->data->block_num() > head_block_num() )
       {
-         wlog( "Switching to fork: ${id}", ("id",new_head->data.id()) );
-         auto branches = _fork_db.fetch_branch_from(new_head->data.id(), head_block_id());
+         wlog( "Switching to fork: ${id}", ("id",new_head->data->id()) );
+         auto branches = _fork_db.fetch_branch_from(new_head->data->id(), head_block_id());
+
+         // Precompute all blocks of the new fork at once, while the blocks of the old one are popped.
+         // The tasks refer to the blocks, so all of them must be done before the branches are released.
+         // This thread blocks on them instead of yielding, otherwise other tasks could run on the
+         // half-switched state.
+         std::vector< std::future<void> > precomputed;
+         precomputed.reserve( branches.first.size() );
+         for( auto ritr = branches.first.rbegin(); ritr != branches.first.rend(); ++ritr )
+         {
+            const signed_block& block = *(*ritr)->data;
+            precomputed.push_back( run_in_background_blocking( [this,&block,skip] () {
+               precompute_block( block, skip );
+            }, "precompute fork block" ) );
+         }
+         auto wait_for_precompute = [&precomputed]() {
+            for( auto& task : precomputed )
+               if( task.valid() )
+                  try { task.get(); } catch( ... ) {} // reported when the block is applied
+         };
 
          // pop blocks until we hit the forked block
-         while( head_block_id() != branches.second.back()->data.previous )
+         while( head_block_id() != branches.second.back()->data->previous )
          {
             ilog( "popping block #${n} ${id}", ("n",head_block_num())("id",head_block_id()) );
             pop_block();
@@ -154,42 +265,46 @@ bool database::_push_block(const signed_block& new_block)
          // push all blocks on the new fork
          for( auto ritr = branches.first.rbegin(); ritr != branches.first.rend(); ++ritr )
          {
-               ilog( "pushing block from fork #${n} ${id}", ("n",(*ritr)->data.block_num())("id",(*ritr)->id) );
+               ilog( "pushing block from fork #${n} ${id}", ("n",(*ritr)->data->block_num())("id",(*ritr)->id) );
                optional<fc::exception> except;
                try {
+                  auto& task = precomputed[ ritr - branches.first.rbegin() ];
+                  if( task.valid() )
+                     try { task.get(); } catch( ... ) {} // fails again when the block is applied
                   undo_database::session session = _undo_db.start_undo_session();
-                  apply_block( (*ritr)->data, skip );
-                  _block_id_to_block.store( (*ritr)->id, (*ritr)->data );
+                  apply_block( *(*ritr)->data, skip );
+                  _block_id_to_block.store( (*ritr)->id, *(*ritr)->data );
                   session.commit();
                }
                catch ( const fc::exception& e ) { except = e; }
                if( except )
                {
                   wlog( "exception thrown while switching forks ${e}", ("e",except->to_detail_string() ) );
+                  wait_for_precompute();
                   // remove the rest of branches.first from the fork_db, those blocks are invalid
                   while( ritr != branches.first.rend() )
                   {
-                     ilog( "removing block from fork_db #${n} ${id}", ("n",(*ritr)->data.block_num())("id",(*ritr)->id) );
+                     ilog( "removing block from fork_db #${n} ${id}", ("n",(*ritr)->data->block_num())("id",(*ritr)->id) );
                      _fork_db.remove( (*ritr)->id );
                      ++ritr;
                   }
                   _fork_db.set_head( branches.second.front() );
 
                   // pop all blocks from the bad fork
-                  while( head_block_id() != branches.second.back()->data.previous )
+                  while( head_block_id() != branches.second.back()->data->previous )
                   {
                      ilog( "popping block #${n} ${id}", ("n",head_block_num())("id",head_block_id()) );
                      pop_block();
                   }
 
-                  ilog( "Switching back to fork: ${id}", ("id",branches.second.front()->data.id()) );
+                  ilog( "Switching back to fork: ${id}", ("id",branches.second.front()->data->id()) );
                   // restore all blocks from the good fork
                   for( auto ritr2 = branches.second.rbegin(); ritr2 != branches.second.rend(); ++ritr2 )
                   {
-                     ilog( "pushing block #${n} ${id}", ("n",(*ritr2)->data.block_num())("id",(*ritr2)->id) );
+                     ilog( "pushing block #${n} ${id}", ("n",(*ritr2)->data->block_num())("id",(*ritr2)->id) );
                      auto session = _undo_db.start_undo_session();
-                     apply_block( (*ritr2)->data, skip );
-                     _block_id_to_block.store( (*ritr2)->id, (*ritr2)->data );
+                     apply_block( *(*ritr2)->data, skip );
+                     _block_id_to_block.store( (*ritr2)->id, *(*ritr2)->data );
                      session.commit();
                   }
                   throw *except;
@@ -202,17 +317,17 @@ bool database::_push_block(const signed_block& new_block)
 
    try {
       auto session = _undo_db.start_undo_session();
-      apply_block(new_block, skip);
-      _block_id_to_block.store(new_block.id(), new_block);
+      apply_block(*new_block, skip);
+      _block_id_to_block.store(new_block->id(), *new_block);
       session.commit();
    } catch ( const fc::exception& e ) {
       elog("Failed to push new block:\n${e}", ("e", e.to_detail_string()));
-      _fork_db.remove( new_block.id() );
+      _fork_db.remove( new_block->id() );
       throw;
    }
 
    return false;
-} FC_CAPTURE_AND_RETHROW( (new_block) ) }
+} FC_CAPTURE_AND_RETHROW( (*new_block) ) }
 
 /**
  * Attempts to push the transaction into the pending queue
@@ -226,7 +341,10 @@ bool database::_push_block(const signed_block& new_block)
 processed_transaction database::push_transaction( const precomputable_transaction& trx, uint32_t skip )
 { try {
    // see https://github.com/bitshares/bitshares-core/issues/1573
-   FC_ASSERT( fc::raw::pack_size( trx ) < (1024 * 1024), "Transaction exceeds maximum transaction size." );
+   // same as fc::raw::pack_size( trx ), but reuses the size computed by precompute_parallel
+   FC_ASSERT( trx.get_packed_size() + fc::raw::pack_size( trx.signatures ) < (1024 * 1024),
+              "Transaction exceeds maximum transaction size." );
+   write_scope scope( *this );
    processed_transaction result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -235,6 +353,85 @@ processed_transaction database::push_transaction( const precomputable_transactio
    return result;
 } FC_CAPTURE_AND_RETHROW( (trx) ) }
 
+void database::precheck_transaction( const precomputable_transaction& trx )const
+{ try {
+   const uint32_t skip = get_node_properties().skip_flags;
+   if( BOOST_LIKELY(head_block_num() > 0) )
+   {
+      const fc::time_point_sec now = head_block_time();
+      const chain_parameters& chain_parameters = get_global_properties().parameters;
+      FC_ASSERT( trx.expiration <= now + chain_parameters.maximum_time_until_expiration, "",
+                 ("trx.expiration",trx.expiration)("now",now)("max_til_exp",chain_parameters.maximum_time_until_expiration));
+      FC_ASSERT( now <= trx.expiration, "", ("now",now)("trx.exp",trx.expiration) );
+      if( !(skip & skip_tapos_check) )
+      {
+         const block_summary_object* tapos_block_summary = find( block_summary_id_type( trx.ref_block_num ) );
+         FC_ASSERT( tapos_block_summary != nullptr
+                    && trx.ref_block_prefix == tapos_block_summary->block_id._hash[1].value(),
+                    "Transaction does not reference a block of this chain" );
+      }
+   }
+   if( !(skip & skip_transaction_dupe_check) )
+   {
+      GRAPHENE_ASSERT( _p_recent_trx_idx->find(trx.id()) == nullptr,
+                       duplicate_transaction,
+                       "Transaction '${txid}' is already in the database",
+                       ("txid",trx.id()) );
+   }
+} FC_CAPTURE_AND_RETHROW( (trx) ) }
+
+namespace {
+   struct get_fee_visitor
+   {
+      typedef asset result_type;
+      template<typename Op>
+      asset operator()( const Op& op )const { return op.fee; }
+   };
+}
+
+/**
+ * @return the fees paid by all operations of trx, valued in the core asset at the current core exchange rates and
+ *         capped at GRAPHENE_MAX_SHARE_SUPPLY
+ *
+ * Only used to order the pending transactions. Called after trx has been applied, so it must not throw.
+ */
+static share_type get_core_fees( const database& db, const transaction& trx )
+{
+   fc::uint128_t result = 0;
+   for( const operation& op : trx.operations )
+   {
+      const asset fee = op.visit( get_fee_visitor() );
+      if( fee.amount <= 0 )
+         continue;
+      if( fee.asset_id == asset_id_type() )
+         result += fee.amount.value;
+      else
+      {
+         const asset_object* fee_asset = db.find( fee.asset_id );
+         if( fee_asset == nullptr )
+            continue;
+         const price& rate = fee_asset->options.core_exchange_rate;
+         fc::uint128_t core_amount = fee.amount.value;
+         if( rate.base.asset_id == fee.asset_id && rate.base.amount > 0 && rate.quote.amount > 0 )
+         {
+            core_amount *= rate.quote.amount.value;
+            core_amount /= rate.base.amount.value;
+         }
+         else if( rate.quote.asset_id == fee.asset_id && rate.quote.amount > 0 && rate.base.amount > 0 )
+         {
+            core_amount *= rate.base.amount.value;
+            core_amount /= rate.quote.amount.value;
+         }
+         else
+            continue;
+         result += core_amount;
+      }
+      if( result >= GRAPHENE_MAX_SHARE_SUPPLY )
+         return GRAPHENE_MAX_SHARE_SUPPLY;
+   }
+   return static_cast<int64_t>( result );
+}
+
 processed_transaction database::_push_transaction( const precomputable_transaction& trx )
 {
    // If this is the first transaction pushed after applying a block, start a new undo session.
@@ -247,9 +444,20 @@ processed_transaction database::_push_transaction( const precomputable_transacti
    // _apply_transaction fails.  If we make it to merge(), we
    // apply the changes.
 
+   // Remember the keys, so that they need not be recovered again when the transaction is included in a block
+   if( !(get_node_properties().skip_flags & skip_transaction_signatures) )
+      get_signature_keys( trx );
+
+   // the duplicate check of _apply_transaction may be skipped, but the pool holds every transaction once
+   GRAPHENE_ASSERT( _pending_tx.find( trx.id() ) == nullptr,
+                    duplicate_transaction,
+                    "Transaction '${txid}' is already pending",
+                    ("txid",trx.id()) );
+
    auto temp_session = _undo_db.start_undo_session();
    auto processed_trx = _apply_transaction( trx );
-   _pending_tx.push_back(processed_trx);
+   const bool added = _pending_tx.push_back( processed_trx, trx.id(), get_core_fees( *this, trx ) );
+   FC_ASSERT( added, "Transaction '${txid}' is already pending", ("txid",trx.id()) );
 
    // notify_changed_objects();
    // The transaction applied successfully. Merge its changes into the pending block session.
@@ -262,6 +470,7 @@ processed_transaction database::_push_transaction( const precomputable_transacti
 
 processed_transaction database::validate_transaction( const signed_transaction& trx )
 {
+   write_scope scope( *this );
    auto session = _undo_db.start_undo_session();
    return _apply_transaction( trx );
 }
@@ -331,6 +540,7 @@ signed_block database::generate_block(
    uint32_t skip /* = 0 */
    )
 { try {
+   write_scope scope( *this );
    signed_block result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -352,30 +562,14 @@ signed_block database::_generate_block(
    witness_id_type scheduled_witness = get_scheduled_witness( slot_num );
    FC_ASSERT( scheduled_witness == witness_id );
 
-   //
-   // The following code throws away existing pending_tx_session and
-   // rebuilds it by re-applying pending transactions.
-   //
-   // This rebuild is necessary because pending transactions' validity
-   // and semantics may have changed since they were received, because
-   // time-based semantics are evaluated based on the current block
-   // time.  These changes can only be reflected in the database when
-   // the value of the "when" variable is known, which means we need to
-   // re-apply pending transactions in this method.
-   //
-
-   // pop pending state (reset to head block state)
-   _pending_tx_session.reset();
-
-   // Check witness signing key
+   // Check witness signing key, as of the head block so that pending transactions can not affect it
    if( !(skip & skip_witness_signature) )
    {
-      // Note: if this check failed (which won't happen in normal situations),
-      // we would have temporarily broken the invariant that
-      // _pending_tx_session is the result of applying _pending_tx.
-      // In this case, when the node received a new block,
-      // the push_block() call will re-create the _pending_tx_session.
-      FC_ASSERT( witness_id(*this).signing_key == block_signing_private_key.get_public_key() );
+      unique_ptr<object> holder;
+      const object* witness_obj = find_object_at_head_block( witness_id, holder );
+      FC_ASSERT( witness_obj != nullptr );
+      FC_ASSERT( static_cast<const witness_object*>(witness_obj)->signing_key
+                 == block_signing_private_key.get_public_key() );
    }
 
    static const size_t max_partial_block_header_size = fc::raw::pack_size( signed_block_header() )
@@ -385,32 +579,46 @@ signed_block database::_generate_block(
    const size_t max_block_header_size = max_partial_block_header_size + fc::raw::pack_size( witness_id );
    auto maximum_block_size = get_global_properties().parameters.maximum_block_size;
    size_t total_block_size = max_block_header_size;
+   const size_t max_transactions_size = maximum_block_size > total_block_size
+                                        ? maximum_block_size - total_block_size : 0;
 
    signed_block pending_block;
-
-   _pending_tx_session = _undo_db.start_undo_session();
-
    uint64_t postponed_tx_count = 0;
-   for( const processed_transaction& tx : _pending_tx )
+
+   if( _pending_tx.total_size() <= max_transactions_size )
+   {
+      // The pending state is the result of applying _pending_tx in order on top of the head block, and
+      // transactions are evaluated against the head block time, so re-applying them all in the same order
+      // would give the same results and the same state.  Since all of them fit, the block is made of them as
+      // they are, which saves applying every pending transaction once more while the slot is running.
+      pending_block.transactions.reserve( _pending_tx.size() );
+      for( const pending_transaction_pool::entry& e : _pending_tx )
+         pending_block.transactions.push_back( e.trx );
+   }
+   else
    {
-      size_t new_total_size = total_block_size + fc::raw::pack_size( tx );
+      //
+      // The following code throws away existing pending_tx_session and
+      // rebuilds it by re-applying the pending transactions chosen to
+      // fill the block, which may be in a different order than they were
+      // received, so their validity and results may change.
+      //
+
+      // pop pending state (reset to head block state)
+      _pending_tx_session.reset();
+      _pending_tx_session = _undo_db.start_undo_session();
 
-      // postpone transaction if it would make block too big
-      if( new_total_size > maximum_block_size )
-      {
-         postponed_tx_count++;
-         continue;
-      }
+      // these would fail to apply anyway
+      if( head_block_num() > 0 )
+         _pending_tx.remove_expired( head_block_time() );
 
-      try
+      const auto candidates = _pending_tx.select( max_transactions_size );
+      postponed_tx_count = _pending_tx.size() - candidates.size();
+      for( const pending_transaction_pool::entry* candidate : candidates )
       {
-         auto temp_session = _undo_db.start_undo_session();
-         processed_transaction ptx = _apply_transaction( tx );
+         const processed_transaction& tx = candidate->trx;
+         size_t new_total_size = total_block_size + candidate->packed_size;
 
-         // We have to recompute pack_size(ptx) because it may be different
-         // than pack_size(tx) (i.e. if one or more results increased
-         // their size)
-         new_total_size = total_block_size + fc::raw::pack_size( ptx );
          // postpone transaction if it would make block too big
          if( new_total_size > maximum_block_size )
          {
@@ -418,16 +626,33 @@ signed_block database::_generate_block(
             continue;
          }
 
-         temp_session.merge();
-
-         total_block_size = new_total_size;
-         pending_block.transactions.push_back( ptx );
-      }
-      catch ( const fc::exception& e )
-      {
-         // Do nothing, transaction will not be re-applied
-         wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
-         wlog( "The transaction was ${t}", ("t", tx) );
+         try
+         {
+            auto temp_session = _undo_db.start_undo_session();
+            processed_transaction ptx = _apply_transaction( tx );
+
+            // We have to recompute pack_size(ptx) because it may be different
+            // than pack_size(tx) (i.e. if one or more results increased
+            // their size)
+            new_total_size = total_block_size + fc::raw::pack_size( ptx );
+            // postpone transaction if it would make block too big
+            if( new_total_size > maximum_block_size )
+            {
+               postponed_tx_count++;
+               continue;
+            }
+
+            temp_session.merge();
+
+            total_block_size = new_total_size;
+            pending_block.transactions.push_back( ptx );
+         }
+         catch ( const fc::exception& e )
+         {
+            // Do nothing, transaction will not be re-applied
+            wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
+            wlog( "The transaction was ${t}", ("t", tx) );
+         }
       }
    }
    if( postponed_tx_count > 0 )
@@ -462,6 +687,7 @@ signed_block database::_generate_block(
  */
 void database::pop_block()
 { try {
+   write_scope scope( *this );
    _pending_tx_session.reset();
    auto fork_db_head = _fork_db.head();
    FC_ASSERT( fork_db_head, "Trying to pop() from empty fork database!?" );
@@ -472,17 +698,134 @@ void database::pop_block()
       fork_db_head = _fork_db.fetch_block( head_block_id() );
       FC_ASSERT( fork_db_head, "Trying to pop() block that's not in fork database!?" );
    }
+   // the objects restored, and those changed by the blocks of another fork, are newer than the popped block
+   set_modification_stamp( head_block_num() + 1 );
    pop_undo();
-   _popped_tx.insert( _popped_tx.begin(), fork_db_head->data.transactions.begin(), fork_db_head->data.transactions.end() );
+   _popped_tx.insert( _popped_tx.begin(), fork_db_head->data->transactions.begin(), fork_db_head->data->transactions.end() );
 } FC_CAPTURE_AND_RETHROW() }
 
 void database::clear_pending()
 { try {
+   write_scope scope( *this );
    assert( (_pending_tx.size() == 0) || _pending_tx_session.valid() );
    _pending_tx.clear();
    _pending_tx_session.reset();
 } FC_CAPTURE_AND_RETHROW() }
 
+std::shared_lock<database::state_mutex> database::read_lock()const
+{
+   return std::shared_lock<state_mutex>( _read_write_mutex );
+}
+
+std::shared_lock<database::state_mutex> database::yielding_read_lock()const
+{
+   std::shared_lock<state_mutex> lock( _read_write_mutex, std::defer_lock );
+   while( !lock.try_lock() )
+      fc::usleep( fc::microseconds( 200 ) );
+   return lock;
+}
+
+void database::state_mutex::lock()
+{
+   std::unique_lock<std::mutex> guard( _mutex );
+   ++_waiting_writers;
+   try
+   {
+      while( _writing || _readers > 0 )
+      {
+         guard.unlock();
+         // the readers run in other threads, they must not hold up the other fibers of this one
+         fc::usleep( fc::microseconds( 200 ) );
+         guard.lock();
+      }
+   }
+   catch( ... )
+   {
+      if( !guard.owns_lock() )
+         guard.lock();
+      if( --_waiting_writers == 0 )
+         _readers_may_enter.notify_all();
+      throw;
+   }
+   --_waiting_writers;
+   _writing = true;
+}
+
+void database::state_mutex::unlock()
+{
+   {
+      std::lock_guard<std::mutex> guard( _mutex );
+      _writing = false;
+   }
+   _readers_may_enter.notify_all();
+}
+
+void database::state_mutex::lock_shared()
+{
+   std::unique_lock<std::mutex> guard( _mutex );
+   _readers_may_enter.wait( guard, [this] () { return !_writing && _waiting_writers == 0; } );
+   ++_readers;
+}
+
+bool database::state_mutex::try_lock_shared()
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   if( _writing || _waiting_writers > 0 )
+      return false;
+   ++_readers;
+   return true;
+}
+
+void database::state_mutex::unlock_shared()
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   --_readers;
+}
+
+database::write_scope::write_scope( database& db ) : _db( db )
+{
+   // the lock would wait for the read scope, which waits for this fiber
+   FC_ASSERT( _db._active_read_scope == nullptr, "The state can not be modified while it is read in a read scope" );
+   // counted only once the lock is held, other fibers of this thread run while lock() waits for the readers
+   if( _db._write_scope_depth == 0 )
+      _db._read_write_mutex.lock();
+   ++_db._write_scope_depth;
+}
+
+database::write_scope::~write_scope()
+{
+   if( --_db._write_scope_depth == 0 )
+      _db._read_write_mutex.unlock();
+}
+
+database::read_scope::read_scope( database& db ) : _db( db ), _lock( db.yielding_read_lock() )
+{
+   FC_ASSERT( _db._active_read_scope == nullptr && _db._write_scope_depth == 0 );
+   _db._active_read_scope = this;
+}
+
+database::read_scope::~read_scope()
+{
+   _db._active_read_scope = nullptr;
+}
+
+database::suspend_read_scope::suspend_read_scope( database& db ) : _db( db ), _suspended( db._active_read_scope )
+{
+   _db._active_read_scope = nullptr;
+}
+
+database::suspend_read_scope::~suspend_read_scope()
+{
+   _db._active_read_scope = _suspended;
+}
+
+const object* database::find_object_at_head_block( object_id_type id, unique_ptr<object>& holder )const
+{
+   // while transactions are pending, the topmost undo state holds their changes
+   const bool has_pending_state = _pending_tx_session.valid() && _undo_db.enabled() && _undo_db.size() > 0;
+   return _undo_db.find_before( id, has_pending_state ? 1 : 0, holder );
+}
+
 uint32_t database::push_applied_operation( const operation& op )
 {
    _applied_ops.emplace_back(op);
@@ -509,6 +852,22 @@ const vector<optional< operation_history_object > >& database::get_applied_opera
    return _applied_ops;
 }
 
+optional< vector< operation_history_object > > database::fetch_applied_operations( uint32_t block_num )const
+{
+   const auto data = fetch_packed_applied_operations( block_num );
+   if( !data.valid() )
+      return optional< vector< operation_history_object > >();
+   return fc::raw::unpack< vector< operation_history_object > >( *data );
+}
+
+optional< vector<char> > database::fetch_packed_applied_operations( uint32_t block_num )const
+{
+   // the operations of popped blocks are left in the log until a block of the new fork replaces them
+   if( block_num > head_block_num() )
+      return optional< vector<char> >();
+   return _applied_operation_log.fetch_packed( block_num );
+}
+
 //////////////////// private methods ////////////////////
 
 void database::apply_block( const signed_block& next_block, uint32_t skip )
@@ -520,8 +879,7 @@ void database::apply_block( const signed_block& next_block, uint32_t skip )
       if( itr != _checkpoints.end() )
          FC_ASSERT( next_block.id() == itr->second, "Block did not match checkpoint", ("checkpoint",*itr)("block_id",next_block.id()) );
 
-      if( _checkpoints.rbegin()->first >= block_num )
-         skip = ~0;// WE CAN SKIP ALMOST EVERYTHING
+      skip |= checkpoint_skip_flags( block_num );
    }
 
    detail::with_skip_flags( *this, skip, [&]()
@@ -531,15 +889,67 @@ void database::apply_block( const signed_block& next_block, uint32_t skip )
    return;
 }
 
+/**
+ * Calls f with the ID of every object created, modified or removed in changes.
+ *
+ * The ID counters of the indexes and the transaction history objects of the duplicate check are left out. Every
+ * transaction writes them, but they would not be shared by transactions running in parallel: IDs would be assigned
+ * when the results are merged, and the duplicate check only conflicts for identical transactions.
+ */
+template<typename F>
+static void for_each_written_object( const graphene::db::undo_state& changes, F&& f )
+{
+   const auto is_bookkeeping = []( const object_id_type& id ) {
+      return id.space() == transaction_history_object::space_id && id.type() == transaction_history_object::type_id;
+   };
+   for( const auto& item : changes.old_values )
+      if( !is_bookkeeping( item.first ) )
+         f( item.first );
+   for( const auto& id : changes.new_ids )
+      if( !is_bookkeeping( id ) )
+         f( id );
+   for( const auto& item : changes.removed )
+      if( !is_bookkeeping( item.first ) )
+         f( item.first );
+}
+
+/**
+ * @return the step at which a transaction with the given changes could run at the earliest, if transactions only
+ *         had to wait for earlier ones that wrote some of the same objects. Steps start at 1.
+ * @param last_step the step of the last transaction that wrote each object, updated for this transaction
+ */
+static uint32_t earliest_step( const graphene::db::undo_state& changes,
+                               std::unordered_map<object_id_type,uint32_t>& last_step )
+{
+   uint32_t step = 1;
+   for_each_written_object( changes, [&step,&last_step]( const object_id_type& id ) {
+      auto itr = last_step.find( id );
+      if( itr != last_step.end() )
+         step = std::max( step, itr->second + 1 );
+   });
+   for_each_written_object( changes, [step,&last_step]( const object_id_type& id ) {
+      last_step[id] = step;
+   });
+   return step;
+}
+
 void database::_apply_block( const signed_block& next_block )
 { try {
    uint32_t next_block_num = next_block.block_num();
    uint32_t skip = get_node_properties().skip_flags;
+   // plugins writing history use pointers to their indexes, which may still be loading. This blocks the thread
+   // instead of yielding, nothing else may run in the middle of a block.
+   wait_for_background_loads();
    _applied_ops.clear();
+   set_modification_stamp( next_block_num );
+   _block_timing = block_timing();
+   _block_timing.block_num = next_block_num;
+   _block_timing.transactions = next_block.transactions.size();
+   profile_stopwatch stopwatch( _block_timing, _active_replay_profile );
 
    if( !(skip & skip_block_size_check) )
    {
-      FC_ASSERT( fc::raw::pack_size(next_block) <= get_global_properties().parameters.maximum_block_size );
+      FC_ASSERT( next_block.get_packed_size() <= get_global_properties().parameters.maximum_block_size );
    }
 
    FC_ASSERT( (skip & skip_merkle_check) || next_block.transaction_merkle_root == next_block.calculate_merkle_root(),
@@ -553,6 +963,7 @@ void database::_apply_block( const signed_block& next_block )
    const auto& global_props = get_global_properties();
    const auto& dynamic_global_props = get_dynamic_global_properties();
    bool maint_needed = (dynamic_global_props.next_maintenance_time <= next_block.timestamp);
+   stopwatch.lap( &block_timing::header_ns, &replay_profile::header_ns );
 
    // trx_in_block starts from 0.
    // For real operations which are explicitly included in a transaction, op_in_trx starts from 0, virtual_op is 0.
@@ -565,6 +976,11 @@ void database::_apply_block( const signed_block& next_block )
 
    _issue_453_affected_assets.clear();
 
+   // The analysis reads the changes of each transaction from its own undo session, so it needs undo to be enabled
+   const bool analyze_conflicts = _analyze_transaction_conflicts && _undo_db.enabled();
+   std::unordered_map<object_id_type,uint32_t> last_step;
+   uint32_t steps = 0;
+
    for( const auto& trx : next_block.transactions )
    {
       /* We do not need to push the undo state for each transaction
@@ -573,10 +989,24 @@ void database::_apply_block( const signed_block& next_block )
        * for transactions when validating broadcast transactions or
        * when building a block.
        */
-      apply_transaction( trx, skip );
+      if( analyze_conflicts )
+      {
+         auto session = _undo_db.start_undo_session();
+         apply_transaction( trx, skip );
+         steps = std::max( steps, earliest_step( _undo_db.head(), last_step ) );
+         session.merge();
+      }
+      else
+         apply_transaction( trx, skip );
       ++_current_trx_in_block;
    }
 
+   _transaction_conflict_steps = steps;
+   if( analyze_conflicts && next_block.transactions.size() > 1 )
+      ilog( "Block #${n}: ${t} transactions, ${s} steps if only transactions writing the same objects were ordered",
+            ("n",next_block_num)("t",next_block.transactions.size())("s",steps) );
+   stopwatch.lap( &block_timing::transactions_ns, &replay_profile::transactions_ns );
+
    _current_op_in_trx    = 0;
    _current_virtual_op   = 0;
 
@@ -585,9 +1015,12 @@ void database::_apply_block( const signed_block& next_block )
    update_signing_witness(signing_witness, next_block);
    update_last_irreversible_block();
 
+   stopwatch.lap( &block_timing::block_updates_ns, &replay_profile::block_end_ns );
+
    // Are we at the maintenance interval?
    if( maint_needed )
       perform_chain_maintenance(next_block, global_props);
+   stopwatch.lap( &block_timing::maintenance_ns, &replay_profile::maintenance_ns );
 
    create_block_summary(next_block);
    clear_expired_transactions();
@@ -597,6 +1030,7 @@ void database::_apply_block( const signed_block& next_block )
    update_expired_feeds();       // this will update expired feeds and some core exchange rates
    update_core_exchange_rates(); // this will update remaining core exchange rates
    update_withdraw_permissions();
+   stopwatch.lap( &block_timing::expiry_ns, &replay_profile::block_end_ns );
 
    // n.b., update_maintenance_flag() happens this late
    // because get_slot_time() / get_slot_at_time() is needed above
@@ -607,17 +1041,26 @@ void database::_apply_block( const signed_block& next_block )
    update_witness_schedule();
    if( !_node_property_object.debug_updates.empty() )
       apply_debug_updates();
+   stopwatch.lap( &block_timing::block_updates_ns, &replay_profile::block_end_ns );
+
+   apply_batched_index_changes();
+   stopwatch.lap( &block_timing::batched_indexes_ns, &replay_profile::block_end_ns );
 
    // notify observers that the block has been applied
    notify_applied_block( next_block ); //emit
+   if( _applied_operation_log.is_open() )
+      _applied_operation_log.store( next_block.id(), _applied_ops );
    _applied_ops.clear();
+   stopwatch.lap( &block_timing::applied_block_ns, &replay_profile::plugins_ns );
 
    notify_changed_objects();
+   stopwatch.lap( &block_timing::changed_objects_ns, &replay_profile::plugins_ns );
+   stopwatch.finish();
 } FC_CAPTURE_AND_RETHROW( (next_block.block_num()) )  }
 
 
 
-processed_transaction database::apply_transaction(const signed_transaction& trx, uint32_t skip)
+processed_transaction database::apply_transaction(const precomputable_transaction& trx, uint32_t skip)
 {
    processed_transaction result;
    detail::with_skip_flags( *this, skip, [&]()
@@ -627,7 +1070,7 @@ processed_transaction database::apply_transaction(const signed_transaction& trx,
    return result;
 }
 
-processed_transaction database::_apply_transaction(const signed_transaction& trx)
+processed_transaction database::_apply_transaction(const precomputable_transaction& trx)
 { try {
    uint32_t skip = get_node_properties().skip_flags;
 
@@ -637,7 +1080,7 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    const chain_id_type& chain_id = get_chain_id();
    if( !(skip & skip_transaction_dupe_check) )
    {
-      GRAPHENE_ASSERT( trx_idx.indices().get<by_trx_id>().find(trx.id()) == trx_idx.indices().get<by_trx_id>().end(),
+      GRAPHENE_ASSERT( _p_recent_trx_idx->find(trx.id()) == nullptr,
                        duplicate_transaction,
                        "Transaction '${txid}' is already in the database",
                        ("txid",trx.id()) );
@@ -655,7 +1098,8 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
                             get_active,
                             get_owner,
                             allow_non_immediate_owner,
-                            get_global_properties().parameters.max_authority_depth );
+                            get_global_properties().parameters.max_authority_depth,
+                            &_authority_check_cache );
    }
 
    //Skip all manner of expiration and TaPoS checking if we're on block 1; It's impossible that the transaction is
@@ -692,7 +1136,7 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
 
    eval_state.operation_results.reserve(trx.operations.size());
 
-   //Finally process the operations
+   //Finally process the operations, the result keeps the ID, size, digest and keys of trx
    processed_transaction ptrx(trx);
    _current_op_in_trx = 0;
    for( const auto& op : ptrx.operations )
@@ -715,11 +1159,55 @@ operation_result database::apply_operation(transaction_evaluation_state& eval_st
    unique_ptr<op_evaluator>& eval = _operation_evaluators[ u_which ];
    FC_ASSERT( eval, "No registered evaluator for operation ${op}", ("op",op) );
    auto op_id = push_applied_operation( op );
+   if( BOOST_UNLIKELY( _active_replay_profile != nullptr && u_which < _active_replay_profile->operations.size() ) )
+   {
+      const auto start = std::chrono::steady_clock::now();
+      auto result = eval->evaluate( eval_state, op, true );
+      auto& stats = _active_replay_profile->operations[ u_which ];
+      ++stats.count;
+      stats.total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - start ).count();
+      set_applied_operation_result( op_id, result );
+      return result;
+   }
    auto result = eval->evaluate( eval_state, op, true );
    set_applied_operation_result( op_id, result );
    return result;
 } FC_CAPTURE_AND_RETHROW( (op) ) }
 
+bool database::evaluator_profiling_enabled()
+{
+#ifdef GRAPHENE_EVALUATOR_PROFILING
+   return true;
+#else
+   return false;
+#endif
+}
+
+vector<evaluator_statistics> database::get_evaluator_statistics()const
+{
+   vector<evaluator_statistics> result;
+#ifdef GRAPHENE_EVALUATOR_PROFILING
+   for( const auto& eval : _operation_evaluators )
+      if( eval && ( eval->statistics.evaluations > 0 || eval->statistics.applications > 0 ) )
+         result.push_back( eval->statistics );
+#endif
+   return result;
+}
+
+void database::reset_evaluator_statistics()
+{
+#ifdef GRAPHENE_EVALUATOR_PROFILING
+   for( const auto& eval : _operation_evaluators )
+      if( eval )
+      {
+         evaluator_statistics cleared;
+         cleared.operation = eval->statistics.operation;
+         eval->statistics = cleared;
+      }
+#endif
+}
+
 const witness_object& database::validate_block_header( uint32_t skip, const signed_block& next_block )const
 {
    FC_ASSERT( head_block_id() == next_block.previous, "", ("head_block_id",head_block_id())("next.prev",next_block.previous) );
@@ -762,50 +1250,120 @@ bool database::before_last_checkpoint()const
    return (_checkpoints.size() > 0) && (_checkpoints.rbegin()->first >= head_block_num());
 }
 
+uint32_t database::checkpoint_skip_flags( uint32_t block_num )const
+{
+   if( _checkpoints.empty() || _checkpoints.rbegin()->second == block_id_type()
+         || _checkpoints.rbegin()->first < block_num )
+      return skip_nothing;
+   return ~uint32_t( skip_merkle_check ); // WE CAN SKIP ALMOST EVERYTHING
+}
+
 
 static const uint32_t skip_expensive = database::skip_transaction_signatures | database::skip_witness_signature
                                        | database::skip_merkle_check | database::skip_transaction_dupe_check;
 
+/// When only validation is left to do, blocks with fewer transactions are not worth handing to worker threads
+static const size_t min_parallel_validation = 100;
+
+/// Whether the block contains operations whose validation checks commitments and range proofs
+static bool has_confidential_operations( const signed_block& block )
+{
+   for( const auto& trx : block.transactions )
+      for( const auto& op : trx.operations )
+         if( op.which() == operation::tag<transfer_to_blind_operation>::value
+               || op.which() == operation::tag<blind_transfer_operation>::value
+               || op.which() == operation::tag<transfer_from_blind_operation>::value )
+            return true;
+   return false;
+}
+
 template<typename Trx>
 void database::_precompute_parallel( const Trx* trx, const size_t count, const uint32_t skip )const
 {
-   for( size_t i = 0; i < count; ++i, ++trx )
+   for( size_t i = 0; i < count; ++i )
    {
-      trx->validate(); // TODO - parallelize wrt confidential operations
+      trx[i].validate(); // includes the commitment and range proof checks of confidential operations
       if ( !(skip & skip_block_size_check) )
-         trx->get_packed_size();
+         trx[i].get_packed_size();
       if( !(skip&skip_transaction_dupe_check) )
-         trx->id();
-      if( !(skip&skip_transaction_signatures) )
-         trx->get_signature_keys( get_chain_id() );
+         trx[i].id();
    }
+   if( !(skip&skip_transaction_signatures) )
+      _recover_signature_keys( trx, count );
+}
+
+template<typename Trx>
+void database::_recover_signature_keys( const Trx* trx, const size_t count )const
+{
+   // Collect the signatures of all transactions first, so that the signature cache is consulted in bulk
+   vector<signature_cache::request> requests;
+   vector<size_t> first_request( count );
+   for( size_t i = 0; i < count; ++i )
+   {
+      first_request[i] = requests.size();
+      const digest_type digest = trx[i].sig_digest( get_chain_id() );
+      for( const auto& sig : trx[i].signatures )
+         requests.push_back( { sig, digest, public_key_type() } );
+   }
+   _signature_cache.recover( requests );
+
+   for( size_t i = 0; i < count; ++i )
+   {
+      size_t next = first_request[i];
+      trx[i].get_signature_keys( get_chain_id(), [&requests,&next]( const signature_type&, const digest_type& ) {
+         return requests[next++].key;
+      });
+   }
+}
+
+const flat_set<public_key_type>& database::get_signature_keys( const precomputable_transaction& trx )const
+{
+   return trx.get_signature_keys( get_chain_id(), [this]( const signature_type& sig, const digest_type& digest ) {
+      return _signature_cache.recover( sig, digest );
+   });
 }
 
 fc::future<void> database::precompute_parallel( const signed_block& block, const uint32_t skip )const
 { try {
    std::vector<fc::future<void>> workers;
+   if( !(skip&skip_witness_signature) )
+      workers.push_back( fc::do_parallel( [&block] () { block.signee(); } ) );
+   if( !(skip&skip_block_size_check) )
+      workers.push_back( fc::do_parallel( [&block] () { block.get_packed_size(); } ) );
+
    if( !block.transactions.empty() )
    {
-      if( (skip & skip_expensive) == skip_expensive )
+      if( (skip & skip_expensive) == skip_expensive && block.transactions.size() < min_parallel_validation
+            && !has_confidential_operations( block ) )
          _precompute_parallel( &block.transactions[0], block.transactions.size(), skip );
       else
       {
+         // The workers also compute the merkle digests of their transactions, only the tree
+         // on top of them is built in this thread
+         auto merkle_digests = std::make_shared<vector<digest_type>>( skip & skip_merkle_check ? 0
+                                                                                : block.transactions.size() );
          uint32_t chunks = fc::asio::default_io_service_scope::get_num_threads();
          uint32_t chunk_size = ( block.transactions.size() + chunks - 1 ) / chunks;
-         workers.reserve( chunks + 1 );
+         std::vector<fc::future<void>> trx_workers;
+         trx_workers.reserve( chunks );
          for( size_t base = 0; base < block.transactions.size(); base += chunk_size )
-            workers.push_back( fc::do_parallel( [this,&block,base,chunk_size,skip] () {
-               _precompute_parallel( &block.transactions[base],
-                                     base + chunk_size < block.transactions.size() ? chunk_size : block.transactions.size() - base,
-                                     skip );
+            trx_workers.push_back( fc::do_parallel( [this,&block,merkle_digests,base,chunk_size,skip] () {
+               const size_t count = base + chunk_size < block.transactions.size() ? chunk_size
+                                                                                  : block.transactions.size() - base;
+               _precompute_parallel( &block.transactions[base], count, skip );
+               if( !merkle_digests->empty() )
+                  for( size_t i = base; i < base + count; ++i )
+                     (*merkle_digests)[i] = block.transactions[i].merkle_digest();
             }) );
+         if( !merkle_digests->empty() )
+         {
+            for( auto& worker : trx_workers )
+               worker.wait();
+            block.calculate_merkle_root( std::move(*merkle_digests) );
+         }
+         workers.insert( workers.end(), trx_workers.begin(), trx_workers.end() );
       }
    }
-
-   if( !(skip&skip_witness_signature) )
-      workers.push_back( fc::do_parallel( [&block] () { block.signee(); } ) );
-   if( !(skip&skip_merkle_check) )
-      block.calculate_merkle_root();
    block.id();
 
    if( workers.empty() )
@@ -818,6 +1376,19 @@ fc::future<void> database::precompute_parallel( const signed_block& block, const
    return *first;
 } FC_LOG_AND_RETHROW() }
 
+void database::precompute_block( const signed_block& block, const uint32_t skip )const
+{ try {
+   if( !block.transactions.empty() )
+      _precompute_parallel( &block.transactions[0], block.transactions.size(), skip );
+   if( !(skip&skip_witness_signature) )
+      block.signee();
+   if( !(skip&skip_block_size_check) )
+      block.get_packed_size();
+   if( !(skip&skip_merkle_check) )
+      block.calculate_merkle_root();
+   block.id();
+} FC_LOG_AND_RETHROW() }
+
 fc::future<void> database::precompute_parallel( const precomputable_transaction& trx )const
 {
    return fc::do_parallel([this,&trx] () {
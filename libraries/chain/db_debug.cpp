@@ -193,6 +193,7 @@ void database::apply_debug_updates()
 
 void database::debug_update( const fc::variant_object& update )
 {
+   write_scope scope( *this );
    block_id_type head_id = head_block_id();
    auto it = _node_property_object.debug_updates.find( head_id );
    if( it == _node_property_object.debug_updates.end() )
@@ -207,4 +208,35 @@ void database::debug_update( const fc::variant_object& update )
    push_block( *head_block );
 }
 
+void database::debug_start_fork()
+{
+   FC_ASSERT( !_debug_fork_point.valid(), "An experiment is running already since block ${n}",
+              ("n",*_debug_fork_point) );
+   _debug_fork_point = head_block_num();
+}
+
+uint32_t database::debug_discard_fork()
+{
+   FC_ASSERT( _debug_fork_point.valid(), "No experiment is running" );
+   write_scope scope( *this );
+   clear_pending();
+   uint32_t popped = 0;
+   while( head_block_num() > *_debug_fork_point )
+   {
+      const block_id_type popped_id = head_block_id();
+      pop_block();
+      _fork_db.remove( popped_id );
+      _block_id_to_block.remove( popped_id );
+      _node_property_object.debug_updates.erase( popped_id );
+      ++popped;
+   }
+   _popped_tx.clear();
+   _debug_fork_point.reset();
+
+   const auto& dgp = get_dynamic_global_properties();
+   _undo_db.set_max_size( dgp.head_block_number - dgp.last_irreversible_block_num + 1 );
+   _fork_db.set_max_size( dgp.head_block_number - dgp.last_irreversible_block_num + 1 );
+   return popped;
+}
+
 } }
@@ -27,6 +27,7 @@
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/chain_property_object.hpp>
 #include <graphene/chain/global_property_object.hpp>
+#include <graphene/chain/hardfork.hpp>
 
 namespace graphene { namespace chain {
 
@@ -55,6 +56,28 @@ const dynamic_global_property_object& database::get_dynamic_global_properties()
    return *_p_dyn_global_prop_obj;
 }
 
+void maintenance_hardforks::update( time_point_sec maint_time )
+{
+   next_maintenance_time     = maint_time;
+   before_core_hardfork_184  = ( maint_time <= HARDFORK_CORE_184_TIME );
+   before_core_hardfork_338  = ( maint_time <= HARDFORK_CORE_338_TIME );
+   before_core_hardfork_342  = ( maint_time <= HARDFORK_CORE_342_TIME );
+   before_core_hardfork_343  = ( maint_time <= HARDFORK_CORE_343_TIME );
+   before_core_hardfork_453  = ( maint_time <= HARDFORK_CORE_453_TIME );
+   before_core_hardfork_606  = ( maint_time <= HARDFORK_CORE_606_TIME );
+   before_core_hardfork_625  = ( maint_time <= HARDFORK_CORE_625_TIME );
+   before_core_hardfork_834  = ( maint_time <= HARDFORK_CORE_834_TIME );
+   before_core_hardfork_1270 = ( maint_time <= HARDFORK_CORE_1270_TIME );
+}
+
+const maintenance_hardforks& database::get_maintenance_hardforks()const
+{
+   const time_point_sec maint_time = get_dynamic_global_properties().next_maintenance_time;
+   if( maint_time != _maintenance_hardforks.next_maintenance_time )
+      _maintenance_hardforks.update( maint_time );
+   return _maintenance_hardforks;
+}
+
 const fee_schedule&  database::current_fee_schedule()const
 {
    return get_global_properties().parameters.get_current_fees();
@@ -186,30 +186,36 @@ void database::initialize_indexes()
    _undo_db.set_max_size( GRAPHENE_MIN_UNDO_HISTORY );
 
    //Protocol object indexes
-   add_index< primary_index<asset_index, 13> >(); // 8192 assets per chunk
+   auto asset_idx = add_index< primary_index<asset_index, 13> >(); // 8192 assets per chunk
+   asset_idx->add_secondary_index<asset_whitelist_index>( &_authorized_asset_cache );
    add_index< primary_index<force_settlement_index> >();
 
    auto acnt_index = add_index< primary_index<account_index, 20> >(); // ~1 million accounts per chunk
-   acnt_index->add_secondary_index<account_member_index>();
+   acnt_index->add_secondary_index<account_member_index>( acnt_index );
    acnt_index->add_secondary_index<account_referrer_index>();
+   acnt_index->add_secondary_index<account_authority_index>( &_authority_check_cache );
+   acnt_index->add_secondary_index<account_whitelist_index>( &_authorized_asset_cache );
 
    add_index< primary_index<committee_member_index, 8> >(); // 256 members per chunk
    add_index< primary_index<witness_index, 10> >(); // 1024 witnesses per chunk
-   add_index< primary_index<limit_order_index > >();
-   add_index< primary_index<call_order_index > >();
+   auto limit_order_idx = add_index< primary_index<limit_order_index > >();
+   _p_limit_order_book_idx = limit_order_idx->add_secondary_index<limit_order_book_index>();
+   auto call_order_idx = add_index< primary_index<call_order_index > >();
+   _p_call_order_book_idx = call_order_idx->add_secondary_index<call_order_book_index>();
 
    auto prop_index = add_index< primary_index<proposal_index > >();
    prop_index->add_secondary_index<required_approval_index>();
 
    add_index< primary_index<withdraw_permission_index > >();
-   add_index< primary_index<vesting_balance_index> >();
+   add_index< primary_index<vesting_balance_index, 16> >(); // 64 Ki per chunk
    add_index< primary_index<worker_index> >();
    add_index< primary_index<balance_index> >();
    add_index< primary_index<blinded_balance_index> >();
    add_index< primary_index< htlc_index> >();
 
    //Implementation object indexes
-   add_index< primary_index<transaction_index                             > >();
+   auto trx_idx = add_index< primary_index<transaction_index              > >();
+   _p_recent_trx_idx = trx_idx->add_secondary_index<recent_transaction_index>();
 
    auto bal_idx = add_index< primary_index<account_balance_index          > >();
    bal_idx->add_secondary_index<balances_by_account_index>();
@@ -440,36 +446,60 @@ void database::init_genesis(const genesis_state_type& genesis_state)
    for (uint32_t i = 0; i <= 0x10000; i++)
       create<block_summary_object>( [&]( block_summary_object&) {});
 
-   // Create initial accounts
-   for( const auto& account : genesis_state.initial_accounts )
+   // Create initial accounts. They are inserted directly, leaving the same objects that applying an
+   // account_create_operation registered by the temp account (and an account_upgrade_operation for
+   // lifetime members) would, which saves running the evaluators millions of times on large test networks.
    {
-      account_create_operation cop;
-      cop.name = account.name;
-      cop.registrar = GRAPHENE_TEMP_ACCOUNT;
-      cop.owner = authority(1, account.owner_key, 1);
-      if( account.active_key == public_key_type() )
+      const auto& accounts_by_name = get_index_type<account_index>().indices().get<by_exact_name>();
+      const auto& params = get_global_properties().parameters;
+      const account_id_type referrer; // the referrer of the operations is not set
+      const account_id_type lifetime_referrer = referrer(*this).lifetime_referrer;
+      for( const auto& account : genesis_state.initial_accounts )
       {
-         cop.active = cop.owner;
-         cop.options.memo_key = account.owner_key;
-      }
-      else
-      {
-         cop.active = authority(1, account.active_key, 1);
-         cop.options.memo_key = account.active_key;
-      }
-      account_id_type account_id(apply_operation(genesis_eval_state, cop).get<object_id_type>());
-
-      if( account.is_lifetime_member )
-      {
-          account_upgrade_operation op;
-          op.account_to_upgrade = account_id;
-          op.upgrade_to_lifetime_member = true;
-          apply_operation(genesis_eval_state, op);
+         FC_ASSERT( accounts_by_name.find( account.name ) == accounts_by_name.end(),
+                    "Account '${a}' already exists.", ("a",account.name) );
+         create<account_object>( [this,&account,&params,referrer,lifetime_referrer]( account_object& obj ) {
+            obj.registrar = GRAPHENE_TEMP_ACCOUNT;
+            obj.referrer = referrer;
+            obj.lifetime_referrer = lifetime_referrer;
+            obj.network_fee_percentage = params.network_percent_of_fee;
+            obj.lifetime_referrer_fee_percentage = params.lifetime_referrer_percent_of_fee;
+            obj.referrer_rewards_percentage = 0;
+
+            obj.name = account.name;
+            obj.owner = authority(1, account.owner_key, 1);
+            if( account.active_key == public_key_type() )
+            {
+               obj.active = obj.owner;
+               obj.options.memo_key = account.owner_key;
+            }
+            else
+            {
+               obj.active = authority(1, account.active_key, 1);
+               obj.options.memo_key = account.active_key;
+            }
+            obj.statistics = create<account_statistics_object>([&obj](account_statistics_object& s){
+                                s.owner = obj.id;
+                                s.name = obj.name;
+                                s.is_voting = obj.options.is_voting();
+                             }).id;
+
+            if( account.is_lifetime_member )
+            {
+               obj.membership_expiration_date = time_point_sec::maximum();
+               obj.referrer = obj.registrar = obj.lifetime_referrer = obj.get_id();
+               obj.lifetime_referrer_fee_percentage = GRAPHENE_100_PERCENT - obj.network_fee_percentage;
+            }
+         });
       }
+      // Fees are zero during genesis, so scaling the account registration fee would change nothing
+      modify( get_dynamic_global_properties(), [&genesis_state]( dynamic_global_property_object& p ) {
+         p.accounts_registered_this_interval += genesis_state.initial_accounts.size();
+      });
    }
 
    // Helper function to get account ID by name
-   const auto& accounts_by_name = get_index_type<account_index>().indices().get<by_name>();
+   const auto& accounts_by_name = get_index_type<account_index>().indices().get<by_exact_name>();
    auto get_account_id = [&accounts_by_name](const string& name) {
       auto itr = accounts_by_name.find(name);
       FC_ASSERT(itr != accounts_by_name.end(),
@@ -479,7 +509,7 @@ void database::init_genesis(const genesis_state_type& genesis_state)
    };
 
    // Helper function to get asset ID by symbol
-   const auto& assets_by_symbol = get_index_type<asset_index>().indices().get<by_symbol>();
+   const auto& assets_by_symbol = get_index_type<asset_index>().indices().get<by_exact_symbol>();
    const auto get_asset_id = [&assets_by_symbol](const string& symbol) {
       auto itr = assets_by_symbol.find(symbol);
       FC_ASSERT(itr != assets_by_symbol.end(),
@@ -690,6 +720,7 @@ void database::init_genesis(const genesis_state_type& genesis_state)
    // Enable fees
    modify(get_global_properties(), [&genesis_state](global_property_object& p) {
       p.parameters.get_mutable_fees() = genesis_state.initial_parameters.get_current_fees();
+      p.parameters.get_mutable_fees().build_lookup_table();
    });
 
    // Create witness scheduler
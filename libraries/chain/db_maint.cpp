@@ -22,6 +22,7 @@
  * THE SOFTWARE.
  */
 
+#include <fc/thread/parallel.hpp>
 #include <fc/uint128.hpp>
 
 #include <graphene/protocol/market.hpp>
@@ -45,6 +46,9 @@
 #include <graphene/chain/witness_object.hpp>
 #include <graphene/chain/worker_object.hpp>
 
+#include <algorithm>
+#include <sstream>
+
 namespace graphene { namespace chain {
 
 template<class Index>
@@ -53,26 +57,42 @@ vector<std::reference_wrapper<const typename Index::object_type>> database::sort
    using ObjectType = typename Index::object_type;
    const auto& all_objects = get_index_type<Index>().indices();
    count = std::min(count, all_objects.size());
-   vector<std::reference_wrapper<const ObjectType>> refs;
-   refs.reserve(all_objects.size());
-   std::transform(all_objects.begin(), all_objects.end(),
-                  std::back_inserter(refs),
-                  [](const ObjectType& o) { return std::cref(o); });
-   std::partial_sort(refs.begin(), refs.begin() + count, refs.end(),
-                   [this](const ObjectType& a, const ObjectType& b)->bool {
-      share_type oa_vote = _vote_tally_buffer[a.vote_id];
-      share_type ob_vote = _vote_tally_buffer[b.vote_id];
-      if( oa_vote != ob_vote )
-         return oa_vote > ob_vote;
+
+   // Look up the votes of each candidate once, the selection then only compares integers
+   struct candidate
+   {
+      uint64_t          votes;
+      vote_id_type      vote_id;
+      const ObjectType* object;
+   };
+   vector<candidate> candidates;
+   candidates.reserve(all_objects.size());
+   for( const ObjectType& o : all_objects )
+      candidates.push_back( candidate{ _vote_tally_buffer[o.vote_id], o.vote_id, &o } );
+
+   // Most votes first, ties broken by vote ID. Vote IDs are unique, so the order is total and selecting the
+   // top candidates before sorting them gives the same result as sorting everything.
+   const auto more_votes = []( const candidate& a, const candidate& b ) {
+      if( a.votes != b.votes )
+         return a.votes > b.votes;
       return a.vote_id < b.vote_id;
-   });
+   };
+   if( count < candidates.size() )
+      std::nth_element( candidates.begin(), candidates.begin() + count, candidates.end(), more_votes );
+   std::sort( candidates.begin(), candidates.begin() + count, more_votes );
 
-   refs.resize(count, refs.front());
+   vector<std::reference_wrapper<const ObjectType>> refs;
+   refs.reserve(count);
+   for( size_t i = 0; i < count; ++i )
+      refs.push_back( std::cref( *candidates[i].object ) );
    return refs;
 }
 
+/// With fewer accounts voting than this, the maintenance vote tally is not split across threads
+static const size_t min_parallel_tally = 10000;
+
 template<class Type>
-void database::perform_account_maintenance(Type tally_helper)
+void database::perform_account_maintenance(Type& tally_helper)
 {
    const auto& bal_idx = get_index_type< account_balance_index >().indices().get< by_maintenance_flag >();
    if( bal_idx.begin() != bal_idx.end() )
@@ -139,11 +159,17 @@ void database::update_worker_votes()
    bool allow_negative_votes = (head_block_time() < HARDFORK_607_TIME);
    while( itr != itr_end )
    {
-      modify( *itr, [this,allow_negative_votes]( worker_object& obj )
+      const uint64_t votes_for = _vote_tally_buffer[itr->vote_for];
+      const uint64_t votes_against = allow_negative_votes ? _vote_tally_buffer[itr->vote_against] : 0;
+      // Most workers have long expired and their votes rarely change, don't copy them into the undo state for nothing
+      if( itr->total_votes_for != votes_for || itr->total_votes_against != votes_against )
       {
-         obj.total_votes_for = _vote_tally_buffer[obj.vote_for];
-         obj.total_votes_against = allow_negative_votes ? _vote_tally_buffer[obj.vote_against] : 0;
-      });
+         modify( *itr, [votes_for,votes_against]( worker_object& obj )
+         {
+            obj.total_votes_for = votes_for;
+            obj.total_votes_against = votes_against;
+         });
+      }
       ++itr;
    }
 }
@@ -153,12 +179,14 @@ void database::pay_workers( share_type& budget )
    const auto head_time = head_block_time();
 //   ilog("Processing payroll! Available budget is ${b}", ("b", budget));
    vector<std::reference_wrapper<const worker_object>> active_workers;
-   // TODO optimization: add by_expiration index to avoid iterating through all objects
-   get_index_type<worker_index>().inspect_all_objects([head_time, &active_workers](const object& o) {
-      const worker_object& w = static_cast<const worker_object&>(o);
+   // Workers that have ended are skipped without being visited
+   const auto& end_date_idx = get_index_type<worker_index>().indices().get<by_end_date>();
+   for( auto itr = end_date_idx.lower_bound( head_time ); itr != end_date_idx.end(); ++itr )
+   {
+      const worker_object& w = *itr;
       if( w.is_active(head_time) && w.approving_stake() > 0 )
          active_workers.emplace_back(w);
-   });
+   }
 
    // worker with more votes is preferred
    // if two workers exactly tie for votes, worker with lower ID is preferred
@@ -707,9 +735,12 @@ void create_buyback_orders( database& db )
          continue;
       }
 
+      // copied, because receiving the bought asset may add a balance object to the account
+      vector< const account_balance_object* > balances;
       for( const auto& entry : bal_idx.get_account_balances( buyback_account.id ) )
+         balances.push_back( entry.second );
+      for( const auto* it : balances )
       {
-         const auto* it = entry.second;
          asset_id_type asset_to_sell = it->asset_type;
          share_type amount_to_sell = it->balance;
          if( asset_to_sell == asset_to_buy.id )
@@ -1143,29 +1174,87 @@ void process_hf_935( database& db )
    }
 }
 
+/// Logs the total duration of a maintenance and the duration of each of its phases
+void log_maintenance_timing( const maintenance_timing& timing )
+{
+   std::stringstream phases;
+   for( const auto& phase : timing.phases )
+      phases << " " << phase.first << " " << phase.second / 1000 << "ms;";
+   ilog( "Chain maintenance at block ${n} took ${t}ms:${p}",
+         ("n",timing.block_num)("t",timing.total_us / 1000)("p",phases.str()) );
+}
+
+/// Logs the total approximate memory usage of all indexes and the largest ones
+void log_memory_usage( const database& db )
+{
+   auto usage = db.get_memory_usage();
+   const auto total_bytes = []( const graphene::db::index_memory_usage& u ) {
+      return u.object_bytes + u.secondary_index_bytes;
+   };
+   uint64_t total = 0;
+   for( const auto& u : usage )
+      total += total_bytes( u );
+   const size_t top = std::min< size_t >( 5, usage.size() );
+   std::partial_sort( usage.begin(), usage.begin() + top, usage.end(),
+                      [&total_bytes]( const graphene::db::index_memory_usage& a,
+                                      const graphene::db::index_memory_usage& b ) {
+      return total_bytes( a ) > total_bytes( b );
+   });
+   std::stringstream largest;
+   for( size_t i = 0; i < top; ++i )
+      largest << " " << uint32_t(usage[i].space_id) << "." << uint32_t(usage[i].type_id) << ": "
+              << usage[i].object_count << " objects, " << ( total_bytes( usage[i] ) >> 20 ) << " MiB;";
+   ilog( "Approximate index memory usage at block ${n}: ${t} MiB, largest:${l}",
+         ("n",db.head_block_num())("t",total >> 20)("l",largest.str()) );
+}
+
 void database::perform_chain_maintenance(const signed_block& next_block, const global_property_object& global_props)
 {
    const auto& gpo = get_global_properties();
 
+   maintenance_timing timing;
+   timing.block_num = next_block.block_num();
+   timing.timestamp = next_block.timestamp;
+   const fc::time_point maintenance_start = fc::time_point::now();
+   fc::time_point phase_start = maintenance_start;
+   const auto end_phase = [&timing,&phase_start]( const char* name ) {
+      const fc::time_point now = fc::time_point::now();
+      timing.phases.emplace_back( name, ( now - phase_start ).count() );
+      phase_start = now;
+   };
+
    distribute_fba_balances(*this);
    create_buyback_orders(*this);
+   end_phase( "fba_and_buyback" );
 
    struct vote_tally_helper {
       database& d;
       const global_property_object& props;
+      // Loop invariants, looked up once rather than for each of the accounts that are tallied
+      const time_point_sec now;
+      const bool count_non_member_votes;
+      const uint16_t maximum_witness_count;
+      const uint16_t maximum_committee_count;
+      /// The account specifying the opinions and the stake voting with them, for each account that is counted
+      vector< std::pair< const account_object*, uint64_t > > stakes;
 
       vote_tally_helper(database& d, const global_property_object& gpo)
-         : d(d), props(gpo)
+         : d(d), props(gpo), now(d.head_block_time()),
+           count_non_member_votes(gpo.parameters.count_non_member_votes),
+           maximum_witness_count(gpo.parameters.maximum_witness_count),
+           maximum_committee_count(gpo.parameters.maximum_committee_count)
       {
          d._vote_tally_buffer.resize(props.next_available_vote_id);
-         d._witness_count_histogram_buffer.resize(props.parameters.maximum_witness_count / 2 + 1);
-         d._committee_count_histogram_buffer.resize(props.parameters.maximum_committee_count / 2 + 1);
+         d._witness_count_histogram_buffer.resize(maximum_witness_count / 2 + 1);
+         d._committee_count_histogram_buffer.resize(maximum_committee_count / 2 + 1);
          d._total_voting_stake = 0;
       }
 
+      // Called in maintenance order, interleaved with fee processing. Fees paid by one account can add to the
+      // cashback of another, so the stake must be read here. Adding it to the tallies is left to tally().
       void operator()( const account_object& stake_account, const account_statistics_object& stats )
       {
-         if( props.parameters.count_non_member_votes || stake_account.is_member(d.head_block_time()) )
+         if( count_non_member_votes || stake_account.is_member(now) )
          {
             // There may be a difference between the account whose stake is voting and the one specifying opinions.
             // Usually they're the same, but if the stake account has specified a voting_account, that account is the one
@@ -1175,47 +1264,123 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
                    GRAPHENE_PROXY_TO_SELF_ACCOUNT)? stake_account
                                      : d.get(stake_account.options.voting_account);
 
+            // Of all vesting balances only the cashback balance counts, and only its amount is read. No vesting
+            // policy is evaluated here, so there is nothing worth caching between maintenances.
             uint64_t voting_stake = stats.total_core_in_orders.value
                   + (stake_account.cashback_vb.valid() ? (*stake_account.cashback_vb)(d).balance.amount.value: 0)
                   + stats.core_in_balance.value;
 
+            stakes.emplace_back( &opinion_account, voting_stake );
+         }
+      }
+
+      /// Adds the stakes [begin, end) to the given buffers, which are laid out like the ones of the database
+      void tally( size_t begin, size_t end, vector<uint64_t>& vote_tally, vector<uint64_t>& witness_count_histogram,
+                  vector<uint64_t>& committee_count_histogram, uint64_t& total_voting_stake )const
+      {
+         const size_t tally_size = vote_tally.size();
+         for( size_t i = begin; i < end; ++i )
+         {
+            const account_object& opinion_account = *stakes[i].first;
+            const uint64_t voting_stake = stakes[i].second;
+
             for( vote_id_type id : opinion_account.options.votes )
             {
                uint32_t offset = id.instance();
                // if they somehow managed to specify an illegal offset, ignore it.
-               if( offset < d._vote_tally_buffer.size() )
-                  d._vote_tally_buffer[offset] += voting_stake;
+               if( offset < tally_size )
+                  vote_tally[offset] += voting_stake;
             }
 
-            if( opinion_account.options.num_witness <= props.parameters.maximum_witness_count )
+            if( opinion_account.options.num_witness <= maximum_witness_count )
             {
                uint16_t offset = std::min(size_t(opinion_account.options.num_witness/2),
-                                          d._witness_count_histogram_buffer.size() - 1);
+                                          witness_count_histogram.size() - 1);
                // votes for a number greater than maximum_witness_count
                // are turned into votes for maximum_witness_count.
                //
                // in particular, this takes care of the case where a
                // member was voting for a high number, then the
                // parameter was lowered.
-               d._witness_count_histogram_buffer[offset] += voting_stake;
+               witness_count_histogram[offset] += voting_stake;
             }
-            if( opinion_account.options.num_committee <= props.parameters.maximum_committee_count )
+            if( opinion_account.options.num_committee <= maximum_committee_count )
             {
                uint16_t offset = std::min(size_t(opinion_account.options.num_committee/2),
-                                          d._committee_count_histogram_buffer.size() - 1);
+                                          committee_count_histogram.size() - 1);
                // votes for a number greater than maximum_committee_count
                // are turned into votes for maximum_committee_count.
                //
                // same rationale as for witnesses
-               d._committee_count_histogram_buffer[offset] += voting_stake;
+               committee_count_histogram[offset] += voting_stake;
             }
 
-            d._total_voting_stake += voting_stake;
+            total_voting_stake += voting_stake;
+         }
+      }
+
+      /// Sums up all stakes into the buffers of the database. Large sweeps are split into ranges that are summed
+      /// up in parallel into buffers of their own. Addition is commutative, so the result is the same either way.
+      void tally_all()
+      {
+         const size_t count = stakes.size();
+         const size_t threads = fc::asio::default_io_service_scope::get_num_threads();
+         if( threads < 2 || count < min_parallel_tally )
+         {
+            tally( 0, count, d._vote_tally_buffer, d._witness_count_histogram_buffer,
+                   d._committee_count_histogram_buffer, d._total_voting_stake );
+            return;
+         }
+
+         struct partial_tally
+         {
+            vector<uint64_t> vote_tally;
+            vector<uint64_t> witness_count_histogram;
+            vector<uint64_t> committee_count_histogram;
+            uint64_t         total_voting_stake = 0;
+         };
+         const size_t chunk_size = ( count + threads - 1 ) / threads;
+         vector<partial_tally> partials( ( count + chunk_size - 1 ) / chunk_size );
+         // in the middle of a block, so the workers are waited for without yielding
+         vector<std::future<void>> workers;
+         workers.reserve( partials.size() );
+         for( size_t i = 0; i < partials.size(); ++i )
+         {
+            partial_tally& part = partials[i];
+            part.vote_tally.resize( d._vote_tally_buffer.size() );
+            part.witness_count_histogram.resize( d._witness_count_histogram_buffer.size() );
+            part.committee_count_histogram.resize( d._committee_count_histogram_buffer.size() );
+            const size_t begin = i * chunk_size;
+            const size_t end = std::min( count, begin + chunk_size );
+            workers.push_back( d.run_in_background_blocking( [this,&part,begin,end] () {
+               tally( begin, end, part.vote_tally, part.witness_count_histogram, part.committee_count_histogram,
+                      part.total_voting_stake );
+            }, "tally votes" ) );
+         }
+         // the workers refer to the partials, so none may still run when an exception leaves this scope
+         for( auto& worker : workers )
+            worker.wait();
+         for( auto& worker : workers )
+            worker.get();
+
+         const auto add_to = []( vector<uint64_t>& target, const vector<uint64_t>& source ) {
+            for( size_t i = 0; i < target.size(); ++i )
+               target[i] += source[i];
+         };
+         for( const auto& part : partials )
+         {
+            add_to( d._vote_tally_buffer, part.vote_tally );
+            add_to( d._witness_count_histogram_buffer, part.witness_count_histogram );
+            add_to( d._committee_count_histogram_buffer, part.committee_count_histogram );
+            d._total_voting_stake += part.total_voting_stake;
          }
       }
    } tally_helper(*this, gpo);
 
    perform_account_maintenance( tally_helper );
+   end_phase( "account_maintenance" );
+   tally_helper.tally_all();
+   end_phase( "vote_tally" );
 
    struct clear_canary {
       clear_canary(vector<uint64_t>& target): target(target){}
@@ -1228,9 +1393,13 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
                 c(_vote_tally_buffer);
 
    update_top_n_authorities(*this);
+   end_phase( "update_top_n_authorities" );
    update_active_witnesses();
+   end_phase( "update_active_witnesses" );
    update_active_committee_members();
+   end_phase( "update_active_committee_members" );
    update_worker_votes();
+   end_phase( "update_worker_votes" );
 
    const auto& dgpo = get_dynamic_global_properties();
    
@@ -1243,6 +1412,7 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
       {
          p.parameters = std::move(*p.pending_parameters);
          p.pending_parameters.reset();
+         p.parameters.get_mutable_fees().build_lookup_table();
       }
    });
 
@@ -1322,11 +1492,27 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
       match_call_orders(*this);
    }
 
+   end_phase( "parameters_and_hardforks" );
+
    process_bitassets();
+   end_phase( "process_bitassets" );
 
    // process_budget needs to run at the bottom because
    //   it needs to know the next_maintenance_time
    process_budget();
+   end_phase( "process_budget" );
+
+   timing.total_us = ( fc::time_point::now() - maintenance_start ).count();
+   _maintenance_timings.push_back( std::move( timing ) );
+   if( _maintenance_timings.size() > maintenance_timings_to_keep )
+      _maintenance_timings.pop_front();
+
+   if( _undo_db.enabled() ) // skip the log lines while replaying old blocks
+   {
+      log_maintenance_timing( _maintenance_timings.back() );
+      if( _memory_usage_log_enabled )
+         log_memory_usage(*this);
+   }
 }
 
 } }
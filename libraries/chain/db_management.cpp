@@ -32,12 +32,16 @@
 #include <graphene/protocol/fee_schedule.hpp>
 
 #include <fc/io/fstream.hpp>
+#include <fc/thread/parallel.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <fstream>
 #include <functional>
 #include <iostream>
-#include <queue>
-#include <tuple>
+#include <memory>
 
 namespace graphene { namespace chain {
 
@@ -52,6 +56,109 @@ database::~database()
    clear_pending();
 }
 
+namespace {
+   /// A block that is read and precomputed while earlier blocks are applied, @see database::reindex
+   struct replay_item
+   {
+      uint32_t               block_num = 0;
+      size_t                 position = 0; ///< position in the block database after reading the block
+      uint32_t               skip = 0;
+      optional<signed_block> block;
+      fc::future<void>       ready;
+   };
+
+   /// Time spent by the worker threads in microseconds, summed over all threads
+   struct replay_stats
+   {
+      std::atomic<uint64_t> read_time{0};
+      std::atomic<uint64_t> precompute_time{0};
+   };
+
+   /// Blocks in the order they are applied. Waits for the remaining workers when destroyed, so that none of them
+   /// outlives the replay when applying a block fails.
+   class replay_queue : public std::deque< std::shared_ptr< replay_item > >
+   {
+      public:
+         ~replay_queue() { wait_all(); }
+
+         void wait_all()
+         {
+            for( auto& item : *this )
+               try
+               {
+                  item->ready.wait();
+               }
+               catch( ... )
+               {
+               }
+         }
+   };
+
+   struct operation_name_visitor
+   {
+      typedef std::string result_type;
+
+      template<typename Type>
+      std::string operator()( const Type& )const { return fc::get_typename<Type>::name(); }
+   };
+
+   int64_t nanoseconds_since( const std::chrono::steady_clock::time_point& start )
+   {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start ).count();
+   }
+
+   /// Stops adding to the active replay profile when the replay ends, also if it fails
+   struct replay_profile_scope
+   {
+      replay_profile*& active;
+      ~replay_profile_scope() { active = nullptr; }
+   };
+
+   void log_replay_profile( const replay_profile& profile )
+   {
+      const auto sec = []( int64_t ns ) { return double( ns ) / 1000000000.0; };
+      ilog( "Replay profile of ${b} blocks and ${t} transactions in ${s} sec: reading ${r} sec, precomputing ${p} sec, "
+            "waiting ${w} sec, headers ${h} sec, transactions ${x} sec, maintenance ${m} sec, end of block ${e} sec, "
+            "plugins ${pl} sec, undo and block storage ${u} sec, rebuilding indexes ${i} sec",
+            ("b",profile.blocks)("t",profile.transactions)("s",sec(profile.total_ns))("r",sec(profile.read_ns))
+            ("p",sec(profile.precompute_ns))("w",sec(profile.wait_ns))("h",sec(profile.header_ns))
+            ("x",sec(profile.transactions_ns))("m",sec(profile.maintenance_ns))("e",sec(profile.block_end_ns))
+            ("pl",sec(profile.plugins_ns))("u",sec(profile.undo_ns))("i",sec(profile.rebuild_indexes_ns)) );
+
+      vector< const replay_profile::operation_stats* > by_time;
+      for( const auto& stats : profile.operations )
+         if( stats.count > 0 )
+            by_time.push_back( &stats );
+      std::sort( by_time.begin(), by_time.end(),
+                 []( const replay_profile::operation_stats* a, const replay_profile::operation_stats* b ) {
+         return a->total_ns > b->total_ns;
+      });
+      const size_t top = std::min< size_t >( 10, by_time.size() );
+      for( size_t i = 0; i < top; ++i )
+         ilog( "   ${name}: ${c} operations in ${s} sec, ${a} us on average",
+               ("name",by_time[i]->name)("c",by_time[i]->count)("s",sec(by_time[i]->total_ns))
+               ("a",double(by_time[i]->average_ns) / 1000.0) );
+   }
+
+   /// The description of the snapshot data_dir was started from, kept by database::load_snapshot
+   fc::path snapshot_info_file( const fc::path& data_dir )
+   {
+      return data_dir / "database" / "snapshot_info";
+   }
+
+   /// @return true if data_dir was started from a snapshot of the block head_id
+   bool is_snapshot_head( const fc::path& data_dir, const block_id_type& head_id )
+   {
+      const fc::path info_file = snapshot_info_file( data_dir );
+      if( !fc::exists( info_file ) )
+         return false;
+      std::string info_data;
+      fc::read_file_contents( info_file, info_data );
+      const auto info = fc::raw::unpack<snapshot_info>( std::vector<char>( info_data.begin(), info_data.end() ) );
+      return info.head_block.id() == head_id;
+   }
+}
+
 void database::reindex( fc::path data_dir )
 { try {
    auto last_block = _block_id_to_block.last();
@@ -62,8 +169,31 @@ void database::reindex( fc::path data_dir )
    }
    if( last_block->block_num() <= head_block_num()) return;
 
+   FC_ASSERT( _block_id_to_block.first_available_block_num() <= head_block_num() + 1,
+              "Unable to replay, blocks before ${n} have been pruned from the block database",
+              ("n",_block_id_to_block.first_available_block_num()) );
+
    ilog( "reindexing blockchain" );
+   write_scope scope( *this );
+   wait_for_background_loads();
    auto start = fc::time_point::now();
+
+   const auto profile_start = std::chrono::steady_clock::now();
+   replay_profile* profile = nullptr;
+   if( _replay_profile_enabled )
+   {
+      _replay_profile.reset( new replay_profile() );
+      profile = _replay_profile.get();
+      operation op;
+      profile->operations.resize( op.count() );
+      for( int64_t which = 0; which < op.count(); ++which )
+      {
+         op.set_which( which );
+         profile->operations[which].name = op.visit( operation_name_visitor() );
+      }
+   }
+   _active_replay_profile = profile;
+   replay_profile_scope profile_scope{ _active_replay_profile };
    const auto last_block_num = last_block->block_num();
    uint32_t undo_point = last_block_num < GRAPHENE_MAX_UNDO_HISTORY ? 0 : last_block_num - GRAPHENE_MAX_UNDO_HISTORY;
 
@@ -78,27 +208,58 @@ void database::reindex( fc::path data_dir )
 
    uint32_t skip = node_properties().skip_flags;
 
+   // nothing reads batched secondary indexes while replaying, build them once when done
+   suspend_batched_indexes();
+
    size_t total_block_size = _block_id_to_block.total_block_size();
    const auto& gpo = get_global_properties();
-   std::queue< std::tuple< size_t, signed_block, fc::future< void > > > blocks;
+   // blocks are read, unpacked and precomputed by worker threads while earlier blocks are applied
+   auto stats = std::make_shared< replay_stats >();
+   replay_queue blocks;
+   vector< std::shared_ptr< replay_item > > applied_items;
+   uint64_t wait_time = 0;
+   uint64_t apply_time = 0;
    uint32_t next_block_num = head_block_num() + 1;
    uint32_t i = next_block_num;
    while( next_block_num <= last_block_num || !blocks.empty() )
    {
-      if( next_block_num <= last_block_num && blocks.size() < 20 )
+      if( next_block_num <= last_block_num && blocks.size() < _replay_queue_depth )
       {
-         const size_t processed_block_size = _block_id_to_block.blocks_current_position();
-         fc::optional< signed_block > block = _block_id_to_block.fetch_by_number( next_block_num++ );
-         if( block.valid() )
-         {
-            if( block->timestamp >= last_block->timestamp - gpo.parameters.maximum_time_until_expiration )
-               skip &= ~skip_transaction_dupe_check;
-            blocks.emplace( processed_block_size, std::move(*block), fc::future<void>() );
-            std::get<2>(blocks.back()) = precompute_parallel( std::get<1>(blocks.back()), skip );
-         }
-         else
+         auto item = std::make_shared< replay_item >();
+         item->block_num = next_block_num++;
+         const fc::time_point_sec dupe_check_start = last_block->timestamp - gpo.parameters.maximum_time_until_expiration;
+         auto applied = std::make_shared< vector< std::shared_ptr< replay_item > > >( std::move( applied_items ) );
+         applied_items.clear();
+         item->ready = fc::do_parallel( [this,item,stats,skip,dupe_check_start,applied] () {
+            // free the blocks applied since the last worker started here, rather than in the applying thread
+            applied->clear();
+            const auto read_start = fc::time_point::now();
+            item->block = _block_id_to_block.fetch_by_number( item->block_num );
+            item->position = _block_id_to_block.blocks_current_position();
+            const auto precompute_start = fc::time_point::now();
+            stats->read_time += ( precompute_start - read_start ).count();
+            if( !item->block.valid() )
+               return;
+            item->skip = skip;
+            if( item->block->timestamp >= dupe_check_start )
+               item->skip &= ~skip_transaction_dupe_check;
+            precompute_block( *item->block, item->skip );
+            stats->precompute_time += ( fc::time_point::now() - precompute_start ).count();
+         });
+         blocks.push_back( item );
+      }
+      else
+      {
+         const auto wait_start = fc::time_point::now();
+         blocks.front()->ready.wait();
+         const auto apply_start = fc::time_point::now();
+         wait_time += ( apply_start - wait_start ).count();
+
+         if( !blocks.front()->block.valid() )
          {
             wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", i) );
+            blocks.wait_all();
+            blocks.clear();
             uint32_t dropped_count = 0;
             while( true )
             {
@@ -114,23 +275,20 @@ void database::reindex( fc::path data_dir )
             }
             wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
             next_block_num = last_block_num + 1; // don't load more blocks
+            continue;
          }
-      }
-      else
-      {
-         std::get<2>(blocks.front()).wait();
-         const signed_block& block = std::get<1>(blocks.front());
 
+         const signed_block& block = *blocks.front()->block;
          if( i % 10000 == 0 )
          {
             std::stringstream bysize;
             std::stringstream bynum;
-            bysize << std::fixed << std::setprecision(5) << double(std::get<0>(blocks.front())) / total_block_size * 100;
+            bysize << std::fixed << std::setprecision(5) << double(blocks.front()->position) / total_block_size * 100;
             bynum << std::fixed << std::setprecision(5) << double(i*100)/last_block_num;
             ilog(
                "   [by size: ${size}%   ${processed} of ${total}]   [by num: ${num}%   ${i} of ${last}]",
                ("size", bysize.str())
-               ("processed", std::get<0>(blocks.front()))
+               ("processed", blocks.front()->position)
                ("total", total_block_size)
                ("num", bynum.str())
                ("i", i)
@@ -144,19 +302,50 @@ void database::reindex( fc::path data_dir )
             ilog( "Done" );
          }
          if( i < undo_point )
-            apply_block( block, skip );
+            apply_block( block, blocks.front()->skip );
          else
          {
             _undo_db.enable();
-            push_block( block, skip );
+            const auto push_start = std::chrono::steady_clock::now();
+            const int64_t applied_before = profile ? profile->apply_ns() : 0;
+            push_block( block, blocks.front()->skip );
+            if( profile )
+               profile->undo_ns += nanoseconds_since( push_start ) - ( profile->apply_ns() - applied_before );
+         }
+         if( profile )
+         {
+            ++profile->blocks;
+            profile->transactions += block.transactions.size();
          }
-         blocks.pop();
+         applied_items.push_back( std::move( blocks.front() ) );
+         blocks.pop_front();
          i++;
+         apply_time += ( fc::time_point::now() - apply_start ).count();
       }
    }
+   ilog( "Replay timing: reading ${r} sec and precomputing ${p} sec in ${n} parallel slots, "
+         "waiting for blocks ${w} sec, applying blocks ${a} sec",
+         ("r",double(stats->read_time)/1000000.0)("p",double(stats->precompute_time)/1000000.0)
+         ("n",_replay_queue_depth)("w",double(wait_time)/1000000.0)("a",double(apply_time)/1000000.0) );
    _undo_db.enable();
+   ilog( "Rebuilding secondary indexes..." );
+   const auto rebuild_start = std::chrono::steady_clock::now();
+   rebuild_batched_indexes();
    auto end = fc::time_point::now();
    ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
+
+   if( profile )
+   {
+      profile->rebuild_indexes_ns = nanoseconds_since( rebuild_start );
+      profile->total_ns = nanoseconds_since( profile_start );
+      profile->read_ns = int64_t( stats->read_time ) * 1000;
+      profile->precompute_ns = int64_t( stats->precompute_time ) * 1000;
+      profile->wait_ns = int64_t( wait_time ) * 1000;
+      for( auto& op_stats : profile->operations )
+         if( op_stats.count > 0 )
+            op_stats.average_ns = op_stats.total_ns / int64_t( op_stats.count );
+      log_replay_profile( *profile );
+   }
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
 void database::wipe(const fc::path& data_dir, bool include_blocks)
@@ -170,6 +359,71 @@ void database::wipe(const fc::path& data_dir, bool include_blocks)
       fc::remove_all( data_dir / "database" );
 }
 
+void database::save_snapshot( const fc::path& dir, const std::string& db_version )const
+{ try {
+   FC_ASSERT( head_block_num() > 0, "Nothing to save before the first block" );
+   FC_ASSERT( !fc::exists( dir ), "Snapshot destination exists already" );
+   snapshot_info info;
+   info.db_version = db_version;
+   info.chain_id = get_chain_id();
+   auto head_block = fetch_block_by_id( head_block_id() );
+   FC_ASSERT( head_block.valid(), "Unable to find the head block ${id}", ("id",head_block_id()) );
+   info.head_block = std::move( *head_block );
+
+   ilog( "Saving snapshot of block ${n} to ${d}", ("n",head_block_num())("d",dir) );
+   object_database::save_copy( dir / "object_database" );
+   std::ofstream out( (dir / "snapshot_info").generic_string(), std::ios::out | std::ios::binary | std::ios::trunc );
+   fc::raw::pack( out, info );
+   out.close();
+   FC_ASSERT( out, "Failed to write snapshot_info" );
+   ilog( "Done saving snapshot." );
+} FC_CAPTURE_AND_RETHROW( (dir)(db_version) ) }
+
+snapshot_info database::load_snapshot( const fc::path& snapshot_dir, const fc::path& data_dir,
+                                        const std::string& db_version, const chain_id_type& chain_id )
+{ try {
+   FC_ASSERT( !_opened, "Snapshots can only be loaded into a closed database" );
+   const fc::path info_file = snapshot_dir / "snapshot_info";
+   FC_ASSERT( fc::exists( info_file ), "${f} not found, the snapshot is incomplete", ("f",info_file) );
+   std::string info_data;
+   fc::read_file_contents( info_file, info_data );
+   const auto info = fc::raw::unpack<snapshot_info>( std::vector<char>( info_data.begin(), info_data.end() ) );
+   FC_ASSERT( info.db_version == db_version,
+              "The snapshot was written with database version ${s}, this node uses version ${v}",
+              ("s",info.db_version)("v",db_version) );
+   FC_ASSERT( info.chain_id == chain_id, "The snapshot belongs to chain ${s}, not to ${c}",
+              ("s",info.chain_id)("c",chain_id) );
+
+   ilog( "Loading snapshot of block ${n} from ${d}", ("n",info.head_block.block_num())("d",snapshot_dir) );
+   wipe( data_dir, true );
+   const fc::path object_dir = data_dir / "object_database";
+   for( fc::directory_iterator space_itr( snapshot_dir / "object_database" ); space_itr != fc::directory_iterator();
+        ++space_itr )
+   {
+      const fc::path space_dir = *space_itr;
+      fc::create_directories( object_dir / space_dir.filename() );
+      for( fc::directory_iterator itr( space_dir ); itr != fc::directory_iterator(); ++itr )
+      {
+         const fc::path file = *itr;
+         fc::copy( file, object_dir / space_dir.filename() / file.filename() );
+      }
+   }
+   std::ofstream version_file( (data_dir / "db_version").generic_string().c_str(),
+                               std::ios::out | std::ios::binary | std::ios::trunc );
+   version_file.write( db_version.c_str(), db_version.size() );
+   version_file.close();
+
+   // the head block lets open() link the next block to the loaded state
+   block_database blocks;
+   blocks.open( data_dir / "database" / "block_num_to_block" );
+   blocks.store( info.head_block.id(), info.head_block );
+   blocks.close();
+   // lets open() accept the state of the snapshot also if its head block is not in the block database
+   fc::copy( info_file, snapshot_info_file( data_dir ) );
+   ilog( "Done loading snapshot." );
+   return info;
+} FC_CAPTURE_AND_RETHROW( (snapshot_dir)(data_dir)(db_version)(chain_id) ) }
+
 void database::open(
    const fc::path& data_dir,
    std::function<genesis_state_type()> genesis_loader,
@@ -177,6 +431,7 @@ void database::open(
 {
    try
    {
+      write_scope scope( *this );
       bool wipe_object_db = false;
       if( !fc::exists( data_dir / "db_version" ) )
          wipe_object_db = true;
@@ -198,6 +453,8 @@ void database::open(
       object_database::open(data_dir);
 
       _block_id_to_block.open(data_dir / "database" / "block_num_to_block");
+      if( _applied_operation_log_enabled )
+         _applied_operation_log.open( data_dir / "database" / "applied_operations" );
 
       if( !find(global_property_id_type()) )
          init_genesis(genesis_loader());
@@ -209,14 +466,26 @@ void database::open(
          _p_chain_property_obj = &get( chain_property_id_type() );
          _p_dyn_global_prop_obj = &get( dynamic_global_property_id_type() );
          _p_witness_schedule_obj = &get( witness_schedule_id_type() );
+         // the lookup table of the fee schedule is not stored
+         modify( *_p_global_prop_obj, []( global_property_object& p ) {
+            p.parameters.get_mutable_fees().build_lookup_table();
+         });
       }
 
+      // the objects loaded may have changed in any block up to the head block
+      set_loaded_objects_stamp( head_block_num() );
+      set_modification_stamp( head_block_num() );
+
       fc::optional<block_id_type> last_block = _block_id_to_block.last_id();
       if( last_block.valid() )
       {
-         FC_ASSERT( *last_block >= head_block_id(),
-                    "last block ID does not match current chain state",
-                    ("last_block->id", last_block)("head_block_id",head_block_num()) );
+         // The state is only written at irreversible blocks, but after a dirty shutdown it can be ahead of the
+         // blocks that made it to disk, or belong to a block the block database does not contain. A node started
+         // from a snapshot has no blocks up to the head block of the snapshot, its state is accepted at that block.
+         FC_ASSERT( head_block_num() == 0 || _block_id_to_block.contains( head_block_id() )
+                    || is_snapshot_head( data_dir, head_block_id() ),
+                    "The chain state of block ${n} does not match the block database, a replay is required",
+                    ("n",head_block_num())("head_block_id",head_block_id())("last_block_id",last_block) );
          reindex( data_dir );
       }
       _opened = true;
@@ -228,7 +497,8 @@ void database::close(bool rewind)
 {
    if (!_opened)
       return;
-      
+   write_scope scope( *this );
+
    // TODO:  Save pending tx's on close()
    clear_pending();
 
@@ -264,6 +534,7 @@ void database::close(bool rewind)
 
    if( _block_id_to_block.is_open() )
       _block_id_to_block.close();
+   _applied_operation_log.close();
 
    _fork_db.reset();
 
@@ -32,6 +32,8 @@
 
 #include <fc/uint128.hpp>
 
+#include <exception>
+
 namespace graphene { namespace chain {
 
 namespace detail {
@@ -47,6 +49,27 @@ namespace detail {
 
 } //detail
 
+database::market_fee_batch::market_fee_batch( database& db )
+   : _db( db ), _uncaught_exceptions( std::uncaught_exceptions() )
+{
+   ++_db._market_fee_batch_depth;
+}
+
+database::market_fee_batch::~market_fee_batch() noexcept(false)
+{
+   if( --_db._market_fee_batch_depth > 0 )
+      return;
+   // the changes of the operation are undone anyway, but a batch that merely lives in a destructor called
+   // during unwinding must still be written out
+   if( std::uncaught_exceptions() > _uncaught_exceptions )
+   {
+      _db._batched_issuer_fees.clear();
+      _db._batched_fee_rewards.clear();
+      return;
+   }
+   _db.flush_market_fees();
+}
+
 /**
  * All margin positions are force closed at the swan price
  * Collateral received goes into a force-settlement fund
@@ -67,8 +90,7 @@ void database::globally_settle_asset( const asset_object& mia, const price& sett
 
    const auto& call_price_index = get_index_type<call_order_index>().indices().get<by_price>();
 
-   auto maint_time = get_dynamic_global_properties().next_maintenance_time;
-   bool before_core_hardfork_342 = ( maint_time <= HARDFORK_CORE_342_TIME ); // better rounding
+   bool before_core_hardfork_342 = get_maintenance_hardforks().before_core_hardfork_342; // better rounding
 
    // cancel all call orders and accumulate it into collateral_gathered
    auto call_itr = call_price_index.lower_bound( price::min( bitasset.options.short_backing_asset, mia.id ) );
@@ -183,7 +205,7 @@ void database::execute_bid( const collateral_bid_object& bid, share_type debt_co
          call.collateral = bid.inv_swan_price.base.amount + collateral_from_fund;
          call.debt = debt_covered;
          // don't calculate call_price after core-1270 hard fork
-         if( get_dynamic_global_properties().next_maintenance_time > HARDFORK_CORE_1270_TIME )
+         if( !get_maintenance_hardforks().before_core_hardfork_1270 )
             // bid.inv_swan_price is in collateral / debt
             call.call_price = price( asset( 1, bid.inv_swan_price.base.asset_id ),
                                      asset( 1, bid.inv_swan_price.quote.asset_id ) );
@@ -344,6 +366,7 @@ bool maybe_cull_small_order( database& db, const limit_order_object& order )
 
 bool database::apply_order_before_hardfork_625(const limit_order_object& new_order_object, bool allow_black_swan)
 {
+   market_fee_batch fee_batch( *this );
    auto order_id = new_order_object.id;
    const asset_object& sell_asset = get(new_order_object.amount_for_sale().asset_id);
    const asset_object& receive_asset = get(new_order_object.amount_to_receive().asset_id);
@@ -356,16 +379,15 @@ bool database::apply_order_before_hardfork_625(const limit_order_object& new_ord
    if( called_some && !find_object(order_id) ) // then we were filled by call order
       return true;
 
-   const auto& limit_price_idx = get_index_type<limit_order_index>().indices().get<by_price>();
-
    // TODO: it should be possible to simply check the NEXT/PREV iterator after new_order_object to
    // determine whether or not this order has "changed the book" in a way that requires us to
    // check orders. For now I just lookup the lower bound and check for equality... this is log(n) vs
    // constant time check. Potential optimization.
 
    auto max_price = ~new_order_object.sell_price;
-   auto limit_itr = limit_price_idx.lower_bound(max_price.max());
-   auto limit_end = limit_price_idx.upper_bound(max_price);
+   const auto& book = get_limit_order_books().get_book( receive_asset.id, sell_asset.id );
+   auto limit_itr = book.begin();
+   auto limit_end = book.upper_bound( price_sort_key( max_price ) );
 
    bool finished = false;
    while( !finished && limit_itr != limit_end )
@@ -373,7 +395,7 @@ bool database::apply_order_before_hardfork_625(const limit_order_object& new_ord
       auto old_limit_itr = limit_itr;
       ++limit_itr;
       // match returns 2 when only the old order was fully filled. In this case, we keep matching; otherwise, we stop.
-      finished = (match(new_order_object, *old_limit_itr, old_limit_itr->sell_price) != 2);
+      finished = (match(new_order_object, *old_limit_itr->order, old_limit_itr->order->sell_price) != 2);
    }
 
    //Possible optimization: only check calls if the new order completely filled some old order
@@ -395,24 +417,22 @@ bool database::apply_order_before_hardfork_625(const limit_order_object& new_ord
 
 bool database::apply_order(const limit_order_object& new_order_object, bool allow_black_swan)
 {
+   market_fee_batch fee_batch( *this );
    auto order_id = new_order_object.id;
    asset_id_type sell_asset_id = new_order_object.sell_asset_id();
    asset_id_type recv_asset_id = new_order_object.receive_asset_id();
 
    // We only need to check if the new order will match with others if it is at the front of the book
-   const auto& limit_price_idx = get_index_type<limit_order_index>().indices().get<by_price>();
-   auto limit_itr = limit_price_idx.lower_bound( boost::make_tuple( new_order_object.sell_price, order_id ) );
-   if( limit_itr != limit_price_idx.begin() )
-   {
-      --limit_itr;
-      if( limit_itr->sell_asset_id() == sell_asset_id && limit_itr->receive_asset_id() == recv_asset_id )
-         return false;
-   }
+   const limit_order_book_index& books = get_limit_order_books();
+   const auto& own_book = books.get_book( sell_asset_id, recv_asset_id );
+   if( !own_book.empty() && own_book.begin()->id != order_id )
+      return false;
 
    // this is the opposite side (on the book)
    auto max_price = ~new_order_object.sell_price;
-   limit_itr = limit_price_idx.lower_bound( max_price.max() );
-   auto limit_end = limit_price_idx.upper_bound( max_price );
+   const auto& book = books.get_book( recv_asset_id, sell_asset_id );
+   auto limit_itr = book.begin();
+   auto limit_end = book.upper_bound( price_sort_key( max_price ) );
 
    // Order matching should be in favor of the taker.
    // When a new limit order is created, e.g. an ask, need to check if it will match the highest bid.
@@ -445,8 +465,8 @@ bool database::apply_order(const limit_order_object& new_order_object, bool allo
    // 5. the call order's collateral ratio is below or equals to MCR
    // 6. the limit order provided a good price
 
-   auto maint_time = get_dynamic_global_properties().next_maintenance_time;
-   bool before_core_hardfork_1270 = ( maint_time <= HARDFORK_CORE_1270_TIME ); // call price caching issue
+   // call price caching issue
+   bool before_core_hardfork_1270 = get_maintenance_hardforks().before_core_hardfork_1270;
 
    bool to_check_call_orders = false;
    const asset_object& sell_asset = sell_asset_id( *this );
@@ -473,31 +493,28 @@ bool database::apply_order(const limit_order_object& new_order_object, bool allo
    if( to_check_call_orders )
    {
       // check limit orders first, match the ones with better price in comparison to call orders
-      while( !finished && limit_itr != limit_end && limit_itr->sell_price > call_match_price )
+      while( !finished && limit_itr != limit_end && limit_itr->order->sell_price > call_match_price )
       {
          auto old_limit_itr = limit_itr;
          ++limit_itr;
          // match returns 2 when only the old order was fully filled. In this case, we keep matching; otherwise, we stop.
-         finished = ( match( new_order_object, *old_limit_itr, old_limit_itr->sell_price ) != 2 );
+         finished = ( match( new_order_object, *old_limit_itr->order, old_limit_itr->order->sell_price ) != 2 );
       }
 
       if( !finished && !before_core_hardfork_1270 ) // TODO refactor or cleanup duplicate code after core-1270 hard fork
       {
          // check if there are margin calls
-         const auto& call_collateral_idx = get_index_type<call_order_index>().indices().get<by_collateral>();
-         auto call_min = price::min( recv_asset_id, sell_asset_id );
+         const auto& call_book = get_call_order_books().get_book( sell_asset_id, recv_asset_id );
          while( !finished )
          {
             // hard fork core-343 and core-625 took place at same time,
             // always check call order with least collateral ratio
-            auto call_itr = call_collateral_idx.lower_bound( call_min );
-            if( call_itr == call_collateral_idx.end()
-                  || call_itr->debt_type() != sell_asset_id
+            if( call_book.empty()
                   // feed protected https://github.com/cryptonomex/graphene/issues/436
-                  || call_itr->collateralization() > sell_abd->current_maintenance_collateralization )
+                  || call_book.begin()->order->collateralization() > sell_abd->current_maintenance_collateralization )
                break;
             // hard fork core-338 and core-625 took place at same time, not checking HARDFORK_CORE_338_TIME here.
-            int match_result = match( new_order_object, *call_itr, call_match_price,
+            int match_result = match( new_order_object, *call_book.begin()->order, call_match_price,
                                       sell_abd->current_feed.settlement_price,
                                       sell_abd->current_feed.maintenance_collateral_ratio,
                                       sell_abd->current_maintenance_collateralization );
@@ -540,7 +557,7 @@ bool database::apply_order(const limit_order_object& new_order_object, bool allo
       auto old_limit_itr = limit_itr;
       ++limit_itr;
       // match returns 2 when only the old order was fully filled. In this case, we keep matching; otherwise, we stop.
-      finished = ( match( new_order_object, *old_limit_itr, old_limit_itr->sell_price ) != 2 );
+      finished = ( match( new_order_object, *old_limit_itr->order, old_limit_itr->order->sell_price ) != 2 );
    }
 
    const limit_order_object* updated_order_object = find< limit_order_object >( order_id );
@@ -574,8 +591,8 @@ int database::match( const limit_order_object& usd, const limit_order_object& co
 
    asset usd_pays, usd_receives, core_pays, core_receives;
 
-   auto maint_time = get_dynamic_global_properties().next_maintenance_time;
-   bool before_core_hardfork_342 = ( maint_time <= HARDFORK_CORE_342_TIME ); // better rounding
+   const auto& hardforks = get_maintenance_hardforks();
+   bool before_core_hardfork_342 = hardforks.before_core_hardfork_342; // better rounding
 
    bool cull_taker = false;
    if( usd_for_sale <= core_for_sale * match_price ) // rounding down here should be fine
@@ -584,7 +601,7 @@ int database::match( const limit_order_object& usd, const limit_order_object& co
 
       // Be here, it's possible that taker is paying something for nothing due to partially filled in last loop.
       // In this case, we see it as filled and cancel it later
-      if( usd_receives.amount == 0 && maint_time > HARDFORK_CORE_184_TIME )
+      if( usd_receives.amount == 0 && !hardforks.before_core_hardfork_184 )
          return 1;
 
       if( before_core_hardfork_342 )
@@ -638,11 +655,11 @@ int database::match( const limit_order_object& bid, const call_order_object& ask
    FC_ASSERT( bid.receive_asset_id() == ask.collateral_type() );
    FC_ASSERT( bid.for_sale > 0 && ask.debt > 0 && ask.collateral > 0 );
 
-   auto maint_time = get_dynamic_global_properties().next_maintenance_time;
+   const auto& hardforks = get_maintenance_hardforks();
    // TODO remove when we're sure it's always false
-   bool before_core_hardfork_184 = ( maint_time <= HARDFORK_CORE_184_TIME ); // something-for-nothing
+   bool before_core_hardfork_184 = hardforks.before_core_hardfork_184; // something-for-nothing
    // TODO remove when we're sure it's always false
-   bool before_core_hardfork_342 = ( maint_time <= HARDFORK_CORE_342_TIME ); // better rounding
+   bool before_core_hardfork_342 = hardforks.before_core_hardfork_342; // better rounding
    // TODO remove when we're sure it's always false
    if( before_core_hardfork_184 )
       ilog( "match(limit,call) is called before hardfork core-184 at block #${block}", ("block",head_block_num()) );
@@ -713,8 +730,8 @@ asset database::match( const call_order_object& call,
    FC_ASSERT(call.get_debt().asset_id == settle.balance.asset_id );
    FC_ASSERT(call.debt > 0 && call.collateral > 0 && settle.balance.amount > 0);
 
-   auto maint_time = get_dynamic_global_properties().next_maintenance_time;
-   bool before_core_hardfork_342 = ( maint_time <= HARDFORK_CORE_342_TIME ); // better rounding
+   const auto& hardforks = get_maintenance_hardforks();
+   bool before_core_hardfork_342 = hardforks.before_core_hardfork_342; // better rounding
 
    auto settle_for_sale = std::min(settle.balance, max_settlement);
    auto call_debt = call.get_debt();
@@ -727,7 +744,7 @@ asset database::match( const call_order_object& call,
    bool cull_settle_order = false; // whether need to cancel dust settle order
    if( call_pays.amount == 0 )
    {
-      if( maint_time > HARDFORK_CORE_184_TIME )
+      if( !hardforks.before_core_hardfork_184 )
       {
          if( call_receives == call_debt ) // the call order is smaller than or equal to the settle order
          {
@@ -888,10 +905,10 @@ bool database::fill_call_order( const call_order_object& order, const asset& pay
             }
             else
             {
-               auto maint_time = get_dynamic_global_properties().next_maintenance_time;
+               const auto& hardforks = get_maintenance_hardforks();
                // update call_price after core-343 hard fork,
                // but don't update call_price after core-1270 hard fork
-               if( maint_time <= HARDFORK_CORE_1270_TIME && maint_time > HARDFORK_CORE_343_TIME )
+               if( hardforks.before_core_hardfork_1270 && !hardforks.before_core_hardfork_343 )
                {
                   o.call_price = price::call_price( o.get_debt(), o.get_collateral(),
                                                     mia.bitasset_data(*this).current_feed.maintenance_collateral_ratio );
@@ -973,10 +990,10 @@ bool database::fill_settle_order( const force_settlement_object& settle, const a
 bool database::check_call_orders( const asset_object& mia, bool enable_black_swan, bool for_new_limit_order,
                                   const asset_bitasset_data_object* bitasset_ptr )
 { try {
-    const auto& dyn_prop = get_dynamic_global_properties();
-    auto maint_time = dyn_prop.next_maintenance_time;
+    market_fee_batch fee_batch( *this );
+    const auto& hardforks = get_maintenance_hardforks();
     if( for_new_limit_order )
-       FC_ASSERT( maint_time <= HARDFORK_CORE_625_TIME ); // `for_new_limit_order` is only true before HF 338 / 625
+       FC_ASSERT( hardforks.before_core_hardfork_625 ); // `for_new_limit_order` is only true before HF 338 / 625
 
     if( !mia.is_market_issued() ) return false;
 
@@ -988,46 +1005,44 @@ bool database::check_call_orders( const asset_object& mia, bool enable_black_swa
     if( bitasset.is_prediction_market ) return false;
     if( bitasset.current_feed.settlement_price.is_null() ) return false;
 
-    const limit_order_index& limit_index = get_index_type<limit_order_index>();
-    const auto& limit_price_index = limit_index.indices().get<by_price>();
+    bool before_core_hardfork_1270 = hardforks.before_core_hardfork_1270; // call price caching issue
 
-    bool before_core_hardfork_1270 = ( maint_time <= HARDFORK_CORE_1270_TIME ); // call price caching issue
+    const auto& call_book = get_call_order_books().get_book( mia.id, bitasset.options.short_backing_asset );
+    // Nothing to call if the least collateralized position is feed protected, which is the usual case
+    if( !before_core_hardfork_1270 && ( call_book.empty()
+          || bitasset.current_maintenance_collateralization < call_book.begin()->order->collateralization() ) )
+       return false;
 
     // looking for limit orders selling the most USD for the least CORE
-    auto max_price = price::max( mia.id, bitasset.options.short_backing_asset );
+    const auto& limit_book = get_limit_order_books().get_book( mia.id, bitasset.options.short_backing_asset );
     // stop when limit orders are selling too little USD for too much CORE
     auto min_price = ( before_core_hardfork_1270 ? bitasset.current_feed.max_short_squeeze_price_before_hf_1270()
                                                  : bitasset.current_feed.max_short_squeeze_price() );
 
-    // NOTE limit_price_index is sorted from greatest to least
-    auto limit_itr = limit_price_index.lower_bound( max_price );
-    auto limit_end = limit_price_index.upper_bound( min_price );
+    // NOTE the book is sorted from greatest to least
+    auto limit_itr = limit_book.begin();
+    auto limit_end = limit_book.upper_bound( price_sort_key( min_price ) );
 
     if( limit_itr == limit_end )
        return false;
 
     const call_order_index& call_index = get_index_type<call_order_index>();
     const auto& call_price_index = call_index.indices().get<by_price>();
-    const auto& call_collateral_index = call_index.indices().get<by_collateral>();
 
     auto call_min = price::min( bitasset.options.short_backing_asset, mia.id );
     auto call_max = price::max( bitasset.options.short_backing_asset, mia.id );
 
     auto call_price_itr = call_price_index.begin();
     auto call_price_end = call_price_itr;
-    auto call_collateral_itr = call_collateral_index.begin();
-    auto call_collateral_end = call_collateral_itr;
+    // after core-1270 hard fork, positions are called in the order of the by_collateral index, as kept in call_book
+    auto call_collateral_itr = call_book.begin();
+    auto call_collateral_end = call_book.end();
 
     if( before_core_hardfork_1270 )
     {
        call_price_itr = call_price_index.lower_bound( call_min );
        call_price_end = call_price_index.upper_bound( call_max );
     }
-    else
-    {
-       call_collateral_itr = call_collateral_index.lower_bound( call_min );
-       call_collateral_end = call_collateral_index.upper_bound( call_max );
-    }
 
     bool filled_limit = false;
     bool margin_called = false;
@@ -1038,12 +1053,12 @@ bool database::check_call_orders( const asset_object& mia, bool enable_black_swa
     bool before_hardfork_615 = ( head_time < HARDFORK_615_TIME );
     bool after_hardfork_436 = ( head_time > HARDFORK_436_TIME );
 
-    bool before_core_hardfork_184 = ( maint_time <= HARDFORK_CORE_184_TIME ); // something-for-nothing
-    bool before_core_hardfork_342 = ( maint_time <= HARDFORK_CORE_342_TIME ); // better rounding
-    bool before_core_hardfork_343 = ( maint_time <= HARDFORK_CORE_343_TIME ); // update call_price after partially filled
-    bool before_core_hardfork_453 = ( maint_time <= HARDFORK_CORE_453_TIME ); // multiple matching issue
-    bool before_core_hardfork_606 = ( maint_time <= HARDFORK_CORE_606_TIME ); // feed always trigger call
-    bool before_core_hardfork_834 = ( maint_time <= HARDFORK_CORE_834_TIME ); // target collateral ratio option
+    bool before_core_hardfork_184 = hardforks.before_core_hardfork_184; // something-for-nothing
+    bool before_core_hardfork_342 = hardforks.before_core_hardfork_342; // better rounding
+    bool before_core_hardfork_343 = hardforks.before_core_hardfork_343; // update call_price after partially filled
+    bool before_core_hardfork_453 = hardforks.before_core_hardfork_453; // multiple matching issue
+    bool before_core_hardfork_606 = hardforks.before_core_hardfork_606; // feed always trigger call
+    bool before_core_hardfork_834 = hardforks.before_core_hardfork_834; // target collateral ratio option
 
     while( !check_for_blackswan( mia, enable_black_swan, &bitasset ) // TODO perhaps improve performance by passing in iterators
            && limit_itr != limit_end
@@ -1052,7 +1067,7 @@ bool database::check_call_orders( const asset_object& mia, bool enable_black_swa
     {
        bool  filled_call      = false;
 
-       const call_order_object& call_order = ( before_core_hardfork_1270 ? *call_price_itr : *call_collateral_itr );
+       const call_order_object& call_order = ( before_core_hardfork_1270 ? *call_price_itr : *call_collateral_itr->order );
 
        // Feed protected (don't call if CR>MCR) https://github.com/cryptonomex/graphene/issues/436
        if( ( !before_core_hardfork_1270 && bitasset.current_maintenance_collateralization < call_order.collateralization() )
@@ -1060,7 +1075,7 @@ bool database::check_call_orders( const asset_object& mia, bool enable_black_swa
                    && after_hardfork_436 && bitasset.current_feed.settlement_price > ~call_order.call_price ) )
           return margin_called;
 
-       const limit_order_object& limit_order = *limit_itr;
+       const limit_order_object& limit_order = *limit_itr->order;
        price match_price  = limit_order.sell_price;
        // There was a check `match_price.validate();` here, which is removed now because it always passes
 
@@ -1145,7 +1160,7 @@ bool database::check_call_orders( const asset_object& mia, bool enable_black_swa
 
           if( usd_to_buy == usd_for_sale )
              filled_limit = true;
-          else if( filled_limit && maint_time <= HARDFORK_CORE_453_TIME ) // TODO remove warning after hard fork core-453
+          else if( filled_limit && before_core_hardfork_453 ) // TODO remove warning after hard fork core-453
           {
              wlog( "Multiple limit match problem (issue 453) occurred at block #${block}", ("block",head_num) );
              if( before_hardfork_615 )
@@ -1161,7 +1176,7 @@ bool database::check_call_orders( const asset_object& mia, bool enable_black_swa
        // when for_new_limit_order is true, the call order is maker, otherwise the call order is taker
        fill_call_order( call_order, call_pays, call_receives, match_price, for_new_limit_order );
        if( !before_core_hardfork_1270 )
-          call_collateral_itr = call_collateral_index.lower_bound( call_min );
+          call_collateral_itr = call_book.begin();
        else if( !before_core_hardfork_343 )
           call_price_itr = call_price_index.lower_bound( call_min );
 
@@ -1213,13 +1228,7 @@ asset database::pay_market_fees( const asset_object& recv_asset, const asset& re
 
    //Don't dirty undo state if not actually collecting any fees
    if( issuer_fees.amount > 0 )
-   {
-      const auto& recv_dyn_data = recv_asset.dynamic_asset_data_id(*this);
-      modify( recv_dyn_data, [&]( asset_dynamic_data_object& obj ){
-                   //idump((issuer_fees));
-         obj.accumulated_fees += issuer_fees.amount;
-      });
-   }
+      add_issuer_market_fee( recv_asset, issuer_fees.amount );
 
    return issuer_fees;
 }
@@ -1262,21 +1271,65 @@ asset database::pay_market_fees(const account_object& seller, const asset_object
                                  "Referrer reward shouldn't be greater than total reward" );
                      const asset referrer_reward = recv_asset.amount(referrer_rewards_value);
                      registrar_reward -= referrer_reward;
-                     deposit_market_fee_vesting_balance(seller.referrer, referrer_reward);
+                     add_market_fee_reward(seller.referrer, referrer_reward);
                   }
                }
-               deposit_market_fee_vesting_balance(seller.registrar, registrar_reward);
+               add_market_fee_reward(seller.registrar, registrar_reward);
             }
          }
       }
 
-      const auto& recv_dyn_data = recv_asset.dynamic_asset_data_id(*this);
-      modify( recv_dyn_data, [&issuer_fees, &reward]( asset_dynamic_data_object& obj ){
-         obj.accumulated_fees += issuer_fees.amount - reward.amount;
-      });
+      add_issuer_market_fee( recv_asset, issuer_fees.amount - reward.amount );
    }
 
    return issuer_fees;
 }
 
+void database::add_issuer_market_fee( const asset_object& recv_asset, share_type amount )
+{
+   if( _market_fee_batch_depth > 0 )
+   {
+      _batched_issuer_fees[recv_asset.dynamic_asset_data_id] += amount;
+      return;
+   }
+   modify( recv_asset.dynamic_asset_data_id(*this), [amount]( asset_dynamic_data_object& obj ){
+      obj.accumulated_fees += amount;
+   });
+}
+
+void database::add_market_fee_reward( account_id_type account, const asset& reward )
+{
+   if( _market_fee_batch_depth == 0 )
+   {
+      deposit_market_fee_vesting_balance( account, reward );
+      return;
+   }
+   // Only a handful of registrars and referrers take part in one batch
+   for( auto& pending : _batched_fee_rewards )
+   {
+      if( pending.first == account && pending.second.asset_id == reward.asset_id )
+      {
+         pending.second += reward;
+         return;
+      }
+   }
+   _batched_fee_rewards.emplace_back( account, reward );
+}
+
+void database::flush_market_fees()
+{
+   // Take the pending fees first, the modifications below must not add to them
+   auto issuer_fees = std::move( _batched_issuer_fees );
+   auto rewards = std::move( _batched_fee_rewards );
+   _batched_issuer_fees.clear();
+   _batched_fee_rewards.clear();
+
+   for( const auto& reward : rewards )
+      deposit_market_fee_vesting_balance( reward.first, reward.second );
+   for( const auto& fee : issuer_fees )
+      modify( fee.first(*this), [&fee]( asset_dynamic_data_object& obj ){
+         obj.accumulated_fees += fee.second;
+      });
+}
+
 } }
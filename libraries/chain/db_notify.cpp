@@ -18,6 +18,8 @@
 #include <graphene/chain/transaction_history_object.hpp>
 #include <graphene/chain/impacted.hpp>
 
+#include <algorithm>
+
 using namespace fc;
 using namespace graphene::chain;
 
@@ -295,6 +297,157 @@ void graphene::chain::transaction_get_impacted_accounts( const transaction& tx,
     operation_get_impacted_accounts( op, result );
 }
 
+namespace {
+
+/**
+ * Only operations that are common and whose effects follow from their fields are described precisely,
+ * all others are unknown. Operations that refer to existing objects like orders or vesting balances are
+ * unknown as well, because what they touch depends on these objects.
+ */
+struct get_footprint_visitor
+{
+   operation_footprint& _result;
+   get_footprint_visitor( operation_footprint& result ) : _result( result ) {}
+   typedef void result_type;
+
+   template<typename Op>
+   void operator()( const Op& )
+   {
+      _result.unknown = true;
+   }
+
+   void fee( account_id_type payer, const asset& fee )
+   {
+      _result.accounts.insert( payer );
+      _result.balances.emplace( payer, fee.asset_id );
+      _result.assets_read.insert( fee.asset_id );
+      if( fee.asset_id != asset_id_type() ) // the fee is converted through the fee pool of the asset
+         _result.assets_written.insert( fee.asset_id );
+   }
+   void balance( account_id_type owner, asset_id_type asset )
+   {
+      _result.accounts.insert( owner );
+      _result.balances.emplace( owner, asset );
+      _result.assets_read.insert( asset );
+   }
+
+   void operator()( const transfer_operation& op )
+   {
+      fee( op.from, op.fee );
+      balance( op.from, op.amount.asset_id );
+      balance( op.to, op.amount.asset_id );
+   }
+   void operator()( const override_transfer_operation& op )
+   {
+      fee( op.issuer, op.fee );
+      balance( op.from, op.amount.asset_id );
+      balance( op.to, op.amount.asset_id );
+   }
+   void operator()( const limit_order_create_operation& op )
+   {
+      fee( op.seller, op.fee );
+      balance( op.seller, op.amount_to_sell.asset_id );
+      balance( op.seller, op.min_to_receive.asset_id );
+      // market fees, and margin calls of market pegged assets
+      _result.assets_written.insert( op.amount_to_sell.asset_id );
+      _result.assets_written.insert( op.min_to_receive.asset_id );
+      _result.markets.insert( std::minmax( op.amount_to_sell.asset_id, op.min_to_receive.asset_id ) );
+      _result.any_account = true;
+   }
+   void operator()( const asset_issue_operation& op )
+   {
+      fee( op.issuer, op.fee );
+      balance( op.issue_to_account, op.asset_to_issue.asset_id );
+      _result.assets_written.insert( op.asset_to_issue.asset_id );
+   }
+   void operator()( const asset_reserve_operation& op )
+   {
+      fee( op.payer, op.fee );
+      balance( op.payer, op.amount_to_reserve.asset_id );
+      _result.assets_written.insert( op.amount_to_reserve.asset_id );
+   }
+   void operator()( const asset_fund_fee_pool_operation& op )
+   {
+      fee( op.from_account, op.fee );
+      balance( op.from_account, asset_id_type() );
+      _result.assets_written.insert( op.asset_id );
+   }
+   void operator()( const account_whitelist_operation& op )
+   {
+      fee( op.authorizing_account, op.fee );
+      _result.accounts.insert( op.account_to_list );
+   }
+   void operator()( const account_upgrade_operation& op )
+   {
+      fee( op.account_to_upgrade, op.fee );
+   }
+   void operator()( const account_update_operation& op )
+   {
+      fee( op.account, op.fee );
+      // votes refer to witnesses, committee members and workers
+      if( op.new_options.valid() )
+         _result.unknown = true;
+   }
+   void operator()( const vesting_balance_create_operation& op )
+   {
+      fee( op.creator, op.fee );
+      balance( op.creator, op.amount.asset_id );
+      _result.accounts.insert( op.owner );
+   }
+   void operator()( const htlc_create_operation& op )
+   {
+      fee( op.from, op.fee );
+      balance( op.from, op.amount.asset_id );
+      _result.accounts.insert( op.to );
+   }
+};
+
+template<typename T>
+bool intersects( const flat_set<T>& a, const flat_set<T>& b )
+{
+   auto i = a.begin();
+   auto j = b.begin();
+   while( i != a.end() && j != b.end() )
+   {
+      if( *i < *j )
+         ++i;
+      else if( *j < *i )
+         ++j;
+      else
+         return true;
+   }
+   return false;
+}
+
+} // anonymous namespace
+
+bool graphene::chain::operation_footprint::conflicts_with( const operation_footprint& other )const
+{
+   if( unknown || other.unknown )
+      return true;
+   // every balance belongs to one of the accounts, so this covers them as well
+   if( ( any_account && !other.accounts.empty() ) || ( other.any_account && !accounts.empty() ) )
+      return true;
+   return intersects( accounts, other.accounts )
+       || intersects( balances, other.balances )
+       || intersects( markets, other.markets )
+       || intersects( assets_written, other.assets_written )
+       || intersects( assets_written, other.assets_read )
+       || intersects( assets_read, other.assets_written );
+}
+
+void graphene::chain::operation_get_footprint( const operation& op, operation_footprint& result )
+{
+   get_footprint_visitor vtor( result );
+   op.visit( vtor );
+}
+
+void graphene::chain::transaction_get_footprint( const transaction& tx, operation_footprint& result )
+{
+   for( const auto& op : tx.operations )
+      operation_get_footprint( op, result );
+}
+
 void get_relevant_accounts( const object* obj, flat_set<account_id_type>& accounts )
 {
    if( obj->id.space() == protocol_ids )
@@ -455,60 +608,94 @@ void database::notify_on_pending_transaction( const signed_transaction& tx )
 
 void database::notify_changed_objects()
 { try {
-   if( _undo_db.enabled() ) 
-   {
-      const auto& head_undo = _undo_db.head();
+   if( !_undo_db.enabled() )
+      return;
 
-      // New
-      if( !new_objects.empty() )
-      {
-        vector<object_id_type> new_ids;  new_ids.reserve(head_undo.new_ids.size());
-        flat_set<account_id_type> new_accounts_impacted;
-        for( const auto& item : head_undo.new_ids )
-        {
-          new_ids.push_back(item);
-          auto obj = find_object(item);
-          if(obj != nullptr)
-            get_relevant_accounts(obj, new_accounts_impacted);
-        }
+   const auto& head_undo = _undo_db.head();
 
-        if( new_ids.size() )
-           GRAPHENE_TRY_NOTIFY( new_objects, new_ids, new_accounts_impacted)
-      }
+   // The handlers read the state of this block and may reject it, so the signals are emitted here. Only the
+   // impacted accounts are computed in other threads, this one blocks meanwhile so that the state cannot change.
+   vector<object_id_type> new_ids;
+   flat_set<account_id_type> new_accounts_impacted;
+   vector<object_id_type> changed_ids;
+   flat_set<account_id_type> changed_accounts_impacted;
+   vector<object_id_type> removed_ids;
+   vector<const object*> removed;
+   flat_set<account_id_type> removed_accounts_impacted;
+   std::vector<std::future<void>> workers;
 
-      // Changed
-      if( !changed_objects.empty() )
-      {
-        vector<object_id_type> changed_ids;  changed_ids.reserve(head_undo.old_values.size());
-        flat_set<account_id_type> changed_accounts_impacted;
-        for( const auto& item : head_undo.old_values )
-        {
-          changed_ids.push_back(item.first);
-          get_relevant_accounts(item.second.get(), changed_accounts_impacted);
-        }
+   // New
+   if( !new_objects.empty() )
+   {
+      new_ids.reserve( head_undo.new_ids.size() );
+      for( const auto& item : head_undo.new_ids )
+         new_ids.push_back( item );
+      workers.push_back( run_in_background_blocking( [this,&new_ids,&new_accounts_impacted] () {
+         for( const auto& id : new_ids )
+         {
+            auto obj = find_object( id );
+            if( obj != nullptr )
+               get_relevant_accounts( obj, new_accounts_impacted );
+         }
+      }, "accounts impacted by new objects" ) );
+   }
 
-        if( changed_ids.size() )
-           GRAPHENE_TRY_NOTIFY( changed_objects, changed_ids, changed_accounts_impacted)
-      }
+   // Changed
+   if( !changed_objects.empty() )
+   {
+      changed_ids.reserve( head_undo.old_values.size() );
+      for( const auto& item : head_undo.old_values )
+         changed_ids.push_back( item.first );
+      workers.push_back( run_in_background_blocking( [this,&head_undo,&changed_accounts_impacted] () {
+         for( const auto& item : head_undo.old_values )
+         {
+            auto obj = find_object( item.first );
+            if( obj == nullptr )
+            {
+               get_relevant_accounts( item.second.get(), changed_accounts_impacted );
+               continue;
+            }
+            get_relevant_accounts( obj, changed_accounts_impacted );
+            // the accounts of the old value too, e.g. the ones removed from an authority; the old value may be a
+            // partial undo snapshot, so a copy of it is restored onto a copy of the current value
+            std::unique_ptr<object> old_value = obj->clone();
+            std::unique_ptr<object> snapshot = item.second->clone();
+            old_value->restore_undo_snapshot( *snapshot );
+            get_relevant_accounts( old_value.get(), changed_accounts_impacted );
+         }
+      }, "accounts impacted by changed objects" ) );
+   }
 
-      // Removed
-      if( !removed_objects.empty() )
+   // Removed
+   if( !removed_objects.empty() )
+   {
+      removed_ids.reserve( head_undo.removed.size() );
+      removed.reserve( head_undo.removed.size() );
+      for( const auto& item : head_undo.removed )
       {
-        vector<object_id_type> removed_ids; removed_ids.reserve( head_undo.removed.size() );
-        vector<const object*> removed; removed.reserve( head_undo.removed.size() );
-        flat_set<account_id_type> removed_accounts_impacted;
-        for( const auto& item : head_undo.removed )
-        {
-          removed_ids.emplace_back( item.first );
-          auto obj = item.second.get();
-          removed.emplace_back( obj );
-          get_relevant_accounts(obj, removed_accounts_impacted);
-        }
-
-        if( removed_ids.size() )
-           GRAPHENE_TRY_NOTIFY( removed_objects, removed_ids, removed, removed_accounts_impacted)
+         removed_ids.emplace_back( item.first );
+         removed.emplace_back( item.second.get() );
       }
+      workers.push_back( run_in_background_blocking( [&removed,&removed_accounts_impacted] () {
+         for( const auto obj : removed )
+            get_relevant_accounts( obj, removed_accounts_impacted );
+      }, "accounts impacted by removed objects" ) );
    }
+
+   // all workers refer to the locals, so none may still run when an exception leaves this scope
+   for( auto& worker : workers )
+      worker.wait();
+   for( auto& worker : workers )
+      worker.get();
+
+   if( !new_ids.empty() )
+      GRAPHENE_TRY_NOTIFY( new_objects, new_ids, new_accounts_impacted )
+
+   if( !changed_ids.empty() )
+      GRAPHENE_TRY_NOTIFY( changed_objects, changed_ids, changed_accounts_impacted )
+
+   if( !removed_ids.empty() )
+      GRAPHENE_TRY_NOTIFY( removed_objects, removed_ids, removed, removed_accounts_impacted )
 } FC_CAPTURE_AND_LOG( (0) ) }
 
 } }
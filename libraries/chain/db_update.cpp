@@ -74,10 +74,30 @@ void database::update_global_dynamic_data( const signed_block& b, const uint32_t
                  "Please add a checkpoint if you would like to continue applying blocks beyond this point.",
                  ("last_irreversible_block_num",_dgp.last_irreversible_block_num)("head", _dgp.head_block_number)
                  ("recently_missed",_dgp.recently_missed_count)("max_undo",GRAPHENE_MAX_UNDO_HISTORY) );
+
+      const size_t max_undo_bytes = _undo_db.max_bytes();
+      if( max_undo_bytes > 0 )
+      {
+         const size_t undo_bytes = _undo_db.bytes();
+         GRAPHENE_ASSERT( undo_bytes <= max_undo_bytes, undo_database_exception,
+                    "The undo history since the last irreversible block uses more memory than allowed. "
+                    "Please add a checkpoint or raise the limit if you would like to continue applying blocks.",
+                    ("last_irreversible_block_num",_dgp.last_irreversible_block_num)("head", _dgp.head_block_number)
+                    ("undo_bytes",undo_bytes)("max_undo_bytes",max_undo_bytes) );
+         const bool near_limit = ( undo_bytes > max_undo_bytes / 4 * 3 );
+         if( near_limit && !_undo_history_near_limit )
+            wlog( "The undo history uses ${b} of ${m} bytes, ${n} blocks since the last irreversible block",
+                  ("b",undo_bytes)("m",max_undo_bytes)
+                  ("n",_dgp.head_block_number - _dgp.last_irreversible_block_num) );
+         _undo_history_near_limit = near_limit;
+      }
    }
 
-   _undo_db.set_max_size( _dgp.head_block_number - _dgp.last_irreversible_block_num + 1 );
-   _fork_db.set_max_size( _dgp.head_block_number - _dgp.last_irreversible_block_num + 1 );
+   uint32_t keep_from = _dgp.last_irreversible_block_num;
+   if( _debug_fork_point.valid() )
+      keep_from = std::min( keep_from, *_debug_fork_point );
+   _undo_db.set_max_size( _dgp.head_block_number - keep_from + 1 );
+   _fork_db.set_max_size( _dgp.head_block_number - keep_from + 1 );
 }
 
 void database::update_signing_witness(const witness_object& signing_witness, const signed_block& new_block)
@@ -136,6 +156,9 @@ void database::update_last_irreversible_block()
       {
          _dpo.last_irreversible_block_num = new_last_irreversible_block_num;
       } );
+
+      if( _block_log_retain_blocks > 0 && new_last_irreversible_block_num > _block_log_retain_blocks )
+         _block_id_to_block.remove_blocks_before( new_last_irreversible_block_num - _block_log_retain_blocks + 1 );
    }
 }
 
@@ -145,15 +168,18 @@ void database::clear_expired_transactions()
    //Transactions must have expired by at least two forking windows in order to be removed.
    auto& transaction_idx = static_cast<transaction_index&>(get_mutable_index(implementation_ids,
                                                                              impl_transaction_history_object_type));
-   const auto& dedupe_index = transaction_idx.indices().get<by_expiration>();
-   while( (!dedupe_index.empty()) && (head_block_time() > dedupe_index.begin()->trx.expiration) )
-      transaction_idx.remove(*dedupe_index.begin());
+   while( const transaction_history_object* expired = _p_recent_trx_idx->find_expired( head_block_time() ) )
+      transaction_idx.remove(*expired);
 } FC_CAPTURE_AND_RETHROW() }
 
 void database::clear_expired_proposals()
 {
+   // Like the other clear_expired_* functions this only looks at the front of an index sorted by expiration, so a
+   // block in which nothing expires costs a single comparison. The order of this index decides the order in which
+   // proposals are executed, so it must not be replaced by a structure that could order them differently.
+   const fc::time_point_sec head_time = head_block_time();
    const auto& proposal_expiration_index = get_index_type<proposal_index>().indices().get<by_expiration>();
-   while( !proposal_expiration_index.empty() && proposal_expiration_index.begin()->expiration_time <= head_block_time() )
+   while( !proposal_expiration_index.empty() && proposal_expiration_index.begin()->expiration_time <= head_time )
    {
       const proposal_object& proposal = *proposal_expiration_index.begin();
       processed_transaction result;
@@ -196,8 +222,8 @@ bool database::check_for_blackswan( const asset_object& mia, bool enable_black_s
     asset_id_type debt_asset_id = mia.id;
     auto call_min = price::min( bitasset.options.short_backing_asset, debt_asset_id );
 
-    auto maint_time = get_dynamic_global_properties().next_maintenance_time;
-    bool before_core_hardfork_1270 = ( maint_time <= HARDFORK_CORE_1270_TIME ); // call price caching issue
+    const auto& hardforks = get_maintenance_hardforks();
+    bool before_core_hardfork_1270 = hardforks.before_core_hardfork_1270; // call price caching issue
 
     if( before_core_hardfork_1270 ) // before core-1270 hard fork, check with call_price
     {
@@ -209,39 +235,27 @@ bool database::check_for_blackswan( const asset_object& mia, bool enable_black_s
     }
     else // after core-1270 hard fork, check with collateralization
     {
-       const auto& call_collateral_index = get_index_type<call_order_index>().indices().get<by_collateral>();
-       auto call_itr = call_collateral_index.lower_bound( call_min );
-       if( call_itr == call_collateral_index.end() ) // no call order
+       const auto& call_book = get_call_order_books().get_book( debt_asset_id, bitasset.options.short_backing_asset );
+       if( call_book.empty() ) // no call order
           return false;
-       call_ptr = &(*call_itr);
+       call_ptr = call_book.begin()->order;
     }
     if( call_ptr->debt_type() != debt_asset_id ) // no call order
        return false;
 
     price highest = settle_price;
-    if( maint_time > HARDFORK_CORE_1270_TIME )
+    if( !before_core_hardfork_1270 )
        // due to #338, we won't check for black swan on incoming limit order, so need to check with MSSP here
        highest = bitasset.current_feed.max_short_squeeze_price();
-    else if( maint_time > HARDFORK_CORE_338_TIME )
+    else if( !hardforks.before_core_hardfork_338 )
        // due to #338, we won't check for black swan on incoming limit order, so need to check with MSSP here
        highest = bitasset.current_feed.max_short_squeeze_price_before_hf_1270();
 
-    const limit_order_index& limit_index = get_index_type<limit_order_index>();
-    const auto& limit_price_index = limit_index.indices().get<by_price>();
-
-    // looking for limit orders selling the most USD for the least CORE
-    auto highest_possible_bid = price::max( mia.id, bitasset.options.short_backing_asset );
-    // stop when limit orders are selling too little USD for too much CORE
-    auto lowest_possible_bid  = price::min( mia.id, bitasset.options.short_backing_asset );
-
-    FC_ASSERT( highest_possible_bid.base.asset_id == lowest_possible_bid.base.asset_id );
-    // NOTE limit_price_index is sorted from greatest to least
-    auto limit_itr = limit_price_index.lower_bound( highest_possible_bid );
-    auto limit_end = limit_price_index.upper_bound( lowest_possible_bid );
-
-    if( limit_itr != limit_end ) {
-       FC_ASSERT( highest.base.asset_id == limit_itr->sell_price.base.asset_id );
-       highest = std::max( limit_itr->sell_price, highest );
+    // looking for the limit order selling the most USD for the least CORE, the book is sorted from greatest to least
+    const auto& limit_book = get_limit_order_books().get_book( mia.id, bitasset.options.short_backing_asset );
+    if( !limit_book.empty() ) {
+       FC_ASSERT( highest.base.asset_id == limit_book.begin()->order->sell_price.base.asset_id );
+       highest = std::max( limit_book.begin()->order->sell_price, highest );
     }
 
     auto least_collateral = call_ptr->collateralization();
@@ -260,7 +274,7 @@ bool database::check_for_blackswan( const asset_object& mia, bool enable_black_s
             ("h",highest.to_real())("~h",(~highest).to_real()) );
        edump((enable_black_swan));
        FC_ASSERT( enable_black_swan, "Black swan was detected during a margin update which is not allowed to trigger a blackswan" );
-       if( maint_time > HARDFORK_CORE_338_TIME && ~least_collateral <= settle_price )
+       if( !hardforks.before_core_hardfork_338 && ~least_collateral <= settle_price )
           // global settle at feed price if possible
           globally_settle_asset(mia, settle_price );
        else
@@ -274,11 +288,11 @@ void database::clear_expired_orders()
 { try {
          //Cancel expired limit orders
          auto head_time = head_block_time();
-         auto maint_time = get_dynamic_global_properties().next_maintenance_time;
+         const auto& hardforks = get_maintenance_hardforks();
 
-         bool before_core_hardfork_184 = ( maint_time <= HARDFORK_CORE_184_TIME ); // something-for-nothing
-         bool before_core_hardfork_342 = ( maint_time <= HARDFORK_CORE_342_TIME ); // better rounding
-         bool before_core_hardfork_606 = ( maint_time <= HARDFORK_CORE_606_TIME ); // feed always trigger call
+         bool before_core_hardfork_184 = hardforks.before_core_hardfork_184; // something-for-nothing
+         bool before_core_hardfork_342 = hardforks.before_core_hardfork_342; // better rounding
+         bool before_core_hardfork_606 = hardforks.before_core_hardfork_606; // feed always trigger call
 
          auto& limit_index = get_index_type<limit_order_index>().indices().get<by_expiration>();
          while( !limit_index.empty() && limit_index.begin()->expiration <= head_time )
@@ -289,6 +303,8 @@ void database::clear_expired_orders()
             cancel_limit_order( order );
             if( before_core_hardfork_606 )
             {
+               // Note: these checks are part of consensus, they must run after every single cancellation and
+               //       cannot be merged for orders that expire together
                // check call orders
                // Comments below are copied from limit_order_cancel_evaluator::do_apply(...)
                // Possible optimization: order can be called by cancelling a limit order
@@ -331,6 +347,23 @@ void database::clear_expired_orders()
 
       uint32_t count = 0;
 
+      // The asset, its bitasset data and short positions are looked up once for all the due settle orders
+      // of an asset. The settled volume is tracked here and written back when moving on to another asset.
+      const asset_object* mia_object_ptr = nullptr;
+      const asset_bitasset_data_object* mia_ptr = nullptr;
+      const call_order_book_index::book_type* call_book_ptr = nullptr;
+      asset settled;
+      auto write_settled_volume = [this, &mia_ptr, &settled] {
+         if( mia_ptr != nullptr && mia_ptr->force_settled_volume != settled.amount )
+         {
+            modify(*mia_ptr, [&settled](asset_bitasset_data_object& b) {
+               b.force_settled_volume = settled.amount;
+            });
+         }
+      };
+      // Fees of the fills are written once for all settlements, @see database::market_fee_batch
+      market_fee_batch fee_batch( *this );
+
       // At each iteration, we either consume the current order and remove it, or we move to the next asset
       for( auto itr = settlement_index.lower_bound(current_asset);
            itr != settlement_index.end();
@@ -340,8 +373,16 @@ void database::clear_expired_orders()
          const force_settlement_object& order = *itr;
          auto order_id = order.id;
          current_asset = order.settlement_asset_id();
-         const asset_object& mia_object = get(current_asset);
-         const asset_bitasset_data_object& mia = mia_object.bitasset_data(*this);
+         if( mia_object_ptr == nullptr || mia_object_ptr->id != current_asset )
+         {
+            write_settled_volume();
+            mia_object_ptr = &get(current_asset);
+            mia_ptr = &mia_object_ptr->bitasset_data(*this);
+            call_book_ptr = &get_call_order_books().get_book( current_asset, mia_ptr->options.short_backing_asset );
+            settled = mia_object_ptr->amount(mia_ptr->force_settled_volume);
+         }
+         const asset_object& mia_object = *mia_object_ptr;
+         const asset_bitasset_data_object& mia = *mia_ptr;
 
          extra_dump = ((count >= 1000) && (count <= 1020));
 
@@ -390,12 +431,12 @@ void database::clear_expired_orders()
             max_settlement_volume = mia_object.amount(mia.max_force_settlement_volume(mia_object.dynamic_data(*this).current_supply));
          // When current_asset_finished is true, this would be the 2nd time processing the same order.
          // In this case, we move to the next asset.
-         if( mia.force_settled_volume >= max_settlement_volume.amount || current_asset_finished )
+         if( settled.amount >= max_settlement_volume.amount || current_asset_finished )
          {
             /*
             ilog("Skipping force settlement in ${asset}; settled ${settled_volume} / ${max_volume}",
                  ("asset", mia_object.symbol)("settlement_price_null",mia.current_feed.settlement_price.is_null())
-                 ("settled_volume", mia.force_settled_volume)("max_volume", max_settlement_volume));
+                 ("settled_volume", settled.amount)("max_volume", max_settlement_volume));
                  */
             if( next_asset() )
             {
@@ -426,15 +467,13 @@ void database::clear_expired_orders()
          else if( settlement_price.base.asset_id != current_asset ) // only calculate once per asset
             settlement_price = settlement_fill_price;
 
-         auto& call_index = get_index_type<call_order_index>().indices().get<by_collateral>();
-         asset settled = mia_object.amount(mia.force_settled_volume);
+         const auto& call_book = *call_book_ptr;
          // Match against the least collateralized short until the settlement is finished or we reach max settlements
          while( settled < max_settlement_volume && find_object(order_id) )
          {
-            auto itr = call_index.lower_bound(boost::make_tuple(price::min(mia_object.bitasset_data(*this).options.short_backing_asset,
-                                                                           mia_object.get_id())));
             // There should always be a call order, since asset exists!
-            assert(itr != call_index.end() && itr->debt_type() == mia_object.get_id());
+            assert( !call_book.empty() );
+            const call_order_object& call_order = *call_book.begin()->order;
             asset max_settlement = max_settlement_volume - settled;
 
             if( order.balance.amount == 0 )
@@ -444,7 +483,7 @@ void database::clear_expired_orders()
                break;
             }
             try {
-               asset new_settled = match(*itr, order, settlement_price, max_settlement, settlement_fill_price);
+               asset new_settled = match(call_order, order, settlement_price, max_settlement, settlement_fill_price);
                if( !before_core_hardfork_184 && new_settled.amount == 0 ) // unable to fill this settle order
                {
                   if( find_object( order_id ) ) // the settle order hasn't been cancelled
@@ -470,13 +509,8 @@ void database::clear_expired_orders()
                break;
             }
          }
-         if( mia.force_settled_volume != settled.amount )
-         {
-            modify(mia, [settled](asset_bitasset_data_object& b) {
-               b.force_settled_volume = settled.amount;
-            });
-         }
       }
+      write_settled_volume();
    }
 } FC_CAPTURE_AND_RETHROW() }
 
@@ -578,16 +612,19 @@ void database::update_maintenance_flag( bool new_maintenance_flag )
 
 void database::update_withdraw_permissions()
 {
+   // Only the front of the expiration index is looked at, @see clear_expired_proposals
+   const fc::time_point_sec head_time = head_block_time();
    auto& permit_index = get_index_type<withdraw_permission_index>().indices().get<by_expiration>();
-   while( !permit_index.empty() && permit_index.begin()->expiration <= head_block_time() )
+   while( !permit_index.empty() && permit_index.begin()->expiration <= head_time )
       remove(*permit_index.begin());
 }
 
 void database::clear_expired_htlcs()
 {
+   const fc::time_point_sec head_time = head_block_time();
    const auto& htlc_idx = get_index_type<htlc_index>().indices().get<by_expiration>();
    while ( htlc_idx.begin() != htlc_idx.end()
-         && htlc_idx.begin()->conditions.time_lock.expiration <= head_block_time() )
+         && htlc_idx.begin()->conditions.time_lock.expiration <= head_time )
    {
       const htlc_object& obj = *htlc_idx.begin();
       adjust_balance( obj.transfer.from, asset(obj.transfer.amount, obj.transfer.asset_id) );
@@ -79,19 +79,42 @@ uint32_t database::get_slot_at_time(fc::time_point_sec when)const
    return (when - first_slot_time).to_seconds() / block_interval() + 1;
 }
 
+vector<std::pair<fc::time_point_sec, witness_id_type>> database::get_upcoming_slots( uint32_t count )const
+{
+   const dynamic_global_property_object& dpo = get_dynamic_global_properties();
+   const auto& witnesses = get_witness_schedule_object().current_shuffled_witnesses;
+   vector<std::pair<fc::time_point_sec, witness_id_type>> result;
+   if( witnesses.empty() )
+      return result;
+
+   const uint32_t blocks_left_in_round = witnesses.size() - head_block_num() % witnesses.size();
+   count = std::min( count, blocks_left_in_round );
+   result.reserve( count );
+
+   // slots after the first one follow one block interval apart
+   const auto interval = block_interval();
+   fc::time_point_sec slot_time = get_slot_time( 1 );
+   for( uint32_t slot = 1; slot <= count; ++slot, slot_time += interval )
+      result.emplace_back( slot_time, witnesses[ ( dpo.current_aslot + slot ) % witnesses.size() ] );
+   return result;
+}
+
 uint32_t database::update_witness_missed_blocks( const signed_block& b )
 {
    uint32_t missed_blocks = get_slot_at_time( b.timestamp );
    FC_ASSERT( missed_blocks != 0, "Trying to push double-produced block onto current block?!" );
    missed_blocks--;
-   const auto& witnesses = witness_schedule_id_type()(*this).current_shuffled_witnesses;
+   const auto& witnesses = get_witness_schedule_object().current_shuffled_witnesses;
    if( missed_blocks < witnesses.size() )
+   {
+      const uint64_t current_aslot = get_dynamic_global_properties().current_aslot;
       for( uint32_t i = 0; i < missed_blocks; ++i ) {
-         const auto& witness_missed = get_scheduled_witness( i+1 )(*this);
+         const auto& witness_missed = witnesses[ ( current_aslot + i + 1 ) % witnesses.size() ](*this);
          modify( witness_missed, []( witness_object& w ) {
             w.total_missed++;
          });
       }
+   }
    return missed_blocks;
 }
 
@@ -25,6 +25,22 @@
 #include <graphene/chain/exceptions.hpp>
 
 namespace graphene { namespace chain {
+
+namespace {
+   inline uint32_t invert_lowest_one( uint32_t n ) { return n & (n - 1); }
+
+   /**
+    * The block number a fork_item with block number num keeps its skip pointer at. Odd and even
+    * numbers jump back different distances so that any ancestor is reachable in O(log n) steps.
+    */
+   inline uint32_t skip_num( uint32_t num )
+   {
+      if( num < 2 )
+         return 0;
+      return ( num & 1 ) ? invert_lowest_one( invert_lowest_one( num - 1 ) ) + 1 : invert_lowest_one( num );
+   }
+}
+
 fork_database::fork_database()
 {
 }
@@ -44,7 +60,7 @@ void fork_database::pop_block()
 
 void     fork_database::start_block(signed_block b)
 {
-   auto item = std::make_shared<fork_item>(std::move(b));
+   auto item = std::make_shared<fork_item>( std::make_shared<const signed_block>( std::move(b) ) );
    _index.insert(item);
    _head = item;
 }
@@ -53,7 +69,7 @@ void     fork_database::start_block(signed_block b)
  * Pushes the block into the fork database
  *
  */
-shared_ptr<fork_item>  fork_database::push_block(const signed_block& b)
+shared_ptr<fork_item>  fork_database::push_block(const shared_ptr<const signed_block>& b)
 {
    auto item = std::make_shared<fork_item>(b);
    try {
@@ -61,13 +77,18 @@ shared_ptr<fork_item>  fork_database::push_block(const signed_block& b)
    }
    catch ( const unlinkable_block_exception& e )
    {
-      wlog( "Pushing block to fork database that failed to link: ${id}, ${num}", ("id",b.id())("num",b.block_num()) );
-      wlog( "Head: ${num}, ${id}", ("num",_head->data.block_num())("id",_head->data.id()) );
+      wlog( "Pushing block to fork database that failed to link: ${id}, ${num}", ("id",item->id)("num",item->num) );
+      wlog( "Head: ${num}, ${id}", ("num",_head->num)("id",_head->id) );
       throw;
    }
    return _head;
 }
 
+shared_ptr<fork_item>  fork_database::push_block(const signed_block& b)
+{
+   return push_block( std::make_shared<const signed_block>( b ) );
+}
+
 void  fork_database::_push_block(const item_ptr& item)
 {
    if( _head ) // make sure the block is within the range that we are caching
@@ -83,6 +104,7 @@ void  fork_database::_push_block(const item_ptr& item)
       auto itr = index.find(item->previous_id());
       GRAPHENE_ASSERT(itr != index.end(), unlinkable_block_exception, "block does not link to known chain");
       item->prev = *itr;
+      item->skip = fetch_ancestor( *itr, skip_num( item->num ) );
    }
 
    _index.insert(item);
@@ -159,36 +181,66 @@ pair<fork_database::branch_type,fork_database::branch_type>
    FC_ASSERT(second_branch_itr != _index.get<block_id>().end());
    auto second_branch = *second_branch_itr;
 
-
-   while( first_branch->data.block_num() > second_branch->data.block_num() )
-   {
-      result.first.push_back(first_branch);
-      first_branch = first_branch->prev.lock();
-      FC_ASSERT(first_branch);
-   }
-   while( second_branch->data.block_num() > first_branch->data.block_num() )
-   {
-      result.second.push_back( second_branch );
-      second_branch = second_branch->prev.lock();
-      FC_ASSERT(second_branch);
-   }
-   while( first_branch->data.previous != second_branch->data.previous )
+   // Find the highest pair of blocks at equal height which link to the same prior block. Both
+   // sides move in lockstep, so they reach the same skip heights; a skip is only taken while the
+   // blocks it leads to still differ, which keeps it from jumping past the fork point.
+   uint32_t height = std::min( first_branch->num, second_branch->num );
+   auto first_ancestor = fetch_ancestor( first_branch, height );
+   auto second_ancestor = fetch_ancestor( second_branch, height );
+   FC_ASSERT( first_ancestor && second_ancestor );
+   while( first_ancestor->previous_id() != second_ancestor->previous_id() )
    {
-      result.first.push_back(first_branch);
-      result.second.push_back(second_branch);
-      first_branch = first_branch->prev.lock();
-      FC_ASSERT(first_branch);
-      second_branch = second_branch->prev.lock();
-      FC_ASSERT(second_branch);
-   }
-   if( first_branch && second_branch )
-   {
-      result.first.push_back(first_branch);
-      result.second.push_back(second_branch);
+      auto first_skip = first_ancestor->skip.lock();
+      auto second_skip = second_ancestor->skip.lock();
+      if( first_skip && second_skip && first_skip != second_skip )
+      {
+         first_ancestor = first_skip;
+         second_ancestor = second_skip;
+      }
+      else
+      {
+         first_ancestor = first_ancestor->prev.lock();
+         second_ancestor = second_ancestor->prev.lock();
+         FC_ASSERT( first_ancestor && second_ancestor );
+      }
    }
+
+   const uint32_t stop_num = first_ancestor->num;
+   auto fill_branch = [stop_num]( item_ptr item, branch_type& branch ) {
+      branch.reserve( item->num - stop_num + 1 );
+      branch.push_back( item );
+      while( item->num > stop_num )
+      {
+         item = item->prev.lock();
+         FC_ASSERT( item );
+         branch.push_back( item );
+      }
+   };
+   fill_branch( first_branch, result.first );
+   fill_branch( second_branch, result.second );
    return result;
 } FC_CAPTURE_AND_RETHROW( (first)(second) ) }
 
+item_ptr fork_database::fetch_ancestor( item_ptr item, uint32_t num )const
+{
+   if( !item || num > item->num )
+      return item_ptr();
+   while( item && item->num > num )
+   {
+      // Take the skip pointer unless it overshoots num, or stepping back once would reach a
+      // skip pointer that lands closer to num
+      const uint32_t skip = skip_num( item->num );
+      const uint32_t prev_skip = skip_num( item->num - 1 );
+      item_ptr next;
+      if( skip == num || ( skip > num && !( skip >= 2 && prev_skip < skip - 2 && prev_skip >= num ) ) )
+         next = item->skip.lock();
+      if( !next )
+         next = item->prev.lock();
+      item = next;
+   }
+   return item;
+}
+
 void fork_database::set_head(shared_ptr<fork_item> h)
 {
    _head = h;
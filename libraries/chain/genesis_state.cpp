@@ -25,7 +25,12 @@
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/protocol/fee_schedule.hpp>
 
+#include <fc/asio.hpp>
+#include <fc/io/json.hpp>
 #include <fc/io/raw.hpp>
+#include <fc/thread/parallel.hpp>
+
+#include <algorithm>
 
 namespace graphene { namespace chain {
 
@@ -34,6 +39,62 @@ chain_id_type genesis_state_type::compute_chain_id() const
    return initial_chain_id;
 }
 
+namespace {
+   /// Lists shorter than this are converted in the calling thread
+   const size_t min_parallel_genesis_list = 1000;
+
+   template<typename T>
+   void convert_genesis_list( const fc::variant_object& genesis, const char* name, vector<T>& result,
+                              uint32_t max_depth )
+   {
+      auto itr = genesis.find( name );
+      if( itr == genesis.end() )
+         return;
+      const fc::variants& list = itr->value().get_array();
+      result.resize( list.size() );
+      if( list.size() < min_parallel_genesis_list )
+      {
+         for( size_t i = 0; i < list.size(); ++i )
+            fc::from_variant( list[i], result[i], max_depth );
+         return;
+      }
+
+      const size_t chunks = std::max<size_t>( 1, fc::asio::default_io_service_scope::get_num_threads() );
+      const size_t chunk_size = ( list.size() + chunks - 1 ) / chunks;
+      std::vector<fc::future<void>> workers;
+      workers.reserve( chunks );
+      for( size_t base = 0; base < list.size(); base += chunk_size )
+         workers.push_back( fc::do_parallel( [&list,&result,base,chunk_size,max_depth] () {
+            const size_t end = std::min( list.size(), base + chunk_size );
+            for( size_t i = base; i < end; ++i )
+               fc::from_variant( list[i], result[i], max_depth );
+         }) );
+      for( auto& worker : workers )
+         worker.wait();
+   }
+}
+
+genesis_state_type load_genesis_state( const string& json, uint32_t max_depth )
+{ try {
+   FC_ASSERT( max_depth > 2, "Nesting depth of the genesis state is too small" );
+   const fc::variant parsed = fc::json::from_string( json );
+   const fc::variant_object& genesis = parsed.get_object();
+
+   // Everything but the long lists is converted as usual, those are added to the result afterwards
+   static const std::set<string> lists = { "initial_accounts", "initial_balances", "initial_vesting_balances" };
+   fc::mutable_variant_object rest;
+   for( const auto& entry : genesis )
+      if( lists.find( entry.key() ) == lists.end() )
+         rest.set( entry.key(), entry.value() );
+   genesis_state_type result = fc::variant( fc::variant_object( std::move(rest) ) ).as<genesis_state_type>( max_depth );
+
+   // The vectors are one level below the genesis state, their elements two levels
+   convert_genesis_list( genesis, "initial_accounts", result.initial_accounts, max_depth - 2 );
+   convert_genesis_list( genesis, "initial_balances", result.initial_balances, max_depth - 2 );
+   convert_genesis_list( genesis, "initial_vesting_balances", result.initial_vesting_balances, max_depth - 2 );
+   return result;
+} FC_CAPTURE_AND_RETHROW() }
+
 } } // graphene::chain
 
 FC_REFLECT_DERIVED_NO_TYPENAME(graphene::chain::genesis_state_type::initial_account_type, BOOST_PP_SEQ_NIL,
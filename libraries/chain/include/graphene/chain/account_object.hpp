@@ -28,11 +28,15 @@
 #include <graphene/protocol/account.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+
+#include <unordered_map>
 
 namespace graphene { namespace chain {
    class database;
    class account_object;
    class vesting_balance_object;
+   class authorized_asset_cache;
 
    /**
     * @class account_statistics_object
@@ -51,8 +55,6 @@ namespace graphene { namespace chain {
 
          account_id_type  owner;
 
-         string           name; ///< redundantly store account name here for better maintenance performance
-
          /**
           * Keep the most recent operation as a root pointer to a linked list of the transaction history.
           */
@@ -116,6 +118,17 @@ namespace graphene { namespace chain {
           * Core fees are paid into the account_statistics_object by this method
           */
          void pay_fee( share_type core_fee, share_type cashback_vesting_threshold );
+
+         /// Declared after the counters above, which are modified by most operations, to keep those together
+         string           name; ///< redundantly store account name here for better maintenance performance
+
+         /// Undo snapshots leave out name, which never changes after creation.
+         /// Any newly added member that can be modified must be handled in these methods.
+         ///@{
+         virtual unique_ptr<object> undo_snapshot()const override;
+         virtual void               copy_undo_snapshot_from( const object& obj ) override;
+         virtual void               restore_undo_snapshot( object& snapshot ) override;
+         ///@}
    };
 
    /**
@@ -297,23 +310,29 @@ namespace graphene { namespace chain {
     *  @brief This secondary index will allow a reverse lookup of all accounts that a particular key or account
     *  is an potential signing authority.
     */
-   class account_member_index : public secondary_index
+   class account_member_index : public batched_secondary_index
    {
       public:
-         virtual void object_inserted( const object& obj ) override;
-         virtual void object_removed( const object& obj ) override;
-         virtual void about_to_modify( const object& before ) override;
-         virtual void object_modified( const object& after  ) override;
-
+         explicit account_member_index( const graphene::db::index* primary ) : batched_secondary_index( primary ) {}
 
          /** given an account or key, map it to the set of accounts that reference it in an active or owner authority */
          map< account_id_type, set<account_id_type> >                    account_to_account_memberships;
-         map< public_key_type, set<account_id_type>, pubkey_comparator > account_to_key_memberships;
+         /** keys are looked up far more often than ordered, and nearly all of them belong to a single account */
+         std::unordered_map< public_key_type, flat_set<account_id_type>, pubkey_hasher > account_to_key_memberships;
          /** some accounts use address authorities in the genesis block */
          map< address, set<account_id_type> >                            account_to_address_memberships;
 
+         virtual size_t memory_usage()const override;
 
       protected:
+         virtual void apply_change( const object* before, const object* after ) override;
+         virtual void clear() override;
+
+         void insert_members( const account_object& a );
+         void remove_members( const account_object& a );
+         void update_members( const account_object& before, const account_object& after );
+         void remove_key_member( const public_key_type& key, account_id_type account );
+
          set<account_id_type>                    get_account_members( const account_object& a )const;
          set<public_key_type, pubkey_comparator> get_key_members( const account_object& a )const;
          set<address>                            get_address_members( const account_object& a )const;
@@ -340,6 +359,45 @@ namespace graphene { namespace chain {
          map< account_id_type, set<account_id_type> > referred_by;
    };
 
+   /**
+    *  @brief Clears an authority_check_cache whenever the owner or active authority of an account changes,
+    *  including when the change is undone.
+    */
+   class account_authority_index : public secondary_index
+   {
+      public:
+         explicit account_authority_index( authority_check_cache* cache ) : _cache( *cache ) {}
+
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+
+      private:
+         authority_check_cache& _cache;
+         authority              _owner_before;
+         authority              _active_before;
+   };
+
+   /**
+    *  @brief Clears an authorized_asset_cache whenever the allowed assets, the whitelisting accounts or the
+    *  blacklisting accounts of an account change, including when the change is undone.
+    */
+   class account_whitelist_index : public secondary_index
+   {
+      public:
+         explicit account_whitelist_index( authorized_asset_cache* cache ) : _cache( *cache ) {}
+
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+
+      private:
+         authorized_asset_cache&           _cache;
+         optional< flat_set<asset_id_type> > _allowed_assets_before;
+         flat_set<account_id_type>         _whitelisting_before;
+         flat_set<account_id_type>         _blacklisting_before;
+   };
+
    /**
     *  @brief This secondary index will allow fast access to the balance objects
     *         that belonging to an account.
@@ -352,15 +410,21 @@ namespace graphene { namespace chain {
          virtual void about_to_modify( const object& before ) override;
          virtual void object_modified( const object& after  ) override;
 
-         const map< asset_id_type, const account_balance_object* >& get_account_balances( const account_id_type& acct )const;
+         /// The balance objects of an account by asset, kept in a sorted vector since most accounts hold few assets
+         typedef flat_map< asset_id_type, const account_balance_object* > account_balances_type;
+
+         /// @note adding a balance object of the account invalidates the iterators of the returned container
+         const account_balances_type& get_account_balances( const account_id_type& acct )const;
          const account_balance_object* get_account_balance( const account_id_type& acct, const asset_id_type& asset )const;
 
+         virtual size_t memory_usage()const override;
+
       private:
          static const uint8_t  bits;
          static const uint64_t mask;
 
          /** Maps each account to its balance objects */
-         vector< vector< map< asset_id_type, const account_balance_object* > > > balances;
+         vector< vector< account_balances_type > > balances;
          std::stack< object_id_type > ids_being_modified;
    };
 
@@ -397,15 +461,19 @@ namespace graphene { namespace chain {
    typedef generic_index<account_balance_object, account_balance_object_multi_index_type> account_balance_index;
 
    struct by_name;
+   struct by_exact_name;
 
    /**
     * @ingroup object_index
+    *
+    * by_exact_name hashes the names for exact lookups, by_name is ordered for listing and prefix searches
     */
    typedef multi_index_container<
       account_object,
       indexed_by<
          ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
-         ordered_unique< tag<by_name>, member<account_object, string, &account_object::name> >
+         ordered_unique< tag<by_name>, member<account_object, string, &account_object::name> >,
+         hashed_unique< tag<by_exact_name>, member<account_object, string, &account_object::name> >
       >
    > account_multi_index_type;
 
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/operation_history_object.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/optional.hpp>
+
+#include <fstream>
+#include <mutex>
+
+namespace graphene { namespace chain {
+
+   /**
+    *  Stores the operations applied in each block, virtual operations and operation results included, so that
+    *  they are available without applying the blocks again.
+    *
+    *  The file "operations" holds the packed vector of operation_history_object of each block, the file "index"
+    *  maps a block number to the position of its operations and the ID of the block they were applied in. The
+    *  operations of a block that is applied again on another fork replace those stored before, and the entries
+    *  of higher blocks are dropped. Operations the chain removed while applying the block, e.g. of a failed
+    *  proposal, are not stored.
+    *
+    *  Lookups may be done concurrently with each other and with storing. The files are flushed every
+    *  blocks_per_flush blocks, open() drops the entries at the end whose operations were not written.
+    */
+   class applied_operation_log
+   {
+      public:
+         static const uint32_t blocks_per_flush = 100;
+
+         applied_operation_log();
+         ~applied_operation_log();
+
+         void open( const fc::path& dir );
+         bool is_open()const;
+         void flush();
+         void close();
+
+         void store( const block_id_type& id, const vector<optional<operation_history_object>>& ops );
+
+         /** @return the operations applied in the block with the given number, null if they are not stored */
+         optional<vector<operation_history_object>> fetch( uint32_t block_num )const;
+         /** @return the packed vector of operations as stored, without unpacking it */
+         optional<vector<char>> fetch_packed( uint32_t block_num )const;
+         /** @return the ID of the block the stored operations of block_num were applied in */
+         optional<block_id_type> fetch_block_id( uint32_t block_num )const;
+         /** @return the number of the last block stored, 0 if none */
+         uint32_t last_block_num()const;
+
+      private:
+         struct log_index_entry;
+         bool read_index_entry( uint32_t block_num, log_index_entry& e )const;
+
+         fc::path             _operations_filename;
+         fc::path             _index_filename;
+         mutable std::fstream _operations;
+         mutable std::fstream _index;
+         uint32_t             _last_block_num = 0;
+         uint32_t             _unflushed_blocks = 0;
+         mutable std::mutex   _mutex;
+   };
+
+} } // graphene::chain
@@ -27,6 +27,7 @@
 #include <graphene/protocol/asset_ops.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
 
 /**
  * @defgroup prediction_market Prediction Market
@@ -40,6 +41,7 @@
 
 namespace graphene { namespace chain {
    class asset_bitasset_data_object;
+   class authorized_asset_cache;
    class database;
    using namespace graphene::db;
 
@@ -294,8 +296,10 @@ namespace graphene { namespace chain {
    typedef generic_index<asset_bitasset_data_object, asset_bitasset_data_object_multi_index_type> asset_bitasset_data_index;
 
    struct by_symbol;
+   struct by_exact_symbol;
    struct by_type;
    struct by_issuer;
+   /// by_exact_symbol hashes the symbols for exact lookups, by_symbol is ordered for listing and prefix searches
    typedef multi_index_container<
       asset_object,
       indexed_by<
@@ -312,11 +316,31 @@ namespace graphene { namespace chain {
                 member< asset_object, account_id_type, &asset_object::issuer >,
                 member< object, object_id_type, &object::id >
             >
-         >
+         >,
+         hashed_unique< tag<by_exact_symbol>, member<asset_object, string, &asset_object::symbol> >
       >
    > asset_object_multi_index_type;
    typedef generic_index<asset_object, asset_object_multi_index_type> asset_index;
 
+   /**
+    *  @brief Clears an authorized_asset_cache whenever the whitelist or the blacklist authorities of an asset
+    *  change, including when the change is undone.
+    */
+   class asset_whitelist_index : public secondary_index
+   {
+      public:
+         explicit asset_whitelist_index( authorized_asset_cache* cache ) : _cache( *cache ) {}
+
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+
+      private:
+         authorized_asset_cache&   _cache;
+         flat_set<account_id_type> _whitelist_authorities_before;
+         flat_set<account_id_type> _blacklist_authorities_before;
+   };
+
 } } // graphene::chain
 
 MAP_OBJECT_ID_TO_TYPE(graphene::chain::asset_object)
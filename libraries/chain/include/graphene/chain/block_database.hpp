@@ -22,19 +22,41 @@
  * THE SOFTWARE.
  */
 #pragma once
+#include <atomic>
 #include <fstream>
+#include <memory>
 #include <graphene/protocol/block.hpp>
 
 #include <fc/filesystem.hpp>
+#include <fc/interprocess/file_mapping.hpp>
 
 namespace graphene { namespace chain {
    struct index_entry;
    using namespace graphene::protocol;
 
+   /**
+    *  Stores blocks in segments of consecutive block numbers. Each segment consists of a file with the
+    *  serialized blocks and an index file that maps block numbers to positions in it. Segment 0 uses the
+    *  files "blocks" and "index", segment N the files "blocks.N" and "index.N". Databases created before
+    *  segments were introduced consist of a single segment containing all blocks.
+    *
+    *  Old segments are never written to again. While the node is stopped they can be compressed or moved to
+    *  an archive; blocks of missing segments are simply reported as not found.
+    *
+    *  Lookups read the files through read-only mappings instead of the streams used for writing. They
+    *  don't seek and can be served concurrently, e.g. to several peers and API clients at once.
+    */
    class block_database 
    {
       public:
-         void open( const fc::path& dbdir );
+         /** number of blocks per segment of newly created databases */
+         static const uint32_t default_blocks_per_segment = 1000000;
+
+         block_database();
+         ~block_database();
+
+         /** @param new_blocks_per_segment segment size used if the database does not exist yet */
+         void open( const fc::path& dbdir, uint32_t new_blocks_per_segment = default_blocks_per_segment );
          bool is_open()const;
          void flush();
          void close();
@@ -44,16 +66,66 @@ namespace graphene { namespace chain {
 
          bool                   contains( const block_id_type& id )const;
          block_id_type          fetch_block_id( uint32_t block_num )const;
+         /** @return the ids of count consecutive blocks starting at first_block_num, read with one mapping per segment */
+         vector<block_id_type>  fetch_block_ids( uint32_t first_block_num, uint32_t count )const;
          optional<signed_block> fetch_optional( const block_id_type& id )const;
          optional<signed_block> fetch_by_number( uint32_t block_num )const;
+         /**
+          *  @return the header of the block, unpacked from the start of the stored block without reading its
+          *  transactions
+          */
+         optional<block_header> fetch_header( uint32_t block_num )const;
+         /** @return the serialized block as stored, without unpacking it */
+         optional<vector<char>> fetch_packed( uint32_t block_num )const;
+         /** @return the serialized block as stored, if the block with the given number has the given ID */
+         optional<vector<char>> fetch_packed( const block_id_type& id )const;
          optional<signed_block> last()const;
          optional<block_id_type> last_id()const;
          size_t                 blocks_current_position()const;
          size_t                 total_block_size()const;
+
+         /** @return the number of blocks per segment, or 0 if all blocks are stored in a single segment */
+         uint32_t               blocks_per_segment()const { return _blocks_per_segment; }
+
+         /**
+          *  Deletes the files of all segments that contain only blocks older than block_num. Blocks in the
+          *  segment containing block_num are kept, pruning is not possible if all blocks are in one segment.
+          */
+         void                   remove_blocks_before( uint32_t block_num );
+         /**
+          *  @return number of the oldest stored block, 0 if there are no blocks. A database that was started
+          *  from a snapshot has no blocks before the head block of the snapshot.
+          */
+         uint32_t               first_available_block_num()const;
       private:
+         struct segment;
+
          optional<index_entry> last_index_entry()const;
-         fc::path _index_filename;
-         mutable std::fstream _blocks;
-         mutable std::fstream _block_num_to_pos;
+         uint32_t segment_number( uint32_t block_num )const;
+         fc::path segment_file( const std::string& name, uint32_t segment_num )const;
+         /** @return the segment containing block_num, or nullptr if it does not exist */
+         std::shared_ptr<segment> find_segment( uint32_t block_num )const;
+         /** @return the segment containing block_num, its files are created if necessary */
+         std::shared_ptr<segment> get_or_create_segment( uint32_t block_num );
+         /** @return false if the index contains no entry for block_num */
+         bool read_index_entry( const segment& seg, uint32_t block_num, index_entry& e )const;
+         /** @return false if the block referenced by e was removed or is not stored completely */
+         bool read_packed( const segment& seg, const index_entry& e, vector<char>& data )const;
+         /** @return the block referenced by e, or an empty optional if it was removed or is not stored completely */
+         optional<signed_block> read_block( const segment& seg, const index_entry& e )const;
+
+         fc::path _dbdir;
+         uint32_t _blocks_per_segment = 0;
+         /**
+          *  One entry per possible segment, nullptr for segments that don't exist. The vector is not resized
+          *  while the database is open, its entries are accessed with std::atomic_load and std::atomic_store.
+          */
+         vector< std::shared_ptr<segment> > _segments;
+
+         /** segment and end of the block read most recently, @see blocks_current_position */
+         mutable std::atomic<uint32_t> _read_segment{0};
+         mutable std::atomic<uint64_t> _read_pos{0};
+         /** result of first_available_block_num, 0 if it has to be looked up again */
+         mutable std::atomic<uint32_t> _first_available{0};
    };
 } }
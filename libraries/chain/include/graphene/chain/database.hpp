@@ -31,8 +31,12 @@
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/fork_database.hpp>
 #include <graphene/chain/block_database.hpp>
+#include <graphene/chain/applied_operation_log.hpp>
+#include <graphene/chain/signature_cache.hpp>
+#include <graphene/chain/pending_transaction_pool.hpp>
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/chain/evaluator.hpp>
+#include <graphene/chain/is_authorized_asset.hpp>
 
 #include <graphene/db/object_database.hpp>
 #include <graphene/db/object.hpp>
@@ -41,7 +45,10 @@
 
 #include <fc/log/logger.hpp>
 
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <mutex>
 
 namespace graphene { namespace chain {
    using graphene::db::abstract_object;
@@ -57,10 +64,109 @@ namespace graphene { namespace chain {
    class limit_order_object;
    class collateral_bid_object;
    class call_order_object;
+   class recent_transaction_index;
+   class limit_order_book_index;
+   class call_order_book_index;
 
    struct budget_record;
    enum class vesting_balance_type;
 
+   /** Describes the chain state written by database::save_snapshot */
+   struct snapshot_info
+   {
+      std::string   db_version; ///< version of the database format the index files were written with
+      chain_id_type chain_id;
+      signed_block  head_block; ///< the last block applied to the saved state
+   };
+
+   /**
+    * Which of the hardforks that activate at a maintenance interval are not in effect yet, derived from
+    * dynamic_global_property_object::next_maintenance_time, @see database::get_maintenance_hardforks
+    */
+   struct maintenance_hardforks
+   {
+      time_point_sec next_maintenance_time; ///< the flags below were computed for
+      bool before_core_hardfork_184  = true; ///< something-for-nothing
+      bool before_core_hardfork_338  = true; ///< black swan check with MSSP
+      bool before_core_hardfork_342  = true; ///< better rounding
+      bool before_core_hardfork_343  = true; ///< update call_price after partially filled
+      bool before_core_hardfork_453  = true; ///< multiple matching issue
+      bool before_core_hardfork_606  = true; ///< feed always trigger call
+      bool before_core_hardfork_625  = true; ///< margin calls are not checked for new limit orders
+      bool before_core_hardfork_834  = true; ///< target collateral ratio option
+      bool before_core_hardfork_1270 = true; ///< call price caching issue
+
+      /// Recomputes the flags for the given next maintenance time
+      void update( time_point_sec maint_time );
+   };
+
+   /** Wall clock time spent in the phases of one chain maintenance, @see database::get_maintenance_timings */
+   struct maintenance_timing
+   {
+      uint32_t       block_num = 0; ///< of the block that triggered the maintenance
+      time_point_sec timestamp;     ///< of the block that triggered the maintenance
+      int64_t        total_us = 0;
+      /// Name and duration in microseconds of each phase, in the order they ran
+      vector< std::pair< std::string, int64_t > > phases;
+   };
+
+   /** Wall clock time spent in the stages of a replay in nanoseconds, @see database::enable_replay_profile */
+   struct replay_profile
+   {
+      /// Evaluations of one operation type, including the operations of the proposals they execute
+      struct operation_stats
+      {
+         std::string name;
+         uint64_t    count = 0;
+         int64_t     total_ns = 0;
+         int64_t     average_ns = 0;
+      };
+
+      uint32_t blocks = 0;
+      uint64_t transactions = 0;
+      int64_t  total_ns = 0;           ///< of the whole replay, including the rebuild of secondary indexes
+      int64_t  read_ns = 0;            ///< reading and unpacking blocks, summed over the worker threads
+      int64_t  precompute_ns = 0;      ///< precomputing blocks, summed over the worker threads
+      int64_t  wait_ns = 0;            ///< waiting for blocks that were not precomputed yet
+      int64_t  header_ns = 0;          ///< block size, merkle root and header checks
+      int64_t  transactions_ns = 0;    ///< applying transactions, including the evaluation of their operations
+      int64_t  maintenance_ns = 0;
+      int64_t  block_end_ns = 0;       ///< per block updates of expirations, feeds, witnesses and batched indexes
+      int64_t  plugins_ns = 0;         ///< applied_block and changed objects handlers, applied operation log
+      int64_t  undo_ns = 0;            ///< undo sessions, fork database and block storage of blocks near the head
+      int64_t  rebuild_indexes_ns = 0; ///< rebuilding batched secondary indexes after the last block
+      /// Indexed by the tag of the operation type
+      vector< operation_stats > operations;
+
+      /// @return the time spent in the stages of applying blocks
+      int64_t apply_ns()const
+      {
+         return header_ns + transactions_ns + maintenance_ns + block_end_ns + plugins_ns;
+      }
+   };
+
+   /**
+    * Wall clock time spent in the stages of applying the last block in nanoseconds, @see database::get_block_timing.
+    * The stages add up to apply_ns, push_ns additionally covers the undo session, the fork database and the
+    * block storage.
+    */
+   struct block_timing
+   {
+      uint32_t block_num = 0;
+      uint32_t transactions = 0;
+      int64_t  header_ns = 0;          ///< block size, merkle root and header checks
+      int64_t  transactions_ns = 0;
+      int64_t  block_updates_ns = 0;   ///< witness, global properties, irreversibility and witness schedule
+      int64_t  maintenance_ns = 0;
+      int64_t  expiry_ns = 0;          ///< removing expired transactions, proposals, orders and HTLCs, updating feeds
+      int64_t  batched_indexes_ns = 0; ///< @see object_database::apply_batched_index_changes
+      int64_t  applied_block_ns = 0;   ///< applied_block handlers of the plugins and the APIs, applied operation log
+      int64_t  changed_objects_ns = 0; ///< new, changed and removed objects handlers
+      int64_t  apply_ns = 0;
+      /// The whole push_block call that applied the block, 0 if the block was applied while switching forks
+      int64_t  push_ns = 0;
+   };
+
    /**
     *   @class database
     *   @brief tracks the blockchain state in an extensible manner
@@ -122,6 +228,29 @@ namespace graphene { namespace chain {
          void wipe(const fc::path& data_dir, bool include_blocks);
          void close(bool rewind = true);
 
+         /**
+          * @brief Write the current object state and its head block to the snapshot directory dir
+          *
+          * The state of plugins is included as far as they keep it in their own indexes of this database.
+          * The file describing the snapshot is written last, so an interrupted snapshot is never loaded.
+          * @param dir must not exist yet
+          * @param db_version version of the database format, @see open
+          */
+         void save_snapshot( const fc::path& dir, const std::string& db_version )const;
+
+         /**
+          * @brief Replace the database in data_dir with a snapshot written by @ref save_snapshot
+          *
+          * Must be called before @ref open, which then continues from the state of the snapshot. All blocks in
+          * data_dir are deleted, afterwards the block database contains only the head block of the snapshot.
+          * The description of the snapshot is kept in data_dir, so that @ref open accepts the state at the head
+          * block of the snapshot also if the block database does not contain that block.
+          * @param chain_id the snapshot is rejected before touching data_dir if it belongs to a different chain
+          * @return the description of the loaded snapshot
+          */
+         snapshot_info load_snapshot( const fc::path& snapshot_dir, const fc::path& data_dir,
+                                      const std::string& db_version, const chain_id_type& chain_id );
+
          //////////////////// db_block.cpp ////////////////////
 
          /**
@@ -131,8 +260,23 @@ namespace graphene { namespace chain {
          bool                       is_known_block( const block_id_type& id )const;
          bool                       is_known_transaction( const transaction_id_type& id )const;
          block_id_type              get_block_id_for_num( uint32_t block_num )const;
+         /**
+          *  Like is_known_block and fetch_packed_block_by_id, but only look at the block database, which unlike
+          *  the fork database can be read from other threads while blocks are being applied.
+          */
+         bool                       is_stored_block( const block_id_type& id )const;
+         optional<vector<char>>     fetch_stored_packed_block( const block_id_type& id )const;
+         /** @return the ids of count consecutive blocks of the current chain, starting at first_block_num */
+         vector<block_id_type>      get_block_ids_for_nums( uint32_t first_block_num, uint32_t count )const;
          optional<signed_block>     fetch_block_by_id( const block_id_type& id )const;
          optional<signed_block>     fetch_block_by_number( uint32_t num )const;
+         /** @return the header of the block, without reading the rest of the block from the block database */
+         optional<block_header>     fetch_block_header_by_number( uint32_t num )const;
+         /** @return the serialized block, read as stored from the block database unless it is in the fork database */
+         optional<vector<char>>     fetch_packed_block_by_number( uint32_t num )const;
+         optional<vector<char>>     fetch_packed_block_by_id( const block_id_type& id )const;
+         /** @return number of the oldest block that may still be fetched, older ones have been pruned */
+         uint32_t                   first_available_block_num()const;
          const signed_transaction&  get_recent_transaction( const transaction_id_type& trx_id )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
@@ -145,10 +289,25 @@ namespace graphene { namespace chain {
          void                              add_checkpoints( const flat_map<uint32_t,block_id_type>& checkpts );
          const flat_map<uint32_t,block_id_type> get_checkpoints()const { return _checkpoints; }
          bool before_last_checkpoint()const;
+         /**
+          * @return the skip flags for a block at or below the last checkpoint, whose id vouches for it through the
+          *         chain of previous block ids, or skip_nothing for other blocks. Only the merkle check is kept,
+          *         it binds the transactions to the header the block id is computed from.
+          */
+         uint32_t checkpoint_skip_flags( uint32_t block_num )const;
 
          bool push_block( const signed_block& b, uint32_t skip = skip_nothing );
+         /// Same as above, the fork database keeps a reference to the block instead of a copy
+         bool push_block( const std::shared_ptr<const signed_block>& b, uint32_t skip = skip_nothing );
          processed_transaction push_transaction( const precomputable_transaction& trx, uint32_t skip = skip_nothing );
-         bool _push_block( const signed_block& b );
+         /**
+          *  Rejects trx if it fails the checks of push_transaction that need no signature recovery or evaluation:
+          *  expiration, TaPoS and duplicates.  Lets transactions received from the network be turned away
+          *  before their signatures are recovered.
+          *  @throws fc::exception if trx fails one of the checks
+          */
+         void precheck_transaction( const precomputable_transaction& trx )const;
+         bool _push_block( const std::shared_ptr<const signed_block>& b );
          processed_transaction _push_transaction( const precomputable_transaction& trx );
 
          ///@throws fc::exception if the proposed transaction fails to apply.
@@ -169,6 +328,83 @@ namespace graphene { namespace chain {
          void pop_block();
          void clear_pending();
 
+         /**
+          *  A shared mutex that prefers writers: once a writer waits, no new reader gets the lock, so a steady
+          *  stream of readers cannot hold off the thread applying blocks. Readers block their thread. A writer
+          *  waits for the readers by sleeping its fiber, the other fibers of the applying thread go on meanwhile.
+          */
+         class state_mutex
+         {
+            public:
+               void lock();
+               void unlock();
+               void lock_shared();
+               bool try_lock_shared();
+               void unlock_shared();
+            private:
+               std::mutex              _mutex;
+               std::condition_variable _readers_may_enter;
+               uint32_t                _readers = 0;
+               uint32_t                _waiting_writers = 0;
+               bool                    _writing = false;
+         };
+
+         ///@{
+         /**
+          *  The chain state may be read from threads other than the one applying blocks while holding read_lock().
+          *  Everything that modifies the state from outside a block, i.e. push_block, push_transaction,
+          *  generate_block, pop_block, clear_pending, validate_transaction, open, close, reindex and the debug
+          *  updates, holds the exclusive side through a write_scope as long as it modifies the state. The
+          *  outermost scope of nested calls takes the lock. Code that runs in the applying thread needs no lock
+          *  to read.
+          */
+         std::shared_lock<state_mutex> read_lock()const;
+         /// The same as read_lock, but waits by sleeping the fiber, so that the other tasks of the thread go on
+         std::shared_lock<state_mutex> yielding_read_lock()const;
+         class write_scope
+         {
+            public:
+               explicit write_scope( database& db );
+               ~write_scope();
+            private:
+               database& _db;
+         };
+
+         /**
+          *  Holds the shared side of the lock in the applying thread, for code there that has to see one state
+          *  across calls which yield, e.g. an API batch. The other fibers go on meanwhile, but no block is
+          *  applied. The scope is active while its fiber runs: a write_scope is refused then, and a fiber that
+          *  yields inside the scope suspends it around the yield with a suspend_read_scope.
+          */
+         class read_scope
+         {
+            public:
+               explicit read_scope( database& db );
+               ~read_scope();
+            private:
+               database&                     _db;
+               std::shared_lock<state_mutex> _lock;
+         };
+         class suspend_read_scope
+         {
+            public:
+               explicit suspend_read_scope( database& db );
+               ~suspend_read_scope();
+            private:
+               database&         _db;
+               const read_scope* _suspended;
+         };
+         /// @return whether a read_scope is active in the applying thread
+         bool in_read_scope()const { return _active_read_scope != nullptr; }
+         ///@}
+
+         /**
+          *  Looks up an object as of the head block, i.e. without the changes made by pending transactions.
+          *  @param holder receives a copy of the object if pending transactions have changed it
+          *  @return the object, or nullptr if it did not exist at the head block
+          */
+         const object* find_object_at_head_block( object_id_type id, unique_ptr<object>& holder )const;
+
          /**
           *  This method is used to track appied operations during the evaluation of a block, these
           *  operations should include any operation actually included in a transaction as well
@@ -181,6 +417,14 @@ namespace graphene { namespace chain {
          uint32_t  push_applied_operation( const operation& op );
          void      set_applied_operation_result( uint32_t op_id, const operation_result& r );
          const vector<optional< operation_history_object > >& get_applied_operations()const;
+         /**
+          *  @return the operations applied in the block with the given number of the current chain, read from
+          *  the applied operation log, null if the log is disabled or does not have them
+          *  @see enable_applied_operation_log
+          */
+         optional< vector< operation_history_object > > fetch_applied_operations( uint32_t block_num )const;
+         /** @return the packed operations applied in the block, as stored in the applied operation log */
+         optional< vector<char> > fetch_packed_applied_operations( uint32_t block_num )const;
 
          string to_pretty_string( const asset& a )const;
 
@@ -217,6 +461,7 @@ namespace graphene { namespace chain {
           */
          fc::signal<void(const vector<object_id_type>&, const vector<const object*>&, const flat_set<account_id_type>&)>  removed_objects;
 
+
          //////////////////// db_witness_schedule.cpp ////////////////////
 
          /**
@@ -255,6 +500,14 @@ namespace graphene { namespace chain {
           */
          uint32_t get_slot_at_time(fc::time_point_sec when)const;
 
+         /**
+          * Get the time and the scheduled witness of the next slots, starting with slot 1.
+          *
+          * The witnesses are shuffled again when the current round ends, so at most as many
+          * slots are returned as there are blocks left in the round.
+          */
+         vector<std::pair<fc::time_point_sec, witness_id_type>> get_upcoming_slots(uint32_t count)const;
+
          void update_witness_schedule();
 
          //////////////////// db_getter.cpp ////////////////////
@@ -269,6 +522,34 @@ namespace graphene { namespace chain {
          const fee_schedule&                    current_fee_schedule()const;
          const account_statistics_object&       get_account_stats_by_owner( account_id_type owner )const;
          const witness_schedule_object&         get_witness_schedule_object()const;
+         /// The limit orders of each market, @see limit_order_book_index
+         const limit_order_book_index&          get_limit_order_books()const { return *_p_limit_order_book_idx; }
+         /// The margin positions of each market, @see call_order_book_index
+         const call_order_book_index&           get_call_order_books()const { return *_p_call_order_book_idx; }
+         /// Successful authority checks of transactions and proposals, cleared by account_authority_index
+         authority_check_cache&                 get_authority_check_cache() { return _authority_check_cache; }
+         /// Results of is_authorized_asset, kept consistent with the accounts and assets by secondary indexes
+         authorized_asset_cache&                get_authorized_asset_cache()const { return _authorized_asset_cache; }
+         /**
+          * The maintenance hardforks in effect, recomputed only when next_maintenance_time has moved since
+          * the last call, so that the order matching code does not compare the same times for every order
+          */
+         const maintenance_hardforks&           get_maintenance_hardforks()const;
+         /// Depth and approximate memory use of the undo history, @see set_undo_history_max_bytes
+         graphene::db::undo_history_usage       get_undo_history_usage()const { return _undo_db.get_usage(); }
+         /// Phase timings of the most recent chain maintenances, oldest first
+         const std::deque<maintenance_timing>&  get_maintenance_timings()const { return _maintenance_timings; }
+         /// The profile of the last replay, or null if there was none since enable_replay_profile was set
+         const replay_profile*                  get_replay_profile()const { return _replay_profile.get(); }
+         /// Stage timings of the last block applied, including blocks that failed to apply
+         const block_timing&                    get_block_timing()const { return _block_timing; }
+
+         /// Whether the node is built with GRAPHENE_EVALUATOR_PROFILING, @see get_evaluator_statistics
+         static bool                            evaluator_profiling_enabled();
+         /// The evaluators of the operation types evaluated since the start or the last reset, empty if
+         /// evaluator_profiling_enabled() is false
+         vector<evaluator_statistics>           get_evaluator_statistics()const;
+         void                                   reset_evaluator_statistics();
 
          time_point_sec   head_block_time()const;
          uint32_t         head_block_num()const;
@@ -354,6 +635,18 @@ namespace graphene { namespace chain {
          void debug_dump();
          void apply_debug_updates();
          void debug_update( const fc::variant_object& update );
+         /**
+          *  Marks the head block as the point an experiment forks off from. Until @ref debug_discard_fork is
+          *  called, the undo history and the fork database keep all blocks back to it, even once they are
+          *  irreversible.
+          */
+         void debug_start_fork();
+         /**
+          *  Pops all blocks applied since @ref debug_start_fork and removes them from the block database, which
+          *  restores the state of the fork point. Pending and popped transactions are dropped.
+          *  @return the number of blocks that were popped
+          */
+         uint32_t debug_discard_fork();
 
          //////////////////// db_market.cpp ////////////////////
 
@@ -424,6 +717,27 @@ namespace graphene { namespace chain {
          asset pay_market_fees( const account_object& seller, const asset_object& recv_asset, const asset& receives );
          ///@}
 
+         ///@{
+         /**
+          * While a market_fee_batch is alive, market fees and fee sharing rewards are summed up per asset and
+          * per beneficiary instead of being applied fill by fill, and written out once the outermost batch ends.
+          * A taker crossing many makers then modifies each fee pool and vesting balance only once.
+          */
+         class market_fee_batch
+         {
+            public:
+               explicit market_fee_batch( database& db );
+               ~market_fee_batch() noexcept(false);
+            private:
+               database& _db;
+               /// Exceptions in flight when the batch started, the batch is discarded if one more is
+               const int _uncaught_exceptions;
+         };
+         void add_issuer_market_fee( const asset_object& recv_asset, share_type amount );
+         void add_market_fee_reward( account_id_type account, const asset& reward );
+         void flush_market_fees();
+         ///@}
+
 
          ///@{
          /**
@@ -437,6 +751,12 @@ namespace graphene { namespace chain {
           * can be reapplied at the proper time */
          std::deque< precomputable_transaction > _popped_tx;
 
+         /**
+          * Maximum time spent re-applying pending transactions after a block was pushed, 0 for no limit.
+          * Transactions that were not re-applied in time are kept in _popped_tx until the next block.
+          */
+         fc::microseconds                        _pending_tx_reapply_time_limit;
+
          /**
           * @}
           */
@@ -444,6 +764,55 @@ namespace graphene { namespace chain {
          /// Enable or disable tracking of votes of standby witnesses and committee members
          inline void enable_standby_votes_tracking(bool enable)  { _track_standby_votes = enable; }
 
+         /// Store the operations applied in each block in an applied_operation_log next to the block database,
+         /// this has to be set before the database is opened
+         inline void enable_applied_operation_log(bool enable)  { _applied_operation_log_enabled = enable; }
+
+         /// Keep only about the last @p blocks irreversible blocks in the block database, 0 to keep all blocks
+         inline void set_block_log_retention(uint32_t blocks)  { _block_log_retain_blocks = blocks; }
+
+         /// Set the number of blocks that are read and precomputed ahead of the block being applied during replay
+         inline void set_replay_queue_depth(uint32_t depth)  { FC_ASSERT( depth > 0 ); _replay_queue_depth = depth; }
+
+         /**
+          * Enable or disable measuring the time spent in each stage of replays and in the evaluation of each
+          * operation type, @see get_replay_profile. Adds a clock reading per operation while replaying.
+          */
+         inline void enable_replay_profile(bool enable)  { _replay_profile_enabled = enable; }
+
+         /**
+          * Enable or disable logging how many steps the transactions of each applied block would need if they ran
+          * in parallel and only transactions that create, modify or remove the same objects were kept in order.
+          * Objects that are only read are not taken into account. Has no effect while undo is disabled, e.g. during
+          * replay.
+          */
+         inline void enable_transaction_conflict_analysis(bool enable)  { _analyze_transaction_conflicts = enable; }
+         /**
+          * Enable or disable logging the approximate memory usage of the indexes after each chain maintenance,
+          * @see get_memory_usage. It walks all objects of the indexes.
+          */
+         inline void enable_memory_usage_log(bool enable)  { _memory_usage_log_enabled = enable; }
+         /// The steps computed for the last applied block, 0 if it was not analyzed or had no transactions
+         inline uint32_t get_transaction_conflict_steps()const  { return _transaction_conflict_steps; }
+
+         /// Limit the time spent re-applying pending transactions after each block, 0 for no limit
+         inline void set_pending_tx_reapply_time_limit(fc::microseconds limit)  { _pending_tx_reapply_time_limit = limit; }
+
+         /**
+          * Limit the approximate memory used by the undo history, 0 for no limit, @see undo_database::bytes
+          * Blocks are rejected like beyond GRAPHENE_MAX_UNDO_HISTORY while the undo history of the blocks since the
+          * last irreversible block exceeds the limit, a warning is logged when three quarters are reached.
+          */
+         inline void set_undo_history_max_bytes(size_t bytes)  { _undo_db.set_max_bytes( bytes ); }
+
+         /// Set the number of public keys recovered from transaction signatures to remember, 0 to disable the cache
+         inline void set_signature_cache_size(size_t size)  { _signature_cache.set_capacity( size ); }
+
+         /** @return the public keys of the signatures of trx, which are looked up in the signature cache
+          *          and added to it if they are not known yet
+          */
+         const flat_set<public_key_type>& get_signature_keys( const precomputable_transaction& trx )const;
+
          /** Precomputes digests, signatures and operation validations depending
           *  on skip flags. "Expensive" computations may be done in a parallel
           *  thread.
@@ -463,9 +832,17 @@ namespace graphene { namespace chain {
           *         precomputations applied
           */
          fc::future<void> precompute_parallel( const precomputable_transaction& trx )const;
+
+         /** Does the same precomputations as precompute_parallel, but all of them in the calling thread.
+          *  Used when several blocks are precomputed concurrently, e.g. during replay.
+          */
+         void precompute_block( const signed_block& block, const uint32_t skip = skip_nothing )const;
    private:
          template<typename Trx>
          void _precompute_parallel( const Trx* trx, const size_t count, const uint32_t skip )const;
+         /** Recovers the signature keys of count transactions starting at trx, all signatures in one batch */
+         template<typename Trx>
+         void _recover_signature_keys( const Trx* trx, const size_t count )const;
 
    protected:
          //Mark pop_undo() as protected -- we do not want outside calling pop_undo(); it should call pop_block() instead
@@ -486,12 +863,12 @@ namespace graphene { namespace chain {
        public:
          // these were formerly private, but they have a fairly well-defined API, so let's make them public
          void                  apply_block( const signed_block& next_block, uint32_t skip = skip_nothing );
-         processed_transaction apply_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
+         processed_transaction apply_transaction( const precomputable_transaction& trx, uint32_t skip = skip_nothing );
          operation_result      apply_operation( transaction_evaluation_state& eval_state, const operation& op );
 
       private:
          void                  _apply_block( const signed_block& next_block );
-         processed_transaction _apply_transaction( const signed_transaction& trx );
+         processed_transaction _apply_transaction( const precomputable_transaction& trx );
          void                  _cancel_bids_and_revive_mpa( const asset_object& bitasset, const asset_bitasset_data_object& bad );
 
          ///Steps involved in applying a new block
@@ -536,11 +913,11 @@ namespace graphene { namespace chain {
          void process_bitassets();
 
          template<class Type>
-         void perform_account_maintenance( Type tally_helper );
+         void perform_account_maintenance( Type& tally_helper );
          ///@}
          ///@}
 
-         vector< processed_transaction >        _pending_tx;
+         pending_transaction_pool               _pending_tx;
          fork_database                          _fork_db;
 
          /**
@@ -553,6 +930,9 @@ namespace graphene { namespace chain {
           *  the fork tree relatively simple.
           */
          block_database   _block_id_to_block;
+         /// The operations applied in the blocks of _block_id_to_block, if enabled
+         applied_operation_log _applied_operation_log;
+         bool             _applied_operation_log_enabled = false;
 
          /**
           * Contains the set of ops that are in the process of being applied from
@@ -576,10 +956,48 @@ namespace graphene { namespace chain {
 
          node_property_object              _node_property_object;
 
+         /// The block an experiment forked off from, @see debug_start_fork
+         optional<uint32_t>                _debug_fork_point;
+
          /// Whether to update votes of standby witnesses and committee members when performing chain maintenance.
          /// Set it to true to provide accurate data to API clients, set to false to have better performance.
          bool                              _track_standby_votes = true;
 
+         /// Number of irreversible blocks to keep in the block database, 0 to keep all.
+         /// Segments that only contain older blocks are deleted, @see block_database::remove_blocks_before
+         uint32_t                          _block_log_retain_blocks = 0;
+
+         /// Number of blocks read and precomputed in parallel ahead of the block being applied during replay
+         uint32_t                          _replay_queue_depth = 20;
+
+         /// Whether the undo history is above three quarters of its limit, @see set_undo_history_max_bytes
+         bool                              _undo_history_near_limit = false;
+
+         /// Whether replays are profiled, @see enable_replay_profile
+         bool                              _replay_profile_enabled = false;
+         /// The profile of the last replay
+         std::unique_ptr<replay_profile>   _replay_profile;
+         /// The profile that blocks and operations are added to, only set while replaying
+         replay_profile*                   _active_replay_profile = nullptr;
+         /// @see get_block_timing
+         block_timing                      _block_timing;
+
+         /// Whether to log the parallelism available in applied blocks, @see enable_transaction_conflict_analysis
+         bool                              _analyze_transaction_conflicts = false;
+         /// @see get_transaction_conflict_steps
+         uint32_t                          _transaction_conflict_steps = 0;
+         /// @see enable_memory_usage_log
+         bool                              _memory_usage_log_enabled = false;
+
+         /// Public keys recovered from the signatures of recently seen transactions
+         mutable signature_cache           _signature_cache{ 65536 };
+
+         /// Successful authority checks of transactions and proposals, cleared by account_authority_index
+         authority_check_cache             _authority_check_cache;
+
+         /// Results of is_authorized_asset, cleared by account_whitelist_index and asset_whitelist_index
+         mutable authorized_asset_cache    _authorized_asset_cache;
+
          /**
           * Whether database is successfully opened or not.
           *
@@ -592,11 +1010,41 @@ namespace graphene { namespace chain {
          // Counts nested proposal updates
          uint32_t                           _push_proposal_nesting_depth = 0;
 
+         /// Guards the chain state against readers in other threads, @see read_lock
+         ///@{
+         mutable state_mutex                _read_write_mutex;
+         /// Only touched by the applying thread
+         uint32_t                           _write_scope_depth = 0;
+         const read_scope*                  _active_read_scope = nullptr;
+         ///@}
+
+         /// Only touched by the applying thread, @see get_maintenance_hardforks
+         mutable maintenance_hardforks      _maintenance_hardforks;
+
+         /// Number of maintenances whose timings are kept, @see get_maintenance_timings
+         static const size_t                maintenance_timings_to_keep = 10;
+         std::deque<maintenance_timing>     _maintenance_timings;
+
+         /// Market fees waiting to be written out, @see market_fee_batch
+         ///@{
+         uint32_t                                          _market_fee_batch_depth = 0;
+         flat_map<asset_dynamic_data_id_type, share_type>  _batched_issuer_fees;
+         /// In the order of the first reward per beneficiary, so that new vesting balances get the same IDs
+         vector<pair<account_id_type, asset>>              _batched_fee_rewards;
+         ///@}
+
          /// Tracks assets affected by bitshares-core issue #453 before hard fork #615 in one block
          flat_set<asset_id_type>           _issue_453_affected_assets;
 
          /// Pointers to core asset object and global objects who will have immutable addresses after created
          ///@{
+         /// Looks up recent transactions by ID, set up together with the transaction index
+         const recent_transaction_index*        _p_recent_trx_idx          = nullptr;
+         /// Limit orders by market, set up together with the limit order index
+         const limit_order_book_index*          _p_limit_order_book_idx    = nullptr;
+         /// Call orders by market, set up together with the call order index
+         const call_order_book_index*           _p_call_order_book_idx     = nullptr;
+
          const asset_object*                    _p_core_asset_obj          = nullptr;
          const asset_dynamic_data_object*       _p_core_dynamic_data_obj   = nullptr;
          const global_property_object*          _p_global_prop_obj         = nullptr;
@@ -626,3 +1074,13 @@ namespace graphene { namespace chain {
    }
 
 } }
+
+FC_REFLECT( graphene::chain::snapshot_info, (db_version)(chain_id)(head_block) )
+FC_REFLECT( graphene::chain::maintenance_timing, (block_num)(timestamp)(total_us)(phases) )
+FC_REFLECT( graphene::chain::block_timing,
+            (block_num)(transactions)(header_ns)(transactions_ns)(block_updates_ns)(maintenance_ns)(expiry_ns)
+            (batched_indexes_ns)(applied_block_ns)(changed_objects_ns)(apply_ns)(push_ns) )
+FC_REFLECT( graphene::chain::replay_profile::operation_stats, (name)(count)(total_ns)(average_ns) )
+FC_REFLECT( graphene::chain::replay_profile,
+            (blocks)(transactions)(total_ns)(read_ns)(precompute_ns)(wait_ns)(header_ns)(transactions_ns)
+            (maintenance_ns)(block_end_ns)(plugins_ns)(undo_ns)(rebuild_indexes_ns)(operations) )
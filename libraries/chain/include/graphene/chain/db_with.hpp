@@ -68,36 +68,43 @@ struct skip_flags_restorer
  */
 struct pending_transactions_restorer
 {
-   pending_transactions_restorer( database& db, std::vector<processed_transaction>&& pending_transactions )
-      : _db(db), _pending_transactions( std::move(pending_transactions) )
+   pending_transactions_restorer( database& db, pending_transaction_pool&& pending_transactions )
+      : _db(db), _pending_transactions( pending_transactions.release() )
    {
       _db.clear_pending();
    }
 
    ~pending_transactions_restorer()
    {
-      for( const auto& tx : _db._popped_tx )
-      {
+      const fc::microseconds time_limit = _db._pending_tx_reapply_time_limit;
+      const fc::time_point deadline = time_limit.count() > 0 ? fc::time_point::now() + time_limit
+                                                             : fc::time_point::maximum();
+      // transactions left over when the time is up, they are tried again after the next block
+      std::deque< precomputable_transaction > deferred;
+      auto reapply = [this,deadline,&deferred]( precomputable_transaction&& tx ) {
+         // expired and included transactions are dropped without applying them
+         if( _db.head_block_time() > tx.expiration || _db.is_known_transaction( tx.id() ) )
+            return;
+         if( deadline != fc::time_point::maximum() && fc::time_point::now() > deadline )
+         {
+            deferred.push_back( std::move(tx) );
+            return;
+         }
          try {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               _db._push_transaction( tx );
-            }
+            _db._push_transaction( tx );
          } catch ( const fc::exception& ) { // ignore invalid transactions
          }
-      }
+      };
+
+      for( auto& tx : _db._popped_tx )
+         reapply( std::move(tx) );
       _db._popped_tx.clear();
-      for( const processed_transaction& tx : _pending_transactions )
-      {
-         try
-         {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               _db._push_transaction( tx );
-            }
-         }
-         catch( const fc::exception& )
-         { // ignore invalid transactions
-         }
-      }
+      for( processed_transaction& tx : _pending_transactions )
+         reapply( std::move(tx) );
+
+      if( !deferred.empty() )
+         wlog( "Deferred re-applying ${n} pending transactions", ("n",deferred.size()) );
+      _db._popped_tx = std::move( deferred );
    }
 
    database& _db;
@@ -131,7 +138,7 @@ void with_skip_flags(
 template< typename Lambda >
 void without_pending_transactions(
    database& db,
-   std::vector<processed_transaction>&& pending_transactions,
+   pending_transaction_pool&& pending_transactions,
    Lambda callback )
 {
     pending_transactions_restorer restorer( db, std::move(pending_transactions) );
@@ -26,6 +26,11 @@
 #include <graphene/chain/transaction_evaluation_state.hpp>
 #include <graphene/protocol/operations.hpp>
 
+#ifdef GRAPHENE_EVALUATOR_PROFILING
+#include <algorithm>
+#include <chrono>
+#endif
+
 namespace graphene { namespace chain {
 
    class database;
@@ -36,6 +41,46 @@ namespace graphene { namespace chain {
    class asset_object;
    class asset_dynamic_data_object;
 
+   /**
+    * Calls and wall clock time of the evaluator of one operation type, @see database::get_evaluator_statistics.
+    * Only collected in builds with GRAPHENE_EVALUATOR_PROFILING.
+    */
+   struct evaluator_statistics
+   {
+      std::string operation;
+      uint64_t    evaluations = 0;       ///< calls of do_evaluate, including failed ones
+      int64_t     evaluate_total_ns = 0;
+      int64_t     evaluate_max_ns = 0;
+      uint64_t    applications = 0;      ///< calls of do_apply, including failed ones
+      int64_t     apply_total_ns = 0;
+      int64_t     apply_max_ns = 0;
+   };
+
+#ifdef GRAPHENE_EVALUATOR_PROFILING
+   /// Adds the time from construction to destruction to a call count, a total and a maximum
+   class evaluator_timer
+   {
+      public:
+         evaluator_timer( uint64_t& count, int64_t& total_ns, int64_t& max_ns )
+         : _count( count ), _total_ns( total_ns ), _max_ns( max_ns ), _start( std::chrono::steady_clock::now() ) {}
+
+         ~evaluator_timer()
+         {
+            const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now() - _start ).count();
+            ++_count;
+            _total_ns += ns;
+            _max_ns = std::max( _max_ns, ns );
+         }
+
+      private:
+         uint64_t&                             _count;
+         int64_t&                              _total_ns;
+         int64_t&                              _max_ns;
+         std::chrono::steady_clock::time_point _start;
+   };
+#endif
+
    class generic_evaluator
    {
    public:
@@ -70,6 +115,11 @@ namespace graphene { namespace chain {
 
       database& db()const;
 
+#ifdef GRAPHENE_EVALUATOR_PROFILING
+      /// Where the calls of do_evaluate and do_apply are counted, set by op_evaluator_impl
+      evaluator_statistics*            statistics = nullptr;
+#endif
+
       //void check_required_authorities(const operation& op);
    protected:
       /**
@@ -125,15 +175,34 @@ namespace graphene { namespace chain {
    public:
       virtual ~op_evaluator(){}
       virtual operation_result evaluate(transaction_evaluation_state& eval_state, const operation& op, bool apply) = 0;
+
+#ifdef GRAPHENE_EVALUATOR_PROFILING
+      evaluator_statistics statistics;
+#endif
    };
 
    template<typename T>
    class op_evaluator_impl : public op_evaluator
    {
    public:
+#ifdef GRAPHENE_EVALUATOR_PROFILING
+      op_evaluator_impl()
+      {
+         statistics.operation = fc::get_typename<typename T::operation_type>::name();
+      }
+#endif
+
+      /**
+       * The evaluator is constructed for every operation rather than kept, because evaluators store the objects of
+       * the operation they evaluate and an operation may apply nested operations of the same type, like a
+       * proposal_update_operation executing a proposal.
+       */
       virtual operation_result evaluate(transaction_evaluation_state& eval_state, const operation& op, bool apply = true) override
       {
          T eval;
+#ifdef GRAPHENE_EVALUATOR_PROFILING
+         eval.statistics = &statistics;
+#endif
          return eval.start_evaluate(eval_state, op, apply);
       }
    };
@@ -144,6 +213,19 @@ namespace graphene { namespace chain {
    public:
       virtual int get_type()const override { return operation::tag<typename DerivedEvaluator::operation_type>::value; }
 
+      /**
+       * Same as generic_evaluator::start_evaluate, but with the calls of evaluate and apply bound at compile time,
+       * so that dispatching an operation from op_evaluator_impl takes no virtual call beyond the registry lookup.
+       */
+      virtual operation_result start_evaluate( transaction_evaluation_state& eval_state, const operation& op,
+                                               bool apply ) final override
+      { try {
+         trx_state = &eval_state;
+         auto result = evaluator::evaluate( op );
+         if( apply ) result = evaluator::apply( op );
+         return result;
+      } FC_CAPTURE_AND_RETHROW() }
+
       virtual operation_result evaluate(const operation& o) final override
       {
          auto* eval = static_cast<DerivedEvaluator*>(this);
@@ -159,6 +241,14 @@ namespace graphene { namespace chain {
                        ("core_fee_paid",core_fee_paid)("required", required_fee) );
          }
 
+#ifdef GRAPHENE_EVALUATOR_PROFILING
+         if( statistics )
+         {
+            evaluator_timer timer( statistics->evaluations, statistics->evaluate_total_ns,
+                                   statistics->evaluate_max_ns );
+            return eval->do_evaluate(op);
+         }
+#endif
          return eval->do_evaluate(op);
       }
 
@@ -170,7 +260,18 @@ namespace graphene { namespace chain {
          convert_fee();
          pay_fee();
 
+#ifdef GRAPHENE_EVALUATOR_PROFILING
+         operation_result result;
+         if( statistics )
+         {
+            evaluator_timer timer( statistics->applications, statistics->apply_total_ns, statistics->apply_max_ns );
+            result = eval->do_apply(op);
+         }
+         else
+            result = eval->do_apply(op);
+#else
          auto result = eval->do_apply(op);
+#endif
 
          db_adjust_balance(op.fee_payer(), -fee_from_account);
 
@@ -178,3 +279,7 @@ namespace graphene { namespace chain {
       }
    };
 } }
+
+FC_REFLECT( graphene::chain::evaluator_statistics,
+            (operation)(evaluations)(evaluate_total_ns)(evaluate_max_ns)
+            (applications)(apply_total_ns)(apply_max_ns) )
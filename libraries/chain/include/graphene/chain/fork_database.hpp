@@ -39,15 +39,18 @@ namespace graphene { namespace chain {
 
    struct fork_item
    {
-      fork_item( signed_block d )
-      :num(d.block_num()),id(d.id()),data( std::move(d) ){}
+      fork_item( shared_ptr<const signed_block> d )
+      :num(d->block_num()),id(d->id()),data( std::move(d) ){}
 
-      block_id_type previous_id()const { return data.previous; }
+      block_id_type previous_id()const { return data->previous; }
 
       weak_ptr< fork_item > prev;
+      /// Ancestor a variable number of blocks back, used by fork_database::fetch_ancestor to skip ahead
+      weak_ptr< fork_item > skip;
       uint32_t              num;    // initialized in ctor
       block_id_type         id;
-      signed_block          data;
+      /// Shared with the caller of fork_database::push_block, so that the block is not copied
+      shared_ptr<const signed_block> data;
    };
    typedef shared_ptr<fork_item> item_ptr;
 
@@ -82,6 +85,7 @@ namespace graphene { namespace chain {
          /**
           *  @return the new head block ( the longest fork )
           */
+         shared_ptr<fork_item>            push_block(const shared_ptr<const signed_block>& b);
          shared_ptr<fork_item>            push_block(const signed_block& b);
          shared_ptr<fork_item>            head()const { return _head; }
          void                             pop_block();
@@ -93,6 +97,12 @@ namespace graphene { namespace chain {
          pair< branch_type, branch_type >  fetch_branch_from(block_id_type first,
                                                              block_id_type second)const;
 
+         /**
+          *  @return the ancestor of item with block number num, or null if it is not in the fork DB.
+          *  Follows the skip pointers of the branch, so the lookup takes O(log n) steps.
+          */
+         item_ptr                         fetch_ancestor( item_ptr item, uint32_t num )const;
+
          struct block_id;
          struct block_num;
          typedef multi_index_container<
@@ -126,6 +126,15 @@ struct genesis_state_type {
    chain_id_type compute_chain_id() const;
 };
 
+/**
+ * Parses a genesis state from its JSON representation, same as converting the parsed variant to a
+ * genesis_state_type, but the long lists of accounts and balances are converted on the worker threads.
+ *
+ * @param json the genesis state in JSON
+ * @param max_depth the maximum nesting depth of the genesis state, as in fc::variant::as
+ */
+genesis_state_type load_genesis_state( const string& json, uint32_t max_depth );
+
 } } // namespace graphene::chain
 
 FC_REFLECT_TYPENAME( graphene::chain::genesis_state_type::initial_account_type )
@@ -39,4 +39,35 @@ void transaction_get_impacted_accounts(
    fc::flat_set<graphene::chain::account_id_type>& result
    );
 
+/**
+ * A conservative description of the state that operations may read or modify, derived from the operations
+ * alone. Operations whose footprints do not conflict can be evaluated in either order with the same result,
+ * apart from the IDs of created objects.
+ */
+struct operation_footprint
+{
+   typedef graphene::chain::account_id_type account_id_type;
+   typedef graphene::chain::asset_id_type   asset_id_type;
+
+   /// Accounts, including their statistics, that may be read or modified
+   fc::flat_set<account_id_type>                      accounts;
+   /// Balances by (owner, asset) that may be read or modified
+   fc::flat_set<std::pair<account_id_type,asset_id_type>> balances;
+   /// Assets that may be read
+   fc::flat_set<asset_id_type>                        assets_read;
+   /// Assets whose objects, including dynamic data and bitasset data, may be modified
+   fc::flat_set<asset_id_type>                        assets_written;
+   /// Markets whose orders may be created, matched or changed, the lower asset ID first
+   fc::flat_set<std::pair<asset_id_type,asset_id_type>> markets;
+   /// Whether accounts and balances of other traders in the markets may be modified, e.g. by filled orders
+   bool                                               any_account = false;
+   /// Whether the operation may touch anything, e.g. because it executes other operations
+   bool                                               unknown = false;
+
+   bool conflicts_with( const operation_footprint& other )const;
+};
+
+void operation_get_footprint( const graphene::chain::operation& op, operation_footprint& result );
+void transaction_get_footprint( const graphene::chain::transaction& tx, operation_footprint& result );
+
 } } // graphene::app
\ No newline at end of file
@@ -23,12 +23,43 @@
  */
 #pragma once
 
+#include <graphene/chain/types.hpp>
+
+#include <map>
+
 namespace graphene { namespace chain {
 
 class account_object;
 class asset_object;
 class database;
 
+/**
+ * @brief Results of the whitelist and blacklist checks of is_authorized_asset by account and asset.
+ *
+ * Cleared by account_whitelist_index and asset_whitelist_index whenever the lists of an account or an asset
+ * change, including when the change is undone.
+ */
+class authorized_asset_cache
+{
+   public:
+      /** @return the cached result for the account and the asset, or null if there is none */
+      const bool* find( account_id_type account, asset_id_type asset )const
+      {
+         auto itr = _results.find( std::make_pair( account, asset ) );
+         return itr != _results.end() ? &itr->second : nullptr;
+      }
+      /** Adds a result to the cache, the cache is emptied first if it is full */
+      void insert( account_id_type account, asset_id_type asset, bool authorized );
+      void clear() { _results.clear(); }
+      size_t size()const { return _results.size(); }
+
+      /** Maximum number of entries */
+      static const size_t max_size = 100000;
+
+   private:
+      std::map< std::pair<account_id_type, asset_id_type>, bool > _results;
+};
+
 namespace detail {
 
 bool _is_authorized_asset(const database& d, const account_object& acct, const asset_object& asset_obj);
@@ -29,6 +29,10 @@
 
 #include <boost/multi_index/composite_key.hpp>
 
+#include <set>
+#include <tuple>
+#include <unordered_map>
+
 namespace graphene { namespace chain {
 
 using namespace graphene::db;
@@ -95,11 +99,93 @@ typedef multi_index_container<
          >,
          composite_key_compare<std::less<account_id_type>, std::greater<price>, std::less<object_id_type>>
       >
-   >
+   >,
+   node_pool_allocator< limit_order_object >
 > limit_order_multi_index_type;
 
 typedef generic_index<limit_order_object, limit_order_multi_index_type> limit_order_index;
 
+/**
+ *  An integer that sorts like the ratio base / quote of a price, computed as floor( base * 2^126 / quote ).
+ *  Ratios of amounts below 2^63 that are not equal differ by at least 2^-126, so they never get the same key.
+ *  Comparing keys is much cheaper than comparing prices. The asset IDs are not part of the key.
+ */
+struct price_sort_key
+{
+   price_sort_key() = default;
+   explicit price_sort_key( const price& p );
+
+   uint64_t high = 0;
+   uint64_t middle = 0;
+   uint64_t low = 0;
+
+   friend bool operator < ( const price_sort_key& a, const price_sort_key& b )
+   {
+      return std::tie( a.high, a.middle, a.low ) < std::tie( b.high, b.middle, b.low );
+   }
+   friend bool operator == ( const price_sort_key& a, const price_sort_key& b )
+   {
+      return a.low == b.low && a.middle == b.middle && a.high == b.high;
+   }
+};
+
+/**
+ *  @brief Keeps the limit orders of each market side in a separate tree, ordered like the by_price index of
+ *  limit_order_index. Matching walks only the book of the market being matched, and orders are compared by
+ *  their price_sort_key, which does not look at the asset IDs as they are the same for all orders of a book.
+ */
+class limit_order_book_index : public secondary_index
+{
+   public:
+      struct entry
+      {
+         entry( const limit_order_object& o );
+
+         price_sort_key            key; ///< of the sell price of the order
+         object_id_type            id;
+         const limit_order_object* order;
+      };
+      /** Best price first, orders at the same price in the order they were created. Sort keys of prices can be
+       *  used for lookups, lower_bound and upper_bound then behave like a partial composite key of the by_price
+       *  index. */
+      struct compare_entries
+      {
+         typedef void is_transparent;
+         bool operator()( const entry& a, const entry& b )const
+         {
+            if( a.key == b.key )
+               return a.id < b.id;
+            return b.key < a.key;
+         }
+         bool operator()( const entry& a, const price_sort_key& b )const { return b < a.key; }
+         bool operator()( const price_sort_key& a, const entry& b )const { return b.key < a; }
+      };
+      typedef std::set< entry, compare_entries > book_type;
+
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual void about_to_modify( const object& before ) override;
+      virtual void object_modified( const object& after  ) override;
+
+      /** @return the orders selling sell_asset for receive_asset. The book stays valid while orders are added
+       *  and removed, so iterators into it can be kept during matching. */
+      const book_type& get_book( asset_id_type sell_asset, asset_id_type receive_asset )const;
+
+      virtual size_t memory_usage()const override;
+
+   private:
+      typedef std::pair< asset_id_type, asset_id_type > market_type;
+      struct market_hash
+      {
+         size_t operator()( const market_type& m )const;
+      };
+      book_type& book_of( const limit_order_object& o );
+
+      /// Books are not removed when they become empty, they may still be iterated
+      std::unordered_map< market_type, book_type, market_hash > _books;
+      price _price_before;
+};
+
 /**
  * @class call_order_object
  * @brief tracks debt and call price information
@@ -268,6 +354,62 @@ typedef generic_index<call_order_object, call_order_multi_index_type>
 typedef generic_index<force_settlement_object, force_settlement_object_multi_index_type>   force_settlement_index;
 typedef generic_index<collateral_bid_object, collateral_bid_object_multi_index_type>       collateral_bid_index;
 
+/**
+ *  @brief Keeps the call orders of each (debt asset, collateral asset) pair in a separate tree, ordered like the
+ *  by_collateral index of call_order_index. The least collateralized position, which decides whether anything
+ *  can be margin called, is found in constant time, and moving through the positions compares price_sort_keys
+ *  instead of computing the collateralization of each position that is passed.
+ */
+class call_order_book_index : public secondary_index
+{
+   public:
+      struct entry
+      {
+         entry( const call_order_object& o );
+
+         price_sort_key           key; ///< of the collateralization of the position
+         object_id_type           id;
+         const call_order_object* order;
+      };
+      /** Least collateralized first, positions with the same collateralization in the order they were created */
+      struct compare_entries
+      {
+         bool operator()( const entry& a, const entry& b )const
+         {
+            if( a.key == b.key )
+               return a.id < b.id;
+            return a.key < b.key;
+         }
+      };
+      typedef std::set< entry, compare_entries > book_type;
+
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual void about_to_modify( const object& before ) override;
+      virtual void object_modified( const object& after  ) override;
+
+      /** @return the positions owing debt_asset backed by collateral_asset. The book stays valid while positions
+       *  are added and removed. */
+      const book_type& get_book( asset_id_type debt_asset, asset_id_type collateral_asset )const;
+
+      virtual size_t memory_usage()const override;
+
+   private:
+      typedef std::pair< asset_id_type, asset_id_type > market_type;
+      struct market_hash
+      {
+         size_t operator()( const market_type& m )const;
+      };
+      book_type& book_of( const call_order_object& o );
+      static market_type market_of( const call_order_object& o );
+
+      /// Books are not removed when they become empty, they may still be iterated
+      std::unordered_map< market_type, book_type, market_hash > _books;
+      market_type    _market_before;
+      share_type     _collateral_before;
+      share_type     _debt_before;
+};
+
 } } // graphene::chain
 
 MAP_OBJECT_ID_TO_TYPE(graphene::chain::limit_order_object)
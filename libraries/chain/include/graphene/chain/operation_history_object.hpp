@@ -25,6 +25,7 @@
 
 #include <graphene/protocol/operations.hpp>
 #include <graphene/db/object.hpp>
+#include <graphene/db/generic_index.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
 
@@ -96,13 +97,16 @@ namespace graphene { namespace chain {
          operation_history_id_type            operation_id;
          uint64_t                             sequence = 0; /// the operation position within the given account
          account_transaction_history_id_type  next;
+         /// which() of the operation, so that the history can be indexed by type without the operation object
+         uint16_t                             operation_type = 0;
    };
 
    typedef multi_index_container<
       operation_history_object,
       indexed_by<
          ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >
-      >
+      >,
+      node_pool_allocator< operation_history_object >
    > operation_history_multi_index_type;
 
    typedef generic_index<operation_history_object, operation_history_multi_index_type> operation_history_index;
@@ -130,7 +134,8 @@ namespace graphene { namespace chain {
          ordered_non_unique< tag<by_opid>,
             member< account_transaction_history_object, operation_history_id_type, &account_transaction_history_object::operation_id>
          >
-      >
+      >,
+      node_pool_allocator< account_transaction_history_object >
    > account_transaction_history_multi_index_type;
 
    typedef generic_index<account_transaction_history_object, account_transaction_history_multi_index_type> account_transaction_history_index;
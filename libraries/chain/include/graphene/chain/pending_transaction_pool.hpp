@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/protocol/transaction.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
+namespace graphene { namespace chain {
+   using namespace graphene::protocol;
+
+   /**
+    *  The transactions that have been applied on top of the head block but are not yet in a block. They are
+    *  kept in the order they were applied, and are indexed by ID, fee payer and expiration so that any of them
+    *  can be found and removed in constant or logarithmic time.
+    *
+    *  The packed size and the fee paid per kilobyte are computed once on insertion, block production uses
+    *  them to choose the transactions to include when not all of them fit into a block.
+    */
+   class pending_transaction_pool
+   {
+      public:
+         struct entry
+         {
+            processed_transaction trx;
+            transaction_id_type   id;
+            account_id_type       fee_payer;   ///< of the first operation
+            fc::time_point_sec    expiration;
+            size_t                packed_size = 0;
+            uint64_t              fee_rate = 0; ///< core asset paid per 1024 bytes
+            uint64_t              sequence = 0; ///< arrival order
+         };
+
+         struct by_id;
+         struct by_fee_payer;
+         struct by_expiration;
+         typedef boost::multi_index_container<
+            entry,
+            boost::multi_index::indexed_by<
+               boost::multi_index::sequenced<>, // in the order the transactions were applied
+               boost::multi_index::hashed_unique< boost::multi_index::tag<by_id>,
+                  boost::multi_index::member< entry, transaction_id_type, &entry::id >,
+                  std::hash<transaction_id_type> >,
+               boost::multi_index::ordered_unique< boost::multi_index::tag<by_fee_payer>,
+                  boost::multi_index::composite_key< entry,
+                     boost::multi_index::member< entry, account_id_type, &entry::fee_payer >,
+                     boost::multi_index::member< entry, uint64_t, &entry::sequence >
+                  >
+               >,
+               boost::multi_index::ordered_non_unique< boost::multi_index::tag<by_expiration>,
+                  boost::multi_index::member< entry, fc::time_point_sec, &entry::expiration > >
+            >
+         > entry_index_type;
+
+         /**
+          *  Adds a transaction after the ones already in the pool, unless one with the same ID is there already.
+          *  @param core_fees the fees of all operations of trx, converted to the core asset
+          *  @return true if it was added
+          */
+         bool push_back( processed_transaction trx, const transaction_id_type& id, share_type core_fees );
+
+         /** @return the pending transaction with the given ID, or nullptr */
+         const entry* find( const transaction_id_type& id )const;
+         /** @return true if a transaction was removed */
+         bool remove( const transaction_id_type& id );
+         /** Removes the transactions that expire before now, @return how many were removed */
+         size_t remove_expired( fc::time_point_sec now );
+
+         /** Empties the pool, @return its transactions in the order they were added */
+         vector<processed_transaction> release();
+         void clear();
+
+         /**
+          *  Chooses the transactions to put into a block, so that the sum of their packed sizes does not exceed
+          *  max_size. If all of them fit they are returned in the order they were added. Otherwise the ones paying
+          *  the highest fee per byte come first, but the transactions paid by each account are kept in their
+          *  original order, as later ones may depend on earlier ones.
+          */
+         vector<const entry*> select( size_t max_size )const;
+
+         size_t size()const { return _entries.size(); }
+         bool empty()const { return _entries.empty(); }
+         /// The sum of the packed sizes of all pending transactions
+         size_t total_size()const { return _total_size; }
+
+         entry_index_type::const_iterator begin()const { return _entries.begin(); }
+         entry_index_type::const_iterator end()const { return _entries.end(); }
+
+      private:
+         entry_index_type _entries;
+         size_t           _total_size = 0;
+         uint64_t         _next_sequence = 0;
+   };
+
+} } // graphene::chain
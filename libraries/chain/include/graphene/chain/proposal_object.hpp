@@ -55,6 +55,14 @@ class proposal_object : public abstract_object<proposal_object>
       std::string                   fail_reason;
 
       bool is_authorized_to_execute(database& db) const;
+
+      /// Undo snapshots leave out proposed_transaction, which never changes after creation.
+      /// Any newly added member that can be modified must be handled in these methods.
+      ///@{
+      virtual unique_ptr<object> undo_snapshot()const override;
+      virtual void               copy_undo_snapshot_from( const object& obj ) override;
+      virtual void               restore_undo_snapshot( object& snapshot ) override;
+      ///@}
 };
 
 /**
@@ -64,9 +72,10 @@ class proposal_object : public abstract_object<proposal_object>
  *  @ingroup object
  *  @ingroup protocol
  *
- *  This is a secondary index on the proposal_index
+ *  This is a secondary index on the proposal_index. An account is mapped to all proposals
+ *  it proposed, is required to approve, or has approved.
  *
- *  @note the set of required approvals is constant
+ *  @note the proposer and the set of required approvals are constant
  */
 class required_approval_index : public secondary_index
 {
@@ -80,8 +89,10 @@ class required_approval_index : public secondary_index
 
    private:
       void remove( account_id_type a, proposal_id_type p );
-      void insert_or_remove_delta( proposal_id_type p, const flat_set<account_id_type>& before,
+      /** Maps the accounts added to the set of approvals, and unmaps the removed ones not related otherwise */
+      void insert_or_remove_delta( const proposal_object& p, const flat_set<account_id_type>& before,
                                    const flat_set<account_id_type>& after );
+      static bool is_related( const proposal_object& p, account_id_type a );
       flat_set<account_id_type> available_active_before_modify;
       flat_set<account_id_type> available_owner_before_modify;
 };
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/protocol/types.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
+#include <mutex>
+
+namespace graphene { namespace chain {
+   using namespace graphene::protocol;
+
+   /**
+    *  Remembers the public keys recovered from transaction signatures. Transactions are usually seen twice,
+    *  when they are broadcast and again in a block, so the expensive recovery is only done once. The least
+    *  recently used keys are dropped when the cache is full.
+    *
+    *  Safe to use from several threads at once, the recovery itself runs without holding the lock.
+    */
+   class signature_cache
+   {
+      public:
+         explicit signature_cache( size_t capacity ) : _capacity( capacity ) {}
+
+         /** @return the public key that created sig on digest */
+         public_key_type recover( const signature_type& sig, const digest_type& digest );
+
+         struct request
+         {
+            signature_type  sig;
+            digest_type     digest;
+            public_key_type key; ///< set by recover()
+         };
+         /** Recovers the keys of all requests, the lock is only taken once to look them up and once to add them */
+         void recover( vector<request>& requests );
+
+         /** Sets the maximum number of keys to keep, 0 disables the cache */
+         void set_capacity( size_t capacity );
+         size_t size()const;
+
+      private:
+         struct signed_digest
+         {
+            digest_type    digest;
+            signature_type sig;
+
+            bool operator==( const signed_digest& other )const
+            {
+               return digest == other.digest && sig == other.sig;
+            }
+         };
+         struct signed_digest_hash
+         {
+            size_t operator()( const signed_digest& key )const;
+         };
+         struct entry
+         {
+            signed_digest   key;
+            public_key_type public_key;
+         };
+         typedef boost::multi_index_container<
+            entry,
+            boost::multi_index::indexed_by<
+               boost::multi_index::sequenced<>, // most recently used first
+               boost::multi_index::hashed_unique< boost::multi_index::member< entry, signed_digest, &entry::key >,
+                                                  signed_digest_hash >
+            >
+         > entry_index_type;
+
+         void trim();
+
+         mutable std::mutex _mutex;
+         size_t             _capacity;
+         entry_index_type   _entries;
+   };
+
+} } // graphene::chain
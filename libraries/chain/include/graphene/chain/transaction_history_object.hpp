@@ -32,6 +32,8 @@
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/mem_fun.hpp>
 
+#include <deque>
+
 namespace graphene { namespace chain {
    using namespace graphene::db;
    using boost::multi_index_container;
@@ -53,20 +55,58 @@ namespace graphene { namespace chain {
          time_point_sec get_expiration()const { return trx.expiration; }
    };
 
-   struct by_expiration;
-   struct by_trx_id;
    typedef multi_index_container<
       transaction_history_object,
       indexed_by<
-         ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
-         hashed_unique< tag<by_trx_id>, BOOST_MULTI_INDEX_MEMBER(transaction_history_object, transaction_id_type, trx_id),
-                        std::hash<transaction_id_type> >,
-         ordered_non_unique< tag<by_expiration>, const_mem_fun< transaction_history_object, time_point_sec,
-                                                                &transaction_history_object::get_expiration > >
-      >
+         ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >
+      >,
+      node_pool_allocator< transaction_history_object >
    > transaction_multi_index_type;
 
    typedef generic_index<transaction_history_object, transaction_multi_index_type> transaction_index;
+
+   /**
+    * Finds transaction_history_objects by transaction ID for the duplicate check, and finds the expired ones.
+    *
+    * The IDs are kept in an open addressing hash table. Objects are also kept in a ring of buckets, with one
+    * bucket for each second of expiration time. Expired transactions are taken from the oldest bucket, and
+    * the bucket is dropped once it is empty. Neither structure allocates a node per transaction.
+    */
+   class recent_transaction_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+         virtual size_t memory_usage()const override;
+
+         /** @return the object of the transaction with the given ID, or nullptr if there is none */
+         const transaction_history_object* find( const transaction_id_type& id )const;
+         /** @return one of the objects of transactions that expired before now, or nullptr if there is none */
+         const transaction_history_object* find_expired( time_point_sec now )const;
+         size_t size()const { return _count; }
+
+      private:
+         struct slot
+         {
+            transaction_id_type               id;
+            const transaction_history_object* obj = nullptr; ///< nullptr for an empty slot
+         };
+
+         void insert( const transaction_history_object& obj );
+         void remove( const transaction_history_object& obj );
+         void resize_table( size_t new_size );
+         size_t home_slot( const transaction_id_type& id )const;
+
+         /** the size is a power of two and at least twice _count, collisions are resolved by linear probing */
+         vector<slot> _table;
+         size_t       _count = 0;
+
+         /** _buckets[i] holds the objects expiring at _first_expiration + i, the first and last bucket are not empty */
+         std::deque< vector<const transaction_history_object*> > _buckets;
+         uint32_t     _first_expiration = 0;
+   };
 } }
 
 MAP_OBJECT_ID_TO_TYPE(graphene::chain::transaction_history_object)
@@ -27,15 +27,22 @@
 
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/is_authorized_asset.hpp>
 
 namespace graphene { namespace chain {
 
+void authorized_asset_cache::insert( account_id_type account, asset_id_type asset, bool authorized )
+{
+   if( _results.size() >= max_size )
+      _results.clear();
+   _results[ std::make_pair( account, asset ) ] = authorized;
+}
+
 namespace detail {
 
-bool _is_authorized_asset(
-   const database& d,
-   const account_object& acct,
-   const asset_object& asset_obj)
+namespace {
+
+bool check_authorized_asset( const account_object& acct, const asset_object& asset_obj )
 {
    if( acct.allowed_assets.valid() )
    {
@@ -62,6 +69,23 @@ bool _is_authorized_asset(
    return false;
 }
 
+} // anonymous namespace
+
+bool _is_authorized_asset(
+   const database& d,
+   const account_object& acct,
+   const asset_object& asset_obj)
+{
+   authorized_asset_cache& cache = d.get_authorized_asset_cache();
+   const bool* cached = cache.find( acct.id, asset_obj.id );
+   if( cached != nullptr )
+      return *cached;
+
+   const bool authorized = check_authorized_asset( acct, asset_obj );
+   cache.insert( acct.id, asset_obj.id, authorized );
+   return authorized;
+}
+
 } // detail
 
 } } // graphene::chain
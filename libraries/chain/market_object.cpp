@@ -26,8 +26,10 @@
 #include <boost/multiprecision/cpp_int.hpp>
 
 #include <functional>
+#include <limits>
 
 #include <fc/io/raw.hpp>
+#include <fc/uint128.hpp>
 
 using namespace graphene::chain;
 
@@ -303,6 +305,155 @@ share_type call_order_object::get_max_debt_to_cover( price match_price,
 
 } FC_CAPTURE_AND_RETHROW( (*this)(feed_price)(match_price)(maintenance_collateral_ratio) ) }
 
+price_sort_key::price_sort_key( const price& p )
+{
+   if( p.quote.amount <= 0 )
+   {
+      high = middle = low = std::numeric_limits<uint64_t>::max();
+      return;
+   }
+   using boost::multiprecision::uint256_t;
+   const uint256_t word_mask = std::numeric_limits<uint64_t>::max();
+   uint256_t ratio = uint256_t( static_cast<uint64_t>( std::max<int64_t>( p.base.amount.value, 0 ) ) ) << 126;
+   ratio /= static_cast<uint64_t>( p.quote.amount.value );
+   low = static_cast<uint64_t>( ratio & word_mask );
+   middle = static_cast<uint64_t>( ( ratio >> 64 ) & word_mask );
+   high = static_cast<uint64_t>( ratio >> 128 );
+}
+
+limit_order_book_index::entry::entry( const limit_order_object& o )
+   : key( o.sell_price ), id( o.id ), order( &o )
+{
+}
+
+size_t limit_order_book_index::market_hash::operator()( const market_type& m )const
+{
+   return std::hash<uint64_t>()( ( m.first.instance.value << 32 ) ^ m.second.instance.value );
+}
+
+limit_order_book_index::book_type& limit_order_book_index::book_of( const limit_order_object& o )
+{
+   return _books[ std::make_pair( o.sell_asset_id(), o.receive_asset_id() ) ];
+}
+
+void limit_order_book_index::object_inserted( const object& obj )
+{
+   const auto& o = static_cast< const limit_order_object& >( obj );
+   book_of( o ).insert( entry( o ) );
+}
+
+void limit_order_book_index::object_removed( const object& obj )
+{
+   const auto& o = static_cast< const limit_order_object& >( obj );
+   book_of( o ).erase( entry( o ) );
+}
+
+void limit_order_book_index::about_to_modify( const object& before )
+{
+   _price_before = static_cast< const limit_order_object& >( before ).sell_price;
+}
+
+void limit_order_book_index::object_modified( const object& after )
+{
+   const auto& o = static_cast< const limit_order_object& >( after );
+   // filling an order only changes the amount for sale
+   if( o.sell_price.base == _price_before.base && o.sell_price.quote == _price_before.quote )
+      return;
+   entry old_entry( o );
+   old_entry.key = price_sort_key( _price_before );
+   _books[ std::make_pair( _price_before.base.asset_id, _price_before.quote.asset_id ) ].erase( old_entry );
+   book_of( o ).insert( entry( o ) );
+}
+
+const limit_order_book_index::book_type& limit_order_book_index::get_book( asset_id_type sell_asset,
+                                                                           asset_id_type receive_asset )const
+{
+   static const book_type empty_book;
+   auto itr = _books.find( std::make_pair( sell_asset, receive_asset ) );
+   return itr == _books.end() ? empty_book : itr->second;
+}
+
+size_t limit_order_book_index::memory_usage()const
+{
+   const size_t tree_node_overhead = 4 * sizeof(void*);
+   size_t result = _books.bucket_count() * sizeof(void*)
+                   + _books.size() * ( sizeof(void*) + sizeof( decltype(_books)::value_type ) );
+   for( const auto& book : _books )
+      result += book.second.size() * ( tree_node_overhead + sizeof( entry ) );
+   return result;
+}
+
+call_order_book_index::entry::entry( const call_order_object& o )
+   : key( o.collateralization() ), id( o.id ), order( &o )
+{
+}
+
+size_t call_order_book_index::market_hash::operator()( const market_type& m )const
+{
+   return std::hash<uint64_t>()( ( m.first.instance.value << 32 ) ^ m.second.instance.value );
+}
+
+call_order_book_index::market_type call_order_book_index::market_of( const call_order_object& o )
+{
+   return std::make_pair( o.debt_type(), o.collateral_type() );
+}
+
+call_order_book_index::book_type& call_order_book_index::book_of( const call_order_object& o )
+{
+   return _books[ market_of( o ) ];
+}
+
+void call_order_book_index::object_inserted( const object& obj )
+{
+   const auto& o = static_cast< const call_order_object& >( obj );
+   book_of( o ).insert( entry( o ) );
+}
+
+void call_order_book_index::object_removed( const object& obj )
+{
+   const auto& o = static_cast< const call_order_object& >( obj );
+   book_of( o ).erase( entry( o ) );
+}
+
+void call_order_book_index::about_to_modify( const object& before )
+{
+   const auto& o = static_cast< const call_order_object& >( before );
+   _market_before = market_of( o );
+   _collateral_before = o.collateral;
+   _debt_before = o.debt;
+}
+
+void call_order_book_index::object_modified( const object& after )
+{
+   const auto& o = static_cast< const call_order_object& >( after );
+   // e.g. only the call price was updated
+   if( o.collateral == _collateral_before && o.debt == _debt_before && market_of( o ) == _market_before )
+      return;
+   entry old_entry( o );
+   old_entry.key = price_sort_key( price( asset( _collateral_before, _market_before.second ),
+                                          asset( _debt_before, _market_before.first ) ) );
+   _books[ _market_before ].erase( old_entry );
+   book_of( o ).insert( entry( o ) );
+}
+
+const call_order_book_index::book_type& call_order_book_index::get_book( asset_id_type debt_asset,
+                                                                         asset_id_type collateral_asset )const
+{
+   static const book_type empty_book;
+   auto itr = _books.find( std::make_pair( debt_asset, collateral_asset ) );
+   return itr == _books.end() ? empty_book : itr->second;
+}
+
+size_t call_order_book_index::memory_usage()const
+{
+   const size_t tree_node_overhead = 4 * sizeof(void*);
+   size_t result = _books.bucket_count() * sizeof(void*)
+                   + _books.size() * ( sizeof(void*) + sizeof( decltype(_books)::value_type ) );
+   for( const auto& book : _books )
+      result += book.second.size() * ( tree_node_overhead + sizeof( entry ) );
+   return result;
+}
+
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::chain::limit_order_object,
                     (graphene::db::object),
                     (expiration)(seller)(for_sale)(sell_price)(deferred_fee)(deferred_paid_fee)
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/pending_transaction_pool.hpp>
+
+#include <fc/io/raw.hpp>
+#include <fc/uint128.hpp>
+
+#include <queue>
+
+namespace graphene { namespace chain {
+
+namespace {
+   struct get_fee_payer_visitor
+   {
+      typedef account_id_type result_type;
+      template<typename Op>
+      account_id_type operator()( const Op& op )const { return op.fee_payer(); }
+   };
+}
+
+bool pending_transaction_pool::push_back( processed_transaction trx, const transaction_id_type& id,
+                                          share_type core_fees )
+{
+   entry e;
+   e.id = id;
+   if( !trx.operations.empty() )
+      e.fee_payer = trx.operations.front().visit( get_fee_payer_visitor() );
+   e.expiration = trx.expiration;
+   e.packed_size = fc::raw::pack_size( trx );
+   if( core_fees > 0 )
+   {
+      fc::uint128_t rate = core_fees.value;
+      rate *= 1024;
+      rate /= e.packed_size;
+      e.fee_rate = static_cast<uint64_t>(rate);
+   }
+   e.sequence = _next_sequence;
+   e.trx = std::move( trx );
+
+   if( !_entries.push_back( std::move(e) ).second )
+      return false;
+   _total_size += _entries.back().packed_size;
+   ++_next_sequence;
+   return true;
+}
+
+const pending_transaction_pool::entry* pending_transaction_pool::find( const transaction_id_type& id )const
+{
+   const auto& id_idx = _entries.get<by_id>();
+   auto itr = id_idx.find( id );
+   return itr == id_idx.end() ? nullptr : &*itr;
+}
+
+bool pending_transaction_pool::remove( const transaction_id_type& id )
+{
+   auto& id_idx = _entries.get<by_id>();
+   auto itr = id_idx.find( id );
+   if( itr == id_idx.end() )
+      return false;
+   _total_size -= itr->packed_size;
+   id_idx.erase( itr );
+   return true;
+}
+
+size_t pending_transaction_pool::remove_expired( fc::time_point_sec now )
+{
+   auto& exp_idx = _entries.get<by_expiration>();
+   auto end = exp_idx.lower_bound( now );
+   size_t count = 0;
+   for( auto itr = exp_idx.begin(); itr != end; ++itr, ++count )
+      _total_size -= itr->packed_size;
+   exp_idx.erase( exp_idx.begin(), end );
+   return count;
+}
+
+vector<processed_transaction> pending_transaction_pool::release()
+{
+   vector<processed_transaction> result;
+   result.reserve( _entries.size() );
+   // the transaction itself is not part of any key, so it can be moved out before the entries are dropped
+   for( const entry& e : _entries )
+      result.push_back( std::move( const_cast<entry&>(e).trx ) );
+   clear();
+   return result;
+}
+
+void pending_transaction_pool::clear()
+{
+   _entries.clear();
+   _total_size = 0;
+}
+
+vector<const pending_transaction_pool::entry*> pending_transaction_pool::select( size_t max_size )const
+{
+   vector<const entry*> result;
+   if( _total_size <= max_size )
+   {
+      result.reserve( _entries.size() );
+      for( const entry& e : _entries )
+         result.push_back( &e );
+      return result;
+   }
+
+   // Only the first remaining transaction of each fee payer is a candidate, the best of them is taken next
+   const auto& payer_idx = _entries.get<by_fee_payer>();
+   typedef entry_index_type::index<by_fee_payer>::type::const_iterator payer_iterator;
+   auto lower_priority = []( const payer_iterator& a, const payer_iterator& b ) {
+      if( a->fee_rate != b->fee_rate )
+         return a->fee_rate < b->fee_rate;
+      return a->sequence > b->sequence;
+   };
+   std::priority_queue< payer_iterator, vector<payer_iterator>, decltype(lower_priority) > heads( lower_priority );
+   for( auto itr = payer_idx.begin(); itr != payer_idx.end(); itr = payer_idx.upper_bound( boost::make_tuple( itr->fee_payer ) ) )
+      heads.push( itr );
+
+   size_t remaining = max_size;
+   while( !heads.empty() )
+   {
+      const payer_iterator itr = heads.top();
+      heads.pop();
+      // if it does not fit, the later transactions of the same account have to wait for another block too
+      if( itr->packed_size > remaining )
+         continue;
+      remaining -= itr->packed_size;
+      result.push_back( &*itr );
+      auto next = std::next( itr );
+      if( next != payer_idx.end() && next->fee_payer == itr->fee_payer )
+         heads.push( next );
+   }
+   return result;
+}
+
+} } // graphene::chain
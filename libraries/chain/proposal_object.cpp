@@ -42,7 +42,8 @@ bool proposal_object::is_authorized_to_execute(database& db) const
                         db.get_global_properties().parameters.max_authority_depth,
                         true, /* allow committee */
                         available_active_approvals,
-                        available_owner_approvals );
+                        available_owner_approvals,
+                        &db.get_authority_check_cache() );
    } 
    catch ( const fc::exception& e )
    {
@@ -51,6 +52,43 @@ bool proposal_object::is_authorized_to_execute(database& db) const
    return true;
 }
 
+unique_ptr<object> proposal_object::undo_snapshot()const
+{
+   unique_ptr<object> result( new proposal_object() );
+   result->copy_undo_snapshot_from( *this );
+   return result;
+}
+
+void proposal_object::copy_undo_snapshot_from( const object& obj )
+{
+   const proposal_object& p = static_cast<const proposal_object&>(obj);
+   id                         = p.id;
+   expiration_time            = p.expiration_time;
+   review_period_time         = p.review_period_time;
+   proposed_transaction       = transaction();
+   required_active_approvals  = p.required_active_approvals;
+   available_active_approvals = p.available_active_approvals;
+   required_owner_approvals   = p.required_owner_approvals;
+   available_owner_approvals  = p.available_owner_approvals;
+   available_key_approvals    = p.available_key_approvals;
+   proposer                   = p.proposer;
+   fail_reason                = p.fail_reason;
+}
+
+void proposal_object::restore_undo_snapshot( object& snapshot )
+{
+   proposal_object& p = static_cast<proposal_object&>(snapshot);
+   expiration_time            = p.expiration_time;
+   review_period_time         = p.review_period_time;
+   required_active_approvals  = std::move( p.required_active_approvals );
+   available_active_approvals = std::move( p.available_active_approvals );
+   required_owner_approvals   = std::move( p.required_owner_approvals );
+   available_owner_approvals  = std::move( p.available_owner_approvals );
+   available_key_approvals    = std::move( p.available_key_approvals );
+   proposer                   = p.proposer;
+   fail_reason                = std::move( p.fail_reason );
+}
+
 void required_approval_index::object_inserted( const object& obj )
 {
     assert( dynamic_cast<const proposal_object*>(&obj) );
@@ -64,6 +102,7 @@ void required_approval_index::object_inserted( const object& obj )
        _account_to_proposals[a].insert( p.id );
     for( const auto& a : p.available_owner_approvals )
        _account_to_proposals[a].insert( p.id );
+    _account_to_proposals[p.proposer].insert( p.id );
 }
 
 void required_approval_index::remove( account_id_type a, proposal_id_type p )
@@ -90,9 +129,19 @@ void required_approval_index::object_removed( const object& obj )
        remove( a, p.id );
     for( const auto& a : p.available_owner_approvals )
        remove( a, p.id );
+    remove( p.proposer, p.id );
+}
+
+bool required_approval_index::is_related( const proposal_object& p, account_id_type a )
+{
+    return p.proposer == a
+        || p.required_active_approvals.find( a ) != p.required_active_approvals.end()
+        || p.required_owner_approvals.find( a ) != p.required_owner_approvals.end()
+        || p.available_active_approvals.find( a ) != p.available_active_approvals.end()
+        || p.available_owner_approvals.find( a ) != p.available_owner_approvals.end();
 }
 
-void required_approval_index::insert_or_remove_delta( proposal_id_type p,
+void required_approval_index::insert_or_remove_delta( const proposal_object& p,
                                                       const flat_set<account_id_type>& before,
                                                       const flat_set<account_id_type>& after )
 {
@@ -102,12 +151,13 @@ void required_approval_index::insert_or_remove_delta( proposal_id_type p,
     {
        if( a == after.end() || (b != before.end() && *b < *a) )
        {
-           remove( *b, p );
+           if( !is_related( p, *b ) )
+              remove( *b, p.id );
            ++b;
        }
        else if( b == before.end() || (a != after.end() && *a < *b) )
        {
-           _account_to_proposals[*a].insert( p );
+           _account_to_proposals[*a].insert( p.id );
            ++a;
        }
        else // *a == *b
@@ -128,8 +178,8 @@ void required_approval_index::about_to_modify( const object& before )
 void required_approval_index::object_modified( const object& after )
 {
     const proposal_object& p = static_cast<const proposal_object&>(after);
-    insert_or_remove_delta( p.id, available_active_before_modify, p.available_active_approvals );
-    insert_or_remove_delta( p.id, available_owner_before_modify,  p.available_owner_approvals );
+    insert_or_remove_delta( p, available_active_before_modify, p.available_active_approvals );
+    insert_or_remove_delta( p, available_owner_before_modify,  p.available_owner_approvals );
 }
 
 } } // graphene::chain
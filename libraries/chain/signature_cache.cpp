@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/signature_cache.hpp>
+
+#include <cstring>
+
+namespace graphene { namespace chain {
+
+size_t signature_cache::signed_digest_hash::operator()( const signed_digest& key )const
+{
+   // both are effectively random, the first byte of the signature only holds the recovery ID
+   size_t digest_part;
+   size_t sig_part;
+   std::memcpy( &digest_part, key.digest.data(), sizeof(digest_part) );
+   std::memcpy( &sig_part, key.sig.begin() + 1, sizeof(sig_part) );
+   return digest_part ^ sig_part;
+}
+
+public_key_type signature_cache::recover( const signature_type& sig, const digest_type& digest )
+{
+   signed_digest key{ digest, sig };
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      auto& by_key = _entries.get<1>();
+      auto itr = by_key.find( key );
+      if( itr != by_key.end() )
+      {
+         _entries.relocate( _entries.begin(), _entries.project<0>( itr ) );
+         return itr->public_key;
+      }
+      if( _capacity == 0 )
+         return fc::ecc::public_key( sig, digest );
+   }
+
+   public_key_type result = fc::ecc::public_key( sig, digest );
+
+   std::lock_guard<std::mutex> lock( _mutex );
+   // another thread may have recovered the same key in the meantime, then it stays where it is
+   _entries.push_front( entry{ std::move(key), result } );
+   trim();
+   return result;
+}
+
+void signature_cache::recover( vector<request>& requests )
+{
+   vector<size_t> missing;
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      const auto& by_key = _entries.get<1>();
+      for( size_t i = 0; i < requests.size(); ++i )
+      {
+         auto itr = _capacity > 0 ? by_key.find( signed_digest{ requests[i].digest, requests[i].sig } )
+                                  : by_key.end();
+         if( itr != by_key.end() )
+         {
+            _entries.relocate( _entries.begin(), _entries.project<0>( itr ) );
+            requests[i].key = itr->public_key;
+         }
+         else
+            missing.push_back( i );
+      }
+   }
+   if( missing.empty() )
+      return;
+
+   for( size_t i : missing )
+      requests[i].key = fc::ecc::public_key( requests[i].sig, requests[i].digest );
+
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( _capacity == 0 )
+      return;
+   for( size_t i : missing )
+      _entries.push_front( entry{ signed_digest{ requests[i].digest, requests[i].sig }, requests[i].key } );
+   trim();
+}
+
+void signature_cache::set_capacity( size_t capacity )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _capacity = capacity;
+   trim();
+}
+
+size_t signature_cache::size()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _entries.size();
+}
+
+void signature_cache::trim()
+{
+   while( _entries.size() > _capacity )
+      _entries.pop_back();
+}
+
+} } // graphene::chain
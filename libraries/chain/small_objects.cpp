@@ -133,7 +133,7 @@ FC_REFLECT_DERIVED_NO_TYPENAME( graphene::chain::operation_history_object, (grap
                     (op)(result)(block_num)(trx_in_block)(op_in_trx)(virtual_op) )
 
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::chain::account_transaction_history_object, (graphene::chain::object),
-                    (account)(operation_id)(sequence)(next) )
+                    (account)(operation_id)(sequence)(next)(operation_type) )
 
 FC_REFLECT_DERIVED_NO_TYPENAME(
    graphene::chain::special_authority_object,
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/transaction_history_object.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace chain {
+
+static const size_t min_table_size = 64;
+
+size_t recent_transaction_index::home_slot( const transaction_id_type& id )const
+{
+   return std::hash<transaction_id_type>()( id ) & ( _table.size() - 1 );
+}
+
+const transaction_history_object* recent_transaction_index::find( const transaction_id_type& id )const
+{
+   if( _table.empty() )
+      return nullptr;
+   const size_t mask = _table.size() - 1;
+   for( size_t i = home_slot( id ); _table[i].obj != nullptr; i = ( i + 1 ) & mask )
+      if( _table[i].id == id )
+         return _table[i].obj;
+   return nullptr;
+}
+
+const transaction_history_object* recent_transaction_index::find_expired( time_point_sec now )const
+{
+   if( _buckets.empty() || _first_expiration >= now.sec_since_epoch() )
+      return nullptr;
+   return _buckets.front().back();
+}
+
+void recent_transaction_index::resize_table( size_t new_size )
+{
+   vector<slot> old_table( new_size );
+   _table.swap( old_table );
+   const size_t mask = _table.size() - 1;
+   for( const auto& s : old_table )
+      if( s.obj != nullptr )
+      {
+         size_t i = home_slot( s.id );
+         while( _table[i].obj != nullptr )
+            i = ( i + 1 ) & mask;
+         _table[i] = s;
+      }
+}
+
+void recent_transaction_index::insert( const transaction_history_object& obj )
+{
+   if( ( _count + 1 ) * 2 > _table.size() )
+      resize_table( std::max( min_table_size, _table.size() * 2 ) );
+   const size_t mask = _table.size() - 1;
+   size_t i = home_slot( obj.trx_id );
+   while( _table[i].obj != nullptr )
+      i = ( i + 1 ) & mask;
+   _table[i].id = obj.trx_id;
+   _table[i].obj = &obj;
+   ++_count;
+
+   const uint32_t expiration = obj.get_expiration().sec_since_epoch();
+   if( _buckets.empty() )
+      _first_expiration = expiration;
+   else if( expiration < _first_expiration )
+   {
+      _buckets.insert( _buckets.begin(), _first_expiration - expiration, vector<const transaction_history_object*>() );
+      _first_expiration = expiration;
+   }
+   if( expiration - _first_expiration >= _buckets.size() )
+      _buckets.resize( expiration - _first_expiration + 1 );
+   _buckets[ expiration - _first_expiration ].push_back( &obj );
+}
+
+void recent_transaction_index::remove( const transaction_history_object& obj )
+{
+   FC_ASSERT( !_table.empty(), "Transaction ${id} is not indexed", ("id",obj.trx_id) );
+   const size_t mask = _table.size() - 1;
+   size_t gap = home_slot( obj.trx_id );
+   while( _table[gap].obj != &obj )
+   {
+      FC_ASSERT( _table[gap].obj != nullptr, "Transaction ${id} is not indexed", ("id",obj.trx_id) );
+      gap = ( gap + 1 ) & mask;
+   }
+   // Move later entries of the probe sequence into the gap, unless that would place them before their home slot
+   for( size_t i = ( gap + 1 ) & mask; _table[i].obj != nullptr; i = ( i + 1 ) & mask )
+      if( ( ( i - home_slot( _table[i].id ) ) & mask ) >= ( ( i - gap ) & mask ) )
+      {
+         _table[gap] = _table[i];
+         gap = i;
+      }
+   _table[gap] = slot();
+   --_count;
+   if( _table.size() > min_table_size && _count * 8 < _table.size() )
+      resize_table( _table.size() / 2 );
+
+   const uint32_t expiration = obj.get_expiration().sec_since_epoch();
+   FC_ASSERT( expiration >= _first_expiration && expiration - _first_expiration < _buckets.size() );
+   auto& bucket = _buckets[ expiration - _first_expiration ];
+   // expired transactions are removed starting with the last one in the bucket
+   auto itr = std::find( bucket.rbegin(), bucket.rend(), &obj );
+   FC_ASSERT( itr != bucket.rend() );
+   *itr = bucket.back();
+   bucket.pop_back();
+   while( !_buckets.empty() && _buckets.front().empty() )
+   {
+      _buckets.pop_front();
+      ++_first_expiration;
+   }
+   while( !_buckets.empty() && _buckets.back().empty() )
+      _buckets.pop_back();
+}
+
+void recent_transaction_index::object_inserted( const object& obj )
+{
+   insert( static_cast<const transaction_history_object&>( obj ) );
+}
+
+void recent_transaction_index::object_removed( const object& obj )
+{
+   remove( static_cast<const transaction_history_object&>( obj ) );
+}
+
+void recent_transaction_index::about_to_modify( const object& before )
+{
+   remove( static_cast<const transaction_history_object&>( before ) );
+}
+
+void recent_transaction_index::object_modified( const object& after )
+{
+   insert( static_cast<const transaction_history_object&>( after ) );
+}
+
+size_t recent_transaction_index::memory_usage()const
+{
+   size_t result = _table.capacity() * sizeof(slot) + _buckets.size() * sizeof(_buckets.front());
+   for( const auto& bucket : _buckets )
+      result += bucket.capacity() * sizeof(bucket.front());
+   return result;
+}
+
+} } // graphene::chain
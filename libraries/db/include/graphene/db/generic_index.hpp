@@ -27,6 +27,8 @@
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/mem_fun.hpp>
+#include <boost/mpl/size.hpp>
+#include <boost/pool/pool_alloc.hpp>
 
 namespace graphene { namespace db {
 
@@ -34,6 +36,16 @@ namespace graphene { namespace db {
    using namespace boost::multi_index;
 
    struct by_id;
+
+   /**
+    *  Allocator for the multi_index containers of indexes whose objects are created and removed all the time.
+    *  Nodes are cut from larger blocks shared by all nodes of the same size instead of being allocated one by one,
+    *  which keeps them closer together and stops them from fragmenting the heap. The memory of removed nodes is
+    *  kept for the next ones.
+    */
+   template< typename T >
+   using node_pool_allocator = boost::fast_pool_allocator< T >;
+
    /**
     *  Almost all objects can be tracked and managed via a boost::multi_index container that uses
     *  an unordered_unique key on the object ID.  This template class adapts the generic index interface
@@ -110,6 +122,18 @@ namespace graphene { namespace db {
             } FC_CAPTURE_AND_RETHROW()
          }
 
+         virtual size_t object_count()const override
+         {
+            return _indices.size();
+         }
+
+         /** assumes ordered indices, i.e. three pointers per node and index */
+         virtual size_t memory_usage()const override
+         {
+            const size_t index_count = boost::mpl::size< typename MultiIndexType::index_type_list >::value;
+            return _indices.size() * ( sizeof(ObjectType) + index_count * 3 * sizeof(void*) );
+         }
+
          const index_type& indices()const { return _indices; }
 
       private:
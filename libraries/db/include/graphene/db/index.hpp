@@ -27,10 +27,12 @@
 #include <fc/interprocess/file_mapping.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/io/json.hpp>
+#include <fc/crypto/city.hpp>
 #include <fc/crypto/sha256.hpp>
 
 #include <fstream>
 #include <stack>
+#include <unordered_map>
 
 namespace graphene { namespace db {
    class object_database;
@@ -52,6 +54,15 @@ namespace graphene { namespace db {
          virtual void on_modify( const object& obj ){}
    };
 
+   /** The hash of the objects of an index with instances in [first, last), @see index::digest_ranges */
+   struct object_range_digest
+   {
+      uint64_t   first = 0;
+      uint64_t   last = 0;
+      uint64_t   count = 0; ///< number of objects in the range
+      fc::sha256 digest;    ///< of the instances and packed objects in the range, in ID order
+   };
+
    /**
     *  @class index
     *  @brief abstract base class for accessing objects indexed in various ways.
@@ -98,7 +109,14 @@ namespace graphene { namespace db {
           */
          virtual void open( const fc::path& db ) = 0;
          virtual void save( const fc::path& db ) = 0;
+         /** Writes the same file as save(), but leaves has_unsaved_changes() untouched */
+         virtual void save_copy( const fc::path& db )const = 0;
 
+         /**
+          *  @return true if objects or the next ID of this index have changed since it was
+          *  last opened or saved, i.e. if the file written by save() would differ from the last one
+          */
+         virtual bool has_unsaved_changes()const = 0;
 
 
          /** @return the object with id or nullptr if not found */
@@ -132,8 +150,31 @@ namespace graphene { namespace db {
          virtual void               inspect_all_objects(std::function<void(const object&)> inspector)const = 0;
          virtual void               add_observer( const shared_ptr<index_observer>& ) = 0;
 
+         /** @return the number of objects in this index */
+         virtual size_t             object_count()const
+         {
+            size_t count = 0;
+            inspect_all_objects( [&count]( const object& ) { ++count; } );
+            return count;
+         }
+         /**
+          *  @return approximate number of bytes allocated by this index for storing its objects, including
+          *  container overhead but not memory owned by members of the objects, or 0 if unknown
+          */
+         virtual size_t             memory_usage()const { return 0; }
+
          virtual void               object_from_variant( const fc::variant& var, object& obj, uint32_t max_depth )const = 0;
          virtual void               object_default( object& obj )const = 0;
+
+         /**
+          *  Splits the instances [first, last) into at most parts ranges of equal size and hashes the objects of
+          *  each. Two databases split the same range in the same way, so comparing the digests and descending
+          *  into the ranges that differ locates the differing objects in a logarithmic number of rounds.
+          *  @param last the end of the range, 0 for the next instance of the index
+          *  @param lookup finds the object to hash by ID, defaults to find()
+          */
+         vector<object_range_digest> digest_ranges( uint64_t first, uint64_t last, uint32_t parts,
+               const std::function<const object*( object_id_type )>& lookup = nullptr )const;
    };
 
    class secondary_index
@@ -144,6 +185,59 @@ namespace graphene { namespace db {
          virtual void object_removed( const object& obj ){};
          virtual void about_to_modify( const object& before ){};
          virtual void object_modified( const object& after  ){};
+         /** @return approximate number of bytes allocated by this index, or 0 if unknown */
+         virtual size_t memory_usage()const { return 0; }
+   };
+
+   /**
+    * @class batched_secondary_index
+    * @brief A secondary index that processes changes in batches instead of one at a time
+    *
+    * Changes of the primary index are only recorded. When flush_changes() is called, apply_change() is
+    * invoked once per changed object with its value as of the previous flush and its current value, no
+    * matter how often the object was modified in between.
+    *
+    * This is only suitable for secondary indexes that are not queried while blocks or transactions are
+    * being applied. Readers must call object_database::apply_batched_index_changes() first.
+    */
+   class batched_secondary_index : public secondary_index
+   {
+      public:
+         explicit batched_secondary_index( const index* primary ) : _primary( *primary ) {}
+         virtual ~batched_secondary_index(){}
+
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+
+         /** Processes all changes recorded since the last call */
+         void flush_changes();
+         /** @return number of objects with unprocessed changes */
+         size_t pending_changes()const { return _pending.size(); }
+
+         /**
+          * Stops recording changes until rebuild() is called, e.g. while replaying the chain.
+          * The content of the index is meaningless in the meantime.
+          */
+         void suspend();
+         bool is_suspended()const { return _suspended; }
+         /** Discards the content of the index and builds it again from all objects in the primary index */
+         void rebuild();
+
+      protected:
+         /**
+          * @param before value of the object as of the previous flush, or nullptr if it did not exist
+          * @param after current value of the object, or nullptr if it does not exist anymore
+          */
+         virtual void apply_change( const object* before, const object* after ) = 0;
+         /** Removes all content, called by rebuild() */
+         virtual void clear() = 0;
+
+      private:
+         const index& _primary;
+         bool         _suspended = false;
+         /** copies of changed objects as of the previous flush, nullptr for objects that did not exist */
+         std::unordered_map< object_id_type, unique_ptr<object> > _pending;
    };
 
    /**
@@ -173,6 +267,15 @@ namespace graphene { namespace db {
             return static_cast<T*>(_sindex.back().get());
          }
 
+         /** Processes the recorded changes of all batched secondary indexes of this index */
+         void flush_batched_secondary_indexes();
+         /** @return sum of secondary_index::memory_usage() over all secondary indexes of this index */
+         size_t secondary_index_memory_usage()const;
+         /** @see batched_secondary_index::suspend */
+         void suspend_batched_secondary_indexes();
+         /** Rebuilds all suspended batched secondary indexes of this index */
+         void rebuild_batched_secondary_indexes();
+
          template<typename T>
          const T& get_secondary_index()const
          {
@@ -187,6 +290,8 @@ namespace graphene { namespace db {
       protected:
          vector< shared_ptr<index_observer> >   _observers;
          vector< unique_ptr<secondary_index> >  _sindex;
+         /** set whenever an object is added, modified or removed, cleared on open and save */
+         bool                                   _unsaved_changes = false;
 
       private:
          object_database& _db;
@@ -252,6 +357,12 @@ namespace graphene { namespace db {
             content[instance >> chunkbits][instance & _mask] = static_cast<const Object*>( &obj );
          }
 
+         virtual size_t memory_usage()const override
+         {
+            return content.capacity() * sizeof( vector< const Object* > )
+                   + content.size() * ( size_t(1) << chunkbits ) * sizeof( const Object* );
+         }
+
          virtual void object_removed( const object& obj )
          {
             FC_ASSERT( nullptr != dynamic_cast<const Object*>(&obj), "Wrong object type!" );
@@ -303,6 +414,10 @@ namespace graphene { namespace db {
     * @brief  Wraps a derived index to intercept calls to create, modify, and remove so that
     *  callbacks may be fired and undo state saved.
     *
+    *  If DirectBits is non-zero, lookups by ID are served by a @ref direct_index with chunks of
+    *  2^DirectBits entries instead of the derived index. This turns find() into an array access and
+    *  should be used for objects with dense IDs that are rarely or never removed.
+    *
     *  @see http://en.wikipedia.org/wiki/Curiously_recurring_template_pattern
     */
    template<typename DerivedIndex, uint8_t DirectBits = 0>
@@ -325,8 +440,16 @@ namespace graphene { namespace db {
          { return object_type::type_id; }
 
          virtual object_id_type get_next_id()const override              { return _next_id;    }
-         virtual void           use_next_id()override                    { ++_next_id.number;  }
-         virtual void           set_next_id( object_id_type id )override { _next_id = id;      }
+         virtual void           use_next_id()override
+         {
+            ++_next_id.number;
+            _unsaved_changes = true;
+         }
+         virtual void           set_next_id( object_id_type id )override
+         {
+            if( id != _next_id ) _unsaved_changes = true;
+            _next_id = id;
+         }
 
          /** @return the object with id or nullptr if not found */
          virtual const object*  find( object_id_type id )const override
@@ -342,6 +465,21 @@ namespace graphene { namespace db {
             return fc::sha256::hash(desc);
          }
 
+         /**
+          *  Identifies the layout of files written by save(): the next ID, the file version, the object version
+          *  and a sequence of chunks. Each chunk consists of its size, its checksum and length-prefixed packed
+          *  objects.
+          *  Files written before chunks were introduced have the object version right after the next ID and
+          *  contain nothing but length-prefixed packed objects after that. They can still be opened.
+          */
+         static fc::sha256 get_file_version()
+         {
+            return fc::sha256::hash( std::string( "chunked-1" ) );
+         }
+
+         /** save() starts a new chunk as soon as the current one exceeds this many bytes */
+         static const uint32_t save_chunk_size = 1024 * 1024;
+
          virtual void open( const path& db )override
          { 
             if( !fc::exists( db ) ) return;
@@ -352,33 +490,76 @@ namespace graphene { namespace db {
 
             fc::raw::unpack(ds, _next_id);
             fc::raw::unpack(ds, open_ver);
-            FC_ASSERT( open_ver == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
-            vector<char> tmp;
-            while( ds.remaining() > 0 )
+            if( open_ver == get_object_version() ) // no chunks
+               load_objects( ds, db );
+            else
             {
-               fc::raw::unpack( ds, tmp );
-               load( tmp );
+               FC_ASSERT( open_ver == get_file_version(), "Unknown format of index file ${f}", ("f",db) );
+               fc::raw::unpack(ds, open_ver);
+               FC_ASSERT( open_ver == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
+               while( ds.remaining() > 0 )
+               {
+                  uint32_t size;
+                  uint64_t checksum;
+                  fc::raw::unpack( ds, size );
+                  fc::raw::unpack( ds, checksum );
+                  FC_ASSERT( size <= ds.remaining(), "Truncated chunk in index file ${f}", ("f",db) );
+                  FC_ASSERT( fc::city_hash64( ds.pos(), size ) == checksum, "Corrupted chunk in index file ${f}", ("f",db) );
+                  fc::datastream<const char*> chunk_ds( ds.pos(), size );
+                  load_objects( chunk_ds, db );
+                  ds.skip( size );
+               }
             }
+            _unsaved_changes = false;
+         }
+
+         virtual void save( const path& db ) override
+         {
+            save_copy( db );
+            _unsaved_changes = false;
          }
 
-         virtual void save( const path& db ) override 
+         virtual void save_copy( const path& db )const override
          {
             std::ofstream out( db.generic_string(), 
                                std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
             FC_ASSERT( out );
-            auto ver  = get_object_version();
             fc::raw::pack( out, _next_id );
-            fc::raw::pack( out, ver );
+            fc::raw::pack( out, get_file_version() );
+            fc::raw::pack( out, get_object_version() );
+            std::vector<char> chunk;
+            const auto write_chunk = [&out,&chunk]() {
+               const uint32_t size = chunk.size();
+               const uint64_t checksum = fc::city_hash64( chunk.data(), chunk.size() );
+               fc::raw::pack( out, size );
+               fc::raw::pack( out, checksum );
+               out.write( chunk.data(), chunk.size() );
+               chunk.clear();
+            };
             this->inspect_all_objects( [&]( const object& o ) {
                 auto vec = fc::raw::pack( static_cast<const object_type&>(o) );
                 auto packed_vec = fc::raw::pack( vec );
-                out.write( packed_vec.data(), packed_vec.size() );
+                chunk.insert( chunk.end(), packed_vec.begin(), packed_vec.end() );
+                if( chunk.size() >= save_chunk_size )
+                   write_chunk();
             });
+            if( !chunk.empty() )
+               write_chunk();
+            out.close();
+            FC_ASSERT( out, "Failed to write index file ${f}", ("f",db) );
          }
 
+         virtual bool has_unsaved_changes()const override { return _unsaved_changes; }
+
          virtual const object&  load( const std::vector<char>& data )override
          {
-            const auto& result = DerivedIndex::insert( fc::raw::unpack<object_type>( data ) );
+            return load( fc::raw::unpack<object_type>( data ) );
+         }
+
+         /** Inserts an already deserialized object without firing observers or saving undo state */
+         const object&  load( object_type&& obj )
+         {
+            const auto& result = DerivedIndex::insert( std::move( obj ) );
             for( const auto& item : _sindex )
                item->object_inserted( result );
             return result;
@@ -446,8 +627,26 @@ namespace graphene { namespace db {
          }
 
       private:
+         /** Loads length-prefixed packed objects until the end of ds */
+         void load_objects( fc::datastream<const char*>& ds, const path& db )
+         {
+            while( ds.remaining() > 0 )
+            {
+               fc::unsigned_int size;
+               fc::raw::unpack( ds, size );
+               FC_ASSERT( size.value <= ds.remaining(), "Truncated object in index file ${f}", ("f",db) );
+               fc::datastream<const char*> obj_ds( ds.pos(), size.value );
+               object_type obj;
+               fc::raw::unpack( obj_ds, obj );
+               ds.skip( size.value );
+               load( std::move( obj ) );
+            }
+         }
+
          object_id_type                                 _next_id;
          const direct_index< object_type, DirectBits >* _direct_by_id = nullptr;
    };
 
 } } // graphene::db
+
+FC_REFLECT( graphene::db::object_range_digest, (first)(last)(count)(digest) )
@@ -72,11 +72,36 @@ namespace graphene { namespace db {
          // serialized
          object_id_type          id;
 
+         /// not serialized, @see object_database::set_modification_stamp
+         uint32_t                modification_stamp = 0;
+         /// not serialized, @see object_database::get_object_version
+         uint32_t                revision = 0;
+
          /// these methods are implemented for derived classes by inheriting abstract_object<DerivedClass>
          virtual unique_ptr<object> clone()const = 0;
+         /// obj must be of the same derived type as this object
+         virtual void               copy_from( const object& obj ) = 0;
          virtual void               move_from( object& obj ) = 0;
          virtual variant            to_variant()const  = 0;
          virtual vector<char>       pack()const = 0;
+         /// Size of the most derived type, not including memory owned by its members
+         virtual size_t             object_size()const { return sizeof( object ); }
+
+         /**
+          *  Undo snapshots are the copies the undo_database keeps of modified objects. Derived classes may
+          *  override these three methods together to leave out members that never change after creation,
+          *  so that the cost of saving undo state does not scale with the size of such members.
+          *
+          *  A snapshot is only ever restored onto the object it was taken from.
+          */
+         ///@{
+         /// @return a snapshot of this object
+         virtual unique_ptr<object> undo_snapshot()const { return clone(); }
+         /// Turns this object into a snapshot of obj (both are of the same derived type)
+         virtual void               copy_undo_snapshot_from( const object& obj ) { copy_from( obj ); }
+         /// Restores the state saved in snapshot onto this object, snapshot may be left in an unspecified state
+         virtual void               restore_undo_snapshot( object& snapshot ) { move_from( snapshot ); }
+         ///@}
    };
 
    /**
@@ -95,12 +120,18 @@ namespace graphene { namespace db {
             return unique_ptr<object>(new DerivedClass( *static_cast<const DerivedClass*>(this) ));
          }
 
+         virtual void    copy_from( const object& obj )
+         {
+            static_cast<DerivedClass&>(*this) = static_cast<const DerivedClass&>(obj);
+         }
+
          virtual void    move_from( object& obj )
          {
             static_cast<DerivedClass&>(*this) = std::move( static_cast<DerivedClass&>(obj) );
          }
          virtual variant to_variant()const { return variant( static_cast<const DerivedClass&>(*this), MAX_NESTING ); }
          virtual vector<char> pack()const  { return fc::raw::pack( static_cast<const DerivedClass&>(*this) ); }
+         virtual size_t  object_size()const { return sizeof( DerivedClass ); }
    };
 
    typedef flat_map<uint8_t, object_id_type> annotation_map;
@@ -27,11 +27,30 @@
 #include <graphene/db/undo_database.hpp>
 
 #include <fc/log/logger.hpp>
+#include <fc/thread/parallel.hpp>
+#include <fc/thread/thread.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <future>
 #include <map>
+#include <mutex>
+#include <set>
 
 namespace graphene { namespace db {
 
+   /** Approximate memory consumption of one index, @see object_database::get_memory_usage */
+   struct index_memory_usage
+   {
+      uint8_t  space_id              = 0;
+      uint8_t  type_id               = 0;
+      uint64_t object_count          = 0;
+      /** @see index::memory_usage */
+      uint64_t object_bytes          = 0;
+      /** sum over all secondary indexes, @see secondary_index::memory_usage */
+      uint64_t secondary_index_bytes = 0;
+   };
+
    /**
     *   @class object_database
     *   @brief maintains a set of indexed objects that can be modified with multi-level rollback support
@@ -42,14 +61,50 @@ namespace graphene { namespace db {
          object_database();
          ~object_database();
 
-         void reset_indexes() { _index.clear(); _index.resize(255); }
+         void reset_indexes()
+         {
+            wait_for_background_loads();
+            _index.clear();
+            _index.resize(255);
+            _lookup.assign( _lookup.size(), index_lookup() );
+            _current_checkpoint_valid = false;
+         }
 
          void open(const fc::path& data_dir );
 
          /**
-          * Saves the complete state of the object_database to disk, this could take a while
+          * Makes open() load the index of the given space and type in the background instead of before it returns.
+          * The marked indexes are loaded one after another in one OS thread, in the order of their space and type,
+          * so that secondary indexes referring to an earlier one see it complete.
+          *
+          * get_index(), get_mutable_index() and the typed getters block the calling thread until the indexes are
+          * loaded, without yielding to other fibers. Code holding pointers to these indexes must call
+          * wait_for_background_loads() before using them, the chain database does so before applying a block.
+          * Must be called after the index is added and before open().
+          */
+         void load_in_background( uint8_t space_id, uint8_t type_id );
+         /**
+          * Blocks the calling thread until the indexes open() loads in the background are loaded, rethrows their
+          * errors. Does not yield, so the state cannot change while waiting.
+          */
+         void wait_for_background_loads()const
+         {
+            if( _background_load_pending.load( std::memory_order_acquire ) )
+               join_background_load();
+         }
+
+         /**
+          * Saves the complete state of the object_database to disk, this could take a while.
+          *
+          * Indexes without changes since the last open() or flush() are not serialized again,
+          * their files from the previous checkpoint are hard-linked into the new one.
           */
          void flush();
+         /**
+          * Writes all indexes to dir, in the same layout as the object_database directory that open() reads.
+          * Unlike flush(), this does not affect the checkpoint in the data directory.
+          */
+         void save_copy( const fc::path& dir )const;
          void wipe(const fc::path& data_dir); // remove from disk
          void close();
 
@@ -61,6 +116,8 @@ namespace graphene { namespace db {
             {
                assert( dynamic_cast<T*>(&o) );
                constructor( static_cast<T&>(o) );
+               o.modification_stamp = _modification_stamp;
+               o.revision = next_revision();
             } ));
          }
 
@@ -84,11 +141,51 @@ namespace graphene { namespace db {
          /// in order to maintain proper undo history.
          ///@{
 
-         const object& insert( object&& obj ) { return get_mutable_index(obj.id).insert( std::move(obj) ); }
+         const object& insert( object&& obj )
+         {
+            obj.modification_stamp = _modification_stamp;
+            obj.revision = next_revision();
+            return get_mutable_index(obj.id).insert( std::move(obj) );
+         }
          void          remove( const object& obj ) { get_mutable_index(obj.id).remove( obj ); }
          template<typename T, typename Lambda>
          void modify( const T& obj, const Lambda& m ) {
-            get_mutable_index(obj.id).modify(obj,m);
+            const uint32_t stamp = _modification_stamp;
+            const uint32_t revision = next_revision();
+            get_mutable_index(obj.id).modify( obj, [&m,stamp,revision]( T& o ) {
+               m( o );
+               o.modification_stamp = stamp;
+               o.revision = revision;
+            });
+         }
+
+         /**
+          * Objects created, modified or re-inserted by the undo database from now on are stamped with stamp, the
+          * chain database sets it to the number of the block being applied. The stamp never decreases, so that
+          * it can be compared with the stamps handed out before, also across a switch to another fork.
+          */
+         void     set_modification_stamp( uint32_t stamp ) { _modification_stamp = std::max( _modification_stamp, stamp ); }
+         uint32_t get_modification_stamp()const { return _modification_stamp; }
+         /**
+          * @return the stamp obj was last created or modified with. Objects loaded by open() are not stamped, for
+          * them the stamp passed to set_loaded_objects_stamp is returned.
+          */
+         uint32_t get_modification_stamp( const object& obj )const
+         {
+            return std::max( obj.modification_stamp, _loaded_objects_stamp );
+         }
+         /// Sets the stamp of the objects loaded from disk, which may have changed any time before they were saved
+         void     set_loaded_objects_stamp( uint32_t stamp ) { _loaded_objects_stamp = stamp; }
+         /**
+          * @return a version of obj that changes whenever obj is created, modified or restored by the undo database.
+          * It combines the modification stamp with a revision counted over all writes, so two different states of
+          * an object never have the same version within a run, also across a switch to another fork. The revisions
+          * of a run start from the time open() was called, which makes a version seen before a restart unlikely to
+          * repeat after it, but as the revisions are not persisted this is not guaranteed.
+          */
+         uint64_t get_object_version( const object& obj )const
+         {
+            return ( uint64_t( get_modification_stamp( obj ) ) << 32 ) | obj.revision;
          }
 
          ///@}
@@ -121,14 +218,23 @@ namespace graphene { namespace db {
             return static_cast<const T*>(obj);
          }
 
+         /**
+          * Typed lookups are served by the lookup table filled in add_index(), which calls the find() of the
+          * concrete index type directly instead of going through get_index() and the virtual index::find().
+          */
          template<uint8_t SpaceID, uint8_t TypeID>
          auto find( object_id<SpaceID,TypeID> id )const -> const object_downcast_t<decltype(id)>* {
-             return find<object_downcast_t<decltype(id)>>(id);
+             typedef object_downcast_t<decltype(id)> T;
+             const object* obj = find_typed( SpaceID, TypeID, id );
+             assert(  !obj || nullptr != dynamic_cast<const T*>(obj) );
+             return static_cast<const T*>(obj);
          }
 
          template<uint8_t SpaceID, uint8_t TypeID>
          auto get( object_id<SpaceID,TypeID> id )const -> const object_downcast_t<decltype(id)>& {
-             return get<object_downcast_t<decltype(id)>>(id);
+             const auto* obj = find( id );
+             FC_ASSERT( obj != nullptr, "Unable to find Object ${id}", ("id",id) );
+             return *obj;
          }
 
          template<typename IndexType>
@@ -140,7 +246,14 @@ namespace graphene { namespace db {
             assert(!_index[ObjectType::space_id][ObjectType::type_id]);
             unique_ptr<index> indexptr( new IndexType(*this) );
             _index[ObjectType::space_id][ObjectType::type_id] = std::move(indexptr);
-            return static_cast<IndexType*>(_index[ObjectType::space_id][ObjectType::type_id].get());
+            IndexType* result = static_cast<IndexType*>(_index[ObjectType::space_id][ObjectType::type_id].get());
+            if( ObjectType::space_id < max_lookup_spaces )
+            {
+               index_lookup& lookup = _lookup[ lookup_slot( ObjectType::space_id, ObjectType::type_id ) ];
+               lookup.idx = result;
+               lookup.find = &find_in_index<IndexType>;
+            }
+            return result;
          }
 
          template<typename IndexType, typename SecondaryIndexType, typename... Args>
@@ -151,8 +264,58 @@ namespace graphene { namespace db {
 
          void pop_undo();
 
+         /** Processes the recorded changes of all batched secondary indexes, @see batched_secondary_index */
+         void apply_batched_index_changes();
+         /** @return approximate memory consumption of all registered indexes */
+         vector< index_memory_usage > get_memory_usage()const;
+
+         /** Stops maintaining all batched secondary indexes until rebuild_batched_indexes() is called */
+         void suspend_batched_indexes();
+         /** Rebuilds all suspended batched secondary indexes from their primary indexes, in parallel */
+         void rebuild_batched_indexes();
+
          fc::path get_data_dir()const { return _data_dir; }
 
+         /**
+          * Sets the number of threads writing indexes to disk in flush(), save_copy() and run_in_background().
+          * With 0, the default, that work goes through fc::do_parallel, where it is queued together with the
+          * precomputation of blocks and transactions. Must not be called while background tasks are running.
+          */
+         void set_background_threads( uint16_t num_threads );
+         uint16_t get_background_threads()const { return static_cast<uint16_t>( _background_threads.size() ); }
+
+         /** Runs f in one of the background threads, or through fc::do_parallel if there are none */
+         template<typename Functor>
+         auto run_in_background( Functor&& f, const char* desc = "background task" )const
+            -> fc::future<decltype( f() )>
+         {
+            if( _background_threads.empty() )
+               return fc::do_parallel( std::forward<Functor>( f ), desc );
+            const size_t index = _next_background_thread++ % _background_threads.size();
+            return _background_threads[index]->async( std::forward<Functor>( f ), desc );
+         }
+
+         /**
+          * Like run_in_background(), but waiting for the returned future blocks the OS thread instead of yielding
+          * to other fibers. For work in the middle of applying a block, where nothing else may run on the chain
+          * thread. f must not need the calling thread.
+          */
+         template<typename Functor>
+         std::future<void> run_in_background_blocking( Functor&& f, const char* desc = "background task" )const
+         {
+            auto done = std::make_shared< std::promise<void> >();
+            std::future<void> result = done->get_future();
+            run_in_background( [task = std::forward<Functor>( f ),done] () mutable {
+               try {
+                  task();
+                  done->set_value();
+               } catch( ... ) {
+                  done->set_exception( std::current_exception() );
+               }
+            }, desc );
+            return result;
+         }
+
          /** public for testing purposes only... should be private in practice. */
          undo_database                          _undo_db;
      protected:
@@ -167,6 +330,51 @@ namespace graphene { namespace db {
          index& get_mutable_index(uint8_t space_id, uint8_t type_id);
 
      private:
+         /// Objects with a space_id below this are looked up through _lookup by the typed find() and get()
+         static const uint8_t max_lookup_spaces = 16;
+
+         /// A registered index together with a non-virtual lookup function for its concrete type
+         struct index_lookup
+         {
+            const index* idx = nullptr;
+            const object* (*find)( const index&, object_id_type ) = nullptr;
+         };
+
+         template<typename IndexType>
+         static const object* find_in_index( const index& idx, object_id_type id )
+         {
+            return static_cast<const IndexType&>( idx ).IndexType::find( id );
+         }
+
+         static size_t lookup_slot( uint8_t space_id, uint8_t type_id ) { return ( size_t(space_id) << 8 ) | type_id; }
+
+         const object* find_typed( uint8_t space_id, uint8_t type_id, object_id_type id )const
+         {
+            // while indexes are loaded in the background, get_index() has to check whether this one is among them
+            if( space_id < max_lookup_spaces && !_background_load_pending.load( std::memory_order_acquire ) )
+            {
+               const index_lookup& lookup = _lookup[ lookup_slot( space_id, type_id ) ];
+               if( lookup.find != nullptr )
+                  return lookup.find( *lookup.idx, id );
+            }
+            return get_index( space_id, type_id ).find( id );
+         }
+
+         /// Blocks until the index is loaded if it is loaded in the background, @see load_in_background
+         void wait_for_load( uint8_t space_id, uint8_t type_id )const
+         {
+            if( _background_load_pending.load( std::memory_order_acquire )
+                  && _background_load_slots.count( lookup_slot( space_id, type_id ) ) > 0 )
+               join_background_load();
+         }
+         void join_background_load()const;
+
+         uint32_t next_revision()
+         {
+            if( ++_last_revision == 0 )
+               ++_last_revision;
+            return _last_revision;
+         }
 
          friend class base_primary_index;
          friend class undo_database;
@@ -176,8 +384,28 @@ namespace graphene { namespace db {
 
          fc::path                                                  _data_dir;
          vector< vector< unique_ptr<index> > >                     _index;
+         /// flat by lookup_slot(), sized for max_lookup_spaces in the constructor, @see add_index
+         vector< index_lookup >                                    _lookup;
+         /// true if the files in _data_dir/object_database match the in-memory state of all unchanged indexes
+         bool                                                      _current_checkpoint_valid = false;
+         /// @see set_background_threads
+         vector< std::shared_ptr<fc::thread> >                     _background_threads;
+         mutable std::atomic<uint32_t>                             _next_background_thread{ 0 };
+         /// @see set_modification_stamp
+         uint32_t                                                  _modification_stamp = 0;
+         uint32_t                                                  _loaded_objects_stamp = 0;
+         /// the last revision handed out, 0 is left to the objects loaded from disk, set by open() to the
+         /// open time in seconds, @see get_object_version
+         uint32_t                                                  _last_revision = 0;
+         /// lookup_slot() of the indexes open() loads in the background, not changed while they load
+         std::set< size_t >                                        _background_load_slots;
+         /// the thread loading them, joined through the future, guarded by _background_load_mutex
+         mutable std::shared_future<void>                          _background_load;
+         mutable std::mutex                                        _background_load_mutex;
+         /// true from the start of the background load until somebody has seen it finish successfully
+         mutable std::atomic<bool>                                 _background_load_pending{ false };
    };
 
 } } // graphene::db
 
-
+FC_REFLECT( graphene::db::index_memory_usage, (space_id)(type_id)(object_count)(object_bytes)(secondary_index_bytes) )
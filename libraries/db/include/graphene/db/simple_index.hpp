@@ -99,6 +99,11 @@ namespace graphene { namespace db {
             } FC_CAPTURE_AND_RETHROW()
          }
 
+         virtual size_t memory_usage()const override
+         {
+            return _objects.capacity() * sizeof( unique_ptr<object> ) + object_count() * sizeof( T );
+         }
+
          class const_iterator
          {
             public:
@@ -38,6 +38,16 @@ namespace graphene { namespace db {
       unordered_map<object_id_type, object_id_type>      old_index_next_ids;
       std::unordered_set<object_id_type>                 new_ids;
       unordered_map<object_id_type, unique_ptr<object> > removed;
+      /// Approximate memory used by the entries above, @see undo_database::bytes
+      size_t                                             bytes = 0;
+   };
+
+   /** Size of the undo history, @see undo_database::bytes */
+   struct undo_history_usage
+   {
+      uint32_t depth     = 0; ///< number of undo states
+      uint64_t bytes     = 0; ///< approximate memory used by the undo states
+      uint64_t max_bytes = 0; ///< the configured limit, 0 for none
    };
 
 
@@ -121,18 +131,65 @@ namespace graphene { namespace db {
          size_t max_size()const { return _max_size; }
          uint32_t active_sessions()const { return _active_sessions; }
 
+         /**
+          * Approximate memory used by all undo states: the shallow size of every saved object plus a fixed
+          * overhead per entry. Memory owned by members of the saved objects (e.g. strings) is not counted.
+          */
+         size_t bytes()const { return _bytes; }
+         /// Sets the limit for bytes() that the owner of the undo database enforces, 0 for none
+         void set_max_bytes( size_t new_max_bytes ) { _max_bytes = new_max_bytes; }
+         size_t max_bytes()const { return _max_bytes; }
+         undo_history_usage get_usage()const;
+
          const undo_state& head()const;
 
+         /**
+          * Looks up the value an object had before the changes recorded in the topmost @p depth undo states,
+          * e.g. the state of the head block while a pending undo session is open.
+          *
+          * @param holder receives a copy of the old value if the object was changed in these states
+          * @return the live object if it was not changed, holder.get() if it was, nullptr if it did not exist
+          */
+         const object* find_before( object_id_type id, size_t depth, unique_ptr<object>& holder )const;
+
+         /// Upper bound for the number of discarded undo copies kept for reuse, per object type
+         static const size_t     max_spare_objects_per_type = 1024;
+
       private:
          void undo();
          void merge();
          void commit();
 
+         /**
+          * Copies obj into a previously discarded undo copy of the same type if one is available,
+          * reusing its memory (including that of its members), otherwise clones obj.
+          * If snapshot is true, the copy may be a partial undo snapshot, @see object::undo_snapshot
+          */
+         unique_ptr<object> clone_object( const object& obj, bool snapshot );
+         /// Keeps discarded undo copies of the given state for reuse by clone_object()
+         void               recycle( undo_state& state );
+         void               recycle( unique_ptr<object>& obj );
+         /// Accounting of undo_state::bytes and _bytes
+         ///@{
+         void               add_bytes( undo_state& state, size_t n ) { state.bytes += n; _bytes += n; }
+         void               remove_bytes( undo_state& state, size_t n ) { state.bytes -= n; _bytes -= n; }
+         /// Removes the given state from the stack, either the oldest or the newest one
+         void               discard_front();
+         void               discard_back();
+         ///@}
+
          uint32_t                _active_sessions = 0;
          bool                    _disabled = true;
          std::deque<undo_state>  _stack;
          object_database&        _db;
          size_t                  _max_size = 256;
+         size_t                  _bytes = 0;
+         size_t                  _max_bytes = 0;
+
+         /// Discarded undo copies by object space and type, see clone_object()
+         unordered_map< uint16_t, vector< unique_ptr<object> > > _spare_objects;
    };
 
 } } // graphene::db
+
+FC_REFLECT( graphene::db::undo_history_usage, (depth)(bytes)(max_bytes) )
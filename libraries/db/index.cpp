@@ -26,18 +26,148 @@
 #include <graphene/db/object_database.hpp>
 
 namespace graphene { namespace db {
+   vector<object_range_digest> index::digest_ranges( uint64_t first, uint64_t last, uint32_t parts,
+         const std::function<const object*( object_id_type )>& lookup )const
+   {
+      if( last == 0 )
+         last = get_next_id().instance();
+      vector<object_range_digest> result;
+      if( first >= last || parts == 0 )
+         return result;
+      const uint64_t size = last - first;
+      if( parts > size )
+         parts = size;
+      result.resize( parts );
+      const uint8_t space = object_space_id();
+      const uint8_t type = object_type_id();
+      for( uint32_t i = 0; i < parts; ++i )
+      {
+         object_range_digest& range = result[i];
+         range.first = first + size / parts * i + std::min<uint64_t>( i, size % parts );
+         range.last = range.first + size / parts + ( i < size % parts ? 1 : 0 );
+         fc::sha256::encoder enc;
+         for( uint64_t instance = range.first; instance < range.last; ++instance )
+         {
+            const object_id_type id( space, type, instance );
+            const object* obj = lookup ? lookup( id ) : find( id );
+            if( obj == nullptr )
+               continue;
+            ++range.count;
+            fc::raw::pack( enc, instance );
+            const vector<char> data = obj->pack();
+            enc.write( data.data(), data.size() );
+         }
+         range.digest = enc.result();
+      }
+      return result;
+   }
+
    void base_primary_index::save_undo( const object& obj )
    { _db.save_undo( obj ); }
 
    void base_primary_index::on_add( const object& obj )
    {
+      _unsaved_changes = true;
       _db.save_undo_add( obj );
       for( auto ob : _observers ) ob->on_add( obj );
    }
 
    void base_primary_index::on_remove( const object& obj )
-   { _db.save_undo_remove( obj ); for( auto ob : _observers ) ob->on_remove( obj ); }
+   {
+      _unsaved_changes = true;
+      _db.save_undo_remove( obj );
+      for( auto ob : _observers ) ob->on_remove( obj );
+   }
 
    void base_primary_index::on_modify( const object& obj )
-   {for( auto ob : _observers ) ob->on_modify(  obj ); }
+   {
+      _unsaved_changes = true;
+      for( auto ob : _observers ) ob->on_modify(  obj );
+   }
+
+   void base_primary_index::flush_batched_secondary_indexes()
+   {
+      for( const auto& item : _sindex )
+      {
+         batched_secondary_index* batched = dynamic_cast<batched_secondary_index*>( item.get() );
+         if( batched != nullptr )
+            batched->flush_changes();
+      }
+   }
+
+   size_t base_primary_index::secondary_index_memory_usage()const
+   {
+      size_t result = 0;
+      for( const auto& item : _sindex )
+         result += item->memory_usage();
+      return result;
+   }
+
+   void base_primary_index::suspend_batched_secondary_indexes()
+   {
+      for( const auto& item : _sindex )
+      {
+         batched_secondary_index* batched = dynamic_cast<batched_secondary_index*>( item.get() );
+         if( batched != nullptr )
+            batched->suspend();
+      }
+   }
+
+   void base_primary_index::rebuild_batched_secondary_indexes()
+   {
+      for( const auto& item : _sindex )
+      {
+         batched_secondary_index* batched = dynamic_cast<batched_secondary_index*>( item.get() );
+         if( batched != nullptr && batched->is_suspended() )
+            batched->rebuild();
+      }
+   }
+
+   void batched_secondary_index::suspend()
+   {
+      _suspended = true;
+      _pending.clear();
+   }
+
+   void batched_secondary_index::rebuild()
+   {
+      _suspended = false;
+      _pending.clear();
+      clear();
+      _primary.inspect_all_objects( [this]( const object& obj ) {
+         apply_change( nullptr, &obj );
+      });
+   }
+
+   void batched_secondary_index::object_inserted( const object& obj )
+   {
+      if( _suspended ) return;
+      // if the object was removed since the last flush, keep the copy from before the removal
+      _pending.emplace( obj.id, unique_ptr<object>() );
+   }
+
+   void batched_secondary_index::object_removed( const object& obj )
+   {
+      if( _suspended ) return;
+      if( _pending.find( obj.id ) == _pending.end() )
+         _pending.emplace( obj.id, obj.clone() );
+   }
+
+   void batched_secondary_index::about_to_modify( const object& before )
+   {
+      if( _suspended ) return;
+      if( _pending.find( before.id ) == _pending.end() )
+         _pending.emplace( before.id, before.clone() );
+   }
+
+   void batched_secondary_index::flush_changes()
+   {
+      for( const auto& item : _pending )
+      {
+         const object* after = _primary.find( item.first );
+         if( item.second || after != nullptr )
+            apply_change( item.second.get(), after );
+      }
+      _pending.clear();
+   }
 } } // graphene::chain
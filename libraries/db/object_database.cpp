@@ -30,29 +30,62 @@
 namespace graphene { namespace db {
 
 object_database::object_database()
-:_undo_db(*this)
+:_undo_db(*this),_lookup( size_t(max_lookup_spaces) << 8 )
 {
    _index.resize(255);
    _undo_db.enable();
 }
 
-object_database::~object_database(){}
+object_database::~object_database()
+{
+   try {
+      wait_for_background_loads();
+   } catch( const fc::exception& e ) {
+      elog( "Loading an index in the background failed: ${e}", ("e", e.to_detail_string()) );
+   } catch( const std::exception& e ) {
+      elog( "Loading an index in the background failed: ${e}", ("e", e.what()) );
+   }
+}
 
 void object_database::close()
 {
+   wait_for_background_loads();
+}
+
+void object_database::load_in_background( uint8_t space_id, uint8_t type_id )
+{
+   FC_ASSERT( _index.size() > space_id && _index[space_id].size() > type_id && _index[space_id][type_id],
+              "No index to load in the background", ("space",space_id)("type",type_id) );
+   _background_load_slots.insert( lookup_slot( space_id, type_id ) );
+}
+
+void object_database::join_background_load()const
+{
+   // every waiter gets its own copy, a shared_future must not be used by several threads at once
+   std::shared_future<void> load;
+   {
+      std::lock_guard<std::mutex> guard( _background_load_mutex );
+      load = _background_load;
+   }
+   if( load.valid() )
+      load.get();
+   _background_load_pending.store( false, std::memory_order_release );
 }
 
 const object* object_database::find_object( object_id_type id )const
 {
-   return get_index(id.space(),id.type()).find( id );
+   return find_typed( id.space(), id.type(), id );
 }
 const object& object_database::get_object( object_id_type id )const
 {
-   return get_index(id.space(),id.type()).get( id );
+   const object* obj = find_object( id );
+   FC_ASSERT( obj != nullptr, "Unable to find Object ${id}", ("id",id) );
+   return *obj;
 }
 
 const index& object_database::get_index(uint8_t space_id, uint8_t type_id)const
 {
+   wait_for_load( space_id, type_id );
    FC_ASSERT( _index.size() > space_id, "", ("space_id",space_id)("type_id",type_id)("index.size",_index.size()) );
    FC_ASSERT( _index[space_id].size() > type_id, "", ("space_id",space_id)("type_id",type_id)("index[space_id].size",_index[space_id].size()) );
    const auto& tmp = _index[space_id][type_id];
@@ -61,6 +94,7 @@ const index& object_database::get_index(uint8_t space_id, uint8_t type_id)const
 }
 index& object_database::get_mutable_index(uint8_t space_id, uint8_t type_id)
 {
+   wait_for_load( space_id, type_id );
    FC_ASSERT( _index.size() > space_id, "", ("space_id",space_id)("type_id",type_id)("index.size",_index.size()) );
    FC_ASSERT( _index[space_id].size() > type_id , "", ("space_id",space_id)("type_id",type_id)("index[space_id].size",_index[space_id].size()) );
    const auto& idx = _index[space_id][type_id];
@@ -71,26 +105,72 @@ index& object_database::get_mutable_index(uint8_t space_id, uint8_t type_id)
 void object_database::flush()
 {
 //   ilog("Save object_database in ${d}", ("d", _data_dir));
-   fc::create_directories( _data_dir / "object_database.tmp" / "lock" );
-   std::vector<fc::future<void>> tasks;
+   const fc::path current_dir = _data_dir / "object_database";
+   const fc::path tmp_dir = _data_dir / "object_database.tmp";
+   wait_for_background_loads();
+   fc::create_directories( tmp_dir / "lock" );
+   // The indexes are saved while the state is in use, so this thread blocks on the tasks instead of yielding
+   std::vector<std::future<void>> tasks;
    tasks.reserve(200);
    for( uint32_t space = 0; space < _index.size(); ++space )
    {
-      fc::create_directories( _data_dir / "object_database.tmp" / fc::to_string(space) );
+      fc::create_directories( tmp_dir / fc::to_string(space) );
       const auto types = _index[space].size();
       for( uint32_t type = 0; type  <  types; ++type )
-         if( _index[space][type] )
-            tasks.push_back( fc::do_parallel( [this,space,type] () {
-               _index[space][type]->save( _data_dir / "object_database.tmp" / fc::to_string(space)/fc::to_string(type) );
-            } ) );
+      {
+         if( !_index[space][type] )
+            continue;
+         const fc::path file = fc::path( fc::to_string(space) ) / fc::to_string(type);
+         // An index that has not changed since the last checkpoint is identical to its file on disk,
+         // so link the existing file instead of serializing the whole index again
+         if( _current_checkpoint_valid && !_index[space][type]->has_unsaved_changes()
+               && fc::exists( current_dir / file ) )
+            fc::create_hard_link( current_dir / file, tmp_dir / file );
+         else
+            tasks.push_back( run_in_background_blocking( [this,space,type,tmp_dir,file] () {
+               _index[space][type]->save( tmp_dir / file );
+            }, "save index" ) );
+      }
    }
    for( auto& task : tasks )
       task.wait();
-   fc::remove_all( _data_dir / "object_database.tmp" / "lock" );
-   if( fc::exists( _data_dir / "object_database" ) )
-      fc::rename( _data_dir / "object_database", _data_dir / "object_database.old" );
-   fc::rename( _data_dir / "object_database.tmp", _data_dir / "object_database" );
+   for( auto& task : tasks )
+      task.get();
+   fc::remove_all( tmp_dir / "lock" );
+   if( fc::exists( current_dir ) )
+      fc::rename( current_dir, _data_dir / "object_database.old" );
+   fc::rename( tmp_dir, current_dir );
    fc::remove_all( _data_dir / "object_database.old" );
+   _current_checkpoint_valid = true;
+}
+
+void object_database::save_copy( const fc::path& dir )const
+{
+   wait_for_background_loads();
+   // Called from applied_block, so this thread blocks on the tasks instead of yielding while they read the indexes
+   std::vector<std::future<void>> tasks;
+   tasks.reserve(200);
+   for( uint32_t space = 0; space < _index.size(); ++space )
+   {
+      fc::create_directories( dir / fc::to_string(space) );
+      for( uint32_t type = 0; type < _index[space].size(); ++type )
+         if( _index[space][type] )
+            tasks.push_back( run_in_background_blocking( [this,space,type,dir] () {
+               _index[space][type]->save_copy( dir / fc::to_string(space) / fc::to_string(type) );
+            }, "copy index" ) );
+   }
+   for( auto& task : tasks )
+      task.wait();
+   for( auto& task : tasks )
+      task.get();
+}
+
+void object_database::set_background_threads( uint16_t num_threads )
+{
+   _background_threads.clear();
+   _background_threads.reserve( num_threads );
+   for( uint16_t i = 0; i < num_threads; ++i )
+      _background_threads.push_back( std::make_shared<fc::thread>( "background " + std::to_string(i) ) );
 }
 
 void object_database::wipe(const fc::path& data_dir)
@@ -98,29 +178,50 @@ void object_database::wipe(const fc::path& data_dir)
    close();
    ilog("Wiping object database...");
    fc::remove_all(data_dir / "object_database");
+   _current_checkpoint_valid = false;
    ilog("Done wiping object databse.");
 }
 
 void object_database::open(const fc::path& data_dir)
 { try {
    _data_dir = data_dir;
+   _current_checkpoint_valid = false;
+   _last_revision = fc::time_point::now().sec_since_epoch();
    if( fc::exists( _data_dir / "object_database" / "lock" ) )
    {
        wlog("Ignoring locked object_database");
        return;
    }
+   wait_for_background_loads();
    std::vector<fc::future<void>> tasks;
    tasks.reserve(200);
    ilog("Opening object database from ${d} ...", ("d", data_dir));
    for( uint32_t space = 0; space < _index.size(); ++space )
       for( uint32_t type = 0; type  < _index[space].size(); ++type )
-         if( _index[space][type] )
+         if( _index[space][type] && _background_load_slots.count( lookup_slot( space, type ) ) == 0 )
             tasks.push_back( fc::do_parallel( [this,space,type] () {
                _index[space][type]->open( _data_dir / "object_database" / fc::to_string(space)/fc::to_string(type) );
             } ) );
    for( auto& task : tasks )
       task.wait();
-   ilog( "Done opening object database." );
+   // The indexes loaded in the background start after the others so that they don't delay them. They are loaded
+   // one after another, loading an index inserts its objects into secondary indexes that may read an earlier one.
+   if( !_background_load_slots.empty() )
+   {
+      std::lock_guard<std::mutex> guard( _background_load_mutex );
+      _background_load_pending.store( true, std::memory_order_release );
+      _background_load = std::async( std::launch::async, [this] () {
+         for( size_t slot : _background_load_slots )
+         {
+            const uint32_t space = slot >> 8;
+            const uint32_t type = slot & 0xff;
+            _index[space][type]->open( _data_dir / "object_database" / fc::to_string(space)/fc::to_string(type) );
+         }
+      } ).share();
+   }
+   _current_checkpoint_valid = true;
+   ilog( "Done opening object database, ${n} indexes are loaded in the background.",
+         ("n", _background_load_slots.size()) );
 
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
@@ -130,6 +231,68 @@ void object_database::pop_undo()
    _undo_db.pop_commit();
 } FC_CAPTURE_AND_RETHROW() }
 
+void object_database::apply_batched_index_changes()
+{
+   wait_for_background_loads();
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+      {
+         base_primary_index* primary = dynamic_cast<base_primary_index*>( idx.get() );
+         if( primary != nullptr )
+            primary->flush_batched_secondary_indexes();
+      }
+}
+
+vector< index_memory_usage > object_database::get_memory_usage()const
+{
+   wait_for_background_loads();
+   vector< index_memory_usage > result;
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+      {
+         if( !idx ) continue;
+         index_memory_usage usage;
+         usage.space_id = idx->object_space_id();
+         usage.type_id = idx->object_type_id();
+         usage.object_count = idx->object_count();
+         usage.object_bytes = idx->memory_usage();
+         const base_primary_index* primary = dynamic_cast<const base_primary_index*>( idx.get() );
+         if( primary != nullptr )
+            usage.secondary_index_bytes = primary->secondary_index_memory_usage();
+         result.push_back( usage );
+      }
+   return result;
+}
+
+void object_database::suspend_batched_indexes()
+{
+   wait_for_background_loads();
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+      {
+         base_primary_index* primary = dynamic_cast<base_primary_index*>( idx.get() );
+         if( primary != nullptr )
+            primary->suspend_batched_secondary_indexes();
+      }
+}
+
+void object_database::rebuild_batched_indexes()
+{
+   wait_for_background_loads();
+   std::vector<fc::future<void>> tasks;
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+      {
+         base_primary_index* primary = dynamic_cast<base_primary_index*>( idx.get() );
+         if( primary != nullptr )
+            tasks.push_back( fc::do_parallel( [primary] () {
+               primary->rebuild_batched_secondary_indexes();
+            } ) );
+      }
+   for( auto& task : tasks )
+      task.wait();
+}
+
 void object_database::save_undo( const object& obj )
 {
    _undo_db.on_modify( obj );
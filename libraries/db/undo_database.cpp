@@ -27,6 +27,16 @@
 
 namespace graphene { namespace db {
 
+namespace {
+   // approximate size of an entry of the unordered containers of undo_state: the key, a node pointer and a bucket
+   const size_t id_entry_bytes = sizeof( object_id_type ) + 2 * sizeof( void* );
+   const size_t next_id_entry_bytes = id_entry_bytes + sizeof( object_id_type );
+   size_t value_entry_bytes( const object& obj )
+   {
+      return id_entry_bytes + sizeof( unique_ptr<object> ) + obj.object_size();
+   }
+}
+
 void undo_database::enable()  { _disabled = false; }
 void undo_database::disable() { _disabled = true; }
 
@@ -51,7 +61,7 @@ undo_database::session undo_database::start_undo_session( bool force_enable )
       _disabled = false;
 
    while( size() > max_size() )
-      _stack.pop_front();
+      discard_front();
 
    _stack.emplace_back();
    ++_active_sessions;
@@ -67,8 +77,12 @@ void undo_database::on_create( const object& obj )
    auto index_id = object_id_type( obj.id.space(), obj.id.type(), 0 );
    auto itr = state.old_index_next_ids.find( index_id );
    if( itr == state.old_index_next_ids.end() )
+   {
       state.old_index_next_ids[index_id] = obj.id;
-   state.new_ids.insert(obj.id);
+      add_bytes( state, next_id_entry_bytes );
+   }
+   if( state.new_ids.insert(obj.id).second )
+      add_bytes( state, id_entry_bytes );
 }
 void undo_database::on_modify( const object& obj )
 {
@@ -81,7 +95,8 @@ void undo_database::on_modify( const object& obj )
       return;
    auto itr =  state.old_values.find(obj.id);
    if( itr != state.old_values.end() ) return;
-   state.old_values[obj.id] = obj.clone();
+   add_bytes( state, value_entry_bytes( obj ) );
+   state.old_values[obj.id] = clone_object( obj, true );
 }
 void undo_database::on_remove( const object& obj )
 {
@@ -93,16 +108,23 @@ void undo_database::on_remove( const object& obj )
    if( state.new_ids.count(obj.id) )
    {
       state.new_ids.erase(obj.id);
+      remove_bytes( state, id_entry_bytes );
       return;
    }
-   if( state.old_values.count(obj.id) )
+   auto itr = state.old_values.find(obj.id);
+   if( itr != state.old_values.end() )
    {
-      state.removed[obj.id] = std::move(state.old_values[obj.id]);
-      state.old_values.erase(obj.id);
-      return;
+      // the saved value may be a partial snapshot, complete it from the current value
+      auto removed = clone_object( obj, false );
+      removed->restore_undo_snapshot( *itr->second );
+      recycle( itr->second );
+      state.removed[obj.id] = std::move(removed);
+      state.old_values.erase(itr);
+      return; // same size as the entry in old_values
    }
    if( state.removed.count(obj.id) ) return;
-   state.removed[obj.id] = obj.clone();
+   add_bytes( state, value_entry_bytes( obj ) );
+   state.removed[obj.id] = clone_object( obj, false );
 }
 
 void undo_database::undo()
@@ -114,7 +136,7 @@ void undo_database::undo()
    auto& state = _stack.back();
    for( auto& item : state.old_values )
    {
-      _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
+      _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.restore_undo_snapshot( *item.second ); } );
    }
 
    for( auto ritr = state.new_ids.begin(); ritr != state.new_ids.end(); ++ritr  )
@@ -130,7 +152,7 @@ void undo_database::undo()
    for( auto& item : state.removed )
       _db.insert( std::move(*item.second) );
 
-   _stack.pop_back();
+   discard_back();
    enable();
    --_active_sessions;
 } FC_CAPTURE_AND_RETHROW() }
@@ -140,7 +162,7 @@ void undo_database::merge()
    FC_ASSERT( _active_sessions > 0 );
    if( _active_sessions == 1 && _stack.size() == 1 )
    {
-      _stack.pop_back();
+      discard_back();
       --_active_sessions;
       return;
    }
@@ -206,12 +228,14 @@ void undo_database::merge()
       // del+upd -> N/A
       assert( prev_state.removed.find(obj.second->id) == prev_state.removed.end() );
       // nop+upd(was=Y) -> upd(was=Y), type B
+      add_bytes( prev_state, value_entry_bytes( *obj.second ) );
       prev_state.old_values[obj.second->id] = std::move(obj.second);
    }
 
    // *+new, but we assume the N/A cases don't happen, leaving type B nop+new -> new
    for( auto id : state.new_ids )
-      prev_state.new_ids.insert(id);
+      if( prev_state.new_ids.insert(id).second )
+         add_bytes( prev_state, id_entry_bytes );
 
    // old_index_next_ids can only be updated, iterate over *+upd cases
    for( auto& item : state.old_index_next_ids )
@@ -220,6 +244,7 @@ void undo_database::merge()
       {
          // nop+upd(was=Y) -> upd(was=Y), type B
          prev_state.old_index_next_ids[item.first] = item.second;
+         add_bytes( prev_state, next_id_entry_bytes );
          continue;
       }
       else
@@ -237,22 +262,27 @@ void undo_database::merge()
       {
          // new + del -> nop (type C)
          prev_state.new_ids.erase(obj.second->id);
+         remove_bytes( prev_state, id_entry_bytes );
          continue;
       }
       auto it = prev_state.old_values.find(obj.second->id);
       if( it != prev_state.old_values.end() )
       {
          // upd(was=X) + del(was=Y) -> del(was=X)
-         prev_state.removed[obj.second->id] = std::move(it->second);
-         prev_state.old_values.erase(obj.second->id);
+         // X may be a partial snapshot, so restore it onto the complete Y
+         obj.second->restore_undo_snapshot( *it->second );
+         recycle( it->second );
+         prev_state.removed[obj.second->id] = std::move(obj.second);
+         prev_state.old_values.erase(it);
          continue;
       }
       // del + del -> N/A
       assert( prev_state.removed.find( obj.second->id ) == prev_state.removed.end() );
       // nop + del(was=Y) -> del(was=Y)
+      add_bytes( prev_state, value_entry_bytes( *obj.second ) );
       prev_state.removed[obj.second->id] = std::move(obj.second);
    }
-   _stack.pop_back();
+   discard_back();
    --_active_sessions;
 }
 void undo_database::commit()
@@ -272,7 +302,7 @@ void undo_database::pop_commit()
 
       for( auto& item : state.old_values )
       {
-         _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
+         _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.restore_undo_snapshot( *item.second ); } );
       }
 
       for( auto ritr = state.new_ids.begin(); ritr != state.new_ids.end(); ++ritr  )
@@ -288,7 +318,7 @@ void undo_database::pop_commit()
       for( auto& item : state.removed )
          _db.insert( std::move(*item.second) );
 
-      _stack.pop_back();
+      discard_back();
    }
    catch ( const fc::exception& e )
    {
@@ -298,6 +328,102 @@ void undo_database::pop_commit()
    }
    enable();
 }
+static uint16_t spare_key( const object_id_type& id )
+{
+   return ( uint16_t( id.space() ) << 8 ) | id.type();
+}
+
+unique_ptr<object> undo_database::clone_object( const object& obj, bool snapshot )
+{
+   auto itr = _spare_objects.find( spare_key( obj.id ) );
+   if( itr == _spare_objects.end() || itr->second.empty() )
+      return snapshot ? obj.undo_snapshot() : obj.clone();
+   unique_ptr<object> result = std::move( itr->second.back() );
+   itr->second.pop_back();
+   if( snapshot )
+      result->copy_undo_snapshot_from( obj );
+   else
+      result->copy_from( obj );
+   return result;
+}
+
+void undo_database::recycle( unique_ptr<object>& obj )
+{
+   if( !obj ) return;
+   auto& spares = _spare_objects[ spare_key( obj->id ) ];
+   if( spares.size() < max_spare_objects_per_type )
+      spares.push_back( std::move( obj ) );
+   obj.reset();
+}
+
+void undo_database::recycle( undo_state& state )
+{
+   for( auto& item : state.old_values )
+      recycle( item.second );
+   for( auto& item : state.removed )
+      recycle( item.second );
+}
+
+void undo_database::discard_front()
+{
+   recycle( _stack.front() );
+   _bytes -= _stack.front().bytes;
+   _stack.pop_front();
+}
+
+void undo_database::discard_back()
+{
+   recycle( _stack.back() );
+   _bytes -= _stack.back().bytes;
+   _stack.pop_back();
+}
+
+undo_history_usage undo_database::get_usage()const
+{
+   undo_history_usage result;
+   result.depth = _stack.size();
+   result.bytes = _bytes;
+   result.max_bytes = _max_bytes;
+   return result;
+}
+
+const object* undo_database::find_before( object_id_type id, size_t depth, unique_ptr<object>& holder )const
+{
+   FC_ASSERT( depth <= _stack.size() );
+   holder.reset();
+   const object* result = _db.find_object( id );
+   // walk from the newest state to the oldest one, each state records the value before its own changes
+   for( auto itr = _stack.rbegin(); depth > 0; ++itr, --depth )
+   {
+      const undo_state& state = *itr;
+      if( state.new_ids.find( id ) != state.new_ids.end() )
+      {
+         holder.reset();
+         result = nullptr;
+         continue;
+      }
+      auto old_itr = state.old_values.find( id );
+      if( old_itr != state.old_values.end() )
+      {
+         // the old value may be a partial snapshot, restore a copy of it onto a copy of the later value
+         FC_ASSERT( result != nullptr );
+         unique_ptr<object> value = result->clone();
+         unique_ptr<object> snapshot = old_itr->second->clone();
+         value->restore_undo_snapshot( *snapshot );
+         holder = std::move( value );
+         result = holder.get();
+         continue;
+      }
+      auto removed_itr = state.removed.find( id );
+      if( removed_itr != state.removed.end() )
+      {
+         holder = removed_itr->second->clone();
+         result = holder.get();
+      }
+   }
+   return result;
+}
+
 const undo_state& undo_database::head()const
 {
    FC_ASSERT( !_stack.empty() );
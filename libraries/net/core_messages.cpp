@@ -29,6 +29,9 @@ namespace graphene { namespace net {
 
   const core_message_type_enum trx_message::type                             = core_message_type_enum::trx_message_type;
   const core_message_type_enum block_message::type                           = core_message_type_enum::block_message_type;
+  const core_message_type_enum compact_block_message::type                   = core_message_type_enum::compact_block_message_type;
+  const core_message_type_enum fetch_full_block_message::type                = core_message_type_enum::fetch_full_block_message_type;
+  const core_message_type_enum block_batch_message::type                     = core_message_type_enum::block_batch_message_type;
   const core_message_type_enum item_ids_inventory_message::type              = core_message_type_enum::item_ids_inventory_message_type;
   const core_message_type_enum blockchain_item_ids_inventory_message::type   = core_message_type_enum::blockchain_item_ids_inventory_message_type;
   const core_message_type_enum fetch_blockchain_item_ids_message::type       = core_message_type_enum::fetch_blockchain_item_ids_message_type;
@@ -47,11 +50,39 @@ namespace graphene { namespace net {
   const core_message_type_enum get_current_connections_request_message::type = core_message_type_enum::get_current_connections_request_message_type;
   const core_message_type_enum get_current_connections_reply_message::type   = core_message_type_enum::get_current_connections_reply_message_type;
 
+  message block_message::from_packed_block( std::vector<char>&& packed_block, const block_id_type& id )
+  {
+     // a block_message is serialized as the block followed by its ID
+     message result;
+     result.msg_type = block_message::type;
+     result.data     = std::move( packed_block );
+     const auto packed_id = fc::raw::pack( id );
+     result.data.insert( result.data.end(), packed_id.begin(), packed_id.end() );
+     result.size     = (uint32_t)result.data.size();
+     return result;
+  }
+
+  compact_block_message::compact_block_message( const block_message& full_block ) :
+     header( full_block.block ),
+     block_id( full_block.block_id )
+  {
+     transactions.reserve( full_block.block.transactions.size() );
+     for( const auto& trx : full_block.block.transactions )
+        transactions.push_back( compact_transaction{ trx.id(), trx.operation_results } );
+  }
+
 } } // graphene::net
 
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::trx_message, BOOST_PP_SEQ_NIL, (trx) )
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::block_message, BOOST_PP_SEQ_NIL, (block)(block_id) )
 
+FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::compact_block_message::compact_transaction, BOOST_PP_SEQ_NIL,
+                                (id)(operation_results) )
+FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::compact_block_message, BOOST_PP_SEQ_NIL,
+                                (header)(block_id)(transactions) )
+FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::fetch_full_block_message, BOOST_PP_SEQ_NIL, (block_id) )
+FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::block_batch_message, BOOST_PP_SEQ_NIL, (block_messages) )
+
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::item_id, BOOST_PP_SEQ_NIL,
                                (item_type)
                                (item_hash) )
@@ -131,6 +162,10 @@ FC_REFLECT_DERIVED_NO_TYPENAME(graphene::net::get_current_connections_reply_mess
 
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::trx_message )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::block_message )
+GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::compact_block_message::compact_transaction )
+GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::compact_block_message )
+GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::fetch_full_block_message )
+GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::block_batch_message )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::item_id )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::item_ids_inventory_message )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::blockchain_item_ids_inventory_message )
@@ -58,7 +58,29 @@
 #define GRAPHENE_NET_DEFAULT_DESIRED_CONNECTIONS             20
 #define GRAPHENE_NET_DEFAULT_MAX_CONNECTIONS                 200
 
+/**
+ * Each peer's outgoing messages are queued by priority class (see
+ * peer_connection::send_priority), and the connection is closed if any
+ * class grows beyond its limit.  The urgent class holds full blocks we push,
+ * so it gets room for a couple of maximum-sized messages; every other class
+ * is limited to GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES.
+ */
 #define GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES        (1024 * 1024)
+#define GRAPHENE_NET_MAXIMUM_QUEUED_URGENT_MESSAGES_IN_BYTES (2 * MAX_MESSAGE_SIZE)
+
+/**
+ * After this many messages in a row have been sent from higher priority
+ * classes while a lower class was waiting, the oldest waiting message of the
+ * lower classes is sent, so that a busy peer still receives transactions.
+ */
+#define GRAPHENE_NET_MAX_CONSECUTIVE_HIGHER_PRIORITY_SENDS   16
+
+/**
+ * Each connection keeps the buffer it pads outgoing messages into, so that
+ * sending does not allocate.  A buffer that grew past this size for a large
+ * message is released after the send instead of being kept.
+ */
+#define GRAPHENE_NET_MAX_RETAINED_SEND_BUFFER_SIZE           (64 * 1024)
 
 /**
  * When we receive a message from the network, we advertise it to
@@ -82,20 +104,63 @@
 
 #define GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES           2
 
+/**
+ * When a pass of the inventory advertising loop had at least this many new
+ * items to advertise, the next pass waits up to
+ * GRAPHENE_NET_INVENTORY_BATCH_INTERVAL_MS for more transactions to arrive,
+ * so that during a flood they go out in fewer, larger inventory messages.
+ * New blocks still end the wait immediately.
+ */
+#define GRAPHENE_NET_INVENTORY_BATCHING_THRESHOLD            50
+#define GRAPHENE_NET_INVENTORY_BATCH_INTERVAL_MS             100
+
 #define GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING      200
 
 /**
- * During normal operation, how many items will be fetched from each
- * peer at a time.  This will only come into play when the network
+ * Consecutive blocks requested by a syncing peer that accepts block batches
+ * are sent in block_batch_messages of up to this many bytes.  Larger blocks
+ * are sent on their own.
+ */
+#define GRAPHENE_NET_MAX_BLOCK_BATCH_SIZE_IN_BYTES           (MAX_MESSAGE_SIZE / 2)
+
+/**
+ * Upload bandwidth for replies to syncing peers.  Each of them gets at most
+ * GRAPHENE_NET_DEFAULT_SYNC_UPLOAD_RATE_PER_PEER bytes per second (0 for no
+ * limit).  If a total upload limit is set, all of them together get at most
+ * GRAPHENE_NET_DEFAULT_SYNC_UPLOAD_SHARE_PERCENT of it, which keeps the rest
+ * free for relaying blocks and transactions.
+ */
+#define GRAPHENE_NET_DEFAULT_SYNC_UPLOAD_RATE_PER_PEER       0
+#define GRAPHENE_NET_DEFAULT_SYNC_UPLOAD_SHARE_PERCENT       75
+
+/**
+ * During sync, blocks that arrive before the ones they build on are held in
+ * memory.  While they take up more than this many bytes, we stop requesting
+ * more sync blocks until the backlog has been passed to the blockchain.
+ */
+#define GRAPHENE_NET_MAX_SYNC_BLOCKS_MEMORY_IN_BYTES         (256 * 1024 * 1024)
+
+/**
+ * During normal operation, the maximum number of items that will be fetched
+ * from each peer at a time.  This will only come into play when the network
  * is being flooded -- typically transactions will be fetched as soon
  * as we find out about them, so only one item will be requested
  * at a time.
- * 
- * No tests have been done to find the optimal value for this
- * parameter, so consider increasing or decreasing it if performance
- * during flooding is lacking.
+ *
+ * The number of items requested from a peer starts at 1 and is adapted to
+ * how fast the peer delivered the previous requests, see
+ * GRAPHENE_NET_FETCH_ITEMS_TARGET_DELAY_MS.
+ */
+#define GRAPHENE_NET_MAX_ITEMS_PER_PEER_DURING_NORMAL_OPERATION  100
+
+/**
+ * During normal operation, items are requested from a peer in batches that the
+ * peer is expected to deliver within about this many milliseconds, judging by the
+ * rate at which it delivered the previous batches.  The batch size grows at most
+ * twofold per batch so that it follows both the latency and the throughput of the
+ * connection.
  */
-#define GRAPHENE_NET_MAX_ITEMS_PER_PEER_DURING_NORMAL_OPERATION  1 
+#define GRAPHENE_NET_FETCH_ITEMS_TARGET_DELAY_MS                 500
 
 /**
  * Instead of fetching all item IDs from a peer, then fetching all blocks
@@ -24,6 +24,7 @@
 #pragma once
 
 #include <graphene/net/config.hpp>
+#include <graphene/net/message.hpp>
 
 #include <fc/crypto/ripemd160.hpp>
 #include <fc/crypto/elliptic.hpp>
@@ -43,6 +44,7 @@ namespace graphene { namespace net {
   using graphene::protocol::block_id_type;
   using graphene::protocol::transaction_id_type;
   using graphene::protocol::signed_block;
+  using graphene::protocol::signed_block_header;
 
   typedef fc::ecc::public_key_data node_id_t;
   typedef fc::ripemd160 item_hash_t;
@@ -85,6 +87,9 @@ namespace graphene { namespace net {
     check_firewall_reply_message_type            = 5015,
     get_current_connections_request_message_type = 5016,
     get_current_connections_reply_message_type   = 5017,
+    compact_block_message_type                   = 5018,
+    fetch_full_block_message_type                = 5019,
+    block_batch_message_type                     = 5020,
     core_message_type_last                       = 5099
   };
 
@@ -109,11 +114,69 @@ namespace graphene { namespace net {
       block_message(const signed_block& blk )
       :block(blk),block_id(blk.id()){}
 
+      /**
+       *  Builds the network message for a block from the serialized block, e.g. as stored in the
+       *  block_database, without unpacking and packing it again. The result equals message( block_message( b ) ).
+       */
+      static message from_packed_block( std::vector<char>&& packed_block, const block_id_type& id );
+
       signed_block    block;
       block_id_type   block_id;
 
    };
 
+  /**
+   *  A block sent in reply to a fetch_items_message, to a peer in sync with us that accepts compact blocks.
+   *  Instead of the transactions it carries their IDs, the peer takes them from the transactions it received
+   *  through trx_message.  The operation results are included, they are part of the merkle root and the peer
+   *  may have gotten different ones when applying the transactions itself.
+   *
+   *  A peer that is missing any of the transactions, or whose rebuilt block does not match, asks for the
+   *  whole block with a fetch_full_block_message.
+   */
+  struct compact_block_message
+  {
+    static const core_message_type_enum type;
+
+    struct compact_transaction
+    {
+      transaction_id_type                            id;
+      std::vector<graphene::protocol::operation_result> operation_results;
+    };
+
+    compact_block_message() {}
+    explicit compact_block_message(const block_message& full_block);
+
+    signed_block_header              header;
+    block_id_type                    block_id;
+    std::vector<compact_transaction> transactions;
+  };
+
+  struct fetch_full_block_message
+  {
+    static const core_message_type_enum type;
+
+    block_id_type block_id;
+
+    fetch_full_block_message() {}
+    fetch_full_block_message(const block_id_type& block_id) :
+      block_id(block_id)
+    {}
+  };
+
+  /**
+   *  Several consecutive blocks sent at once in reply to a fetch_items_message, to a peer that is syncing from us
+   *  and accepts block batches.  Each entry is the data of the block_message that would otherwise have been sent
+   *  on its own, so that the blocks are neither unpacked nor packed again and the receiver can handle each of
+   *  them as if it had arrived separately.
+   */
+  struct block_batch_message
+  {
+    static const core_message_type_enum type;
+
+    std::vector<std::vector<char>> block_messages;
+  };
+
   struct item_ids_inventory_message
   {
     static const core_message_type_enum type;
@@ -422,6 +485,9 @@ FC_REFLECT_ENUM( graphene::net::core_message_type_enum,
                  (check_firewall_reply_message_type)
                  (get_current_connections_request_message_type)
                  (get_current_connections_reply_message_type)
+                 (compact_block_message_type)
+                 (fetch_full_block_message_type)
+                 (block_batch_message_type)
                  (core_message_type_last) )
 FC_REFLECT_ENUM(graphene::net::rejection_reason_code, (unspecified)
                                                  (different_chain)
@@ -443,6 +509,10 @@ FC_REFLECT_ENUM(graphene::net::firewall_check_result, (unable_to_check)
 
 FC_REFLECT_TYPENAME( graphene::net::trx_message )
 FC_REFLECT_TYPENAME( graphene::net::block_message )
+FC_REFLECT_TYPENAME( graphene::net::compact_block_message::compact_transaction )
+FC_REFLECT_TYPENAME( graphene::net::compact_block_message )
+FC_REFLECT_TYPENAME( graphene::net::fetch_full_block_message )
+FC_REFLECT_TYPENAME( graphene::net::block_batch_message )
 FC_REFLECT_TYPENAME( graphene::net::item_id )
 FC_REFLECT_TYPENAME( graphene::net::item_ids_inventory_message )
 FC_REFLECT_TYPENAME( graphene::net::blockchain_item_ids_inventory_message )
@@ -466,6 +536,10 @@ FC_REFLECT_TYPENAME( graphene::net::get_current_connections_reply_message )
 
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::trx_message )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::block_message )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::compact_block_message::compact_transaction )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::compact_block_message )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::fetch_full_block_message )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::block_batch_message )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::item_id )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::item_ids_inventory_message )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::blockchain_item_ids_inventory_message )
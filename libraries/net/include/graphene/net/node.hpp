@@ -30,6 +30,7 @@
 #include <graphene/protocol/types.hpp>
 
 #include <list>
+#include <random>
 
 namespace graphene { namespace net {
 
@@ -68,6 +69,12 @@ namespace graphene { namespace net {
           */
          virtual bool has_item( const net::item_id& id ) = 0;
 
+         /**
+          *  Like has_item, but called from the p2p thread without waiting for the delegate's thread, so it must
+          *  only look at state that may be read concurrently. Returning false makes the node ask has_item.
+          */
+         virtual bool has_item_concurrently( const net::item_id& id ) { return false; }
+
          /**
           *  @brief Called when a new block comes in from the network
           *
@@ -114,6 +121,13 @@ namespace graphene { namespace net {
           */
          virtual message get_item( const item_id& id ) = 0;
 
+         /**
+          *  Like get_item, but called from the p2p thread without waiting for the delegate's thread, so it must
+          *  only look at state that may be read concurrently.
+          *  @return the item, or an empty optional if it has to be fetched through get_item
+          */
+         virtual fc::optional<message> get_item_concurrently( const item_id& id ) { return fc::optional<message>(); }
+
          virtual chain_id_type get_chain_id()const = 0;
 
          /**
@@ -262,6 +276,13 @@ namespace graphene { namespace net {
            broadcast( trx_message(trx) );
         }
 
+        /**
+         *  Broadcast a block produced by this node.  Peers which accept pushed blocks are sent the
+         *  whole block right away, saving the round trips of advertising it and waiting for them to
+         *  fetch it.  All other peers are notified as with broadcast().
+         */
+        virtual void  push_block_to_peers( const block_message& block );
+
         /**
          *  Node starts the process of fetching all items after item_id of the
          *  given item_type.   During this process messages are not broadcast.
@@ -287,6 +308,8 @@ namespace graphene { namespace net {
 
         fc::variant_object network_get_info() const;
         fc::variant_object network_get_usage_stats() const;
+        /** @return counts, bytes and handling times of received messages by type, and the send queue size of each peer */
+        fc::variant_object get_message_statistics() const;
 
         std::vector<potential_peer_record> get_potential_peers() const;
 
@@ -296,6 +319,30 @@ namespace graphene { namespace net {
         std::unique_ptr<detail::node_impl, detail::node_impl_deleter> my;
    };
 
+    /**
+     *  Properties of the link from a simulated_network to each of its nodes. Messages are sent one after
+     *  another at the given bandwidth and arrive after the given latency. Lost messages are not resent.
+     */
+    struct simulated_link_parameters
+    {
+      fc::microseconds latency;
+      /** bandwidth of each link, 0 for unlimited */
+      uint64_t         bytes_per_second = 0;
+      /** fraction of the messages that are dropped, between 0 and 1 */
+      double           loss_rate = 0;
+      uint32_t         random_seed = 0;
+    };
+
+    /** Traffic of the link from a simulated_network to one node */
+    struct simulated_link_statistics
+    {
+      uint64_t messages_delivered = 0;
+      uint64_t bytes_delivered = 0;
+      uint64_t messages_dropped = 0;
+      /** messages that were sent but not yet delivered */
+      uint64_t messages_in_flight = 0;
+    };
+
     class simulated_network : public node
     {
     public:
@@ -309,13 +356,21 @@ namespace graphene { namespace net {
 
       void      sync_from(const item_id& current_head_block, const std::vector<uint32_t>& hard_fork_block_numbers) override {}
       void      broadcast(const message& item_to_broadcast) override;
+      void      push_block_to_peers(const block_message& block) override { broadcast( block ); }
       void      add_node_delegate(node_delegate* node_delegate_to_add);
 
+      /** Applies to messages broadcast afterwards, by default messages are delivered immediately */
+      void      set_link_parameters(const simulated_link_parameters& parameters);
+      /** @return the statistics of each node, in the order the nodes were added */
+      std::vector<simulated_link_statistics> get_link_statistics() const;
+
       virtual uint32_t get_connection_count() const override { return 8; }
     private:
       struct node_info;
       void message_sender(node_info* destination_node);
       std::list<node_info*> network_nodes;
+      simulated_link_parameters link_parameters;
+      std::minstd_rand loss_generator;
     };
 
 
@@ -37,6 +37,7 @@
 #include <boost/multi_index/tag.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 
+#include <array>
 #include <queue>
 #include <boost/container/deque.hpp>
 #include <fc/thread/future.hpp>
@@ -122,6 +123,12 @@ namespace graphene { namespace net
         {}
 
         virtual message get_message(peer_connection_delegate* node) = 0;
+        /** returns the messages to send right after the one returned by get_message(), which must have been
+         * called before
+         */
+        virtual std::vector<message> get_followup_messages() { return std::vector<message>(); }
+        /** returns the type of the message that will be sent, used to pick its send queue */
+        virtual uint32_t get_message_type() const = 0;
         /** returns roughly the number of bytes of memory the message is consuming while
          * it is sitting on the queue
          */
@@ -144,6 +151,7 @@ namespace graphene { namespace net
         {}
 
         message get_message(peer_connection_delegate* node) override;
+        uint32_t get_message_type() const override { return message_to_send.msg_type.value(); }
         size_t get_size_in_queue() override;
       };
 
@@ -160,12 +168,55 @@ namespace graphene { namespace net
         {}
 
         message get_message(peer_connection_delegate* node) override;
+        uint32_t get_message_type() const override { return item_to_send.item_type; }
         size_t get_size_in_queue() override;
       };
 
+      /* like a virtual_queued_message, but for a block_batch_message of the blocks with the
+       * given IDs.  Blocks that are no longer available when it is sent are left out, and an
+       * item_not_available_message for each of them follows the batch.
+       */
+      struct virtual_block_batch_queued_message : queued_message
+      {
+        std::vector<item_hash_t> blocks_to_send;
+        std::vector<message>     item_not_available_messages;
+
+        virtual_block_batch_queued_message(std::vector<item_hash_t> blocks_to_send) :
+          blocks_to_send(std::move(blocks_to_send))
+        {}
+
+        message get_message(peer_connection_delegate* node) override;
+        std::vector<message> get_followup_messages() override { return std::move(item_not_available_messages); }
+        uint32_t get_message_type() const override { return block_batch_message_type; }
+        size_t get_size_in_queue() override;
+      };
 
-      size_t _total_queued_messages_size = 0;
-      std::queue<std::unique_ptr<queued_message>, std::list<std::unique_ptr<queued_message> > > _queued_messages;
+      /* outgoing messages are queued by class and sent highest class first, so that a
+       * block doesn't wait behind a long backlog of transactions to a slow peer.
+       * Each class keeps its own byte limit.
+       */
+      enum send_priority
+      {
+        urgent_send_priority,      /// blocks, requests that gate block propagation or our sync, connection control
+        sync_send_priority,        /// replies to a peer that is syncing from us
+        inventory_send_priority,   /// item advertisements
+        transaction_send_priority, /// transactions
+        send_priority_count
+      };
+      send_priority get_send_priority(const queued_message& message_to_send) const;
+
+      typedef std::queue<std::unique_ptr<queued_message>, std::list<std::unique_ptr<queued_message> > > queued_message_queue;
+      std::array<queued_message_queue, send_priority_count> _queued_messages;
+      /// whether the next message of queue is a block or block batch for a syncing peer, @see sync_upload_rate_limit
+      bool is_sync_block_payload(const queued_message_queue& queue) const;
+      std::array<size_t, send_priority_count> _queued_messages_size = {};
+      /// number of messages sent in a row while a lower class was waiting, see send_queued_messages_task()
+      uint32_t _consecutive_higher_priority_sends = 0;
+      /// bytes of sync blocks we may still send before sync_upload_rate_limit holds them back, may be negative
+      int64_t _sync_upload_allowance = 0;
+      fc::time_point _sync_upload_allowance_time;
+      /// set while send_queued_messages_task() waits for the sync upload allowance, wakes it for new messages
+      fc::promise<void>::ptr _send_queue_updated_promise;
       fc::future<void> _send_queued_messages_done;
     public:
       fc::time_point connection_initiation_time;
@@ -205,6 +256,14 @@ namespace graphene { namespace net
       fc::optional<fc::time_point_sec> fc_git_revision_unix_timestamp;
       fc::optional<std::string> platform;
       fc::optional<uint32_t> bitness;
+      /// true if the peer told us in its hello message that it accepts blocks sent without being requested
+      bool accepts_pushed_blocks = false;
+      /// true if the peer told us in its hello message that it accepts compact_block_message replies
+      bool accepts_compact_blocks = false;
+      /// true if the peer told us in its hello message that it accepts block_batch_message replies
+      bool accepts_block_batches = false;
+      /// bytes per second of blocks we send to this peer while it syncs from us, 0 for no limit.  Set by the node.
+      uint32_t sync_upload_rate_limit = 0;
 
       // for inbound connections, these fields record what the peer sent us in
       // its hello message.  For outbound, they record what we sent the peer
@@ -252,6 +311,13 @@ namespace graphene { namespace net
       timestamped_items_set_type inventory_advertised_to_peer;
 
       item_to_time_map_type items_requested_from_peer;  /// items we've requested from this peer during normal operation.  fetch from another peer if this peer disconnects
+      /// number of items requested from this peer at once during normal operation, adapted to how fast it delivers them
+      uint32_t items_per_fetch_request = 1;
+      /// items per second the peer delivered the recent requests at, 0 until the first request was delivered
+      double fetch_items_per_second = 0;
+      /// when the items in items_requested_from_peer were requested, and how many
+      fc::time_point fetch_request_time;
+      uint32_t fetch_request_size = 0;
       /// @}
 
       // if they're flooding us with transactions, we set this to avoid fetching for a few seconds to let the
@@ -285,10 +351,14 @@ namespace graphene { namespace net
       void send_queueable_message(std::unique_ptr<queued_message>&& message_to_send);
       void send_message(const message& message_to_send, size_t message_send_time_field_offset = (size_t)-1);
       void send_item(const item_id& item_to_send);
+      /// sends the blocks with the given IDs as one block_batch_message, fetched from the node when it is sent
+      void send_block_batch(std::vector<item_hash_t> block_ids);
       void close_connection();
       void destroy_connection();
 
       uint64_t get_total_bytes_sent() const;
+      /** returns roughly the number of bytes of memory taken by messages waiting to be sent to the peer */
+      size_t get_queued_messages_size() const;
       uint64_t get_total_bytes_received() const;
 
       fc::time_point get_last_message_sent_time() const;
@@ -33,6 +33,7 @@
 #include <graphene/net/config.hpp>
 
 #include <atomic>
+#include <vector>
 
 #ifdef DEFAULT_LOGGER
 # undef DEFAULT_LOGGER
@@ -65,6 +66,8 @@ namespace graphene { namespace net {
 
       std::atomic_bool _send_message_in_progress;
       std::atomic_bool _read_loop_in_progress;
+      /// Holds the padded message being written, kept between calls so that send_message does not allocate
+      std::vector<char> _send_buffer;
 #ifndef NDEBUG
       fc::thread* _thread;
 #endif
@@ -273,16 +276,23 @@ namespace graphene { namespace net {
            elog("Trying to send a message larger than MAX_MESSAGE_SIZE. This probably won't work...");
         //pad the message we send to a multiple of 16 bytes
         size_t size_with_padding = 16 * ((size_of_message_and_header + 15) / 16);
-        std::unique_ptr<char[]> padded_message(new char[size_with_padding]);
+        if( _send_buffer.size() < size_with_padding )
+           _send_buffer.resize(size_with_padding);
+        char* padded_message = _send_buffer.data();
 
-        memcpy(padded_message.get(), (char*)&message_to_send, sizeof(message_header));
-        memcpy(padded_message.get() + sizeof(message_header), message_to_send.data.data(), message_to_send.size.value() );
-        char* padding_space = padded_message.get() + sizeof(message_header) + message_to_send.size.value();
+        memcpy(padded_message, (char*)&message_to_send, sizeof(message_header));
+        memcpy(padded_message + sizeof(message_header), message_to_send.data.data(), message_to_send.size.value() );
+        char* padding_space = padded_message + sizeof(message_header) + message_to_send.size.value();
         memset(padding_space, 0, size_with_padding - size_of_message_and_header);
-        _sock.write(padded_message.get(), size_with_padding);
+        _sock.write(padded_message, size_with_padding);
         _sock.flush();
         _bytes_sent += size_with_padding;
         _last_message_sent_time = fc::time_point::now();
+
+        // don't hold on to the memory of an occasional large message (e.g. a full block) for the
+        // lifetime of the connection
+        if( _send_buffer.size() > GRAPHENE_NET_MAX_RETAINED_SEND_BUFFER_SIZE )
+           std::vector<char>().swap(_send_buffer);
       } FC_RETHROW_EXCEPTIONS( warn, "unable to send message" );
     }
 
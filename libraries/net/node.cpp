@@ -41,6 +41,7 @@
 #include <boost/multi_index/tag.hpp>
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/composite_key.hpp>
 #include <boost/logic/tribool.hpp>
 #include <boost/range/algorithm_ext/push_back.hpp>
 #include <boost/range/algorithm/find.hpp>
@@ -179,8 +180,11 @@ namespace graphene { namespace net {
       void block_accepted();
       void cache_message( const message& message_to_cache, const message_hash_type& hash_of_message_to_cache,
                         const message_propagation_data& propagation_data, const fc::uint160_t& message_content_hash );
-      message get_message( const message_hash_type& hash_of_message_to_lookup );
+      /// @param contents_hash if not null, receives the hash of the message contents, i.e. the block ID of blocks
+      message get_message( const message_hash_type& hash_of_message_to_lookup, fc::uint160_t* contents_hash = nullptr );
       message_propagation_data get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const;
+      /// @return a cached message with the given contents hash, e.g. the transaction with the given ID
+      fc::optional<message> find_message_by_contents_hash( const fc::uint160_t& hash_of_message_contents_to_lookup ) const;
       size_t size() const { return _message_cache.size(); }
     };
 
@@ -204,12 +208,17 @@ namespace graphene { namespace net {
                                          message_content_hash ) );
     }
 
-    message blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup )
+    message blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup,
+                                                        fc::uint160_t* contents_hash )
     {
       message_cache_container::index<message_hash_index>::type::const_iterator iter =
          _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
       if( iter != _message_cache.get<message_hash_index>().end() )
+      {
+        if( contents_hash != nullptr )
+          *contents_hash = iter->message_contents_hash;
         return iter->message_body;
+      }
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
     }
 
@@ -225,6 +234,16 @@ namespace graphene { namespace net {
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
     }
 
+    fc::optional<message> blockchain_tied_message_cache::find_message_by_contents_hash(
+          const fc::uint160_t& hash_of_message_contents_to_lookup ) const
+    {
+      message_cache_container::index<message_contents_hash_index>::type::const_iterator iter =
+         _message_cache.get<message_contents_hash_index>().find(hash_of_message_contents_to_lookup );
+      if( iter != _message_cache.get<message_contents_hash_index>().end() )
+        return iter->message_body;
+      return fc::optional<message>();
+    }
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 
     // This specifies configuration info for the local node.  It's stored as JSON
@@ -318,7 +337,10 @@ namespace graphene { namespace net { namespace detail {
       _node_is_shutting_down(false),
       _maximum_number_of_blocks_to_handle_at_one_time(MAXIMUM_NUMBER_OF_BLOCKS_TO_HANDLE_AT_ONE_TIME),
       _maximum_number_of_sync_blocks_to_prefetch(MAXIMUM_NUMBER_OF_BLOCKS_TO_PREFETCH),
-      _maximum_blocks_per_peer_during_syncing(GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING)
+      _maximum_blocks_per_peer_during_syncing(GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING),
+      _maximum_sync_blocks_memory(GRAPHENE_NET_MAX_SYNC_BLOCKS_MEMORY_IN_BYTES),
+      _maximum_sync_upload_rate_per_peer(GRAPHENE_NET_DEFAULT_SYNC_UPLOAD_RATE_PER_PEER),
+      _sync_upload_share_percent(GRAPHENE_NET_DEFAULT_SYNC_UPLOAD_SHARE_PERCENT)
     {
       _rate_limiter.set_actual_rate_time_constant(fc::seconds(2));
       fc::rand_bytes((char*) _node_id.data(), (int)_node_id.size());
@@ -484,8 +506,7 @@ namespace graphene { namespace net { namespace detail {
     bool node_impl::have_already_received_sync_item( const item_hash_t& item_hash )
     {
       VERIFY_CORRECT_THREAD();
-      return std::find_if(_received_sync_items.begin(), _received_sync_items.end(),
-                          [&item_hash]( const graphene::net::block_message& message ) { return message.block_id == item_hash; } ) != _received_sync_items.end() ||
+      return _received_sync_items.find(item_hash) != _received_sync_items.end() ||
              std::find_if(_new_received_sync_items.begin(), _new_received_sync_items.end(),
                           [&item_hash]( const graphene::net::block_message& message ) { return message.block_id == item_hash; } ) != _new_received_sync_items.end();                          ;
     }
@@ -523,6 +544,12 @@ namespace graphene { namespace net { namespace detail {
         _sync_items_to_fetch_updated = false;
         dlog( "beginning another iteration of the sync items loop" );
 
+        // When the blocks waiting to be processed fill the memory budget, only the first block each peer has for
+        // us is fetched. The waiting blocks may all be orphans that cannot be processed before that one arrives.
+        const bool sync_blocks_memory_full = _received_sync_items_size >= _maximum_sync_blocks_memory;
+        if (!_suspend_fetching_sync_blocks && sync_blocks_memory_full)
+          dlog("fetch_sync_items_loop is throttled, we hold ${size} bytes of sync blocks waiting to be processed",
+               ("size", _received_sync_items_size));
         if (!_suspend_fetching_sync_blocks)
         {
           std::map<peer_connection_ptr, std::vector<item_hash_t> > sync_item_requests_to_send;
@@ -541,7 +568,10 @@ namespace graphene { namespace net { namespace detail {
                 if (!peer->inhibit_fetching_sync_blocks)
                 {
                   // loop through the items it has that we don't yet have on our blockchain
-                  for( unsigned i = 0; i < peer->ids_of_items_to_get.size(); ++i )
+                  const size_t items_to_consider = sync_blocks_memory_full
+                                                   ? std::min<size_t>( 1, peer->ids_of_items_to_get.size() )
+                                                   : peer->ids_of_items_to_get.size();
+                  for( unsigned i = 0; i < items_to_consider; ++i )
                   {
                     item_hash_t item_to_potentially_request = peer->ids_of_items_to_get[i];
                     // if we don't already have this item in our temporary storage and we haven't requested from another syncing peer
@@ -618,14 +648,23 @@ namespace graphene { namespace net { namespace detail {
         {
           peer_connection_ptr peer;
           std::vector<item_id> item_ids;
-          peer_and_items_to_fetch(const peer_connection_ptr& peer) : peer(peer) {}
+          /// measured round trip delay to the peer, peers we haven't measured yet sort last
+          int64_t round_trip_delay_us;
+          peer_and_items_to_fetch(const peer_connection_ptr& peer) :
+            peer(peer),
+            round_trip_delay_us(peer->round_trip_delay > fc::microseconds() ? peer->round_trip_delay.count()
+                                                                            : fc::microseconds::maximum().count())
+          {}
           bool operator<(const peer_and_items_to_fetch& rhs) const { return peer < rhs.peer; }
           size_t number_of_items() const { return item_ids.size(); }
         };
+        // among peers with equally many requests pending, ask the one with the lowest latency first
         typedef boost::multi_index_container<peer_and_items_to_fetch,
                                              boost::multi_index::indexed_by<boost::multi_index::ordered_unique<boost::multi_index::member<peer_and_items_to_fetch, peer_connection_ptr, &peer_and_items_to_fetch::peer> >,
                                                                             boost::multi_index::ordered_non_unique<boost::multi_index::tag<requested_item_count_index>,
-                                                                                                                   boost::multi_index::const_mem_fun<peer_and_items_to_fetch, size_t, &peer_and_items_to_fetch::number_of_items> > > > fetch_messages_to_send_set;
+                                                                                                                   boost::multi_index::composite_key<peer_and_items_to_fetch,
+                                                                                                                                                     boost::multi_index::const_mem_fun<peer_and_items_to_fetch, size_t, &peer_and_items_to_fetch::number_of_items>,
+                                                                                                                                                     boost::multi_index::member<peer_and_items_to_fetch, int64_t, &peer_and_items_to_fetch::round_trip_delay_us> > > > > fetch_messages_to_send_set;
         fetch_messages_to_send_set items_by_peer;
 
         // initialize the fetch_messages_to_send with an empty set of items for all idle peers
@@ -652,7 +691,7 @@ namespace graphene { namespace net { namespace detail {
             {
               const peer_connection_ptr& peer = peer_iter->peer;
               // if they have the item and we haven't already decided to ask them for too many other items
-              if (peer_iter->item_ids.size() < GRAPHENE_NET_MAX_ITEMS_PER_PEER_DURING_NORMAL_OPERATION &&
+              if (peer_iter->item_ids.size() < peer->items_per_fetch_request &&
                   peer->inventory_peer_advertised_to_us.find(item_iter->item) != peer->inventory_peer_advertised_to_us.end())
               {
                 if (item_iter->item.item_type == graphene::net::trx_message_type && peer->is_transaction_fetching_inhibited())
@@ -680,6 +719,11 @@ namespace graphene { namespace net { namespace detail {
         // we've figured out which peer will be providing each item, now send the messages.
         for (const peer_and_items_to_fetch& peer_and_items : items_by_peer)
         {
+          if (!peer_and_items.item_ids.empty())
+          {
+            peer_and_items.peer->fetch_request_time = fc::time_point::now();
+            peer_and_items.peer->fetch_request_size = peer_and_items.item_ids.size();
+          }
           // the item lists are heterogenous and
           // the fetch_items_message can only deal with one item type at a time.  
           std::map<uint32_t, std::vector<item_hash_t> > items_to_fetch_by_type;
@@ -717,6 +761,26 @@ namespace graphene { namespace net { namespace detail {
       } // while (!canceled)
     }
 
+    void node_impl::on_fetch_request_completed( peer_connection* peer )
+    {
+      VERIFY_CORRECT_THREAD();
+      if (peer->fetch_request_size == 0)
+        return;
+      const int64_t elapsed_us = std::max<int64_t>((fc::time_point::now() - peer->fetch_request_time).count(), 1);
+      const double items_per_second = peer->fetch_request_size * 1000000.0 / elapsed_us;
+      peer->fetch_items_per_second = peer->fetch_items_per_second > 0
+                                     ? (3 * peer->fetch_items_per_second + items_per_second) / 4
+                                     : items_per_second;
+      // a single item is delivered at about one item per round trip, larger requests measure the throughput
+      const double target = peer->fetch_items_per_second * GRAPHENE_NET_FETCH_ITEMS_TARGET_DELAY_MS / 1000;
+      // only a request that used up the limit shows whether the peer could deliver more
+      const uint32_t max_size = peer->fetch_request_size >= peer->items_per_fetch_request
+                                ? 2 * peer->items_per_fetch_request : peer->items_per_fetch_request;
+      peer->items_per_fetch_request = (uint32_t)std::max(1.0, std::min({target, (double)max_size,
+                                                         (double)GRAPHENE_NET_MAX_ITEMS_PER_PEER_DURING_NORMAL_OPERATION}));
+      peer->fetch_request_size = 0;
+    }
+
     void node_impl::trigger_fetch_items_loop()
     {
       VERIFY_CORRECT_THREAD();
@@ -743,7 +807,6 @@ namespace graphene { namespace net { namespace detail {
         for (const peer_connection_ptr& peer : _active_connections)
         {
           // only advertise to peers who are in sync with us
-          idump((peer->peer_needs_sync_items_from_us));
           if( !peer->peer_needs_sync_items_from_us )
           {
             std::map<uint32_t, std::vector<item_hash_t> > items_to_advertise_by_type;
@@ -751,7 +814,6 @@ namespace graphene { namespace net { namespace detail {
             // or anything it has advertised to us
             // group the items we need to send by type, because we'll need to send one inventory message per type
             unsigned total_items_to_send_to_this_peer = 0;
-            idump((inventory_to_advertise));
             for (const item_id& item_to_advertise : inventory_to_advertise)
             {
                auto adv_to_peer = peer->inventory_advertised_to_peer.find(item_to_advertise);
@@ -767,13 +829,6 @@ namespace graphene { namespace net { namespace detail {
                   testnetlog("advertising transaction ${id} to peer ${endpoint}", ("id", item_to_advertise.item_hash)("endpoint", peer->get_remote_endpoint()));
                 dlog("advertising item ${id} to peer ${endpoint}", ("id", item_to_advertise.item_hash)("endpoint", peer->get_remote_endpoint()));
               }
-              else
-              {
-                 if (adv_to_peer != peer->inventory_advertised_to_peer.end() )
-                    idump( (*adv_to_peer) );
-                 if (adv_to_us != peer->inventory_peer_advertised_to_us.end() )
-                    idump( (*adv_to_us) );
-              }
             }
               dlog("advertising ${count} new item(s) of ${types} type(s) to peer ${endpoint}",
                    ("count", total_items_to_send_to_this_peer)
@@ -789,19 +844,32 @@ namespace graphene { namespace net { namespace detail {
           iter->first->send_message(iter->second);
         inventory_messages_to_send.clear();
 
-        if (_new_inventory.empty())
+        // after a large batch, give more transactions a moment to accumulate rather than waking up
+        // for each one
+        const bool batch_next_inventory = inventory_to_advertise.size() >= GRAPHENE_NET_INVENTORY_BATCHING_THRESHOLD;
+        if (_new_inventory.empty() || batch_next_inventory)
         {
           _retrigger_advertise_inventory_loop_promise = fc::promise<void>::create("graphene::net::retrigger_advertise_inventory_loop");
-          _retrigger_advertise_inventory_loop_promise->wait();
+          _advertise_inventory_batching = batch_next_inventory;
+          try
+          {
+            _retrigger_advertise_inventory_loop_promise->wait( batch_next_inventory ?
+                  fc::milliseconds(GRAPHENE_NET_INVENTORY_BATCH_INTERVAL_MS) : fc::microseconds::maximum() );
+          }
+          catch (const fc::timeout_exception&)
+          {
+            // done batching, advertise what has accumulated
+          }
+          _advertise_inventory_batching = false;
           _retrigger_advertise_inventory_loop_promise.reset();
         }
       } // while(!canceled)
     }
 
-    void node_impl::trigger_advertise_inventory_loop()
+    void node_impl::trigger_advertise_inventory_loop(bool urgent)
     {
       VERIFY_CORRECT_THREAD();
-      if( _retrigger_advertise_inventory_loop_promise )
+      if( _retrigger_advertise_inventory_loop_promise && ( urgent || !_advertise_inventory_batching ) )
         _retrigger_advertise_inventory_loop_promise->set_value();
     }
 
@@ -1254,9 +1322,31 @@ namespace graphene { namespace net { namespace detail {
       }
     }
 
+    static bool is_known_message_type( uint32_t type )
+    {
+      return type == trx_message_type || type == block_message_type ||
+             (type > core_message_type_first && type <= block_batch_message_type);
+    }
+
     void node_impl::on_message( peer_connection* originating_peer, const message& received_message )
     {
       VERIFY_CORRECT_THREAD();
+      // account for the message however its handler exits
+      struct handling_time_recorder
+      {
+        received_message_statistics& statistics;
+        fc::time_point start_time = fc::time_point::now();
+        ~handling_time_recorder()
+        {
+          fc::microseconds handling_time = fc::time_point::now() - start_time;
+          statistics.total_handling_time += handling_time;
+          statistics.max_handling_time = std::max(statistics.max_handling_time, handling_time);
+        }
+      } recorder{_received_message_statistics[is_known_message_type(received_message.msg_type.value()) ?
+                                              received_message.msg_type.value() : unknown_message_types]};
+      ++recorder.statistics.count;
+      recorder.statistics.bytes += received_message.size.value();
+
       message_hash_type message_hash = received_message.id();
       dlog("handling message ${type} ${hash} size ${size} from peer ${endpoint}",
            ("type", graphene::net::core_message_type_enum(received_message.msg_type.value()))("hash", message_hash)
@@ -1291,6 +1381,15 @@ namespace graphene { namespace net { namespace detail {
       case core_message_type_enum::item_not_available_message_type:
         on_item_not_available_message(originating_peer, received_message.as<item_not_available_message>());
         break;
+      case core_message_type_enum::compact_block_message_type:
+        on_compact_block_message(originating_peer, received_message.as<compact_block_message>());
+        break;
+      case core_message_type_enum::fetch_full_block_message_type:
+        on_fetch_full_block_message(originating_peer, received_message.as<fetch_full_block_message>());
+        break;
+      case core_message_type_enum::block_batch_message_type:
+        on_block_batch_message(originating_peer, received_message.as<block_batch_message>());
+        break;
       case core_message_type_enum::item_ids_inventory_message_type:
         on_item_ids_inventory_message(originating_peer, received_message.as<item_ids_inventory_message>());
         break;
@@ -1361,6 +1460,10 @@ namespace graphene { namespace net { namespace detail {
       if (!_hard_fork_block_numbers.empty())
         user_data["last_known_fork_block_number"] = _hard_fork_block_numbers.back();
 
+      user_data["accepts_pushed_blocks"] = true;
+      user_data["accepts_compact_blocks"] = true;
+      user_data["accepts_block_batches"] = true;
+
       return user_data;
     }
     void node_impl::parse_hello_user_data_for_peer(peer_connection* originating_peer, const fc::variant_object& user_data)
@@ -1383,6 +1486,12 @@ namespace graphene { namespace net { namespace detail {
         originating_peer->node_id = user_data["node_id"].as<node_id_t>(1);
       if (user_data.contains("last_known_fork_block_number"))
         originating_peer->last_known_fork_block_number = user_data["last_known_fork_block_number"].as<uint32_t>(1);
+      if (user_data.contains("accepts_pushed_blocks"))
+        originating_peer->accepts_pushed_blocks = user_data["accepts_pushed_blocks"].as<bool>(1);
+      if (user_data.contains("accepts_compact_blocks"))
+        originating_peer->accepts_compact_blocks = user_data["accepts_compact_blocks"].as<bool>(1);
+      if (user_data.contains("accepts_block_batches"))
+        originating_peer->accepts_block_batches = user_data["accepts_block_batches"].as<bool>(1);
     }
 
     void node_impl::on_hello_message( peer_connection* originating_peer, const hello_message& hello_message_received )
@@ -2256,20 +2365,23 @@ namespace graphene { namespace net { namespace detail {
            ("type", fetch_items_message_received.item_type)
            ("endpoint", originating_peer->get_remote_endpoint()));
 
-      fc::optional<message> last_block_message_sent;
+      // the ID of the last block we send, taken from the cache or the request so that the blocks need not be unpacked
+      fc::optional<item_hash_t> last_block_id_sent;
 
-      std::list<message> reply_messages;
+      // the replies, with the block ID of block messages
+      std::list<std::pair<message, item_hash_t> > reply_messages;
       for (const item_hash_t& item_hash : fetch_items_message_received.items_to_fetch)
       {
         try
         {
-          message requested_message = _message_cache.get_message(item_hash);
+          fc::uint160_t contents_hash;
+          message requested_message = _message_cache.get_message(item_hash, &contents_hash);
           dlog("received item request for item ${id} from peer ${endpoint}, returning the item from my message cache",
                ("endpoint", originating_peer->get_remote_endpoint())
                ("id", requested_message.id()));
-          reply_messages.push_back(requested_message);
+          reply_messages.emplace_back(requested_message, contents_hash);
           if (fetch_items_message_received.item_type == block_message_type)
-            last_block_message_sent = requested_message;
+            last_block_id_sent = contents_hash;
           continue;
         }
         catch (fc::key_not_found_exception&)
@@ -2285,34 +2397,146 @@ namespace graphene { namespace net { namespace detail {
                ("id", requested_message.id())
                ("size", requested_message.size)
                ("endpoint", originating_peer->get_remote_endpoint()));
-          reply_messages.push_back(requested_message);
+          // the delegate looks blocks up by their ID
+          reply_messages.emplace_back(requested_message, item_hash);
           if (fetch_items_message_received.item_type == block_message_type)
-            last_block_message_sent = requested_message;
+            last_block_id_sent = item_hash;
           continue;
         }
         catch (fc::key_not_found_exception&)
         {
-          reply_messages.push_back(item_not_available_message(item_to_fetch));
+          reply_messages.emplace_back(item_not_available_message(item_to_fetch), item_hash_t());
           dlog("received item request from peer ${endpoint} but we don't have it",
                ("endpoint", originating_peer->get_remote_endpoint()));
         }
       }
 
       // if we sent them a block, update our record of the last block they've seen accordingly
-      if (last_block_message_sent)
+      if (last_block_id_sent)
+      {
+        originating_peer->last_block_delegate_has_seen = *last_block_id_sent;
+        originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(*last_block_id_sent);
+      }
+
+      // a peer that is in sync with us most likely has the transactions of new blocks already
+      const bool send_compact_blocks = originating_peer->accepts_compact_blocks &&
+                                       !originating_peer->peer_needs_sync_items_from_us;
+      originating_peer->sync_upload_rate_limit = get_sync_upload_rate_limit_per_peer();
+      // a syncing peer gets runs of consecutive blocks in as few messages as possible
+      const bool send_block_batches = originating_peer->accepts_block_batches &&
+                                      originating_peer->peer_needs_sync_items_from_us;
+      std::vector<item_hash_t> block_batch;
+      size_t block_batch_size = 0;
+      const auto send_block_batch = [&]() {
+        if (block_batch.size() == 1)
+          originating_peer->send_item(item_id(block_message_type, block_batch.front()));
+        else if (!block_batch.empty())
+          originating_peer->send_block_batch(std::move(block_batch));
+        block_batch.clear();
+        block_batch_size = 0;
+      };
+      for (const auto& reply : reply_messages)
+      {
+        if (reply.first.msg_type.value() == block_message_type && send_block_batches)
+        {
+          // the entry of each block is its data with a size prefix of at most 5 bytes
+          const size_t entry_size = reply.first.data.size() + 5;
+          if (block_batch_size + entry_size > GRAPHENE_NET_MAX_BLOCK_BATCH_SIZE_IN_BYTES)
+            send_block_batch();
+          block_batch.push_back(reply.second);
+          block_batch_size += entry_size;
+          continue;
+        }
+        send_block_batch();
+        if (reply.first.msg_type.value() != block_message_type)
+          originating_peer->send_message(reply.first);
+        else if (send_compact_blocks)
+          originating_peer->send_message(compact_block_message(reply.first.as<graphene::net::block_message>()));
+        else
+          originating_peer->send_item(item_id(block_message_type, reply.second));
+      }
+      send_block_batch();
+    }
+
+    void node_impl::on_block_batch_message( peer_connection* originating_peer,
+                                            const block_batch_message& block_batch_message_received )
+    {
+      VERIFY_CORRECT_THREAD();
+      dlog("received batch of ${n} block(s) from peer ${endpoint}",
+           ("n", block_batch_message_received.block_messages.size())
+           ("endpoint", originating_peer->get_remote_endpoint()));
+      for (const std::vector<char>& block_message_data : block_batch_message_received.block_messages)
       {
-        graphene::net::block_message block = last_block_message_sent->as<graphene::net::block_message>();
-        originating_peer->last_block_delegate_has_seen = block.block_id;
-        originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(block.block_id);
+        message block_message_received;
+        block_message_received.msg_type = block_message_type;
+        block_message_received.size = (uint32_t)block_message_data.size();
+        block_message_received.data = block_message_data;
+        process_block_message(originating_peer, block_message_received, block_message_received.id());
       }
+    }
+
+    void node_impl::on_compact_block_message( peer_connection* originating_peer,
+                                              const compact_block_message& compact_block_message_received )
+    {
+      VERIFY_CORRECT_THREAD();
+      dlog("received compact block ${id} with ${n} transaction(s) from peer ${endpoint}",
+           ("id", compact_block_message_received.block_id)
+           ("n", compact_block_message_received.transactions.size())
+           ("endpoint", originating_peer->get_remote_endpoint()));
 
-      for (const message& reply : reply_messages)
+      // rebuild the block from the transactions we know
+      graphene::net::block_message rebuilt_block;
+      static_cast<signed_block_header&>(rebuilt_block.block) = compact_block_message_received.header;
+      rebuilt_block.block_id = compact_block_message_received.block_id;
+      rebuilt_block.block.transactions.reserve(compact_block_message_received.transactions.size());
+      bool have_all_transactions = true;
+      for (const auto& compact_trx : compact_block_message_received.transactions)
       {
-        if (reply.msg_type.value() == block_message_type)
-          originating_peer->send_item(item_id(block_message_type, reply.as<graphene::net::block_message>().block_id));
-        else
-          originating_peer->send_message(reply);
+        fc::optional<message> trx_message_found = _message_cache.find_message_by_contents_hash(compact_trx.id);
+        if (!trx_message_found || trx_message_found->msg_type.value() != trx_message_type)
+        {
+          have_all_transactions = false;
+          break;
+        }
+        graphene::protocol::processed_transaction trx(trx_message_found->as<trx_message>().trx);
+        trx.operation_results = compact_trx.operation_results;
+        rebuilt_block.block.transactions.push_back(std::move(trx));
+      }
+
+      if (have_all_transactions)
+      {
+        // Only take the rebuilt block if it is exactly the block we asked for, i.e. if it has the message hash we
+        // requested it by, or for a sync request by block id, if its header has that id and its transactions are
+        // the ones of the header.  A transaction with the same ID but different signatures would otherwise make
+        // us reject a valid block and disconnect from the peer who sent it.
+        const message rebuilt_message(rebuilt_block);
+        const message_hash_type rebuilt_message_hash = rebuilt_message.id();
+        const bool requested_for_sync =
+            originating_peer->sync_items_requested_from_peer.find(rebuilt_block.block_id)
+              != originating_peer->sync_items_requested_from_peer.end() &&
+            rebuilt_block.block.id() == rebuilt_block.block_id &&
+            rebuilt_block.block.calculate_merkle_root() == rebuilt_block.block.transaction_merkle_root;
+        if (originating_peer->items_requested_from_peer.find(item_id(graphene::net::block_message_type, rebuilt_message_hash))
+              != originating_peer->items_requested_from_peer.end() ||
+            requested_for_sync)
+        {
+          process_block_message(originating_peer, rebuilt_message, rebuilt_message_hash);
+          return;
+        }
       }
+
+      dlog("unable to rebuild compact block ${id}, asking peer ${endpoint} for the whole block",
+           ("id", compact_block_message_received.block_id)
+           ("endpoint", originating_peer->get_remote_endpoint()));
+      originating_peer->send_message(fetch_full_block_message(compact_block_message_received.block_id));
+    }
+
+    void node_impl::on_fetch_full_block_message( peer_connection* originating_peer,
+                                                 const fetch_full_block_message& fetch_full_block_message_received )
+    {
+      VERIFY_CORRECT_THREAD();
+      // the block is fetched from the delegate by its ID when it is about to be sent
+      originating_peer->send_item(item_id(block_message_type, fetch_full_block_message_received.block_id));
     }
 
     void node_impl::on_item_not_available_message( peer_connection* originating_peer, const item_not_available_message& item_not_available_message_received )
@@ -2323,6 +2547,8 @@ namespace graphene { namespace net { namespace detail {
       if (regular_item_iter != originating_peer->items_requested_from_peer.end())
       {
         originating_peer->items_requested_from_peer.erase( regular_item_iter );
+        if (originating_peer->items_requested_from_peer.empty())
+          on_fetch_request_completed(originating_peer);
         originating_peer->inventory_peer_advertised_to_us.erase( requested_item );
         if (is_item_in_any_peers_inventory(requested_item))
           _items_to_fetch.insert(prioritized_item_id(requested_item, _items_to_fetch_sequence_counter++));
@@ -2767,84 +2993,97 @@ namespace graphene { namespace net { namespace detail {
 
       do
       {
-        std::copy(std::make_move_iterator(_new_received_sync_items.begin()),
-                  std::make_move_iterator(_new_received_sync_items.end()),
-                  std::front_inserter(_received_sync_items));
+        for (graphene::net::block_message& new_sync_item : _new_received_sync_items)
+        {
+          const item_hash_t block_id = new_sync_item.block_id;
+          if (_received_sync_items.find(block_id) != _received_sync_items.end())
+            _received_sync_items_size -= fc::raw::pack_size(new_sync_item.block); // a duplicate, dropped
+          else
+            _received_sync_items.emplace(block_id, std::move(new_sync_item));
+        }
         _new_received_sync_items.clear();
         dlog("currently ${count} sync items to consider", ("count", _received_sync_items.size()));
 
         block_processed_this_iteration = false;
-        for (auto received_block_iter = _received_sync_items.begin();
-             received_block_iter != _received_sync_items.end();
-             ++received_block_iter)
+
+        // the next block on the active chain or one of the forks is the first item a syncing peer still has for us,
+        // look those up instead of checking every received block against every peer
+        auto received_block_iter = _received_sync_items.end();
+        for (const peer_connection_ptr& peer : _active_connections)
         {
+          ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
+          if (!peer->ids_of_items_to_get.empty())
+          {
+            received_block_iter = _received_sync_items.find(peer->ids_of_items_to_get.front());
+            if (received_block_iter != _received_sync_items.end())
+              break;
+          }
+        }
 
-          // find out if this block is the next block on the active chain or one of the forks
-          bool potential_first_block = false;
+        // if there is one, process it, remove it from all sync peers lists
+        if (received_block_iter != _received_sync_items.end())
+        {
+          const item_hash_t received_block_id = received_block_iter->first;
           for (const peer_connection_ptr& peer : _active_connections)
           {
             ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
             if (!peer->ids_of_items_to_get.empty() &&
-                peer->ids_of_items_to_get.front() == received_block_iter->block_id)
+                peer->ids_of_items_to_get.front() == received_block_id)
             {
-              potential_first_block = true;
               peer->ids_of_items_to_get.pop_front();
-              peer->ids_of_items_being_processed.insert(received_block_iter->block_id);
+              peer->ids_of_items_being_processed.insert(received_block_id);
             }
           }
 
-          // if it is, process it, remove it from all sync peers lists
-          if (potential_first_block)
+          // we can get into an interesting situation near the end of synchronization.  We can be in
+          // sync with one peer who is sending us the last block on the chain via a regular inventory
+          // message, while at the same time still be synchronizing with a peer who is sending us the
+          // block through the sync mechanism.  Further, we must request both blocks because
+          // we don't know they're the same (for the peer in normal operation, it has only told us the
+          // message id, for the peer in the sync case we only known the block_id).
+          if (std::find(_most_recent_blocks_accepted.begin(), _most_recent_blocks_accepted.end(),
+                        received_block_id) == _most_recent_blocks_accepted.end())
           {
-            // we can get into an interesting situation near the end of synchronization.  We can be in
-            // sync with one peer who is sending us the last block on the chain via a regular inventory
-            // message, while at the same time still be synchronizing with a peer who is sending us the
-            // block through the sync mechanism.  Further, we must request both blocks because
-            // we don't know they're the same (for the peer in normal operation, it has only told us the
-            // message id, for the peer in the sync case we only known the block_id).
-            if (std::find(_most_recent_blocks_accepted.begin(), _most_recent_blocks_accepted.end(),
-                          received_block_iter->block_id) == _most_recent_blocks_accepted.end())
-            {
-              graphene::net::block_message block_message_to_process = *received_block_iter;
-              _received_sync_items.erase(received_block_iter);
-              _handle_message_calls_in_progress.emplace_back(fc::async([this, block_message_to_process](){
-                send_sync_block_to_node_delegate(block_message_to_process);
-              }, "send_sync_block_to_node_delegate"));
-              ++blocks_processed;
-              block_processed_this_iteration = true;
-            }
-            else
+            graphene::net::block_message block_message_to_process = std::move(received_block_iter->second);
+            _received_sync_items.erase(received_block_iter);
+            _received_sync_items_size -= fc::raw::pack_size(block_message_to_process.block);
+            _handle_message_calls_in_progress.emplace_back(fc::async([this, block_message_to_process](){
+              send_sync_block_to_node_delegate(block_message_to_process);
+            }, "send_sync_block_to_node_delegate"));
+            ++blocks_processed;
+            block_processed_this_iteration = true;
+          }
+          else
+          {
+            dlog("Already received and accepted this block (presumably through normal inventory mechanism), treating it as accepted");
+            _received_sync_items_size -= fc::raw::pack_size(received_block_iter->second.block);
+            _received_sync_items.erase(received_block_iter);
+            std::vector< peer_connection_ptr > peers_needing_next_batch;
+            for (const peer_connection_ptr& peer : _active_connections)
             {
-              dlog("Already received and accepted this block (presumably through normal inventory mechanism), treating it as accepted");
-              std::vector< peer_connection_ptr > peers_needing_next_batch;
-              for (const peer_connection_ptr& peer : _active_connections)
+              auto items_being_processed_iter = peer->ids_of_items_being_processed.find(received_block_id);
+              if (items_being_processed_iter != peer->ids_of_items_being_processed.end())
               {
-                auto items_being_processed_iter = peer->ids_of_items_being_processed.find(received_block_iter->block_id);
-                if (items_being_processed_iter != peer->ids_of_items_being_processed.end())
+                peer->ids_of_items_being_processed.erase(items_being_processed_iter);
+                dlog("Removed item from ${endpoint}'s list of items being processed, still processing ${len} blocks",
+                     ("endpoint", peer->get_remote_endpoint())("len", peer->ids_of_items_being_processed.size()));
+
+                // if we just processed the last item in our list from this peer, we will want to
+                // send another request to find out if we are now in sync (this is normally handled in
+                // send_sync_block_to_node_delegate)
+                if (peer->ids_of_items_to_get.empty() &&
+                    peer->number_of_unfetched_item_ids == 0 &&
+                    peer->ids_of_items_being_processed.empty())
                 {
-                  peer->ids_of_items_being_processed.erase(items_being_processed_iter);
-                  dlog("Removed item from ${endpoint}'s list of items being processed, still processing ${len} blocks",
-                       ("endpoint", peer->get_remote_endpoint())("len", peer->ids_of_items_being_processed.size()));
-
-                  // if we just processed the last item in our list from this peer, we will want to
-                  // send another request to find out if we are now in sync (this is normally handled in
-                  // send_sync_block_to_node_delegate)
-                  if (peer->ids_of_items_to_get.empty() &&
-                      peer->number_of_unfetched_item_ids == 0 &&
-                      peer->ids_of_items_being_processed.empty())
-                  {
-                    dlog("We received last item in our list for peer ${endpoint}, setup to do a sync check", ("endpoint", peer->get_remote_endpoint()));
-                    peers_needing_next_batch.push_back( peer );
-                  }
+                  dlog("We received last item in our list for peer ${endpoint}, setup to do a sync check", ("endpoint", peer->get_remote_endpoint()));
+                  peers_needing_next_batch.push_back( peer );
                 }
               }
-              for( const peer_connection_ptr& peer : peers_needing_next_batch )
-                fetch_next_batch_of_item_ids_from_peer(peer.get());
             }
-
-            break; // start iterating _received_sync_items from the beginning
-          } // end if potential_first_block
-        } // end for each block in _received_sync_items
+            for( const peer_connection_ptr& peer : peers_needing_next_batch )
+              fetch_next_batch_of_item_ids_from_peer(peer.get());
+          }
+        }
 
         if (_handle_message_calls_in_progress.size() >= _maximum_number_of_blocks_to_handle_at_one_time)
         {
@@ -2877,9 +3116,10 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       dlog( "received a sync block from peer ${endpoint}", ("endpoint", originating_peer->get_remote_endpoint() ) );
 
-      // add it to the front of _received_sync_items, then process _received_sync_items to try to
+      // add it to _new_received_sync_items, then process the received sync items to try to
       // pass as many messages as possible to the client.
       _new_received_sync_items.push_front( block_message_to_process );
+      _received_sync_items_size += fc::raw::pack_size(block_message_to_process.block);
       trigger_process_backlog_of_sync_blocks();
     }
 
@@ -2930,7 +3170,7 @@ namespace graphene { namespace net { namespace detail {
             //}
           }
           if (new_transaction_discovered)
-            trigger_advertise_inventory_loop();
+            trigger_advertise_inventory_loop(false);
         }
         else
           dlog( "Already received and accepted this block (presumably through sync mechanism), treating it as accepted" );
@@ -2958,7 +3198,7 @@ namespace graphene { namespace net { namespace detail {
           peer->clear_old_inventory();
         }
         message_propagation_data propagation_data{message_receive_time, message_validated_time, originating_peer->node_id};
-        broadcast( block_message_to_process, propagation_data );
+        broadcast_block( block_message_to_process, message_hash, block_message_to_process.block_id, propagation_data );
         _message_cache.block_accepted();
 
         if (is_hard_fork_block(block_number))
@@ -3053,6 +3293,8 @@ namespace graphene { namespace net { namespace detail {
       if (item_iter != originating_peer->items_requested_from_peer.end())
       {
         originating_peer->items_requested_from_peer.erase(item_iter);
+        if (originating_peer->items_requested_from_peer.empty())
+          on_fetch_request_completed(originating_peer);
         process_block_during_normal_operation(originating_peer, block_message_to_process, message_hash);
         if (originating_peer->idle())
           trigger_fetch_items_loop();
@@ -3106,6 +3348,21 @@ namespace graphene { namespace net { namespace detail {
         }
       }
 
+      // we told the peer that we accept blocks it pushes to us without being asked, as long as we are not
+      // synchronizing with it
+      if (!originating_peer->we_need_sync_items_from_peer)
+      {
+        dlog("received pushed block ${block_id} from peer ${endpoint}",
+             ("endpoint", originating_peer->get_remote_endpoint())
+             ("block_id", block_message_to_process.block_id));
+        // remember that the peer has it, so that we don't advertise it back
+        originating_peer->inventory_peer_advertised_to_us.insert(
+              peer_connection::timestamped_item_id(item_id(graphene::net::block_message_type, message_hash),
+                                                   fc::time_point::now()));
+        process_block_during_normal_operation(originating_peer, block_message_to_process, message_hash);
+        return;
+      }
+
       // if we get here, we didn't request the message, we must have a misbehaving peer
       wlog("received a block ${block_id} I didn't ask for from peer ${endpoint}, disconnecting from peer",
            ("endpoint", originating_peer->get_remote_endpoint())
@@ -3406,6 +3663,8 @@ namespace graphene { namespace net { namespace detail {
       else
       {
         originating_peer->items_requested_from_peer.erase( iter );
+        if (originating_peer->items_requested_from_peer.empty())
+          on_fetch_request_completed(originating_peer);
         if (originating_peer->idle())
           trigger_fetch_items_loop();
 
@@ -4490,8 +4749,9 @@ namespace graphene { namespace net { namespace detail {
       if( item_to_broadcast.msg_type.value() == graphene::net::block_message_type )
       {
         graphene::net::block_message block_message_to_broadcast = item_to_broadcast.as<graphene::net::block_message>();
-        hash_of_message_contents = block_message_to_broadcast.block_id; // for debugging
-        _most_recent_blocks_accepted.push_back( block_message_to_broadcast.block_id );
+        broadcast_block( item_to_broadcast, item_to_broadcast.id(), block_message_to_broadcast.block_id,
+                         propagation_data );
+        return;
       }
       else if( item_to_broadcast.msg_type.value() == graphene::net::trx_message_type )
       {
@@ -4503,6 +4763,16 @@ namespace graphene { namespace net { namespace detail {
 
       _message_cache.cache_message( item_to_broadcast, hash_of_item_to_broadcast, propagation_data, hash_of_message_contents );
       _new_inventory.insert( item_id(item_to_broadcast.msg_type.value(), hash_of_item_to_broadcast ) );
+      trigger_advertise_inventory_loop( false );
+    }
+
+    void node_impl::broadcast_block( const message& block_to_broadcast, const message_hash_type& message_hash,
+                                     const block_id_type& block_id, const message_propagation_data& propagation_data )
+    {
+      VERIFY_CORRECT_THREAD();
+      _most_recent_blocks_accepted.push_back( block_id );
+      _message_cache.cache_message( block_to_broadcast, message_hash, propagation_data, block_id );
+      _new_inventory.insert( item_id( graphene::net::block_message_type, message_hash ) );
       trigger_advertise_inventory_loop();
     }
 
@@ -4514,6 +4784,32 @@ namespace graphene { namespace net { namespace detail {
       broadcast( item_to_broadcast, propagation_data );
     }
 
+    void node_impl::push_block_to_peers( const block_message& block )
+    {
+      VERIFY_CORRECT_THREAD();
+      const message block_message_to_push( block );
+      const item_id block_item_id( graphene::net::block_message_type, block_message_to_push.id() );
+      // pick the peers first and send afterwards, sending may yield
+      std::vector<peer_connection_ptr> peers_to_push_to;
+      for( const peer_connection_ptr& peer : _active_connections )
+      {
+        ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
+        if( peer->accepts_pushed_blocks && !peer->peer_needs_sync_items_from_us )
+        {
+          // keeps the advertise inventory loop from offering the block to the peer again
+          peer->inventory_advertised_to_peer.insert( peer_connection::timestamped_item_id( block_item_id,
+                                                                                           fc::time_point::now() ) );
+          peer->last_block_delegate_has_seen = block.block_id;
+          peer->last_block_time_delegate_has_seen = block.block.timestamp;
+          peers_to_push_to.push_back( peer );
+        }
+      }
+      for( const peer_connection_ptr& peer : peers_to_push_to )
+        peer->send_message( block_message_to_push );
+      message_propagation_data propagation_data{fc::time_point::now(), fc::time_point::now(), _node_id};
+      broadcast_block( block_message_to_push, block_item_id.item_hash, block.block_id, propagation_data );
+    }
+
     void node_impl::sync_from(const item_id& current_head_block, const std::vector<uint32_t>& hard_fork_block_numbers)
     {
       VERIFY_CORRECT_THREAD();
@@ -4554,6 +4850,12 @@ namespace graphene { namespace net { namespace detail {
         _maximum_number_of_sync_blocks_to_prefetch = params["maximum_number_of_sync_blocks_to_prefetch"].as<uint32_t>(1);
       if (params.contains("maximum_blocks_per_peer_during_syncing"))
         _maximum_blocks_per_peer_during_syncing = params["maximum_blocks_per_peer_during_syncing"].as<uint32_t>(1);
+      if (params.contains("maximum_sync_blocks_memory"))
+        _maximum_sync_blocks_memory = params["maximum_sync_blocks_memory"].as<uint64_t>(1);
+      if (params.contains("maximum_sync_upload_rate_per_peer"))
+        _maximum_sync_upload_rate_per_peer = params["maximum_sync_upload_rate_per_peer"].as<uint32_t>(1);
+      if (params.contains("sync_upload_share_percent"))
+        _sync_upload_share_percent = std::min<uint32_t>(params["sync_upload_share_percent"].as<uint32_t>(1), 100);
 
       _desired_number_of_connections = std::min(_desired_number_of_connections, _maximum_number_of_connections);
 
@@ -4573,6 +4875,10 @@ namespace graphene { namespace net { namespace detail {
       result["maximum_number_of_blocks_to_handle_at_one_time"] = _maximum_number_of_blocks_to_handle_at_one_time;
       result["maximum_number_of_sync_blocks_to_prefetch"] = _maximum_number_of_sync_blocks_to_prefetch;
       result["maximum_blocks_per_peer_during_syncing"] = _maximum_blocks_per_peer_during_syncing;
+      result["maximum_sync_blocks_memory"] = _maximum_sync_blocks_memory;
+      result["maximum_sync_upload_rate_per_peer"] = _maximum_sync_upload_rate_per_peer;
+      result["sync_upload_share_percent"] = _sync_upload_share_percent;
+      result["sync_upload_rate_limit_per_peer"] = get_sync_upload_rate_limit_per_peer();
       return result;
     }
 
@@ -4619,6 +4925,24 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       _rate_limiter.set_upload_limit( upload_bytes_per_second );
       _rate_limiter.set_download_limit( download_bytes_per_second );
+      _total_upload_limit = upload_bytes_per_second;
+    }
+
+    uint32_t node_impl::get_sync_upload_rate_limit_per_peer() const
+    {
+      VERIFY_CORRECT_THREAD();
+      uint32_t limit = _maximum_sync_upload_rate_per_peer;
+      if (_total_upload_limit > 0 && _sync_upload_share_percent < 100)
+      {
+        const size_t syncing_peers = std::count_if(_active_connections.begin(), _active_connections.end(),
+                                                   [](const peer_connection_ptr& peer) {
+                                                     return peer->peer_needs_sync_items_from_us;
+                                                   });
+        const uint32_t share = std::max<uint64_t>(1, (uint64_t)_total_upload_limit * _sync_upload_share_percent / 100
+                                                     / std::max<size_t>(syncing_peers, 1));
+        limit = limit > 0 ? std::min(limit, share) : share;
+      }
+      return limit;
     }
 
     void node_impl::disable_peer_advertising()
@@ -4643,6 +4967,37 @@ namespace graphene { namespace net { namespace detail {
       info["firewalled"] = fc::variant( _is_firewalled, 1 );
       return info;
     }
+    fc::variant_object node_impl::get_message_statistics() const
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::mutable_variant_object statistics;
+      statistics["_note"] = "Messages received since startup by type, times are in microseconds";
+      for (const auto& type_and_statistics : _received_message_statistics)
+      {
+        const received_message_statistics& received = type_and_statistics.second;
+        fc::mutable_variant_object type_statistics;
+        type_statistics["count"] = received.count;
+        type_statistics["bytes"] = received.bytes;
+        type_statistics["total_handling_time"] = received.total_handling_time.count();
+        type_statistics["mean_handling_time"] = received.count ? received.total_handling_time.count() / (int64_t)received.count : 0;
+        type_statistics["max_handling_time"] = received.max_handling_time.count();
+        const uint32_t type = type_and_statistics.first;
+        if (type == unknown_message_types)
+          statistics["unknown"] = type_statistics;
+        else
+          statistics[fc::reflector<core_message_type_enum>::to_string(type)] = type_statistics;
+      }
+
+      fc::mutable_variant_object send_queues;
+      for (const peer_connection_ptr& peer : _active_connections)
+      {
+        fc::optional<fc::ip::endpoint> endpoint = peer->get_remote_endpoint();
+        send_queues[endpoint ? (std::string)*endpoint : std::string()] = peer->get_queued_messages_size();
+      }
+      statistics["send_queue_bytes_by_peer"] = send_queues;
+      return statistics;
+    }
+
     fc::variant_object node_impl::network_get_usage_stats() const
     {
       VERIFY_CORRECT_THREAD();
@@ -4775,6 +5130,11 @@ namespace graphene { namespace net { namespace detail {
     INVOKE_IN_IMPL(broadcast, msg);
   }
 
+  void node::push_block_to_peers( const block_message& block )
+  {
+    INVOKE_IN_IMPL(push_block_to_peers, block);
+  }
+
   void node::sync_from(const item_id& current_head_block, const std::vector<uint32_t>& hard_fork_block_numbers)
   {
     INVOKE_IN_IMPL(sync_from, current_head_block, hard_fork_block_numbers);
@@ -4846,6 +5206,11 @@ namespace graphene { namespace net { namespace detail {
     INVOKE_IN_IMPL(network_get_info);
   }
 
+  fc::variant_object node::get_message_statistics() const
+  {
+    INVOKE_IN_IMPL(get_message_statistics);
+  }
+
   fc::variant_object node::network_get_usage_stats() const
   {
     INVOKE_IN_IMPL(network_get_usage_stats);
@@ -4860,7 +5225,11 @@ namespace graphene { namespace net { namespace detail {
   {
     node_delegate* delegate;
     fc::future<void> message_sender_task_done;
-    std::queue<message> messages_to_deliver;
+    /** messages with the time they arrive at the node */
+    std::queue<std::pair<message, fc::time_point>> messages_to_deliver;
+    /** time at which the link has finished sending the messages queued so far */
+    fc::time_point link_busy_until;
+    simulated_link_statistics statistics;
     node_info(node_delegate* delegate) : delegate(delegate) {}
   };
 
@@ -4877,9 +5246,14 @@ namespace graphene { namespace net { namespace detail {
   {
     while (!destination_node->messages_to_deliver.empty())
     {
+      const fc::microseconds time_until_arrival = destination_node->messages_to_deliver.front().second - fc::time_point::now();
+      if (time_until_arrival.count() > 0)
+        fc::usleep(time_until_arrival);
       try
       {
-        const message& message_to_deliver = destination_node->messages_to_deliver.front();
+        const message& message_to_deliver = destination_node->messages_to_deliver.front().first;
+        ++destination_node->statistics.messages_delivered;
+        destination_node->statistics.bytes_delivered += sizeof(message_header) + message_to_deliver.size.value();
         if (message_to_deliver.msg_type.value() == trx_message_type)
           destination_node->delegate->handle_transaction(message_to_deliver.as<trx_message>());
         else if (message_to_deliver.msg_type.value() == block_message_type)
@@ -4900,9 +5274,22 @@ namespace graphene { namespace net { namespace detail {
 
   void simulated_network::broadcast( const message& item_to_broadcast  )
   {
+    const fc::time_point now = fc::time_point::now();
+    const uint64_t message_size = sizeof(message_header) + item_to_broadcast.size.value();
+    std::uniform_real_distribution<double> loss_distribution(0, 1);
     for (node_info* network_node_info : network_nodes)
     {
-      network_node_info->messages_to_deliver.emplace(item_to_broadcast);
+      // the message occupies the link even if it is lost on the way
+      fc::time_point& busy_until = network_node_info->link_busy_until;
+      busy_until = std::max(busy_until, now);
+      if (link_parameters.bytes_per_second > 0)
+        busy_until += fc::microseconds(message_size * 1000000 / link_parameters.bytes_per_second);
+      if (link_parameters.loss_rate > 0 && loss_distribution(loss_generator) < link_parameters.loss_rate)
+      {
+        ++network_node_info->statistics.messages_dropped;
+        continue;
+      }
+      network_node_info->messages_to_deliver.emplace(item_to_broadcast, busy_until + link_parameters.latency);
       if (!network_node_info->message_sender_task_done.valid() || network_node_info->message_sender_task_done.ready())
         network_node_info->message_sender_task_done = fc::async([=](){ message_sender(network_node_info); }, "simulated_network_sender");
     }
@@ -4913,6 +5300,24 @@ namespace graphene { namespace net { namespace detail {
     network_nodes.push_back(new node_info(node_delegate_to_add));
   }
 
+  void simulated_network::set_link_parameters( const simulated_link_parameters& parameters )
+  {
+    link_parameters = parameters;
+    loss_generator.seed(parameters.random_seed);
+  }
+
+  std::vector<simulated_link_statistics> simulated_network::get_link_statistics() const
+  {
+    std::vector<simulated_link_statistics> result;
+    result.reserve(network_nodes.size());
+    for (const node_info* network_node_info : network_nodes)
+    {
+      result.push_back(network_node_info->statistics);
+      result.back().messages_in_flight = network_node_info->messages_to_deliver.size();
+    }
+    return result;
+  }
+
   namespace detail
   {
 #define ROLLING_WINDOW_SIZE 1000
@@ -5017,6 +5422,9 @@ namespace graphene { namespace net { namespace detail {
 
     bool statistics_gathering_node_delegate_wrapper::has_item( const net::item_id& id )
     {
+      // don't queue behind a block being applied on the delegate's thread if the answer is known already
+      if( _node_delegate->has_item_concurrently( id ) )
+        return true;
       INVOKE_AND_COLLECT_STATISTICS(has_item, id);
     }
 
@@ -5044,6 +5452,9 @@ namespace graphene { namespace net { namespace detail {
 
     message statistics_gathering_node_delegate_wrapper::get_item( const item_id& id )
     {
+      fc::optional<message> item = _node_delegate->get_item_concurrently( id );
+      if( item )
+        return std::move( *item );
       INVOKE_AND_COLLECT_STATISTICS(get_item, id);
     }
 
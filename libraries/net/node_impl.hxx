@@ -1,5 +1,6 @@
 #pragma once
 #include <memory>
+#include <unordered_map>
 #include <fc/thread/thread.hpp>
 #include <fc/log/logger.hpp>
 #include <fc/network/tcp_socket.hpp>
@@ -208,7 +209,10 @@ class node_impl : public peer_connection_delegate
 
       active_sync_requests_map              _active_sync_requests; /// list of sync blocks we've asked for from peers but have not yet received
       std::list<graphene::net::block_message> _new_received_sync_items; /// list of sync blocks we've just received but haven't yet tried to process
-      std::list<graphene::net::block_message> _received_sync_items; /// list of sync blocks we've received, but can't yet process because we are still missing blocks that come earlier in the chain
+      /// sync blocks we've received, but can't yet process because we are still missing blocks that come earlier in the chain, by block ID
+      std::unordered_map<item_hash_t, graphene::net::block_message, std::hash<item_hash_t> > _received_sync_items;
+      /// packed size of all blocks in _new_received_sync_items and _received_sync_items
+      uint64_t                              _received_sync_items_size = 0;
       // @}
 
       fc::future<void> _process_backlog_of_sync_blocks_done;
@@ -237,6 +241,7 @@ class node_impl : public peer_connection_delegate
       fc::promise<void>::ptr        _retrigger_advertise_inventory_loop_promise;
       fc::future<void>              _advertise_inventory_loop_done;
       std::unordered_set<item_id>   _new_inventory; /// list of items we have received but not yet advertised to our peers
+      bool                          _advertise_inventory_batching = false; /// true while the loop waits for more transactions to batch
       // @}
 
       fc::future<void>     _terminate_inactive_connections_loop_done;
@@ -308,6 +313,18 @@ class node_impl : public peer_connection_delegate
       fc::time_point_sec _bandwidth_monitor_last_update_time;
       fc::future<void> _bandwidth_monitor_loop_done;
 
+      /// totals for the messages we received of one type, see get_message_statistics()
+      struct received_message_statistics
+      {
+        uint64_t         count = 0;
+        uint64_t         bytes = 0;
+        fc::microseconds total_handling_time;
+        fc::microseconds max_handling_time;
+      };
+      /// by message type, the types come from the peers, so the ones this node does not know share one entry
+      std::map<uint32_t, received_message_statistics> _received_message_statistics;
+      static const uint32_t unknown_message_types = 0;
+
       fc::future<void> _dump_node_status_task_done;
 
       /* We have two alternate paths through the schedule_peer_for_deletion code -- one that
@@ -334,6 +351,14 @@ class node_impl : public peer_connection_delegate
       unsigned _maximum_number_of_blocks_to_handle_at_one_time;
       unsigned _maximum_number_of_sync_blocks_to_prefetch;
       unsigned _maximum_blocks_per_peer_during_syncing;
+      /// we stop requesting sync blocks while the ones we hold take up more than this many bytes
+      uint64_t _maximum_sync_blocks_memory;
+      /// upload limit of each syncing peer in bytes per second, 0 for no limit
+      uint32_t _maximum_sync_upload_rate_per_peer;
+      /// share of _total_upload_limit that all syncing peers together may use
+      uint32_t _sync_upload_share_percent;
+      /// the total upload limit given to _rate_limiter, 0 for no limit
+      uint32_t _total_upload_limit = 0;
 
       std::list<fc::future<void> > _handle_message_calls_in_progress;
 
@@ -354,9 +379,14 @@ class node_impl : public peer_connection_delegate
       bool is_item_in_any_peers_inventory(const item_id& item) const;
       void fetch_items_loop();
       void trigger_fetch_items_loop();
+      /** Called when the peer delivered the last item of a fetch request during normal operation, adapts the number
+       *  of items requested from it next time to the rate it delivered them at */
+      void on_fetch_request_completed( peer_connection* peer );
 
       void advertise_inventory_loop();
-      void trigger_advertise_inventory_loop();
+      /** Wakes the advertise inventory loop.  While it is batching a flood of transactions, only
+       * urgent triggers (new blocks, shutdown) cut its wait short */
+      void trigger_advertise_inventory_loop(bool urgent = true);
 
       void terminate_inactive_connections_loop();
 
@@ -407,6 +437,15 @@ class node_impl : public peer_connection_delegate
       void on_fetch_items_message( peer_connection* originating_peer,
                                    const fetch_items_message& fetch_items_message_received );
 
+      void on_compact_block_message( peer_connection* originating_peer,
+                                     const compact_block_message& compact_block_message_received );
+
+      void on_fetch_full_block_message( peer_connection* originating_peer,
+                                        const fetch_full_block_message& fetch_full_block_message_received );
+
+      void on_block_batch_message( peer_connection* originating_peer,
+                                   const block_batch_message& block_batch_message_received );
+
       void on_item_not_available_message( peer_connection* originating_peer,
                                           const item_not_available_message& item_not_available_message_received );
 
@@ -494,6 +533,10 @@ class node_impl : public peer_connection_delegate
 
       void broadcast(const message& item_to_broadcast, const message_propagation_data& propagation_data);
       void broadcast(const message& item_to_broadcast);
+      /// Broadcasts a block message whose hash and block ID are known already, without unpacking it
+      void broadcast_block(const message& block_to_broadcast, const message_hash_type& message_hash,
+                           const block_id_type& block_id, const message_propagation_data& propagation_data);
+      void push_block_to_peers(const block_message& block);
       void sync_from(const item_id& current_head_block, const std::vector<uint32_t>& hard_fork_block_numbers);
       bool is_connected() const;
       std::vector<potential_peer_record> get_potential_peers() const;
@@ -507,12 +550,15 @@ class node_impl : public peer_connection_delegate
       void                       set_allowed_peers( const std::vector<node_id_t>& allowed_peers );
       void                       clear_peer_database();
       void                       set_total_bandwidth_limit( uint32_t upload_bytes_per_second, uint32_t download_bytes_per_second );
+      /// @return the sync_upload_rate_limit for peers syncing from us, according to the current number of them
+      uint32_t                   get_sync_upload_rate_limit_per_peer() const;
       void                       disable_peer_advertising();
       fc::variant_object         get_call_statistics() const;
       message                    get_message_for_item(const item_id& item) override;
 
       fc::variant_object         network_get_info() const;
       fc::variant_object         network_get_usage_stats() const;
+      fc::variant_object         get_message_statistics() const;
 
       bool is_hard_fork_block(uint32_t block_number) const;
       uint32_t get_next_known_hard_fork_block_number(uint32_t block_number) const;
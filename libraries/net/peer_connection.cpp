@@ -31,6 +31,9 @@
 
 #include <boost/scope_exit.hpp>
 
+#include <algorithm>
+#include <numeric>
+
 #ifdef DEFAULT_LOGGER
 # undef DEFAULT_LOGGER
 #endif
@@ -71,10 +74,32 @@ namespace graphene { namespace net
       return sizeof(item_id);
     }
 
+    message peer_connection::virtual_block_batch_queued_message::get_message(peer_connection_delegate* node)
+    {
+      block_batch_message batch;
+      batch.block_messages.reserve(blocks_to_send.size());
+      for (const item_hash_t& block_id : blocks_to_send)
+      {
+        message block = node->get_message_for_item(item_id(block_message_type, block_id));
+        if (block.msg_type.value() == block_message_type)
+          batch.block_messages.emplace_back(std::move(block.data));
+        else
+        {
+          dlog("block ${id} is no longer available, leaving it out of the block batch", ("id", block_id));
+          item_not_available_messages.emplace_back(item_not_available_message(item_id(block_message_type, block_id)));
+        }
+      }
+      return batch;
+    }
+
+    size_t peer_connection::virtual_block_batch_queued_message::get_size_in_queue()
+    {
+      return sizeof(item_hash_t) * blocks_to_send.size();
+    }
+
     peer_connection::peer_connection(peer_connection_delegate* delegate) :
       _node(delegate),
       _message_connection(this),
-      _total_queued_messages_size(0),
       direction(peer_connection_direction::unknown),
       is_firewalled(firewalled_state::unknown),
       our_state(our_connection_state::disconnected),
@@ -292,10 +317,76 @@ namespace graphene { namespace net
         ~counter() { assert(_send_message_queue_tasks_counter == 1); --_send_message_queue_tasks_counter; /* dlog("leaving peer_connection::send_queued_messages_task()"); */ }
       } concurrent_invocation_counter(_send_message_queue_tasks_running);
 #endif
-      while (!_queued_messages.empty())
+      while (true)
       {
-        _queued_messages.front()->transmission_start_time = fc::time_point::now();
-        message message_to_send = _queued_messages.front()->get_message(_node);
+        // send from the highest priority class that has messages waiting, unless lower classes have been
+        // passed over too many times in a row, in which case the oldest of their messages goes next
+        queued_message_queue* queue_to_send_from = nullptr;
+        queued_message_queue* oldest_lower_priority_queue = nullptr;
+        for (queued_message_queue& queue : _queued_messages)
+        {
+          if (queue.empty())
+            continue;
+          if (!queue_to_send_from)
+            queue_to_send_from = &queue;
+          else if (!oldest_lower_priority_queue ||
+                   queue.front()->enqueue_time < oldest_lower_priority_queue->front()->enqueue_time)
+            oldest_lower_priority_queue = &queue;
+        }
+        if (!queue_to_send_from)
+          break;
+        if (!oldest_lower_priority_queue)
+          _consecutive_higher_priority_sends = 0;
+        else if (_consecutive_higher_priority_sends >= GRAPHENE_NET_MAX_CONSECUTIVE_HIGHER_PRIORITY_SENDS)
+        {
+          queue_to_send_from = oldest_lower_priority_queue;
+          _consecutive_higher_priority_sends = 0;
+        }
+        else
+          ++_consecutive_higher_priority_sends;
+
+        if (sync_upload_rate_limit > 0 && is_sync_block_payload(*queue_to_send_from))
+        {
+          // the allowance grows at the limit and holds at most one second's worth
+          const fc::time_point now = fc::time_point::now();
+          const int64_t elapsed_us = std::min<int64_t>((now - _sync_upload_allowance_time).count(), 1000000);
+          _sync_upload_allowance = std::min<int64_t>(sync_upload_rate_limit,
+                                                     _sync_upload_allowance + elapsed_us * sync_upload_rate_limit / 1000000);
+          _sync_upload_allowance_time = now;
+          if (_sync_upload_allowance < 0)
+          {
+            // the peer had its share, send anything else first or wait for the allowance to recover
+            queued_message_queue* other_queue = nullptr;
+            for (queued_message_queue& queue : _queued_messages)
+              if (&queue != queue_to_send_from && !queue.empty())
+              {
+                other_queue = &queue;
+                break;
+              }
+            if (!other_queue)
+            {
+              const int64_t time_until_allowed = -_sync_upload_allowance * 1000000 / sync_upload_rate_limit + 1;
+              // a message queued meanwhile wakes us up, so that it does not wait behind the sync blocks
+              fc::promise<void>::ptr queue_updated = fc::promise<void>::create("graphene::net::send_queue_updated");
+              _send_queue_updated_promise = queue_updated;
+              try
+              {
+                queue_updated->wait(fc::microseconds(time_until_allowed));
+              }
+              catch (const fc::timeout_exception&)
+              {
+              }
+              _send_queue_updated_promise.reset();
+              continue;
+            }
+            queue_to_send_from = other_queue;
+          }
+        }
+
+        // other tasks may add to the queues while we're sending, but that never changes the front
+        queued_message& queued_message_to_send = *queue_to_send_from->front();
+        queued_message_to_send.transmission_start_time = fc::time_point::now();
+        message message_to_send = queued_message_to_send.get_message(_node);
         try
         {
           //dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_message() "
@@ -331,22 +422,55 @@ namespace graphene { namespace net
         {
           wlog("message_oriented_exception::send_message() threw an unhandled exception");
         }
-        _queued_messages.front()->transmission_finish_time = fc::time_point::now();
-        _total_queued_messages_size -= _queued_messages.front()->get_size_in_queue();
-        _queued_messages.pop();
+        queued_message_to_send.transmission_finish_time = fc::time_point::now();
+        for (const message& followup : queued_message_to_send.get_followup_messages())
+          send_message(followup);
+        if (sync_upload_rate_limit > 0 && is_sync_block_payload(*queue_to_send_from))
+          _sync_upload_allowance -= sizeof(message_header) + message_to_send.size.value();
+        _queued_messages_size[queue_to_send_from - _queued_messages.data()] -= queued_message_to_send.get_size_in_queue();
+        queue_to_send_from->pop();
       }
       //dlog("leaving peer_connection::send_queued_messages_task() due to queue exhaustion");
     }
 
+    peer_connection::send_priority peer_connection::get_send_priority(const queued_message& message_to_send) const
+    {
+      switch (message_to_send.get_message_type())
+      {
+      case block_message_type:
+        return peer_needs_sync_items_from_us ? sync_send_priority : urgent_send_priority;
+      case block_batch_message_type:
+      case blockchain_item_ids_inventory_message_type:
+        return sync_send_priority;
+      case item_ids_inventory_message_type:
+        return inventory_send_priority;
+      case trx_message_type:
+        return transaction_send_priority;
+      default:
+        return urgent_send_priority;
+      }
+    }
+
+    bool peer_connection::is_sync_block_payload(const queued_message_queue& queue) const
+    {
+      if (&queue != &_queued_messages[sync_send_priority] || queue.empty())
+        return false;
+      const uint32_t type = queue.front()->get_message_type();
+      return type == block_message_type || type == block_batch_message_type;
+    }
+
     void peer_connection::send_queueable_message(std::unique_ptr<queued_message>&& message_to_send)
     {
       VERIFY_CORRECT_THREAD();
-      _total_queued_messages_size += message_to_send->get_size_in_queue();
-      _queued_messages.emplace(std::move(message_to_send));
-      if (_total_queued_messages_size > GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES)
+      const send_priority priority = get_send_priority(*message_to_send);
+      const size_t max_queued_size = priority == urgent_send_priority ? GRAPHENE_NET_MAXIMUM_QUEUED_URGENT_MESSAGES_IN_BYTES
+                                                                      : GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES;
+      _queued_messages_size[priority] += message_to_send->get_size_in_queue();
+      _queued_messages[priority].emplace(std::move(message_to_send));
+      if (_queued_messages_size[priority] > max_queued_size)
       {
-        wlog("send queue exceeded maximum size of ${max} bytes (current size ${current} bytes)",
-             ("max", GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES)("current", _total_queued_messages_size));
+        wlog("send queue for priority class ${priority} exceeded maximum size of ${max} bytes (current size ${current} bytes)",
+             ("priority", (uint32_t)priority)("max", max_queued_size)("current", _queued_messages_size[priority]));
         try
         {
           close_connection();
@@ -361,6 +485,12 @@ namespace graphene { namespace net
       if( _send_queued_messages_done.valid() && _send_queued_messages_done.canceled() )
         FC_THROW_EXCEPTION(fc::exception, "Attempting to send a message on a connection that is being shut down");
 
+      if (_send_queue_updated_promise)
+      {
+        fc::promise<void>::ptr queue_updated = std::move(_send_queue_updated_promise);
+        queue_updated->set_value();
+      }
+
       if (!_send_queued_messages_done.valid() || _send_queued_messages_done.ready())
       {
         //dlog("peer_connection::send_message() is firing up send_queued_message_task");
@@ -388,6 +518,13 @@ namespace graphene { namespace net
       send_queueable_message(std::move(message_to_enqueue));
     }
 
+    void peer_connection::send_block_batch(std::vector<item_hash_t> block_ids)
+    {
+      VERIFY_CORRECT_THREAD();
+      std::unique_ptr<queued_message> message_to_enqueue(new virtual_block_batch_queued_message(std::move(block_ids)));
+      send_queueable_message(std::move(message_to_enqueue));
+    }
+
     void peer_connection::close_connection()
     {
       VERIFY_CORRECT_THREAD();
@@ -410,6 +547,12 @@ namespace graphene { namespace net
       return _message_connection.get_total_bytes_sent();
     }
 
+    size_t peer_connection::get_queued_messages_size() const
+    {
+      VERIFY_CORRECT_THREAD();
+      return std::accumulate(_queued_messages_size.begin(), _queued_messages_size.end(), size_t(0));
+    }
+
     uint64_t peer_connection::get_total_bytes_received() const
     {
       VERIFY_CORRECT_THREAD();
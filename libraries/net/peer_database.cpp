@@ -28,6 +28,9 @@
 #include <boost/multi_index/mem_fun.hpp>
 #include <boost/multi_index/tag.hpp>
 
+#include <functional>
+#include <iterator>
+
 #include <fc/io/raw.hpp>
 #include <fc/io/raw_variant.hpp>
 #include <fc/log/logger.hpp>
@@ -46,11 +49,13 @@ namespace graphene { namespace net {
     public:
       struct last_seen_time_index {};
       struct endpoint_index {};
+      // most recently seen peers first, they are the likeliest to accept a connection
       typedef boost::multi_index_container<potential_peer_record, 
                                            indexed_by<ordered_non_unique<tag<last_seen_time_index>, 
                                                                          member<potential_peer_record, 
                                                                                 fc::time_point_sec, 
-                                                                                &potential_peer_record::last_seen_time> >,
+                                                                                &potential_peer_record::last_seen_time>,
+                                                                         std::greater<fc::time_point_sec> >,
                                                       hashed_unique<tag<endpoint_index>, 
                                                                     member<potential_peer_record, 
                                                                            fc::ip::endpoint, 
@@ -98,7 +103,7 @@ namespace graphene { namespace net {
           std::copy(peer_records.begin(), peer_records.end(), std::inserter(_potential_peer_set, _potential_peer_set.end()));
           if (_potential_peer_set.size() > MAXIMUM_PEERDB_SIZE)
           {
-            // prune database to a reasonable size
+            // prune database to a reasonable size, keeping the most recently seen peers
             auto iter = _potential_peer_set.begin();
             std::advance(iter, MAXIMUM_PEERDB_SIZE);
             _potential_peer_set.erase(iter, _potential_peer_set.end());
@@ -151,7 +156,20 @@ namespace graphene { namespace net {
       if (iter != _potential_peer_set.get<endpoint_index>().end())
         _potential_peer_set.get<endpoint_index>().modify(iter, [&updatedRecord](potential_peer_record& record) { record = updatedRecord; });
       else
+      {
+        // peers keep telling us about more addresses, drop the stalest so that the database
+        // (and every pass of the connect loop over it) stays bounded. A new record that is not
+        // more recent than the stalest one would be dropped right away, so it is not added.
+        if (_potential_peer_set.size() >= MAXIMUM_PEERDB_SIZE)
+        {
+          auto& last_seen_index = _potential_peer_set.get<last_seen_time_index>();
+          auto stalest = std::prev(last_seen_index.end());
+          if (updatedRecord.last_seen_time <= stalest->last_seen_time)
+            return;
+          last_seen_index.erase(stalest);
+        }
         _potential_peer_set.get<endpoint_index>().insert(updatedRecord);
+      }
     }
 
     potential_peer_record peer_database_impl::lookup_or_create_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup)
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/account_history/account_history_archive.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/endian/buffers.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace account_history {
+
+account_history_archive::account_history_archive( const fc::path& dir )
+   : _log_filename( dir / "log" ), _index_filename( dir / "index" )
+{ try {
+   fc::create_directories( dir );
+   _log.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+   if( !fc::exists( _log_filename ) )
+      _log.open( _log_filename.generic_string().c_str(),
+                 std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc );
+   else
+      _log.open( _log_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+
+   if( fc::exists( _index_filename ) )
+   {
+      std::string data;
+      fc::read_file_contents( _index_filename, data );
+      archive_index index = fc::raw::unpack<archive_index>( std::vector<char>( data.begin(), data.end() ) );
+      if( index.log_size <= fc::file_size( _log_filename ) )
+      {
+         _index = std::move( index );
+         for( const auto& account : _index.accounts )
+            _size += account.second.count;
+      }
+      else
+         wlog( "Ignoring the account history archive index, it does not match the log" );
+   }
+   scan( _index.log_size );
+   ilog( "Opened the account history archive with ${n} entries", ("n",_size) );
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+account_history_archive::~account_history_archive()
+{
+   try
+   {
+      flush();
+      save_index();
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "Failed to save the account history archive index: ${e}", ("e",e.to_detail_string()) );
+   }
+   catch( const std::exception& e )
+   {
+      elog( "Failed to save the account history archive index: ${e}", ("e",e.what()) );
+   }
+}
+
+void account_history_archive::scan( uint64_t position )
+{
+   const uint64_t file_size = fc::file_size( _log_filename );
+   while( position + sizeof( boost::endian::little_uint32_buf_t ) <= file_size )
+   {
+      boost::endian::little_uint32_buf_t record_size;
+      _log.seekg( position );
+      _log.read( (char*)&record_size, sizeof( record_size ) );
+      if( position + sizeof( record_size ) + record_size.value() > file_size )
+         break;
+      add_to_index( read( position ), position );
+      position += sizeof( record_size ) + record_size.value();
+   }
+   if( position < file_size )
+   {
+      wlog( "Dropping the incomplete last record of the account history archive" );
+      _log.close();
+      fc::resize_file( _log_filename, position );
+      _log.open( _log_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+   }
+   _index.log_size = position;
+}
+
+void account_history_archive::save_index()const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   const fc::path tmp_filename = _index_filename.generic_string() + ".tmp";
+   const std::vector<char> data = fc::raw::pack( _index );
+   {
+      std::ofstream out( tmp_filename.generic_string().c_str(), std::ofstream::binary | std::ofstream::trunc );
+      out.write( data.data(), data.size() );
+      FC_ASSERT( out, "Unable to write ${f}", ("f",tmp_filename) );
+   }
+   fc::rename( tmp_filename, _index_filename );
+}
+
+void account_history_archive::add_to_index( const archived_operation& entry, uint64_t position )
+{
+   archived_account& account = _index.accounts[entry.account];
+   archive_checkpoint checkpoint;
+   checkpoint.sequence = entry.sequence;
+   checkpoint.operation = entry.operation.id.instance();
+   checkpoint.position = position;
+   if( account.count % checkpoint_interval == 0 )
+      account.checkpoints.push_back( checkpoint );
+   account.newest = checkpoint;
+   ++account.count;
+   ++_size;
+}
+
+void account_history_archive::append( account_id_type account, uint64_t sequence, const operation_history_object& op )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   archived_operation entry;
+   entry.account = account;
+   entry.sequence = sequence;
+   auto itr = _index.accounts.find( account );
+   if( itr != _index.accounts.end() )
+   {
+      if( sequence <= itr->second.newest.sequence )
+         return;
+      entry.previous = itr->second.newest.position + 1;
+   }
+   entry.operation = op;
+
+   const std::vector<char> data = fc::raw::pack( entry );
+   const boost::endian::little_uint32_buf_t record_size( data.size() );
+   const uint64_t position = _index.log_size;
+   _log.seekp( position );
+   _log.write( (const char*)&record_size, sizeof( record_size ) );
+   _log.write( data.data(), data.size() );
+   _index.log_size += sizeof( record_size ) + data.size();
+   add_to_index( entry, position );
+}
+
+void account_history_archive::flush()
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   _log.flush();
+}
+
+archived_operation account_history_archive::read( uint64_t position )const
+{
+   boost::endian::little_uint32_buf_t record_size;
+   _log.seekg( position );
+   _log.read( (char*)&record_size, sizeof( record_size ) );
+   std::vector<char> data( record_size.value() );
+   _log.read( data.data(), data.size() );
+   return fc::raw::unpack<archived_operation>( data );
+}
+
+std::vector<operation_history_object> account_history_archive::get( account_id_type account,
+                                                                    uint64_t archive_checkpoint::* key,
+                                                                    uint64_t max_key, uint64_t min_key,
+                                                                    uint32_t limit )const
+{
+   std::vector<operation_history_object> result;
+   std::lock_guard<std::mutex> guard( _mutex );
+   auto itr = _index.accounts.find( account );
+   if( itr == _index.accounts.end() || limit == 0 || max_key < min_key )
+      return result;
+   const archived_account& entries = itr->second;
+
+   // start at the oldest checkpoint at or after max_key, the entries before it are reached by their links
+   uint64_t next = entries.newest.position + 1;
+   auto checkpoint = std::lower_bound( entries.checkpoints.begin(), entries.checkpoints.end(), max_key,
+                                       [key]( const archive_checkpoint& c, uint64_t k ) { return c.*key < k; } );
+   if( checkpoint != entries.checkpoints.end() )
+      next = checkpoint->position + 1;
+
+   while( next != 0 && result.size() < limit )
+   {
+      archived_operation entry = read( next - 1 );
+      const uint64_t entry_key = ( key == &archive_checkpoint::sequence ) ? entry.sequence
+                                                                            : entry.operation.id.instance();
+      if( entry_key < min_key )
+         break;
+      if( entry_key <= max_key )
+         result.push_back( std::move( entry.operation ) );
+      next = entry.previous;
+   }
+   return result;
+}
+
+std::vector<operation_history_object> account_history_archive::get_by_operation( account_id_type account,
+                                                                                 uint64_t max_operation,
+                                                                                 uint64_t min_operation,
+                                                                                 uint32_t limit )const
+{
+   return get( account, &archive_checkpoint::operation, max_operation, min_operation, limit );
+}
+
+std::vector<operation_history_object> account_history_archive::get_by_sequence( account_id_type account,
+                                                                                uint64_t max_sequence,
+                                                                                uint64_t min_sequence,
+                                                                                uint32_t limit )const
+{
+   return get( account, &archive_checkpoint::sequence, max_sequence, min_sequence, limit );
+}
+
+uint64_t account_history_archive::size()const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   return _size;
+}
+
+} } // graphene::account_history
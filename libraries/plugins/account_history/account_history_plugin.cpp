@@ -55,6 +55,10 @@ class account_history_plugin_impl
        * and will process/index all operations that were applied in the block.
        */
       void update_account_histories( const signed_block& b );
+      /** index the operations applied in a block, null entries are operations which are not stored */
+      void update_account_histories( const vector<optional< operation_history_object > >& hist );
+      /** removes the history records and the archive, and resets the history of the account statistics */
+      void clear_account_histories();
 
       graphene::chain::database& database()
       {
@@ -65,10 +69,49 @@ class account_history_plugin_impl
       flat_set<account_id_type> _tracked_accounts;
       bool _partial_operations = false;
       primary_index< operation_history_index >* _oho_index;
+      primary_index< account_transaction_history_index >* _ath_index;
+
+      /// The indexes may still be loading in the background, so they are used through these
+      /// @see object_database::load_in_background
+      /// @{
+      primary_index< operation_history_index >& oho_index()
+      {
+         database().wait_for_background_loads();
+         return *_oho_index;
+      }
+      primary_index< account_transaction_history_index >& ath_index()
+      {
+         database().wait_for_background_loads();
+         return *_ath_index;
+      }
+      /// @}
+
       uint64_t _max_ops_per_account = -1;
+      bool _archive_old_operations = false;
+      std::unique_ptr<account_history_archive> _archive;
+
+      /** opens the archive if it is enabled and not open yet, the database has to be open */
+      void open_archive();
    private:
-      /** add one history record, then check and remove the earliest history record */
-      void add_account_history( const account_id_type account_id, const operation_history_id_type op_id );
+      /// What the entries added while processing a block change in the statistics of an account
+      struct account_history_change
+      {
+         uint64_t                            total_ops;
+         account_transaction_history_id_type most_recent_op;
+      };
+      typedef flat_map< account_id_type, account_history_change > account_history_changes;
+
+      /** add one history record, the account statistics are updated by apply_account_history_changes */
+      void add_account_history( const account_id_type account_id, const operation_history_object& op,
+                                account_history_changes& changes );
+      /** update the statistics of the accounts at the end of a block, and remove their earliest records if too many */
+      void apply_account_history_changes( const account_history_changes& changes );
+      /**
+       * remove the earliest history records of the account beyond _max_ops_per_account in one pass
+       * @return the number of records removed, with an archive the records are kept until they are irreversible
+       */
+      uint64_t trim_account_history( const account_id_type account_id, const account_history_change& change,
+                                     const uint64_t removed_ops );
 
 };
 
@@ -77,10 +120,55 @@ account_history_plugin_impl::~account_history_plugin_impl()
    return;
 }
 
+void account_history_plugin_impl::open_archive()
+{
+   if( _archive_old_operations && !_archive )
+      _archive.reset( new account_history_archive( database().get_data_dir() / "account_history_archive" ) );
+}
+
+void account_history_plugin_impl::clear_account_histories()
+{
+   graphene::chain::database& db = database();
+   const auto& ath_idx = ath_index().indices();
+   while( !ath_idx.empty() )
+      db.remove( *ath_idx.begin() );
+   ath_index().set_next_id( account_transaction_history_id_type() );
+   const auto& oho_idx = oho_index().indices();
+   while( !oho_idx.empty() )
+      db.remove( *oho_idx.begin() );
+   oho_index().set_next_id( operation_history_id_type() );
+
+   // the ids are not changed, so the statistics are modified in place
+   for( const auto& stats : db.get_index_type<account_stats_index>().indices() )
+   {
+      if( stats.total_ops == 0 && stats.removed_ops == 0 )
+         continue;
+      db.modify( stats, []( account_statistics_object& obj ){
+         obj.most_recent_op = account_transaction_history_id_type();
+         obj.total_ops = 0;
+         obj.removed_ops = 0;
+      });
+   }
+
+   if( _archive_old_operations )
+   {
+      _archive.reset();
+      fc::remove_all( database().get_data_dir() / "account_history_archive" );
+      open_archive();
+   }
+}
+
 void account_history_plugin_impl::update_account_histories( const signed_block& b )
+{
+   update_account_histories( database().get_applied_operations() );
+}
+
+void account_history_plugin_impl::update_account_histories( const vector<optional< operation_history_object > >& hist )
 {
    graphene::chain::database& db = database();
-   const vector<optional< operation_history_object > >& hist = db.get_applied_operations();
+   // during a replay blocks are applied before the plugin is started
+   open_archive();
+   account_history_changes changes;
    bool is_first = true;
    auto skip_oho_id = [&is_first,&db,this]() {
       if( is_first && db._undo_db.enabled() ) // this ensures that the current id is rolled back on undo
@@ -89,7 +177,7 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
          is_first = false;
       }
       else
-         _oho_index->use_next_id();
+         oho_index().use_next_id();
    };
 
    for( const optional< operation_history_object >& o_op : hist )
@@ -163,7 +251,7 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
                // that indexing now happens in observers' post_evaluate()
 
                // add history
-               add_account_history( account_id, oho->id );
+               add_account_history( account_id, *oho, changes );
             }
          }
       }
@@ -183,7 +271,7 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
                {
                   if (!oho.valid()) { oho = create_oho(); }
                   // add history
-                  add_account_history( account_id, oho->id );
+                  add_account_history( account_id, *oho, changes );
                }
             }
          }
@@ -191,69 +279,146 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
       if (_partial_operations && ! oho.valid())
          skip_oho_id();
    }
+   apply_account_history_changes( changes );
+   if( _archive )
+      _archive->flush();
 }
 
-void account_history_plugin_impl::add_account_history( const account_id_type account_id, const operation_history_id_type op_id )
+void account_history_plugin_impl::add_account_history( const account_id_type account_id,
+                                                       const operation_history_object& op,
+                                                       account_history_changes& changes )
 {
    graphene::chain::database& db = database();
-   const auto& stats_obj = account_id(db).statistics(db);
+   auto itr = changes.find( account_id );
+   if( itr == changes.end() )
+   {
+      const auto& stats_obj = account_id(db).statistics(db);
+      itr = changes.emplace( account_id, account_history_change{ stats_obj.total_ops, stats_obj.most_recent_op } ).first;
+   }
    // add new entry
    const auto& ath = db.create<account_transaction_history_object>( [&]( account_transaction_history_object& obj ){
-       obj.operation_id = op_id;
+       obj.operation_id = op.id;
        obj.account = account_id;
-       obj.sequence = stats_obj.total_ops + 1;
-       obj.next = stats_obj.most_recent_op;
+       obj.sequence = itr->second.total_ops + 1;
+       obj.next = itr->second.most_recent_op;
+       obj.operation_type = static_cast<uint16_t>( op.op.which() );
    });
-   db.modify( stats_obj, [&]( account_statistics_object& obj ){
-       obj.most_recent_op = ath.id;
-       obj.total_ops = ath.sequence;
-   });
-   // remove the earliest account history entry if too many
-   // _max_ops_per_account is guaranteed to be non-zero outside
-   if( stats_obj.total_ops - stats_obj.removed_ops > _max_ops_per_account )
+   itr->second.most_recent_op = ath.id;
+   itr->second.total_ops = ath.sequence;
+}
+
+void account_history_plugin_impl::apply_account_history_changes( const account_history_changes& changes )
+{
+   graphene::chain::database& db = database();
+   for( const auto& change : changes )
    {
-      // look for the earliest entry
-      const auto& his_idx = db.get_index_type<account_transaction_history_index>();
-      const auto& by_seq_idx = his_idx.indices().get<by_seq>();
-      auto itr = by_seq_idx.lower_bound( boost::make_tuple( account_id, 0 ) );
-      // make sure don't remove the one just added
-      if( itr != by_seq_idx.end() && itr->account == account_id && itr->id != ath.id )
-      {
-         // if found, remove the entry, and adjust account stats object
-         const auto remove_op_id = itr->operation_id;
-         const auto itr_remove = itr;
-         ++itr;
-         db.remove( *itr_remove );
-         db.modify( stats_obj, [&]( account_statistics_object& obj ){
-             obj.removed_ops = obj.removed_ops + 1;
-         });
-         // modify previous node's next pointer
-         // this should be always true, but just have a check here
-         if( itr != by_seq_idx.end() && itr->account == account_id )
-         {
-            db.modify( *itr, [&]( account_transaction_history_object& obj ){
-               obj.next = account_transaction_history_id_type();
-            });
-         }
-         // else need to modify the head pointer, but it shouldn't be true
+      const auto& stats_obj = change.first(db).statistics(db);
+      // _max_ops_per_account is guaranteed to be non-zero outside
+      const uint64_t removed = trim_account_history( change.first, change.second, stats_obj.removed_ops );
+      db.modify( stats_obj, [&]( account_statistics_object& obj ){
+          obj.most_recent_op = change.second.most_recent_op;
+          obj.total_ops = change.second.total_ops;
+          obj.removed_ops = obj.removed_ops + removed;
+      });
+   }
+}
+
+uint64_t account_history_plugin_impl::trim_account_history( const account_id_type account_id,
+                                                            const account_history_change& change,
+                                                            const uint64_t removed_ops )
+{
+   if( change.total_ops - removed_ops <= _max_ops_per_account )
+      return 0;
+   const uint64_t excess = change.total_ops - removed_ops - _max_ops_per_account;
 
-         // remove the operation history entry (1.11.x) if configured and no reference left
-         if( _partial_operations )
+   graphene::chain::database& db = database();
+   const auto& his_idx = db.get_index_type<account_transaction_history_index>();
+   const auto& by_seq_idx = his_idx.indices().get<by_seq>();
+   const auto& by_opid_idx = his_idx.indices().get<by_opid>();
+   const uint32_t last_irreversible_block = db.get_dynamic_global_properties().last_irreversible_block_num;
+
+   // remove the earliest entries, but never the most recent one
+   uint64_t removed = 0;
+   auto itr = by_seq_idx.lower_bound( boost::make_tuple( account_id, 0 ) );
+   while( removed < excess && itr != by_seq_idx.end() && itr->account == account_id
+          && itr->id != change.most_recent_op )
+   {
+      if( _archive )
+      {
+         const operation_history_object* op = db.find( itr->operation_id );
+         if( op != nullptr )
          {
-            // check for references
-            const auto& by_opid_idx = his_idx.indices().get<by_opid>();
-            if( by_opid_idx.find( remove_op_id ) == by_opid_idx.end() )
-            {
-               // if no reference, remove
-               db.remove( remove_op_id(db) );
-            }
+            // only irreversible entries are archived, which a fork can not replace, the others are kept until then
+            if( op->block_num > last_irreversible_block )
+               break;
+            _archive->append( account_id, itr->sequence, *op );
          }
       }
+      const auto remove_op_id = itr->operation_id;
+      const auto itr_remove = itr;
+      ++itr;
+      db.remove( *itr_remove );
+      ++removed;
+
+      // remove the operation history entry (1.11.x) if configured and no reference left
+      if( _partial_operations && by_opid_idx.find( remove_op_id ) == by_opid_idx.end() )
+         db.remove( remove_op_id(db) );
+   }
+
+   // the earliest entry left ends the list
+   // this should be always true, but just have a check here
+   if( removed > 0 && itr != by_seq_idx.end() && itr->account == account_id )
+   {
+      db.modify( *itr, [&]( account_transaction_history_object& obj ){
+         obj.next = account_transaction_history_id_type();
+      });
    }
+   return removed;
 }
 
 } // end namespace detail
 
+void account_history_by_type_index::object_inserted( const object& obj )
+{
+   const auto& entry = static_cast<const account_transaction_history_object&>( obj );
+   if( _operations_by_type[entry.account][entry.operation_type].insert( entry.operation_id ).second )
+      ++_size;
+}
+
+void account_history_by_type_index::object_removed( const object& obj )
+{
+   const auto& entry = static_cast<const account_transaction_history_object&>( obj );
+   auto account_itr = _operations_by_type.find( entry.account );
+   if( account_itr == _operations_by_type.end() )
+      return;
+   auto type_itr = account_itr->second.find( entry.operation_type );
+   if( type_itr == account_itr->second.end() || type_itr->second.erase( entry.operation_id ) == 0 )
+      return;
+   --_size;
+   if( type_itr->second.empty() )
+      account_itr->second.erase( type_itr );
+   if( account_itr->second.empty() )
+      _operations_by_type.erase( account_itr );
+}
+
+size_t account_history_by_type_index::memory_usage()const
+{
+   // a node of a std::set holds the value and three pointers plus the color
+   return _size * ( sizeof( operation_history_id_type ) + 4 * sizeof( void* ) );
+}
+
+const std::set<operation_history_id_type>* account_history_by_type_index::find( account_id_type account,
+                                                                                  int operation_type )const
+{
+   auto account_itr = _operations_by_type.find( account );
+   if( account_itr == _operations_by_type.end() )
+      return nullptr;
+   auto type_itr = account_itr->second.find( operation_type );
+   if( type_itr == account_itr->second.end() )
+      return nullptr;
+   return &type_itr->second;
+}
+
 
 
 
@@ -282,6 +447,10 @@ void account_history_plugin::plugin_set_program_options(
          ("track-account", boost::program_options::value<std::vector<std::string>>()->composing()->multitoken(), "Account ID to track history for (may specify multiple times)")
          ("partial-operations", boost::program_options::value<bool>(), "Keep only those operations in memory that are related to account history tracking")
          ("max-ops-per-account", boost::program_options::value<uint64_t>(), "Maximum number of operations per account will be kept in memory")
+         ("archive-old-operations", boost::program_options::value<bool>(),
+          "Write the operations of irreversible blocks dropped by max-ops-per-account to an archive on disk, "
+          "from which the history API still returns them. Together with partial-operations the operations are "
+          "then kept in memory only while they are recent.")
          ;
    cfg.add(cli);
 }
@@ -290,7 +459,8 @@ void account_history_plugin::plugin_initialize(const boost::program_options::var
 {
    database().applied_block.connect( [&]( const signed_block& b){ my->update_account_histories(b); } );
    my->_oho_index = database().add_index< primary_index< operation_history_index > >();
-   database().add_index< primary_index< account_transaction_history_index > >();
+   my->_ath_index = database().add_index< primary_index< account_transaction_history_index > >();
+   my->_ath_index->add_secondary_index< account_history_by_type_index >();
 
    LOAD_VALUE_SET(options, "track-account", my->_tracked_accounts, graphene::chain::account_id_type);
    if (options.count("partial-operations")) {
@@ -299,10 +469,37 @@ void account_history_plugin::plugin_initialize(const boost::program_options::var
    if (options.count("max-ops-per-account")) {
        my->_max_ops_per_account = options["max-ops-per-account"].as<uint64_t>();
    }
+   if (options.count("archive-old-operations")) {
+       my->_archive_old_operations = options["archive-old-operations"].as<bool>();
+   }
 }
 
 void account_history_plugin::plugin_startup()
 {
+   my->open_archive();
+}
+
+void account_history_plugin::plugin_shutdown()
+{
+   // saves the index of the archive
+   my->_archive.reset();
+}
+
+bool account_history_plugin::plugin_rebuild_start()
+{
+   my->clear_account_histories();
+   return true;
+}
+
+void account_history_plugin::plugin_rebuild_block( uint32_t block_num, fc::time_point_sec block_time,
+                                                   const std::vector<operation_history_object>& ops )
+{
+   my->update_account_histories( vector<optional< operation_history_object > >( ops.begin(), ops.end() ) );
+}
+
+const account_history_archive* account_history_plugin::archive()const
+{
+   return my->_archive.get();
 }
 
 flat_set<account_id_type> account_history_plugin::tracked_accounts() const
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/operation_history_object.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace graphene { namespace account_history {
+   using namespace chain;
+
+   /// A record of the archive log
+   struct archived_operation
+   {
+      account_id_type          account;
+      uint64_t                 sequence = 0;
+      /// Position of the previous record of the account plus one, 0 for the first one
+      uint64_t                 previous = 0;
+      operation_history_object operation;
+   };
+
+   /// Where an archived entry of an account is
+   struct archive_checkpoint
+   {
+      uint64_t sequence = 0;
+      uint64_t operation = 0; ///< instance of the operation id
+      uint64_t position = 0;
+   };
+
+   struct archived_account
+   {
+      archive_checkpoint              newest;
+      uint64_t                        count = 0;
+      /// Every checkpoint_interval-th entry of the account, oldest first
+      std::vector<archive_checkpoint> checkpoints;
+   };
+
+   /// What the archive keeps in memory, also saved when it is closed
+   struct archive_index
+   {
+      uint64_t                                    log_size = 0;
+      std::map<account_id_type, archived_account> accounts;
+   };
+
+   /**
+    *  Keeps the account history entries the account_history plugin drops from memory, in an append-only log file
+    *  on disk. Each record is preceded by its size and holds the account, the sequence number of the entry and
+    *  the operation, and links to the previous record of the same account. In memory only the last record and
+    *  every checkpoint_interval-th record of each account are kept, so a lookup reads at most that many records
+    *  before the first one it returns.
+    *
+    *  Only entries of irreversible blocks are to be appended. An entry is not appended again if its sequence
+    *  number has been archived for the account already, so that the entries a fork or a replay removes from
+    *  memory again are kept once.
+    *
+    *  The index is saved when the archive is closed. On opening, the records appended since, or all of them if
+    *  there is no index, are read from the log, a record that was not written completely is dropped.
+    */
+   class account_history_archive
+   {
+      public:
+         static const uint64_t checkpoint_interval = 256;
+
+         explicit account_history_archive( const fc::path& dir );
+         ~account_history_archive();
+
+         void append( account_id_type account, uint64_t sequence, const operation_history_object& op );
+         /** Writes the appended records to the log file */
+         void flush();
+
+         /**
+          * @return the archived entries of account with an operation id instance from min_operation to
+          *         max_operation, most recent first
+          */
+         std::vector<operation_history_object> get_by_operation( account_id_type account, uint64_t max_operation,
+                                                                 uint64_t min_operation, uint32_t limit )const;
+         /**
+          * @return the archived entries of account with a sequence number from min_sequence to max_sequence,
+          *         most recent first
+          */
+         std::vector<operation_history_object> get_by_sequence( account_id_type account, uint64_t max_sequence,
+                                                                uint64_t min_sequence, uint32_t limit )const;
+
+         /** @return the number of archived entries */
+         uint64_t size()const;
+
+      private:
+         std::vector<operation_history_object> get( account_id_type account, uint64_t archive_checkpoint::* key,
+                                                    uint64_t max_key, uint64_t min_key, uint32_t limit )const;
+         archived_operation read( uint64_t position )const;
+         void add_to_index( const archived_operation& entry, uint64_t position );
+         /** Adds the records from position onwards to the index, truncates an incomplete last record */
+         void scan( uint64_t position );
+         void save_index()const;
+
+         const fc::path       _log_filename;
+         const fc::path       _index_filename;
+         mutable std::fstream _log;
+         archive_index        _index;
+         uint64_t             _size = 0;
+         mutable std::mutex   _mutex;
+   };
+
+} } // graphene::account_history
+
+FC_REFLECT( graphene::account_history::archived_operation, (account)(sequence)(previous)(operation) )
+FC_REFLECT( graphene::account_history::archive_checkpoint, (sequence)(operation)(position) )
+FC_REFLECT( graphene::account_history::archived_account, (newest)(count)(checkpoints) )
+FC_REFLECT( graphene::account_history::archive_index, (log_size)(accounts) )
@@ -23,6 +23,8 @@
  */
 #pragma once
 
+#include <graphene/account_history/account_history_archive.hpp>
+
 #include <graphene/app/plugin.hpp>
 #include <graphene/chain/database.hpp>
 
@@ -30,6 +32,9 @@
 
 #include <fc/thread/future.hpp>
 
+#include <map>
+#include <set>
+
 namespace graphene { namespace account_history {
    using namespace chain;
    //using namespace graphene::db;
@@ -56,6 +61,28 @@ enum account_history_object_type
 };
 
 
+/**
+ *  A secondary index of the account_transaction_history_index, which maps each account to the operations in its
+ *  history by operation type, so that the history of an account can be filtered by operation type without
+ *  walking all of it. The type is taken from the entry itself, so the index does not depend on the order in
+ *  which the object database loads the indexes.
+ */
+class account_history_by_type_index : public secondary_index
+{
+   public:
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+
+      virtual size_t memory_usage()const override;
+
+      /** @return the operations of the given type in the history of account, null if there are none */
+      const std::set<operation_history_id_type>* find( account_id_type account, int operation_type )const;
+
+   private:
+      std::map< account_id_type, std::map< int, std::set<operation_history_id_type> > > _operations_by_type;
+      size_t _size = 0;
+};
+
 namespace detail
 {
     class account_history_plugin_impl;
@@ -73,8 +100,15 @@ class account_history_plugin : public graphene::app::plugin
          boost::program_options::options_description& cfg) override;
       virtual void plugin_initialize(const boost::program_options::variables_map& options) override;
       virtual void plugin_startup() override;
+      virtual void plugin_shutdown() override;
+      /// The history is rebuilt from the operations, with the current track-account and partial-operations
+      virtual bool plugin_rebuild_start() override;
+      virtual void plugin_rebuild_block( uint32_t block_num, fc::time_point_sec block_time,
+                                         const std::vector<operation_history_object>& ops ) override;
 
       flat_set<account_id_type> tracked_accounts()const;
+      /// @return the archive of the entries dropped from memory, null if archive-old-operations is not set
+      const account_history_archive* archive()const;
 
       friend class detail::account_history_plugin_impl;
       std::unique_ptr<detail::account_history_plugin_impl> my;
@@ -23,6 +23,7 @@
  */
 
 #include <graphene/api_helper_indexes/api_helper_indexes.hpp>
+#include <graphene/chain/account_object.hpp>
 #include <graphene/chain/market_object.hpp>
 
 namespace graphene { namespace api_helper_indexes {
@@ -40,13 +41,15 @@ void amount_in_collateral_index::object_inserted( const object& objct )
    }
 
    {
-      auto itr = backing_collateral.find( o.debt_type() );
-      if( itr == backing_collateral.end() )
-         backing_collateral[o.debt_type()] = o.collateral;
-      else
-         itr->second += o.collateral;
+      debt_totals& totals = debt[o.debt_type()];
+      totals.backing_collateral += o.collateral;
+      totals.debt += o.debt;
+      ++totals.positions;
    }
 
+   positions.insert( collateral_position{ o.debt_type(), o.collateralization(), o.id, o.borrower,
+                                          o.collateral, o.debt } );
+
 } FC_CAPTURE_AND_RETHROW( (objct) ); }
 
 void amount_in_collateral_index::object_removed( const object& objct )
@@ -60,11 +63,17 @@ void amount_in_collateral_index::object_removed( const object& objct )
    }
 
    {
-      auto itr = backing_collateral.find( o.debt_type() );
-      if( itr != backing_collateral.end() ) // should always be true
-         itr->second -= o.collateral;
+      auto itr = debt.find( o.debt_type() );
+      if( itr != debt.end() ) // should always be true
+      {
+         itr->second.backing_collateral -= o.collateral;
+         itr->second.debt -= o.debt;
+         --itr->second.positions;
+      }
    }
 
+   positions.get<by_call_order>().erase( o.id );
+
 } FC_CAPTURE_AND_RETHROW( (objct) ); }
 
 void amount_in_collateral_index::about_to_modify( const object& objct )
@@ -86,11 +95,122 @@ share_type amount_in_collateral_index::get_amount_in_collateral( const asset_id_
 
 share_type amount_in_collateral_index::get_backing_collateral( const asset_id_type& asset )const
 { try {
-   auto itr = backing_collateral.find( asset );
-   if( itr == backing_collateral.end() ) return 0;
-   return itr->second;
+   auto itr = debt.find( asset );
+   if( itr == debt.end() ) return 0;
+   return itr->second.backing_collateral;
+} FC_CAPTURE_AND_RETHROW( (asset) ); }
+
+share_type amount_in_collateral_index::get_total_debt( const asset_id_type& asset )const
+{ try {
+   auto itr = debt.find( asset );
+   if( itr == debt.end() ) return 0;
+   return itr->second.debt;
 } FC_CAPTURE_AND_RETHROW( (asset) ); }
 
+uint64_t amount_in_collateral_index::get_positions_count( const asset_id_type& asset )const
+{
+   auto itr = debt.find( asset );
+   if( itr == debt.end() ) return 0;
+   return itr->second.positions;
+}
+
+vector<collateral_position> amount_in_collateral_index::get_positions( const asset_id_type& asset, uint32_t start,
+                                                                       uint32_t limit )const
+{ try {
+   vector<collateral_position> result;
+   const uint64_t count = get_positions_count( asset );
+   if( start >= count )
+      return result;
+   result.reserve( std::min<uint64_t>( limit, count - start ) );
+
+   const auto& by_cr_idx = positions.get<by_collateralization>();
+#if BOOST_VERSION >= 105900
+   auto itr = by_cr_idx.nth( by_cr_idx.rank( by_cr_idx.lower_bound( boost::make_tuple( asset ) ) ) + start );
+#else
+   auto itr = by_cr_idx.lower_bound( boost::make_tuple( asset ) );
+   std::advance( itr, start );
+#endif
+   for( ; itr != by_cr_idx.end() && itr->debt_asset == asset && result.size() < limit; ++itr )
+      result.push_back( *itr );
+   return result;
+} FC_CAPTURE_AND_RETHROW( (asset)(start)(limit) ); }
+
+size_t amount_in_collateral_index::memory_usage()const
+{
+   // the entry plus the nodes of both ordered indexes
+   return positions.size() * ( sizeof( collateral_position ) + 8 * sizeof( void* ) )
+          + in_collateral.size() * ( sizeof( asset_id_type ) + sizeof( share_type ) )
+          + debt.size() * ( sizeof( asset_id_type ) + sizeof( debt_totals ) );
+}
+
+void asset_holders_index::object_inserted( const object& objct )
+{ try {
+   const account_balance_object& b = static_cast<const account_balance_object&>( objct );
+   if( b.balance == 0 )
+      return;
+   holders.insert( asset_holder{ b.asset_type, b.balance, b.owner } );
+   ++holders_count[b.asset_type];
+} FC_CAPTURE_AND_RETHROW( (objct) ); }
+
+void asset_holders_index::object_removed( const object& objct )
+{ try {
+   const account_balance_object& b = static_cast<const account_balance_object&>( objct );
+   auto& by_owner_idx = holders.get<by_owner>();
+   auto itr = by_owner_idx.find( boost::make_tuple( b.owner, b.asset_type ) );
+   if( itr == by_owner_idx.end() )
+      return;
+   by_owner_idx.erase( itr );
+   auto count = holders_count.find( b.asset_type );
+   if( --count->second == 0 )
+      holders_count.erase( count );
+} FC_CAPTURE_AND_RETHROW( (objct) ); }
+
+void asset_holders_index::about_to_modify( const object& objct )
+{ try {
+   object_removed( objct );
+} FC_CAPTURE_AND_RETHROW( (objct) ); }
+
+void asset_holders_index::object_modified( const object& objct )
+{ try {
+   object_inserted( objct );
+} FC_CAPTURE_AND_RETHROW( (objct) ); }
+
+size_t asset_holders_index::memory_usage()const
+{
+   // the entry plus the nodes of both ordered indexes
+   return holders.size() * ( sizeof( asset_holder ) + 8 * sizeof( void* ) )
+          + holders_count.size() * ( sizeof( asset_id_type ) + sizeof( uint64_t ) );
+}
+
+uint64_t asset_holders_index::get_holders_count( const asset_id_type& asset )const
+{
+   auto itr = holders_count.find( asset );
+   if( itr == holders_count.end() ) return 0;
+   return itr->second;
+}
+
+vector<asset_holder> asset_holders_index::get_holders( const asset_id_type& asset, uint32_t start,
+                                                       uint32_t limit )const
+{ try {
+   vector<asset_holder> result;
+   const uint64_t count = get_holders_count( asset );
+   if( start >= count )
+      return result;
+   result.reserve( std::min<uint64_t>( limit, count - start ) );
+
+   const auto& by_balance_idx = holders.get<by_balance>();
+#if BOOST_VERSION >= 105900
+   auto itr = by_balance_idx.nth( by_balance_idx.rank( by_balance_idx.lower_bound( boost::make_tuple( asset ) ) )
+                                  + start );
+#else
+   auto itr = by_balance_idx.lower_bound( boost::make_tuple( asset ) );
+   std::advance( itr, start );
+#endif
+   for( ; itr != by_balance_idx.end() && itr->asset == asset && result.size() < limit; ++itr )
+      result.push_back( *itr );
+   return result;
+} FC_CAPTURE_AND_RETHROW( (asset)(start)(limit) ); }
+
 namespace detail
 {
 
@@ -149,6 +269,9 @@ void api_helper_indexes::plugin_startup()
    amount_in_collateral = database().add_secondary_index< primary_index<call_order_index>, amount_in_collateral_index >();
    for( const auto& call : database().get_index_type<call_order_index>().indices() )
       amount_in_collateral->object_inserted( call );
+   asset_holders = database().add_secondary_index< primary_index<account_balance_index>, asset_holders_index >();
+   for( const auto& balance : database().get_index_type<account_balance_index>().indices() )
+      asset_holders->object_inserted( balance );
 }
 
 } }
@@ -26,12 +26,37 @@
 #include <graphene/app/plugin.hpp>
 #include <graphene/protocol/types.hpp>
 
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/version.hpp>
+
+#if BOOST_VERSION >= 105900
+#include <boost/multi_index/ranked_index.hpp>
+#endif
+
 namespace graphene { namespace api_helper_indexes {
 using namespace chain;
 
+/** A margin position of an MPA, @see amount_in_collateral_index */
+struct collateral_position
+{
+   asset_id_type      debt_asset;
+   price              collateralization; ///< collateral / debt
+   call_order_id_type call_order;
+   account_id_type    borrower;
+   share_type         collateral;
+   share_type         debt;
+};
+
 /**
  *  @brief This secondary index tracks how much of each asset is locked up as collateral for MPAs, and how much
  *         collateral is backing an MPA in total.
+ *
+ *  For each MPA it also keeps the total debt, the number of margin positions and the positions ordered by
+ *  collateralization, least collateralized first. With Boost 1.59 or newer the positions are kept in a ranked
+ *  index, so that a page at an offset is found in logarithmic time.
  */
 class amount_in_collateral_index : public secondary_index
 {
@@ -41,12 +66,118 @@ class amount_in_collateral_index : public secondary_index
       virtual void about_to_modify( const object& before ) override;
       virtual void object_modified( const object& after ) override;
 
+      virtual size_t memory_usage()const override;
+
       share_type get_amount_in_collateral( const asset_id_type& asset )const;
       share_type get_backing_collateral( const asset_id_type& asset )const;
+      /** @return the debt of all margin positions of the MPA asset */
+      share_type get_total_debt( const asset_id_type& asset )const;
+      /** @return the number of margin positions of the MPA asset */
+      uint64_t get_positions_count( const asset_id_type& asset )const;
+      /** @return up to limit positions of asset, least collateralized first, skipping the first start of them */
+      vector<collateral_position> get_positions( const asset_id_type& asset, uint32_t start, uint32_t limit )const;
+
+   private:
+      /** Totals of the margin positions of an MPA */
+      struct debt_totals
+      {
+         share_type backing_collateral;
+         share_type debt;
+         uint64_t   positions = 0;
+      };
+
+      struct by_collateralization;
+      struct by_call_order;
+      typedef boost::multi_index_container<
+         collateral_position,
+         boost::multi_index::indexed_by<
+#if BOOST_VERSION >= 105900
+            boost::multi_index::ranked_unique< boost::multi_index::tag<by_collateralization>,
+#else
+            boost::multi_index::ordered_unique< boost::multi_index::tag<by_collateralization>,
+#endif
+               boost::multi_index::composite_key< collateral_position,
+                  boost::multi_index::member< collateral_position, asset_id_type,
+                                              &collateral_position::debt_asset >,
+                  boost::multi_index::member< collateral_position, price, &collateral_position::collateralization >,
+                  boost::multi_index::member< collateral_position, call_order_id_type,
+                                              &collateral_position::call_order >
+               >
+            >,
+            boost::multi_index::ordered_unique< boost::multi_index::tag<by_call_order>,
+               boost::multi_index::member< collateral_position, call_order_id_type, &collateral_position::call_order >
+            >
+         >
+      > position_multi_index_type;
+
+      flat_map<asset_id_type, share_type>  in_collateral;
+      flat_map<asset_id_type, debt_totals> debt;
+      position_multi_index_type            positions;
+};
+
+/** A non-zero balance of an asset, @see asset_holders_index */
+struct asset_holder
+{
+   asset_id_type   asset;
+   share_type      balance;
+   account_id_type owner;
+};
+
+/**
+ *  @brief This secondary index of the account balances tracks the accounts holding a non-zero balance of each
+ *         asset, ordered by balance, and counts them.
+ *
+ *  With Boost 1.59 or newer the holders are kept in a ranked index, an order-statistic tree, so that a page at
+ *  an offset is found in logarithmic time. With older versions the offset is walked.
+ */
+class asset_holders_index : public secondary_index
+{
+   public:
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual void about_to_modify( const object& before ) override;
+      virtual void object_modified( const object& after ) override;
+
+      virtual size_t memory_usage()const override;
+
+      /** @return the number of accounts holding a non-zero balance of asset */
+      uint64_t get_holders_count( const asset_id_type& asset )const;
+      /** @return up to limit holders of asset with the highest balances, skipping the first start of them */
+      vector<asset_holder> get_holders( const asset_id_type& asset, uint32_t start, uint32_t limit )const;
 
    private:
-      flat_map<asset_id_type, share_type> in_collateral;
-      flat_map<asset_id_type, share_type> backing_collateral;
+      struct by_balance;
+      struct by_owner;
+      typedef boost::multi_index_container<
+         asset_holder,
+         boost::multi_index::indexed_by<
+#if BOOST_VERSION >= 105900
+            boost::multi_index::ranked_non_unique< boost::multi_index::tag<by_balance>,
+#else
+            boost::multi_index::ordered_non_unique< boost::multi_index::tag<by_balance>,
+#endif
+               boost::multi_index::composite_key< asset_holder,
+                  boost::multi_index::member< asset_holder, asset_id_type, &asset_holder::asset >,
+                  boost::multi_index::member< asset_holder, share_type, &asset_holder::balance >,
+                  boost::multi_index::member< asset_holder, account_id_type, &asset_holder::owner >
+               >,
+               boost::multi_index::composite_key_compare<
+                  std::less< asset_id_type >,
+                  std::greater< share_type >,
+                  std::less< account_id_type >
+               >
+            >,
+            boost::multi_index::ordered_unique< boost::multi_index::tag<by_owner>,
+               boost::multi_index::composite_key< asset_holder,
+                  boost::multi_index::member< asset_holder, account_id_type, &asset_holder::owner >,
+                  boost::multi_index::member< asset_holder, asset_id_type, &asset_holder::asset >
+               >
+            >
+         >
+      > holder_multi_index_type;
+
+      holder_multi_index_type             holders;
+      flat_map<asset_id_type, uint64_t>   holders_count;
 };
 
 namespace detail
@@ -73,6 +204,7 @@ class api_helper_indexes : public graphene::app::plugin
 
    private:
       amount_in_collateral_index* amount_in_collateral = nullptr;
+      asset_holders_index* asset_holders = nullptr;
 };
 
 } } //graphene::template
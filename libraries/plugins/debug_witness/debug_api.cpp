@@ -26,6 +26,8 @@ class debug_api_impl
       void debug_push_blocks( const std::string& src_filename, uint32_t count );
       void debug_generate_blocks( const std::string& debug_key, uint32_t count );
       void debug_update_object( const fc::variant_object& update );
+      void debug_fork_from_head();
+      uint32_t debug_discard_fork();
       void debug_stream_json_objects( const std::string& filename );
       void debug_stream_json_objects_flush();
       std::shared_ptr< graphene::debug_witness_plugin::debug_witness_plugin > get_plugin();
@@ -104,6 +106,21 @@ void debug_api_impl::debug_update_object( const fc::variant_object& update )
    db->debug_update( update );
 }
 
+void debug_api_impl::debug_fork_from_head()
+{
+   std::shared_ptr< graphene::chain::database > db = app.chain_database();
+   db->debug_start_fork();
+   ilog( "Started experiment at block ${n}", ("n", db->head_block_num()) );
+}
+
+uint32_t debug_api_impl::debug_discard_fork()
+{
+   std::shared_ptr< graphene::chain::database > db = app.chain_database();
+   const uint32_t popped = db->debug_discard_fork();
+   ilog( "Discarded ${p} blocks of experiment, back at block ${n}", ("p", popped)("n", db->head_block_num()) );
+   return popped;
+}
+
 std::shared_ptr< graphene::debug_witness_plugin::debug_witness_plugin > debug_api_impl::get_plugin()
 {
    return app.get_plugin< graphene::debug_witness_plugin::debug_witness_plugin >( "debug_witness" );
@@ -141,6 +158,16 @@ void debug_api::debug_update_object( fc::variant_object update )
    my->debug_update_object( update );
 }
 
+void debug_api::debug_fork_from_head()
+{
+   my->debug_fork_from_head();
+}
+
+uint32_t debug_api::debug_discard_fork()
+{
+   return my->debug_discard_fork();
+}
+
 void debug_api::debug_stream_json_objects( std::string filename )
 {
    my->debug_stream_json_objects( filename );
@@ -59,6 +59,21 @@ class debug_api
        */
       void debug_update_object( fc::variant_object update );
 
+      /**
+       * Start an experiment at the head block. Blocks and object updates that follow can be discarded with
+       * debug_discard_fork, which restores the current state from the undo history without a replay.
+       *
+       * Plugins that write data outside of the chain state, and peers, see the blocks of the experiment, so
+       * this is meant for nodes that are not connected to the network.
+       */
+      void debug_fork_from_head();
+
+      /**
+       * Discard the blocks applied since debug_fork_from_head.
+       * @return the number of blocks that were discarded
+       */
+      uint32_t debug_discard_fork();
+
       /**
        * Start a node with given initial path.
        */
@@ -91,6 +106,8 @@ FC_API(graphene::debug_witness::debug_api,
        (debug_push_blocks)
        (debug_generate_blocks)
        (debug_update_object)
+       (debug_fork_from_head)
+       (debug_discard_fork)
        (debug_stream_json_objects)
        (debug_stream_json_objects_flush)
      )
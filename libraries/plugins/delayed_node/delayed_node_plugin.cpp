@@ -30,20 +30,41 @@
 #include <fc/network/http/websocket.hpp>
 #include <fc/rpc/websocket_api.hpp>
 #include <fc/api.hpp>
+#include <fc/io/raw.hpp>
+
+#include <deque>
+#include <mutex>
 
 namespace graphene { namespace delayed_node {
 namespace bpo = boost::program_options;
 
 namespace detail {
+
+/** Blocks received through block_api::stream_blocks, filled by the RPC callback and drained by the sync loop */
+struct block_stream {
+   std::mutex                                   mutex;
+   std::deque<graphene::app::streamed_block>    blocks;
+};
+
 struct delayed_node_plugin_impl {
    std::string remote_endpoint;
+   std::string remote_user;
+   std::string remote_password;
+   uint32_t stream_batch_size = 1000;
    fc::http::websocket_client client;
    std::shared_ptr<fc::rpc::websocket_api_connection> client_connection;
    fc::api<graphene::app::database_api> database_api;
+   /// Only set if the trusted node grants access to it and streaming is enabled
+   fc::optional< fc::api<graphene::app::block_api> > block_api;
    boost::signals2::scoped_connection client_connection_closed;
    graphene::chain::block_id_type last_received_remote_head;
    graphene::chain::block_id_type last_processed_remote_head;
 };
+
+/// Number of received blocks whose signatures and transaction IDs are computed while earlier blocks are applied
+static const size_t precompute_ahead = 64;
+/// Time after which a stream that does not deliver the next block is given up
+static const fc::microseconds stream_timeout = fc::seconds(30);
 }
 
 delayed_node_plugin::delayed_node_plugin()
@@ -57,6 +78,13 @@ void delayed_node_plugin::plugin_set_program_options(bpo::options_description& c
 {
    cli.add_options()
          ("trusted-node", boost::program_options::value<std::string>(), "RPC endpoint of a trusted validating node (required for delayed_node)")
+         ("trusted-node-user", boost::program_options::value<std::string>()->default_value(""),
+          "User name to log in to the trusted node with, to stream blocks through its block_api")
+         ("trusted-node-password", boost::program_options::value<std::string>()->default_value(""),
+          "Password to log in to the trusted node with")
+         ("delayed-node-stream-batch", boost::program_options::value<uint32_t>()->default_value(1000),
+          "Number of blocks to request at once from the block_api of the trusted node while catching up, "
+          "0 to fetch blocks one by one through the database_api")
          ;
    cfg.add(cli);
 }
@@ -67,6 +95,21 @@ void delayed_node_plugin::connect()
                               my->client.connect(my->remote_endpoint),
                               GRAPHENE_NET_MAX_NESTED_OBJECTS );
    my->database_api = my->client_connection->get_remote_api<graphene::app::database_api>(0);
+   my->block_api.reset();
+   if( my->stream_batch_size > 0 )
+   {
+      try
+      {
+         auto login = my->client_connection->get_remote_api<graphene::app::login_api>(1);
+         FC_ASSERT( login->login( my->remote_user, my->remote_password ), "Failed to log in to the trusted node" );
+         my->block_api = login->block();
+      }
+      catch( const fc::exception& e )
+      {
+         wlog( "The block_api of the trusted node is not available, fetching blocks one by one: ${e}",
+               ("e", e.to_string()) );
+      }
+   }
    my->client_connection_closed = my->client_connection->closed.connect([this] {
       connection_failed();
    });
@@ -77,6 +120,12 @@ void delayed_node_plugin::plugin_initialize(const boost::program_options::variab
    FC_ASSERT(options.count("trusted-node") > 0);
    my = std::unique_ptr<detail::delayed_node_plugin_impl>{ new detail::delayed_node_plugin_impl() };
    my->remote_endpoint = "ws://" + options.at("trusted-node").as<std::string>();
+   if( options.count("trusted-node-user") )
+      my->remote_user = options.at("trusted-node-user").as<std::string>();
+   if( options.count("trusted-node-password") )
+      my->remote_password = options.at("trusted-node-password").as<std::string>();
+   if( options.count("delayed-node-stream-batch") )
+      my->stream_batch_size = options.at("delayed-node-stream-batch").as<uint32_t>();
 }
 
 void delayed_node_plugin::sync_with_trusted_node()
@@ -100,6 +149,11 @@ void delayed_node_plugin::sync_with_trusted_node()
          break;
       }
       pass_count++;
+      if( my->block_api.valid() )
+      {
+         synced_blocks += stream_from_trusted_node( remote_dpo.last_irreversible_block_num );
+         continue;
+      }
       while( remote_dpo.last_irreversible_block_num > db.head_block_num() )
       {
          fc::optional<graphene::chain::signed_block> block = my->database_api->get_block( db.head_block_num()+1 );
@@ -113,6 +167,83 @@ void delayed_node_plugin::sync_with_trusted_node()
    }
 }
 
+uint32_t delayed_node_plugin::stream_from_trusted_node( uint32_t last_block_num )
+{
+   auto& db = database();
+   uint32_t synced_blocks = 0;
+   while( db.head_block_num() < last_block_num )
+   {
+      const uint32_t from = db.head_block_num() + 1;
+      const uint32_t to = from + std::min( last_block_num - from, my->stream_batch_size - 1 );
+      auto stream = std::make_shared<detail::block_stream>();
+      (*my->block_api)->stream_blocks( [stream]( const fc::variant& v ) {
+         auto item = v.as<graphene::app::streamed_block>( GRAPHENE_MAX_NESTED_OBJECTS );
+         std::lock_guard<std::mutex> guard( stream->mutex );
+         stream->blocks.push_back( std::move( item ) );
+      }, from, to, true );
+
+      // Blocks are unpacked and precomputed as they arrive, while the earlier ones are applied. A deque keeps
+      // the blocks in place while the precomputation refers to them.
+      std::deque< std::pair< graphene::chain::signed_block, fc::future<void> > > ready;
+      uint32_t next_num = from;
+      fc::time_point last_received = fc::time_point::now();
+      try
+      {
+         while( next_num <= to )
+         {
+            while( ready.size() < detail::precompute_ahead )
+            {
+               graphene::app::streamed_block item;
+               {
+                  std::lock_guard<std::mutex> guard( stream->mutex );
+                  if( stream->blocks.empty() )
+                     break;
+                  item = std::move( stream->blocks.front() );
+                  stream->blocks.pop_front();
+               }
+               FC_ASSERT( item.packed.valid(), "Trusted node claims it has blocks it doesn't actually have." );
+               ready.emplace_back( fc::raw::unpack<graphene::chain::signed_block>( *item.packed ),
+                                   fc::future<void>() );
+               ready.back().second = db.precompute_parallel( ready.back().first,
+                                                             graphene::chain::database::skip_nothing );
+               last_received = fc::time_point::now();
+            }
+            if( ready.empty() )
+            {
+               FC_ASSERT( fc::time_point::now() - last_received < detail::stream_timeout,
+                          "Trusted node stopped sending blocks at #${n}", ("n", next_num) );
+               fc::usleep( fc::milliseconds(10) );
+               continue;
+            }
+            auto& block = ready.front();
+            FC_ASSERT( block.first.block_num() == next_num, "Trusted node sent block #${r} instead of #${n}",
+                       ("r", block.first.block_num())("n", next_num) );
+            block.second.wait();
+            db.push_block( block.first );
+            ready.pop_front();
+            ++next_num;
+            ++synced_blocks;
+         }
+      }
+      catch( ... )
+      {
+         // the precomputations refer to the blocks, let them finish before the blocks are freed
+         for( auto& block : ready )
+         {
+            try
+            {
+               if( block.second.valid() )
+                  block.second.wait();
+            }
+            catch( ... ) {}
+         }
+         throw;
+      }
+      ilog( "Pushed blocks #${f} to #${t}", ("f", from)("t", to) );
+   }
+   return synced_blocks;
+}
+
 void delayed_node_plugin::mainloop()
 {
    while( true )
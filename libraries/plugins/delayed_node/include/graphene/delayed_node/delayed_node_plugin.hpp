@@ -46,6 +46,9 @@ protected:
    void connection_failed();
    void connect();
    void sync_with_trusted_node();
+   /** Applies the blocks up to last_block_num streamed by the block_api of the trusted node
+    *  @return the number of blocks applied */
+   uint32_t stream_from_trusted_node( uint32_t last_block_num );
 };
 
 } } //graphene::account_history
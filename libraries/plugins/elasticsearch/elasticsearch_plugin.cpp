@@ -26,6 +26,7 @@
 #include <graphene/chain/impacted.hpp>
 #include <graphene/chain/account_evaluator.hpp>
 #include <curl/curl.h>
+#include <deque>
 
 namespace graphene { namespace elasticsearch {
 
@@ -41,6 +42,13 @@ class elasticsearch_plugin_impl
       virtual ~elasticsearch_plugin_impl();
 
       bool update_account_histories( const signed_block& b );
+      /**
+       * queues the bulk lines of the blocks which became irreversible
+       * @param flush queue them even if the bulk is not full yet
+       */
+      void send_irreversible_blocks( bool flush = false );
+      /** queues what is irreversible and waits until the sender sent everything */
+      void stop_sender();
 
       graphene::chain::database& database()
       {
@@ -50,6 +58,14 @@ class elasticsearch_plugin_impl
       elasticsearch_plugin& _self;
       primary_index< operation_history_index >* _oho_index;
 
+      /// The index may still be loading in the background, so it is used through this
+      /// @see object_database::load_in_background
+      primary_index< operation_history_index >& oho_index()
+      {
+         database().wait_for_background_loads();
+         return *_oho_index;
+      }
+
       std::string _elasticsearch_node_url = "http://localhost:9200/";
       uint32_t _elasticsearch_bulk_replay = 10000;
       uint32_t _elasticsearch_bulk_sync = 100;
@@ -61,10 +77,8 @@ class elasticsearch_plugin_impl
       bool _elasticsearch_operation_string = true;
       mode _elasticsearch_mode = mode::only_save;
       CURL *curl; // curl handler
-      vector <string> bulk_lines; //  vector of op lines
-      vector<std::string> prepare;
+      graphene::utilities::bulk_body bulk; // lines of the next bulk
 
-      graphene::utilities::ES es;
       uint32_t limit_documents;
       int16_t op_type;
       operation_history_struct os;
@@ -74,6 +88,15 @@ class elasticsearch_plugin_impl
       std::string bulk_line;
       std::string index_name;
       bool is_sync = false;
+
+      /// Send only the documents of irreversible blocks
+      bool _elasticsearch_irreversible_only = false;
+      /// Bulk lines of the applied blocks which are not irreversible yet, by block number
+      std::deque< std::pair< uint32_t, graphene::utilities::bulk_body > > _pending_blocks;
+      uint32_t _elasticsearch_max_in_flight = 4;
+      uint32_t _elasticsearch_max_queued_bulks = 16;
+      /// Sends the bulks from a worker thread
+      std::unique_ptr<graphene::utilities::bulk_sender> _sender;
    private:
       bool add_elasticsearch( const account_id_type account_id, const optional<operation_history_object>& oho, const uint32_t block_number );
       const account_transaction_history_object& addNewEntry(const account_statistics_object& stats_obj,
@@ -89,11 +112,13 @@ class elasticsearch_plugin_impl
       void cleanObjects(const account_transaction_history_id_type& ath, const account_id_type& account_id);
       void createBulkLine(const account_transaction_history_object& ath);
       void prepareBulk(const account_transaction_history_id_type& ath_id);
-      void populateESstruct();
+      /** queues bulk in the sender, @return false if the plugin is not started */
+      bool send_bulk();
 };
 
 elasticsearch_plugin_impl::~elasticsearch_plugin_impl()
 {
+   stop_sender();
    if (curl) {
       curl_easy_cleanup(curl);
       curl = nullptr;
@@ -107,6 +132,12 @@ bool elasticsearch_plugin_impl::update_account_histories( const signed_block& b
    index_name = graphene::utilities::generateIndexName(b.timestamp, _elasticsearch_index_prefix);
 
    graphene::chain::database& db = database();
+   if( _elasticsearch_irreversible_only )
+   {
+      // a block number seen again means the blocks from there on were popped by a fork
+      while( !_pending_blocks.empty() && _pending_blocks.back().first >= b.block_num() )
+         _pending_blocks.pop_back();
+   }
    const vector<optional< operation_history_object > >& hist = db.get_applied_operations();
    bool is_first = true;
    auto skip_oho_id = [&is_first,&db,this]() {
@@ -116,7 +147,7 @@ bool elasticsearch_plugin_impl::update_account_histories( const signed_block& b
          is_first = false;
       }
       else
-         _oho_index->use_next_id();
+         oho_index().use_next_id();
    };
    for( const optional< operation_history_object >& o_op : hist ) {
       optional <operation_history_object> oho;
@@ -172,26 +203,54 @@ bool elasticsearch_plugin_impl::update_account_histories( const signed_block& b
             return false;
       }
    }
+   if( _elasticsearch_irreversible_only )
+   {
+      _pending_blocks.emplace_back( b.block_num(), std::move(bulk) );
+      bulk = graphene::utilities::bulk_body();
+      send_irreversible_blocks();
+   }
    // we send bulk at end of block when we are in sync for better real time client experience
-   if(is_sync)
+   else if(is_sync && !bulk.empty())
    {
-      populateESstruct();
-      if(es.bulk_lines.size() > 0)
-      {
-         prepare.clear();
-         if(!graphene::utilities::SendBulk(std::move(es)))
-            return false;
-         else
-            bulk_lines.clear();
-      }
+      if(!send_bulk())
+         return false;
    }
 
-   if(bulk_lines.size() != limit_documents)
-      bulk_lines.reserve(limit_documents);
-
    return true;
 }
 
+void elasticsearch_plugin_impl::send_irreversible_blocks( bool flush )
+{
+   const uint32_t last_irreversible_block = database().get_dynamic_global_properties().last_irreversible_block_num;
+   graphene::utilities::bulk_body lines;
+   size_t block_count = 0;
+   while( !_pending_blocks.empty() && _pending_blocks.front().first <= last_irreversible_block )
+   {
+      lines.append( _pending_blocks.front().second );
+      _pending_blocks.pop_front();
+      ++block_count;
+   }
+   if( block_count == 0 || lines.empty() )
+      return;
+   // during a replay the blocks are collected until there are enough documents for a bulk
+   if( !flush && !is_sync && lines.lines() < limit_documents )
+   {
+      _pending_blocks.emplace_front( last_irreversible_block, std::move(lines) );
+      return;
+   }
+   if( _sender )
+      _sender->queue( lines.take() );
+}
+
+void elasticsearch_plugin_impl::stop_sender()
+{
+   if( !_pending_blocks.empty() )
+      send_irreversible_blocks( true );
+   _pending_blocks.clear();
+   // sends what is queued, drops what ES does not take within the shutdown timeout of the sender
+   _sender.reset();
+}
+
 void elasticsearch_plugin_impl::checkState(const fc::time_point_sec& block_time)
 {
    if((fc::time_point::now() - block_time) < fc::seconds(30))
@@ -292,13 +351,10 @@ bool elasticsearch_plugin_impl::add_elasticsearch( const account_id_type account
    }
    cleanObjects(ath.id, account_id);
 
-   if (curl && bulk_lines.size() >= limit_documents) { // we are in bulk time, ready to add data to elasticsearech
-      prepare.clear();
-      populateESstruct();
-      if(!graphene::utilities::SendBulk(std::move(es)))
+   // in irreversible-only mode the lines are sent once their block is irreversible
+   if (curl && !_elasticsearch_irreversible_only && bulk.lines() >= limit_documents) { // we are in bulk time, ready to add data to elasticsearech
+      if(!send_bulk())
          return false;
-      else
-         bulk_lines.clear();
    }
 
    return true;
@@ -322,6 +378,7 @@ const account_transaction_history_object& elasticsearch_plugin_impl::addNewEntry
       obj.account = account_id;
       obj.sequence = stats_obj.total_ops + 1;
       obj.next = stats_obj.most_recent_op;
+      obj.operation_type = static_cast<uint16_t>( oho->op.which() );
    });
 
    return ath;
@@ -351,15 +408,9 @@ void elasticsearch_plugin_impl::createBulkLine(const account_transaction_history
 
 void elasticsearch_plugin_impl::prepareBulk(const account_transaction_history_id_type& ath_id)
 {
-   const std::string _id = fc::json::to_string(ath_id);
-   fc::mutable_variant_object bulk_header;
-   bulk_header["_index"] = index_name;
-   bulk_header["_type"] = "data";
-   bulk_header["_id"] = fc::to_string(ath_id.space_id) + "." + fc::to_string(ath_id.type_id) + "."
-                      + fc::to_string(ath_id.instance.value);
-   prepare = graphene::utilities::createBulk(bulk_header, std::move(bulk_line));
-   std::move(prepare.begin(), prepare.end(), std::back_inserter(bulk_lines));
-   prepare.clear();
+   bulk.add_action( "index", index_name, fc::to_string(ath_id.space_id) + "." + fc::to_string(ath_id.type_id) + "."
+                                        + fc::to_string(ath_id.instance.value) );
+   bulk.add_document( bulk_line );
 }
 
 void elasticsearch_plugin_impl::cleanObjects(const account_transaction_history_id_type& ath_id, const account_id_type& account_id)
@@ -391,15 +442,13 @@ void elasticsearch_plugin_impl::cleanObjects(const account_transaction_history_i
    }
 }
 
-void elasticsearch_plugin_impl::populateESstruct()
+bool elasticsearch_plugin_impl::send_bulk()
 {
-   es.curl = curl;
-   es.bulk_lines = std::move(bulk_lines);
-   es.elasticsearch_url = _elasticsearch_node_url;
-   es.auth = _elasticsearch_basic_auth;
-   es.index_prefix = _elasticsearch_index_prefix;
-   es.endpoint = "";
-   es.query = "";
+   if( !_sender )
+      return false;
+   // waits only while the queue of the sender is full
+   _sender->queue( bulk.take() );
+   return true;
 }
 
 } // end namespace detail
@@ -448,6 +497,12 @@ void elasticsearch_plugin::plugin_set_program_options(
                "Save operation as string. Needed to serve history api calls(true)")
          ("elasticsearch-mode", boost::program_options::value<uint16_t>(),
                "Mode of operation: only_save(0), only_query(1), all(2) - Default: 0")
+         ("elasticsearch-irreversible-only", boost::program_options::value<bool>(),
+               "Send the documents of a block only once it is irreversible(false)")
+         ("elasticsearch-max-in-flight", boost::program_options::value<uint32_t>(),
+               "Number of bulk requests sent at the same time, 1 keeps them in order(4)")
+         ("elasticsearch-max-queued-bulks", boost::program_options::value<uint32_t>(),
+               "Number of bulks waiting to be sent before block processing waits for ES(16)")
          ;
    cfg.add(cli);
 }
@@ -490,12 +545,29 @@ void elasticsearch_plugin::plugin_initialize(const boost::program_options::varia
          FC_THROW_EXCEPTION(graphene::chain::plugin_exception, "Elasticsearch mode not valid");
       my->_elasticsearch_mode = static_cast<mode>(options["elasticsearch-mode"].as<uint16_t>());
    }
+   if (options.count("elasticsearch-irreversible-only")) {
+      my->_elasticsearch_irreversible_only = options["elasticsearch-irreversible-only"].as<bool>();
+   }
+   if (options.count("elasticsearch-max-in-flight")) {
+      my->_elasticsearch_max_in_flight = std::max( 1u, options["elasticsearch-max-in-flight"].as<uint32_t>() );
+   }
+   if (options.count("elasticsearch-max-queued-bulks")) {
+      my->_elasticsearch_max_queued_bulks = std::max( 1u, options["elasticsearch-max-queued-bulks"].as<uint32_t>() );
+   }
 
    if(my->_elasticsearch_mode != mode::only_query) {
       if (my->_elasticsearch_mode == mode::all && !my->_elasticsearch_operation_string)
          FC_THROW_EXCEPTION(graphene::chain::plugin_exception,
                "If elasticsearch-mode is set to all then elasticsearch-operation-string need to be true");
 
+      // blocks are applied before plugin_startup() during a replay
+      graphene::utilities::bulk_sender::options_type sender_options;
+      sender_options.elasticsearch_url = my->_elasticsearch_node_url;
+      sender_options.auth = my->_elasticsearch_basic_auth;
+      sender_options.max_in_flight = my->_elasticsearch_max_in_flight;
+      sender_options.max_queued = my->_elasticsearch_max_queued_bulks;
+      my->_sender.reset( new graphene::utilities::bulk_sender( sender_options ) );
+
       database().applied_block.connect([this](const signed_block &b) {
          if (!my->update_account_histories(b))
             FC_THROW_EXCEPTION(graphene::chain::plugin_exception,
@@ -516,6 +588,11 @@ void elasticsearch_plugin::plugin_startup()
    ilog("elasticsearch ACCOUNT HISTORY: plugin_startup() begin");
 }
 
+void elasticsearch_plugin::plugin_shutdown()
+{
+   my->stop_sender();
+}
+
 operation_history_object elasticsearch_plugin::get_operation_by_id(operation_history_id_type id)
 {
    const string operation_id_string = std::string(object_id_type(id));
@@ -49,6 +49,8 @@ class es_objects_plugin_impl
       bool index_database(const vector<object_id_type>& ids, std::string action);
       bool genesis();
       void remove_from_database(object_id_type id, std::string index);
+      /** sends the pending changes, then waits until everything queued is sent */
+      void stop_sender();
 
       es_objects_plugin& _self;
       std::string _es_objects_elasticsearch_url = "http://localhost:9200/";
@@ -64,17 +66,41 @@ class es_objects_plugin_impl
       std::string _es_objects_index_prefix = "objects-";
       uint32_t _es_objects_start_es_after_block = 0;
       CURL *curl; // curl handler
-      vector <std::string> bulk;
-      vector<std::string> prepare;
+      graphene::utilities::bulk_body bulk;
 
       bool _es_objects_keep_only_current = true;
+      /// Send only the changed fields of balances and limit orders
+      bool _es_objects_partial_updates = false;
 
       uint32_t block_number;
       fc::time_point_sec block_time;
 
+      enum class change_type { create, update, remove };
+      struct pending_change {
+         change_type type;
+         const char* index;
+         uint32_t block_number;
+         fc::time_point_sec block_time;
+      };
+      /// Objects changed since the last bulk when only the current state is kept, an object is sent once however
+      /// often it changes
+      std::map< object_id_type, pending_change > _pending_changes;
+      /// Sends the bulks from a worker thread
+      std::unique_ptr<graphene::utilities::bulk_sender> _sender;
+
    private:
       template<typename T>
       void prepareTemplate(T blockchain_object, string index_name);
+      void prepare_update(const object_id_type& id, const string& index_name,
+                          fc::mutable_variant_object&& changed_fields);
+
+      /// @return the index of the objects of the type of id, or nullptr if they are not stored
+      const char* index_of(const object_id_type& id)const;
+      void add_change(const object_id_type& id, const char* index, change_type type);
+      /** writes the document of the object into bulk, @return false if it does not exist */
+      bool write_document(const object_id_type& id, const string& index_name, bool partial);
+      void write_pending_changes();
+      void send_bulk();
 };
 
 bool es_objects_plugin_impl::genesis()
@@ -112,15 +138,15 @@ bool es_objects_plugin_impl::genesis()
       });
    }
 
+   // the genesis documents have to be stored before the changes of the following blocks
+   if( _sender )
+      _sender->flush();
    graphene::utilities::ES es;
    es.curl = curl;
-   es.bulk_lines = bulk;
    es.elasticsearch_url = _es_objects_elasticsearch_url;
    es.auth = _es_objects_auth;
-   if (!graphene::utilities::SendBulk(std::move(es)))
+   if (!graphene::utilities::SendBulk(std::move(es), bulk.take()))
       FC_THROW_EXCEPTION(graphene::chain::plugin_exception, "Error inserting genesis data.");
-   else
-      bulk.clear();
 
    return true;
 }
@@ -141,110 +167,170 @@ bool es_objects_plugin_impl::index_database(const vector<object_id_type>& ids, s
       else
          limit_documents = _es_objects_bulk_replay;
 
-
+      const change_type type = ( action == "delete" ? change_type::remove
+                                 : action == "create" ? change_type::create : change_type::update );
       for (auto const &value: ids) {
-         if (value.is<proposal_object>() && _es_objects_proposals) {
-            auto obj = db.find_object(value);
-            auto p = static_cast<const proposal_object *>(obj);
-            if (p != nullptr) {
-               if (action == "delete")
-                  remove_from_database(p->id, "proposal");
-               else
-                  prepareTemplate<proposal_object>(*p, "proposal");
-            }
-         } else if (value.is<account_object>() && _es_objects_accounts) {
-            auto obj = db.find_object(value);
-            auto a = static_cast<const account_object *>(obj);
-            if (a != nullptr) {
-               if (action == "delete")
-                  remove_from_database(a->id, "account");
-               else
-                  prepareTemplate<account_object>(*a, "account");
-            }
-         } else if (value.is<asset_object>() && _es_objects_assets) {
-            auto obj = db.find_object(value);
-            auto a = static_cast<const asset_object *>(obj);
-            if (a != nullptr) {
-               if (action == "delete")
-                  remove_from_database(a->id, "asset");
-               else
-                  prepareTemplate<asset_object>(*a, "asset");
-            }
-         } else if (value.is<account_balance_object>() && _es_objects_balances) {
-            auto obj = db.find_object(value);
-            auto b = static_cast<const account_balance_object *>(obj);
-            if (b != nullptr) {
-               if (action == "delete")
-                  remove_from_database(b->id, "balance");
-               else
-                  prepareTemplate<account_balance_object>(*b, "balance");
-            }
-         } else if (value.is<limit_order_object>() && _es_objects_limit_orders) {
-            auto obj = db.find_object(value);
-            auto l = static_cast<const limit_order_object *>(obj);
-            if (l != nullptr) {
-               if (action == "delete")
-                  remove_from_database(l->id, "limitorder");
-               else
-                  prepareTemplate<limit_order_object>(*l, "limitorder");
-            }
-         } else if (value.is<asset_bitasset_data_object>() && _es_objects_asset_bitasset) {
-            auto obj = db.find_object(value);
-            auto ba = static_cast<const asset_bitasset_data_object *>(obj);
-            if (ba != nullptr) {
-               if (action == "delete")
-                  remove_from_database(ba->id, "bitasset");
-               else
-                  prepareTemplate<asset_bitasset_data_object>(*ba, "bitasset");
-            }
-         }
+         const char* index = index_of(value);
+         if (index == nullptr)
+            continue;
+         if (_es_objects_keep_only_current)
+            add_change(value, index, type);
+         else if (type != change_type::remove) // every version of the object is a document of its own
+            write_document(value, index, false);
       }
 
-      if (curl && bulk.size() >= limit_documents) { // we are in bulk time, ready to add data to elasticsearech
+      // every pending change is an action line and a document line, except deletes
+      if (curl && bulk.lines() + 2 * _pending_changes.size() >= limit_documents) { // we are in bulk time, ready to add data to elasticsearech
+         write_pending_changes();
+         send_bulk();
+      }
+   }
+
+   return true;
+}
 
-         graphene::utilities::ES es;
-         es.curl = curl;
-         es.bulk_lines = bulk;
-         es.elasticsearch_url = _es_objects_elasticsearch_url;
-         es.auth = _es_objects_auth;
+const char* es_objects_plugin_impl::index_of(const object_id_type& id)const
+{
+   if (id.is<proposal_object>())
+      return _es_objects_proposals ? "proposal" : nullptr;
+   if (id.is<account_object>())
+      return _es_objects_accounts ? "account" : nullptr;
+   if (id.is<asset_object>())
+      return _es_objects_assets ? "asset" : nullptr;
+   if (id.is<account_balance_object>())
+      return _es_objects_balances ? "balance" : nullptr;
+   if (id.is<limit_order_object>())
+      return _es_objects_limit_orders ? "limitorder" : nullptr;
+   if (id.is<asset_bitasset_data_object>())
+      return _es_objects_asset_bitasset ? "bitasset" : nullptr;
+   return nullptr;
+}
 
-         if (!graphene::utilities::SendBulk(std::move(es)))
-            return false;
-         else
-            bulk.clear();
-      }
+void es_objects_plugin_impl::add_change(const object_id_type& id, const char* index, change_type type)
+{
+   auto itr = _pending_changes.find(id);
+   if (itr == _pending_changes.end()) {
+      _pending_changes.emplace(id, pending_change{ type, index, block_number, block_time });
+      return;
+   }
+   if (type == change_type::remove && itr->second.type == change_type::create) {
+      // never sent
+      _pending_changes.erase(itr);
+      return;
    }
+   // an object created since the last bulk is still sent as a whole
+   if (type != change_type::update || itr->second.type != change_type::create)
+      itr->second.type = type;
+   itr->second.block_number = block_number;
+   itr->second.block_time = block_time;
+}
 
+bool es_objects_plugin_impl::write_document(const object_id_type& id, const string& index_name, bool partial)
+{
+   const graphene::db::object* obj = _self.database().find_object(id);
+   if (obj == nullptr)
+      return false;
+
+   if (id.is<proposal_object>())
+      prepareTemplate<proposal_object>(*static_cast<const proposal_object*>(obj), index_name);
+   else if (id.is<account_object>())
+      prepareTemplate<account_object>(*static_cast<const account_object*>(obj), index_name);
+   else if (id.is<asset_object>())
+      prepareTemplate<asset_object>(*static_cast<const asset_object*>(obj), index_name);
+   else if (id.is<account_balance_object>()) {
+      const auto& b = *static_cast<const account_balance_object*>(obj);
+      if (partial) {
+         fc::mutable_variant_object changed_fields;
+         changed_fields["balance"] = fc::variant(b.balance, GRAPHENE_NET_MAX_NESTED_OBJECTS);
+         changed_fields["maintenance_flag"] = b.maintenance_flag;
+         prepare_update(id, index_name, std::move(changed_fields));
+      }
+      else
+         prepareTemplate<account_balance_object>(b, index_name);
+   }
+   else if (id.is<limit_order_object>()) {
+      const auto& l = *static_cast<const limit_order_object*>(obj);
+      if (partial) {
+         fc::mutable_variant_object changed_fields;
+         changed_fields["for_sale"] = fc::variant(l.for_sale, GRAPHENE_NET_MAX_NESTED_OBJECTS);
+         changed_fields["deferred_fee"] = fc::variant(l.deferred_fee, GRAPHENE_NET_MAX_NESTED_OBJECTS);
+         changed_fields["deferred_paid_fee"] = fc::variant(l.deferred_paid_fee, GRAPHENE_NET_MAX_NESTED_OBJECTS);
+         prepare_update(id, index_name, std::move(changed_fields));
+      }
+      else
+         prepareTemplate<limit_order_object>(l, index_name);
+   }
+   else if (id.is<asset_bitasset_data_object>())
+      prepareTemplate<asset_bitasset_data_object>(*static_cast<const asset_bitasset_data_object*>(obj), index_name);
+   else
+      return false;
    return true;
 }
 
+void es_objects_plugin_impl::write_pending_changes()
+{
+   for (const auto& item : _pending_changes) {
+      const pending_change& change = item.second;
+      block_number = change.block_number;
+      block_time = change.block_time;
+      if (change.type == change_type::remove)
+         remove_from_database(item.first, change.index);
+      else // an object which is gone already is deleted by the notification of its removal
+         write_document(item.first, change.index,
+                        _es_objects_partial_updates && change.type == change_type::update);
+   }
+   _pending_changes.clear();
+
+   graphene::chain::database &db = _self.database();
+   block_time = db.head_block_time();
+   block_number = db.head_block_num();
+}
+
+void es_objects_plugin_impl::send_bulk()
+{
+   if (bulk.empty())
+      return;
+   if (_sender)
+      _sender->queue(bulk.take()); // waits only while the queue of the sender is full
+   else
+      bulk.take();
+}
+
+void es_objects_plugin_impl::stop_sender()
+{
+   if (!_sender)
+      return;
+   write_pending_changes();
+   send_bulk();
+   // sends what is queued, drops what ES does not take within the shutdown timeout of the sender
+   _sender.reset();
+}
+
 void es_objects_plugin_impl::remove_from_database( object_id_type id, std::string index)
 {
    if(_es_objects_keep_only_current)
    {
-      fc::mutable_variant_object delete_line;
-      delete_line["_id"] = string(id);
-      delete_line["_index"] = _es_objects_index_prefix + index;
-      delete_line["_type"] = "data";
-      fc::mutable_variant_object final_delete_line;
-      final_delete_line["delete"] = delete_line;
-      prepare.push_back(fc::json::to_string(final_delete_line));
-      std::move(prepare.begin(), prepare.end(), std::back_inserter(bulk));
-      prepare.clear();
+      bulk.add_action( "delete", _es_objects_index_prefix + index, string(id) );
    }
 }
 
+void es_objects_plugin_impl::prepare_update(const object_id_type& id, const string& index_name,
+                                            fc::mutable_variant_object&& changed_fields)
+{
+   adaptor_struct adaptor;
+   fc::mutable_variant_object o = adaptor.adapt(fc::variant_object(std::move(changed_fields)));
+   o["block_time"] = block_time;
+   o["block_number"] = block_number;
+
+   fc::mutable_variant_object doc;
+   doc["doc"] = std::move(o);
+   bulk.add_action( "update", _es_objects_index_prefix + index_name, string(id) );
+   bulk.add_document( fc::json::to_string(doc, fc::json::legacy_generator) );
+}
+
 template<typename T>
 void es_objects_plugin_impl::prepareTemplate(T blockchain_object, string index_name)
 {
-   fc::mutable_variant_object bulk_header;
-   bulk_header["_index"] = _es_objects_index_prefix + index_name;
-   bulk_header["_type"] = "data";
-   if(_es_objects_keep_only_current)
-   {
-      bulk_header["_id"] = string(blockchain_object.id);
-   }
-
    adaptor_struct adaptor;
    fc::variant blockchain_object_variant;
    fc::to_variant( blockchain_object, blockchain_object_variant, GRAPHENE_NET_MAX_NESTED_OBJECTS );
@@ -254,15 +340,15 @@ void es_objects_plugin_impl::prepareTemplate(T blockchain_object, string index_n
    o["block_time"] = block_time;
    o["block_number"] = block_number;
 
-   string data = fc::json::to_string(o, fc::json::legacy_generator);
-
-   prepare = graphene::utilities::createBulk(bulk_header, std::move(data));
-   std::move(prepare.begin(), prepare.end(), std::back_inserter(bulk));
-   prepare.clear();
+   // without an _id every version of the object is kept as a new document
+   bulk.add_action( "index", _es_objects_index_prefix + index_name,
+                    _es_objects_keep_only_current ? string(blockchain_object.id) : string() );
+   bulk.add_document( fc::json::to_string(o, fc::json::legacy_generator) );
 }
 
 es_objects_plugin_impl::~es_objects_plugin_impl()
 {
+   _sender.reset();
    if (curl) {
       curl_easy_cleanup(curl);
       curl = nullptr;
@@ -309,6 +395,8 @@ void es_objects_plugin::plugin_set_program_options(
          ("es-objects-index-prefix", boost::program_options::value<std::string>(), "Add a prefix to the index(objects-)")
          ("es-objects-keep-only-current", boost::program_options::value<bool>(), "Keep only current state of the objects(true)")
          ("es-objects-start-es-after-block", boost::program_options::value<uint32_t>(), "Start doing ES job after block(0)")
+         ("es-objects-partial-updates", boost::program_options::value<bool>(),
+               "Send only the changed fields of balances and limit orders, their documents must exist(false)")
          ;
    cfg.add(cli);
 }
@@ -381,6 +469,16 @@ void es_objects_plugin::plugin_initialize(const boost::program_options::variable
    if (options.count("es-objects-start-es-after-block")) {
       my->_es_objects_start_es_after_block = options["es-objects-start-es-after-block"].as<uint32_t>();
    }
+   if (options.count("es-objects-partial-updates")) {
+      my->_es_objects_partial_updates = options["es-objects-partial-updates"].as<bool>();
+   }
+
+   graphene::utilities::bulk_sender::options_type sender_options;
+   sender_options.elasticsearch_url = my->_es_objects_elasticsearch_url;
+   sender_options.auth = my->_es_objects_auth;
+   // the documents of the current state are rewritten, so the bulks have to arrive in order
+   sender_options.max_in_flight = 1;
+   my->_sender.reset( new graphene::utilities::bulk_sender( sender_options ) );
 }
 
 void es_objects_plugin::plugin_startup()
@@ -396,4 +494,9 @@ void es_objects_plugin::plugin_startup()
    ilog("elasticsearch OBJECTS: plugin_startup() begin");
 }
 
+void es_objects_plugin::plugin_shutdown()
+{
+   my->stop_sender();
+}
+
 } }
\ No newline at end of file
@@ -26,6 +26,8 @@
 
 #include <graphene/chain/market_object.hpp>
 
+#include <cmath>
+
 namespace graphene { namespace grouped_orders {
 
 namespace detail
@@ -47,13 +49,38 @@ class grouped_orders_plugin_impl
       flat_set<uint16_t>         _tracked_groups;
 };
 
+namespace {
+   double log_price( const price& p )
+   {
+      return std::log( double( p.base.amount.value ) / double( p.quote.amount.value ) );
+   }
+
+   int64_t to_bucket( double log_price, double log_group_ratio )
+   {
+      return int64_t( std::floor( log_price / log_group_ratio ) );
+   }
+
+   double log_group_ratio( uint16_t group )
+   {
+      return std::log1p( double( group ) / GRAPHENE_100_PERCENT );
+   }
+}
+
 /**
  *  @brief This secondary index is used to track changes on limit order objects.
+ *
+ *  The groups are kept by market, then by group, each in a flat array of buckets. The bucket of an order is
+ *  computed from its price once for all groups, so that adding or removing an order is a lookup in a small
+ *  array per group instead of a search through the groups of all markets with price comparisons.
  */
 class limit_order_group_index : public secondary_index
 {
    public:
-      limit_order_group_index( const flat_set<uint16_t>& groups ) : _tracked_groups( groups ) {};
+      limit_order_group_index( const flat_set<uint16_t>& groups ) : _tracked_groups( groups )
+      {
+         for( uint16_t group : _tracked_groups )
+            _log_group_ratios.push_back( log_group_ratio( group ) );
+      };
 
       virtual void object_inserted( const object& obj ) override;
       virtual void object_removed( const object& obj ) override;
@@ -63,127 +90,50 @@ class limit_order_group_index : public secondary_index
       const flat_set<uint16_t>& get_tracked_groups() const
       { return _tracked_groups; }
 
-      const map< limit_order_group_key, limit_order_group_data >& get_order_groups() const
-      { return _og_data; }
+      const limit_order_groups_type* find_groups( asset_id_type base, asset_id_type quote, uint16_t group )const
+      {
+         auto market = _groups.find( std::make_pair( base, quote ) );
+         if( market == _groups.end() )
+            return nullptr;
+         auto groups = market->second.find( group );
+         return groups == market->second.end() ? nullptr : &groups->second;
+      }
 
    private:
       void remove_order( const limit_order_object& obj, bool remove_empty = true );
 
       /** tracked groups */
       flat_set<uint16_t> _tracked_groups;
+      /** log( 1 + group / 10000 ) of the tracked groups, in the same order */
+      vector<double>     _log_group_ratios;
 
-      /** maps the group key to group data */
-      map< limit_order_group_key, limit_order_group_data > _og_data;
+      /** maps the market, then the group to the groups of the orders */
+      map< std::pair<asset_id_type,asset_id_type>, flat_map< uint16_t, limit_order_groups_type > > _groups;
 };
 
 void limit_order_group_index::object_inserted( const object& objct )
 { try {
    const limit_order_object& o = static_cast<const limit_order_object&>( objct );
 
-   auto& idx = _og_data;
-
+   auto& market = _groups[ std::make_pair( o.sell_price.base.asset_id, o.sell_price.quote.asset_id ) ];
+   const double order_log_price = log_price( o.sell_price );
+   size_t i = 0;
    for( uint16_t group : get_tracked_groups() )
    {
-      auto create_ogo = [&]() {
-         idx[ limit_order_group_key( group, o.sell_price ) ] = limit_order_group_data( o.sell_price, o.for_sale );
-      };
-      // if idx is empty, insert this order
-      // Note: not capped
-      if( idx.empty() )
+      auto& groups = market[ group ];
+      const int64_t bucket = to_bucket( order_log_price, _log_group_ratios[i++] );
+      auto itr = groups.find( bucket );
+      if( itr == groups.end() )
       {
-         create_ogo();
+         groups.emplace( bucket, limit_order_group_data( o.sell_price, o.for_sale ) );
          continue;
       }
-
-      // cap the price
-      price capped_price = o.sell_price;
-      price max = o.sell_price.max();
-      price min = o.sell_price.min();
-      bool capped_max = false;
-      bool capped_min = false;
-      if( o.sell_price > max )
-      {
-         capped_price = max;
-         capped_max = true;
-      }
-      else if( o.sell_price < min )
-      {
-         capped_price = min;
-         capped_min = true;
-      }
-      // if idx is not empty, find the group that is next to this order
-      auto itr = idx.lower_bound( limit_order_group_key( group, capped_price ) );
-      bool check_previous = false;
-      if( itr == idx.end() || itr->first.group != group
-            || itr->first.min_price.base.asset_id != o.sell_price.base.asset_id
-            || itr->first.min_price.quote.asset_id != o.sell_price.quote.asset_id )
-         // not same market or group type
-         check_previous = true;
-      else // same market and group type
-      {
-         bool update_max = false;
-         if( capped_price > itr->second.max_price ) // implies itr->min_price <= itr->max_price < max
-         {
-            update_max = true;
-            price max_price = itr->first.min_price * ratio_type( GRAPHENE_100_PERCENT + group, GRAPHENE_100_PERCENT );
-            // max_price should have been capped here
-            if( capped_price > max_price ) // new order is out of range
-               check_previous = true;
-         }
-         if( !check_previous ) // new order is within the range
-         {
-            if( capped_min && o.sell_price < itr->first.min_price )
-            {  // need to update itr->min_price here, if itr is below min, and new order is even lower
-               // TODO improve performance
-               limit_order_group_data data( itr->second.max_price, o.for_sale + itr->second.total_for_sale );
-               idx.erase( itr );
-               idx[ limit_order_group_key( group, o.sell_price ) ] = data;
-            }
-            else
-            {
-               if( update_max || ( capped_max && o.sell_price > itr->second.max_price ) )
-                  itr->second.max_price = o.sell_price; // store real price here, not capped
-               itr->second.total_for_sale += o.for_sale;
-            }
-         }
-      }
-
-      if( check_previous )
-      {
-         if( itr == idx.begin() ) // no previous
-            create_ogo();
-         else
-         {
-            --itr; // should be valid
-            if( itr->first.group != group || itr->first.min_price.base.asset_id != o.sell_price.base.asset_id
-                                          || itr->first.min_price.quote.asset_id != o.sell_price.quote.asset_id )
-               // not same market or group type
-               create_ogo();
-            else // same market and group type
-            {
-               // due to lower_bound, always true: capped_price < itr->first.min_price, so no need to check again,
-               // if new order is in range of itr group, always need to update itr->first.min_price, unless
-               //   o.sell_price is higher than max
-               price min_price = itr->second.max_price / ratio_type( GRAPHENE_100_PERCENT + group, GRAPHENE_100_PERCENT );
-               // min_price should have been capped here
-               if( capped_price < min_price ) // new order is out of range
-                  create_ogo();
-               else if( capped_max && o.sell_price >= itr->first.min_price )
-               {  // itr is above max, and price of new order is even higher
-                  if( o.sell_price > itr->second.max_price )
-                     itr->second.max_price = o.sell_price;
-                  itr->second.total_for_sale += o.for_sale;
-               }
-               else
-               {  // new order is within the range
-                  // TODO improve performance
-                  limit_order_group_data data( itr->second.max_price, o.for_sale + itr->second.total_for_sale );
-                  idx.erase( itr );
-                  idx[ limit_order_group_key( group, o.sell_price ) ] = data;
-               }
-            }
-         }
-      }
+      limit_order_group_data& data = itr->second;
+      if( o.sell_price < data.min_price )
+         data.min_price = o.sell_price;
+      else if( o.sell_price > data.max_price )
+         data.max_price = o.sell_price;
+      data.total_for_sale += o.for_sale;
    }
 } FC_CAPTURE_AND_RETHROW( (objct) ); }
 
@@ -206,33 +156,48 @@ void limit_order_group_index::object_modified( const object& objct )
 
 void limit_order_group_index::remove_order( const limit_order_object& o, bool remove_empty )
 {
-   auto& idx = _og_data;
+   auto market = _groups.find( std::make_pair( o.sell_price.base.asset_id, o.sell_price.quote.asset_id ) );
+   if( market == _groups.end() )
+   {
+      // should not happen
+      wlog( "can not find the order groups of the market of order for removing: ${o}", ("o",o) );
+      return;
+   }
 
+   const double order_log_price = log_price( o.sell_price );
+   size_t i = 0;
    for( uint16_t group : get_tracked_groups() )
    {
-      // find the group that should contain this order
-      auto itr = idx.lower_bound( limit_order_group_key( group, o.sell_price ) );
-      if( itr == idx.end() || itr->first.group != group
-            || itr->first.min_price.base.asset_id != o.sell_price.base.asset_id
-            || itr->first.min_price.quote.asset_id != o.sell_price.quote.asset_id
-            || itr->second.max_price < o.sell_price )
+      const int64_t bucket = to_bucket( order_log_price, _log_group_ratios[i++] );
+      auto groups = market->second.find( group );
+      if( groups == market->second.end() )
+      {
+         // should not happen
+         wlog( "can not find the order groups of group ${g} for removing: ${o}", ("g",group)("o",o) );
+         continue;
+      }
+      auto itr = groups->second.find( bucket );
+      if( itr == groups->second.end() )
       {
          // can not find corresponding group, should not happen
          wlog( "can not find the order group containing order for removing (price dismatch): ${o}", ("o",o) );
          continue;
       }
-      else // found
+      if( itr->second.total_for_sale < o.for_sale )
+         // should not happen
+         wlog( "can not find the order group containing order for removing (amount dismatch): ${o}", ("o",o) );
+      else if( !remove_empty || itr->second.total_for_sale > o.for_sale )
+         itr->second.total_for_sale -= o.for_sale;
+      else
       {
-         if( itr->second.total_for_sale < o.for_sale )
-            // should not happen
-            wlog( "can not find the order group containing order for removing (amount dismatch): ${o}", ("o",o) );
-         else if( !remove_empty || itr->second.total_for_sale > o.for_sale )
-            itr->second.total_for_sale -= o.for_sale;
-         else
-            // it's the only order in the group and need to be removed
-            idx.erase( itr );
+         // it's the only order in the group and need to be removed
+         groups->second.erase( itr );
+         if( groups->second.empty() )
+            market->second.erase( groups );
       }
    }
+   if( market->second.empty() )
+      _groups.erase( market );
 }
 
 grouped_orders_plugin_impl::~grouped_orders_plugin_impl()
@@ -292,12 +257,18 @@ const flat_set<uint16_t>& grouped_orders_plugin::tracked_groups() const
    return my->_tracked_groups;
 }
 
-const map< limit_order_group_key, limit_order_group_data >& grouped_orders_plugin::limit_order_groups()
+const limit_order_groups_type* grouped_orders_plugin::find_limit_order_groups( asset_id_type base, asset_id_type quote,
+                                                                               uint16_t group )
 {
    const auto& idx = database().get_index_type< limit_order_index >();
    const auto& pidx = dynamic_cast<const primary_index< limit_order_index >&>(idx);
    const auto& logidx = pidx.get_secondary_index< detail::limit_order_group_index >();
-   return logidx.get_order_groups();
+   return logidx.find_groups( base, quote, group );
+}
+
+int64_t price_bucket( const price& p, uint16_t group )
+{
+   return detail::to_bucket( detail::log_price( p ), detail::log_group_ratio( group ) );
 }
 
 } }
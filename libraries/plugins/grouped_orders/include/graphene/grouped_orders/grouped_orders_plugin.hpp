@@ -29,34 +29,26 @@
 namespace graphene { namespace grouped_orders {
 using namespace chain;
 
-struct limit_order_group_key
-{
-   limit_order_group_key( const uint16_t g, const price& p ) : group(g), min_price(p) {}
-   limit_order_group_key() {}
-
-   uint16_t      group = 0; ///< percentage, 1 means 1 / 10000
-   price         min_price;
-
-   friend bool operator < ( const limit_order_group_key& a, const limit_order_group_key& b )
-   {
-      // price is ordered descendingly, same as limit_order_index
-      return std::tie( a.group, b.min_price ) < std::tie( b.group, a.min_price );
-   }
-   friend bool operator == ( const limit_order_group_key& a, const limit_order_group_key& b )
-   {
-      return std::tie( a.group, a.min_price ) == std::tie( b.group, b.min_price );
-   }
-};
-
 struct limit_order_group_data
 {
-   limit_order_group_data( const price& p, const share_type s ) : max_price(p), total_for_sale(s) {}
+   limit_order_group_data( const price& p, const share_type s ) : min_price(p), max_price(p), total_for_sale(s) {}
    limit_order_group_data() {}
 
-   price         max_price;
+   price         min_price; ///< lowest price of the orders added to the group
+   price         max_price; ///< highest price of the orders added to the group
    share_type    total_for_sale; ///< asset id is min_price.base.asset_id
 };
 
+/**
+ *  The groups of the orders of one market and group size, by bucket. Bucket n of group g holds the prices from
+ *  (1 + g / 10000)^n up to (1 + g / 10000)^(n + 1), so the buckets are ordered from the highest prices down, the
+ *  same as limit_order_index.
+ */
+typedef flat_map< int64_t, limit_order_group_data, std::greater<int64_t> > limit_order_groups_type;
+
+/// @return the bucket of p in group, a percentage where 1 means 1 / 10000
+int64_t price_bucket( const price& p, uint16_t group );
+
 namespace detail
 {
     class grouped_orders_plugin_impl;
@@ -82,7 +74,9 @@ class grouped_orders_plugin : public graphene::app::plugin
 
       const flat_set<uint16_t>&   tracked_groups()const;
 
-      const map< limit_order_group_key, limit_order_group_data >& limit_order_groups();
+      /// @return the groups of the orders selling base for quote, null if there are none
+      const limit_order_groups_type* find_limit_order_groups( asset_id_type base, asset_id_type quote,
+                                                              uint16_t group );
 
    private:
       friend class detail::grouped_orders_plugin_impl;
@@ -91,5 +85,4 @@ class grouped_orders_plugin : public graphene::app::plugin
 
 } } //graphene::grouped_orders
 
-FC_REFLECT( graphene::grouped_orders::limit_order_group_key, (group)(min_price) )
-FC_REFLECT( graphene::grouped_orders::limit_order_group_data, (max_price)(total_for_sale) )
+FC_REFLECT( graphene::grouped_orders::limit_order_group_data, (min_price)(max_price)(total_for_sale) )
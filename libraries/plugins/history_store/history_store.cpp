@@ -0,0 +1,718 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/history_store/history_store.hpp>
+
+#include <graphene/chain/impacted.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/endian/buffers.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+namespace graphene { namespace history_store {
+
+namespace {
+   /// An entry of a run file
+   struct run_record
+   {
+      boost::endian::little_uint64_buf_t key;
+      boost::endian::little_uint64_buf_t sequence;
+      boost::endian::little_uint32_buf_t block_num;
+      boost::endian::little_uint32_buf_t block_time;
+      boost::endian::little_uint16_buf_t operation_type;
+   };
+   static_assert( sizeof( run_record ) == 26, "run records must be packed" );
+
+   /// The number of run records read at once when going backwards through a run
+   const uint64_t read_window = 256;
+
+   std::vector<char> compress( const std::vector<char>& data )
+   {
+      std::vector<char> result;
+      boost::iostreams::filtering_ostream out;
+      out.push( boost::iostreams::zlib_compressor() );
+      out.push( boost::iostreams::back_inserter( result ) );
+      out.write( data.data(), data.size() );
+      out.reset();
+      return result;
+   }
+
+   std::vector<char> decompress( const std::vector<char>& data )
+   {
+      std::vector<char> result;
+      boost::iostreams::filtering_ostream out;
+      out.push( boost::iostreams::zlib_decompressor() );
+      out.push( boost::iostreams::back_inserter( result ) );
+      out.write( data.data(), data.size() );
+      out.reset();
+      return result;
+   }
+
+   /// Whether an operation is selected by q: 1 if it is, 0 if not, -1 if it and all older ones are not
+   int match( const history_query& q, uint64_t sequence, uint32_t block_num, uint32_t block_time,
+              int64_t operation_type )
+   {
+      if( block_num < q.start_block || block_time < q.start_time.sec_since_epoch() )
+         return -1;
+      if( sequence > q.max_sequence || block_num > q.end_block || block_time > q.end_time.sec_since_epoch() )
+         return 0;
+      if( !q.operation_types.empty() && q.operation_types.find( operation_type ) == q.operation_types.end() )
+         return 0;
+      return 1;
+   }
+
+   /// Reads a run file from the start
+   class run_reader
+   {
+      public:
+         run_reader( const std::string& filename, uint64_t entries ) : _left( entries )
+         {
+            _in.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+            _in.open( filename.c_str(), std::ifstream::binary );
+         }
+
+         bool read( run_record& record )
+         {
+            if( _left == 0 )
+               return false;
+            _in.read( (char*)&record, sizeof( record ) );
+            --_left;
+            return true;
+         }
+
+      private:
+         std::ifstream _in;
+         uint64_t      _left;
+   };
+}
+
+struct history_store::run_file
+{
+   run_file( const std::string& filename, uint64_t entries ) : entries( entries )
+   {
+      in.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+      in.open( filename.c_str(), std::ifstream::binary );
+   }
+
+   void read( uint64_t first, uint64_t count, std::vector<run_record>& records )
+   {
+      records.resize( count );
+      in.seekg( first * sizeof( run_record ) );
+      in.read( (char*)records.data(), count * sizeof( run_record ) );
+   }
+
+   /** @return the first entry for which pred is true, pred has to be false for the entries before it only */
+   uint64_t lower_bound( const std::function<bool( const run_record& )>& pred )
+   {
+      uint64_t first = 0;
+      uint64_t count = entries;
+      std::vector<run_record> record;
+      while( count > 0 )
+      {
+         const uint64_t step = count / 2;
+         read( first + step, 1, record );
+         if( !pred( record.front() ) )
+         {
+            first += step + 1;
+            count -= step + 1;
+         }
+         else
+            count = step;
+      }
+      return first;
+   }
+
+   std::ifstream  in;
+   const uint64_t entries;
+};
+
+history_store::history_store( const fc::path& dir, const options_type& options )
+   : _dir( dir ), _log_filename( dir / "operations" ), _index_filename( dir / "index" ), _options( options )
+{ try {
+   fc::create_directories( dir );
+   _log.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+   if( !fc::exists( _log_filename ) )
+      _log.open( _log_filename.generic_string().c_str(),
+                 std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc );
+   else
+      _log.open( _log_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+
+   if( fc::exists( _index_filename ) )
+   {
+      std::string data;
+      fc::read_file_contents( _index_filename, data );
+      store_index index = fc::raw::unpack<store_index>( std::vector<char>( data.begin(), data.end() ) );
+      if( index.log_size <= fc::file_size( _log_filename ) )
+         _index = std::move( index );
+      else
+         wlog( "Ignoring the history store index, it does not match the operation log" );
+   }
+
+   // runs of an ignored index, or written by a merge which did not complete, are not used
+   std::vector<fc::path> unused_runs;
+   for( fc::directory_iterator itr( _dir ); itr != fc::directory_iterator(); ++itr )
+   {
+      const fc::path file = *itr;
+      const std::string name = file.filename().generic_string();
+      if( name.compare( 0, 4, "run-" ) != 0 )
+         continue;
+      auto used = std::find_if( _index.runs.begin(), _index.runs.end(), [this,&file]( const history_run& run ) {
+         return run_filename( run.number ) == file.generic_string();
+      } );
+      if( used == _index.runs.end() )
+         unused_runs.push_back( file );
+   }
+   for( const auto& file : unused_runs )
+      fc::remove( file );
+   for( const auto& run : _index.runs )
+      _run_files.emplace_back( new run_file( run_filename( run.number ), run.entries ) );
+
+   scan( _index.log_size );
+   if( !_index.chunks.empty() )
+   {
+      _next_sequence = _index.chunks.back().first_sequence + _index.chunks.back().count;
+      _last_block = _index.chunks.back().last_block;
+   }
+
+   // the entries which are not in a run are built again from the log
+   const uint64_t indexed = _index.runs.empty() ? 0 : _index.runs.back().max_sequence + 1;
+   auto chunk = std::upper_bound( _index.chunks.begin(), _index.chunks.end(), indexed,
+                                  []( uint64_t sequence, const chunk_info& c ) {
+                                     return sequence < c.first_sequence + c.count;
+                                  } );
+   for( ; chunk != _index.chunks.end(); ++chunk )
+   {
+      for( const auto& op : read_chunk( chunk - _index.chunks.begin() ) )
+         if( op.sequence >= indexed )
+            add_to_memtable( op );
+      // a store without a usable index is indexed again without waiting for the next block
+      if( _memtable_entries >= _options.memtable_size && chunk + 1 != _index.chunks.end() )
+      {
+         const size_t position = chunk - _index.chunks.begin();
+         // a merge may already run in the background
+         std::lock_guard<std::mutex> guard( _mutex );
+         write_run();
+         chunk = _index.chunks.begin() + position;
+      }
+   }
+   ilog( "Opened the history store with ${n} operations up to block ${b}", ("n",_next_sequence)("b",_last_block) );
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+history_store::~history_store()
+{
+   _closing = true;
+   if( _merge.valid() )
+      _merge.wait();
+   try
+   {
+      flush();
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "Failed to save the history store: ${e}", ("e",e.to_detail_string()) );
+   }
+   catch( const std::exception& e )
+   {
+      elog( "Failed to save the history store: ${e}", ("e",e.what()) );
+   }
+}
+
+uint64_t history_store::account_key( account_id_type account )
+{
+   return ( uint64_t(1) << 56 ) | account.instance.value;
+}
+
+uint64_t history_store::asset_key( asset_id_type asset )
+{
+   return ( uint64_t(2) << 56 ) | asset.instance.value;
+}
+
+uint64_t history_store::operation_type_key( int64_t operation_type )
+{
+   return ( uint64_t(3) << 56 ) | uint64_t( operation_type );
+}
+
+std::string history_store::run_filename( uint32_t number )const
+{
+   return ( _dir / ( "run-" + std::to_string( number ) ) ).generic_string();
+}
+
+void history_store::scan( uint64_t position )
+{
+   const uint64_t file_size = fc::file_size( _log_filename );
+   while( position + sizeof( boost::endian::little_uint32_buf_t ) <= file_size )
+   {
+      boost::endian::little_uint32_buf_t record_size;
+      _log.seekg( position );
+      _log.read( (char*)&record_size, sizeof( record_size ) );
+      if( position + sizeof( record_size ) + record_size.value() > file_size )
+         break;
+      std::vector<char> data( record_size.value() );
+      _log.read( data.data(), data.size() );
+      stored_chunk chunk = fc::raw::unpack<stored_chunk>( data );
+      chunk.info.position = position;
+      _index.chunks.push_back( chunk.info );
+      position += sizeof( record_size ) + record_size.value();
+   }
+   if( position < file_size )
+   {
+      wlog( "Dropping the incomplete last chunk of the history store" );
+      _log.close();
+      fc::resize_file( _log_filename, position );
+      _log.open( _log_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+   }
+   _index.log_size = position;
+}
+
+void history_store::save_index()const
+{
+   const fc::path tmp_filename = _index_filename.generic_string() + ".tmp";
+   const std::vector<char> data = fc::raw::pack( _index );
+   {
+      std::ofstream out( tmp_filename.generic_string().c_str(), std::ofstream::binary | std::ofstream::trunc );
+      out.write( data.data(), data.size() );
+      FC_ASSERT( out, "Unable to write ${f}", ("f",tmp_filename) );
+   }
+   fc::rename( tmp_filename, _index_filename );
+}
+
+void history_store::add_to_memtable( const stored_operation& op )
+{
+   const operation& o = op.operation.op;
+   flat_set<uint64_t> keys;
+
+   flat_set<account_id_type> accounts;
+   vector<authority> other;
+   operation_get_required_authorities( o, accounts, accounts, other );
+   if( o.is_type<account_create_operation>() && op.operation.result.is_type<object_id_type>() )
+      accounts.insert( op.operation.result.get<object_id_type>() );
+   else
+      operation_get_impacted_accounts( o, accounts );
+   for( const auto& a : other )
+      for( const auto& item : a.account_auths )
+         accounts.insert( item.first );
+   for( const auto& account : accounts )
+      keys.insert( account_key( account ) );
+
+   operation_footprint footprint;
+   operation_get_footprint( o, footprint );
+   flat_set<asset_id_type> assets( footprint.assets_read.begin(), footprint.assets_read.end() );
+   assets.insert( footprint.assets_written.begin(), footprint.assets_written.end() );
+   for( const auto& balance : footprint.balances )
+      assets.insert( balance.second );
+   for( const auto& market : footprint.markets )
+   {
+      assets.insert( market.first );
+      assets.insert( market.second );
+   }
+   if( o.is_type<asset_create_operation>() && op.operation.result.is_type<object_id_type>() )
+      assets.insert( op.operation.result.get<object_id_type>() );
+   for( const auto& asset : assets )
+      keys.insert( asset_key( asset ) );
+
+   keys.insert( operation_type_key( o.which() ) );
+
+   const index_entry entry{ op.sequence, op.operation.block_num, op.block_time.sec_since_epoch(),
+                            uint16_t( o.which() ) };
+   for( const auto& key : keys )
+      _memtable[key].push_back( entry );
+   _memtable_entries += keys.size();
+}
+
+void history_store::append_block( uint32_t block_num, fc::time_point_sec block_time,
+                                  const std::vector<operation_history_object>& ops )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   if( block_num <= _last_block )
+      return;
+   for( const auto& op : ops )
+   {
+      stored_operation stored;
+      stored.sequence = _next_sequence++;
+      stored.block_time = block_time;
+      stored.operation = op;
+      stored.operation.block_num = block_num;
+      add_to_memtable( stored );
+      _open_chunk.push_back( std::move( stored ) );
+   }
+   _last_block = block_num;
+
+   // a chunk holds whole blocks
+   if( _open_chunk.size() >= _options.chunk_size )
+      write_chunk();
+   if( _memtable_entries >= _options.memtable_size )
+      write_run();
+}
+
+void history_store::write_chunk()
+{
+   if( _open_chunk.empty() )
+      return;
+   stored_chunk chunk;
+   chunk.info.position = _index.log_size;
+   chunk.info.first_sequence = _open_chunk.front().sequence;
+   chunk.info.count = _open_chunk.size();
+   chunk.info.first_block = _open_chunk.front().operation.block_num;
+   chunk.info.last_block = _open_chunk.back().operation.block_num;
+   chunk.info.first_time = _open_chunk.front().block_time;
+   chunk.info.last_time = _open_chunk.back().block_time;
+   chunk.data = fc::raw::pack( _open_chunk );
+   if( _options.compression )
+   {
+      chunk.data = compress( chunk.data );
+      chunk.compressed = true;
+   }
+
+   const std::vector<char> data = fc::raw::pack( chunk );
+   const boost::endian::little_uint32_buf_t record_size( data.size() );
+   _log.seekp( _index.log_size );
+   _log.write( (const char*)&record_size, sizeof( record_size ) );
+   _log.write( data.data(), data.size() );
+   _index.log_size += sizeof( record_size ) + data.size();
+   _index.chunks.push_back( chunk.info );
+   _open_chunk.clear();
+}
+
+void history_store::write_run()
+{
+   if( _memtable.empty() )
+      return;
+   // a run must not index operations which could be lost from the log
+   write_chunk();
+   _log.flush();
+
+   history_run run;
+   run.number = _index.next_run++;
+   run.entries = _memtable_entries;
+   run.max_sequence = _next_sequence - 1;
+   const std::string filename = run_filename( run.number );
+   {
+      std::ofstream out( ( filename + ".tmp" ).c_str(), std::ofstream::binary | std::ofstream::trunc );
+      run_record record;
+      for( const auto& key : _memtable )
+         for( const auto& entry : key.second )
+         {
+            record.key = key.first;
+            record.sequence = entry.sequence;
+            record.block_num = entry.block_num;
+            record.block_time = entry.block_time;
+            record.operation_type = entry.operation_type;
+            out.write( (const char*)&record, sizeof( record ) );
+         }
+      FC_ASSERT( out, "Unable to write ${f}", ("f",filename) );
+   }
+   fc::rename( filename + ".tmp", filename );
+   _index.runs.push_back( run );
+   _run_files.emplace_back( new run_file( filename, run.entries ) );
+   _memtable.clear();
+   _memtable_entries = 0;
+
+   save_index();
+   start_merge();
+}
+
+std::pair<size_t,size_t> history_store::runs_to_merge()const
+{
+   // the runs of a level are next to each other
+   size_t first = 0;
+   while( first < _index.runs.size() )
+   {
+      size_t end = first + 1;
+      while( end < _index.runs.size() && _index.runs[end].level == _index.runs[first].level )
+         ++end;
+      if( end - first > _options.max_runs )
+         return std::make_pair( first, end );
+      first = end;
+   }
+   return std::make_pair( _index.runs.size(), _index.runs.size() );
+}
+
+void history_store::start_merge()
+{
+   if( _merge.valid() && _merge.wait_for( std::chrono::seconds(0) ) != std::future_status::ready )
+      return;
+   if( runs_to_merge().first == _index.runs.size() )
+      return;
+   _merge = std::async( std::launch::async, [this]() { merge_runs(); } );
+}
+
+void history_store::merge_runs()
+{ try {
+   while( !_closing )
+   {
+      // only this thread removes runs, the ones before the end are not changed meanwhile
+      std::vector<history_run> runs;
+      size_t first;
+      history_run merged;
+      {
+         std::lock_guard<std::mutex> guard( _mutex );
+         const auto range = runs_to_merge();
+         if( range.first == _index.runs.size() )
+            return;
+         first = range.first;
+         runs.assign( _index.runs.begin() + range.first, _index.runs.begin() + range.second );
+         merged.number = _index.next_run++;
+      }
+      merged.max_sequence = runs.back().max_sequence;
+      merged.level = runs.front().level + 1;
+
+      const std::string filename = run_filename( merged.number );
+      {
+         std::vector< std::unique_ptr<run_reader> > readers;
+         typedef std::pair< std::pair<uint64_t,uint64_t>, size_t > head_type; // (key, sequence), reader
+         std::priority_queue< head_type, std::vector<head_type>, std::greater<head_type> > heads;
+         std::vector<run_record> current( runs.size() );
+         for( const auto& run : runs )
+         {
+            const size_t i = readers.size();
+            readers.emplace_back( new run_reader( run_filename( run.number ), run.entries ) );
+            if( readers.back()->read( current[i] ) )
+               heads.push( head_type( std::make_pair( current[i].key.value(), current[i].sequence.value() ), i ) );
+         }
+
+         std::ofstream out( ( filename + ".tmp" ).c_str(), std::ofstream::binary | std::ofstream::trunc );
+         while( !heads.empty() )
+         {
+            // the runs are left as they are when the store is closed, the next open removes the file
+            if( _closing )
+               return;
+            const size_t i = heads.top().second;
+            heads.pop();
+            out.write( (const char*)&current[i], sizeof( run_record ) );
+            ++merged.entries;
+            if( readers[i]->read( current[i] ) )
+               heads.push( head_type( std::make_pair( current[i].key.value(), current[i].sequence.value() ), i ) );
+         }
+         FC_ASSERT( out, "Unable to write ${f}", ("f",filename) );
+      }
+      fc::rename( filename + ".tmp", filename );
+
+      {
+         std::lock_guard<std::mutex> guard( _mutex );
+         _index.runs.erase( _index.runs.begin() + first, _index.runs.begin() + first + runs.size() );
+         _index.runs.insert( _index.runs.begin() + first, merged );
+         _run_files.erase( _run_files.begin() + first, _run_files.begin() + first + runs.size() );
+         _run_files.emplace( _run_files.begin() + first, new run_file( filename, merged.entries ) );
+         save_index();
+      }
+      for( const auto& run : runs )
+         fc::remove( run_filename( run.number ) );
+   }
+} catch( const fc::exception& e ) {
+   elog( "Failed to merge the runs of the history store: ${e}", ("e",e.to_detail_string()) );
+} catch( const std::exception& e ) {
+   elog( "Failed to merge the runs of the history store: ${e}", ("e",e.what()) );
+} }
+
+void history_store::flush()
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   write_chunk();
+   _log.flush();
+   save_index();
+}
+
+std::vector<stored_operation> history_store::read_chunk( size_t i )const
+{
+   boost::endian::little_uint32_buf_t record_size;
+   _log.seekg( _index.chunks[i].position );
+   _log.read( (char*)&record_size, sizeof( record_size ) );
+   std::vector<char> data( record_size.value() );
+   _log.read( data.data(), data.size() );
+   stored_chunk chunk = fc::raw::unpack<stored_chunk>( data );
+   if( chunk.compressed )
+      chunk.data = decompress( chunk.data );
+   return fc::raw::unpack< std::vector<stored_operation> >( chunk.data );
+}
+
+const stored_operation& history_store::get( uint64_t sequence, size_t& cached_chunk,
+                                            std::vector<stored_operation>& cache )const
+{
+   if( !_open_chunk.empty() && sequence >= _open_chunk.front().sequence )
+      return _open_chunk[ sequence - _open_chunk.front().sequence ];
+   auto chunk = std::upper_bound( _index.chunks.begin(), _index.chunks.end(), sequence,
+                                  []( uint64_t s, const chunk_info& c ) { return s < c.first_sequence; } );
+   FC_ASSERT( chunk != _index.chunks.begin(), "Operation ${s} is not stored", ("s",sequence) );
+   const size_t i = ( chunk - _index.chunks.begin() ) - 1;
+   if( i != cached_chunk )
+   {
+      cache = read_chunk( i );
+      cached_chunk = i;
+   }
+   return cache[ sequence - _index.chunks[i].first_sequence ];
+}
+
+std::vector<stored_operation> history_store::query_chunks( const history_query& q )const
+{
+   std::vector<stored_operation> result;
+   // true if op is added, false if it and the older ones are not selected
+   auto add = [&q,&result]( const stored_operation& op ) {
+      const int m = match( q, op.sequence, op.operation.block_num, op.block_time.sec_since_epoch(),
+                           op.operation.op.which() );
+      if( m > 0 )
+         result.push_back( op );
+      return m >= 0;
+   };
+
+   for( auto op = _open_chunk.rbegin(); op != _open_chunk.rend() && result.size() < q.limit; ++op )
+      if( !add( *op ) )
+         return result;
+   for( size_t i = _index.chunks.size(); i > 0 && result.size() < q.limit; --i )
+   {
+      const chunk_info& chunk = _index.chunks[i - 1];
+      if( chunk.last_block < q.start_block || chunk.last_time < q.start_time )
+         break;
+      if( chunk.first_sequence > q.max_sequence || chunk.first_block > q.end_block || chunk.first_time > q.end_time )
+         continue;
+      const std::vector<stored_operation> ops = read_chunk( i - 1 );
+      for( auto op = ops.rbegin(); op != ops.rend() && result.size() < q.limit; ++op )
+         if( !add( *op ) )
+            return result;
+   }
+   return result;
+}
+
+void history_store::for_each_block( uint32_t first_block, uint32_t last_block, const block_visitor& visit )const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   std::vector<operation_history_object> block_ops;
+   uint32_t block_num = 0;
+   fc::time_point_sec block_time;
+   // false once past last_block
+   auto add = [&]( const std::vector<stored_operation>& ops ) {
+      for( const auto& op : ops )
+      {
+         if( op.operation.block_num < first_block )
+            continue;
+         if( op.operation.block_num != block_num && !block_ops.empty() )
+         {
+            visit( block_num, block_time, block_ops );
+            block_ops.clear();
+         }
+         if( op.operation.block_num > last_block )
+            return false;
+         block_num = op.operation.block_num;
+         block_time = op.block_time;
+         block_ops.push_back( op.operation );
+      }
+      return true;
+   };
+
+   auto chunk = std::lower_bound( _index.chunks.begin(), _index.chunks.end(), first_block,
+                                  []( const chunk_info& c, uint32_t b ) { return c.last_block < b; } );
+   bool more = true;
+   for( ; more && chunk != _index.chunks.end(); ++chunk )
+      more = add( read_chunk( chunk - _index.chunks.begin() ) );
+   if( more )
+      add( _open_chunk );
+   if( !block_ops.empty() )
+      visit( block_num, block_time, block_ops );
+}
+
+std::vector<uint64_t> history_store::query_index( uint64_t key, const history_query& q )const
+{
+   std::vector<uint64_t> result;
+
+   // the memtable holds the most recent entries, then come the runs from the newest one
+   auto entries = _memtable.find( key );
+   if( entries != _memtable.end() )
+   {
+      for( auto e = entries->second.rbegin(); e != entries->second.rend() && result.size() < q.limit; ++e )
+      {
+         const int m = match( q, e->sequence, e->block_num, e->block_time, e->operation_type );
+         if( m < 0 )
+            return result;
+         if( m > 0 )
+            result.push_back( e->sequence );
+      }
+   }
+
+   const uint32_t end_time = q.end_time.sec_since_epoch();
+   std::vector<run_record> records;
+   for( auto run = _run_files.rbegin(); run != _run_files.rend() && result.size() < q.limit; ++run )
+   {
+      run_file& file = **run;
+      const uint64_t first = file.lower_bound( [key]( const run_record& r ) { return r.key.value() >= key; } );
+      uint64_t end = file.lower_bound( [key,&q,end_time]( const run_record& r ) {
+         return r.key.value() > key
+                || ( r.key.value() == key && ( r.sequence.value() > q.max_sequence
+                                               || r.block_num.value() > q.end_block
+                                               || r.block_time.value() > end_time ) );
+      } );
+      while( end > first && result.size() < q.limit )
+      {
+         const uint64_t begin = std::max( first, end > read_window ? end - read_window : 0 );
+         file.read( begin, end - begin, records );
+         for( auto r = records.rbegin(); r != records.rend() && result.size() < q.limit; ++r )
+         {
+            const int m = match( q, r->sequence.value(), r->block_num.value(), r->block_time.value(),
+                                 r->operation_type.value() );
+            if( m < 0 )
+               return result;
+            if( m > 0 )
+               result.push_back( r->sequence.value() );
+         }
+         end = begin;
+      }
+   }
+   return result;
+}
+
+std::vector<stored_operation> history_store::query( const history_query& q )const
+{
+   FC_ASSERT( int( q.account.valid() ) + int( q.asset.valid() ) + int( q.operation_type.valid() ) <= 1,
+              "Only one of account, asset and operation_type can be queried at once" );
+   std::lock_guard<std::mutex> guard( _mutex );
+   if( !q.account.valid() && !q.asset.valid() && !q.operation_type.valid() )
+      return query_chunks( q );
+
+   const uint64_t key = q.account.valid() ? account_key( *q.account )
+                      : q.asset.valid() ? asset_key( *q.asset ) : operation_type_key( *q.operation_type );
+   std::vector<stored_operation> result;
+   size_t cached_chunk = std::numeric_limits<size_t>::max();
+   std::vector<stored_operation> cache;
+   for( const uint64_t sequence : query_index( key, q ) )
+      result.push_back( get( sequence, cached_chunk, cache ) );
+   return result;
+}
+
+uint32_t history_store::last_block()const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   return _last_block;
+}
+
+uint64_t history_store::size()const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   return _next_sequence;
+}
+
+} } // graphene::history_store
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/history_store/history_store_plugin.hpp>
+
+#include <boost/algorithm/string.hpp>
+
+#include <deque>
+
+namespace graphene { namespace history_store {
+
+namespace detail
+{
+
+class history_store_plugin_impl
+{
+   public:
+      history_store_plugin_impl( history_store_plugin& _plugin )
+         : _self( _plugin )
+      { }
+
+      graphene::chain::database& database()
+      {
+         return _self.database();
+      }
+
+      void open_store();
+      void on_applied_block( const signed_block& b );
+      /** stores the pending blocks up to block_num */
+      void store_blocks( uint32_t block_num );
+
+      history_store_plugin& _self;
+      history_store::options_type _options;
+      std::unique_ptr<history_store> _store;
+      std::vector<std::string> _rebuild_plugins;
+
+      struct pending_block
+      {
+         uint32_t                         block_num;
+         fc::time_point_sec               block_time;
+         std::vector<operation_history_object> operations;
+      };
+      /// Blocks applied which are not irreversible yet
+      std::deque<pending_block> _pending_blocks;
+};
+
+void history_store_plugin_impl::open_store()
+{
+   if( !_store )
+      _store.reset( new history_store( database().get_data_dir() / "history_store", _options ) );
+}
+
+void history_store_plugin_impl::on_applied_block( const signed_block& b )
+{
+   graphene::chain::database& db = database();
+   // during a replay blocks are applied before the plugin is started
+   open_store();
+
+   // a block number seen again means the blocks from there on were popped by a fork
+   while( !_pending_blocks.empty() && _pending_blocks.back().block_num >= b.block_num() )
+      _pending_blocks.pop_back();
+
+   pending_block block;
+   block.block_num = b.block_num();
+   block.block_time = b.timestamp;
+   for( const auto& op : db.get_applied_operations() )
+      if( op.valid() )
+         block.operations.push_back( *op );
+   _pending_blocks.push_back( std::move( block ) );
+
+   store_blocks( db.get_dynamic_global_properties().last_irreversible_block_num );
+}
+
+void history_store_plugin_impl::store_blocks( uint32_t block_num )
+{
+   while( !_pending_blocks.empty() && _pending_blocks.front().block_num <= block_num )
+   {
+      const pending_block& block = _pending_blocks.front();
+      _store->append_block( block.block_num, block.block_time, block.operations );
+      _pending_blocks.pop_front();
+   }
+}
+
+} // end namespace detail
+
+history_store_plugin::history_store_plugin() :
+   my( new detail::history_store_plugin_impl(*this) )
+{
+}
+
+history_store_plugin::~history_store_plugin()
+{
+}
+
+std::string history_store_plugin::plugin_name()const
+{
+   return "history_store";
+}
+
+std::string history_store_plugin::plugin_description()const
+{
+   return "Stores the operation history on disk, indexed by account, asset, operation type, block and time.";
+}
+
+void history_store_plugin::plugin_set_program_options(
+   boost::program_options::options_description& cli,
+   boost::program_options::options_description& cfg
+   )
+{
+   cli.add_options()
+         ("history-store-chunk-size", boost::program_options::value<uint32_t>(),
+          "Number of operations stored together in a chunk of the log, compressed at once(1024)")
+         ("history-store-memtable-size", boost::program_options::value<uint64_t>(),
+          "Number of index entries kept in memory before they are written to a run file(1048576)")
+         ("history-store-max-runs", boost::program_options::value<uint32_t>(),
+          "Number of run files of the index of one size before they are merged into one of the next size(8)")
+         ("history-store-compression", boost::program_options::value<bool>(),
+          "Compress the chunks of the log with zlib(true)")
+         ("history-store-rebuild-plugins", boost::program_options::value<std::vector<std::string>>()->composing(),
+          "Names of plugins to rebuild from the stored operations at startup instead of replaying the chain, "
+          "e.g. after account_history was enabled or its track-account changed. Only plugins which build their "
+          "state from operations can be rebuilt, and only if the store was enabled since the last replay")
+         ;
+   cfg.add(cli);
+}
+
+void history_store_plugin::plugin_initialize(const boost::program_options::variables_map& options)
+{
+   database().applied_block.connect( [this]( const signed_block& b ) { my->on_applied_block( b ); } );
+
+   if( options.count( "history-store-chunk-size" ) )
+      my->_options.chunk_size = std::max( 1u, options["history-store-chunk-size"].as<uint32_t>() );
+   if( options.count( "history-store-memtable-size" ) )
+      my->_options.memtable_size = std::max( uint64_t(1), options["history-store-memtable-size"].as<uint64_t>() );
+   if( options.count( "history-store-max-runs" ) )
+      my->_options.max_runs = std::max( 1u, options["history-store-max-runs"].as<uint32_t>() );
+   if( options.count( "history-store-compression" ) )
+      my->_options.compression = options["history-store-compression"].as<bool>();
+   if( options.count( "history-store-rebuild-plugins" ) )
+   {
+      for( const std::string& names : options["history-store-rebuild-plugins"].as<std::vector<std::string>>() )
+      {
+         std::vector<std::string> split;
+         boost::split( split, names, boost::is_any_of( " ," ) );
+         for( const std::string& name : split )
+            if( !name.empty() )
+               my->_rebuild_plugins.push_back( name );
+      }
+   }
+}
+
+void history_store_plugin::plugin_startup()
+{
+   my->open_store();
+   for( const std::string& name : my->_rebuild_plugins )
+      rebuild_plugin( name );
+}
+
+void history_store_plugin::plugin_shutdown()
+{
+   if( !my->_store )
+      return;
+   // the state of the database is saved with these blocks, they are not undone after a restart
+   my->store_blocks( std::numeric_limits<uint32_t>::max() );
+   my->_store->flush();
+}
+
+const history_store* history_store_plugin::store()const
+{
+   return my->_store.get();
+}
+
+void history_store_plugin::rebuild_plugin( const std::string& name )
+{ try {
+   graphene::chain::database& db = database();
+   FC_ASSERT( app().is_plugin_enabled( name ), "Plugin ${p} is not enabled", ("p",name) );
+   auto plugin = app().get_plugin( name );
+   // the plugins clear and refill their indexes through pointers, which do not wait for a background load
+   db.wait_for_background_loads();
+   my->open_store();
+   // blocks applied by a replay before the plugin was started
+   my->store_blocks( db.head_block_num() );
+   // the blocks at the end without operations are not known to the store after a restart
+   if( my->_store->last_block() < db.head_block_num() )
+      wlog( "The operations of the history store end at block ${s}, before the head block ${h}, if the node was "
+            "not shut down cleanly the plugin misses operations, replay the chain then",
+            ("s",my->_store->last_block())("h",db.head_block_num()) );
+
+   // API calls in other threads read the plugin indexes
+   graphene::chain::database::write_scope scope( db );
+   const bool undo_enabled = db._undo_db.enabled();
+   db._undo_db.disable();
+   if( !plugin->plugin_rebuild_start() )
+   {
+      if( undo_enabled )
+         db._undo_db.enable();
+      FC_THROW( "Plugin ${p} can not be rebuilt from the operations", ("p",name) );
+   }
+   ilog( "Rebuilding plugin ${p} from the history store up to block ${h}", ("p",name)("h",db.head_block_num()) );
+   const fc::time_point start = fc::time_point::now();
+   uint32_t blocks = 0;
+   my->_store->for_each_block( 0, db.head_block_num(),
+      [&plugin,&blocks]( uint32_t block_num, fc::time_point_sec block_time,
+                         const std::vector<operation_history_object>& ops ) {
+         plugin->plugin_rebuild_block( block_num, block_time, ops );
+         if( ++blocks % 100000 == 0 )
+            ilog( "   ... at block ${b}", ("b",block_num) );
+      } );
+   plugin->plugin_rebuild_end();
+   if( undo_enabled )
+      db._undo_db.enable();
+   ilog( "Rebuilt plugin ${p} from ${n} blocks in ${t} ms",
+         ("p",name)("n",blocks)("t",( fc::time_point::now() - start ).count() / 1000) );
+} FC_CAPTURE_AND_RETHROW( (name) ) }
+
+} }
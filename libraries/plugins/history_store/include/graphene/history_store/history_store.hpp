@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/operation_history_object.hpp>
+
+#include <fc/container/flat.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/optional.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace graphene { namespace history_store {
+   using namespace chain;
+
+   /// An operation of the store
+   struct stored_operation
+   {
+      /// Position of the operation in the store, counted from 0
+      uint64_t                 sequence = 0;
+      fc::time_point_sec       block_time;
+      operation_history_object operation;
+   };
+
+   /**
+    *  Selects operations of the store, the most recent ones are returned first.
+    *
+    *  At most one of account, asset and operation_type may be set to look the operations up in the index of that
+    *  key, without any of them the operations are read block by block. The ranges are inclusive.
+    */
+   struct history_query
+   {
+      optional<account_id_type> account;
+      optional<asset_id_type>   asset;
+      optional<int64_t>         operation_type;
+      /// If not empty, only operations of these types
+      flat_set<int64_t>         operation_types;
+      fc::time_point_sec        start_time;
+      fc::time_point_sec        end_time = fc::time_point_sec::maximum();
+      uint32_t                  start_block = 0;
+      uint32_t                  end_block = std::numeric_limits<uint32_t>::max();
+      /// To page through the results, the sequence of the last operation returned minus one
+      uint64_t                  max_sequence = std::numeric_limits<uint64_t>::max();
+      uint32_t                  limit = 100;
+   };
+
+   /// Where the operations of a chunk are
+   struct chunk_info
+   {
+      uint64_t           position = 0;
+      uint64_t           first_sequence = 0;
+      uint32_t           count = 0;
+      uint32_t           first_block = 0;
+      uint32_t           last_block = 0;
+      fc::time_point_sec first_time;
+      fc::time_point_sec last_time;
+   };
+
+   /// A record of the operation log, data is a packed vector of stored_operation
+   struct stored_chunk
+   {
+      chunk_info        info;
+      bool              compressed = false;
+      std::vector<char> data;
+   };
+
+   /// A file of index entries sorted by key and sequence
+   struct history_run
+   {
+      uint32_t number = 0;
+      uint64_t entries = 0;
+      /// The highest sequence of the operations indexed
+      uint64_t max_sequence = 0;
+      /// 0 for a run written from the memtable, one more than the runs merged into it otherwise
+      uint32_t level = 0;
+   };
+
+   /// What the store keeps in memory, saved whenever a run is written and when the store is closed
+   struct store_index
+   {
+      uint64_t                 log_size = 0;
+      std::vector<chunk_info>  chunks;
+      std::vector<history_run> runs;
+      uint32_t                 next_run = 0;
+   };
+
+   /**
+    *  Keeps the operation history on disk, indexed by account, asset and operation type.
+    *
+    *  The operations are appended block by block to a log of chunks of about chunk_size operations, which are
+    *  compressed with zlib if enabled. Only the position and the block and time range of each chunk are kept in
+    *  memory, so that chunks are found by sequence, block or time with a binary search.
+    *
+    *  The index is a log-structured merge tree: the entries of recently appended operations are kept in memory
+    *  until there are memtable_size of them, then written to a new run file sorted by key and sequence. The runs
+    *  are compacted by size: when there are more than max_runs runs of a level they are merged into one run of
+    *  the next level, in a background thread, so that every entry is merged a logarithmic number of times. The
+    *  levels of the runs fall from the oldest run to the newest one. Within a key the sequences, blocks and times
+    *  of the entries rise together, so the entries of a range are found with a binary search in each run, and
+    *  the operation type of every entry is at hand to filter without reading the operations.
+    *
+    *  Only operations of irreversible blocks are to be appended, a block that is not newer than the last one
+    *  appended is ignored. The entries of the operations which are not in a run yet are not saved, on opening
+    *  they are built again from the log, and so is the index of the chunks appended since the index file was
+    *  saved. A chunk that was not written completely is dropped.
+    */
+   class history_store
+   {
+      public:
+         struct options_type
+         {
+            uint32_t chunk_size = 1024;
+            uint64_t memtable_size = 1024 * 1024;
+            uint32_t max_runs = 8;
+            bool     compression = true;
+         };
+
+         history_store( const fc::path& dir, const options_type& options );
+         ~history_store();
+
+         void append_block( uint32_t block_num, fc::time_point_sec block_time,
+                            const std::vector<operation_history_object>& ops );
+         /** Writes the operations appended so far to the log file */
+         void flush();
+
+         std::vector<stored_operation> query( const history_query& q )const;
+
+         typedef std::function<void( uint32_t block_num, fc::time_point_sec block_time,
+                                     const std::vector<operation_history_object>& ops )> block_visitor;
+         /**
+          * Calls visit with the operations of each block from first_block to last_block which has operations,
+          * the oldest block first. The store is locked meanwhile, visit must not use it.
+          */
+         void for_each_block( uint32_t first_block, uint32_t last_block, const block_visitor& visit )const;
+
+         /// @return the number of the last block appended
+         uint32_t last_block()const;
+         /// @return the number of operations stored
+         uint64_t size()const;
+
+      private:
+         struct index_entry
+         {
+            uint64_t sequence;
+            uint32_t block_num;
+            uint32_t block_time;
+            uint16_t operation_type;
+         };
+         struct run_file;
+
+         static uint64_t account_key( account_id_type account );
+         static uint64_t asset_key( asset_id_type asset );
+         static uint64_t operation_type_key( int64_t operation_type );
+
+         void add_to_memtable( const stored_operation& op );
+         /** Writes the open chunk to the log */
+         void write_chunk();
+         /** Writes the memtable to a new run, starts merging the runs if there are too many of a level */
+         void write_run();
+         /** @return the first and the end position of runs to merge, both the number of runs if there are none */
+         std::pair<size_t,size_t> runs_to_merge()const;
+         /** Starts merge_runs in the background if it is not running and there are runs to merge */
+         void start_merge();
+         /** Merges runs until there are none to merge, with _mutex locked only to swap the runs */
+         void merge_runs();
+         std::string run_filename( uint32_t number )const;
+         void save_index()const;
+         /** Adds the chunks from position onwards to the index, truncates an incomplete last chunk */
+         void scan( uint64_t position );
+
+         /** @return the operations of the chunk at position i of the chunk index */
+         std::vector<stored_operation> read_chunk( size_t i )const;
+         /** @return the stored operation with sequence, from a chunk or the open chunk */
+         const stored_operation& get( uint64_t sequence, size_t& cached_chunk,
+                                      std::vector<stored_operation>& cache )const;
+         std::vector<stored_operation> query_chunks( const history_query& q )const;
+         std::vector<uint64_t> query_index( uint64_t key, const history_query& q )const;
+
+         const fc::path                               _dir;
+         const fc::path                               _log_filename;
+         const fc::path                               _index_filename;
+         const options_type                           _options;
+         mutable std::fstream                         _log;
+         store_index                                  _index;
+         std::vector< std::unique_ptr<run_file> >     _run_files;
+         /// Operations of the chunk which is not written yet
+         std::vector<stored_operation>                _open_chunk;
+         std::map< uint64_t, std::vector<index_entry> > _memtable;
+         uint64_t                                     _memtable_entries = 0;
+         uint64_t                                     _next_sequence = 0;
+         uint32_t                                     _last_block = 0;
+         mutable std::mutex                           _mutex;
+         std::atomic<bool>                            _closing{ false };
+         /// The running merge_runs, destroyed first so that it is finished before the members it uses
+         std::future<void>                            _merge;
+   };
+
+} } // graphene::history_store
+
+FC_REFLECT( graphene::history_store::stored_operation, (sequence)(block_time)(operation) )
+FC_REFLECT( graphene::history_store::history_query,
+            (account)(asset)(operation_type)(operation_types)(start_time)(end_time)(start_block)(end_block)
+            (max_sequence)(limit) )
+FC_REFLECT( graphene::history_store::chunk_info,
+            (position)(first_sequence)(count)(first_block)(last_block)(first_time)(last_time) )
+FC_REFLECT( graphene::history_store::stored_chunk, (info)(compressed)(data) )
+FC_REFLECT( graphene::history_store::history_run, (number)(entries)(max_sequence)(level) )
+FC_REFLECT( graphene::history_store::store_index, (log_size)(chunks)(runs)(next_run) )
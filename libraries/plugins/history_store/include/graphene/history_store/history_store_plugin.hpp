@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/history_store/history_store.hpp>
+
+#include <graphene/app/plugin.hpp>
+#include <graphene/chain/database.hpp>
+
+namespace graphene { namespace history_store {
+   using namespace chain;
+
+namespace detail
+{
+    class history_store_plugin_impl;
+}
+
+/**
+ *  Stores the full operation history on disk in a history_store, which the history API queries by account,
+ *  asset, operation type, block and time, without an external database.
+ *
+ *  The operations of a block are stored once the block is irreversible, the blocks applied since are written
+ *  when the plugin is shut down.
+ *
+ *  The plugins named in history-store-rebuild-plugins are rebuilt from the store at startup, which is much faster
+ *  than a replay, as only the plugins process the operations and no block is evaluated again.
+ */
+class history_store_plugin : public graphene::app::plugin
+{
+   public:
+      history_store_plugin();
+      virtual ~history_store_plugin();
+
+      std::string plugin_name()const override;
+      std::string plugin_description()const override;
+      virtual void plugin_set_program_options(
+         boost::program_options::options_description& cli,
+         boost::program_options::options_description& cfg) override;
+      virtual void plugin_initialize(const boost::program_options::variables_map& options) override;
+      virtual void plugin_startup() override;
+      virtual void plugin_shutdown() override;
+
+      /// @return the store, null before the plugin is started
+      const history_store* store()const;
+
+      /**
+       * Drops the state of the plugin named and builds it again from the operations stored up to the head block,
+       * see @ref graphene::app::abstract_plugin::plugin_rebuild_start. The store has to hold the operations of
+       * all the blocks, i.e. the plugin was enabled since the chain was replayed the last time. The rebuilt state
+       * can not be undone, so it is done at startup.
+       */
+      void rebuild_plugin( const std::string& name );
+
+      friend class detail::history_store_plugin_impl;
+      std::unique_ptr<detail::history_store_plugin_impl> my;
+};
+
+} } //graphene::history_store
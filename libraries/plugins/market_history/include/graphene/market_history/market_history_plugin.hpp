@@ -31,6 +31,8 @@
 
 #include <boost/multi_index/composite_key.hpp>
 
+#include <deque>
+
 namespace graphene { namespace market_history {
 using namespace chain;
 
@@ -53,7 +55,7 @@ enum market_history_object_type
    order_history_object_type = 0,
    bucket_object_type = 1,
    market_ticker_object_type = 2,
-   market_ticker_meta_object_type = 3
+   market_ticker_window_object_type = 3
 };
 
 struct bucket_key
@@ -150,13 +152,22 @@ struct market_ticker_object : public abstract_object<market_ticker_object>
    fc::uint128_t       quote_volume;
 };
 
-struct market_ticker_meta_object : public abstract_object<market_ticker_meta_object>
+/**
+ *  The maker fills of one market in one minute, which are added to the market ticker as they happen and rolled out of
+ *  it in one step once the whole minute is more than 24 hours old.
+ */
+struct market_ticker_window_object : public abstract_object<market_ticker_window_object>
 {
    static const uint8_t space_id = MARKET_HISTORY_SPACE_ID;
-   static const uint8_t type_id  = market_ticker_meta_object_type;
+   static const uint8_t type_id  = market_ticker_window_object_type;
 
-   object_id_type      rolling_min_order_his_id;
-   bool                skip_min_order_his_id = false;
+   asset_id_type       base;
+   asset_id_type       quote;
+   fc::time_point_sec  minute;
+   share_type          close_base;
+   share_type          close_quote;
+   fc::uint128_t       base_volume;
+   fc::uint128_t       quote_volume;
 };
 
 struct by_key;
@@ -212,9 +223,61 @@ typedef multi_index_container<
    >
 > market_ticker_object_multi_index_type;
 
+struct by_minute;
+typedef multi_index_container<
+   market_ticker_window_object,
+   indexed_by<
+      ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
+      ordered_unique<
+         tag<by_market>,
+         composite_key<
+            market_ticker_window_object,
+            member<market_ticker_window_object, asset_id_type, &market_ticker_window_object::base>,
+            member<market_ticker_window_object, asset_id_type, &market_ticker_window_object::quote>,
+            member<market_ticker_window_object, fc::time_point_sec, &market_ticker_window_object::minute>
+         >
+      >,
+      ordered_unique<
+         tag<by_minute>,
+         composite_key<
+            market_ticker_window_object,
+            member<market_ticker_window_object, fc::time_point_sec, &market_ticker_window_object::minute>,
+            member<market_ticker_window_object, asset_id_type, &market_ticker_window_object::base>,
+            member<market_ticker_window_object, asset_id_type, &market_ticker_window_object::quote>
+         >
+      >
+   >
+> market_ticker_window_multi_index_type;
+
 typedef generic_index<bucket_object, bucket_object_multi_index_type> bucket_index;
 typedef generic_index<order_history_object, order_history_multi_index_type> history_index;
 typedef generic_index<market_ticker_object, market_ticker_object_multi_index_type> market_ticker_index;
+typedef generic_index<market_ticker_window_object, market_ticker_window_multi_index_type> market_ticker_window_index;
+
+/**
+ *  A secondary index of the bucket_index, which keeps the buckets of each market and bucket size as one series
+ *  sorted by opening time, so that a time range of candles is a contiguous slice found by binary search.
+ *
+ *  The buckets themselves stay in the bucket_index, so they are still restored on undo and saved with the object
+ *  database; the series follow them through the notifications of the primary index.
+ */
+class bucket_series_index : public secondary_index
+{
+   public:
+      typedef std::deque< const bucket_object* > series_type;
+
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+
+      virtual size_t memory_usage()const override;
+
+      /** @return the buckets of the market with the given size ordered by opening time, null if there are none */
+      const series_type* find( asset_id_type base, asset_id_type quote, uint32_t seconds )const;
+
+   private:
+      std::map< std::tuple< asset_id_type, asset_id_type, uint32_t >, series_type > _series;
+      size_t _size = 0;
+};
 
 
 namespace detail
@@ -240,11 +303,24 @@ class market_history_plugin : public graphene::app::plugin
       virtual void plugin_initialize(
          const boost::program_options::variables_map& options) override;
       virtual void plugin_startup() override;
+      /// The buckets, order history and tickers are rebuilt from the fill operations, with the current options
+      virtual bool plugin_rebuild_start() override;
+      virtual void plugin_rebuild_block( uint32_t block_num, fc::time_point_sec block_time,
+                                         const std::vector<operation_history_object>& ops ) override;
 
       uint32_t                    max_history()const;
       const flat_set<uint32_t>&   tracked_buckets()const;
       uint32_t                    max_order_his_records_per_market()const;
       uint32_t                    max_order_his_seconds_per_market()const;
+      bool                        bucket_rollup()const;
+
+      /**
+       * @return the buckets of a market with the given size opening in [start, end], at most limit of them. With
+       * bucket-rollup, the larger buckets which did not close yet are built from the smaller ones and have no id.
+       */
+      vector<bucket_object> get_market_history( asset_id_type base, asset_id_type quote, uint32_t bucket_seconds,
+                                                fc::time_point_sec start, fc::time_point_sec end,
+                                                uint32_t limit )const;
 
    private:
       friend class detail::market_history_plugin_impl;
@@ -268,5 +344,7 @@ FC_REFLECT_DERIVED( graphene::market_history::market_ticker_object, (graphene::d
                     (last_day_base)(last_day_quote)
                     (latest_base)(latest_quote)
                     (base_volume)(quote_volume) )
-FC_REFLECT_DERIVED( graphene::market_history::market_ticker_meta_object, (graphene::db::object),
-                    (rolling_min_order_his_id)(skip_min_order_his_id) )
+FC_REFLECT_DERIVED( graphene::market_history::market_ticker_window_object, (graphene::db::object),
+                    (base)(quote)(minute)
+                    (close_base)(close_quote)
+                    (base_volume)(quote_volume) )
@@ -51,6 +51,22 @@ class market_history_plugin_impl
        * and will process/index all operations that were applied in the block.
        */
       void update_market_histories( const signed_block& b );
+      /** process the operations applied in a block with the given time, null entries are skipped */
+      void update_market_histories( const vector<optional< operation_history_object > >& hist,
+                                    fc::time_point_sec block_time );
+      /** removes the order history, the buckets and the tickers */
+      void clear_market_histories();
+
+      /**
+       * @return the buckets of a market with the given size opening in [start, end], at most limit of them.
+       * In bucket-rollup mode the buckets which are not rolled up yet are built from the next finer size.
+       */
+      vector<bucket_object> get_buckets( asset_id_type base, asset_id_type quote, uint32_t seconds,
+                                         fc::time_point_sec start, fc::time_point_sec end, uint32_t limit )const;
+      /** in bucket-rollup mode, stores the coarser buckets of a market which closed before now */
+      void rollup_buckets( asset_id_type base, asset_id_type quote, fc::time_point_sec now );
+      /** @return the tracked bucket size coarser buckets are built from in bucket-rollup mode, 0 if none */
+      uint32_t finer_bucket( uint32_t seconds )const;
 
       graphene::chain::database& database()
       {
@@ -58,10 +74,15 @@ class market_history_plugin_impl
       }
 
       market_history_plugin&     _self;
+      primary_index< bucket_index >*               _bucket_index = nullptr;
+      primary_index< history_index >*              _history_index = nullptr;
+      primary_index< market_ticker_index >*        _ticker_index = nullptr;
+      primary_index< market_ticker_window_index >* _ticker_window_index = nullptr;
       flat_set<uint32_t>         _tracked_buckets;
       uint32_t                   _maximum_history_per_bucket_size = 1000;
       uint32_t                   _max_order_his_records_per_market = 1000;
       uint32_t                   _max_order_his_seconds_per_market = 259200;
+      bool                       _bucket_rollup = false;
 };
 
 
@@ -69,10 +90,12 @@ struct operation_process_fill_order
 {
    market_history_plugin&            _plugin;
    fc::time_point_sec                _now;
-   const market_ticker_meta_object*& _meta;
+   /// the markets whose buckets changed, for bucket-rollup mode
+   flat_set< std::pair< asset_id_type, asset_id_type > >& _filled_markets;
 
-   operation_process_fill_order( market_history_plugin& mhp, fc::time_point_sec n, const market_ticker_meta_object*& meta )
-   :_plugin(mhp),_now(n),_meta(meta) {}
+   operation_process_fill_order( market_history_plugin& mhp, fc::time_point_sec n,
+                                 flat_set< std::pair< asset_id_type, asset_id_type > >& filled_markets )
+   :_plugin(mhp),_now(n),_filled_markets(filled_markets) {}
 
    typedef void result_type;
 
@@ -103,25 +126,12 @@ struct operation_process_fill_order
       else
          hkey.sequence = 0;
 
-      const auto& new_order_his_obj = db.create<order_history_object>( [&]( order_history_object& ho ) {
+      db.create<order_history_object>( [&]( order_history_object& ho ) {
          ho.key = hkey;
          ho.time = _now;
          ho.op = o;
       });
 
-      // save a reference to market ticker meta object
-      if( _meta == nullptr )
-      {
-         const auto& meta_idx = db.get_index_type<simple_index<market_ticker_meta_object>>();
-         if( meta_idx.size() == 0 )
-            _meta = &db.create<market_ticker_meta_object>( [&]( market_ticker_meta_object& mtm ) {
-               mtm.rolling_min_order_his_id = new_order_his_obj.id;
-               mtm.skip_min_order_his_id = false;
-            });
-         else
-            _meta = &( *meta_idx.begin() );
-      }
-
       // To remove old filled order data
       const auto max_records = _plugin.max_order_his_records_per_market();
       hkey.sequence += max_records;
@@ -202,6 +212,32 @@ struct operation_process_fill_order
          });
       }
 
+      // To remember when to roll the fill out of the ticker data
+      const auto minute = fc::time_point_sec() + _now.sec_since_epoch() / 60 * 60;
+      const auto& window_idx = db.get_index_type<market_ticker_window_index>().indices().get<by_market>();
+      auto window_itr = window_idx.find( std::make_tuple( key.base, key.quote, minute ) );
+      if( window_itr == window_idx.end() )
+      {
+         db.create<market_ticker_window_object>( [&]( market_ticker_window_object& mtw ) {
+            mtw.base         = key.base;
+            mtw.quote        = key.quote;
+            mtw.minute       = minute;
+            mtw.close_base   = fill_price.base.amount;
+            mtw.close_quote  = fill_price.quote.amount;
+            mtw.base_volume  = trade_price.base.amount.value;
+            mtw.quote_volume = trade_price.quote.amount.value;
+         });
+      }
+      else
+      {
+         db.modify( *window_itr, [&]( market_ticker_window_object& mtw ) {
+            mtw.close_base   = fill_price.base.amount;
+            mtw.close_quote  = fill_price.quote.amount;
+            mtw.base_volume  += trade_price.base.amount.value;  // ignore overflow
+            mtw.quote_volume += trade_price.quote.amount.value; // ignore overflow
+         });
+      }
+
       // To update buckets data
       const auto max_history = _plugin.max_history();
       if( max_history == 0 ) return;
@@ -209,9 +245,16 @@ struct operation_process_fill_order
       const auto& buckets = _plugin.tracked_buckets();
       if( buckets.size() == 0 ) return;
 
+      // in bucket-rollup mode only the finest buckets are updated on fills
+      const bool rollup = _plugin.bucket_rollup();
+      if( rollup )
+         _filled_markets.insert( std::make_pair( key.base, key.quote ) );
+
       const auto& bucket_idx = db.get_index_type<bucket_index>();
       for( auto bucket : buckets )
       {
+          if( rollup && bucket != *buckets.begin() )
+             break;
           auto bucket_num = _now.sec_since_epoch() / bucket;
           fc::time_point_sec cutoff;
           if( bucket_num > max_history )
@@ -270,6 +313,8 @@ struct operation_process_fill_order
              //wlog( "    after bucket bucket ${b}", ("b",*bucket_itr) );
           }
 
+          // in bucket-rollup mode the buckets are removed after the larger ones are built from them
+          if( !rollup )
           {
              key.open = fc::time_point_sec();
              bucket_itr = by_key_idx.lower_bound( key );
@@ -293,93 +338,247 @@ struct operation_process_fill_order
 market_history_plugin_impl::~market_history_plugin_impl()
 {}
 
-void market_history_plugin_impl::update_market_histories( const signed_block& b )
-{
-   graphene::chain::database& db = database();
-   const market_ticker_meta_object* _meta = nullptr;
-   const auto& meta_idx = db.get_index_type<simple_index<market_ticker_meta_object>>();
-   if( meta_idx.size() > 0 )
-      _meta = &( *meta_idx.begin() );
-   const vector<optional< operation_history_object > >& hist = db.get_applied_operations();
-   for( const optional< operation_history_object >& o_op : hist )
+namespace {
+   bool opens_before( const bucket_object* bucket, const fc::time_point_sec open )
    {
-      if( o_op.valid() )
+      return bucket->key.open < open;
+   }
+
+   /** adds the trades of bucket to candle, bucket opens after the trades already in candle */
+   void merge_bucket( bucket_object& candle, const bucket_object& bucket )
+   {
+      candle.close_base = bucket.close_base;
+      candle.close_quote = bucket.close_quote;
+      if( candle.high() < bucket.high() )
       {
-         try
-         {
-            o_op->op.visit( operation_process_fill_order( _self, b.timestamp, _meta ) );
-         } FC_CAPTURE_AND_LOG( (o_op) )
+         candle.high_base = bucket.high_base;
+         candle.high_quote = bucket.high_quote;
+      }
+      if( candle.low() > bucket.low() )
+      {
+         candle.low_base = bucket.low_base;
+         candle.low_quote = bucket.low_quote;
+      }
+      try {
+         candle.base_volume += bucket.base_volume;
+      } catch( fc::overflow_exception& ) {
+         candle.base_volume = std::numeric_limits<int64_t>::max();
+      }
+      try {
+         candle.quote_volume += bucket.quote_volume;
+      } catch( fc::overflow_exception& ) {
+         candle.quote_volume = std::numeric_limits<int64_t>::max();
       }
    }
-   // roll out expired data from ticker
-   if( _meta != nullptr )
-   {
-      time_point_sec last_day = b.timestamp - 86400;
-      object_id_type last_min_his_id = _meta->rolling_min_order_his_id;
-      bool skip = _meta->skip_min_order_his_id;
 
-      const auto& ticker_idx = db.get_index_type<market_ticker_index>().indices().get<by_market>();
-      const auto& history_idx = db.get_index_type<history_index>().indices().get<by_id>();
-      auto history_itr = history_idx.lower_bound( _meta->rolling_min_order_his_id );
-      while( history_itr != history_idx.end() && history_itr->time < last_day )
+   /** groups buckets ordered by opening time into candles of the given size, appending them to result */
+   void group_buckets( const vector<bucket_object>& buckets, uint32_t seconds, vector<bucket_object>& result )
+   {
+      const size_t first = result.size();
+      for( const auto& bucket : buckets )
       {
-         const fill_order_operation& o = history_itr->op;
-         if( skip && history_itr->id == _meta->rolling_min_order_his_id )
-            skip = false;
-         else if( o.is_maker )
+         const fc::time_point_sec open = fc::time_point_sec() + bucket.key.open.sec_since_epoch() / seconds * seconds;
+         if( result.size() > first && result.back().key.open == open )
+            merge_bucket( result.back(), bucket );
+         else
          {
-            bucket_key key;
-            key.base    = o.pays.asset_id;
-            key.quote   = o.receives.asset_id;
+            // built on query, so it has no id
+            result.push_back( bucket );
+            result.back().id = object_id_type();
+            result.back().key.seconds = seconds;
+            result.back().key.open = open;
+         }
+      }
+   }
+}
 
-            price trade_price = o.pays / o.receives;
+uint32_t market_history_plugin_impl::finer_bucket( uint32_t seconds )const
+{
+   if( !_bucket_rollup )
+      return 0;
+   auto itr = _tracked_buckets.find( seconds );
+   if( itr == _tracked_buckets.end() || itr == _tracked_buckets.begin() )
+      return 0;
+   return *(--itr);
+}
 
-            if( key.base > key.quote )
-            {
-               std::swap( key.base, key.quote );
-               trade_price = ~trade_price;
-            }
+vector<bucket_object> market_history_plugin_impl::get_buckets( asset_id_type base, asset_id_type quote,
+                                                               uint32_t seconds, fc::time_point_sec start,
+                                                               fc::time_point_sec end, uint32_t limit )const
+{
+   vector<bucket_object> result;
+   const auto& series_idx = _self.database().get_index_type< primary_index< bucket_index > >()
+                                            .get_secondary_index< bucket_series_index >();
+   fc::time_point_sec not_stored_after = start;
+   const auto* series = series_idx.find( base, quote, seconds );
+   if( series != nullptr )
+   {
+      auto itr = std::lower_bound( series->begin(), series->end(), start, opens_before );
+      while( itr != series->end() && (*itr)->key.open <= end && result.size() < limit )
+      {
+         result.push_back( **itr );
+         ++itr;
+      }
+      not_stored_after = std::max( not_stored_after, series->back()->key.open + seconds );
+   }
 
-            price fill_price = o.fill_price;
-            if( fill_price.base.asset_id > fill_price.quote.asset_id )
-               fill_price = ~fill_price;
+   const uint32_t finer = finer_bucket( seconds );
+   if( finer == 0 || result.size() >= limit || not_stored_after > end )
+      return result;
+
+   // the first bucket opening at or after not_stored_after, and the end of the last one opening before end
+   const uint64_t from = ( uint64_t( not_stored_after.sec_since_epoch() ) + seconds - 1 ) / seconds * seconds;
+   const uint64_t to = std::min< uint64_t >( uint64_t( end.sec_since_epoch() ) / seconds * seconds + seconds - 1,
+                                             std::numeric_limits<uint32_t>::max() );
+   if( from > to )
+      return result;
+   const uint64_t finer_limit = std::min< uint64_t >( uint64_t( limit - result.size() ) * ( seconds / finer ),
+                                                      std::numeric_limits<uint32_t>::max() );
+   const auto parts = get_buckets( base, quote, finer, fc::time_point_sec() + uint32_t( from ),
+                                   fc::time_point_sec() + uint32_t( to ), uint32_t( finer_limit ) );
+   group_buckets( parts, seconds, result );
+   if( result.size() > limit )
+      result.resize( limit );
+   return result;
+}
 
-            auto ticker_itr = ticker_idx.find( std::make_tuple( key.base, key.quote ) );
-            if( ticker_itr != ticker_idx.end() ) // should always be true
-            {
-               db.modify( *ticker_itr, [&]( market_ticker_object& mt ) {
-                  mt.last_day_base  = fill_price.base.amount;
-                  mt.last_day_quote = fill_price.quote.amount;
-                  mt.base_volume    -= trade_price.base.amount.value;  // ignore underflow
-                  mt.quote_volume   -= trade_price.quote.amount.value; // ignore underflow
-               });
-            }
-         }
-         last_min_his_id = history_itr->id;
-         ++history_itr;
+void market_history_plugin_impl::rollup_buckets( asset_id_type base, asset_id_type quote, fc::time_point_sec now )
+{
+   graphene::chain::database& db = database();
+   const auto& series_idx = db.get_index_type< primary_index< bucket_index > >()
+                              .get_secondary_index< bucket_series_index >();
+   const auto& by_key_idx = db.get_index_type<bucket_index>().indices().get<by_key>();
+   const auto cutoff_of = [this,now]( uint32_t seconds ) {
+      const auto bucket_num = now.sec_since_epoch() / seconds;
+      fc::time_point_sec cutoff;
+      if( bucket_num > _maximum_history_per_bucket_size )
+         cutoff = cutoff + ( seconds * ( bucket_num - _maximum_history_per_bucket_size ) );
+      return cutoff;
+   };
+   // Finer sizes first, so that the coarser ones are built from what was just stored. In a market without
+   // trades for a long time the candles closed since the last rollup are built from buckets which are already
+   // beyond the history of their size, so nothing is removed before all sizes are built.
+   for( auto size_itr = std::next( _tracked_buckets.begin() ); size_itr != _tracked_buckets.end(); ++size_itr )
+   {
+      const uint32_t seconds = *size_itr;
+      const fc::time_point_sec current = fc::time_point_sec() + now.sec_since_epoch() / seconds * seconds;
+      const fc::time_point_sec cutoff = cutoff_of( seconds );
+
+      fc::time_point_sec from = cutoff;
+      const auto* series = series_idx.find( base, quote, seconds );
+      if( series != nullptr )
+         from = std::max( from, series->back()->key.open + seconds );
+      if( from >= current )
+         continue;
+
+      // the buckets which closed since the last rollup
+      for( const auto& candle : get_buckets( base, quote, seconds, from, current - 1,
+                                             std::numeric_limits<uint32_t>::max() ) )
+      {
+         db.create<bucket_object>( [&candle]( bucket_object& b ){
+            b.key = candle.key;
+            b.high_base = candle.high_base;
+            b.high_quote = candle.high_quote;
+            b.low_base = candle.low_base;
+            b.low_quote = candle.low_quote;
+            b.open_base = candle.open_base;
+            b.open_quote = candle.open_quote;
+            b.close_base = candle.close_base;
+            b.close_quote = candle.close_quote;
+            b.base_volume = candle.base_volume;
+            b.quote_volume = candle.quote_volume;
+         });
       }
-      // update meta
-      if( history_itr != history_idx.end() ) // if still has some data rolling
+   }
+
+   for( const uint32_t seconds : _tracked_buckets )
+   {
+      const fc::time_point_sec cutoff = cutoff_of( seconds );
+      auto bucket_itr = by_key_idx.lower_bound( bucket_key( base, quote, seconds, fc::time_point_sec() ) );
+      while( bucket_itr != by_key_idx.end() &&
+             bucket_itr->key.base == base &&
+             bucket_itr->key.quote == quote &&
+             bucket_itr->key.seconds == seconds &&
+             bucket_itr->key.open < cutoff )
       {
-         if( history_itr->id != _meta->rolling_min_order_his_id ) // if rolled out some
-         {
-            db.modify( *_meta, [&]( market_ticker_meta_object& mtm ) {
-               mtm.rolling_min_order_his_id = history_itr->id;
-               mtm.skip_min_order_his_id = false;
-            });
-         }
+         auto old_bucket_itr = bucket_itr;
+         ++bucket_itr;
+         db.remove( *old_bucket_itr );
       }
-      else // if all data are rolled out
+   }
+}
+
+namespace {
+   template<typename IndexType>
+   void clear_index( graphene::chain::database& db, IndexType* idx )
+   {
+      const auto& objects = idx->indices();
+      while( !objects.empty() )
+         db.remove( *objects.begin() );
+      idx->set_next_id( object_id_type( IndexType::object_type::space_id, IndexType::object_type::type_id, 0 ) );
+   }
+}
+
+void market_history_plugin_impl::clear_market_histories()
+{
+   graphene::chain::database& db = database();
+   // the indexes may still be loading in the background, @see object_database::load_in_background
+   db.wait_for_background_loads();
+   clear_index( db, _bucket_index );
+   clear_index( db, _history_index );
+   clear_index( db, _ticker_window_index );
+   clear_index( db, _ticker_index );
+}
+
+void market_history_plugin_impl::update_market_histories( const signed_block& b )
+{
+   update_market_histories( database().get_applied_operations(), b.timestamp );
+}
+
+void market_history_plugin_impl::update_market_histories( const vector<optional< operation_history_object > >& hist,
+                                                          fc::time_point_sec block_time )
+{
+   graphene::chain::database& db = database();
+   flat_set< std::pair< asset_id_type, asset_id_type > > filled_markets;
+   for( const optional< operation_history_object >& o_op : hist )
+   {
+      if( o_op.valid() )
       {
-         if( !_meta->skip_min_order_his_id
-             || last_min_his_id != _meta->rolling_min_order_his_id ) // if rolled out some
+         try
          {
-            db.modify( *_meta, [&]( market_ticker_meta_object& mtm ) {
-               mtm.rolling_min_order_his_id = last_min_his_id;
-               mtm.skip_min_order_his_id = true;
-            });
-         }
+            o_op->op.visit( operation_process_fill_order( _self, block_time, filled_markets ) );
+         } FC_CAPTURE_AND_LOG( (o_op) )
+      }
+   }
+   for( const auto& market : filled_markets )
+   {
+      try
+      {
+         rollup_buckets( market.first, market.second, block_time );
+      } FC_CAPTURE_AND_LOG( (market) )
+   }
+   // roll out expired data from ticker, one minute of a market at a time
+   if( block_time.sec_since_epoch() < 86400 )
+      return;
+   const time_point_sec last_day = block_time - 86400;
+   const auto& ticker_idx = db.get_index_type<market_ticker_index>().indices().get<by_market>();
+   const auto& window_idx = db.get_index_type<market_ticker_window_index>().indices().get<by_minute>();
+   auto window_itr = window_idx.begin();
+   while( window_itr != window_idx.end() && window_itr->minute + 60 <= last_day )
+   {
+      auto ticker_itr = ticker_idx.find( std::make_tuple( window_itr->base, window_itr->quote ) );
+      if( ticker_itr != ticker_idx.end() ) // should always be true
+      {
+         db.modify( *ticker_itr, [&]( market_ticker_object& mt ) {
+            mt.last_day_base  = window_itr->close_base;
+            mt.last_day_quote = window_itr->close_quote;
+            mt.base_volume    -= window_itr->base_volume;  // ignore underflow
+            mt.quote_volume   -= window_itr->quote_volume; // ignore underflow
+         });
       }
+      auto old_window_itr = window_itr;
+      ++window_itr;
+      db.remove( *old_window_itr );
    }
 }
 
@@ -399,6 +598,55 @@ market_history_plugin::~market_history_plugin()
 {
 }
 
+void bucket_series_index::object_inserted( const object& obj )
+{
+   const auto& bucket = static_cast<const bucket_object&>( obj );
+   auto& series = _series[ std::make_tuple( bucket.key.base, bucket.key.quote, bucket.key.seconds ) ];
+   // new buckets open after the others, except when they are restored by an undo
+   if( series.empty() || series.back()->key.open < bucket.key.open )
+      series.push_back( &bucket );
+   else
+      series.insert( std::lower_bound( series.begin(), series.end(), bucket.key.open, opens_before ), &bucket );
+   ++_size;
+}
+
+void bucket_series_index::object_removed( const object& obj )
+{
+   const auto& bucket = static_cast<const bucket_object&>( obj );
+   auto series_itr = _series.find( std::make_tuple( bucket.key.base, bucket.key.quote, bucket.key.seconds ) );
+   if( series_itr == _series.end() )
+      return;
+   auto& series = series_itr->second;
+   // old buckets are removed from the front
+   if( !series.empty() && series.front() == &bucket )
+      series.pop_front();
+   else
+   {
+      auto itr = std::lower_bound( series.begin(), series.end(), bucket.key.open, opens_before );
+      if( itr == series.end() || *itr != &bucket )
+         return;
+      series.erase( itr );
+   }
+   --_size;
+   if( series.empty() )
+      _series.erase( series_itr );
+}
+
+size_t bucket_series_index::memory_usage()const
+{
+   return _size * sizeof( const bucket_object* )
+          + _series.size() * ( sizeof( decltype(_series)::value_type ) + 3 * sizeof( void* ) );
+}
+
+const bucket_series_index::series_type* bucket_series_index::find( asset_id_type base, asset_id_type quote,
+                                                                   uint32_t seconds )const
+{
+   auto itr = _series.find( std::make_tuple( base, quote, seconds ) );
+   if( itr == _series.end() )
+      return nullptr;
+   return &itr->second;
+}
+
 std::string market_history_plugin::plugin_name()const
 {
    return "market_history";
@@ -418,6 +666,9 @@ void market_history_plugin::plugin_set_program_options(
            "Will only store this amount of matched orders for each market in order history for querying, or those meet the other option, which has more data (default: 1000)")
          ("max-order-his-seconds-per-market", boost::program_options::value<uint32_t>()->default_value(259200),
            "Will only store matched orders in last X seconds for each market in order history for querying, or those meet the other option, which has more data (default: 259200 (3 days))")
+         ("bucket-rollup", boost::program_options::bool_switch()->default_value(false),
+           "Update only the smallest bucket size on fills and build the larger ones from the next smaller size "
+           "once they close, each size has to be a multiple of the next smaller one (default: false)")
          ;
    cfg.add(cli);
 }
@@ -425,10 +676,11 @@ void market_history_plugin::plugin_set_program_options(
 void market_history_plugin::plugin_initialize(const boost::program_options::variables_map& options)
 { try {
    database().applied_block.connect( [this]( const signed_block& b){ my->update_market_histories(b); } );
-   database().add_index< primary_index< bucket_index  > >();
-   database().add_index< primary_index< history_index  > >();
-   database().add_index< primary_index< market_ticker_index  > >();
-   database().add_index< primary_index< simple_index< market_ticker_meta_object > > >();
+   my->_bucket_index = database().add_index< primary_index< bucket_index  > >();
+   database().add_secondary_index< primary_index< bucket_index >, bucket_series_index >();
+   my->_history_index = database().add_index< primary_index< history_index  > >();
+   my->_ticker_index = database().add_index< primary_index< market_ticker_index  > >();
+   my->_ticker_window_index = database().add_index< primary_index< market_ticker_window_index > >();
 
    if( options.count( "bucket-size" ) )
    {
@@ -442,12 +694,37 @@ void market_history_plugin::plugin_initialize(const boost::program_options::vari
       my->_max_order_his_records_per_market = options["max-order-his-records-per-market"].as<uint32_t>();
    if( options.count( "max-order-his-seconds-per-market" ) )
       my->_max_order_his_seconds_per_market = options["max-order-his-seconds-per-market"].as<uint32_t>();
+   if( options.count( "bucket-rollup" ) )
+      my->_bucket_rollup = options["bucket-rollup"].as<bool>();
+   if( my->_bucket_rollup )
+   {
+      uint32_t finer = 0;
+      for( const auto seconds : my->_tracked_buckets )
+      {
+         FC_ASSERT( finer == 0 || seconds % finer == 0,
+                    "With bucket-rollup every bucket size has to be a multiple of the next smaller one, ${s} is not",
+                    ("s",seconds) );
+         finer = seconds;
+      }
+   }
 } FC_CAPTURE_AND_RETHROW() }
 
 void market_history_plugin::plugin_startup()
 {
 }
 
+bool market_history_plugin::plugin_rebuild_start()
+{
+   my->clear_market_histories();
+   return true;
+}
+
+void market_history_plugin::plugin_rebuild_block( uint32_t block_num, fc::time_point_sec block_time,
+                                                  const std::vector<operation_history_object>& ops )
+{
+   my->update_market_histories( vector<optional< operation_history_object > >( ops.begin(), ops.end() ), block_time );
+}
+
 const flat_set<uint32_t>& market_history_plugin::tracked_buckets() const
 {
    return my->_tracked_buckets;
@@ -468,4 +745,18 @@ uint32_t market_history_plugin::max_order_his_seconds_per_market()const
    return my->_max_order_his_seconds_per_market;
 }
 
+bool market_history_plugin::bucket_rollup()const
+{
+   return my->_bucket_rollup;
+}
+
+vector<bucket_object> market_history_plugin::get_market_history( asset_id_type base, asset_id_type quote,
+                                                                 uint32_t bucket_seconds, fc::time_point_sec start,
+                                                                 fc::time_point_sec end, uint32_t limit )const
+{
+   if( base > quote )
+      std::swap( base, quote );
+   return my->get_buckets( base, quote, bucket_seconds, start, end, limit );
+}
+
 } }
@@ -30,6 +30,12 @@
 
 namespace graphene { namespace snapshot_plugin {
 
+/**
+ *  Writes all objects of db to dest as JSON, one object per line. The indexes are serialized in parallel, so db
+ *  must not be modified until this returns.
+ */
+void write_json_snapshot( const graphene::db::object_database& db, const fc::path& dest );
+
 class snapshot_plugin : public graphene::app::plugin {
    public:
       ~snapshot_plugin() {}
@@ -52,6 +58,7 @@ class snapshot_plugin : public graphene::app::plugin {
        uint32_t           snapshot_block = -1, last_block = 0;
        fc::time_point_sec snapshot_time = fc::time_point_sec::maximum(), last_time = fc::time_point_sec(1);
        fc::path           dest;
+       bool               binary = false;
 };
 
 } } //graphene::snapshot_plugin
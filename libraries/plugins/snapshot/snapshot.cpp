@@ -27,6 +27,8 @@
 
 #include <fc/io/fstream.hpp>
 
+#include <fstream>
+
 using namespace graphene::snapshot_plugin;
 using std::string;
 using std::vector;
@@ -36,6 +38,7 @@ namespace bpo = boost::program_options;
 static const char* OPT_BLOCK_NUM  = "snapshot-at-block";
 static const char* OPT_BLOCK_TIME = "snapshot-at-time";
 static const char* OPT_DEST       = "snapshot-to";
+static const char* OPT_FORMAT     = "snapshot-format";
 
 void snapshot_plugin::plugin_set_program_options(
    boost::program_options::options_description& command_line_options,
@@ -44,7 +47,11 @@ void snapshot_plugin::plugin_set_program_options(
    command_line_options.add_options()
          (OPT_BLOCK_NUM, bpo::value<uint32_t>(), "Block number after which to do a snapshot")
          (OPT_BLOCK_TIME, bpo::value<string>(), "Block time (ISO format) after which to do a snapshot")
-         (OPT_DEST, bpo::value<string>(), "Pathname of JSON file where to store the snapshot")
+         (OPT_DEST, bpo::value<string>(), "Pathname of JSON file or binary snapshot directory where to store the snapshot")
+         (OPT_FORMAT, bpo::value<string>()->default_value("json"),
+          "Format of the snapshot, 'json' for a dump of all objects or 'binary' for a snapshot of the chain state "
+          "that a node can be started from with --load-snapshot. A binary snapshot is written much faster and can "
+          "be converted to JSON later with the snapshot_to_json tool")
          ;
    config_file_options.add(command_line_options);
 }
@@ -67,6 +74,9 @@ void snapshot_plugin::plugin_initialize(const boost::program_options::variables_
    {
       FC_ASSERT( options.count(OPT_DEST), "Must specify snapshot-to in addition to snapshot-at-block or snapshot-at-time!" );
       dest = options[OPT_DEST].as<std::string>();
+      const std::string format = options[OPT_FORMAT].as<std::string>();
+      FC_ASSERT( format == "json" || format == "binary", "Unknown snapshot-format ${f}", ("f",format) );
+      binary = ( format == "binary" );
       if( options.count(OPT_BLOCK_NUM) )
          snapshot_block = options[OPT_BLOCK_NUM].as<uint32_t>();
       if( options.count(OPT_BLOCK_TIME) )
@@ -84,36 +94,78 @@ void snapshot_plugin::plugin_startup() {}
 
 void snapshot_plugin::plugin_shutdown() {}
 
-static void create_snapshot( const graphene::chain::database& db, const fc::path& dest )
+static void create_binary_snapshot( const graphene::chain::database& db, const fc::path& dest )
 {
-   ilog("snapshot plugin: creating snapshot");
-   fc::ofstream out;
    try
    {
-      out.open( dest );
+      db.save_snapshot( dest, GRAPHENE_CURRENT_DB_VERSION );
    }
    catch ( fc::exception& e )
    {
-      wlog( "Failed to open snapshot destination: ${ex}", ("ex",e) );
-      return;
+      wlog( "Failed to create binary snapshot: ${ex}", ("ex",e) );
    }
+}
+
+void graphene::snapshot_plugin::write_json_snapshot( const graphene::db::object_database& db, const fc::path& dest )
+{ try {
+   // Each index is streamed into a part file of its own in parallel, the parts are then joined in index order.
+   // This runs from applied_block, so the thread blocks on the tasks instead of yielding while they read the indexes.
+   const fc::path parts_dir = dest.parent_path() / ( dest.filename().string() + ".parts" );
+   fc::remove_all( parts_dir );
+   fc::create_directories( parts_dir );
+   vector< fc::path > parts;
+   vector< std::future<void> > tasks;
    for( uint32_t space_id = 0; space_id < 256; space_id++ )
       for( uint32_t type_id = 0; type_id < 256; type_id++ )
       {
+         const graphene::db::index* index;
          try
          {
-            db.get_index( (uint8_t)space_id, (uint8_t)type_id );
+            index = &db.get_index( (uint8_t)space_id, (uint8_t)type_id );
          }
          catch (fc::assert_exception& e)
          {
             continue;
          }
-         auto& index = db.get_index( (uint8_t)space_id, (uint8_t)type_id );
-         index.inspect_all_objects( [&out]( const graphene::db::object& o ) {
-            out << fc::json::to_string( o.to_variant() ) << '\n';
-         });
+         parts.push_back( parts_dir / ( fc::to_string( space_id ) + "." + fc::to_string( type_id ) ) );
+         tasks.push_back( db.run_in_background_blocking( [index,part=parts.back()] () {
+            std::ofstream out( part.generic_string(), std::ios::out | std::ios::binary | std::ios::trunc );
+            index->inspect_all_objects( [&out]( const graphene::db::object& o ) {
+               out << fc::json::to_string( o.to_variant() ) << '\n';
+            });
+            out.close();
+            FC_ASSERT( out, "Failed to write ${f}", ("f",part) );
+         }, "write json snapshot" ) );
       }
+   for( auto& task : tasks )
+      task.wait();
+   for( auto& task : tasks )
+      task.get();
+
+   std::ofstream out( dest.generic_string(), std::ios::out | std::ios::binary | std::ios::trunc );
+   for( const auto& part : parts )
+   {
+      std::ifstream in( part.generic_string(), std::ios::in | std::ios::binary );
+      if( in.peek() != std::ifstream::traits_type::eof() )
+         out << in.rdbuf();
+   }
    out.close();
+   FC_ASSERT( out, "Failed to write ${f}", ("f",dest) );
+   fc::remove_all( parts_dir );
+} FC_CAPTURE_AND_RETHROW( (dest) ) }
+
+static void create_snapshot( const graphene::chain::database& db, const fc::path& dest )
+{
+   ilog("snapshot plugin: creating snapshot");
+   try
+   {
+      graphene::snapshot_plugin::write_json_snapshot( db, dest );
+   }
+   catch ( fc::exception& e )
+   {
+      wlog( "Failed to create snapshot: ${ex}", ("ex",e) );
+      return;
+   }
    ilog("snapshot plugin: created snapshot");
 }
 
@@ -122,7 +174,12 @@ void snapshot_plugin::check_snapshot( const graphene::chain::signed_block& b )
     uint32_t current_block = b.block_num();
     if( (last_block < snapshot_block && snapshot_block <= current_block)
            || (last_time < snapshot_time && snapshot_time <= b.timestamp) )
-       create_snapshot( database(), dest );
+    {
+       if( binary )
+          create_binary_snapshot( database(), dest );
+       else
+          create_snapshot( database(), dest );
+    }
     last_block = current_block;
     last_time = b.timestamp;
 } FC_LOG_AND_RETHROW() }
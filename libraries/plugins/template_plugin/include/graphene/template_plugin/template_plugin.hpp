@@ -62,6 +62,7 @@ class template_plugin : public graphene::app::plugin
          boost::program_options::options_description& cfg) override;
       virtual void plugin_initialize(const boost::program_options::variables_map& options) override;
       virtual void plugin_startup() override;
+      virtual void plugin_shutdown() override;
 
       friend class detail::template_plugin_impl;
       std::unique_ptr<detail::template_plugin_impl> my;
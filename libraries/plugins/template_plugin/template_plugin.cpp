@@ -37,7 +37,8 @@ class template_plugin_impl
       {  }
       virtual ~template_plugin_impl();
 
-      void onBlock( const signed_block& b );
+      /** called on the block consumer thread of the plugin for each applied block, must not access the database */
+      void onBlock( const graphene::app::applied_block_data& b );
 
       graphene::chain::database& database()
       {
@@ -52,9 +53,9 @@ class template_plugin_impl
 
 };
 
-void template_plugin_impl::onBlock( const signed_block& b )
+void template_plugin_impl::onBlock( const graphene::app::applied_block_data& b )
 {
-   wdump((b.block_num()));
+   wdump((b.block.block_num())(b.operations.size()));
 }
 
 template_plugin_impl::~template_plugin_impl()
@@ -95,7 +96,8 @@ void template_plugin::plugin_set_program_options(
 
 void template_plugin::plugin_initialize(const boost::program_options::variables_map& options)
 {
-   database().applied_block.connect( [&]( const signed_block& b) {
+   // blocks are processed on a thread of the plugin, so that the block application does not wait for it
+   consume_blocks( [this]( const graphene::app::applied_block_data& b ) {
       my->onBlock(b);
    } );
 
@@ -109,4 +111,11 @@ void template_plugin::plugin_startup()
    ilog("template_plugin: plugin_startup() begin");
 }
 
+void template_plugin::plugin_shutdown()
+{
+   stop_consuming_blocks();
+   const auto metrics = get_block_consumer_metrics();
+   ilog( "template_plugin: processed ${m}", ("m",metrics) );
+}
+
 } }
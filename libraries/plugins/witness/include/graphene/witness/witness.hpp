@@ -67,6 +67,11 @@ public:
    inline const fc::flat_map< chain::witness_id_type, fc::optional<chain::public_key_type> >& get_witness_key_cache()
    { return _witness_key_cache; }
 
+   /// How much later than scheduled the production loop woke up for the block produced last
+   fc::microseconds get_last_wakeup_delay()const { return _last_wakeup_delay; }
+   /// How long producing the last block took, from waking up until it was generated and applied
+   fc::microseconds get_last_production_time()const { return _last_production_time; }
+
 private:
    void schedule_production_loop();
    block_production_condition::block_production_condition_enum block_production_loop();
@@ -79,8 +84,16 @@ private:
    boost::program_options::variables_map _options;
    bool _production_enabled = false;
    bool _shutting_down = false;
+   bool _push_produced_blocks = false;
    uint32_t _required_witness_participation = 33 * GRAPHENE_1_PERCENT;
    uint32_t _production_skip_flags = graphene::chain::database::skip_nothing;
+   /// How far into each second the production loop wakes up
+   fc::microseconds _production_offset;
+   /// The slot time the production loop checked last
+   fc::time_point_sec _last_checked_second;
+   fc::time_point _next_wakeup;
+   fc::microseconds _last_wakeup_delay;
+   fc::microseconds _last_production_time;
 
    std::map<chain::public_key_type, fc::ecc::private_key, chain::pubkey_comparator> _private_keys;
    std::set<chain::witness_id_type> _witnesses;
@@ -33,6 +33,7 @@
 
 #include <boost/filesystem/path.hpp>
 
+#include <algorithm>
 #include <iostream>
 
 using namespace graphene::witness_plugin;
@@ -81,6 +82,11 @@ void witness_plugin::plugin_set_program_options(
           "Path to a file containing tuples of [PublicKey, WIF private key]."
           " The file has to contain exactly one tuple (i.e. private - public key pair) per line."
           " This option may be specified multiple times, thus multiple files can be provided.")
+         ("production-offset-ms", bpo::value<int32_t>()->default_value(0),
+               "Milliseconds (-499 to 499) after the start of each second to wake up and check whether a block is due, "
+               "a negative value produces blocks slightly before their slot time")
+         ("push-produced-blocks", bpo::bool_switch()->notifier([this](bool e){_push_produced_blocks = e;}),
+               "Send produced blocks in full to the peers that accept it, instead of only advertising them")
          ;
    config_file_options.add(command_line_options);
 }
@@ -164,6 +170,13 @@ void witness_plugin::plugin_initialize(const boost::program_options::variables_m
        else if(required_participation > 90)
            wlog("witness plugin: Warning - High required participation of ${rp}% found", ("rp", required_participation));
    }
+   if( options.count("production-offset-ms") )
+   {
+      auto production_offset = options["production-offset-ms"].as<int32_t>();
+      FC_ASSERT( production_offset > -500 && production_offset < 500,
+                 "production-offset-ms must be between -499 and 499" );
+      _production_offset = fc::milliseconds( production_offset );
+   }
    ilog("witness plugin:  plugin_initialize() end");
 } FC_LOG_AND_RETHROW() }
 
@@ -231,14 +244,19 @@ void witness_plugin::schedule_production_loop()
 {
    if (_shutting_down) return;
 
-   //Schedule for the next second's tick regardless of chain state
-   // If we would wait less than 50ms, wait for the whole second.
+   // Wake up at the configured offset into the second after the one that was checked last, so that no slot
+   // is skipped when producing the previous block took long. If that time has passed already, check now.
    fc::time_point now = fc::time_point::now();
-   int64_t time_to_next_second = 1000000 - (now.time_since_epoch().count() % 1000000);
-   if( time_to_next_second < 50000 )      // we must sleep for at least 50ms
-       time_to_next_second += 1000000;
-
-   fc::time_point next_wakeup( now + fc::microseconds( time_to_next_second ) );
+   fc::time_point next_wakeup;
+   if( _last_checked_second == fc::time_point_sec() )
+   {
+      // align to the offset into the next second
+      int64_t time_to_next_second = 1000000 - ( ( now - _production_offset ).time_since_epoch().count() % 1000000 );
+      next_wakeup = now + fc::microseconds( time_to_next_second );
+   }
+   else
+      next_wakeup = std::max( fc::time_point( _last_checked_second ) + fc::seconds(1) + _production_offset, now );
+   _next_wakeup = next_wakeup;
 
    _block_production_task = fc::schedule([this]{block_production_loop();},
                                          next_wakeup, "Witness Block Production");
@@ -274,7 +292,8 @@ block_production_condition::block_production_condition_enum witness_plugin::bloc
    switch( result )
    {
       case block_production_condition::produced:
-         ilog("Generated block #${n} with ${x} transaction(s) and timestamp ${t} at time ${c}", (capture));
+         ilog("Generated block #${n} with ${x} transaction(s) and timestamp ${t} at time ${c}, "
+              "woke up ${w}us late and took ${d}us", (capture));
          break;
       case block_production_condition::not_synced:
          ilog("Not producing block because production is disabled until we receive a recent block "
@@ -315,6 +334,7 @@ block_production_condition::block_production_condition_enum witness_plugin::mayb
    chain::database& db = database();
    fc::time_point now_fine = fc::time_point::now();
    fc::time_point_sec now = now_fine + fc::microseconds( 500000 );
+   _last_checked_second = now;
 
    // If the next block production opportunity is in the present or future, we're synced.
    if( !_production_enabled )
@@ -380,8 +400,14 @@ block_production_condition::block_production_condition_enum witness_plugin::mayb
       private_key_itr->second,
       _production_skip_flags
       );
-   capture("n", block.block_num())("t", block.timestamp)("c", now)("x", block.transactions.size());
-   fc::async( [this,block](){ p2p_node().broadcast(net::block_message(block)); } );
+   _last_wakeup_delay = now_fine - _next_wakeup;
+   _last_production_time = fc::time_point::now() - now_fine;
+   capture("n", block.block_num())("t", block.timestamp)("c", now)("x", block.transactions.size())
+          ("w", _last_wakeup_delay.count())("d", _last_production_time.count());
+   if( _push_produced_blocks )
+      fc::async( [this,block](){ p2p_node().push_block_to_peers(net::block_message(block)); } );
+   else
+      fc::async( [this,block](){ p2p_node().broadcast(net::block_message(block)); } );
 
    return block_production_condition::produced;
 }
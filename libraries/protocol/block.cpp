@@ -79,7 +79,20 @@ namespace graphene { namespace protocol {
          ids.resize( transactions.size() );
          for( uint32_t i = 0; i < transactions.size(); ++i )
             ids[i] = transactions[i].merkle_digest();
+         calculate_merkle_root( std::move(ids) );
+      }
+      return _calculated_merkle_root;
+   }
+
+   const checksum_type& signed_block::calculate_merkle_root( vector<digest_type>&& ids )const
+   {
+      static const checksum_type empty_checksum;
+      if( transactions.size() == 0 )
+         return empty_checksum;
 
+      if( !_calculated_merkle_root._hash[0].value() )
+      {
+         FC_ASSERT( ids.size() == transactions.size(), "Need one merkle digest per transaction" );
          vector<digest_type>::size_type current_number_of_hashes = ids.size();
          while( current_number_of_hashes > 1 )
          {
@@ -98,6 +111,13 @@ namespace graphene { namespace protocol {
       }
       return _calculated_merkle_root;
    }
+
+   uint64_t signed_block::get_packed_size()const
+   {
+      if( _packed_size == 0 )
+         _packed_size = fc::raw::pack_size( *this );
+      return _packed_size;
+   }
 } }
 
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::protocol::block_header)
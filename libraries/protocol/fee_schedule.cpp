@@ -22,6 +22,7 @@
  * THE SOFTWARE.
  */
 #include <algorithm>
+#include <limits>
 #include <graphene/protocol/fee_schedule.hpp>
 
 #include <fc/io/raw.hpp>
@@ -43,9 +44,22 @@ namespace graphene { namespace protocol {
          fee_parameters x; x.set_which(i);
          result.parameters.insert(x);
       }
+      result.build_lookup_table();
       return result;
    }
 
+   void fee_schedule::build_lookup_table()
+   {
+      _lookup_table.assign( fee_parameters().count(), std::numeric_limits<uint16_t>::max() );
+      uint16_t position = 0;
+      for( const auto& p : parameters )
+      {
+         if( p.which() >= 0 && size_t(p.which()) < _lookup_table.size() )
+            _lookup_table[p.which()] = position;
+         ++position;
+      }
+   }
+
    struct fee_schedule_validate_visitor
    {
       typedef void result_type;
@@ -99,6 +113,17 @@ namespace graphene { namespace protocol {
       }
    };
 
+   struct fixed_fee_visitor
+   {
+      typedef bool result_type;
+
+      template<typename OpType>
+      result_type operator()( const OpType& op )const
+      {
+         return has_fixed_fee<OpType>::value;
+      }
+   };
+
    struct zero_fee_visitor
    {
       typedef void result_type;
@@ -137,9 +162,19 @@ namespace graphene { namespace protocol {
       return calculate_fee( op ).multiply_and_round_up( core_exchange_rate );
    }
 
+   bool fee_schedule::is_fixed_fee( const operation& op )
+   {
+      return op.visit( fixed_fee_visitor() );
+   }
+
    asset fee_schedule::set_fee( operation& op, const price& core_exchange_rate )const
    {
       auto f = calculate_fee( op, core_exchange_rate );
+      if( is_fixed_fee( op ) ) // setting the fee can't change it
+      {
+         op.visit( set_fee_visitor( f ) );
+         return f;
+      }
       auto f_max = f;
       for( int i=0; i<MAX_FEE_STABILIZATION_ITERATION; i++ )
       {
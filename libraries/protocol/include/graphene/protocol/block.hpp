@@ -60,9 +60,14 @@ namespace graphene { namespace protocol {
    {
    public:
       const checksum_type& calculate_merkle_root()const;
+      /// Same as above, but builds the tree from the given merkle digests of transactions
+      const checksum_type& calculate_merkle_root( vector<digest_type>&& merkle_digests )const;
+      /// @return the serialized size of the block, computed once and cached afterwards
+      uint64_t get_packed_size()const;
       vector<processed_transaction> transactions;
    protected:
       mutable checksum_type   _calculated_merkle_root;
+      mutable uint64_t        _packed_size = 0;
    };
 
 } } // graphene::protocol
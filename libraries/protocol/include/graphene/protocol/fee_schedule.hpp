@@ -34,6 +34,15 @@ namespace graphene { namespace protocol {
    };
    typedef transform_to_fee_parameters<operation>::type fee_parameters;
 
+   /**
+    *  Whether the fee of an Operation is the fee parameter of its type, whatever the contents of the operation.
+    *  That is the case for the operations using the calculate_fee of base_operation instead of defining one.
+    */
+   template<typename Operation, typename = void>
+   struct has_fixed_fee : std::true_type {};
+   template<typename Operation>
+   struct has_fixed_fee< Operation, decltype( void( &Operation::calculate_fee ) ) > : std::false_type {};
+
    template<typename Operation>
    class fee_helper {
      public:
@@ -172,6 +181,9 @@ namespace graphene { namespace protocol {
        */
       asset set_fee( operation& op, const price& core_exchange_rate = price::unit_price() )const;
 
+      /** @return whether the fee of op does not depend on its contents, @see has_fixed_fee */
+      static bool is_fixed_fee( const operation& op );
+
       void zero_all_fees();
 
       /**
@@ -182,6 +194,9 @@ namespace graphene { namespace protocol {
       template<typename Operation>
       const typename Operation::fee_parameters_type& get()const
       {
+         const fee_parameters* p = find_parameters( operation::tag<Operation>::value );
+         if( p != nullptr )
+            return p->template get<typename Operation::fee_parameters_type>();
          return fee_helper<Operation>().cget(parameters);
       }
       template<typename Operation>
@@ -196,6 +211,13 @@ namespace graphene { namespace protocol {
          return itr != parameters.end();
       }
 
+      /**
+       *  Records the position in parameters of the fee parameters of every operation tag, so that get() needs no
+       *  search. Must be called again after parameters were replaced for the lookups to stay fast, lookups
+       *  through an outdated table are still correct.
+       */
+      void build_lookup_table();
+
       /**
        *  @note must be sorted by fee_parameters.which() and have no duplicates
        */
@@ -203,6 +225,22 @@ namespace graphene { namespace protocol {
       uint32_t                 scale = GRAPHENE_100_PERCENT; ///< fee * scale / GRAPHENE_100_PERCENT
       private:
       static void set_fee_parameters(fee_schedule& sched);
+
+      /// @return the fee parameters of the operation tag according to the lookup table, or null if unknown
+      const fee_parameters* find_parameters( int64_t tag )const
+      {
+         if( tag < 0 || uint64_t(tag) >= _lookup_table.size() )
+            return nullptr;
+         const uint16_t position = _lookup_table[tag];
+         if( position >= parameters.size() )
+            return nullptr;
+         auto itr = parameters.nth( position );
+         return itr->which() == tag ? &*itr : nullptr;
+      }
+
+      /// Position in parameters by operation tag, or a position past the end if the operation has none.
+      /// Not serialized, copies keep the order of parameters and therefore the positions.
+      vector<uint16_t>         _lookup_table;
    };
 
    typedef fee_schedule fee_schedule_type;
@@ -64,6 +64,11 @@ namespace graphene { namespace protocol {
 
       std::string get_message(const fc::ecc::private_key& priv,
                               const fc::ecc::public_key& pub)const;
+      /**
+       * Same as get_message above, with the shared secret of the two keys computed by the caller, which
+       * can reuse it for all of the memos between the same two keys
+       */
+      std::string get_message(const fc::sha512& shared_secret)const;
    };
 
    /**
@@ -25,6 +25,7 @@
 #include <graphene/protocol/operations.hpp>
 
 namespace graphene { namespace protocol {
+   class authority_check_cache;
 
    /**
     * @defgroup transactions Transactions
@@ -115,9 +116,10 @@ namespace graphene { namespace protocol {
 
       virtual uint64_t get_packed_size()const;
 
+      /// Calculate the digest used for signature validation
+      virtual digest_type sig_digest( const chain_id_type& chain_id )const;
+
    protected:
-      // Calculate the digest used for signature validation
-      digest_type sig_digest( const chain_id_type& chain_id )const;
       mutable transaction_id_type _tx_id_buffer;
    };
 
@@ -164,13 +166,15 @@ namespace graphene { namespace protocol {
        *            required accounts to authorize operations in the transaction
        * @param max_recursion maximum level of recursion when verifying, since an account
        *            can have another account in active authorities and/or owner authorities
+       * @param cache if not null, remembers successful checks, @see authority_check_cache
        */
       void verify_authority(
          const chain_id_type& chain_id,
          const std::function<const authority*(account_id_type)>& get_active,
          const std::function<const authority*(account_id_type)>& get_owner,
          bool allow_non_immediate_owner,
-         uint32_t max_recursion = GRAPHENE_MAX_SIG_CHECK_DEPTH )const;
+         uint32_t max_recursion = GRAPHENE_MAX_SIG_CHECK_DEPTH,
+         authority_check_cache* cache = nullptr )const;
 
       /**
        * This is a slower replacement for get_required_signatures()
@@ -200,6 +204,16 @@ namespace graphene { namespace protocol {
        */
       virtual const flat_set<public_key_type>& get_signature_keys( const chain_id_type& chain_id )const;
 
+      /** Recovers the public key that created a signature of the given digest */
+      typedef std::function<public_key_type( const signature_type&, const digest_type& )> signature_key_recovery;
+
+      /**
+       * @brief Same as get_signature_keys(const chain_id_type&), but recovers each key through @p recover_key,
+       *        e.g. to look it up in a cache first
+       */
+      virtual const flat_set<public_key_type>& get_signature_keys( const chain_id_type& chain_id,
+                                                                const signature_key_recovery& recover_key )const;
+
       /** Signatures */
       vector<signature_type> signatures;
 
@@ -227,10 +241,52 @@ namespace graphene { namespace protocol {
       virtual const transaction_id_type&       id()const override;
       virtual void                             validate()const override;
       virtual const flat_set<public_key_type>& get_signature_keys( const chain_id_type& chain_id )const override;
+      virtual const flat_set<public_key_type>& get_signature_keys( const chain_id_type& chain_id,
+                                                                const signature_key_recovery& recover_key )const override;
       virtual uint64_t                         get_packed_size()const override;
+      /** @note Like the signature keys, the digest is only computed for the first chain ID it is requested for */
+      virtual digest_type                      sig_digest( const chain_id_type& chain_id )const override;
    protected:
       mutable bool _validated = false;
       mutable uint64_t _packed_size = 0;
+      mutable digest_type _sig_digest;
+   };
+
+   /**
+    * Remembers which sets of required accounts verify_authority found to be authorized by which sets of keys.
+    * Transactions of the same accounts that are signed with the same keys need not walk the authorities again.
+    * Proposed transactions are remembered together with their approvals. Operations requiring other authorities
+    * than those of accounts are not remembered.
+    *
+    * The owner of the cache must clear() it whenever the authority of an account may have changed.
+    */
+   class authority_check_cache
+   {
+      public:
+         struct entry
+         {
+            flat_set<account_id_type> required_active;
+            flat_set<account_id_type> required_owner;
+            flat_set<public_key_type> keys;
+            bool                      allow_non_immediate_owner;
+            uint32_t                  max_recursion;
+            flat_set<account_id_type> active_approvals;
+            flat_set<account_id_type> owner_approvals;
+
+            bool operator<( const entry& other )const;
+         };
+
+         bool contains( const entry& e )const { return _entries.find( e ) != _entries.end(); }
+         /** Adds e to the cache, the cache is emptied first if it is full */
+         void insert( entry&& e );
+         void clear() { _entries.clear(); }
+         size_t size()const { return _entries.size(); }
+
+         /** Maximum number of entries */
+         static const size_t max_size = 10000;
+
+      private:
+         std::set<entry> _entries;
    };
 
    /**
@@ -248,6 +304,7 @@ namespace graphene { namespace protocol {
     * @param allow_committee whether to allow the special "committee account" to authorize the operations
     * @param active_approvals accounts that approved the operations with their active authories
     * @param owner_approvals accounts that approved the operations with their owner authories
+    * @param cache if not null, remembers successful checks, @see authority_check_cache
     */
    void verify_authority( const vector<operation>& ops, const flat_set<public_key_type>& sigs,
                           const std::function<const authority*(account_id_type)>& get_active,
@@ -256,7 +313,8 @@ namespace graphene { namespace protocol {
                           uint32_t max_recursion = GRAPHENE_MAX_SIG_CHECK_DEPTH,
                           bool allow_committe = false,
                           const flat_set<account_id_type>& active_aprovals = flat_set<account_id_type>(),
-                          const flat_set<account_id_type>& owner_approvals = flat_set<account_id_type>());
+                          const flat_set<account_id_type>& owner_approvals = flat_set<account_id_type>(),
+                          authority_check_cache* cache = nullptr );
 
    /**
     *  @brief captures the result of evaluating the operations contained in the transaction
@@ -275,6 +333,9 @@ namespace graphene { namespace protocol {
    {
       processed_transaction( const signed_transaction& trx = signed_transaction() )
          : precomputable_transaction(trx){}
+      /** Keeps the values that trx has already computed */
+      processed_transaction( const precomputable_transaction& trx )
+         : precomputable_transaction(trx){}
       virtual ~processed_transaction() = default;
 
       vector<operation_result> operation_results;
@@ -23,6 +23,7 @@
  */
 #pragma once
 
+#include <cstring>
 #include <memory>
 #include <vector>
 #include <deque>
@@ -214,6 +215,16 @@ public:
     }
 };
 
+/** Hashes a public key for unordered containers. The bytes after the parity prefix are uniformly distributed. */
+class pubkey_hasher {
+public:
+    inline size_t operator()(const public_key_type& k) const {
+        uint64_t result;
+        std::memcpy( &result, k.key_data.data() + 1, sizeof(result) );
+        return result;
+    }
+};
+
 struct fee_schedule;
 } }  // graphene::protocol
 
@@ -271,7 +271,8 @@ void verify_authority( const vector<operation>& ops, const flat_set<public_key_t
                        uint32_t max_recursion_depth,
                        bool  allow_committe,
                        const flat_set<account_id_type>& active_aprovals,
-                       const flat_set<account_id_type>& owner_approvals )
+                       const flat_set<account_id_type>& owner_approvals,
+                       authority_check_cache* cache )
 { try {
    flat_set<account_id_type> required_active;
    flat_set<account_id_type> required_owner;
@@ -284,6 +285,16 @@ void verify_authority( const vector<operation>& ops, const flat_set<public_key_t
       GRAPHENE_ASSERT( required_active.find(GRAPHENE_COMMITTEE_ACCOUNT) == required_active.end(),
                        invalid_committee_approval, "Committee account may only propose transactions" );
 
+   optional<authority_check_cache::entry> cache_entry;
+   if( cache != nullptr && other.empty() )
+   {
+      cache_entry = authority_check_cache::entry{ required_active, required_owner, sigs,
+                                                  allow_non_immediate_owner, max_recursion_depth,
+                                                  active_aprovals, owner_approvals };
+      if( cache->contains( *cache_entry ) )
+         return;
+   }
+
    sign_state s( sigs, get_active, get_owner, allow_non_immediate_owner, max_recursion_depth );
    for( auto& id : active_aprovals )
       s.approved_by.insert( id );
@@ -316,17 +327,43 @@ void verify_authority( const vector<operation>& ops, const flat_set<public_key_t
       tx_irrelevant_sig,
       "Unnecessary signature(s) detected"
       );
+
+   if( cache_entry.valid() )
+      cache->insert( std::move( *cache_entry ) );
 } FC_CAPTURE_AND_RETHROW( (ops)(sigs) ) }
 
+bool authority_check_cache::entry::operator<( const entry& other )const
+{
+   return std::tie( required_active, required_owner, keys, allow_non_immediate_owner, max_recursion,
+                    active_approvals, owner_approvals )
+        < std::tie( other.required_active, other.required_owner, other.keys, other.allow_non_immediate_owner,
+                    other.max_recursion, other.active_approvals, other.owner_approvals );
+}
+
+void authority_check_cache::insert( entry&& e )
+{
+   if( _entries.size() >= max_size )
+      _entries.clear();
+   _entries.insert( std::move( e ) );
+}
+
 
 const flat_set<public_key_type>& signed_transaction::get_signature_keys( const chain_id_type& chain_id )const
+{
+   return signed_transaction::get_signature_keys( chain_id, []( const signature_type& sig, const digest_type& d ) {
+      return public_key_type( fc::ecc::public_key( sig, d ) );
+   });
+}
+
+const flat_set<public_key_type>& signed_transaction::get_signature_keys( const chain_id_type& chain_id,
+                                                                         const signature_key_recovery& recover_key )const
 { try {
    auto d = sig_digest( chain_id );
    flat_set<public_key_type> result;
    for( const auto&  sig : signatures )
    {
       GRAPHENE_ASSERT(
-         result.insert( fc::ecc::public_key(sig,d) ).second,
+         result.insert( recover_key( sig, d ) ).second,
             tx_duplicate_sig,
             "Duplicate Signature detected" );
    }
@@ -420,6 +457,13 @@ uint64_t precomputable_transaction::get_packed_size()const
    return _packed_size;
 }
 
+digest_type precomputable_transaction::sig_digest( const chain_id_type& chain_id )const
+{
+   if( _sig_digest == digest_type() )
+      _sig_digest = transaction::sig_digest( chain_id );
+   return _sig_digest;
+}
+
 const flat_set<public_key_type>& precomputable_transaction::get_signature_keys( const chain_id_type& chain_id )const
 {
    // Strictly we should check whether the given chain ID is same as the one used to initialize the `signees` field.
@@ -429,15 +473,25 @@ const flat_set<public_key_type>& precomputable_transaction::get_signature_keys(
    return _signees;
 }
 
+const flat_set<public_key_type>& precomputable_transaction::get_signature_keys( const chain_id_type& chain_id,
+                                                                       const signature_key_recovery& recover_key )const
+{
+   if( _signees.empty() )
+      signed_transaction::get_signature_keys( chain_id, recover_key );
+   return _signees;
+}
+
 void signed_transaction::verify_authority(
    const chain_id_type& chain_id,
    const std::function<const authority*(account_id_type)>& get_active,
    const std::function<const authority*(account_id_type)>& get_owner,
    bool allow_non_immediate_owner,
-   uint32_t max_recursion )const
+   uint32_t max_recursion,
+   authority_check_cache* cache )const
 { try {
    graphene::protocol::verify_authority( operations, get_signature_keys( chain_id ), get_active, get_owner,
-                                         allow_non_immediate_owner, max_recursion );
+                                         allow_non_immediate_owner, max_recursion, false,
+                                         flat_set<account_id_type>(), flat_set<account_id_type>(), cache );
 } FC_CAPTURE_AND_RETHROW( (*this) ) }
 
 } } // graphene::protocol
@@ -25,9 +25,12 @@
 
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string.hpp>
+#include <fc/exception/exception.hpp>
 #include <fc/log/logger.hpp>
 #include <fc/io/json.hpp>
 
+#include <algorithm>
+
 size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp)
 {
    ((std::string*)userp)->append((char*)contents, size * nmemb);
@@ -64,13 +67,17 @@ const std::string simpleQuery(ES& es)
 bool SendBulk(ES&& es)
 {
    std::string bulking = joinBulkLines(es.bulk_lines);
+   return SendBulk(std::move(es), std::move(bulking));
+}
 
+bool SendBulk(ES&& es, std::string&& body)
+{
    graphene::utilities::CurlRequest curl_request;
    curl_request.handler = es.curl;
    curl_request.url = es.elasticsearch_url + "_bulk";
    curl_request.auth = es.auth;
    curl_request.type = "POST";
-   curl_request.query = std::move(bulking);
+   curl_request.query = std::move(body);
 
    auto curlResponse = doCurl(curl_request);
 
@@ -129,6 +136,69 @@ const std::vector<std::string> createBulk(const fc::mutable_variant_object& bulk
    return bulk;
 }
 
+namespace {
+   void append_json_string( std::string& out, const std::string& s )
+   {
+      static const char hex[] = "0123456789abcdef";
+      out += '"';
+      for( const char c : s )
+      {
+         if( c == '"' || c == '\\' )
+         {
+            out += '\\';
+            out += c;
+         }
+         else if( static_cast<unsigned char>(c) < 0x20 )
+         {
+            out += "\\u00";
+            out += hex[ ( c >> 4 ) & 0xf ];
+            out += hex[ c & 0xf ];
+         }
+         else
+            out += c;
+      }
+      out += '"';
+   }
+}
+
+void bulk_body::add_action( const char* action, const std::string& index, const std::string& id )
+{
+   _body += "{\"";
+   _body += action;
+   _body += "\":{\"_index\":";
+   append_json_string( _body, index );
+   _body += ",\"_type\":\"data\"";
+   if( !id.empty() )
+   {
+      _body += ",\"_id\":";
+      append_json_string( _body, id );
+   }
+   _body += "}}\n";
+   ++_lines;
+}
+
+void bulk_body::add_document( const std::string& json )
+{
+   _body += json;
+   _body += '\n';
+   ++_lines;
+}
+
+void bulk_body::append( const bulk_body& other )
+{
+   _body += other._body;
+   _lines += other._lines;
+}
+
+std::string bulk_body::take()
+{
+   std::string body;
+   body.reserve( _body.size() );
+   body.swap( _body );
+   _lines = 0;
+   return body;
+}
+
 bool deleteAll(ES& es)
 {
    graphene::utilities::CurlRequest curl_request;
@@ -187,4 +257,223 @@ const std::string doCurl(CurlRequest& curl)
    return CurlReadBuffer;
 }
 
+struct bulk_sender::request
+{
+   std::string body;
+   std::string response;
+   curl_slist* headers = nullptr;
+   uint32_t attempts = 0;
+   uint64_t sequence = 0;
+   std::chrono::steady_clock::time_point not_before;
+};
+
+bulk_sender::bulk_sender( const options_type& options )
+   : _options( options ), _multi( curl_multi_init() )
+{
+   FC_ASSERT( _multi != nullptr, "Failed to initialize curl multi handle" );
+   FC_ASSERT( _options.max_in_flight > 0 && _options.max_queued > 0 );
+   _worker = std::thread( [this]() { run(); } );
+}
+
+bulk_sender::~bulk_sender()
+{
+   {
+      std::unique_lock<std::mutex> lock( _mutex );
+      _stopping = true;
+      _stop_deadline = std::chrono::steady_clock::now() + _options.shutdown_timeout;
+   }
+   _changed.notify_all();
+   _worker.join();
+   curl_multi_cleanup( _multi );
+}
+
+void bulk_sender::queue( std::vector<std::string>&& bulk_lines )
+{
+   std::string body = joinBulkLines( bulk_lines );
+   bulk_lines.clear();
+   queue( std::move(body) );
+}
+
+void bulk_sender::queue( std::string&& body )
+{
+   std::unique_ptr<request> r( new request );
+   r->body = std::move(body);
+   std::unique_lock<std::mutex> lock( _mutex );
+   _changed.wait( lock, [this]() { return _queued.size() < _options.max_queued; } );
+   r->sequence = _next_sequence++;
+   _queued.push_back( std::move(r) );
+   lock.unlock();
+   _changed.notify_all();
+}
+
+void bulk_sender::flush()
+{
+   std::unique_lock<std::mutex> lock( _mutex );
+   _changed.wait( lock, [this]() { return _queued.empty() && _in_flight.empty(); } );
+}
+
+bool bulk_sender::flush( std::chrono::milliseconds timeout )
+{
+   std::unique_lock<std::mutex> lock( _mutex );
+   return _changed.wait_for( lock, timeout, [this]() { return _queued.empty() && _in_flight.empty(); } );
+}
+
+uint64_t bulk_sender::sent_bulks()const
+{
+   std::unique_lock<std::mutex> lock( _mutex );
+   return _sent;
+}
+
+uint64_t bulk_sender::dropped_bulks()const
+{
+   std::unique_lock<std::mutex> lock( _mutex );
+   return _dropped;
+}
+
+uint64_t bulk_sender::retried_attempts()const
+{
+   std::unique_lock<std::mutex> lock( _mutex );
+   return _retried;
+}
+
+CURL* bulk_sender::start( request& r )
+{
+   CURL* handle = curl_easy_init();
+   FC_ASSERT( handle != nullptr, "Failed to initialize curl handle" );
+   r.response.clear();
+   r.headers = curl_slist_append( nullptr, "Content-Type: application/json" );
+   curl_easy_setopt( handle, CURLOPT_HTTPHEADER, r.headers );
+   const std::string url = _options.elasticsearch_url + "_bulk";
+   curl_easy_setopt( handle, CURLOPT_URL, url.c_str() ); // copied by curl
+   curl_easy_setopt( handle, CURLOPT_POST, 1L );
+   curl_easy_setopt( handle, CURLOPT_POSTFIELDS, r.body.c_str() );
+   curl_easy_setopt( handle, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)r.body.size() );
+   curl_easy_setopt( handle, CURLOPT_WRITEFUNCTION, WriteCallback );
+   curl_easy_setopt( handle, CURLOPT_WRITEDATA, (void *)&r.response );
+   curl_easy_setopt( handle, CURLOPT_USERAGENT, "libcrp/0.1" );
+   if( !_options.auth.empty() )
+      curl_easy_setopt( handle, CURLOPT_USERPWD, _options.auth.c_str() );
+   curl_multi_add_handle( _multi, handle );
+   ++r.attempts;
+   return handle;
+}
+
+void bulk_sender::finish( CURL* handle, CURLcode result )
+{
+   long http_code = 0;
+   curl_easy_getinfo( handle, CURLINFO_RESPONSE_CODE, &http_code );
+   curl_multi_remove_handle( _multi, handle );
+   curl_easy_cleanup( handle );
+
+   std::unique_lock<std::mutex> lock( _mutex );
+   auto itr = _in_flight.find( handle );
+   std::unique_ptr<request> r = std::move( itr->second );
+   _in_flight.erase( itr );
+   curl_slist_free_all( r->headers );
+   r->headers = nullptr;
+
+   // when stopping, a bulk is not retried, so that an unreachable ES does not block the shutdown
+   if( !_stopping && ( result != CURLE_OK || http_code == 429 || http_code >= 500 ) )
+   {
+      // ES is not reachable or overloaded, try again later
+      auto backoff = _options.initial_backoff * ( 1u << std::min< uint32_t >( r->attempts - 1, 16 ) );
+      if( backoff > _options.max_backoff )
+         backoff = _options.max_backoff;
+      wlog( "Sending bulk to ES failed with curl code ${c} and HTTP status ${s}, retrying in ${b} ms",
+            ("c",(int64_t)result)("s",(int64_t)http_code)("b",(int64_t)backoff.count()) );
+      r->not_before = std::chrono::steady_clock::now() + backoff;
+      ++_retried;
+      // back to its place in the queue, ahead of the bulks queued after it
+      const auto pos = std::upper_bound( _queued.begin(), _queued.end(), r->sequence,
+                                         []( uint64_t sequence, const std::unique_ptr<request>& queued ) {
+                                            return sequence < queued->sequence;
+                                         } );
+      _queued.insert( pos, std::move(r) );
+      return;
+   }
+
+   bool succeeded = false;
+   try
+   {
+      succeeded = handleBulkResponse( http_code, r->response );
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "Unexpected response of ES to a bulk: ${e}", ("e",e.to_detail_string()) );
+   }
+   if( succeeded )
+      ++_sent;
+   else
+   {
+      elog( "Dropping a bulk which ES rejected" );
+      ++_dropped;
+   }
+}
+
+void bulk_sender::run()
+{
+   int running = 0;
+   while( true )
+   {
+      {
+         std::unique_lock<std::mutex> lock( _mutex );
+         if( _in_flight.empty() )
+         {
+            // nothing to wait for on the network, sleep until a bulk is due
+            if( _queued.empty() )
+            {
+               _changed.notify_all(); // flush() waits for this
+               if( _stopping )
+                  break;
+            }
+            auto wakeup = std::chrono::steady_clock::now() + std::chrono::seconds( 1 );
+            if( !_queued.empty() )
+               wakeup = std::min( wakeup, _queued.front()->not_before );
+            if( _stopping )
+               wakeup = std::min( wakeup, _stop_deadline );
+            _changed.wait_until( lock, wakeup );
+         }
+         const auto now = std::chrono::steady_clock::now();
+         if( _stopping && now >= _stop_deadline && !( _queued.empty() && _in_flight.empty() ) )
+         {
+            // ES is down or too slow, the node must not hang on exit
+            elog( "Dropping ${n} bulks which were not sent to ES within the shutdown timeout",
+                  ("n",_queued.size() + _in_flight.size()) );
+            _dropped += _queued.size() + _in_flight.size();
+            _queued.clear();
+            for( auto& in_flight : _in_flight )
+            {
+               curl_multi_remove_handle( _multi, in_flight.first );
+               curl_easy_cleanup( in_flight.first );
+               curl_slist_free_all( in_flight.second->headers );
+            }
+            _in_flight.clear();
+            continue;
+         }
+         bool started = false;
+         // in the order they were queued, a retry that is not due yet holds back the bulks after it
+         while( !_queued.empty() && _in_flight.size() < _options.max_in_flight
+                && _queued.front()->not_before <= now )
+         {
+            std::unique_ptr<request> r = std::move( _queued.front() );
+            _queued.pop_front();
+            CURL* handle = start( *r );
+            _in_flight.emplace( handle, std::move(r) );
+            started = true;
+         }
+         if( started )
+            _changed.notify_all(); // the queue has space again
+      }
+      curl_multi_perform( _multi, &running );
+      int messages = 0;
+      while( CURLMsg* msg = curl_multi_info_read( _multi, &messages ) )
+      {
+         if( msg->msg == CURLMSG_DONE )
+            finish( msg->easy_handle, msg->data.result );
+      }
+      if( running > 0 )
+         curl_multi_wait( _multi, nullptr, 0, 100, nullptr );
+   }
+}
+
 } } // end namespace graphene::utilities
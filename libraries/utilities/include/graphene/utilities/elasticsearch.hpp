@@ -22,8 +22,15 @@
  * THE SOFTWARE.
  */
 #pragma once
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <curl/curl.h>
@@ -54,6 +61,8 @@ namespace graphene { namespace utilities {
    };
 
    bool SendBulk(ES&& es);
+   /** sends body, the lines of a bulk already joined, instead of es.bulk_lines */
+   bool SendBulk(ES&& es, std::string&& body);
    const std::vector<std::string> createBulk(const fc::mutable_variant_object& bulk_header, std::string&& data);
    bool checkES(ES& es);
    const std::string simpleQuery(ES& es);
@@ -65,4 +74,102 @@ namespace graphene { namespace utilities {
    const std::string joinBulkLines(const std::vector<std::string>& bulk);
    long getResponseCode(CURL *handler);
 
+   /**
+    * The body of a bulk request, written line by line into one buffer.
+    *
+    * The action lines are written directly instead of being built as variants and serialized, and the lines are
+    * not copied again to join them. take() leaves the buffer reserved to the size of the body it returns, so the
+    * next bulk of a similar size is written without growing the buffer.
+    */
+   class bulk_body {
+      public:
+         /** writes the action line of a document, e.g. "index" or "delete", the _id is left out when id is empty */
+         void add_action( const char* action, const std::string& index, const std::string& id );
+         /** writes a document line, json must not contain line breaks */
+         void add_document( const std::string& json );
+         /** writes the lines of other after the lines of this */
+         void append( const bulk_body& other );
+
+         /// @return number of lines written since the last take()
+         size_t lines()const { return _lines; }
+         bool empty()const { return _lines == 0; }
+
+         /** @return the body, every line terminated by a line break */
+         std::string take();
+
+      private:
+         std::string _body;
+         size_t _lines = 0;
+   };
+
+   /**
+    * Sends bulks to ES from a worker thread, with several requests in flight on one curl multi handle.
+    *
+    * Bulks which fail because ES is unreachable or overloaded (HTTP 429 and 5xx) are sent again after a backoff
+    * which doubles with every attempt, other failures are logged and dropped. Bulks are started in the order they
+    * were queued, a retry waiting for its backoff holds back the bulks queued after it. Requests in flight may
+    * complete in any order, so max_in_flight should be 1 when documents are rewritten, e.g. after forks.
+    */
+   class bulk_sender {
+      public:
+         struct options_type {
+            std::string elasticsearch_url;
+            std::string auth;
+            /// requests sent at the same time
+            size_t max_in_flight = 4;
+            /// bulks waiting to be sent, queue() blocks while there are more
+            size_t max_queued = 16;
+            std::chrono::milliseconds initial_backoff = std::chrono::milliseconds( 500 );
+            std::chrono::milliseconds max_backoff = std::chrono::milliseconds( 30000 );
+            /// how long the destructor keeps sending what is queued, the rest is dropped then
+            std::chrono::milliseconds shutdown_timeout = std::chrono::milliseconds( 10000 );
+         };
+
+         explicit bulk_sender( const options_type& options );
+         /**
+          * sends what is queued without retrying failures, then stops the worker thread, drops what is not sent
+          * within shutdown_timeout
+          */
+         ~bulk_sender();
+
+         /** queues the lines as one bulk, blocks the caller while the queue is full */
+         void queue( std::vector<std::string>&& bulk_lines );
+         /** queues a body as returned by bulk_body::take(), blocks the caller while the queue is full */
+         void queue( std::string&& body );
+         /** blocks the caller until everything queued so far is sent or dropped */
+         void flush();
+         /** like flush(), but waits at most timeout, @return false if bulks are still queued or in flight */
+         bool flush( std::chrono::milliseconds timeout );
+
+         /// @return number of bulks sent
+         uint64_t sent_bulks()const;
+         /// @return number of bulks dropped after an error which retrying does not fix
+         uint64_t dropped_bulks()const;
+         /// @return number of attempts which are retried
+         uint64_t retried_attempts()const;
+
+      private:
+         struct request;
+         void run();
+         /** @return the easy handle sending r, added to the multi handle */
+         CURL* start( request& r );
+         void finish( CURL* handle, CURLcode result );
+
+         const options_type _options;
+         CURLM* _multi = nullptr;
+         mutable std::mutex _mutex;
+         std::condition_variable _changed;
+         std::deque< std::unique_ptr<request> > _queued;
+         std::map< CURL*, std::unique_ptr<request> > _in_flight;
+         bool _stopping = false;
+         /// what is not sent by then is dropped, set when stopping
+         std::chrono::steady_clock::time_point _stop_deadline;
+         /// the order of the queued bulks, retries are put back in it
+         uint64_t _next_sequence = 0;
+         uint64_t _sent = 0;
+         uint64_t _dropped = 0;
+         uint64_t _retried = 0;
+         std::thread _worker;
+   };
+
 } } // end namespace graphene::utilities
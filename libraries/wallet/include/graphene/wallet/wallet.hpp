@@ -194,6 +194,8 @@ struct wallet_data
 
    /** encrypted keys */
    vector<char>              cipher_keys;
+   /** keys added after @ref cipher_keys was encrypted, each save that adds keys encrypts only those */
+   vector<vector<char>>      cipher_key_journal;
 
    /** map an account to a set of extra keys that have been imported for that account */
    map<account_id_type, set<public_key_type> >  extra_keys;
@@ -336,6 +338,15 @@ struct account_history_operation_detail {
    vector<operation_detail_ex>  details;
 };
 
+/// One of the transactions that sign_builder_transaction_in_bulk() split its operations into
+struct bulk_transaction_result {
+   uint32_t                 first_operation = 0; ///< Index of its first operation in the builder
+   uint32_t                 operation_count = 0;
+   transaction_id_type      transaction_id;
+   signed_transaction       trx;
+   optional<string>         error; ///< Set if the transaction could not be signed or broadcast
+};
+
 /**
  * This wallet assumes it is connected to the database server with a high-bandwidth, low-latency connection and
  * performs minimal caching. This API could be provided locally to be used by a web interface.
@@ -414,6 +425,7 @@ class wallet_api
       /** Returns the most recent operations on the named account.
        *
        * This returns a list of operation history objects, which describe activity on the account.
+       * Irreversible operations are cached by the wallet, so later calls only fetch the newer ones.
        *
        * @param name the name or id of the account
        * @param limit the number of entries to return (starting from the most recent)
@@ -631,6 +643,15 @@ class wallet_api
        * @param op the operation in JSON format
        */
       void add_operation_to_builder_transaction(transaction_handle_type transaction_handle, const operation& op);
+      /**
+       * @ingroup Transaction Builder API
+       *
+       * Append a list of operations to a transaction builder.
+       * @param transaction_handle handle of the transaction builder
+       * @param ops the operations in JSON format
+       */
+      void add_operations_to_builder_transaction(transaction_handle_type transaction_handle,
+                                                 const vector<operation>& ops);
       /**
        * @ingroup Transaction Builder API
        *
@@ -669,6 +690,27 @@ class wallet_api
        */
       signed_transaction sign_builder_transaction(transaction_handle_type transaction_handle, bool broadcast = true);
 
+      /**
+       * @ingroup Transaction Builder API
+       *
+       * Split the operations in a transaction builder into as many transactions as needed to stay within the
+       * maximum transaction size, then sign them and optionally broadcast them to the network.
+       *
+       * Fees are set on the operations first, as in \c set_fees_on_builder_transaction(). The transactions are
+       * signed on all worker threads, the requests to the node are pipelined. A transaction that fails does
+       * not stop the others, its error is reported in its result instead.
+       *
+       * @param transaction_handle handle of the transaction builder
+       * @param fee_asset name or ID of an asset that to be used to pay fees
+       * @param max_operations_per_transaction the most operations put into one transaction, 0 for no limit
+       * @param broadcast whether to broadcast the signed transactions to the network
+       * @return one result for each transaction, in the order of their operations
+       */
+      vector<bulk_transaction_result> sign_builder_transaction_in_bulk(transaction_handle_type transaction_handle,
+                                                                       string fee_asset = GRAPHENE_SYMBOL,
+                                                                       uint32_t max_operations_per_transaction = 0,
+                                                                       bool broadcast = true);
+
       /** Broadcast signed transaction
        * @param tx signed transaction
        * @returns the transaction ID along with the signed transaction.
@@ -894,6 +936,17 @@ class wallet_api
        */
       bool import_key(string account_name_or_id, string wif_key);
 
+      /** Imports a list of private keys into the wallet, and associate them with an account.
+       *
+       * Works like \c import_key() for each key, but the wallet file is only backed up and saved once,
+       * so that importing many keys takes time proportional to their number.
+       *
+       * @param account_name_or_id the account owning the keys
+       * @param wif_keys the private keys in WIF format
+       * @returns whether each key matched an owner, active or memo key of the account
+       */
+      vector<bool> import_keys( string account_name_or_id, vector<string> wif_keys );
+
       /** Imports accounts from a BitShares 0.x wallet file.
        * Current wallet file must be unlocked to perform the import.
        *
@@ -1070,6 +1123,16 @@ class wallet_api
        */
       string read_memo(const memo_data& memo);
 
+      /** Read a list of memos, decrypting them on all worker threads.
+       *
+       * The secret shared by two keys is computed once, no matter how many of the memos are encrypted with it.
+       *
+       * @param memos JSON-encoded memos.
+       * @returns the decrypted messages, in the order of the memos. A memo that cannot be decrypted gets an
+       *          empty message, as in \c read_memo().
+       */
+      vector<string> read_memos(const vector<memo_data>& memos);
+
 
       /** Sign a message using an account's memo key. The signature is generated as in
        *   in https://github.com/xeroc/python-graphenelib/blob/d9634d74273ebacc92555499eca7c444217ecba0/graphenecommon/message.py#L64 .
@@ -2032,6 +2095,7 @@ FC_REFLECT( graphene::wallet::wallet_data,
             (chain_id)
             (my_accounts)
             (cipher_keys)
+            (cipher_key_journal)
             (extra_keys)
             (pending_account_registrations)(pending_witness_registrations)
             (labeled_keys)
@@ -2084,6 +2148,9 @@ FC_REFLECT(graphene::wallet::operation_detail_ex,
 FC_REFLECT( graphene::wallet::account_history_operation_detail,
         (total_count)(result_count)(details))
 
+FC_REFLECT( graphene::wallet::bulk_transaction_result,
+            (first_operation)(operation_count)(transaction_id)(trx)(error) )
+
 FC_REFLECT( graphene::wallet::signed_message_meta, (account)(memo_key)(block)(time) )
 FC_REFLECT( graphene::wallet::signed_message, (message)(meta)(signature) )
 
@@ -2094,10 +2161,12 @@ FC_API( graphene::wallet::wallet_api,
         (about)
         (begin_builder_transaction)
         (add_operation_to_builder_transaction)
+        (add_operations_to_builder_transaction)
         (replace_operation_in_builder_transaction)
         (set_fees_on_builder_transaction)
         (preview_builder_transaction)
         (sign_builder_transaction)
+        (sign_builder_transaction_in_bulk)
         (broadcast_transaction)
         (propose_builder_transaction)
         (propose_builder_transaction2)
@@ -2112,6 +2181,7 @@ FC_API( graphene::wallet::wallet_api,
         (list_assets)
         (get_asset_count)
         (import_key)
+        (import_keys)
         (import_accounts)
         (import_account_keys)
         (import_balance)
@@ -2204,6 +2274,7 @@ FC_API( graphene::wallet::wallet_api,
         (network_get_connected_peers)
         (sign_memo)
         (read_memo)
+        (read_memos)
         (sign_message)
         (verify_message)
         (verify_signed_message)
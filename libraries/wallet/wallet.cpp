@@ -23,6 +23,7 @@
  */
 #include <algorithm>
 #include <cctype>
+#include <deque>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
@@ -58,6 +59,9 @@
 #include <fc/crypto/hex.hpp>
 #include <fc/thread/mutex.hpp>
 #include <fc/thread/scoped_lock.hpp>
+#include <fc/thread/parallel.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/asio.hpp>
 #include <fc/rpc/api_connection.hpp>
 #include <fc/crypto/base58.hpp>
 #include <fc/popcount.hpp>
@@ -89,6 +93,9 @@ namespace fc {
 }
 
 #define BRAIN_KEY_WORD_COUNT 16
+#define BULK_TRANSACTION_SIZE_RESERVE 1024 // Bytes of a bulk transaction left for its header and signatures
+#define BULK_PIPELINE_DEPTH 50 // Requests to the node a bulk builder transaction keeps in flight
+#define MAX_MEMO_SHARED_SECRETS 100000 // Shared secrets of memo keys the wallet keeps before it starts over
 #define RANGE_PROOF_MANTISSA 49 // Minimum mantissa bits to "hide" in the range proof.
                                 // If this number is set too low, then for large value
                                 // commitments the length of the range proof will hint
@@ -113,6 +120,22 @@ static const string ENC_META(   "-----BEGIN META-----\n" );
 static const string ENC_SIG(    "-----BEGIN SIGNATURE-----\n" );
 static const string ENC_FOOTER( "-----END BITSHARES SIGNED MESSAGE-----" );
 
+/// Calls f with each index below count on the worker threads, which take one range of indices each
+template<typename F>
+static void for_each_in_parallel( size_t count, F f )
+{
+   const size_t chunks = std::max<size_t>( 1, fc::asio::default_io_service_scope::get_num_threads() );
+   const size_t chunk_size = ( count + chunks - 1 ) / chunks;
+   std::vector<fc::future<void>> workers;
+   for( size_t base = 0; base < count; base += chunk_size )
+      workers.push_back( fc::do_parallel( [&f,base,chunk_size,count] () {
+         for( size_t i = base; i < count && i < base + chunk_size; ++i )
+            f( i );
+      }) );
+   for( auto& worker : workers )
+      worker.wait();
+}
+
 struct operation_result_printer
 {
 public:
@@ -517,6 +540,14 @@ public:
    }
    virtual ~wallet_api_impl()
    {
+      try
+      {
+         flush_wallet_file();
+      }
+      catch (const fc::exception& e)
+      {
+         elog( "Caught exception ${e} while saving the wallet file", ("e", e.to_detail_string()) );
+      }
       try
       {
          _remote_db->cancel_all_subscriptions();
@@ -535,21 +566,71 @@ public:
    {
       if( !is_locked() )
       {
+         if( _keys.size() == _encrypted_keys.size() && _encrypted_checksum == _checksum )
+            return;
+
+         // Keys added since the last encryption are appended to the journal. All of them are encrypted
+         // again only if the password changed or the journal outgrew the keys encrypted before it.
+         size_t journal_size = 0;
+         for( const auto& entry : _wallet.cipher_key_journal )
+            journal_size += entry.size();
          plain_keys data;
-         data.keys = _keys;
          data.checksum = _checksum;
-         auto plain_txt = fc::raw::pack(data);
-         _wallet.cipher_keys = fc::aes_encrypt( data.checksum, plain_txt );
+         if( _encrypted_checksum != _checksum || _wallet.cipher_keys.empty()
+               || journal_size > _wallet.cipher_keys.size() )
+         {
+            data.keys = _keys;
+            _wallet.cipher_keys = fc::aes_encrypt( data.checksum, fc::raw::pack(data) );
+            _wallet.cipher_key_journal.clear();
+            _encrypted_keys.clear();
+            for( const auto& key : _keys )
+               _encrypted_keys.insert( _encrypted_keys.end(), key.first );
+            _encrypted_checksum = _checksum;
+            return;
+         }
+         for( const auto& key : _keys )
+            if( _encrypted_keys.insert( key.first ).second )
+               data.keys.insert( key );
+         _wallet.cipher_key_journal.push_back( fc::aes_encrypt( data.checksum, fc::raw::pack(data) ) );
       }
    }
 
+   /// Decrypts the keys of the wallet and the journal of keys added after them
+   void decrypt_keys( const fc::sha512& password )
+   {
+      auto pk = fc::raw::unpack<plain_keys>( fc::aes_decrypt( password, _wallet.cipher_keys ) );
+      FC_ASSERT( pk.checksum == password );
+      for( const auto& entry : _wallet.cipher_key_journal )
+      {
+         auto added = fc::raw::unpack<plain_keys>( fc::aes_decrypt( password, entry ) );
+         FC_ASSERT( added.checksum == password );
+         pk.keys.insert( added.keys.begin(), added.keys.end() );
+      }
+      _keys = std::move( pk.keys );
+      _checksum = pk.checksum;
+      _encrypted_keys.clear();
+      for( const auto& key : _keys )
+         _encrypted_keys.insert( _encrypted_keys.end(), key.first );
+      _encrypted_checksum = _checksum;
+   }
+
    void on_block_applied( const variant& block_id )
    {
+      clear_chain_state_cache();
       fc::async([this]{resync();}, "Resync after block");
    }
 
+   /// Drops the chain state read from the node, it is read again when it is needed next
+   void clear_chain_state_cache()
+   {
+      fc::scoped_lock<fc::mutex> lock( _cache_mutex );
+      _cache = chain_state_cache();
+      ++_cache_generation;
+   }
+
    bool copy_wallet_file( string destination_filename )
    {
+      flush_wallet_file();
       fc::path src_path = get_wallet_filename();
       if( !fc::exists( src_path ) )
          return false;
@@ -664,11 +745,38 @@ public:
    }
    global_property_object get_global_properties() const
    {
-      return _remote_db->get_global_properties();
+      uint64_t generation;
+      {
+         fc::scoped_lock<fc::mutex> lock( _cache_mutex );
+         if( _cache.global_properties.valid() )
+            return *_cache.global_properties;
+         generation = _cache_generation;
+      }
+      global_property_object result = _remote_db->get_global_properties();
+      fc::scoped_lock<fc::mutex> lock( _cache_mutex );
+      if( generation == _cache_generation )
+         _cache.global_properties = result;
+      return result;
    }
    dynamic_global_property_object get_dynamic_global_properties() const
    {
-      return _remote_db->get_dynamic_global_properties();
+      uint64_t generation;
+      {
+         fc::scoped_lock<fc::mutex> lock( _cache_mutex );
+         if( _cache.dynamic_global_properties.valid() )
+            return *_cache.dynamic_global_properties;
+         generation = _cache_generation;
+      }
+      dynamic_global_property_object result = _remote_db->get_dynamic_global_properties();
+      fc::scoped_lock<fc::mutex> lock( _cache_mutex );
+      if( generation == _cache_generation )
+         _cache.dynamic_global_properties = result;
+      return result;
+   }
+   /// @return the fee schedule in effect, from the cached global properties
+   fee_schedule get_current_fees() const
+   {
+      return get_global_properties().parameters.get_current_fees();
    }
    std::string account_id_to_string(account_id_type id) const
    {
@@ -677,12 +785,31 @@ public:
                                + "." + fc::to_string(id.instance.value);
       return account_id;
    }
+   /// Caches the account unless a block was applied since generation
+   void cache_account( const account_object& account, uint64_t generation ) const
+   {
+      fc::scoped_lock<fc::mutex> lock( _cache_mutex );
+      if( generation != _cache_generation )
+         return;
+      _cache.accounts[account.id] = account;
+      _cache.account_ids[account.name] = account.id;
+   }
    account_object get_account(account_id_type id) const
    {
+      uint64_t generation;
+      {
+         fc::scoped_lock<fc::mutex> lock( _cache_mutex );
+         auto itr = _cache.accounts.find( id );
+         if( itr != _cache.accounts.end() )
+            return itr->second;
+         generation = _cache_generation;
+      }
+
       std::string account_id = account_id_to_string(id);
 
       auto rec = _remote_db->get_accounts({account_id}, {}).front();
       FC_ASSERT(rec);
+      cache_account( *rec, generation );
       return *rec;
    }
    account_object get_account(string account_name_or_id) const
@@ -694,8 +821,17 @@ public:
          // It's an ID
          return get_account(*id);
       } else {
+         uint64_t generation;
+         {
+            fc::scoped_lock<fc::mutex> lock( _cache_mutex );
+            auto itr = _cache.account_ids.find( account_name_or_id );
+            if( itr != _cache.account_ids.end() )
+               return _cache.accounts.at( itr->second );
+            generation = _cache_generation;
+         }
          auto rec = _remote_db->lookup_account_names({account_name_or_id}).front();
          FC_ASSERT( rec && rec->name == account_name_or_id );
+         cache_account( *rec, generation );
          return *rec;
       }
    }
@@ -710,9 +846,28 @@ public:
                              "." + fc::to_string(id.instance.value);
       return asset_id;
    }
+   /// Caches the asset unless a block was applied since generation
+   void cache_asset( const extended_asset_object& asset, uint64_t generation ) const
+   {
+      fc::scoped_lock<fc::mutex> lock( _cache_mutex );
+      if( generation != _cache_generation )
+         return;
+      _cache.assets[asset.id] = asset;
+      _cache.asset_ids[asset.symbol] = asset.id;
+   }
    optional<extended_asset_object> find_asset(asset_id_type id)const
    {
+      uint64_t generation;
+      {
+         fc::scoped_lock<fc::mutex> lock( _cache_mutex );
+         auto itr = _cache.assets.find( id );
+         if( itr != _cache.assets.end() )
+            return itr->second;
+         generation = _cache_generation;
+      }
       auto rec = _remote_db->get_assets({asset_id_to_string(id)}, {}).front();
+      if( rec )
+         cache_asset( *rec, generation );
       return rec;
    }
    optional<extended_asset_object> find_asset(string asset_symbol_or_id)const
@@ -725,11 +880,20 @@ public:
          return find_asset(*id);
       } else {
          // It's a symbol
+         uint64_t generation;
+         {
+            fc::scoped_lock<fc::mutex> lock( _cache_mutex );
+            auto itr = _cache.asset_ids.find( asset_symbol_or_id );
+            if( itr != _cache.asset_ids.end() )
+               return _cache.assets.at( itr->second );
+            generation = _cache_generation;
+         }
          auto rec = _remote_db->lookup_asset_symbols({asset_symbol_or_id}).front();
          if( rec )
          {
             if( rec->symbol != asset_symbol_or_id )
                return optional<asset_object>();
+            cache_asset( *rec, generation );
          }
          return rec;
       }
@@ -827,6 +991,85 @@ public:
 
    vector< signed_transaction > import_balance( string name_or_id, const vector<string>& wif_keys, bool broadcast );
 
+   /// An operation in the history of an account, along with its description once it was made
+   struct cached_operation
+   {
+      operation_history_object           op;
+      optional<operation_detail>         detail;
+      /// Number of keys in the wallet when detail was made, newly imported keys may decrypt its memo
+      size_t                             keys = 0;
+   };
+
+   /// @return the description of a cached operation, which is kept if the wallet could decrypt its memo
+   operation_detail describe_operation( cached_operation& entry )const
+   {
+      if( entry.detail.valid() && entry.keys == _keys.size() )
+         return *entry.detail;
+      std::stringstream ss;
+      auto memo = entry.op.op.visit( detail::operation_printer( ss, *this, entry.op ) );
+      operation_detail result{ memo, ss.str(), entry.op };
+      if( !is_locked() )
+      {
+         entry.detail = result;
+         entry.keys = _keys.size();
+      }
+      return result;
+   }
+
+   /**
+    * Same as history_api::get_relative_account_history, but the operations of the account are kept in the
+    * cache of the wallet once they are irreversible, so that only operations not seen before are fetched
+    * from the node.
+    */
+   vector<operation_detail> get_relative_account_history( const string& name, uint64_t stop, int limit,
+                                                          uint64_t start )const
+   {
+      vector<operation_detail> result;
+      const account_object account = get_account( name );
+      const uint64_t total_ops = get_object( account.statistics ).total_ops;
+      const uint32_t last_irreversible_block = get_dynamic_global_properties().last_irreversible_block_num;
+      const std::string account_id = account_id_to_string( account.get_id() );
+
+      auto& cache = _history_cache[account.get_id()];
+      if( !cache.empty() && cache.rbegin()->first > total_ops ) // the node lost history, e.g. after a replay
+         cache.clear();
+
+      stop = std::max<uint64_t>( stop, 1 );
+      uint64_t seq = ( start == 0 ) ? total_ops : std::min( start, total_ops );
+      while( limit > 0 && seq >= stop )
+      {
+         auto itr = cache.lower_bound( seq );
+         if( itr != cache.end() && itr->first == seq )
+         {
+            result.push_back( describe_operation( itr->second ) );
+            --seq;
+            --limit;
+            continue;
+         }
+
+         // fetch the operations down to the next one in the cache
+         uint64_t page_stop = stop;
+         if( itr != cache.begin() )
+            page_stop = std::max( stop, std::prev( itr )->first + 1 );
+         const uint32_t page_limit = std::min<uint64_t>( std::min<uint64_t>( 100, limit ), seq - page_stop + 1 );
+         vector<operation_history_object> current = _remote_hist->get_relative_account_history(
+               account_id, page_stop, page_limit, seq );
+         for( auto& o : current )
+         {
+            cached_operation entry{ std::move(o) };
+            if( entry.op.block_num <= last_irreversible_block )
+               result.push_back( describe_operation( cache.emplace( seq, std::move(entry) ).first->second ) );
+            else
+               result.push_back( describe_operation( entry ) );
+            --seq;
+            --limit;
+         }
+         if( current.size() < page_limit )
+            break;
+      }
+      return result;
+   }
+
    bool load_wallet_file(string wallet_filename = "")
    {
       // TODO:  Merge imported wallet with existing wallet,
@@ -838,6 +1081,8 @@ public:
          return false;
 
       _wallet = fc::json::from_file( wallet_filename ).as< wallet_data >( 2 * GRAPHENE_MAX_NESTED_OBJECTS );
+      _encrypted_keys.clear();
+      _encrypted_checksum = fc::sha512();
       if( _wallet.chain_id != _chain_id )
          FC_THROW( "Wallet chain ID does not match",
             ("wallet.chain_id", _wallet.chain_id)
@@ -985,6 +1230,35 @@ public:
 
       string data = fc::json::to_pretty_string( _wallet );
 
+      // The file is written on its own thread, which saves in the order the saves were requested
+      _pending_save = _save_thread.async( [this,wallet_filename,data=std::move(data)]() {
+         write_wallet_file( wallet_filename, data );
+      }, "save wallet file" );
+   }
+
+   /// Waits until the wallet file is saved, throws if the last save failed
+   void flush_wallet_file()
+   {
+      if( !_pending_save.valid() )
+         return;
+      fc::future<void> pending_save = _pending_save;
+      _pending_save = fc::future<void>();
+      try
+      {
+         pending_save.wait();
+      }
+      catch(...)
+      {
+         string ws_password = _wallet.ws_password;
+         _wallet.ws_password = "";
+         wlog("wallet file content is next: ${data}", ("data", fc::json::to_pretty_string( _wallet ) ) );
+         _wallet.ws_password = ws_password;
+         throw;
+      }
+   }
+
+   void write_wallet_file( const string& wallet_filename, const string& data )
+   {
       try
       {
          enable_umask_protection();
@@ -1023,11 +1297,7 @@ public:
       }
       catch(...)
       {
-         string ws_password = _wallet.ws_password;
-         _wallet.ws_password = "";
-         wlog("wallet file content is next: ${data}", ("data", fc::json::to_pretty_string( _wallet ) ) );
-         _wallet.ws_password = ws_password;
-
+         elog( "failed to save wallet to file ${fn}", ("fn", wallet_filename) );
          disable_umask_protection();
          throw;
       }
@@ -1045,6 +1315,13 @@ public:
       FC_ASSERT(_builder_transactions.count(transaction_handle));
       _builder_transactions[transaction_handle].operations.emplace_back(op);
    }
+   void add_operations_to_builder_transaction(transaction_handle_type transaction_handle,
+                                              const vector<operation>& ops)
+   {
+      FC_ASSERT(_builder_transactions.count(transaction_handle));
+      auto& operations = _builder_transactions[transaction_handle].operations;
+      operations.insert( operations.end(), ops.begin(), ops.end() );
+   }
    void replace_operation_in_builder_transaction(transaction_handle_type handle,
                                                  uint32_t operation_index,
                                                  const operation& new_op)
@@ -1061,7 +1338,7 @@ public:
       auto fee_asset_obj = get_asset(fee_asset);
       asset total_fee = fee_asset_obj.amount(0);
 
-      auto gprops = _remote_db->get_global_properties().parameters;
+      auto gprops = get_global_properties().parameters;
       if( fee_asset_obj.get_id() != asset_id_type() )
       {
          for( auto& op : _builder_transactions[handle].operations )
@@ -1091,6 +1368,137 @@ public:
             sign_transaction(_builder_transactions[transaction_handle], broadcast);
    }
 
+   /**
+    * Runs task for each of count items, keeping up to BULK_PIPELINE_DEPTH of them waiting for the node at
+    * a time. Returns the error of each item that failed, items are not stopped by the failure of another.
+    */
+   template<typename Task>
+   vector<optional<string>> pipeline_requests( size_t count, Task task )
+   {
+      vector<optional<string>> errors( count );
+      std::deque<std::pair<size_t, fc::future<void>>> in_flight;
+      auto wait_for_oldest = [&in_flight,&errors]() {
+         try
+         {
+            in_flight.front().second.wait();
+         }
+         catch( const fc::exception& e )
+         {
+            errors[in_flight.front().first] = e.to_string();
+         }
+         in_flight.pop_front();
+      };
+      for( size_t i = 0; i < count; ++i )
+      {
+         if( in_flight.size() >= BULK_PIPELINE_DEPTH )
+            wait_for_oldest();
+         in_flight.emplace_back( i, fc::async( [&task,i]() { task(i); }, "bulk request" ) );
+      }
+      while( !in_flight.empty() )
+         wait_for_oldest();
+      return errors;
+   }
+
+   vector<bulk_transaction_result> sign_builder_transaction_in_bulk( transaction_handle_type handle,
+                                                                     string fee_asset,
+                                                                     uint32_t max_operations_per_transaction,
+                                                                     bool broadcast )
+   { try {
+      FC_ASSERT( !self.is_locked() );
+      FC_ASSERT( _builder_transactions.count(handle) );
+      set_fees_on_builder_transaction( handle, fee_asset );
+      const vector<operation>& operations = _builder_transactions[handle].operations;
+
+      const auto parameters = get_global_properties().parameters;
+      FC_ASSERT( parameters.maximum_transaction_size > BULK_TRANSACTION_SIZE_RESERVE );
+      const size_t size_limit = parameters.maximum_transaction_size - BULK_TRANSACTION_SIZE_RESERVE;
+
+      // Pack the operations into transactions in their order, each one starts a new transaction if the
+      // current one would grow beyond the size or operation count limit
+      vector<bulk_transaction_result> results;
+      size_t trx_size = 0;
+      for( uint32_t i = 0; i < operations.size(); ++i )
+      {
+         const size_t op_size = fc::raw::pack_size( operations[i] );
+         if( results.empty() || trx_size + op_size > size_limit
+               || ( max_operations_per_transaction > 0
+                    && results.back().operation_count >= max_operations_per_transaction ) )
+         {
+            results.emplace_back();
+            results.back().first_operation = i;
+            trx_size = 0;
+         }
+         results.back().trx.operations.push_back( operations[i] );
+         ++results.back().operation_count;
+         trx_size += op_size;
+      }
+
+      // Looking up the keys needs two requests to the node for each transaction, so they are pipelined
+      vector<set<public_key_type>> approving_keys( results.size() );
+      auto errors = pipeline_requests( results.size(), [this,&results,&approving_keys]( size_t i ) {
+         approving_keys[i] = get_owned_required_keys( results[i].trx );
+      });
+
+      auto dyn_props = get_dynamic_global_properties();
+      fc::time_point_sec oldest_transaction_ids_to_track(dyn_props.time - fc::minutes(2));
+      auto& by_timestamp = _recently_generated_transactions.get<timestamp_index>();
+      by_timestamp.erase( by_timestamp.begin(), by_timestamp.lower_bound(oldest_transaction_ids_to_track) );
+
+      // The ID does not cover the signatures, so duplicates are avoided before anything is signed
+      vector<vector<private_key_type>> signing_keys( results.size() );
+      for( size_t i = 0; i < results.size(); ++i )
+      {
+         if( errors[i].valid() )
+            continue;
+         signed_transaction& trx = results[i].trx;
+         trx.set_reference_block( dyn_props.head_block_id );
+         uint32_t expiration_time_offset = 0;
+         do {
+            trx.set_expiration( dyn_props.time + parameters.maximum_time_until_expiration
+                                - fc::seconds(expiration_time_offset++) );
+         } while( _recently_generated_transactions.find( trx.id() ) != _recently_generated_transactions.end() );
+         recently_generated_transaction_record this_transaction_record;
+         this_transaction_record.generation_time = dyn_props.time;
+         this_transaction_record.transaction_id = trx.id();
+         _recently_generated_transactions.insert(this_transaction_record);
+
+         for( const public_key_type& key : approving_keys[i] )
+            signing_keys[i].push_back( get_private_key(key) );
+      }
+
+      // Signing does not touch the wallet, so it is spread over the worker threads
+      for_each_in_parallel( results.size(), [this,&results,&signing_keys,&errors]( size_t i ) {
+         if( errors[i].valid() )
+            return;
+         for( const private_key_type& key : signing_keys[i] )
+            results[i].trx.sign( key, _chain_id );
+         results[i].transaction_id = results[i].trx.id();
+      });
+
+      if( broadcast )
+      {
+         auto broadcast_errors = pipeline_requests( results.size(), [this,&results,&errors]( size_t i ) {
+            if( !errors[i].valid() )
+               _remote_net_broadcast->broadcast_transaction( results[i].trx );
+         });
+         for( size_t i = 0; i < results.size(); ++i )
+            if( broadcast_errors[i].valid() )
+               errors[i] = broadcast_errors[i];
+      }
+
+      for( size_t i = 0; i < results.size(); ++i )
+      {
+         if( errors[i].valid() )
+         {
+            elog( "Bulk transaction with operations ${first} to ${last} failed: ${e}",
+                  ("first", results[i].first_operation)
+                  ("last", results[i].first_operation + results[i].operation_count - 1)("e", *errors[i]) );
+            results[i].error = errors[i];
+         }
+      }
+      return results;
+   } FC_CAPTURE_AND_RETHROW( (handle)(fee_asset)(max_operations_per_transaction)(broadcast) ) }
+
    pair<transaction_id_type,signed_transaction> broadcast_transaction(signed_transaction tx)
    {
        try {
@@ -1118,7 +1526,7 @@ public:
       if( review_period_seconds )
          op.review_period_seconds = review_period_seconds;
       trx.operations = {op};
-      _remote_db->get_global_properties().parameters.get_current_fees().set_fee( trx.operations.front() );
+      get_current_fees().set_fee( trx.operations.front() );
 
       return trx = sign_transaction(trx, broadcast);
    }
@@ -1139,7 +1547,7 @@ public:
       if( review_period_seconds )
          op.review_period_seconds = review_period_seconds;
       trx.operations = {op};
-      _remote_db->get_global_properties().parameters.get_current_fees().set_fee( trx.operations.front() );
+      get_current_fees().set_fee( trx.operations.front() );
 
       return trx = sign_transaction(trx, broadcast);
    }
@@ -1186,7 +1594,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( account_create_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees() );
+      set_operation_fees( tx, get_current_fees() );
       tx.validate();
 
       return sign_transaction(tx, broadcast);
@@ -1204,7 +1612,7 @@ public:
       op.account_to_upgrade = account_obj.get_id();
       op.upgrade_to_lifetime_member = true;
       tx.operations = {op};
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees() );
+      set_operation_fees( tx, get_current_fees() );
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1287,7 +1695,7 @@ public:
 
          signed_transaction tx;
          tx.operations.push_back( account_create_op );
-         set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+         set_operation_fees( tx, get_current_fees());
          tx.validate();
 
          // we do not insert owner_privkey here because
@@ -1334,7 +1742,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( create_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1362,7 +1770,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( update_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1385,7 +1793,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( update_issuer );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1406,7 +1814,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( update_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1430,7 +1838,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( update_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1452,7 +1860,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( publish_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1476,7 +1884,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( fund_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1498,7 +1906,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( claim_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1521,7 +1929,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( reserve_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1542,7 +1950,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( settle_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1563,7 +1971,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( settle_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1589,7 +1997,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1607,7 +2015,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( whitelist_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1625,7 +2033,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( committee_member_create_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1724,7 +2132,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( witness_create_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       _wallet.pending_witness_registrations[owner_account] = key_to_wif(witness_private_key);
@@ -1750,7 +2158,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( witness_update_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees() );
+      set_operation_fees( tx, get_current_fees() );
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1801,7 +2209,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees() );
+      set_operation_fees( tx, get_current_fees() );
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1865,7 +2273,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( update_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees() );
+      set_operation_fees( tx, get_current_fees() );
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1904,7 +2312,7 @@ public:
 
          signed_transaction tx;
          tx.operations.push_back(create_op);
-         set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+         set_operation_fees( tx, get_current_fees());
          tx.validate();
 
          return sign_transaction(tx, broadcast);
@@ -1929,7 +2337,7 @@ public:
 
          signed_transaction tx;
          tx.operations.push_back(update_op);
-         set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+         set_operation_fees( tx, get_current_fees());
          tx.validate();
 
          return sign_transaction(tx, broadcast);
@@ -1953,7 +2361,7 @@ public:
 
          signed_transaction tx;
          tx.operations.push_back(update_op);
-         set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+         set_operation_fees( tx, get_current_fees());
          tx.validate();
 
          return sign_transaction(tx, broadcast);
@@ -1964,7 +2372,7 @@ public:
    { try {
       fc::optional<vesting_balance_id_type> vbid = maybe_id<vesting_balance_id_type>( account_name );
       std::vector<vesting_balance_object_with_info> result;
-      fc::time_point_sec now = _remote_db->get_dynamic_global_properties().time;
+      fc::time_point_sec now = get_dynamic_global_properties().time;
 
       if( vbid )
       {
@@ -2007,7 +2415,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( vesting_balance_withdraw_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees() );
+      set_operation_fees( tx, get_current_fees() );
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -2045,7 +2453,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( account_update_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -2081,7 +2489,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( account_update_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -2113,7 +2521,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( account_update_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -2141,7 +2549,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( account_update_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -2243,26 +2651,52 @@ public:
       return md;
    }
 
+   /// @return the key of this wallet a memo is encrypted with, followed by the other key of the memo
+   std::pair<public_key_type, public_key_type> get_memo_keys( const memo_data& memo )const
+   {
+      FC_ASSERT( _keys.count(memo.to) || _keys.count(memo.from),
+                 "Memo is encrypted to a key ${to} or ${from} not in this wallet.",
+                 ("to", memo.to)("from",memo.from) );
+      if( _keys.count(memo.to) )
+         return std::make_pair( memo.to, memo.from );
+      return std::make_pair( memo.from, memo.to );
+   }
+
+   fc::ecc::private_key get_memo_private_key( const public_key_type& key )const
+   {
+      auto my_key = wif_to_key(_keys.at(key));
+      FC_ASSERT(my_key, "Unable to recover private key to decrypt memo. Wallet may be corrupted.");
+      return *my_key;
+   }
+
+   void cache_memo_shared_secret( const std::pair<public_key_type, public_key_type>& keys,
+                                  const fc::sha512& secret )const
+   {
+      if( _memo_shared_secrets.size() >= MAX_MEMO_SHARED_SECRETS )
+         _memo_shared_secrets.clear();
+      _memo_shared_secrets[keys] = secret;
+   }
+
+   /// @return the secret a memo is encrypted with, which is computed once for each pair of keys
+   fc::sha512 get_memo_shared_secret( const memo_data& memo )const
+   {
+      const auto keys = get_memo_keys( memo );
+      auto itr = _memo_shared_secrets.find( keys );
+      if( itr != _memo_shared_secrets.end() )
+         return itr->second;
+      fc::sha512 secret = get_memo_private_key( keys.first ).get_shared_secret( keys.second );
+      cache_memo_shared_secret( keys, secret );
+      return secret;
+   }
+
    string read_memo(const memo_data& md)
    {
       FC_ASSERT(!is_locked());
       std::string clear_text;
 
-      const memo_data *memo = &md;
-
       try {
-         FC_ASSERT( _keys.count(memo->to) || _keys.count(memo->from),
-                    "Memo is encrypted to a key ${to} or ${from} not in this wallet.",
-                    ("to", memo->to)("from",memo->from) );
-         if( _keys.count(memo->to) ) {
-            auto my_key = wif_to_key(_keys.at(memo->to));
-            FC_ASSERT(my_key, "Unable to recover private key to decrypt memo. Wallet may be corrupted.");
-            clear_text = memo->get_message(*my_key, memo->from);
-         } else {
-            auto my_key = wif_to_key(_keys.at(memo->from));
-            FC_ASSERT(my_key, "Unable to recover private key to decrypt memo. Wallet may be corrupted.");
-            clear_text = memo->get_message(*my_key, memo->to);
-         }
+         clear_text = md.from == public_key_type() ? md.get_message( fc::sha512() )
+                                                   : md.get_message( get_memo_shared_secret( md ) );
       } catch (const fc::exception& e) {
          elog("Error when decrypting memo: ${e}", ("e", e.to_detail_string()));
       }
@@ -2270,6 +2704,73 @@ public:
       return clear_text;
    }
 
+   vector<string> read_memos(const vector<memo_data>& memos)
+   {
+      FC_ASSERT(!is_locked());
+      vector<string> clear_texts( memos.size() );
+      vector<optional<fc::sha512>> secrets( memos.size() );
+      vector<optional<string>> errors( memos.size() );
+
+      // The keys of the memos are looked up here, the shared secrets that are not known yet are computed
+      // on the worker threads, once for each pair of keys
+      map<std::pair<public_key_type, public_key_type>, vector<size_t>> missing;
+      for( size_t i = 0; i < memos.size(); ++i )
+      {
+         if( memos[i].from == public_key_type() )
+            continue;
+         try {
+            const auto keys = get_memo_keys( memos[i] );
+            auto itr = _memo_shared_secrets.find( keys );
+            if( itr != _memo_shared_secrets.end() )
+               secrets[i] = itr->second;
+            else
+               missing[keys].push_back( i );
+         } catch (const fc::exception& e) {
+            errors[i] = e.to_detail_string();
+         }
+      }
+      vector<std::pair<std::pair<public_key_type, public_key_type>, vector<size_t>>> pending(
+            missing.begin(), missing.end() );
+      vector<optional<fc::ecc::private_key>> private_keys( pending.size() );
+      for( size_t i = 0; i < pending.size(); ++i )
+      {
+         try {
+            private_keys[i] = get_memo_private_key( pending[i].first.first );
+         } catch (const fc::exception& e) {
+            for( size_t memo : pending[i].second )
+               errors[memo] = e.to_detail_string();
+         }
+      }
+      vector<fc::sha512> pending_secrets( pending.size() );
+      for_each_in_parallel( pending.size(), [&pending,&private_keys,&pending_secrets]( size_t i ) {
+         if( private_keys[i].valid() )
+            pending_secrets[i] = private_keys[i]->get_shared_secret( pending[i].first.second );
+      });
+      for( size_t i = 0; i < pending.size(); ++i )
+      {
+         if( !private_keys[i].valid() )
+            continue;
+         cache_memo_shared_secret( pending[i].first, pending_secrets[i] );
+         for( size_t memo : pending[i].second )
+            secrets[memo] = pending_secrets[i];
+      }
+
+      for_each_in_parallel( memos.size(), [&memos,&secrets,&errors,&clear_texts]( size_t i ) {
+         if( errors[i].valid() )
+            return;
+         try {
+            clear_texts[i] = memos[i].get_message( secrets[i].valid() ? *secrets[i] : fc::sha512() );
+         } catch (const fc::exception& e) {
+            errors[i] = e.to_detail_string();
+         }
+      });
+
+      for( size_t i = 0; i < memos.size(); ++i )
+         if( errors[i].valid() )
+            elog("Error when decrypting memo ${i}: ${e}", ("i", i)("e", *errors[i]));
+      return clear_texts;
+   }
+
    signed_message sign_message(string signer, string message)
    {
       FC_ASSERT( !self.is_locked() );
@@ -2366,7 +2867,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back(op);
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -2387,7 +2888,7 @@ public:
 
       signed_transaction trx;
       trx.operations = {op};
-      set_operation_fees( trx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( trx, get_current_fees());
       trx.validate();
 
       return sign_transaction(trx, broadcast);
@@ -2411,7 +2912,7 @@ public:
 
       signed_transaction trx;
       trx.operations = {op};
-      set_operation_fees( trx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( trx, get_current_fees());
       trx.validate();
 
       return sign_transaction(trx, broadcast);
@@ -2426,7 +2927,7 @@ public:
          op.fee_paying_account = get_object(order_id).seller;
          op.order = order_id;
          trx.operations = {op};
-         set_operation_fees( trx, _remote_db->get_global_properties().parameters.get_current_fees());
+         set_operation_fees( trx, get_current_fees());
 
          trx.validate();
          return sign_transaction(trx, broadcast);
@@ -2461,7 +2962,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back(xfer_op);
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees( tx, get_current_fees());
       tx.validate();
 
       return sign_transaction(tx, broadcast);
@@ -2491,7 +2992,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back(issue_op);
-      set_operation_fees(tx,_remote_db->get_global_properties().parameters.get_current_fees());
+      set_operation_fees(tx,get_current_fees());
       tx.validate();
 
       return sign_transaction(tx, broadcast);
@@ -3081,6 +3582,12 @@ public:
 
    map<public_key_type,string> _keys;
    fc::sha512                  _checksum;
+   /// Keys in the cipher keys or the journal of the wallet, and the checksum they were encrypted with
+   set<public_key_type>        _encrypted_keys;
+   fc::sha512                  _encrypted_checksum;
+
+   fc::thread                  _save_thread{ "wallet save" };
+   fc::future<void>            _pending_save;
 
    chain_id_type           _chain_id;
    fc::api<login_api>      _remote_api;
@@ -3090,6 +3597,31 @@ public:
    optional< fc::api<network_node_api> > _remote_net_node;
    optional< fc::api<graphene::debug_witness::debug_api> > _remote_debug;
 
+   /**
+    * Chain state read from the node, so that building a transaction does not ask for the same
+    * objects again; it is dropped each time the node reports a new block
+    */
+   struct chain_state_cache
+   {
+      optional<global_property_object>                 global_properties;
+      optional<dynamic_global_property_object>         dynamic_global_properties;
+      map<account_id_type, account_object>             accounts;
+      map<string, account_id_type>                     account_ids;
+      map<asset_id_type, extended_asset_object>        assets;
+      map<string, asset_id_type>                       asset_ids;
+   };
+   mutable chain_state_cache   _cache;
+
+   /// Shared secrets of memos, by the key of this wallet and the other key, cleared when the wallet is locked
+   mutable map<std::pair<public_key_type, public_key_type>, fc::sha512> _memo_shared_secrets;
+
+   /// Irreversible operations of the accounts that were queried, by account and sequence number,
+   /// cleared when the wallet is locked since they hold the decrypted memos
+   mutable map<account_id_type, map<uint64_t, cached_operation>> _history_cache;
+   /// Increased whenever the cache is cleared, so that a lookup racing with a new block is not cached
+   mutable uint64_t            _cache_generation = 0;
+   mutable fc::mutex           _cache_mutex;
+
    flat_map<string, operation> _prototype_ops;
 
    static_variant_map _operation_which_map = create_static_variant_map< operation >();
@@ -3157,20 +3689,8 @@ string operation_printer::operator()(const transfer_operation& op) const
          out << " -- Unlock wallet to see memo.";
       } else {
          try {
-            FC_ASSERT( wallet._keys.count(op.memo->to) || wallet._keys.count(op.memo->from),
-                       "Memo is encrypted to a key ${to} or ${from} not in this wallet.",
-                       ("to", op.memo->to)("from",op.memo->from) );
-            if( wallet._keys.count(op.memo->to) ) {
-               auto my_key = wif_to_key(wallet._keys.at(op.memo->to));
-               FC_ASSERT(my_key, "Unable to recover private key to decrypt memo. Wallet may be corrupted.");
-               memo = op.memo->get_message(*my_key, op.memo->from);
-               out << " -- Memo: " << memo;
-            } else {
-               auto my_key = wif_to_key(wallet._keys.at(op.memo->from));
-               FC_ASSERT(my_key, "Unable to recover private key to decrypt memo. Wallet may be corrupted.");
-               memo = op.memo->get_message(*my_key, op.memo->to);
-               out << " -- Memo: " << memo;
-            }
+            memo = op.memo->get_message( wallet.get_memo_shared_secret( *op.memo ) );
+            out << " -- Memo: " << memo;
          } catch (const fc::exception& e) {
             out << " -- could not decrypt memo";
          }
@@ -3446,58 +3966,7 @@ signed_transaction wallet_api::htlc_extend ( std::string htlc_id, std::string is
 
 vector<operation_detail> wallet_api::get_account_history(string name, int limit)const
 {
-   vector<operation_detail> result;
-
-   while( limit > 0 )
-   {
-      bool skip_first_row = false;
-      operation_history_id_type start;
-      if( result.size() )
-      {
-         start = result.back().op.id;
-         if( start == operation_history_id_type() ) // no more data
-            break;
-         start = start + (-1);
-         if( start == operation_history_id_type() ) // will return most recent history if
-                                                    // directly call remote API with this
-         {
-            start = start + 1;
-            skip_first_row = true;
-         }
-      }
-
-      int page_limit = skip_first_row ? std::min( 100, limit + 1 ) : std::min( 100, limit );
-
-      vector<operation_history_object> current = my->_remote_hist->get_account_history(
-            name,
-            operation_history_id_type(),
-            page_limit,
-            start );
-      bool first_row = true;
-      for( auto& o : current )
-      {
-         if( first_row )
-         {
-            first_row = false;
-            if( skip_first_row )
-            {
-               continue;
-            }
-         }
-         std::stringstream ss;
-         auto memo = o.op.visit(detail::operation_printer(ss, *my, o));
-         result.push_back( operation_detail{ memo, ss.str(), o } );
-      }
-
-      if( int(current.size()) < page_limit )
-         break;
-
-      limit -= current.size();
-      if( skip_first_row )
-         ++limit;
-   }
-
-   return result;
+   return my->get_relative_account_history( name, 0, limit, 0 );
 }
 
 vector<operation_detail> wallet_api::get_relative_account_history(
@@ -3506,36 +3975,7 @@ vector<operation_detail> wallet_api::get_relative_account_history(
       int limit,
       uint32_t start)const
 {
-   vector<operation_detail> result;
-   auto account_id = get_account(name).get_id();
-
-   const account_object& account = my->get_account(account_id);
-   const account_statistics_object& stats = my->get_object(account.statistics);
-
-   if(start == 0)
-       start = stats.total_ops;
-   else
-      start = std::min<uint32_t>(start, stats.total_ops);
-
-   while( limit > 0 )
-   {
-      vector <operation_history_object> current = my->_remote_hist->get_relative_account_history(
-            name,
-            stop,
-            std::min<uint32_t>(100, limit),
-            start);
-      for (auto &o : current) {
-         std::stringstream ss;
-         auto memo = o.op.visit(detail::operation_printer(ss, *my, o));
-         result.push_back(operation_detail{memo, ss.str(), o});
-      }
-      if (current.size() < std::min<uint32_t>(100, limit))
-         break;
-      limit -= current.size();
-      start -= 100;
-      if( start == 0 ) break;
-   }
-   return result;
+   return my->get_relative_account_history( name, stop, limit, start );
 }
 
 account_history_operation_detail wallet_api::get_account_history_by_operations(
@@ -3674,6 +4114,13 @@ void wallet_api::add_operation_to_builder_transaction(
    my->add_operation_to_builder_transaction(transaction_handle, op);
 }
 
+void wallet_api::add_operations_to_builder_transaction(
+      transaction_handle_type transaction_handle,
+      const vector<operation>& ops)
+{
+   my->add_operations_to_builder_transaction(transaction_handle, ops);
+}
+
 void wallet_api::replace_operation_in_builder_transaction(
       transaction_handle_type handle,
       unsigned operation_index,
@@ -3702,6 +4149,16 @@ pair<transaction_id_type,signed_transaction> wallet_api::broadcast_transaction(s
     return my->broadcast_transaction(tx);
 }
 
+vector<bulk_transaction_result> wallet_api::sign_builder_transaction_in_bulk(
+      transaction_handle_type transaction_handle,
+      string fee_asset,
+      uint32_t max_operations_per_transaction,
+      bool broadcast)
+{
+   return my->sign_builder_transaction_in_bulk(transaction_handle, fee_asset, max_operations_per_transaction,
+                                               broadcast);
+}
+
 signed_transaction wallet_api::propose_builder_transaction(
       transaction_handle_type handle,
       time_point_sec expiration,
@@ -3774,6 +4231,30 @@ bool wallet_api::import_key(string account_name_or_id, string wif_key)
    return false;
 }
 
+vector<bool> wallet_api::import_keys( string account_name_or_id, vector<string> wif_keys )
+{
+   FC_ASSERT( !is_locked() );
+   FC_ASSERT( !wif_keys.empty() );
+   for( const string& wif_key : wif_keys )
+      if( !wif_to_key( wif_key ) )
+         FC_THROW( "Invalid private key ${key}", ("key", wif_key) );
+   // backup wallet once for all of the keys
+   string shorthash = detail::address_to_shorthash( wif_to_key( wif_keys.front() )->get_public_key() );
+   copy_wallet_file( "before-import-keys-" + shorthash );
+
+   vector<bool> imported;
+   imported.reserve( wif_keys.size() );
+   for( const string& wif_key : wif_keys )
+      imported.push_back( my->import_key( account_name_or_id, wif_key ) );
+
+   if( std::find( imported.begin(), imported.end(), true ) != imported.end() )
+   {
+      save_wallet_file();
+      copy_wallet_file( "after-import-keys-" + shorthash );
+   }
+   return imported;
+}
+
 map<string, bool> wallet_api::import_accounts( string filename, string password )
 {
    FC_ASSERT( !is_locked() );
@@ -4373,6 +4854,7 @@ void wallet_api::quit()
 void wallet_api::save_wallet_file( string wallet_filename )
 {
    my->save_wallet_file( wallet_filename );
+   my->flush_wallet_file();
 }
 
 std::map<string,std::function<string(fc::variant,const fc::variants&)> >
@@ -4402,6 +4884,8 @@ void wallet_api::lock()
    for( auto key : my->_keys )
       key.second = key_to_wif(fc::ecc::private_key());
    my->_keys.clear();
+   my->_memo_shared_secrets.clear();
+   my->_history_cache.clear();
    my->_checksum = fc::sha512();
    my->self.lock_changed(true);
 } FC_CAPTURE_AND_RETHROW() }
@@ -4410,11 +4894,7 @@ void wallet_api::unlock(string password)
 { try {
    FC_ASSERT(password.size() > 0);
    auto pw = fc::sha512::hash(password.c_str(), password.size());
-   vector<char> decrypted = fc::aes_decrypt(pw, my->_wallet.cipher_keys);
-   auto pk = fc::raw::unpack<plain_keys>(decrypted);
-   FC_ASSERT(pk.checksum == pw);
-   my->_keys = std::move(pk.keys);
-   my->_checksum = pk.checksum;
+   my->decrypt_keys(pw);
    my->self.lock_changed(false);
 } FC_CAPTURE_AND_RETHROW() }
 
@@ -4442,7 +4922,7 @@ vector< signed_transaction > wallet_api_impl::import_balance(
       bool broadcast )
 { try {
    FC_ASSERT(!is_locked());
-   const dynamic_global_property_object& dpo = _remote_db->get_dynamic_global_properties();
+   const dynamic_global_property_object dpo = get_dynamic_global_properties();
    account_object claimer = get_account( name_or_id );
    uint32_t max_ops_per_tx = 30;
 
@@ -4534,7 +5014,7 @@ vector< signed_transaction > wallet_api_impl::import_balance(
       tx.operations.reserve( ctx.ops.size() );
       for( const balance_claim_operation& op : ctx.ops )
          tx.operations.emplace_back( op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.get_current_fees() );
+      set_operation_fees( tx, get_current_fees() );
       tx.validate();
       signed_transaction signed_tx = sign_transaction( tx, false );
       for( const address& addr : ctx.addrs )
@@ -4605,6 +5085,12 @@ memo_data wallet_api::sign_memo(string from, string to, string memo)
    return my->sign_memo(from, to, memo);
 }
 
+vector<string> wallet_api::read_memos(const vector<memo_data>& memos)
+{
+   FC_ASSERT(!is_locked());
+   return my->read_memos(memos);
+}
+
 string wallet_api::read_memo(const memo_data& memo)
 {
    FC_ASSERT(!is_locked());
@@ -4761,7 +5247,7 @@ blind_confirmation wallet_api::transfer_from_blind( string from_blind_account_ke
    transfer_from_blind_operation from_blind;
 
 
-   auto fees  = my->_remote_db->get_global_properties().parameters.get_current_fees();
+   auto fees  = my->get_current_fees();
    fc::optional<asset_object> asset_obj = get_asset(symbol);
    FC_ASSERT(asset_obj.valid(), "Could not find asset matching ${asset}", ("asset", symbol));
    auto amount = asset_obj->amount_from_string(amount_in);
@@ -4841,7 +5327,7 @@ blind_confirmation wallet_api::blind_transfer_help( string from_key_or_label,
    blind_transfer_operation blind_tr;
    blind_tr.outputs.resize(2);
 
-   auto fees  = my->_remote_db->get_global_properties().parameters.get_current_fees();
+   auto fees  = my->get_current_fees();
 
    auto amount = asset_obj->amount_from_string(amount_in);
 
@@ -5069,7 +5555,7 @@ blind_confirmation wallet_api::transfer_to_blind( string from_account_id_or_name
               [&]( const blind_output& a, const blind_output& b ){ return a.commitment < b.commitment; } );
 
    confirm.trx.operations.push_back( bop );
-   my->set_operation_fees( confirm.trx, my->_remote_db->get_global_properties().parameters.get_current_fees());
+   my->set_operation_fees( confirm.trx, my->get_current_fees());
    confirm.trx.validate();
    confirm.trx = sign_transaction(confirm.trx, broadcast);
 
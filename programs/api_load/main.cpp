@@ -0,0 +1,456 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <fc/exception/exception.hpp>
+#include <fc/io/json.hpp>
+#include <fc/network/http/websocket.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/time.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bpo = boost::program_options;
+
+namespace {
+
+/// The calls made when neither --mix nor --call-log is given
+const char* const default_mix = R"([
+   { "api": "database", "method": "get_dynamic_global_properties", "params": [], "weight": 4 },
+   { "api": "database", "method": "get_objects", "params": [["1.2.${account}"]], "weight": 4 },
+   { "api": "database", "method": "get_full_accounts", "params": [["1.2.${account}"], false], "weight": 2 },
+   { "api": "database", "method": "get_account_balances", "params": ["1.2.${account}", []], "weight": 2 },
+   { "api": "database", "method": "lookup_accounts", "params": ["", 100], "weight": 1 },
+   { "api": "history", "method": "get_account_history",
+     "params": ["1.2.${account}", "1.11.0", 100, "1.11.0"], "weight": 1 }
+])";
+
+const std::string account_placeholder = "${account}";
+
+/// A call to make, the request without its ID
+struct call_template
+{
+   std::string name;         ///< api.method, the calls are reported by it
+   std::string request_tail; ///< the JSON text of the request after the ID
+   uint32_t    weight = 1;
+   bool        has_placeholder = false;
+};
+
+/// Builds the request tail with the parameters of any call through the call method of the node
+call_template make_call( const fc::variant& api, const std::string& method, const fc::variant& params )
+{
+   call_template result;
+   result.name = ( api.is_string() ? api.as_string() : fc::json::to_string( api ) ) + "." + method;
+   result.request_tail = "\"method\":\"call\",\"params\":[" + fc::json::to_string( api ) + ","
+                         + fc::json::to_string( fc::variant( method ) ) + "," + fc::json::to_string( params ) + "]}";
+   result.has_placeholder = ( result.request_tail.find( account_placeholder ) != std::string::npos );
+   return result;
+}
+
+/// Reads a JSON array of calls with api, method, params and an optional weight
+std::vector<call_template> parse_mix( const std::string& json )
+{
+   std::vector<call_template> result;
+   for( const fc::variant& entry : fc::json::from_string( json ).get_array() )
+   {
+      const fc::variant_object& obj = entry.get_object();
+      call_template call = make_call( obj["api"], obj["method"].as_string(),
+                                      obj.contains( "params" ) ? obj["params"] : fc::variant( fc::variants() ) );
+      if( obj.contains( "weight" ) )
+         call.weight = obj["weight"].as_uint64();
+      FC_ASSERT( call.weight > 0, "The weight of ${c} must be positive", ("c",call.name) );
+      result.push_back( std::move( call ) );
+   }
+   FC_ASSERT( !result.empty(), "The mix contains no calls" );
+   return result;
+}
+
+/**
+ * Reads a call log with one JSON request per line, as sent by clients. Requests through the call method are
+ * reported by API and method, other requests by their method.
+ */
+std::vector<call_template> parse_call_log( const fc::path& file )
+{
+   std::vector<call_template> result;
+   std::ifstream in( file.generic_string() );
+   FC_ASSERT( in.good(), "Unable to open the call log ${f}", ("f",file) );
+   std::string line;
+   while( std::getline( in, line ) )
+   {
+      if( line.find_first_not_of( " \t\r" ) == std::string::npos )
+         continue;
+      const fc::variant_object request = fc::json::from_string( line ).get_object();
+      const std::string method = request["method"].as_string();
+      const fc::variant params = request.contains( "params" ) ? request["params"] : fc::variant( fc::variants() );
+      if( method == "call" )
+      {
+         const fc::variants& call_params = params.get_array();
+         FC_ASSERT( call_params.size() >= 2, "Invalid call in the call log: ${l}", ("l",line) );
+         result.push_back( make_call( call_params[0], call_params[1].as_string(),
+                                      call_params.size() > 2 ? call_params[2] : fc::variant( fc::variants() ) ) );
+      }
+      else
+      {
+         call_template call;
+         call.name = method;
+         call.request_tail = "\"method\":" + fc::json::to_string( fc::variant( method ) ) + ",\"params\":"
+                             + fc::json::to_string( params ) + "}";
+         result.push_back( std::move( call ) );
+      }
+   }
+   FC_ASSERT( !result.empty(), "The call log contains no calls" );
+   return result;
+}
+
+/**
+ * Hands out the calls to make to all connections. A mix is drawn from at random by weight, a call log is
+ * replayed in order, once or repeatedly.
+ */
+class call_source
+{
+   public:
+      call_source( std::vector<call_template> calls, bool random, bool loop, uint32_t accounts )
+      : _calls( std::move( calls ) ), _random( random ), _loop( loop ), _accounts( std::max( 1u, accounts ) )
+      {
+         uint64_t sum = 0;
+         for( const auto& call : _calls )
+         {
+            sum += call.weight;
+            _cumulative_weights.push_back( sum );
+         }
+      }
+
+      /// @return the next call, or null when a call log replayed once is exhausted
+      const call_template* next( std::mt19937_64& rng )
+      {
+         if( _random )
+         {
+            const uint64_t draw = rng() % _cumulative_weights.back();
+            const auto itr = std::upper_bound( _cumulative_weights.begin(), _cumulative_weights.end(), draw );
+            return &_calls[ itr - _cumulative_weights.begin() ];
+         }
+         const size_t index = _next++;
+         if( index >= _calls.size() && !_loop )
+            return nullptr;
+         return &_calls[ index % _calls.size() ];
+      }
+
+      bool exhausted()const { return !_random && !_loop && _next >= _calls.size(); }
+
+      /// @return the request tail of call with the placeholders replaced
+      std::string request_tail( const call_template& call, std::mt19937_64& rng )const
+      {
+         if( !call.has_placeholder )
+            return call.request_tail;
+         std::string result = call.request_tail;
+         size_t pos;
+         while( ( pos = result.find( account_placeholder ) ) != std::string::npos )
+            result.replace( pos, account_placeholder.size(), std::to_string( rng() % _accounts ) );
+         return result;
+      }
+
+   private:
+      const std::vector<call_template>        _calls;
+      const bool                              _random;
+      const bool                              _loop;
+      const uint32_t                          _accounts;
+      std::vector<uint64_t>                   _cumulative_weights;
+      std::atomic<size_t>                     _next{ 0 };
+};
+
+/// Latencies of the calls of one method
+struct method_stats
+{
+   uint64_t              errors = 0;
+   std::vector<uint32_t> latencies_us;
+};
+typedef std::map<std::string, method_stats> stats_map;
+
+/**
+ *  Keeps a number of calls in flight on each of its connections. All the work of a worker, including the message
+ *  handlers of its connections, runs in the fc thread that called start().
+ */
+class load_worker
+{
+   public:
+      load_worker( const std::string& server, uint32_t connections, uint32_t in_flight, call_source& source,
+                   uint64_t seed )
+      : _server( server ), _connections( connections ), _in_flight( in_flight ), _source( source ), _rng( seed ) {}
+
+      void start()
+      {
+         for( uint32_t i = 0; i < _connections; ++i )
+         {
+            std::unique_ptr<connection_state> state( new connection_state() );
+            state->connection = state->client.connect( _server );
+            connection_state* c = state.get();
+            state->connection->on_message_handler( [this,c]( const std::string& message ) {
+               on_message( *c, message );
+            });
+            _states.push_back( std::move( state ) );
+         }
+         for( auto& state : _states )
+            for( uint32_t i = 0; i < _in_flight; ++i )
+               send_next( *state );
+      }
+
+      /// Stops sending calls and closes the connections, the calls still in flight are not counted
+      void stop()
+      {
+         _stopped = true;
+         for( auto& state : _states )
+            state->connection->close( 1000, "done" );
+         _states.clear();
+      }
+
+      uint32_t pending()const { return _pending; }
+      const stats_map& stats()const { return _stats; }
+
+   private:
+      struct pending_call
+      {
+         method_stats*                         stats;
+         std::chrono::steady_clock::time_point start;
+      };
+      struct connection_state
+      {
+         fc::http::websocket_client            client;
+         fc::http::websocket_connection_ptr    connection;
+         std::map<uint64_t, pending_call>      calls;
+         uint64_t                              next_id = 1;
+      };
+
+      void send_next( connection_state& c )
+      {
+         if( _stopped )
+            return;
+         const call_template* call = _source.next( _rng );
+         if( call == nullptr )
+            return;
+         const uint64_t id = c.next_id++;
+         const std::string request = "{\"id\":" + std::to_string( id ) + "," + _source.request_tail( *call, _rng );
+         c.calls[id] = pending_call{ &_stats[call->name], std::chrono::steady_clock::now() };
+         ++_pending;
+         c.connection->send_message( request );
+      }
+
+      void on_message( connection_state& c, const std::string& message )
+      {
+         const auto now = std::chrono::steady_clock::now();
+         const fc::variant_object reply = fc::json::from_string( message ).get_object();
+         // notices of subscriptions have no ID
+         if( !reply.contains( "id" ) || reply["id"].is_null() )
+            return;
+         const auto itr = c.calls.find( reply["id"].as_uint64() );
+         if( itr == c.calls.end() )
+            return;
+         method_stats& stats = *itr->second.stats;
+         stats.latencies_us.push_back( static_cast<uint32_t>(
+               std::chrono::duration_cast<std::chrono::microseconds>( now - itr->second.start ).count() ) );
+         if( reply.contains( "error" ) )
+            ++stats.errors;
+         c.calls.erase( itr );
+         --_pending;
+         send_next( c );
+      }
+
+      const std::string                              _server;
+      const uint32_t                                 _connections;
+      const uint32_t                                 _in_flight;
+      call_source&                                   _source;
+      std::mt19937_64                                _rng;
+      std::vector<std::unique_ptr<connection_state>> _states;
+      stats_map                                      _stats;
+      std::atomic<uint32_t>                          _pending{ 0 };
+      bool                                           _stopped = false;
+};
+
+double percentile_ms( const std::vector<uint32_t>& sorted, double p )
+{
+   if( sorted.empty() )
+      return 0;
+   const size_t index = std::min( sorted.size() - 1, static_cast<size_t>( p * sorted.size() ) );
+   return sorted[index] / 1000.0;
+}
+
+void print_stats( const std::string& name, method_stats& stats, double seconds )
+{
+   std::sort( stats.latencies_us.begin(), stats.latencies_us.end() );
+   std::cout << std::left << std::setw(48) << name << std::right
+             << std::setw(10) << stats.latencies_us.size() << std::setw(8) << stats.errors
+             << std::setw(11) << std::fixed << std::setprecision(1) << stats.latencies_us.size() / seconds
+             << std::setprecision(3)
+             << std::setw(10) << percentile_ms( stats.latencies_us, 0.5 )
+             << std::setw(10) << percentile_ms( stats.latencies_us, 0.9 )
+             << std::setw(10) << percentile_ms( stats.latencies_us, 0.99 )
+             << std::setw(10) << percentile_ms( stats.latencies_us, 1.0 ) << "\n";
+}
+
+}
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      bpo::options_description cli_options("Generate API load on a node and report throughput and latency per method");
+      cli_options.add_options()
+            ("help,h", "Print this help message and exit.")
+            ("server,s", bpo::value<std::string>()->default_value("ws://127.0.0.1:8090"), "Websocket RPC endpoint")
+            ("connections,c", bpo::value<uint32_t>()->default_value(100), "Number of websocket connections")
+            ("in-flight", bpo::value<uint32_t>()->default_value(1),
+             "Number of calls each connection keeps waiting for a response")
+            ("threads", bpo::value<uint32_t>()->default_value( std::max( 1u, std::thread::hardware_concurrency() ) ),
+             "Number of threads handling the connections")
+            ("duration,d", bpo::value<uint32_t>()->default_value(30),
+             "Number of seconds to generate load, a call log replayed once may end earlier")
+            ("mix", bpo::value<boost::filesystem::path>(),
+             "JSON file with an array of calls to draw from at random, each with api, method, params and an "
+             "optional weight. \"${account}\" in a string parameter is replaced by a random account instance. "
+             "Without this option and --call-log, a mix of account and history calls is used")
+            ("call-log", bpo::value<boost::filesystem::path>(),
+             "File with one JSON request per line, e.g. captured from a production node, replayed in order")
+            ("loop", "Replay the call log repeatedly until the duration has passed")
+            ("accounts", bpo::value<uint32_t>()->default_value(100000),
+             "Number of account instances to draw \"${account}\" from")
+            ;
+
+      bpo::variables_map options;
+      try
+      {
+         bpo::store( bpo::parse_command_line(argc, argv, cli_options), options );
+      }
+      catch (const bpo::error& e)
+      {
+         std::cerr << "api_load:  error parsing command line: " << e.what() << "\n";
+         return 1;
+      }
+
+      if( options.count("help") )
+      {
+         std::cout << cli_options << "\n";
+         return 1;
+      }
+      if( options.count("mix") && options.count("call-log") )
+      {
+         std::cerr << "Only one of --mix and --call-log may be given\n";
+         return 1;
+      }
+
+      std::vector<call_template> calls;
+      const bool from_log = options.count("call-log") > 0;
+      if( from_log )
+         calls = parse_call_log( options["call-log"].as<boost::filesystem::path>() );
+      else if( options.count("mix") )
+      {
+         std::ifstream in( options["mix"].as<boost::filesystem::path>().generic_string() );
+         FC_ASSERT( in.good(), "Unable to open the mix file" );
+         calls = parse_mix( std::string( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() ) );
+      }
+      else
+         calls = parse_mix( default_mix );
+      call_source source( std::move( calls ), !from_log, options.count("loop") > 0,
+                          options["accounts"].as<uint32_t>() );
+
+      const std::string server = options["server"].as<std::string>();
+      const uint32_t connections = std::max( 1u, options["connections"].as<uint32_t>() );
+      const uint32_t in_flight = std::max( 1u, options["in-flight"].as<uint32_t>() );
+      const uint32_t thread_count = std::min( connections, std::max( 1u, options["threads"].as<uint32_t>() ) );
+
+      std::random_device entropy;
+      std::vector<std::unique_ptr<fc::thread>> threads;
+      std::vector<std::unique_ptr<load_worker>> workers;
+      for( uint32_t t = 0; t < thread_count; ++t )
+      {
+         const uint32_t count = connections / thread_count + ( t < connections % thread_count ? 1 : 0 );
+         threads.emplace_back( new fc::thread( "load " + std::to_string( t ) ) );
+         workers.emplace_back( new load_worker( server, count, in_flight, source,
+                                                ( uint64_t( entropy() ) << 32 ) | entropy() ) );
+      }
+      std::cout << "Opening " << connections << " connections to " << server << " in " << thread_count
+                << " threads\n";
+      for( uint32_t t = 0; t < thread_count; ++t )
+      {
+         load_worker* worker = workers[t].get();
+         threads[t]->async( [worker]() { worker->start(); } ).wait();
+      }
+
+      const auto start = std::chrono::steady_clock::now();
+      const auto end = start + std::chrono::seconds( options["duration"].as<uint32_t>() );
+      while( std::chrono::steady_clock::now() < end )
+      {
+         const auto idle = []( const std::unique_ptr<load_worker>& w ) { return w->pending() == 0; };
+         if( source.exhausted() && std::all_of( workers.begin(), workers.end(), idle ) )
+            break;
+         fc::usleep( fc::milliseconds( 100 ) );
+      }
+      for( uint32_t t = 0; t < thread_count; ++t )
+      {
+         load_worker* worker = workers[t].get();
+         threads[t]->async( [worker]() { worker->stop(); } ).wait();
+      }
+      const double seconds = std::max( 0.001, std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                 std::chrono::steady_clock::now() - start ).count() / 1000.0 );
+
+      stats_map merged;
+      method_stats total;
+      for( const auto& worker : workers )
+         for( const auto& entry : worker->stats() )
+         {
+            method_stats& stats = merged[entry.first];
+            stats.errors += entry.second.errors;
+            stats.latencies_us.insert( stats.latencies_us.end(), entry.second.latencies_us.begin(),
+                                       entry.second.latencies_us.end() );
+            total.errors += entry.second.errors;
+            total.latencies_us.insert( total.latencies_us.end(), entry.second.latencies_us.begin(),
+                                       entry.second.latencies_us.end() );
+         }
+
+      std::cout << std::left << std::setw(48) << "method" << std::right << std::setw(10) << "calls"
+                << std::setw(8) << "errors" << std::setw(11) << "calls/s" << std::setw(10) << "p50 ms"
+                << std::setw(10) << "p90 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "max ms" << "\n";
+      for( auto& entry : merged )
+         print_stats( entry.first, entry.second, seconds );
+      print_stats( "total", total, seconds );
+      return 0;
+   }
+   catch ( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   }
+}
@@ -5,6 +5,7 @@
 #include <fc/network/ip.hpp>
 #include <fc/network/resolve.hpp>
 #include <fc/thread/future.hpp>
+#include <fc/thread/thread.hpp>
 #include <fstream>
 #include <iostream>
 #include <queue>
@@ -13,6 +14,11 @@
 #include <graphene/chain/database.hpp>
 #include <graphene/net/peer_connection.hpp>
 
+/** number of peers that are probed at the same time */
+static const size_t max_concurrent_probes = 100;
+/** probes taking longer than this are given up */
+static const fc::microseconds probe_timeout = fc::seconds(30);
+
 class peer_probe : public graphene::net::peer_connection_delegate
 {
 public:
@@ -25,6 +31,17 @@ public:
   bool _connection_was_rejected;
   bool _done;
   fc::promise<void>::ptr _probe_complete_promise;
+  fc::future<void> _connect_task;
+
+  fc::time_point _start_time;
+  fc::time_point _hello_sent_time;
+  /** time until the connection was established and the keys were exchanged */
+  fc::microseconds _connect_latency;
+  /** time from sending our hello until the peer's hello arrived */
+  fc::microseconds _hello_latency;
+  std::string _user_agent;
+  uint32_t _protocol_version = 0;
+  fc::variant_object _user_data;
 
 public:
   peer_probe() :
@@ -36,22 +53,62 @@ public:
     _probe_complete_promise(fc::promise<void>::create("probe_complete"))
   {}
 
+  /** Connects and says hello in the background, the result is available once is_complete() */
   void start(const fc::ip::endpoint& endpoint_to_probe,
              const fc::ecc::private_key& my_node_id,
              const graphene::chain::chain_id_type& chain_id)
   {
     _remote = endpoint_to_probe;
-    fc::future<void> connect_task = fc::async([this](){ _connection->connect_to(_remote); }, "connect_task");
+    _start_time = fc::time_point::now();
+    _connect_task = fc::async([this, my_node_id, chain_id](){ connect_and_say_hello(my_node_id, chain_id); },
+                              "connect_task");
+  }
+
+  bool is_complete() const
+  {
+    return _probe_complete_promise->ready() || (_connect_task.valid() && _connect_task.error());
+  }
+
+  bool is_timed_out() const
+  {
+    return fc::time_point::now() - _start_time > probe_timeout;
+  }
+
+  void cancel()
+  {
+    if (_connect_task.valid() && !_connect_task.ready())
+      _connect_task.cancel(__FUNCTION__);
     try
     {
-      connect_task.wait(fc::seconds(10));
+      _connection->close_connection();
     }
-    catch (const fc::timeout_exception&)
+    catch (const fc::exception&)
     {
-      ilog("timeout connecting to node ${endpoint}", ("endpoint", endpoint_to_probe));
-      connect_task.cancel(__FUNCTION__);
-      throw;
     }
+  }
+
+  /** @return the information collected about the peer, for the log and the JSON export */
+  fc::mutable_variant_object get_report() const
+  {
+    fc::mutable_variant_object report;
+    report["endpoint"] = std::string(_remote);
+    if (_node_id.valid())
+      report["node_id"] = fc::variant(_node_id.serialize(), 1);
+    report["connection_rejected"] = _connection_was_rejected;
+    report["connect_latency_us"] = _connect_latency.count();
+    report["hello_latency_us"] = _hello_latency.count();
+    report["user_agent"] = _user_agent;
+    report["protocol_version"] = _protocol_version;
+    report["user_data"] = _user_data;
+    report["peer_count"] = _peers.size();
+    return report;
+  }
+
+  void connect_and_say_hello(const fc::ecc::private_key& my_node_id,
+                             const graphene::chain::chain_id_type& chain_id)
+  {
+    _connection->connect_to(_remote);
+    _connect_latency = fc::time_point::now() - _start_time;
 
     fc::sha256::encoder shared_secret_encoder;
     fc::sha512 shared_secret = _connection->get_shared_secret();
@@ -66,6 +123,7 @@ public:
 				  chain_id,
                                   fc::variant_object());
 
+    _hello_sent_time = fc::time_point::now();
     _connection->send_message(hello);
   }
 
@@ -104,7 +162,11 @@ public:
   void on_hello_message(graphene::net::peer_connection* originating_peer,
                         const graphene::net::hello_message& hello_message_received)
   {
+    _hello_latency = fc::time_point::now() - _hello_sent_time;
     _node_id = hello_message_received.node_public_key;
+    _user_agent = hello_message_received.user_agent;
+    _protocol_version = hello_message_received.core_protocol_version;
+    _user_data = hello_message_received.user_data;
     if (hello_message_received.user_data.contains("node_id"))
       originating_peer->node_id = hello_message_received.user_data["node_id"].as<graphene::net::node_id_t>( 1 );
     originating_peer->send_message(graphene::net::connection_rejected_message());
@@ -150,6 +212,8 @@ public:
 
   void on_connection_closed(graphene::net::peer_connection* originating_peer) override
   {
+    if (_done)
+      return;
     _done = true;
     _probe_complete_promise->set_value();
   }
@@ -165,6 +229,27 @@ public:
   }
 };
 
+static std::string node_id_to_string(const graphene::net::node_id_t& id)
+{
+  return fc::variant( id, 1 ).as_string();
+}
+
+static std::string xml_escape(const std::string& text)
+{
+  std::string result;
+  result.reserve(text.size());
+  for (char c : text)
+    switch (c)
+    {
+    case '&': result += "&amp;"; break;
+    case '<': result += "&lt;"; break;
+    case '>': result += "&gt;"; break;
+    case '"': result += "&quot;"; break;
+    default: result += c;
+    }
+  return result;
+}
+
 int main(int argc, char** argv)
 {
   std::queue<fc::ip::endpoint> nodes_to_visit;
@@ -192,82 +277,96 @@ int main(int argc, char** argv)
 
   fc::path data_dir = fc::temp_directory_path() / ("network_map_" + (fc::string) chain_id);
   fc::create_directories(data_dir);
+  std::cout << "Writing results to " << data_dir.string() << "\n";
+
+  // every finished probe is logged right away, so that partial results survive an interrupted run
+  std::ofstream probe_log((data_dir / "network_probes.log").string().c_str());
 
   fc::ip::endpoint seed_node1 = nodes_to_visit.front();
 
   fc::ecc::private_key my_node_id = fc::ecc::private_key::generate();
   std::map<graphene::net::node_id_t, graphene::net::address_info> address_info_by_node_id;
   std::map<graphene::net::node_id_t, std::vector<graphene::net::address_info> > connections_by_node_id;
+  std::map<graphene::net::node_id_t, fc::mutable_variant_object> report_by_node_id;
   std::vector<std::shared_ptr<peer_probe>> probes;
+  // the connections of given up probes may still call back into them
+  std::vector<std::shared_ptr<peer_probe>> abandoned_probes;
 
   while (!nodes_to_visit.empty() || !probes.empty())
   {
-    while (!nodes_to_visit.empty())
+    while (!nodes_to_visit.empty() && probes.size() < max_concurrent_probes)
     {
        fc::ip::endpoint remote = nodes_to_visit.front();
        nodes_to_visit.pop();
        nodes_to_visit_set.erase( remote );
        nodes_already_visited.insert( remote );
 
-       try
-       {
-          std::shared_ptr<peer_probe> probe(new peer_probe());
-          probe->start(remote, my_node_id, chain_id);
-          probes.emplace_back( std::move( probe ) );
-       }
-       catch (const fc::exception&)
-       {
-          std::cerr << "Failed to connect " << fc::string(remote) << " - skipping!" << std::endl;
-       }
+       std::shared_ptr<peer_probe> probe(new peer_probe());
+       probe->start(remote, my_node_id, chain_id);
+       probes.emplace_back( std::move( probe ) );
     }
 
-    if (!probes.empty())
-    {
-       fc::yield();
-       std::vector<std::shared_ptr<peer_probe>> running;
-       for ( auto& probe : probes ) {
-          if (probe->_probe_complete_promise->error())
-          {
-             std::cerr << fc::string(probe->_remote) << " ran into an error!\n";
-             continue;
-          }
-          if (!probe->_probe_complete_promise->ready())
+    fc::usleep( fc::milliseconds(100) );
+    const size_t probes_before = probes.size();
+    std::vector<std::shared_ptr<peer_probe>> running;
+    for ( auto& probe : probes ) {
+       if (!probe->is_complete())
+       {
+          if (!probe->is_timed_out())
           {
              running.push_back( probe );
              continue;
           }
+          probe->cancel();
+          abandoned_probes.push_back( probe );
+          fc::mutable_variant_object report = probe->get_report();
+          report["error"] = "timeout";
+          probe_log << fc::json::to_string( fc::variant( report ) ) << std::endl;
+          continue;
+       }
+       if (probe->_probe_complete_promise->error() || (probe->_connect_task.valid() && probe->_connect_task.error()))
+       {
+          std::cerr << fc::string(probe->_remote) << " ran into an error!\n";
+          abandoned_probes.push_back( probe );
+          fc::mutable_variant_object report = probe->get_report();
+          report["error"] = "connection failed";
+          probe_log << fc::json::to_string( fc::variant( report ) ) << std::endl;
+          continue;
+       }
 
-          if( probe->_node_id.valid() )
-          {
-             graphene::net::address_info this_node_info;
-             this_node_info.direction = graphene::net::peer_connection_direction::outbound;
-             this_node_info.firewalled = graphene::net::firewalled_state::not_firewalled;
-             this_node_info.remote_endpoint = probe->_remote;
-             this_node_info.node_id = probe->_node_id;
-
-             connections_by_node_id[this_node_info.node_id] = probe->_peers;
-             if (address_info_by_node_id.find(this_node_info.node_id) == address_info_by_node_id.end())
-                address_info_by_node_id[this_node_info.node_id] = this_node_info;
-          }
+       probe_log << fc::json::to_string( fc::variant( probe->get_report() ) ) << std::endl;
+       if( probe->_node_id.valid() )
+       {
+          graphene::net::address_info this_node_info;
+          this_node_info.direction = graphene::net::peer_connection_direction::outbound;
+          this_node_info.firewalled = graphene::net::firewalled_state::not_firewalled;
+          this_node_info.remote_endpoint = probe->_remote;
+          this_node_info.node_id = probe->_node_id;
+
+          connections_by_node_id[this_node_info.node_id] = probe->_peers;
+          report_by_node_id[this_node_info.node_id] = probe->get_report();
+          if (address_info_by_node_id.find(this_node_info.node_id) == address_info_by_node_id.end())
+             address_info_by_node_id[this_node_info.node_id] = this_node_info;
+       }
 
-          for (const graphene::net::address_info& info : probe->_peers)
+       for (const graphene::net::address_info& info : probe->_peers)
+       {
+          if (nodes_already_visited.find(info.remote_endpoint) == nodes_already_visited.end() &&
+              info.firewalled == graphene::net::firewalled_state::not_firewalled &&
+              nodes_to_visit_set.find(info.remote_endpoint) == nodes_to_visit_set.end())
           {
-             if (nodes_already_visited.find(info.remote_endpoint) == nodes_already_visited.end() &&
-                 info.firewalled == graphene::net::firewalled_state::not_firewalled &&
-                 nodes_to_visit_set.find(info.remote_endpoint) == nodes_to_visit_set.end())
-             {
-                nodes_to_visit.push(info.remote_endpoint);
-                nodes_to_visit_set.insert(info.remote_endpoint);
-             }
-             if (address_info_by_node_id.find(info.node_id) == address_info_by_node_id.end())
-                address_info_by_node_id[info.node_id] = info;
+             nodes_to_visit.push(info.remote_endpoint);
+             nodes_to_visit_set.insert(info.remote_endpoint);
           }
+          if (address_info_by_node_id.find(info.node_id) == address_info_by_node_id.end())
+             address_info_by_node_id[info.node_id] = info;
        }
-       probes = std::move( running );
+    }
+    probes = std::move( running );
+    if (probes.size() != probes_before)
        std::cout << address_info_by_node_id.size() << " checked, "
                  << probes.size() << " active, "
                  << nodes_to_visit.size() << " to do\n";
-    }
   }
 
   graphene::net::node_id_t seed_node_id;
@@ -314,5 +413,62 @@ int main(int argc, char** argv)
 
   dot_stream << "}\n";
 
+  // the same graph with the collected details of each node, as JSON and as GraphML
+  fc::variants json_nodes;
+  for (const auto& address_info_for_node : address_info_by_node_id)
+  {
+    fc::mutable_variant_object json_node;
+    auto report_itr = report_by_node_id.find(address_info_for_node.first);
+    if (report_itr != report_by_node_id.end())
+      json_node = report_itr->second;
+    json_node["node_id"] = node_id_to_string(address_info_for_node.first);
+    json_node["endpoint"] = std::string(address_info_for_node.second.remote_endpoint);
+    json_node["firewalled"] = address_info_for_node.second.firewalled != graphene::net::firewalled_state::not_firewalled;
+    json_node["probed"] = report_itr != report_by_node_id.end();
+    json_nodes.emplace_back(std::move(json_node));
+  }
+  fc::variants json_edges;
+  for (const auto& node_and_connections : connections_by_node_id)
+    for (const graphene::net::address_info& this_connection : node_and_connections.second)
+      json_edges.emplace_back(fc::mutable_variant_object("source", node_id_to_string(node_and_connections.first))
+                                                        ("target", node_id_to_string(this_connection.node_id)));
+  fc::json::save_to_file(fc::variant(fc::mutable_variant_object("nodes", std::move(json_nodes))("edges", std::move(json_edges))),
+                         data_dir / "network_graph.json");
+
+  std::ofstream graphml_stream((data_dir / "network_graph.graphml").string().c_str());
+  graphml_stream << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                 << "<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\">\n"
+                 << "  <key id=\"endpoint\" for=\"node\" attr.name=\"endpoint\" attr.type=\"string\"/>\n"
+                 << "  <key id=\"firewalled\" for=\"node\" attr.name=\"firewalled\" attr.type=\"boolean\"/>\n"
+                 << "  <key id=\"connect_latency_us\" for=\"node\" attr.name=\"connect_latency_us\" attr.type=\"long\"/>\n"
+                 << "  <key id=\"hello_latency_us\" for=\"node\" attr.name=\"hello_latency_us\" attr.type=\"long\"/>\n"
+                 << "  <key id=\"user_agent\" for=\"node\" attr.name=\"user_agent\" attr.type=\"string\"/>\n"
+                 << "  <key id=\"protocol_version\" for=\"node\" attr.name=\"protocol_version\" attr.type=\"long\"/>\n"
+                 << "  <graph id=\"G\" edgedefault=\"undirected\">\n";
+  for (const auto& address_info_for_node : address_info_by_node_id)
+  {
+    graphml_stream << "    <node id=\"" << node_id_to_string(address_info_for_node.first) << "\">\n"
+                   << "      <data key=\"endpoint\">" << xml_escape(std::string(address_info_for_node.second.remote_endpoint)) << "</data>\n"
+                   << "      <data key=\"firewalled\">"
+                   << (address_info_for_node.second.firewalled != graphene::net::firewalled_state::not_firewalled ? "true" : "false")
+                   << "</data>\n";
+    auto report_itr = report_by_node_id.find(address_info_for_node.first);
+    if (report_itr != report_by_node_id.end())
+    {
+      const fc::mutable_variant_object& report = report_itr->second;
+      graphml_stream << "      <data key=\"connect_latency_us\">" << report["connect_latency_us"].as_int64() << "</data>\n"
+                     << "      <data key=\"hello_latency_us\">" << report["hello_latency_us"].as_int64() << "</data>\n"
+                     << "      <data key=\"user_agent\">" << xml_escape(report["user_agent"].as_string()) << "</data>\n"
+                     << "      <data key=\"protocol_version\">" << report["protocol_version"].as_uint64() << "</data>\n";
+    }
+    graphml_stream << "    </node>\n";
+  }
+  for (const auto& node_and_connections : connections_by_node_id)
+    for (const graphene::net::address_info& this_connection : node_and_connections.second)
+      graphml_stream << "    <edge source=\"" << node_id_to_string(node_and_connections.first)
+                     << "\" target=\"" << node_id_to_string(this_connection.node_id) << "\"/>\n";
+  graphml_stream << "  </graph>\n"
+                 << "</graphml>\n";
+
   return 0;
 }
@@ -30,16 +30,42 @@
 #include <graphene/protocol/block.hpp>
 #include <graphene/protocol/fee_schedule.hpp>
 
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
 #include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <map>
 #include <sstream>
 #include <string>
 #include <vector>
 
 using namespace graphene::protocol;
+namespace bpo = boost::program_options;
 
 vector< fc::variant_object > g_op_types;
 
+/** Mean time of one conversion of a sample, in nanoseconds */
+struct serialization_timing
+{
+   std::string name;
+   uint64_t    wire_size = 0;
+   uint64_t    json_size = 0;
+   double      pack_ns = 0;
+   double      unpack_ns = 0;
+   double      to_variant_ns = 0;
+   double      from_variant_ns = 0;
+   double      to_json_ns = 0;
+   double      from_json_ns = 0;
+};
+
+FC_REFLECT( serialization_timing,
+            (name)(wire_size)(json_size)(pack_ns)(unpack_ns)(to_variant_ns)(from_variant_ns)(to_json_ns)(from_json_ns) )
+
+/// Keeps the results of the timed conversions alive, so that the compiler can not drop them
+volatile uint64_t g_sink = 0;
+
 template< typename T >
 uint64_t get_wire_size()
 {
@@ -65,12 +91,231 @@ struct size_check_type_visitor
    }
 };
 
+template< typename Func >
+double time_per_iteration( uint32_t iterations, Func&& f )
+{
+   const auto start = std::chrono::steady_clock::now();
+   for( uint32_t i = 0; i < iterations; ++i )
+      f();
+   const auto elapsed = std::chrono::steady_clock::now() - start;
+   return std::chrono::duration<double, std::nano>( elapsed ).count() / iterations;
+}
+
+/** Times binary, variant and JSON conversions of sample in both directions */
+template< typename T >
+serialization_timing measure_serialization( const std::string& name, const T& sample, uint32_t iterations )
+{
+   serialization_timing result;
+   result.name = name;
+
+   const std::vector<char> packed = fc::raw::pack( sample );
+   const fc::variant var( sample, GRAPHENE_MAX_NESTED_OBJECTS );
+   const std::string json = fc::json::to_string( var );
+   result.wire_size = packed.size();
+   result.json_size = json.size();
+
+   result.pack_ns = time_per_iteration( iterations, [&]() {
+      g_sink += fc::raw::pack( sample ).size();
+   });
+   result.unpack_ns = time_per_iteration( iterations, [&]() {
+      T copy;
+      fc::raw::unpack( packed, copy, GRAPHENE_MAX_NESTED_OBJECTS );
+   });
+   result.to_variant_ns = time_per_iteration( iterations, [&]() {
+      fc::variant v;
+      fc::to_variant( sample, v, GRAPHENE_MAX_NESTED_OBJECTS );
+      g_sink += v.get_type();
+   });
+   result.from_variant_ns = time_per_iteration( iterations, [&]() {
+      T copy;
+      fc::from_variant( var, copy, GRAPHENE_MAX_NESTED_OBJECTS );
+   });
+   result.to_json_ns = time_per_iteration( iterations, [&]() {
+      g_sink += fc::json::to_string( var ).size();
+   });
+   result.from_json_ns = time_per_iteration( iterations, [&]() {
+      g_sink += fc::json::from_string( json ).get_type();
+   });
+   return result;
+}
+
+struct serialization_benchmark_visitor
+{
+   typedef void result_type;
+
+   const operation& op;
+   uint32_t iterations;
+   vector< serialization_timing >& results;
+
+   template<typename Type>
+   result_type operator()( const Type& )const
+   {
+      // The operation is measured as part of the static_variant, like it is serialized in a transaction
+      results.push_back( measure_serialization( fc::get_typename<Type>::name(), op, iterations ) );
+   }
+};
+
+/** A block full of transfers with memos, close to what the P2P network and the API handle most */
+signed_block make_sample_block( uint32_t transaction_count )
+{
+   const auto from_key = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string("from") ) );
+   const auto to_key = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string("to") ) );
+
+   signed_block block;
+   block.previous = block_id_type( "00000001aabbccddeeff00112233445566778899" );
+   block.timestamp = fc::time_point_sec( 1500000000 );
+   block.witness = witness_id_type( 1 );
+   block.transactions.reserve( transaction_count );
+   for( uint32_t i = 0; i < transaction_count; ++i )
+   {
+      transfer_operation transfer;
+      transfer.fee = asset( 20000 );
+      transfer.from = account_id_type( 100 + i );
+      transfer.to = account_id_type( 200 + i );
+      transfer.amount = asset( 1000 + i );
+      transfer.memo = memo_data();
+      transfer.memo->from = from_key.get_public_key();
+      transfer.memo->to = to_key.get_public_key();
+      transfer.memo->nonce = i;
+      transfer.memo->message.resize( 64, char(i) );
+
+      signed_transaction trx;
+      trx.ref_block_num = 1;
+      trx.ref_block_prefix = i;
+      trx.expiration = block.timestamp + 30;
+      trx.operations.push_back( transfer );
+      trx.signatures.resize( 1 );
+
+      processed_transaction ptrx( trx );
+      ptrx.operation_results.push_back( void_result() );
+      block.transactions.push_back( std::move( ptrx ) );
+   }
+   block.transaction_merkle_root = block.calculate_merkle_root();
+   return block;
+}
+
+/** Prints the metrics of current that are slower than in baseline by more than threshold percent */
+uint32_t report_regressions( const vector< serialization_timing >& current,
+                             const vector< serialization_timing >& baseline, double threshold )
+{
+   std::map< std::string, const serialization_timing* > by_name;
+   for( const auto& timing : baseline )
+      by_name[timing.name] = &timing;
+
+   uint32_t regressions = 0;
+   auto check = [&]( const std::string& name, const char* metric, double now, double before ) {
+      if( before <= 0 || now <= before * ( 1 + threshold / 100 ) )
+         return;
+      ++regressions;
+      std::cerr << "Regression: " << name << " " << metric << " " << before << " ns -> " << now << " ns (+"
+                << ( now / before - 1 ) * 100 << "%)\n";
+   };
+   for( const auto& timing : current )
+   {
+      auto itr = by_name.find( timing.name );
+      if( itr == by_name.end() )
+         continue;
+      const serialization_timing& before = *itr->second;
+      check( timing.name, "pack", timing.pack_ns, before.pack_ns );
+      check( timing.name, "unpack", timing.unpack_ns, before.unpack_ns );
+      check( timing.name, "to_variant", timing.to_variant_ns, before.to_variant_ns );
+      check( timing.name, "from_variant", timing.from_variant_ns, before.from_variant_ns );
+      check( timing.name, "to_json", timing.to_json_ns, before.to_json_ns );
+      check( timing.name, "from_json", timing.from_json_ns, before.from_json_ns );
+   }
+   return regressions;
+}
+
+int run_benchmark( const bpo::variables_map& options )
+{
+   const uint32_t iterations = std::max( 1u, options["iterations"].as<uint32_t>() );
+   const uint32_t block_iterations = std::max( 1u, options["block-iterations"].as<uint32_t>() );
+
+   vector< serialization_timing > results;
+   operation op;
+   for( int32_t i = 0; i < op.count(); ++i )
+   {
+      op.set_which(i);
+      op.visit( serialization_benchmark_visitor{ op, iterations, results } );
+   }
+   results.push_back( measure_serialization( "signed_block",
+                                             make_sample_block( options["block-transactions"].as<uint32_t>() ),
+                                             block_iterations ) );
+
+   std::cout << "[\n";
+   for( size_t i = 0; i < results.size(); i++ )
+   {
+      std::cout << "   " << fc::json::to_string( fc::variant( results[i], 2 ) );
+      if( i < results.size()-1 )
+         std::cout << ",\n";
+      else
+         std::cout << "\n";
+   }
+   std::cout << "]\n";
+
+   const auto& block = results.back();
+   std::cerr << "Block of " << block.wire_size << " bytes: pack " << block.wire_size * 1000 / block.pack_ns
+             << " MB/s, unpack " << block.wire_size * 1000 / block.unpack_ns << " MB/s\n";
+
+   if( options.count("output") )
+      fc::json::save_to_file( results, options["output"].as<boost::filesystem::path>() );
+
+   if( options.count("baseline") )
+   {
+      const auto baseline = fc::json::from_file( options["baseline"].as<boost::filesystem::path>() )
+                               .as< vector< serialization_timing > >( 3 );
+      const uint32_t regressions = report_regressions( results, baseline, options["max-regression"].as<double>() );
+      if( regressions > 0 )
+      {
+         std::cerr << regressions << " measurements are slower than the baseline\n";
+         return 2;
+      }
+   }
+   return 0;
+}
+
 int main( int argc, char** argv )
 {
    try
    {
-      graphene::protocol::operation op;
+      bpo::options_description cli_options("Print the sizes of the operations, or benchmark their serialization");
+      cli_options.add_options()
+            ("help,h", "Print this help message and exit.")
+            ("benchmark,b", "Time binary, variant and JSON serialization of every operation type and of a block")
+            ("iterations", bpo::value<uint32_t>()->default_value(10000),
+             "Number of conversions timed per operation type")
+            ("block-transactions", bpo::value<uint32_t>()->default_value(1000),
+             "Number of transactions in the sample block")
+            ("block-iterations", bpo::value<uint32_t>()->default_value(20),
+             "Number of conversions timed for the sample block")
+            ("output,o", bpo::value<boost::filesystem::path>(), "File to save the benchmark results to, as JSON")
+            ("baseline", bpo::value<boost::filesystem::path>(),
+             "Results of an earlier benchmark to compare with, exits with 2 if there is a regression")
+            ("max-regression", bpo::value<double>()->default_value(10),
+             "Slowdown against the baseline that is reported as a regression, in percent")
+            ;
+
+      bpo::variables_map options;
+      try
+      {
+         bpo::store( bpo::parse_command_line(argc, argv, cli_options), options );
+      }
+      catch (const bpo::error& e)
+      {
+         std::cerr << "size_checker:  error parsing command line: " << e.what() << "\n";
+         return 1;
+      }
+
+      if( options.count("help") )
+      {
+         std::cout << cli_options << "\n";
+         return 1;
+      }
 
+      if( options.count("benchmark") )
+         return run_benchmark( options );
+
+      graphene::protocol::operation op;
 
       vector<uint64_t> witnesses; witnesses.resize(50);
       for( uint32_t i = 0; i < 60*60*24*30; ++i )
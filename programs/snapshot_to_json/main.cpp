@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/snapshot/snapshot.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include <iostream>
+
+namespace bpo = boost::program_options;
+
+/**
+ * Converts a binary snapshot written by the snapshot plugin with snapshot-format=binary, or by
+ * database::save_snapshot, into the JSON format of snapshot-format=json.
+ */
+int main( int argc, char** argv )
+{
+   try
+   {
+      bpo::options_description cli_options("Convert a binary snapshot to JSON");
+      cli_options.add_options()
+            ("help,h", "Print this help message and exit.")
+            ("snapshot,s", bpo::value<boost::filesystem::path>(), "Directory of the binary snapshot to read")
+            ("out,o", bpo::value<boost::filesystem::path>(), "File to write the JSON snapshot to")
+            ;
+
+      bpo::variables_map options;
+      try
+      {
+         bpo::store( bpo::parse_command_line(argc, argv, cli_options), options );
+      }
+      catch (const bpo::error& e)
+      {
+         std::cerr << "snapshot_to_json:  error parsing command line: " << e.what() << "\n";
+         return 1;
+      }
+
+      if( options.count("help") )
+      {
+         std::cout << cli_options << "\n";
+         return 1;
+      }
+
+      if( !options.count( "snapshot" ) || !options.count( "out" ) )
+      {
+         std::cerr << "--snapshot and --out options are required\n";
+         return 1;
+      }
+
+      const fc::path snapshot_dir = options["snapshot"].as<boost::filesystem::path>();
+      const fc::path info_file = snapshot_dir / "snapshot_info";
+      FC_ASSERT( fc::exists( info_file ), "${f} not found, the snapshot is incomplete", ("f",info_file) );
+      std::string info_data;
+      fc::read_file_contents( info_file, info_data );
+      const auto info = fc::raw::unpack<graphene::chain::snapshot_info>(
+                           std::vector<char>( info_data.begin(), info_data.end() ) );
+      std::cerr << "snapshot_to_json:  Reading snapshot of block " << info.head_block.block_num()
+                << " of chain " << info.chain_id.str() << ", database version " << info.db_version << "\n";
+
+      // Only the index files are opened, the chain itself is not
+      graphene::chain::database db;
+      db.graphene::db::object_database::open( snapshot_dir );
+      graphene::snapshot_plugin::write_json_snapshot( db, options["out"].as<boost::filesystem::path>() );
+   }
+   catch ( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   }
+   return 0;
+}
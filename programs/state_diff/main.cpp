@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/api.hpp>
+#include <graphene/chain/database.hpp>
+
+#include <fc/network/http/websocket.hpp>
+#include <fc/rpc/websocket_api.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include <iostream>
+
+namespace bpo = boost::program_options;
+using graphene::db::object_range_digest;
+
+/** A state to compare, either a binary snapshot or a running node */
+class state_source
+{
+   public:
+      virtual ~state_source() {}
+      virtual std::string name()const = 0;
+      /** @see graphene::db::index::digest_ranges */
+      virtual std::vector<object_range_digest> digests( uint8_t space, uint8_t type, uint64_t first, uint64_t last,
+                                                        uint32_t parts ) = 0;
+};
+
+/** The object database of a binary snapshot, opened into a database that is not used otherwise */
+class snapshot_source : public state_source
+{
+   public:
+      explicit snapshot_source( const fc::path& dir ) : _dir( dir )
+      {
+         _db.graphene::db::object_database::open( dir );
+      }
+
+      std::string name()const override { return _dir.generic_string(); }
+
+      std::vector<object_range_digest> digests( uint8_t space, uint8_t type, uint64_t first, uint64_t last,
+                                                uint32_t parts ) override
+      {
+         return _db.get_index( space, type ).digest_ranges( first, last, parts );
+      }
+
+   private:
+      fc::path                 _dir;
+      graphene::chain::database _db;
+};
+
+/** The head block state of a node, through database_api::get_object_digests */
+class node_source : public state_source
+{
+   public:
+      node_source( const std::string& url, const std::string& user, const std::string& password ) : _url( url )
+      {
+         _connection = _client.connect( url );
+         _api_connection = std::make_shared<fc::rpc::websocket_api_connection>( _connection,
+                                                                                GRAPHENE_MAX_NESTED_OBJECTS );
+         auto login = _api_connection->get_remote_api< graphene::app::login_api >( 1 );
+         FC_ASSERT( login->login( user, password ), "Failed to log in to ${u}", ("u",url) );
+         _db_api = login->database();
+         std::cerr << "state_diff:  " << url << " is at block "
+                   << _db_api->get_dynamic_global_properties().head_block_number << "\n";
+      }
+
+      std::string name()const override { return _url; }
+
+      std::vector<object_range_digest> digests( uint8_t space, uint8_t type, uint64_t first, uint64_t last,
+                                                uint32_t parts ) override
+      {
+         return _db_api->get_object_digests( space, type, first, last, parts );
+      }
+
+   private:
+      std::string                                        _url;
+      fc::http::websocket_client                         _client;
+      fc::http::websocket_connection_ptr                 _connection;
+      std::shared_ptr<fc::rpc::websocket_api_connection> _api_connection;
+      fc::api<graphene::app::database_api>               _db_api;
+};
+
+/** Descends into the ranges whose digests differ between two sources and prints the smallest ones */
+class state_comparer
+{
+   public:
+      state_comparer( state_source& a, state_source& b, uint32_t fanout, uint64_t leaf_size, uint32_t max_ranges )
+         : _a( a ), _b( b ), _fanout( fanout ), _leaf_size( leaf_size ), _max_ranges( max_ranges ) {}
+
+      /** @return false if the index differs */
+      bool compare_index( uint8_t space, uint8_t type )
+      {
+         // the whole index first, this also tells the end of the range of each side
+         const auto a = _a.digests( space, type, 0, 0, 1 );
+         const auto b = _b.digests( space, type, 0, 0, 1 );
+         const uint64_t end = std::max( a.empty() ? 0 : a.front().last, b.empty() ? 0 : b.front().last );
+         if( a.size() == b.size() && ( a.empty() || same( a.front(), b.front() ) ) )
+            return true;
+         std::cout << int(space) << "." << int(type) << " differs\n";
+         compare_range( space, type, 0, end );
+         return false;
+      }
+
+   private:
+      static bool same( const object_range_digest& a, const object_range_digest& b )
+      {
+         return a.first == b.first && a.last == b.last && a.count == b.count && a.digest == b.digest;
+      }
+
+      void compare_range( uint8_t space, uint8_t type, uint64_t first, uint64_t last )
+      {
+         if( _reported >= _max_ranges )
+            return;
+         if( last - first <= _leaf_size )
+         {
+            report( space, type, first, last );
+            return;
+         }
+         const auto a = _a.digests( space, type, first, last, _fanout );
+         const auto b = _b.digests( space, type, first, last, _fanout );
+         FC_ASSERT( a.size() == b.size(), "The sources split ${s}.${t}.${f}-${l} differently",
+                    ("s",space)("t",type)("f",first)("l",last) );
+         for( size_t i = 0; i < a.size() && _reported < _max_ranges; ++i )
+            if( !same( a[i], b[i] ) )
+               compare_range( space, type, a[i].first, a[i].last );
+      }
+
+      void report( uint8_t space, uint8_t type, uint64_t first, uint64_t last )
+      {
+         const auto a = _a.digests( space, type, first, last, 1 );
+         const auto b = _b.digests( space, type, first, last, 1 );
+         std::cout << "   " << int(space) << "." << int(type) << "." << first;
+         if( last - first > 1 )
+            std::cout << " - " << int(space) << "." << int(type) << "." << ( last - 1 );
+         std::cout << ": " << ( a.empty() ? 0 : a.front().count ) << " objects in " << _a.name()
+                   << ", " << ( b.empty() ? 0 : b.front().count ) << " in " << _b.name() << "\n";
+         if( ++_reported == _max_ranges )
+            std::cout << "   ...\n";
+      }
+
+      state_source& _a;
+      state_source& _b;
+      uint32_t      _fanout;
+      uint64_t      _leaf_size;
+      uint32_t      _max_ranges;
+      uint32_t      _reported = 0;
+};
+
+/**
+ * Compares the object database state of two binary snapshots, two nodes, or a snapshot and a node, and prints the
+ * indexes and ranges of object IDs in which they differ.
+ */
+int main( int argc, char** argv )
+{
+   try
+   {
+      bpo::options_description cli_options("Compare the state of two snapshots or nodes");
+      cli_options.add_options()
+            ("help,h", "Print this help message and exit.")
+            ("snapshot,s", bpo::value<std::vector<boost::filesystem::path>>()->composing(),
+             "Directory of a binary snapshot to compare, can be given twice")
+            ("node,n", bpo::value<std::vector<std::string>>()->composing(),
+             "Websocket URL of a node to compare, can be given twice. The node must allow the range with "
+             "api-limit-get-object-digests")
+            ("user,u", bpo::value<std::string>()->default_value(""), "User name to log in to the nodes")
+            ("password,p", bpo::value<std::string>()->default_value(""), "Password to log in to the nodes")
+            ("fanout", bpo::value<uint32_t>()->default_value(16), "Number of parts each differing range is split into")
+            ("leaf-size", bpo::value<uint64_t>()->default_value(1),
+             "Size of the ranges that are reported instead of being split further")
+            ("max-ranges", bpo::value<uint32_t>()->default_value(100), "Maximum number of differing ranges to report")
+            ;
+
+      bpo::variables_map options;
+      try
+      {
+         bpo::store( bpo::parse_command_line(argc, argv, cli_options), options );
+      }
+      catch (const bpo::error& e)
+      {
+         std::cerr << "state_diff:  error parsing command line: " << e.what() << "\n";
+         return 1;
+      }
+
+      if( options.count("help") )
+      {
+         std::cout << cli_options << "\n";
+         return 1;
+      }
+
+      std::vector<std::unique_ptr<state_source>> sources;
+      if( options.count("snapshot") )
+         for( const auto& dir : options["snapshot"].as<std::vector<boost::filesystem::path>>() )
+            sources.emplace_back( new snapshot_source( dir ) );
+      if( options.count("node") )
+         for( const auto& url : options["node"].as<std::vector<std::string>>() )
+            sources.emplace_back( new node_source( url, options["user"].as<std::string>(),
+                                                   options["password"].as<std::string>() ) );
+      if( sources.size() != 2 )
+      {
+         std::cerr << "Exactly two --snapshot or --node options are required\n";
+         return 1;
+      }
+
+      const uint32_t fanout = std::min( std::max( options["fanout"].as<uint32_t>(), 2u ), 256u );
+      const uint64_t leaf_size = std::max<uint64_t>( options["leaf-size"].as<uint64_t>(), 1 );
+      state_comparer comparer( *sources[0], *sources[1], fanout, leaf_size, options["max-ranges"].as<uint32_t>() );
+
+      // the indexes a node of this version has
+      graphene::chain::database schema;
+      bool equal = true;
+      for( uint32_t space = 0; space < 256; ++space )
+         for( uint32_t type = 0; type < 256; ++type )
+         {
+            try
+            {
+               schema.get_index( (uint8_t)space, (uint8_t)type );
+            }
+            catch( fc::assert_exception& e )
+            {
+               continue;
+            }
+            if( !comparer.compare_index( (uint8_t)space, (uint8_t)type ) )
+               equal = false;
+         }
+      if( equal )
+         std::cout << "The states are equal\n";
+      return equal ? 0 : 2;
+   }
+   catch ( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   }
+}
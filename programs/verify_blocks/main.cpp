@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/block_database.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace bpo = boost::program_options;
+using graphene::chain::block_database;
+using graphene::protocol::block_id_type;
+using graphene::protocol::signed_block;
+
+/**
+ *  Checks consecutive blocks of a block database in parallel. Worker threads claim batches of block numbers,
+ *  the lowest failing block number found so far is shared so that batches behind it are not checked anymore.
+ */
+class block_verifier
+{
+   public:
+      /** @param first_available number of the oldest stored block, the link of older blocks is not checked */
+      block_verifier( const block_database& blocks, uint32_t first_available, uint32_t first, uint32_t last,
+                      uint32_t batch_size )
+      : _blocks( blocks ), _first_available( first_available ), _first( first ), _last( last ),
+        _batch_size( batch_size ), _next( first ), _failed_at( last + 1 ) {}
+
+      void run( uint32_t threads )
+      {
+         std::vector<std::thread> workers;
+         workers.reserve( threads );
+         for( uint32_t i = 0; i < threads; ++i )
+            workers.emplace_back( [this]() { work(); } );
+         for( auto& worker : workers )
+            worker.join();
+      }
+
+      bool     failed()const         { return _failed_at <= _last; }
+      uint32_t failed_at()const      { return _failed_at; }
+      const std::string& reason()const { return _reason; }
+      uint32_t verified()const       { return _verified; }
+
+   private:
+      void work()
+      {
+         while( true )
+         {
+            const uint32_t start = _next.fetch_add( _batch_size );
+            if( start > _last || start >= _failed_at || start < _first ) // the last check catches overflow
+               return;
+            const uint32_t end = std::min<uint64_t>( uint64_t(start) + _batch_size - 1, _last );
+            block_id_type previous_id; // block 1 links to the empty ID
+            bool have_previous = ( start == 1 );
+            if( start > _first_available )
+            {
+               try
+               {
+                  previous_id = _blocks.fetch_block_id( start - 1 );
+                  have_previous = true;
+               }
+               catch( const fc::exception& )
+               {
+                  // the block before is reported by the thread verifying it
+               }
+            }
+            for( uint32_t num = start; num <= end && num < _failed_at; ++num )
+            {
+               block_id_type id;
+               std::string error = verify( num, have_previous ? &previous_id : nullptr, id );
+               if( !error.empty() )
+               {
+                  fail( num, error );
+                  return;
+               }
+               previous_id = id;
+               have_previous = true;
+               ++_verified;
+            }
+         }
+      }
+
+      /**
+       *  @param expected_previous the ID block num has to link to, nullptr if it is unknown
+       *  @param id set to the ID of the block
+       *  @return a description of what is wrong with the block, empty if it is fine
+       */
+      std::string verify( uint32_t num, const block_id_type* expected_previous, block_id_type& id )const
+      {
+         fc::optional<signed_block> block;
+         try
+         {
+            block = _blocks.fetch_by_number( num );
+         }
+         catch( const fc::exception& e )
+         {
+            return "block can not be read: " + e.to_string();
+         }
+         if( !block )
+            return "block is missing";
+         if( block->block_num() != num )
+            return "block has number " + std::to_string( block->block_num() );
+         if( expected_previous != nullptr && block->previous != *expected_previous )
+            return "previous ID " + block->previous.str() + " does not match " + expected_previous->str();
+         id = block->id();
+         if( block->calculate_merkle_root() != block->transaction_merkle_root )
+            return "transaction merkle root does not match the transactions";
+         try
+         {
+            block->signee();
+         }
+         catch( const fc::exception& e )
+         {
+            return "signing key can not be recovered: " + e.to_string();
+         }
+         return std::string();
+      }
+
+      void fail( uint32_t num, const std::string& reason )
+      {
+         std::lock_guard<std::mutex> guard( _failure_mutex );
+         if( num < _failed_at )
+         {
+            _failed_at = num;
+            _reason = reason;
+         }
+      }
+
+      const block_database& _blocks;
+      const uint32_t        _first_available;
+      const uint32_t        _first;
+      const uint32_t        _last;
+      const uint32_t        _batch_size;
+      std::atomic<uint32_t> _next;
+      std::atomic<uint32_t> _failed_at;
+      std::atomic<uint32_t> _verified{0};
+      std::mutex            _failure_mutex;
+      std::string           _reason;
+};
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      bpo::options_description cli_options("Verify the blocks stored by a node");
+      cli_options.add_options()
+            ("help,h", "Print this help message and exit.")
+            ("blocks-dir,d", bpo::value<boost::filesystem::path>(),
+             "Block database directory, i.e. blockchain/database/block_num_to_block in the data directory")
+            ("first", bpo::value<uint32_t>()->default_value(0),
+             "Number of the first block to verify, 0 for the oldest stored block")
+            ("last", bpo::value<uint32_t>()->default_value(0),
+             "Number of the last block to verify, 0 for the newest stored block")
+            ("threads", bpo::value<uint32_t>()->default_value( std::max( 1u, std::thread::hardware_concurrency() ) ),
+             "Number of threads verifying blocks")
+            ("batch-size", bpo::value<uint32_t>()->default_value(1000),
+             "Number of consecutive blocks a thread verifies at once")
+            ;
+
+      bpo::variables_map options;
+      try
+      {
+         bpo::store( bpo::parse_command_line(argc, argv, cli_options), options );
+      }
+      catch (const bpo::error& e)
+      {
+         std::cerr << "verify_blocks:  error parsing command line: " << e.what() << "\n";
+         return 1;
+      }
+
+      if( options.count("help") )
+      {
+         std::cout << cli_options << "\n";
+         return 1;
+      }
+      if( !options.count("blocks-dir") )
+      {
+         std::cerr << "The --blocks-dir option is required\n";
+         return 1;
+      }
+      const fc::path dir = options["blocks-dir"].as<boost::filesystem::path>();
+      if( !fc::exists( dir ) )
+      {
+         std::cerr << "Block database directory " << dir.generic_string() << " does not exist\n";
+         return 1;
+      }
+
+      block_database blocks;
+      blocks.open( dir );
+      const auto last_id = blocks.last_id();
+      if( !last_id )
+      {
+         std::cout << "The block database is empty\n";
+         return 0;
+      }
+      const uint32_t first_available = std::max( 1u, blocks.first_available_block_num() );
+      const uint32_t first = std::max( first_available, options["first"].as<uint32_t>() );
+      uint32_t last = graphene::protocol::block_header::num_from_id( *last_id );
+      if( options["last"].as<uint32_t>() > 0 )
+         last = std::min( last, options["last"].as<uint32_t>() );
+      if( first > last )
+      {
+         std::cerr << "No stored blocks between #" << first << " and #" << last << "\n";
+         return 1;
+      }
+
+      block_verifier verifier( blocks, first_available, first, last, std::max( 1u, options["batch-size"].as<uint32_t>() ) );
+      verifier.run( std::max( 1u, options["threads"].as<uint32_t>() ) );
+      if( verifier.failed() )
+      {
+         std::cout << "Block #" << verifier.failed_at() << ": " << verifier.reason() << "\n";
+         return 2;
+      }
+      std::cout << "Verified " << verifier.verified() << " blocks from #" << first << " to #" << last << "\n";
+      return 0;
+   }
+   catch ( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   }
+}
@@ -26,10 +26,14 @@
 #include <graphene/utilities/tempdir.hpp>
 
 #include <fc/crypto/digest.hpp>
+#include <fc/io/json.hpp>
 
 #include <boost/test/auto_unit_test.hpp>
 
+#include "../common/env_util.hpp"
+
 using namespace graphene::chain;
+using namespace graphene::chain::test;
 
 BOOST_AUTO_TEST_CASE( operation_sanity_check )
 {
@@ -51,11 +55,11 @@ BOOST_AUTO_TEST_CASE( genesis_and_persistence_bench )
 
 #ifdef NDEBUG
       ilog("Running in release mode.");
-      const int account_count = 2000000;
+      const int account_count = env_or_default( "GRAPHENE_BENCH_ACCOUNTS", 2000000 );
       const int blocks_to_produce = 1000000;
 #else
       ilog("Running in debug mode.");
-      const int account_count = 30000;
+      const int account_count = env_or_default( "GRAPHENE_BENCH_ACCOUNTS", 30000 );
       const int blocks_to_produce = 1000;
 #endif
 
@@ -63,6 +67,16 @@ BOOST_AUTO_TEST_CASE( genesis_and_persistence_bench )
          genesis_state.initial_accounts.emplace_back("target"+fc::to_string(i),
                                                      public_key_type(fc::ecc::private_key::regenerate(fc::digest(i)).get_public_key()));
 
+      {
+         // load the genesis state the way the node loads a genesis file
+         std::string genesis_json = fc::json::to_string( genesis_state );
+         fc::time_point start_time = fc::time_point::now();
+         genesis_state = load_genesis_state( genesis_json, 20 );
+         ilog("Loaded genesis state of ${c} accounts in ${t} milliseconds.",
+              ("c", account_count)("t", (fc::time_point::now() - start_time).count() / 1000));
+         BOOST_CHECK_EQUAL( account_count, genesis_state.initial_accounts.size() );
+      }
+
       fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
 
       {
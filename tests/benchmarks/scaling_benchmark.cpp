@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/database.hpp>
+
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/market_object.hpp>
+
+#include <fc/io/json.hpp>
+
+#include "../common/database_fixture.hpp"
+#include "../common/env_util.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+namespace {
+
+   int64_t elapsed_us( const fc::time_point& start )
+   {
+      return ( fc::time_point::now() - start ).count();
+   }
+
+}
+
+/**
+ * Builds a chain with a configurable number of accounts, assets and open orders, all of them created
+ * in blocks, then measures the time to apply blocks of transfers, the time of a chain maintenance,
+ * the memory used by each index and the throughput of a replay of the whole chain.
+ *
+ * Sizes are taken from the environment:
+ * GRAPHENE_BENCH_ACCOUNTS, GRAPHENE_BENCH_ASSETS, GRAPHENE_BENCH_ORDERS, GRAPHENE_BENCH_BLOCKS and
+ * GRAPHENE_BENCH_TRX_PER_BLOCK. The results are printed as JSON, or written to the file named by
+ * GRAPHENE_BENCH_OUTPUT.
+ */
+BOOST_FIXTURE_TEST_CASE( scaling_benchmark, database_fixture )
+{ try {
+   const uint32_t account_count = std::max<uint64_t>( env_or_default( "GRAPHENE_BENCH_ACCOUNTS", 10000 ), 2 );
+   const uint32_t asset_count   = env_or_default( "GRAPHENE_BENCH_ASSETS", 100 );
+   const uint32_t order_count   = asset_count > 0 ? env_or_default( "GRAPHENE_BENCH_ORDERS", 10000 ) : 0;
+   const uint32_t block_count   = env_or_default( "GRAPHENE_BENCH_BLOCKS", 10 );
+   const uint32_t trx_per_block = env_or_default( "GRAPHENE_BENCH_TRX_PER_BLOCK", 1000 );
+   const char* output_file = std::getenv( "GRAPHENE_BENCH_OUTPUT" );
+
+   // Setup transactions are pushed without checks and put into blocks of this many
+   const uint32_t setup_trx_per_block = 2000;
+   const fc::ecc::private_key key = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string("scaling") ) );
+   const public_key_type pub_key = key.get_public_key();
+   uint64_t transaction_count = 0;
+   uint32_t pending_count = 0;
+
+   const auto push_op = [&]( operation op ) {
+      signed_transaction tx;
+      tx.operations.push_back( std::move( op ) );
+      db.current_fee_schedule().set_fee( tx.operations.back() );
+      set_expiration( db, tx );
+      auto result = db.push_transaction( tx, ~0 );
+      ++transaction_count;
+      if( ++pending_count == setup_trx_per_block )
+      {
+         generate_block();
+         pending_count = 0;
+      }
+      return result.operation_results[0].get<object_id_type>();
+   };
+
+   const auto setup_start = fc::time_point::now();
+
+   vector<account_id_type> accounts;
+   accounts.reserve( account_count );
+   {
+      account_create_operation op;
+      op.registrar = account_id_type();
+      op.owner = authority( 1, pub_key, 1 );
+      op.active = authority( 1, pub_key, 1 );
+      op.options.memo_key = pub_key;
+      op.options.voting_account = GRAPHENE_PROXY_TO_SELF_ACCOUNT;
+      for( uint32_t i = 0; i < account_count; ++i )
+      {
+         op.name = "scale" + std::to_string( i );
+         accounts.emplace_back( push_op( op ) );
+      }
+   }
+   {
+      transfer_operation op;
+      op.from = account_id_type();
+      op.amount = asset( 10000000 );
+      for( const auto& account : accounts )
+      {
+         op.to = account;
+         push_op( op );
+      }
+   }
+
+   vector<asset_id_type> assets;
+   assets.reserve( asset_count );
+   {
+      asset_create_operation op;
+      op.common_options.core_exchange_rate = asset( 1 ) / asset( 1, asset_id_type(1) );
+      for( uint32_t i = 0; i < asset_count; ++i )
+      {
+         op.issuer = accounts[i % account_count];
+         op.symbol = "SCALE" + std::to_string( i );
+         assets.emplace_back( push_op( op ) );
+      }
+   }
+   {
+      // Orders selling core at different prices, none of them match
+      limit_order_create_operation op;
+      op.amount_to_sell = asset( 10 );
+      for( uint32_t i = 0; i < order_count; ++i )
+      {
+         op.seller = accounts[i % account_count];
+         op.min_to_receive = asset( 10 + i % 1000, assets[i % asset_count] );
+         push_op( op );
+      }
+   }
+   generate_block();
+   pending_count = 0;
+   const int64_t setup_us = elapsed_us( setup_start );
+
+   // Blocks of signed transfers, each one generated, popped and timed while it is pushed again
+   vector<int64_t> block_apply_us;
+   block_apply_us.reserve( block_count );
+   for( uint32_t b = 0; b < block_count; ++b )
+   {
+      for( uint32_t i = 0; i < trx_per_block; ++i )
+      {
+         transfer_operation op;
+         op.from = accounts[i % account_count];
+         op.to = accounts[( i + 1 ) % account_count];
+         op.amount = asset( 1 + i / account_count ); // keeps the transactions of a block unique
+         signed_transaction tx;
+         tx.operations.push_back( op );
+         set_expiration( db, tx );
+         tx.sign( key, db.get_chain_id() );
+         db.push_transaction( tx, ~0 );
+      }
+      const signed_block block = generate_block();
+      transaction_count += block.transactions.size();
+      db.pop_block();
+      db._popped_tx.clear();
+
+      const auto start = fc::time_point::now();
+      db.push_block( block, database::skip_undo_history_check );
+      block_apply_us.push_back( elapsed_us( start ) );
+   }
+
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   BOOST_REQUIRE( !db.get_maintenance_timings().empty() );
+   const maintenance_timing maintenance = db.get_maintenance_timings().back();
+
+   const auto memory = db.get_memory_usage();
+
+   const uint32_t replayed_blocks = db.head_block_num();
+   db.close();
+   const auto replay_start = fc::time_point::now();
+   db.open( data_dir->path(), [this]{ return genesis_state; }, "force_wipe" );
+   const int64_t replay_us = std::max<int64_t>( elapsed_us( replay_start ), 1 );
+   BOOST_CHECK_EQUAL( replayed_blocks, db.head_block_num() );
+   BOOST_CHECK( db.find( accounts.back() ) != nullptr );
+
+   int64_t total_apply_us = 0;
+   int64_t max_apply_us = 0;
+   for( auto us : block_apply_us )
+   {
+      total_apply_us += us;
+      max_apply_us = std::max( max_apply_us, us );
+   }
+
+   fc::mutable_variant_object report;
+   report( "accounts", account_count )
+         ( "assets", asset_count )
+         ( "orders", order_count )
+         ( "blocks", block_count )
+         ( "trx_per_block", trx_per_block )
+         ( "setup_us", setup_us )
+         ( "block_apply_avg_us", block_count > 0 ? total_apply_us / block_count : 0 )
+         ( "block_apply_max_us", max_apply_us )
+         ( "maintenance", maintenance, 3 )
+         ( "memory", memory, 3 )
+         ( "replayed_blocks", replayed_blocks )
+         ( "replay_us", replay_us )
+         ( "replay_blocks_per_second", uint64_t(replayed_blocks) * 1000000 / replay_us )
+         ( "replay_transactions_per_second", transaction_count * 1000000 / replay_us );
+
+   const fc::variant result( report, 3 );
+   if( output_file != nullptr )
+      fc::json::save_to_file( result, fc::path( output_file ) );
+   else
+      std::cout << fc::json::to_pretty_string( result ) << "\n";
+} FC_LOG_AND_RETHROW() }
@@ -725,12 +725,111 @@ BOOST_FIXTURE_TEST_CASE( account_history_pagination, cli_fixture )
          }
          operation_ids.insert(op.op.id);
       }
+
+      // a later call adds the new operations to the ones the wallet has seen before
+      con.wallet_api_ptr->transfer("nathan", "jmjatlanta", "200", "1.3.0", "", true);
+      BOOST_CHECK(generate_block(app1));
+      std::vector<graphene::wallet::operation_detail> newer = con.wallet_api_ptr->get_account_history("jmjatlanta", 300);
+      BOOST_REQUIRE_EQUAL(202u, newer.size());
+      BOOST_CHECK(operation_ids.find(newer.front().op.id) == operation_ids.end());
+      for(size_t i = 1; i < newer.size(); ++i)
+         BOOST_CHECK(newer[i].op.id == history[i - 1].op.id);
+
+      auto relative = con.wallet_api_ptr->get_relative_account_history("jmjatlanta", 0, 10, 150);
+      BOOST_REQUIRE_EQUAL(10u, relative.size());
+      BOOST_CHECK(relative.front().op.id == newer[202 - 150].op.id);
    } catch( fc::exception& e ) {
       edump((e.to_detail_string()));
       throw;
    }
 }
 
+///////////////////////
+// Sign and broadcast the operations of a transaction builder as several transactions
+///////////////////////
+BOOST_FIXTURE_TEST_CASE( cli_bulk_builder_transaction, cli_fixture )
+{
+   try
+   {
+      INVOKE(create_new_account);
+
+      account_id_type nathan_id = con.wallet_api_ptr->get_account("nathan").id;
+      account_id_type jmjatlanta_id = con.wallet_api_ptr->get_account("jmjatlanta").id;
+
+      vector<operation> ops;
+      for( int i = 1; i <= 40; i++ )
+      {
+         transfer_operation xfer_op;
+         xfer_op.from = nathan_id;
+         xfer_op.to = jmjatlanta_id;
+         xfer_op.amount = asset(i);
+         ops.push_back( xfer_op );
+      }
+
+      BOOST_TEST_MESSAGE("Broadcasting 40 transfers in bulk");
+      auto handle = con.wallet_api_ptr->begin_builder_transaction();
+      con.wallet_api_ptr->add_operations_to_builder_transaction( handle, ops );
+      auto results = con.wallet_api_ptr->sign_builder_transaction_in_bulk( handle, "1.3.0", 15, true );
+      con.wallet_api_ptr->remove_builder_transaction( handle );
+
+      BOOST_REQUIRE_EQUAL( 3u, results.size() );
+      uint32_t next_operation = 0;
+      for( const auto& result : results )
+      {
+         BOOST_CHECK( !result.error.valid() );
+         BOOST_CHECK_EQUAL( next_operation, result.first_operation );
+         BOOST_CHECK_EQUAL( result.operation_count, result.trx.operations.size() );
+         BOOST_CHECK( result.transaction_id == result.trx.id() );
+         BOOST_CHECK( !result.trx.signatures.empty() );
+         next_operation += result.operation_count;
+      }
+      BOOST_CHECK_EQUAL( 40u, next_operation );
+
+      BOOST_CHECK(generate_block(app1));
+
+      // the account creation and the first transfer came before
+      auto history = con.wallet_api_ptr->get_account_history("jmjatlanta", 100);
+      BOOST_CHECK_EQUAL( 42u, history.size() );
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+///////////////////////
+// Decrypt a list of memos at once
+///////////////////////
+BOOST_FIXTURE_TEST_CASE( cli_read_memos, cli_fixture )
+{
+   try
+   {
+      INVOKE(create_new_account);
+
+      vector<memo_data> memos;
+      for( int i = 0; i < 20; i++ )
+         memos.push_back( con.wallet_api_ptr->sign_memo( "nathan", "jmjatlanta", "memo " + std::to_string(i) ) );
+      // a memo between two keys that are not in the wallet
+      memo_data foreign;
+      auto key1 = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string("memo key 1") ) );
+      auto key2 = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string("memo key 2") ) );
+      foreign.from = key1.get_public_key();
+      foreign.to = key2.get_public_key();
+      foreign.set_message( key1, key2.get_public_key(), "not for us" );
+      memos.push_back( foreign );
+
+      vector<string> texts = con.wallet_api_ptr->read_memos( memos );
+      BOOST_REQUIRE_EQUAL( memos.size(), texts.size() );
+      for( int i = 0; i < 20; i++ )
+      {
+         BOOST_CHECK_EQUAL( "memo " + std::to_string(i), texts[i] );
+         BOOST_CHECK_EQUAL( texts[i], con.wallet_api_ptr->read_memo( memos[i] ) );
+      }
+      BOOST_CHECK( texts.back().empty() );
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
 
 ///////////////////////
 // Create a multi-sig account and verify that only when all signatures are
@@ -870,6 +969,18 @@ graphene::wallet::plain_keys decrypt_keys( const std::string& password, const ve
    return fc::raw::unpack<graphene::wallet::plain_keys>( decrypted );
 }
 
+graphene::wallet::plain_keys decrypt_keys( const std::string& password, const graphene::wallet::wallet_data& wallet )
+{
+   graphene::wallet::plain_keys pk = decrypt_keys( password, wallet.cipher_keys );
+   for( const auto& entry : wallet.cipher_key_journal )
+   {
+      graphene::wallet::plain_keys added = decrypt_keys( password, entry );
+      BOOST_CHECK( added.checksum == pk.checksum );
+      pk.keys.insert( added.keys.begin(), added.keys.end() );
+   }
+   return pk;
+}
+
 BOOST_AUTO_TEST_CASE( saving_keys_wallet_test ) {
    cli_fixture cli;
 
@@ -879,6 +990,8 @@ BOOST_AUTO_TEST_CASE( saving_keys_wallet_test ) {
    cli.con.wallet_api_ptr->create_account_with_brain_key( brain_key, "account1", "nathan", "nathan", true );
 
    BOOST_CHECK_NO_THROW( cli.con.wallet_api_ptr->transfer( "nathan", "account1", "9000", "1.3.0", "", true ) );
+   // the wallet file is written in the background
+   cli.con.wallet_api_ptr->save_wallet_file();
 
    std::string path( cli.app_dir.path().generic_string() + "/wallet.json" );
    graphene::wallet::wallet_data wallet = fc::json::from_file( path ).as<graphene::wallet::wallet_data>( 2 * GRAPHENE_MAX_NESTED_OBJECTS );
@@ -886,19 +999,36 @@ BOOST_AUTO_TEST_CASE( saving_keys_wallet_test ) {
    BOOST_CHECK( wallet.pending_account_registrations.size() == 1 ); // account1
    BOOST_CHECK( wallet.pending_account_registrations["account1"].size() == 2 ); // account1 active key + account1 memo key
 
-   graphene::wallet::plain_keys pk = decrypt_keys( "supersecret", wallet.cipher_keys );
+   graphene::wallet::plain_keys pk = decrypt_keys( "supersecret", wallet );
    BOOST_CHECK( pk.keys.size() == 1 ); // nathan key
 
    BOOST_CHECK( generate_block( cli.app1 ) );
    fc::usleep( fc::seconds(1) );
+   cli.con.wallet_api_ptr->save_wallet_file();
 
    wallet = fc::json::from_file( path ).as<graphene::wallet::wallet_data>( 2 * GRAPHENE_MAX_NESTED_OBJECTS );
    BOOST_CHECK( wallet.extra_keys.size() == 2 ); // nathan + account1
    BOOST_CHECK( wallet.pending_account_registrations.empty() );
    BOOST_CHECK_NO_THROW( cli.con.wallet_api_ptr->transfer( "account1", "nathan", "1000", "1.3.0", "", true ) );
 
-   pk = decrypt_keys( "supersecret", wallet.cipher_keys );
+   pk = decrypt_keys( "supersecret", wallet );
    BOOST_CHECK( pk.keys.size() == 3 ); // nathan key + account1 active key + account1 memo key
+
+   // keys imported after the first save are appended to the journal, all of them are kept on lock
+   vector<string> wif_keys;
+   for( int i = 0; i < 10; ++i )
+      wif_keys.push_back( graphene::utilities::key_to_wif( fc::ecc::private_key::regenerate(
+            fc::sha256::hash( "bulk key " + std::to_string(i) ) ) ) );
+   auto imported = cli.con.wallet_api_ptr->import_keys( "account1", wif_keys );
+   BOOST_CHECK_EQUAL( 10u, imported.size() );
+   BOOST_CHECK( std::find( imported.begin(), imported.end(), true ) == imported.end() ); // no authority keys
+   cli.con.wallet_api_ptr->save_wallet_file();
+   wallet = fc::json::from_file( path ).as<graphene::wallet::wallet_data>( 2 * GRAPHENE_MAX_NESTED_OBJECTS );
+   BOOST_CHECK_EQUAL( 13u, decrypt_keys( "supersecret", wallet ).keys.size() );
+
+   cli.con.wallet_api_ptr->lock();
+   cli.con.wallet_api_ptr->unlock( "supersecret" );
+   BOOST_CHECK_EQUAL( 13u, cli.con.wallet_api_ptr->dump_private_keys().size() );
 }
 
 
@@ -31,6 +31,7 @@
 #include <graphene/elasticsearch/elasticsearch_plugin.hpp>
 #include <graphene/api_helper_indexes/api_helper_indexes.hpp>
 #include <graphene/es_objects/es_objects.hpp>
+#include <graphene/history_store/history_store_plugin.hpp>
 
 #include <graphene/chain/balance_object.hpp>
 #include <graphene/chain/committee_member_object.hpp>
@@ -64,6 +65,7 @@ void clearable_block::clear()
    _calculated_merkle_root = checksum_type();
    _signee = fc::ecc::public_key();
    _block_id = block_id_type();
+   _packed_size = 0;
 }
 
 database_fixture::database_fixture(const fc::time_point_sec &initial_timestamp)
@@ -127,6 +129,12 @@ database_fixture::database_fixture(const fc::time_point_sec &initial_timestamp)
     */
    auto current_test_name = boost::unit_test::framework::current_test_case().p_name.value;
    auto current_test_suite_id = boost::unit_test::framework::current_test_case().p_parent_id;
+   if (current_test_name == "account_history_archive")
+   {
+      options.insert(std::make_pair("max-ops-per-account", boost::program_options::variable_value((uint64_t)5, false)));
+      options.insert(std::make_pair("partial-operations", boost::program_options::variable_value(true, false)));
+      options.insert(std::make_pair("archive-old-operations", boost::program_options::variable_value(true, false)));
+   }
    if (current_test_name == "get_account_history_operations")
    {
       options.insert(std::make_pair("max-ops-per-account", boost::program_options::variable_value((uint64_t)75, false)));
@@ -198,7 +206,7 @@ database_fixture::database_fixture(const fc::time_point_sec &initial_timestamp)
     options.insert(std::make_pair("plugins", boost::program_options::variable_value(
        string("account_history"), false)));
    }
-   if( current_test_name == "asset_in_collateral" )
+   if( current_test_name == "asset_in_collateral" || current_test_name == "asset_holders_index" )
    {
     options.insert( std::make_pair( "plugins",
                                     boost::program_options::variable_value( string("api_helper_indexes"), false ) ) );
@@ -278,7 +286,7 @@ database_fixture::database_fixture(const fc::time_point_sec &initial_timestamp)
       esobjects_plugin->plugin_initialize(options);
       esobjects_plugin->plugin_startup();
    }
-   else if( current_test_name == "asset_in_collateral" )
+   else if( current_test_name == "asset_in_collateral" || current_test_name == "asset_holders_index" )
    {
       auto ahiplugin = app.register_plugin<graphene::api_helper_indexes::api_helper_indexes>();
       ahiplugin->plugin_set_app(&app);
@@ -286,7 +294,26 @@ database_fixture::database_fixture(const fc::time_point_sec &initial_timestamp)
       ahiplugin->plugin_startup();
    }
 
-   options.insert(std::make_pair("bucket-size", boost::program_options::variable_value(string("[15]"),false)));
+   if( current_test_name == "history_store" || current_test_name == "history_store_rebuild" )
+   {
+      auto hsplugin = app.register_plugin<graphene::history_store::history_store_plugin>();
+      hsplugin->plugin_set_app(&app);
+      // small chunks and runs, so that the test writes and merges several of them
+      options.insert(std::make_pair("history-store-chunk-size", boost::program_options::variable_value(uint32_t(4), false)));
+      options.insert(std::make_pair("history-store-memtable-size", boost::program_options::variable_value(uint64_t(16), false)));
+      options.insert(std::make_pair("history-store-max-runs", boost::program_options::variable_value(uint32_t(2), false)));
+      hsplugin->plugin_initialize(options);
+      hsplugin->plugin_startup();
+   }
+
+   if( current_test_name == "market_history_bucket_rollup" )
+   {
+      options.insert(std::make_pair("bucket-size", boost::program_options::variable_value(string("[15,45]"),false)));
+      options.insert(std::make_pair("bucket-rollup", boost::program_options::variable_value(true, false)));
+      options.insert(std::make_pair("history-per-size", boost::program_options::variable_value(uint32_t(6), false)));
+   }
+   else
+      options.insert(std::make_pair("bucket-size", boost::program_options::variable_value(string("[15]"),false)));
    mhplugin->plugin_set_app(&app);
    mhplugin->plugin_initialize(options);
 
@@ -26,15 +26,22 @@
 #include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <random>
+#include <thread>
 
 #include <fc/io/fstream.hpp>
 #include <fc/io/json.hpp>
 #include <fc/io/stdio.hpp>
+#include <fc/thread/parallel.hpp>
 
 #include <graphene/app/api.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/balance_object.hpp>
 #include <graphene/egenesis/egenesis.hpp>
 #include <graphene/utilities/key_conversion.hpp>
 
+#include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 
 #ifndef WIN32
@@ -53,6 +60,367 @@ namespace graphene { namespace app { namespace detail {
 genesis_state_type create_example_genesis();
 } } } // graphene::app::detail
 
+namespace {
+
+/// Transactions per block while registering and funding the accounts
+const uint32_t max_setup_transactions = 500;
+/// Accounts publishing feeds for the market issued asset
+const size_t   max_feed_producers = 11;
+/// Core and user issued asset given to each account, enough for about 10^4 transfers with default fees
+const int64_t  max_account_funding = int64_t( GRAPHENE_BLOCKCHAIN_PRECISION ) * 20 * 10000;
+
+transfer_operation make_transfer( account_id_type from, account_id_type to, const asset& amount )
+{
+   transfer_operation op;
+   op.from = from;
+   op.to = to;
+   op.amount = amount;
+   return op;
+}
+
+/// Relative weights of the operations in the generated transactions
+struct operation_mix
+{
+   enum kind { transfer, order, feed, proposal, account, kinds };
+   static const char* name( size_t k )
+   {
+      static const char* const names[kinds] = { "transfer", "order", "feed", "proposal", "account" };
+      return names[k];
+   }
+
+   uint32_t weights[kinds] = { 60, 20, 5, 5, 10 };
+};
+
+/// Parses a list like "transfer=60,order=20", the operations not listed keep their default weight
+operation_mix parse_mix( const string& spec )
+{
+   operation_mix mix;
+   vector<string> entries;
+   boost::split( entries, spec, boost::is_any_of( "," ), boost::token_compress_on );
+   for( const string& entry : entries )
+   {
+      if( entry.empty() )
+         continue;
+      const auto pos = entry.find( '=' );
+      FC_ASSERT( pos != string::npos, "Invalid mix entry ${e}, expected name=weight", ("e",entry) );
+      const string name = entry.substr( 0, pos );
+      size_t k = 0;
+      while( k < operation_mix::kinds && name != operation_mix::name( k ) )
+         ++k;
+      FC_ASSERT( k < operation_mix::kinds, "Unknown operation ${n} in the mix", ("n",name) );
+      mix.weights[k] = std::stoul( entry.substr( pos + 1 ) );
+   }
+   return mix;
+}
+
+/**
+ *  Fills the blocks of the generator with transactions drawn from an operation_mix. The stake of the example
+ *  genesis is claimed by nathan, who registers and funds the user accounts, a user issued asset that they trade
+ *  against the core asset and a market issued asset that some of them publish feeds for.
+ *
+ *  The transactions of a block are signed in parallel and pushed without checking their signatures again, they
+ *  are checked when the blocks are replayed.
+ */
+class synthetic_chain
+{
+   public:
+      synthetic_chain( database& db, const fc::ecc::private_key& key, const operation_mix& mix,
+                       uint32_t accounts, uint64_t seed )
+      : _db( db ), _key( key ), _target_accounts( accounts ), _rng( seed )
+      {
+         uint64_t sum = 0;
+         for( size_t k = 0; k < operation_mix::kinds; ++k )
+         {
+            sum += mix.weights[k];
+            _cumulative_weights[k] = sum;
+         }
+         FC_ASSERT( sum > 0, "The operation mix is empty" );
+         const auto& accounts_by_name = _db.get_index_type<account_index>().indices().get<graphene::chain::by_name>();
+         const auto itr = accounts_by_name.find( "nathan" );
+         FC_ASSERT( itr != accounts_by_name.end(), "The genesis state has no nathan account to hold the stake" );
+         _nathan = itr->id;
+      }
+
+      /// Pushes the next transactions preparing the chain, @return false once the chain is prepared
+      bool setup_step()
+      {
+         vector<signed_transaction> trxs;
+         switch( _setup_stage )
+         {
+         case 0:
+            claim_stake( trxs );
+            {
+               account_upgrade_operation op;
+               op.account_to_upgrade = _nathan;
+               op.upgrade_to_lifetime_member = true;
+               trxs.push_back( make_transaction( op ) );
+            }
+            trxs.push_back( make_transaction( make_asset( "SYNTH", false ) ) );
+            trxs.push_back( make_transaction( make_asset( "SYNTHBIT", true ) ) );
+            ++_setup_stage;
+            break;
+         case 1:
+            _uia = find_asset( "SYNTH" );
+            _bitasset = find_asset( "SYNTHBIT" );
+            for( uint32_t i = 0; i < max_setup_transactions && _created_accounts < _target_accounts; ++i )
+               trxs.push_back( make_transaction( make_account() ) );
+            if( _created_accounts >= _target_accounts )
+               ++_setup_stage;
+            break;
+         case 2:
+            fund_new_accounts( trxs );
+            if( !_new_accounts.empty() )
+               break;
+            {
+               asset_update_feed_producers_operation op;
+               op.issuer = _nathan;
+               op.asset_to_update = _bitasset;
+               for( size_t i = 0; i < std::min<size_t>( _users.size(), max_feed_producers ); ++i )
+                  op.new_feed_producers.insert( _users[i] );
+               _feed_producers.assign( op.new_feed_producers.begin(), op.new_feed_producers.end() );
+               trxs.push_back( make_transaction( op ) );
+            }
+            ++_setup_stage;
+            break;
+         default:
+            return false;
+         }
+         sign_and_push( trxs );
+         return true;
+      }
+
+      /// Pushes count transactions drawn from the mix, after funding the accounts created in the previous block
+      void add_transactions( uint32_t count )
+      {
+         vector<signed_transaction> trxs;
+         fund_new_accounts( trxs );
+         trxs.reserve( trxs.size() + count );
+         for( uint32_t i = 0; i < count; ++i )
+            trxs.push_back( make_transaction( make_operation() ) );
+         sign_and_push( trxs );
+      }
+
+      uint64_t pushed()const   { return _pushed; }
+      uint64_t rejected()const { return _rejected; }
+      size_t   users()const    { return _users.size(); }
+
+   private:
+      template<typename Operation>
+      signed_transaction make_transaction( Operation&& op )const
+      {
+         signed_transaction trx;
+         trx.operations.emplace_back( std::forward<Operation>( op ) );
+         for( auto& o : trx.operations )
+            _db.current_fee_schedule().set_fee( o );
+         return trx;
+      }
+
+      void sign_and_push( vector<signed_transaction>& trxs )
+      {
+         const auto expiration = _db.head_block_time() + fc::minutes( 2 );
+         for( auto& trx : trxs )
+         {
+            trx.set_reference_block( _db.head_block_id() );
+            trx.set_expiration( expiration );
+         }
+
+         const chain_id_type& chain_id = _db.get_chain_id();
+         const size_t chunks = std::max( 1u, std::thread::hardware_concurrency() );
+         const size_t chunk_size = ( trxs.size() + chunks - 1 ) / chunks;
+         vector< fc::future<void> > signing;
+         for( size_t begin = 0; begin < trxs.size(); begin += chunk_size )
+         {
+            const size_t end = std::min( trxs.size(), begin + chunk_size );
+            signing.push_back( fc::do_parallel( [this,&trxs,&chain_id,begin,end] () {
+               for( size_t i = begin; i < end; ++i )
+                  trxs[i].sign( _key, chain_id );
+            }) );
+         }
+         for( auto& f : signing )
+            f.wait();
+
+         for( const auto& trx : trxs )
+         {
+            try
+            {
+               _db.push_transaction( trx, database::skip_transaction_signatures );
+               ++_pushed;
+            }
+            catch( const fc::exception& e )
+            {
+               // e.g. a duplicate transaction or an account that has run out of funds
+               if( _rejected++ < 10 )
+                  wlog( "Transaction rejected: ${e}", ("e",e.to_string()) );
+            }
+         }
+      }
+
+      void claim_stake( vector<signed_transaction>& trxs )const
+      {
+         const address owner( _key.get_public_key() );
+         for( const balance_object& balance : _db.get_index_type<balance_index>().indices() )
+         {
+            if( balance.owner != owner || balance.is_vesting_balance() )
+               continue;
+            balance_claim_operation op;
+            op.deposit_to_account = _nathan;
+            op.balance_to_claim = balance.id;
+            op.balance_owner_key = _key.get_public_key();
+            op.total_claimed = balance.balance;
+            trxs.push_back( make_transaction( op ) );
+         }
+      }
+
+      asset_create_operation make_asset( const string& symbol, bool market_issued )const
+      {
+         asset_create_operation op;
+         op.issuer = _nathan;
+         op.symbol = symbol;
+         op.precision = market_issued ? GRAPHENE_BLOCKCHAIN_PRECISION_DIGITS : 2;
+         op.common_options.max_supply = GRAPHENE_MAX_SHARE_SUPPLY;
+         op.common_options.core_exchange_rate = price( asset( 1, asset_id_type(1) ), asset( 1 ) );
+         op.common_options.flags = charge_market_fee;
+         op.common_options.issuer_permissions = charge_market_fee;
+         if( market_issued )
+         {
+            op.bitasset_opts = bitasset_options();
+            op.bitasset_opts->minimum_feeds = 1;
+         }
+         return op;
+      }
+
+      asset_id_type find_asset( const string& symbol )const
+      {
+         const auto& assets_by_symbol = _db.get_index_type<asset_index>().indices().get<graphene::chain::by_symbol>();
+         const auto itr = assets_by_symbol.find( symbol );
+         FC_ASSERT( itr != assets_by_symbol.end(), "Asset ${s} was not created", ("s",symbol) );
+         return itr->id;
+      }
+
+      account_create_operation make_account()
+      {
+         account_create_operation op;
+         op.registrar = _nathan;
+         op.referrer = _nathan;
+         op.name = "synth" + std::to_string( _created_accounts++ );
+         op.owner = authority( 1, public_key_type( _key.get_public_key() ), 1 );
+         op.active = op.owner;
+         op.options.memo_key = _key.get_public_key();
+         op.options.voting_account = GRAPHENE_PROXY_TO_SELF_ACCOUNT;
+         _new_accounts.push_back( op.name );
+         return op;
+      }
+
+      /**
+       * Gives the accounts registered in earlier blocks core and user issued assets, then they may be used. The
+       * amount shrinks with the stake left, so that registering accounts does not stop when it runs low.
+       */
+      void fund_new_accounts( vector<signed_transaction>& trxs )
+      {
+         const auto& accounts_by_name = _db.get_index_type<account_index>().indices().get<graphene::chain::by_name>();
+         const int64_t stake = _db.get_balance( _nathan, asset_id_type() ).amount.value;
+         const int64_t funding = std::max<int64_t>( 1, std::min( max_account_funding, stake / 10000 ) );
+         size_t funded = 0;
+         for( ; funded < _new_accounts.size() && funded < max_setup_transactions; ++funded )
+         {
+            const auto itr = accounts_by_name.find( _new_accounts[funded] );
+            if( itr == accounts_by_name.end() ) // the registration was rejected
+               continue;
+            trxs.push_back( make_transaction( make_transfer( _nathan, itr->id, asset( funding ) ) ) );
+            asset_issue_operation issue;
+            issue.issuer = _nathan;
+            issue.asset_to_issue = asset( funding, _uia );
+            issue.issue_to_account = itr->id;
+            trxs.push_back( make_transaction( issue ) );
+            _users.push_back( itr->id );
+         }
+         _new_accounts.erase( _new_accounts.begin(), _new_accounts.begin() + funded );
+      }
+
+      account_id_type random_user()
+      {
+         return _users[ _rng() % _users.size() ];
+      }
+
+      operation make_operation()
+      {
+         const uint64_t draw = _rng() % _cumulative_weights[operation_mix::kinds - 1];
+         size_t k = std::upper_bound( std::begin( _cumulative_weights ), std::end( _cumulative_weights ), draw )
+                    - std::begin( _cumulative_weights );
+         if( _users.size() < 2 || ( k == operation_mix::feed && _feed_producers.empty() ) )
+            k = operation_mix::account;
+         const int64_t amount = 1 + int64_t( _sequence++ % 100000 );
+         switch( k )
+         {
+         case operation_mix::transfer:
+         {
+            const account_id_type from = random_user();
+            account_id_type to = random_user();
+            while( to == from )
+               to = random_user();
+            return make_transfer( from, to, asset( amount ) );
+         }
+         case operation_mix::order:
+         {
+            limit_order_create_operation op;
+            op.seller = random_user();
+            // prices within 10% of 1:1, so that some of the orders match
+            const int64_t receive = std::max<int64_t>( 1, amount * int64_t( 900 + _rng() % 201 ) / 1000 );
+            const bool sell_core = ( _rng() % 2 == 0 );
+            op.amount_to_sell = sell_core ? asset( amount ) : asset( amount, _uia );
+            op.min_to_receive = sell_core ? asset( receive, _uia ) : asset( receive );
+            op.expiration = _db.head_block_time() + fc::seconds( 60 + _rng() % 86400 );
+            return op;
+         }
+         case operation_mix::feed:
+         {
+            asset_publish_feed_operation op;
+            op.publisher = _feed_producers[ _rng() % _feed_producers.size() ];
+            op.asset_id = _bitasset;
+            const asset core( 90000 + int64_t( _rng() % 20000 ) );
+            op.feed.settlement_price = price( asset( 100000, _bitasset ), core );
+            op.feed.core_exchange_rate = price( asset( 100000, _bitasset ), core );
+            return op;
+         }
+         case operation_mix::proposal:
+         {
+            proposal_create_operation op;
+            op.fee_paying_account = random_user();
+            account_id_type to = random_user();
+            while( to == op.fee_paying_account )
+               to = random_user();
+            op.proposed_ops.emplace_back( make_transfer( op.fee_paying_account, to, asset( amount ) ) );
+            for( auto& proposed : op.proposed_ops )
+               _db.current_fee_schedule().set_fee( proposed.op );
+            op.expiration_time = _db.head_block_time() + fc::hours( 1 );
+            return op;
+         }
+         default:
+            return make_account();
+         }
+      }
+
+      database&                  _db;
+      const fc::ecc::private_key _key;
+      const uint32_t             _target_accounts;
+      std::mt19937_64            _rng;
+      uint64_t                   _cumulative_weights[operation_mix::kinds];
+      uint32_t                   _setup_stage = 0;
+      account_id_type            _nathan;
+      asset_id_type              _uia;
+      asset_id_type              _bitasset;
+      vector<account_id_type>    _users;
+      vector<account_id_type>    _feed_producers;
+      /// Names of the registered accounts that are not funded yet
+      vector<string>             _new_accounts;
+      uint64_t                   _created_accounts = 0;
+      uint64_t                   _sequence = 0;
+      uint64_t                   _pushed = 0;
+      uint64_t                   _rejected = 0;
+};
+
+}
+
 int main( int argc, char** argv )
 {
    try
@@ -65,6 +433,14 @@ int main( int argc, char** argv )
             ("genesis-time,t", bpo::value<uint32_t>()->default_value(0), "Timestamp for genesis state (0=use value from file/example)")
             ("num-blocks,n", bpo::value<uint32_t>()->default_value(1000000), "Number of blocks to generate")
             ("miss-rate,r", bpo::value<uint32_t>()->default_value(3), "Percentage of blocks to miss")
+            ("transactions-per-block,x", bpo::value<uint32_t>()->default_value(0),
+             "Number of transactions drawn from the mix in each block, 0 for empty blocks")
+            ("mix", bpo::value<string>()->default_value("transfer=60,order=20,feed=5,proposal=5,account=10"),
+             "Relative weights of the operations in the transactions, of transfer, order, feed, proposal and account")
+            ("accounts", bpo::value<uint32_t>()->default_value(1000),
+             "Number of accounts registered and funded before the transactions from the mix start")
+            ("seed", bpo::value<uint64_t>()->default_value(1),
+             "Seed of the random choices of the mix, together with --genesis-time the chain is reproducible")
             ("verbose,v", "Enter verbose mode")
             ;
 
@@ -123,12 +499,28 @@ int main( int argc, char** argv )
       fc::path db_path = data_dir / "db";
       db.open(db_path, [&]() { return genesis; }, "TEST" );
 
+      const uint32_t transactions_per_block = options["transactions-per-block"].as<uint32_t>();
+      std::unique_ptr<synthetic_chain> content;
+      if( transactions_per_block > 0 )
+         content.reset( new synthetic_chain( db, nathan_priv_key, parse_mix( options["mix"].as<string>() ),
+                                             options["accounts"].as<uint32_t>(), options["seed"].as<uint64_t>() ) );
+      bool setup_done = false;
+      // the transactions are signed by the generator, checking them again would take as long as signing them
+      const uint32_t skip = content ? database::skip_transaction_signatures : database::skip_nothing;
+
       uint32_t slot = 1;
       uint32_t missed = 0;
 
       for( uint32_t i = 1; i < num_blocks; ++i )
       {
-         signed_block b = db.generate_block(db.get_slot_time(slot), db.get_scheduled_witness(slot), nathan_priv_key, database::skip_nothing);
+         if( content )
+         {
+            if( !setup_done )
+               setup_done = !content->setup_step();
+            if( setup_done )
+               content->add_transactions( transactions_per_block );
+         }
+         signed_block b = db.generate_block(db.get_slot_time(slot), db.get_scheduled_witness(slot), nathan_priv_key, skip);
          FC_ASSERT( db.head_block_id() == b.id() );
          fc::sha256 h = b.digest();
          uint64_t rand = h._hash[0].value();
@@ -154,6 +546,9 @@ int main( int argc, char** argv )
          else if( (i%10000) == 0 )
          {
             std::cerr << "\rblock #" << i << "   missed " << missed;
+            if( content )
+               std::cerr << "   transactions " << content->pushed() << "   rejected " << content->rejected()
+                         << "   accounts " << content->users();
          }
          if( slot == 1 )  // can possibly get consecutive production if block missed
          {
@@ -161,6 +556,9 @@ int main( int argc, char** argv )
          }
       }
       std::cerr << "\n";
+      if( content )
+         std::cerr << "Pushed " << content->pushed() << " transactions, " << content->rejected() << " were rejected, "
+                   << content->users() << " funded accounts\n";
       db.close();
    }
    catch ( const fc::exception& e )
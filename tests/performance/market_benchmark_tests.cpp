@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/database.hpp>
+
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/market_object.hpp>
+
+#include "../common/database_fixture.hpp"
+#include "../common/env_util.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+namespace {
+
+   /// One step of a market workload, see README.md for the text format
+   struct workload_op
+   {
+      enum kind_type { limit, cancel, feed, settle };
+
+      kind_type kind = limit;
+      uint32_t  trader = 0;
+      uint32_t  market = 0;
+      bool      sell_core = false;
+      int64_t   amount = 0;    ///< amount to sell, the debt side of a feed price, or the amount to settle
+      int64_t   receive = 0;   ///< minimum to receive, or the core side of a feed price
+      uint64_t  target = 0;    ///< for cancels, the index of the limit order among all limit ops
+   };
+
+   vector<workload_op> read_workload( const string& path )
+   {
+      std::ifstream in( path );
+      FC_ASSERT( in, "Unable to open workload file ${p}", ("p",path) );
+      vector<workload_op> result;
+      string line;
+      while( std::getline( in, line ) )
+      {
+         std::istringstream fields( line );
+         string kind;
+         if( !( fields >> kind ) || kind[0] == '#' )
+            continue;
+         workload_op op;
+         if( kind == "limit" )
+         {
+            int sell_core = 0;
+            fields >> op.trader >> op.market >> sell_core >> op.amount >> op.receive;
+            op.sell_core = ( sell_core != 0 );
+         }
+         else if( kind == "cancel" )
+         {
+            op.kind = workload_op::cancel;
+            fields >> op.target;
+         }
+         else if( kind == "feed" )
+         {
+            op.kind = workload_op::feed;
+            fields >> op.amount >> op.receive;
+         }
+         else if( kind == "settle" )
+         {
+            op.kind = workload_op::settle;
+            fields >> op.trader >> op.amount;
+         }
+         else
+            FC_THROW( "Unknown workload operation ${k}", ("k",kind) );
+         FC_ASSERT( !fields.fail(), "Malformed workload line: ${l}", ("l",line) );
+         result.push_back( op );
+      }
+      return result;
+   }
+
+   void write_workload( const string& path, const vector<workload_op>& ops )
+   {
+      std::ofstream out( path );
+      FC_ASSERT( out, "Unable to open workload file ${p}", ("p",path) );
+      for( const auto& op : ops )
+      {
+         if( op.kind == workload_op::limit )
+            out << "limit " << op.trader << ' ' << op.market << ' ' << ( op.sell_core ? 1 : 0 )
+                << ' ' << op.amount << ' ' << op.receive << '\n';
+         else if( op.kind == workload_op::cancel )
+            out << "cancel " << op.target << '\n';
+         else if( op.kind == workload_op::settle )
+            out << "settle " << op.trader << ' ' << op.amount << '\n';
+         else
+            out << "feed " << op.amount << ' ' << op.receive << '\n';
+      }
+   }
+
+   /// Collects per operation latencies in microseconds
+   class latency_stats
+   {
+      public:
+         void add( int64_t usecs ) { _samples.push_back( usecs ); }
+
+         void report( const string& name )
+         {
+            if( _samples.empty() )
+               return;
+            std::sort( _samples.begin(), _samples.end() );
+            int64_t total = 0;
+            for( int64_t s : _samples )
+               total += s;
+            const auto percentile = [this]( size_t p ) {
+               return _samples[ std::min( _samples.size() - 1, _samples.size() * p / 100 ) ];
+            };
+            wlog( "Benchmark: ${n} ${c} ops, ${ops}/s, p50 ${p50}us, p90 ${p90}us, p99 ${p99}us, max ${max}us",
+                  ("n",name)("c",_samples.size())
+                  ("ops",total > 0 ? _samples.size() * 1000000 / uint64_t(total) : 0)
+                  ("p50",percentile(50))("p90",percentile(90))("p99",percentile(99))
+                  ("max",_samples.back()) );
+         }
+
+      private:
+         vector<int64_t> _samples;
+   };
+
+}
+
+BOOST_FIXTURE_TEST_SUITE( performance_tests, database_fixture )
+
+/**
+ * Builds order books in a number of markets, one of them a market-pegged asset with
+ * call orders, then times a stream of order placements, cancellations, feed updates and
+ * force settlements, followed by the blocks that execute the settle orders.
+ * Sizes, the random seed and an optional workload file to replay are taken from the
+ * environment, see README.md.
+ */
+BOOST_AUTO_TEST_CASE( market_benchmark )
+{ try {
+   const uint32_t markets = env_or_default( "GRAPHENE_BENCH_MARKETS", 10 );
+   const uint32_t traders = std::max<uint64_t>( env_or_default( "GRAPHENE_BENCH_TRADERS", 20 ), 1 );
+   const uint32_t depth   = env_or_default( "GRAPHENE_BENCH_DEPTH", 200 );
+   const uint64_t ops     = env_or_default( "GRAPHENE_BENCH_OPS", 50000 );
+   const uint64_t seed    = env_or_default( "GRAPHENE_BENCH_SEED", 1 );
+   const char* workload_file = std::getenv( "GRAPHENE_BENCH_WORKLOAD" );
+   const char* record_file   = std::getenv( "GRAPHENE_BENCH_RECORD" );
+
+   // Market i < markets trades the UIA BENCHi against core, market "markets" the MPA BENCHUSD
+   vector<account_id_type> trader_ids;
+   for( uint32_t i = 0; i < traders; ++i )
+   {
+      const auto& trader = create_account( "trader" + std::to_string( i ) );
+      fund( trader, asset( 100000000000ll ) );
+      trader_ids.push_back( trader.id );
+   }
+   vector<asset_id_type> market_assets;
+   for( uint32_t m = 0; m < markets; ++m )
+   {
+      const auto& uia = create_user_issued_asset( "BENCH" + std::to_string( m ) );
+      for( const auto& trader : trader_ids )
+         issue_uia( trader, uia.amount( 100000000000ll ) );
+      market_assets.push_back( uia.id );
+   }
+   const auto& usd = create_bitasset( "BENCHUSD" );
+   const asset_id_type usd_id = usd.id;
+   market_assets.push_back( usd_id );
+   update_feed_producers( usd_id, { trader_ids[0] } );
+   // Settle orders come due shortly after the workload, so that the run can execute them
+   const uint32_t settlement_delay = 2 * db.get_global_properties().parameters.block_interval;
+   {
+      asset_update_bitasset_operation op;
+      op.issuer = usd.issuer;
+      op.asset_to_update = usd_id;
+      op.new_options = usd.bitasset_data( db ).options;
+      op.new_options.force_settlement_delay_sec = settlement_delay;
+      trx.operations.push_back( op );
+      PUSH_TX( db, trx, ~0 );
+      trx.operations.clear();
+   }
+   price_feed feed;
+   feed.settlement_price = asset( 1000, usd_id ) / asset( 1000 );
+   feed.maintenance_collateral_ratio = 1750;
+   feed.maximum_short_squeeze_ratio = 1100;
+   publish_feed( usd_id, trader_ids[0], feed );
+   // Collateral ratios between 2 and 4, so that feed updates can trigger margin calls
+   for( uint32_t i = 0; i < traders; ++i )
+      borrow( trader_ids[i], asset( 1000000000, usd_id ), asset( 1000000000ll * ( 2000 + 2000 * i / traders ) / 1000 ) );
+   generate_block();
+
+   db._undo_db.disable();
+
+   const auto apply_op = [this]( operation op ) {
+      signed_transaction tx;
+      tx.operations.push_back( std::move( op ) );
+      db.current_fee_schedule().set_fee( tx.operations.back() );
+      set_expiration( db, tx );
+      return db.apply_transaction( tx, ~0 );
+   };
+   const auto make_limit = [&]( const workload_op& wop ) {
+      limit_order_create_operation op;
+      op.seller = trader_ids[wop.trader];
+      const asset_id_type other = market_assets[wop.market];
+      op.amount_to_sell = wop.sell_core ? asset( wop.amount ) : asset( wop.amount, other );
+      op.min_to_receive = wop.sell_core ? asset( wop.receive, other ) : asset( wop.receive );
+      return op;
+   };
+
+   // Resting orders on both sides of every book, none of them crossing
+   for( uint32_t m = 0; m <= markets; ++m )
+      for( uint32_t k = 0; k < depth; ++k )
+      {
+         workload_op wop;
+         wop.trader = k % traders;
+         wop.market = m;
+         wop.amount = 100000;
+         wop.receive = 100000 + 100 * ( k + 1 );
+         wop.sell_core = true;
+         apply_op( make_limit( wop ) );
+         wop.sell_core = false;
+         apply_op( make_limit( wop ) );
+      }
+
+   vector<workload_op> workload;
+   if( workload_file != nullptr )
+   {
+      workload = read_workload( workload_file );
+      for( const auto& wop : workload )
+         FC_ASSERT( ( wop.kind != workload_op::limit || ( wop.trader < traders && wop.market <= markets ) )
+                    && ( wop.kind != workload_op::settle || wop.trader < traders ),
+                    "Workload does not fit GRAPHENE_BENCH_TRADERS and GRAPHENE_BENCH_MARKETS" );
+   }
+   else
+   {
+      std::mt19937_64 rng( seed );
+      const auto uniform = [&rng]( int64_t low, int64_t high ) {
+         return std::uniform_int_distribution<int64_t>( low, high )( rng );
+      };
+      vector<uint64_t> placed; // candidates for cancellation, some of them will have been filled
+      uint64_t limit_count = 0;
+      workload.reserve( ops );
+      for( uint64_t i = 0; i < ops; ++i )
+      {
+         workload_op wop;
+         const int64_t dice = uniform( 0, 99 );
+         if( dice < 5 )
+         {
+            wop.kind = workload_op::feed;
+            wop.amount = uniform( 800, 1150 );
+            wop.receive = 1000;
+         }
+         else if( dice < 8 )
+         {
+            wop.kind = workload_op::settle;
+            wop.trader = uniform( 0, traders - 1 );
+            wop.amount = uniform( 1000, 100000 );
+         }
+         else if( dice < 30 && !placed.empty() )
+         {
+            wop.kind = workload_op::cancel;
+            const size_t pick = uniform( 0, placed.size() - 1 );
+            wop.target = placed[pick];
+            placed[pick] = placed.back();
+            placed.pop_back();
+         }
+         else
+         {
+            wop.trader = uniform( 0, traders - 1 );
+            wop.market = uniform( 0, markets );
+            wop.sell_core = uniform( 0, 1 ) != 0;
+            wop.amount = uniform( 10000, 200000 );
+            // Roughly one order in ten crosses the spread
+            wop.receive = wop.amount * ( 1000 + uniform( -int64_t(depth) / 10 - 1, depth ) ) / 1000;
+            wop.receive = std::max<int64_t>( wop.receive, 1 );
+            placed.push_back( limit_count++ );
+         }
+         workload.push_back( wop );
+      }
+   }
+   if( record_file != nullptr )
+      write_workload( record_file, workload );
+
+   latency_stats limit_stats;
+   latency_stats cancel_stats;
+   latency_stats feed_stats;
+   latency_stats settle_stats;
+   vector<optional<limit_order_id_type>> orders;
+   uint64_t skipped = 0;
+   uint64_t skipped_settles = 0;
+   const auto start = fc::time_point::now();
+   for( const auto& wop : workload )
+   {
+      const auto op_start = fc::time_point::now();
+      if( wop.kind == workload_op::limit )
+      {
+         auto result = apply_op( make_limit( wop ) );
+         const limit_order_id_type id( result.operation_results[0].get<object_id_type>() );
+         orders.emplace_back( id );
+         limit_stats.add( ( fc::time_point::now() - op_start ).count() );
+      }
+      else if( wop.kind == workload_op::cancel )
+      {
+         if( wop.target >= orders.size() || !orders[wop.target].valid()
+               || db.find( *orders[wop.target] ) == nullptr )
+         {
+            ++skipped;
+            continue;
+         }
+         limit_order_cancel_operation op;
+         op.order = *orders[wop.target];
+         op.fee_paying_account = op.order( db ).seller;
+         apply_op( op );
+         orders[wop.target].reset();
+         cancel_stats.add( ( fc::time_point::now() - op_start ).count() );
+      }
+      else if( wop.kind == workload_op::settle )
+      {
+         // the trader may have sold the asset meanwhile
+         if( db.get_balance( trader_ids[wop.trader], usd_id ).amount < wop.amount )
+         {
+            ++skipped_settles;
+            continue;
+         }
+         asset_settle_operation op;
+         op.account = trader_ids[wop.trader];
+         op.amount = asset( wop.amount, usd_id );
+         apply_op( op );
+         settle_stats.add( ( fc::time_point::now() - op_start ).count() );
+      }
+      else
+      {
+         asset_publish_feed_operation op;
+         op.publisher = trader_ids[0];
+         op.asset_id = usd_id;
+         op.feed = feed;
+         op.feed.settlement_price = asset( wop.amount, usd_id ) / asset( wop.receive );
+         apply_op( op );
+         feed_stats.add( ( fc::time_point::now() - op_start ).count() );
+      }
+   }
+   const auto elapsed = fc::time_point::now() - start;
+
+   // The settle orders are executed against the call orders by the blocks they come due in
+   const auto& settlements = db.get_index_type<force_settlement_index>().indices();
+   const size_t settle_orders = settlements.size();
+   const auto settle_start = fc::time_point::now();
+   generate_blocks( db.head_block_time() + settlement_delay );
+   const auto settle_elapsed = fc::time_point::now() - settle_start;
+
+   const uint64_t applied = workload.size() - skipped - skipped_settles;
+   wlog( "Benchmark: ${n} market ops in ${s}ms, ${ops}/s, ${k} cancels of filled orders and ${u} settles of sold "
+         "assets skipped",
+         ("n",applied)("s",elapsed.count() / 1000)
+         ("ops",elapsed.count() > 0 ? applied * 1000000 / elapsed.count() : 0)
+         ("k",skipped)("u",skipped_settles) );
+   limit_stats.report( "limit_order_create" );
+   cancel_stats.report( "limit_order_cancel" );
+   feed_stats.report( "asset_publish_feed" );
+   settle_stats.report( "asset_settle" );
+   wlog( "Benchmark: ${e} of ${n} settle orders executed in ${s}ms",
+         ("e",settle_orders - settlements.size())("n",settle_orders)("s",settle_elapsed.count() / 1000) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
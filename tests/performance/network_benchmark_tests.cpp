@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2019 BitShares Blockchain Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/database.hpp>
+
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/node.hpp>
+
+#include <fc/thread/thread.hpp>
+
+#include "../common/database_fixture.hpp"
+#include "../common/env_util.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <memory>
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+using namespace graphene::net;
+
+namespace {
+
+   /// Notes when each block and transaction reaches a node of the simulated network
+   class recording_node_delegate : public node_delegate
+   {
+      public:
+         std::map<fc::ripemd160, fc::time_point> arrivals;
+
+         bool has_item( const item_id& id ) override { return false; }
+         bool handle_block( const block_message& blk_msg, bool sync_mode,
+                            std::vector<fc::uint160_t>& contained_transaction_message_ids ) override
+         {
+            arrivals[blk_msg.block_id] = fc::time_point::now();
+            return false;
+         }
+         void handle_transaction( const trx_message& trx_msg ) override
+         {
+            arrivals[trx_msg.trx.id()] = fc::time_point::now();
+         }
+         void handle_message( const message& message_to_process ) override {}
+         std::vector<item_hash_t> get_block_ids( const std::vector<item_hash_t>& blockchain_synopsis,
+                                                 uint32_t& remaining_item_count, uint32_t limit ) override
+         {
+            remaining_item_count = 0;
+            return std::vector<item_hash_t>();
+         }
+         message get_item( const item_id& id ) override
+         {
+            FC_THROW_EXCEPTION( fc::key_not_found_exception, "Benchmark nodes don't serve items" );
+         }
+         chain_id_type get_chain_id()const override { return chain_id_type(); }
+         std::vector<item_hash_t> get_blockchain_synopsis( const item_hash_t& reference_point,
+                                                           uint32_t number_of_blocks_after_reference_point ) override
+         {
+            return std::vector<item_hash_t>();
+         }
+         void sync_status( uint32_t item_type, uint32_t item_count ) override {}
+         void connection_count_changed( uint32_t c ) override {}
+         uint32_t get_block_number( const item_hash_t& block_id ) override { return block_header::num_from_id( block_id ); }
+         fc::time_point_sec get_block_time( const item_hash_t& block_id ) override { return fc::time_point_sec::min(); }
+         item_hash_t get_head_block_id()const override { return item_hash_t(); }
+         uint32_t estimate_last_known_fork_from_git_revision_timestamp( uint32_t unix_timestamp )const override { return 0; }
+         void error_encountered( const std::string& message, const fc::oexception& error ) override {}
+         uint8_t get_current_block_interval_in_seconds()const override { return GRAPHENE_DEFAULT_BLOCK_INTERVAL; }
+   };
+
+   /// Collects propagation delays in microseconds
+   class delay_stats
+   {
+      public:
+         void add( int64_t usecs ) { _samples.push_back( usecs ); }
+
+         void report( const string& name, uint64_t expected )
+         {
+            std::sort( _samples.begin(), _samples.end() );
+            const auto percentile = [this]( size_t p ) {
+               return _samples.empty() ? 0 : _samples[ std::min( _samples.size() - 1, _samples.size() * p / 100 ) ];
+            };
+            wlog( "Benchmark: ${n} ${c} of ${e} delivered, p50 ${p50}us, p90 ${p90}us, p99 ${p99}us, max ${max}us",
+                  ("n",name)("c",_samples.size())("e",expected)
+                  ("p50",percentile(50))("p90",percentile(90))("p99",percentile(99))
+                  ("max",_samples.empty() ? 0 : _samples.back()) );
+         }
+
+      private:
+         vector<int64_t> _samples;
+   };
+
+}
+
+BOOST_FIXTURE_TEST_SUITE( performance_tests, database_fixture )
+
+/**
+ * Produces blocks full of transfers and broadcasts every transaction and block over a
+ * simulated_network to a number of nodes, then reports how long they took to arrive and
+ * the traffic per node. Finally a node that joins late is sent all blocks to measure the
+ * time it needs to sync. Sizes and link properties are taken from the environment, see
+ * README.md.
+ */
+BOOST_AUTO_TEST_CASE( network_benchmark )
+{ try {
+   const uint32_t node_count    = std::max<uint64_t>( env_or_default( "GRAPHENE_BENCH_NODES", 20 ), 1 );
+   const uint32_t blocks        = env_or_default( "GRAPHENE_BENCH_BLOCKS", 50 );
+   const uint32_t trx_per_block = env_or_default( "GRAPHENE_BENCH_TRX_PER_BLOCK", 100 );
+   const uint64_t latency_ms    = env_or_default( "GRAPHENE_BENCH_LATENCY_MS", 100 );
+   const uint64_t bandwidth     = env_or_default( "GRAPHENE_BENCH_BANDWIDTH", 1000000 );
+   const uint64_t loss_permille = env_or_default( "GRAPHENE_BENCH_LOSS_PERMILLE", 0 );
+   const uint64_t seed          = env_or_default( "GRAPHENE_BENCH_SEED", 1 );
+
+   ACTORS( (alice)(bob) );
+   fund( alice, asset( 100000000000ll ) );
+   generate_block();
+
+   simulated_link_parameters link;
+   link.latency = fc::milliseconds( latency_ms );
+   link.bytes_per_second = bandwidth;
+   link.loss_rate = std::min( loss_permille, uint64_t(1000) ) / 1000.0;
+   link.random_seed = seed;
+
+   // The nodes run on their own thread, so that deliveries are not held up while blocks are produced
+   fc::thread network_thread( "simulated network" );
+   vector<std::unique_ptr<recording_node_delegate>> nodes;
+   std::unique_ptr<simulated_network> network;
+   std::unique_ptr<recording_node_delegate> late_node;
+   std::unique_ptr<simulated_network> sync_network;
+   network_thread.async( [&]() {
+      network.reset( new simulated_network( "network benchmark" ) );
+      network->set_link_parameters( link );
+      for( uint32_t i = 0; i < node_count; ++i )
+      {
+         nodes.emplace_back( new recording_node_delegate );
+         network->add_node_delegate( nodes.back().get() );
+      }
+   } ).wait();
+   const auto broadcast = [&network_thread]( simulated_network& net, const message& msg ) {
+      network_thread.async( [&net, &msg]() { net.broadcast( msg ); } ).wait();
+   };
+   const auto wait_for_deliveries = [&network_thread]( simulated_network& net ) {
+      const auto in_flight = [&net]() {
+         uint64_t result = 0;
+         for( const auto& link_statistics : net.get_link_statistics() )
+            result += link_statistics.messages_in_flight;
+         return result;
+      };
+      while( network_thread.async( in_flight ).wait() > 0 )
+         fc::usleep( fc::milliseconds( 10 ) );
+   };
+
+   std::map<fc::ripemd160, fc::time_point> sent_blocks;
+   std::map<fc::ripemd160, fc::time_point> sent_transactions;
+   vector<signed_block> produced_blocks;
+   int64_t transfer_amount = 0;
+   const fc::time_point start = fc::time_point::now();
+   for( uint32_t b = 0; b < blocks; ++b )
+   {
+      for( uint32_t t = 0; t < trx_per_block; ++t )
+      {
+         signed_transaction tx;
+         transfer_operation op;
+         op.from = alice_id;
+         op.to = bob_id;
+         op.amount = asset( ++transfer_amount );
+         tx.operations.push_back( op );
+         for( auto& o : tx.operations ) db.current_fee_schedule().set_fee( o );
+         set_expiration( db, tx );
+         sign( tx, alice_private_key );
+         PUSH_TX( db, tx );
+         sent_transactions[tx.id()] = fc::time_point::now();
+         broadcast( *network, trx_message( tx ) );
+      }
+      produced_blocks.push_back( generate_block() );
+      sent_blocks[produced_blocks.back().id()] = fc::time_point::now();
+      broadcast( *network, block_message( produced_blocks.back() ) );
+   }
+   wait_for_deliveries( *network );
+   const fc::microseconds elapsed = fc::time_point::now() - start;
+
+   delay_stats block_delays;
+   delay_stats trx_delays;
+   for( const auto& node : nodes )
+      for( const auto& arrival : node->arrivals )
+      {
+         auto itr = sent_blocks.find( arrival.first );
+         if( itr != sent_blocks.end() )
+            block_delays.add( ( arrival.second - itr->second ).count() );
+         else
+         {
+            itr = sent_transactions.find( arrival.first );
+            if( itr != sent_transactions.end() )
+               trx_delays.add( ( arrival.second - itr->second ).count() );
+         }
+      }
+   block_delays.report( "block propagation", uint64_t(blocks) * node_count );
+   trx_delays.report( "transaction propagation", uint64_t(blocks) * trx_per_block * node_count );
+
+   const auto link_statistics = network_thread.async( [&network]() { return network->get_link_statistics(); } ).wait();
+   uint64_t min_bytes = std::numeric_limits<uint64_t>::max();
+   uint64_t max_bytes = 0;
+   uint64_t total_bytes = 0;
+   uint64_t dropped = 0;
+   for( const auto& s : link_statistics )
+   {
+      min_bytes = std::min( min_bytes, s.bytes_delivered );
+      max_bytes = std::max( max_bytes, s.bytes_delivered );
+      total_bytes += s.bytes_delivered;
+      dropped += s.messages_dropped;
+   }
+   const uint64_t elapsed_us = std::max<int64_t>( elapsed.count(), 1 );
+   wlog( "Benchmark: ${n} nodes, ${t}ms, per node ${min} to ${max} bytes/s, average ${avg} bytes/s, ${d} messages dropped",
+         ("n",node_count)("t",elapsed.count() / 1000)
+         ("min",min_bytes * 1000000 / elapsed_us)("max",max_bytes * 1000000 / elapsed_us)
+         ("avg",total_bytes * 1000000 / elapsed_us / link_statistics.size())("d",dropped) );
+
+   // A node that missed all of the above receives the blocks back to back
+   network_thread.async( [&]() {
+      sync_network.reset( new simulated_network( "network benchmark sync" ) );
+      sync_network->set_link_parameters( link );
+      late_node.reset( new recording_node_delegate );
+      sync_network->add_node_delegate( late_node.get() );
+   } ).wait();
+   const fc::time_point sync_start = fc::time_point::now();
+   for( const auto& block : produced_blocks )
+      broadcast( *sync_network, block_message( block ) );
+   wait_for_deliveries( *sync_network );
+   wlog( "Benchmark: synced ${c} of ${b} blocks in ${t}ms",
+         ("c",late_node->arrivals.size())("b",produced_blocks.size())
+         ("t",( fc::time_point::now() - sync_start ).count() / 1000) );
+
+   network_thread.async( [&]() {
+      network.reset();
+      sync_network.reset();
+   } ).wait();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -26,6 +26,7 @@
 
 #include "../common/database_fixture.hpp"
 
+#include <graphene/app/api_rate_limiter.hpp>
 #include <graphene/app/util.hpp>
 
 using namespace graphene::chain;
@@ -278,4 +279,76 @@ BOOST_AUTO_TEST_CASE(price_to_string_verify)
    }
 }
 
+BOOST_AUTO_TEST_CASE(api_rate_limiter_budgets)
+{
+   api_rate_limiter::options_type options;
+   options.connection_rate = 1;
+   options.connection_burst = 10;
+   options.address_rate = 1;
+   options.address_burst = 15;
+   options.method_costs["get_objects"] = 4;
+   api_rate_limiter limiter( options );
+
+   BOOST_CHECK_EQUAL( limiter.cost_of( "get_objects" ), 4u );
+   BOOST_CHECK_EQUAL( limiter.cost_of( "get_full_accounts" ), 10u );
+   BOOST_CHECK_EQUAL( limiter.cost_of( "get_chain_id" ), 1u );
+
+   // the connection bucket holds 10 units
+   api_token_bucket first;
+   limiter.admit( first, "1.2.3.4", 4 );
+   limiter.admit( first, "1.2.3.4", 4 );
+   BOOST_CHECK_THROW( limiter.admit( first, "1.2.3.4", 4 ), fc::exception );
+
+   // the other connection of the address has its own budget, the address one is shared
+   api_token_bucket second;
+   limiter.admit( second, "1.2.3.4", 4 );
+   BOOST_CHECK_THROW( limiter.admit( second, "1.2.3.4", 4 ), fc::exception );
+   // a connection of another address is not limited by that
+   limiter.admit( second, "5.6.7.8", 2 );
+   // nor is one of an unknown address
+   api_token_bucket third;
+   limiter.admit( third, "", 10 );
+
+   // a call costing more than the bucket holds is admitted once it is full
+   api_token_bucket fourth;
+   limiter.admit( fourth, "", 20 );
+   BOOST_CHECK_THROW( limiter.admit( fourth, "", 1 ), fc::exception );
+
+   const api_rate_limit_statistics stats = limiter.get_statistics();
+   BOOST_CHECK_EQUAL( stats.admitted_calls, 6u );
+   BOOST_CHECK_EQUAL( stats.rejected_calls, 3u );
+   BOOST_CHECK_EQUAL( stats.delayed_calls, 0u );
+   BOOST_CHECK_EQUAL( stats.tracked_addresses, 2u );
+}
+
+BOOST_AUTO_TEST_CASE(api_rate_limiter_delays)
+{
+   api_rate_limiter::options_type options;
+   options.connection_rate = 100;
+   options.connection_burst = 1;
+   options.policy = api_rate_limiter::policy_type::delay;
+   options.max_delay_ms = 50;
+   api_rate_limiter limiter( options );
+
+   api_token_bucket bucket;
+   limiter.admit( bucket, "", 1 );
+   // waits about 10ms for the next unit
+   const fc::time_point start = fc::time_point::now();
+   limiter.admit( bucket, "", 1 );
+   BOOST_CHECK_GE( ( fc::time_point::now() - start ).count(), 5000 );
+
+   const api_rate_limit_statistics stats = limiter.get_statistics();
+   BOOST_CHECK_EQUAL( stats.admitted_calls, 2u );
+   BOOST_CHECK_EQUAL( stats.delayed_calls, 1u );
+   BOOST_CHECK_EQUAL( stats.rejected_calls, 0u );
+
+   // a call which would wait 100ms is rejected
+   options.connection_rate = 10;
+   api_rate_limiter slow_limiter( options );
+   api_token_bucket slow_bucket;
+   slow_limiter.admit( slow_bucket, "", 1 );
+   BOOST_CHECK_THROW( slow_limiter.admit( slow_bucket, "", 1 ), fc::exception );
+   BOOST_CHECK_EQUAL( slow_limiter.get_statistics().rejected_calls, 1u );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
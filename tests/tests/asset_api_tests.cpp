@@ -60,6 +60,57 @@ BOOST_AUTO_TEST_CASE( asset_holders )
    BOOST_CHECK(holders[2].name == "alice");
    BOOST_CHECK(holders[3].name == "dan");
 }
+BOOST_AUTO_TEST_CASE( asset_holders_index )
+{ try {
+   graphene::app::asset_api asset_api(app);
+   const string core_id = std::string( static_cast<object_id_type>(asset_id_type()) );
+
+   auto dan = create_account("dan");
+   auto bob = create_account("bob");
+   auto alice = create_account("alice");
+
+   transfer(account_id_type()(db), dan, asset(100));
+   transfer(account_id_type()(db), alice, asset(200));
+   transfer(account_id_type()(db), bob, asset(300));
+
+   BOOST_CHECK_EQUAL( asset_api.get_asset_holders_count( core_id ), 4 );
+
+   // pages are taken at an offset into the holders ordered by balance
+   vector<account_asset_balance> holders = asset_api.get_asset_holders( core_id, 1, 2 );
+   BOOST_REQUIRE_EQUAL( holders.size(), 2u );
+   BOOST_CHECK( holders[0].name == "bob" );
+   BOOST_CHECK_EQUAL( holders[0].amount.value, 300 );
+   BOOST_CHECK( holders[1].name == "alice" );
+   BOOST_CHECK( asset_api.get_asset_holders( core_id, 4, 10 ).empty() );
+
+   // balances that change order or drop to zero are followed
+   transfer(account_id_type()(db), dan, asset(250));
+   transfer(alice, account_id_type()(db), asset(200));
+   BOOST_CHECK_EQUAL( asset_api.get_asset_holders_count( core_id ), 3 );
+   holders = asset_api.get_asset_holders( core_id, 1, 10 );
+   BOOST_REQUIRE_EQUAL( holders.size(), 2u );
+   BOOST_CHECK( holders[0].name == "dan" );
+   BOOST_CHECK( holders[1].name == "bob" );
+
+   // and so are blocks popped from the chain
+   generate_block();
+   transfer(bob, dan, asset(300));
+   generate_block();
+   BOOST_CHECK_EQUAL( asset_api.get_asset_holders_count( core_id ), 2 );
+   db.pop_block();
+   BOOST_CHECK_EQUAL( asset_api.get_asset_holders_count( core_id ), 3 );
+
+   bool found = false;
+   for( const auto& ah : asset_api.get_all_asset_holders() )
+   {
+      if( ah.asset_id != asset_id_type() )
+         continue;
+      found = true;
+      BOOST_CHECK_EQUAL( ah.count, 3 );
+   }
+   BOOST_CHECK( found );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( api_limit_get_asset_holders )
 {
    graphene::app::asset_api asset_api(app);
@@ -2249,4 +2249,82 @@ BOOST_AUTO_TEST_CASE( self_deleting_proposal )
    db.get<proposal_object>(pid1);
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( authority_check_cache )
+{ try {
+   ACTORS( (alice)(bob) );
+   fund( alice );
+   generate_block();
+
+   const fc::ecc::private_key new_key = generate_private_key( "new" );
+
+   auto transfer = [&]( const fc::ecc::private_key& key, int64_t amount ) {
+      trx.clear();
+      set_expiration( db, trx );
+      transfer_operation to;
+      to.amount = asset( amount );
+      to.from = alice_id;
+      to.to = bob_id;
+      trx.operations.push_back( to );
+      sign( trx, key );
+      PUSH_TX( db, trx );
+   };
+
+   // the successful check is remembered
+   transfer( alice_private_key, 1 );
+   transfer( alice_private_key, 2 );
+   generate_block();
+
+   account_update_operation auo;
+   auo.account = alice_id;
+   auo.active = authority( 1, public_key_type( new_key.get_public_key() ), 1 );
+   trx.clear();
+   set_expiration( db, trx );
+   trx.operations.push_back( auo );
+   sign( trx, alice_private_key );
+   PUSH_TX( db, trx );
+
+   GRAPHENE_REQUIRE_THROW( transfer( alice_private_key, 3 ), tx_missing_active_auth );
+   transfer( new_key, 4 );
+   generate_block();
+
+   // undoing the update brings back the old key
+   db.pop_block();
+   GRAPHENE_REQUIRE_THROW( transfer( new_key, 5 ), tx_missing_active_auth );
+   transfer( alice_private_key, 6 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( proposal_authority_check_cache )
+{ try {
+   ACTORS( (alice)(bob) );
+
+   transfer_operation top;
+   top.from = alice_id;
+   top.to = bob_id;
+   top.amount = asset(1);
+   const proposal_object& prop = db.create<proposal_object>( [&]( proposal_object& p ) {
+      p.proposer = alice_id;
+      p.proposed_transaction.operations.push_back( top );
+      p.required_active_approvals.insert( alice_id );
+   });
+
+   auto& cache = db.get_authority_check_cache();
+   cache.clear();
+   BOOST_CHECK( !prop.is_authorized_to_execute( db ) );
+   BOOST_CHECK_EQUAL( 0u, cache.size() );
+
+   db.modify( prop, [&]( proposal_object& p ) {
+      p.available_active_approvals.insert( alice_id );
+   });
+   BOOST_CHECK( prop.is_authorized_to_execute( db ) );
+   BOOST_CHECK_EQUAL( 1u, cache.size() );
+   BOOST_CHECK( prop.is_authorized_to_execute( db ) );
+   BOOST_CHECK_EQUAL( 1u, cache.size() );
+
+   // a check without the approval is not answered by the remembered one
+   db.modify( prop, [&]( proposal_object& p ) {
+      p.available_active_approvals.clear();
+   });
+   BOOST_CHECK( !prop.is_authorized_to_execute( db ) );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
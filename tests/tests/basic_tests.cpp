@@ -29,11 +29,13 @@
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/exceptions.hpp>
+#include <graphene/chain/impacted.hpp>
 
 #include <graphene/db/simple_index.hpp>
 
 #include <fc/crypto/digest.hpp>
 #include <fc/crypto/hex.hpp>
+#include <fc/io/raw.hpp>
 #include "../common/database_fixture.hpp"
 
 #include <algorithm>
@@ -368,6 +370,9 @@ BOOST_AUTO_TEST_CASE( memo_test )
       BOOST_FAIL("Memo format has changed. Notify the web guys and update this test.");
    }
    BOOST_CHECK_EQUAL(m.get_message(receiver, sender.get_public_key()), "Hello, world!");
+   BOOST_CHECK_EQUAL(m.get_message(receiver.get_shared_secret(sender.get_public_key())), "Hello, world!");
+   BOOST_CHECK_EQUAL(m.get_message(sender.get_shared_secret(receiver.get_public_key())), "Hello, world!");
+   GRAPHENE_REQUIRE_THROW(m.get_message(sender.get_shared_secret(sender.get_public_key())), fc::exception);
 } FC_LOG_AND_RETHROW() }
 
 BOOST_AUTO_TEST_CASE( exceptions )
@@ -590,6 +595,13 @@ BOOST_AUTO_TEST_CASE( merkle_root )
    block.transactions.push_back( tx[9] );
    block.clear();
    BOOST_CHECK( block.calculate_merkle_root() == c(dO) );
+
+   // same tree from precomputed digests
+   block.clear();
+   BOOST_CHECK( block.calculate_merkle_root( vector<digest_type>( t.begin(), t.begin() + 10 ) ) == c(dO) );
+   block.clear();
+   GRAPHENE_REQUIRE_THROW( block.calculate_merkle_root( vector<digest_type>( t.begin(), t.begin() + 9 ) ),
+                           fc::exception );
 }
 
 /**
@@ -607,4 +619,127 @@ BOOST_AUTO_TEST_CASE( bitasset_feed_expiration_test )
    BOOST_CHECK( !o.feed_is_expired( now ) );
 }
 
+BOOST_AUTO_TEST_CASE( signature_cache_test )
+{ try {
+   signature_cache cache( 2 );
+   const auto key = generate_private_key( "cache" );
+   vector< digest_type > digests;
+   vector< signature_type > sigs;
+   for( int i = 0; i < 3; ++i )
+   {
+      digests.push_back( digest_type::hash( fc::to_string( i ) ) );
+      sigs.push_back( key.sign_compact( digests.back() ) );
+   }
+
+   for( int i = 0; i < 3; ++i )
+      BOOST_CHECK( cache.recover( sigs[i], digests[i] ) == public_key_type( key.get_public_key() ) );
+   BOOST_CHECK_EQUAL( 2u, cache.size() );
+   // a signature of a different digest yields a different key
+   BOOST_CHECK( cache.recover( sigs[2], digests[1] ) != public_key_type( key.get_public_key() ) );
+   BOOST_CHECK_EQUAL( 2u, cache.size() );
+   BOOST_CHECK( cache.recover( sigs[2], digests[2] ) == public_key_type( key.get_public_key() ) );
+
+   cache.set_capacity( 0 );
+   BOOST_CHECK_EQUAL( 0u, cache.size() );
+   BOOST_CHECK( cache.recover( sigs[0], digests[0] ) == public_key_type( key.get_public_key() ) );
+   BOOST_CHECK_EQUAL( 0u, cache.size() );
+
+   // batches mix cached and new signatures
+   cache.set_capacity( 10 );
+   cache.recover( sigs[1], digests[1] );
+   vector< signature_cache::request > requests;
+   for( int i = 0; i < 3; ++i )
+      requests.push_back( { sigs[i], digests[i], public_key_type() } );
+   cache.recover( requests );
+   for( const auto& r : requests )
+      BOOST_CHECK( r.key == public_key_type( key.get_public_key() ) );
+   BOOST_CHECK_EQUAL( 3u, cache.size() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( operation_footprint_test )
+{ try {
+   auto transfer = []( uint64_t from, uint64_t to, asset_id_type fee_asset ) {
+      transfer_operation op;
+      op.from = account_id_type( from );
+      op.to = account_id_type( to );
+      op.amount = asset( 1 );
+      op.fee = asset( 1, fee_asset );
+      operation_footprint result;
+      operation_get_footprint( op, result );
+      return result;
+   };
+   const asset_id_type uia( 1 );
+
+   BOOST_CHECK( !transfer( 10, 11, asset_id_type() ).conflicts_with( transfer( 12, 13, asset_id_type() ) ) );
+   BOOST_CHECK( transfer( 10, 11, asset_id_type() ).conflicts_with( transfer( 11, 13, asset_id_type() ) ) );
+   // both pay their fee through the fee pool of the same asset
+   BOOST_CHECK( transfer( 10, 11, uia ).conflicts_with( transfer( 12, 13, uia ) ) );
+   BOOST_CHECK( !transfer( 10, 11, uia ).conflicts_with( transfer( 12, 13, asset_id_type() ) ) );
+
+   limit_order_create_operation loc;
+   loc.seller = account_id_type( 20 );
+   loc.amount_to_sell = asset( 1, uia );
+   loc.min_to_receive = asset( 1 );
+   operation_footprint order;
+   operation_get_footprint( loc, order );
+   BOOST_CHECK( order.markets.find( std::make_pair( asset_id_type(), uia ) ) != order.markets.end() );
+   // filled orders pay other traders
+   BOOST_CHECK( order.conflicts_with( transfer( 12, 13, asset_id_type() ) ) );
+
+   operation_footprint proposal;
+   operation_get_footprint( proposal_create_operation(), proposal );
+   BOOST_CHECK( proposal.unknown );
+   BOOST_CHECK( proposal.conflicts_with( operation_footprint() ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( pending_transaction_pool_test )
+{ try {
+   auto make_trx = []( uint64_t from, share_type fee, uint32_t expiration ) {
+      transfer_operation op;
+      op.from = account_id_type( from );
+      op.to = account_id_type( 1 );
+      op.fee = asset( fee );
+      processed_transaction trx;
+      trx.operations.push_back( op );
+      trx.expiration = fc::time_point_sec( expiration );
+      return trx;
+   };
+   pending_transaction_pool pool;
+   const auto a1 = make_trx( 10, 100, 1000 );
+   const auto a2 = make_trx( 10, 10000, 2000 );
+   const auto b1 = make_trx( 11, 1000, 2000 );
+   for( const auto& trx : { a1, a2, b1 } )
+      BOOST_CHECK( pool.push_back( trx, trx.id(), trx.operations.front().get<transfer_operation>().fee.amount ) );
+   BOOST_CHECK( !pool.push_back( a1, a1.id(), 100 ) );
+   BOOST_REQUIRE_EQUAL( 3u, pool.size() );
+   const size_t trx_size = fc::raw::pack_size( a1 );
+   BOOST_CHECK_EQUAL( 3 * trx_size, pool.total_size() );
+   BOOST_REQUIRE( pool.find( b1.id() ) != nullptr );
+   BOOST_CHECK( pool.find( b1.id() )->fee_payer == account_id_type( 11 ) );
+
+   // everything fits, so the order is kept
+   auto selected = pool.select( pool.total_size() );
+   BOOST_REQUIRE_EQUAL( 3u, selected.size() );
+   BOOST_CHECK( selected[0]->id == a1.id() );
+   BOOST_CHECK( selected[1]->id == a2.id() );
+   BOOST_CHECK( selected[2]->id == b1.id() );
+
+   // the best paying transaction has to wait behind the earlier one of the same account
+   selected = pool.select( 2 * trx_size );
+   BOOST_REQUIRE_EQUAL( 2u, selected.size() );
+   BOOST_CHECK( selected[0]->id == b1.id() );
+   BOOST_CHECK( selected[1]->id == a1.id() );
+
+   BOOST_CHECK( pool.remove( b1.id() ) );
+   BOOST_CHECK( !pool.remove( b1.id() ) );
+   BOOST_CHECK_EQUAL( 1u, pool.remove_expired( fc::time_point_sec( 1500 ) ) );
+   BOOST_CHECK_EQUAL( trx_size, pool.total_size() );
+
+   const auto released = pool.release();
+   BOOST_REQUIRE_EQUAL( 1u, released.size() );
+   BOOST_CHECK( released[0].id() == a2.id() );
+   BOOST_CHECK( pool.empty() );
+   BOOST_CHECK_EQUAL( 0u, pool.total_size() );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -25,6 +25,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include <graphene/chain/database.hpp>
+#include <graphene/chain/db_with.hpp>
 #include <graphene/chain/exceptions.hpp>
 
 #include <graphene/chain/account_object.hpp>
@@ -36,10 +37,17 @@
 #include <graphene/chain/witness_schedule_object.hpp>
 #include <graphene/chain/witness_object.hpp>
 
+#include <graphene/app/plugin.hpp>
+
+#include <graphene/net/core_messages.hpp>
+
 #include <graphene/utilities/tempdir.hpp>
 
 #include <fc/crypto/digest.hpp>
 
+#include <atomic>
+#include <thread>
+
 #include "../common/database_fixture.hpp"
 
 using namespace graphene::chain;
@@ -107,7 +115,11 @@ BOOST_AUTO_TEST_CASE( block_database_test )
          auto blk = bdb.fetch_by_number( i );
          FC_ASSERT( blk.valid() );
          FC_ASSERT( blk->witness == witness_id_type(blk->block_num()) );
+         auto header = bdb.fetch_header( i );
+         FC_ASSERT( header.valid() );
+         FC_ASSERT( header->digest() == blk->digest() );
       }
+      FC_ASSERT( !bdb.fetch_header( 6 ).valid() );
 
       auto last = bdb.last();
       FC_ASSERT( last );
@@ -132,6 +144,395 @@ BOOST_AUTO_TEST_CASE( block_database_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( block_database_concurrent_reads )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+
+      clearable_block b;
+      vector<block_id_type> ids;
+      for( uint32_t i = 0; i < 20; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+      }
+      BOOST_CHECK_EQUAL( bdb.total_block_size(), fc::file_size( data_dir.path() / "blocks" ) );
+
+      std::atomic<uint32_t> failures{0};
+      vector<std::thread> readers;
+      for( uint32_t t = 0; t < 4; ++t )
+         readers.emplace_back( [&bdb,&ids,&failures,t]() {
+            for( uint32_t round = 0; round < 50; ++round )
+               for( uint32_t i = 0; i < ids.size(); ++i )
+               {
+                  const uint32_t num = ( i + t * 5 ) % ids.size() + 1;
+                  auto blk = bdb.fetch_by_number( num );
+                  if( !blk.valid() || blk->id() != ids[num-1] || !bdb.contains( ids[num-1] )
+                        || bdb.fetch_block_id( num ) != ids[num-1] )
+                     ++failures;
+               }
+         });
+      for( auto& reader : readers )
+         reader.join();
+      BOOST_CHECK_EQUAL( 0u, failures.load() );
+
+      // packed blocks are returned as stored and can be sent without unpacking them
+      auto blk = bdb.fetch_by_number( 3 );
+      BOOST_REQUIRE( blk.valid() );
+      auto packed = bdb.fetch_packed( 3 );
+      BOOST_REQUIRE( packed.valid() );
+      BOOST_CHECK( *packed == fc::raw::pack( *blk ) );
+      BOOST_CHECK( !bdb.fetch_packed( ids[4] ).valid() ); // not the ID of block 3
+      packed = bdb.fetch_packed( ids[2] );
+      BOOST_REQUIRE( packed.valid() );
+      const graphene::net::message expected( graphene::net::block_message( *blk ) );
+      const auto msg = graphene::net::block_message::from_packed_block( std::move( *packed ), ids[2] );
+      BOOST_CHECK_EQUAL( expected.msg_type.value(), msg.msg_type.value() );
+      BOOST_CHECK( expected.data == msg.data );
+      BOOST_CHECK_EQUAL( expected.size.value(), msg.size.value() );
+
+      bdb.remove( ids.back() );
+      BOOST_CHECK( !bdb.contains( ids.back() ) );
+      BOOST_CHECK( !bdb.fetch_packed( ids.size() ).valid() );
+      BOOST_CHECK( !bdb.fetch_optional( ids.back() ).valid() );
+      BOOST_CHECK( bdb.fetch_optional( ids.front() ).valid() );
+      BOOST_CHECK( !bdb.fetch_by_number( ids.size() + 1 ).valid() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_segments )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path(), 10 );
+      BOOST_CHECK_EQUAL( 10u, bdb.blocks_per_segment() );
+
+      clearable_block b;
+      vector<block_id_type> ids;
+      for( uint32_t i = 0; i < 25; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+      }
+      BOOST_CHECK( fc::exists( data_dir.path() / "blocks.1" ) );
+      BOOST_CHECK( fc::exists( data_dir.path() / "index.2" ) );
+      BOOST_CHECK( !fc::exists( data_dir.path() / "index.3" ) );
+      BOOST_CHECK_EQUAL( bdb.total_block_size(), fc::file_size( data_dir.path() / "blocks" )
+                                                 + fc::file_size( data_dir.path() / "blocks.1" )
+                                                 + fc::file_size( data_dir.path() / "blocks.2" ) );
+
+      // the segment size of an existing database is kept
+      bdb.close();
+      bdb.open( data_dir.path() );
+      BOOST_CHECK_EQUAL( 10u, bdb.blocks_per_segment() );
+      for( uint32_t i = 1; i <= 25; ++i )
+      {
+         auto blk = bdb.fetch_by_number( i );
+         BOOST_REQUIRE( blk.valid() );
+         BOOST_CHECK( blk->id() == ids[i-1] );
+         BOOST_CHECK( bdb.contains( ids[i-1] ) );
+      }
+      BOOST_REQUIRE( bdb.last_id().valid() );
+      BOOST_CHECK( *bdb.last_id() == ids.back() );
+
+      // removing the newest blocks makes last() fall back to the previous segment
+      for( uint32_t i = 20; i <= 25; ++i )
+         bdb.remove( ids[i-1] );
+      BOOST_REQUIRE( bdb.last_id().valid() );
+      BOOST_CHECK( *bdb.last_id() == ids[18] );
+
+      // archived segments are reported as missing
+      bdb.close();
+      fc::remove( data_dir.path() / "blocks" );
+      fc::remove( data_dir.path() / "index" );
+      bdb.open( data_dir.path() );
+      BOOST_CHECK( !bdb.fetch_by_number( 5 ).valid() );
+      BOOST_CHECK( !bdb.contains( ids[4] ) );
+      BOOST_CHECK( bdb.fetch_by_number( 15 ).valid() );
+      BOOST_REQUIRE( bdb.last_id().valid() );
+      BOOST_CHECK( *bdb.last_id() == ids[18] );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_pruning )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path(), 10 );
+
+      clearable_block b;
+      vector<block_id_type> ids;
+      for( uint32_t i = 0; i < 35; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+      }
+      BOOST_CHECK_EQUAL( 1u, bdb.first_available_block_num() );
+
+      // only whole segments are removed, block 20 is in the same segment as block 25
+      bdb.remove_blocks_before( 25 );
+      BOOST_CHECK_EQUAL( 20u, bdb.first_available_block_num() );
+      BOOST_CHECK( !fc::exists( data_dir.path() / "blocks.1" ) );
+      BOOST_CHECK( !bdb.fetch_by_number( 19 ).valid() );
+      BOOST_CHECK( !bdb.contains( ids[0] ) );
+      BOOST_CHECK( bdb.fetch_by_number( 20 ).valid() );
+      BOOST_CHECK( bdb.fetch_by_number( 35 ).valid() );
+
+      bdb.close();
+      bdb.open( data_dir.path() );
+      BOOST_CHECK_EQUAL( 20u, bdb.first_available_block_num() );
+      BOOST_REQUIRE( bdb.last_id().valid() );
+      BOOST_CHECK( *bdb.last_id() == ids.back() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( applied_operation_log_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto make_ops = []( int64_t amount ) {
+         transfer_operation t;
+         t.amount = asset( amount );
+         vector<optional<operation_history_object>> ops;
+         ops.emplace_back( operation_history_object( t ) );
+         ops.back()->result = void_result();
+         ops.emplace_back(); // removed by the chain, not stored
+         ops.emplace_back( operation_history_object( t ) );
+         ops.back()->virtual_op = 1;
+         return ops;
+      };
+
+      vector<block_id_type> ids;
+      clearable_block b;
+      {
+         applied_operation_log log;
+         log.open( data_dir.path() );
+         BOOST_CHECK( log.is_open() );
+         for( uint32_t i = 0; i < 5; ++i )
+         {
+            if( i > 0 ) b.previous = b.id();
+            b.witness = witness_id_type(i+1);
+            b.clear();
+            ids.push_back( b.id() );
+            log.store( b.id(), make_ops( i + 1 ) );
+         }
+         BOOST_CHECK_EQUAL( log.last_block_num(), 5u );
+         const auto ops = log.fetch( 3 );
+         BOOST_REQUIRE( ops.valid() );
+         BOOST_REQUIRE_EQUAL( ops->size(), 2u );
+         BOOST_CHECK_EQUAL( (*ops)[0].op.get<transfer_operation>().amount.amount.value, 3 );
+         BOOST_CHECK_EQUAL( (*ops)[1].virtual_op, 1u );
+         BOOST_CHECK( !log.fetch( 0 ).valid() );
+         BOOST_CHECK( !log.fetch( 6 ).valid() );
+
+         // applying a block again does not store it twice
+         const auto size = fc::file_size( data_dir.path() / "operations" );
+         log.store( ids[4], make_ops( 5 ) );
+         BOOST_CHECK_EQUAL( fc::file_size( data_dir.path() / "operations" ), size );
+      }
+
+      applied_operation_log log;
+      log.open( data_dir.path() );
+      BOOST_CHECK_EQUAL( log.last_block_num(), 5u );
+      BOOST_REQUIRE( log.fetch_block_id( 5 ).valid() );
+      BOOST_CHECK( *log.fetch_block_id( 5 ) == ids[4] );
+
+      // a block of another fork drops the higher blocks
+      clearable_block fork;
+      fork.previous = ids[1];
+      fork.witness = witness_id_type(10);
+      fork.clear();
+      log.store( fork.id(), make_ops( 30 ) );
+      BOOST_CHECK_EQUAL( log.last_block_num(), 3u );
+      BOOST_CHECK( !log.fetch( 4 ).valid() );
+      BOOST_REQUIRE( log.fetch( 3 ).valid() );
+      BOOST_CHECK_EQUAL( log.fetch( 3 )->front().op.get<transfer_operation>().amount.amount.value, 30 );
+      BOOST_CHECK_EQUAL( log.fetch( 2 )->front().op.get<transfer_operation>().amount.amount.value, 2 );
+
+      // blocks stored after a gap
+      b.previous = fork.id();
+      for( uint32_t i = 4; i < 8; ++i )
+      {
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         b.previous = b.id();
+      }
+      b.clear();
+      log.store( b.id(), make_ops( 8 ) );
+      BOOST_CHECK_EQUAL( log.last_block_num(), b.block_num() );
+      BOOST_CHECK( !log.fetch( b.block_num() - 1 ).valid() );
+      BOOST_CHECK( log.fetch( b.block_num() ).valid() );
+
+      // an index without the operations is dropped
+      log.close();
+      fc::remove( data_dir.path() / "operations" );
+      applied_operation_log recovered;
+      recovered.open( data_dir.path() );
+      BOOST_CHECK_EQUAL( recovered.last_block_num(), 0u );
+      BOOST_CHECK( !recovered.fetch( 2 ).valid() );
+      recovered.store( ids[0], make_ops( 1 ) );
+      BOOST_CHECK_EQUAL( recovered.last_block_num(), 1u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( applied_operations_of_the_chain )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      {
+         database db;
+         db.enable_applied_operation_log( true );
+         db.open(data_dir.path(), make_genesis, "TEST" );
+         for( uint32_t i = 0; i < 10; ++i )
+            db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                               database::skip_nothing );
+         for( uint32_t n = 1; n <= db.head_block_num(); ++n )
+            BOOST_CHECK( db.fetch_applied_operations( n ).valid() );
+         BOOST_CHECK( !db.fetch_applied_operations( db.head_block_num() + 1 ).valid() );
+         db.close();
+      }
+      {
+         database db;
+         db.open(data_dir.path(), []{return genesis_state_type();}, "TEST");
+         // not read while disabled
+         BOOST_CHECK( !db.fetch_applied_operations( 1 ).valid() );
+      }
+      database db;
+      db.enable_applied_operation_log( true );
+      db.open(data_dir.path(), []{return genesis_state_type();}, "TEST");
+      BOOST_CHECK( db.fetch_applied_operations( 1 ).valid() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( replay_profile )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis, "TEST" );
+         for( uint32_t i = 0; i < 10; ++i )
+         {
+            transfer_operation t;
+            t.to = account_id_type(1);
+            t.amount = asset( i + 1 );
+            signed_transaction trx;
+            set_expiration( db, trx );
+            trx.operations.push_back( t );
+            PUSH_TX( db, trx, ~0 );
+            db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, ~0 );
+         }
+         BOOST_CHECK( db.get_replay_profile() == nullptr );
+         db.close();
+      }
+      database db;
+      db.enable_replay_profile( true );
+      // a different version wipes the object database and replays the blocks, the transfers are not signed
+      graphene::chain::detail::with_skip_flags( db, database::skip_transaction_signatures, [&data_dir,&db]() {
+         db.open(data_dir.path(), []{return genesis_state_type();}, "TEST2");
+      });
+      const replay_profile* profile = db.get_replay_profile();
+      BOOST_REQUIRE( profile != nullptr );
+      BOOST_CHECK_EQUAL( 10u, profile->blocks );
+      BOOST_CHECK_EQUAL( 10u, profile->transactions );
+      const auto& transfers = profile->operations[ operation::tag<transfer_operation>::value ];
+      BOOST_CHECK_EQUAL( "graphene::protocol::transfer_operation", transfers.name );
+      BOOST_CHECK_EQUAL( 10u, transfers.count );
+      BOOST_CHECK_LE( transfers.total_ns, profile->transactions_ns );
+      BOOST_CHECK_LE( profile->apply_ns(), profile->total_ns );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( block_timing, database_fixture )
+{ try {
+   ACTORS( (alice) );
+   transfer( account_id_type(), alice_id, asset( 1000 ) );
+   const signed_block block = generate_block();
+
+   const auto& timing = db.get_block_timing();
+   BOOST_CHECK_EQUAL( block.block_num(), timing.block_num );
+   BOOST_CHECK_EQUAL( block.transactions.size(), timing.transactions );
+   BOOST_CHECK_GT( timing.apply_ns, 0 );
+   BOOST_CHECK_EQUAL( timing.apply_ns, timing.header_ns + timing.transactions_ns + timing.block_updates_ns
+                                       + timing.maintenance_ns + timing.expiry_ns + timing.batched_indexes_ns
+                                       + timing.applied_block_ns + timing.changed_objects_ns );
+   BOOST_CHECK_GE( timing.push_ns, timing.apply_ns );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( load_large_genesis )
+{
+   try {
+      genesis_state_type genesis_state = make_genesis();
+      for( int i = 0; i < 3000; ++i )
+      {
+         auto key = fc::ecc::private_key::regenerate( fc::digest(i) ).get_public_key();
+         genesis_state.initial_accounts.emplace_back( "target" + fc::to_string(i), key );
+         genesis_state.initial_balances.push_back( { address( key ), GRAPHENE_SYMBOL, i + 1 } );
+      }
+
+      const string json = fc::json::to_string( genesis_state );
+      const genesis_state_type loaded = load_genesis_state( json, 20 );
+      BOOST_CHECK_EQUAL( json, fc::json::to_string( loaded ) );
+      BOOST_CHECK_EQUAL( 3010u, loaded.initial_accounts.size() );
+      BOOST_CHECK_EQUAL( 3000u, loaded.initial_balances.size() );
+      GRAPHENE_REQUIRE_THROW( load_genesis_state( "[]", 20 ), fc::exception );
+
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      database db;
+      db.open( data_dir.path(), [&loaded]{ return loaded; }, "TEST" );
+      const auto& accounts_by_name = db.get_index_type<account_index>().indices().get<by_name>();
+      const account_object& init0 = *accounts_by_name.find( "init0" );
+      BOOST_CHECK( init0.is_lifetime_member() );
+      BOOST_CHECK( init0.referrer == init0.get_id() );
+      const account_object& target = *accounts_by_name.find( "target1234" );
+      BOOST_CHECK( !target.is_lifetime_member() );
+      BOOST_CHECK( target.registrar == GRAPHENE_TEMP_ACCOUNT );
+      BOOST_CHECK( target.referrer == GRAPHENE_COMMITTEE_ACCOUNT );
+      BOOST_CHECK( target.statistics(db).owner == target.get_id() );
+      BOOST_CHECK( target.active == target.owner );
+      BOOST_CHECK_EQUAL( 3010u, db.get_dynamic_global_properties().accounts_registered_this_interval );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( generate_empty_blocks )
 {
    try {
@@ -191,6 +592,94 @@ BOOST_AUTO_TEST_CASE( generate_empty_blocks )
    }
 }
 
+BOOST_AUTO_TEST_CASE( state_of_another_chain_is_rejected )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+
+      uint32_t saved_block_num;
+      {
+         database db;
+         db.open( data_dir1.path(), make_genesis, "TEST" );
+         while( db.get_dynamic_global_properties().last_irreversible_block_num < 5 )
+            db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                               database::skip_nothing );
+         saved_block_num = db.get_dynamic_global_properties().last_irreversible_block_num;
+         db.close();
+      }
+      {
+         // different block times, so the blocks of the same height have different IDs
+         database db;
+         db.open( data_dir2.path(), make_genesis, "TEST" );
+         while( db.head_block_num() < saved_block_num + 5 )
+            db.generate_block( db.get_slot_time(2), db.get_scheduled_witness(2), init_account_priv_key,
+                               database::skip_nothing );
+         db.close();
+      }
+
+      // as if the chain state of the first chain had been written before a dirty shutdown of the second
+      fc::remove_all( data_dir2.path() / "object_database" );
+      fc::rename( data_dir1.path() / "object_database", data_dir2.path() / "object_database" );
+      {
+         database db;
+         GRAPHENE_REQUIRE_THROW( db.open( data_dir2.path(), make_genesis, "TEST" ), fc::exception );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( binary_snapshot )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+      fc::temp_directory snapshot_dir( graphene::utilities::temp_directory_path() );
+      const fc::path snapshot = snapshot_dir.path() / "snapshot";
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+
+      database db1;
+      db1.open( data_dir1.path(), make_genesis, "TEST" );
+      for( uint32_t i = 0; i < 20; ++i )
+         db1.generate_block( db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key,
+                             database::skip_nothing );
+      db1.save_snapshot( snapshot, "TEST" );
+      GRAPHENE_REQUIRE_THROW( db1.save_snapshot( snapshot, "TEST" ), fc::exception );
+
+      std::vector<signed_block> later_blocks;
+      for( uint32_t i = 0; i < 5; ++i )
+         later_blocks.push_back( db1.generate_block( db1.get_slot_time(1), db1.get_scheduled_witness(1),
+                                                     init_account_priv_key, database::skip_nothing ) );
+
+      database db2;
+      GRAPHENE_REQUIRE_THROW( db2.load_snapshot( snapshot, data_dir2.path(), "OTHER", db1.get_chain_id() ),
+                              fc::exception );
+      GRAPHENE_REQUIRE_THROW( db2.load_snapshot( snapshot, data_dir2.path(), "TEST", chain_id_type() ),
+                              fc::exception );
+      const auto info = db2.load_snapshot( snapshot, data_dir2.path(), "TEST", db1.get_chain_id() );
+      BOOST_CHECK_EQUAL( info.head_block.block_num(), 20u );
+
+      db2.open( data_dir2.path(), []{return genesis_state_type();}, "TEST" );
+      BOOST_CHECK_EQUAL( db2.head_block_num(), 20u );
+      BOOST_CHECK( db2.head_block_id() == db1.get_block_id_for_num( 20 ) );
+      BOOST_CHECK( db2.get_chain_id() == db1.get_chain_id() );
+      BOOST_CHECK_EQUAL( db2.first_available_block_num(), 20u );
+      BOOST_CHECK( !db2.fetch_block_by_number( 19 ).valid() );
+
+      // continues with the blocks following the snapshot
+      for( const auto& b : later_blocks )
+         PUSH_BLOCK( db2, b );
+      BOOST_CHECK( db2.head_block_id() == db1.head_block_id() );
+      BOOST_CHECK( db2.get_dynamic_global_properties().current_aslot
+                   == db1.get_dynamic_global_properties().current_aslot );
+      BOOST_CHECK_EQUAL( db2.get_index( protocol_ids, account_object_type ).object_count(),
+                         db1.get_index( protocol_ids, account_object_type ).object_count() );
+   } FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( undo_block )
 {
    try {
@@ -356,6 +845,50 @@ BOOST_AUTO_TEST_CASE( change_signing_key_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( checkpoint_sync )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+
+      database db1;
+      db1.open(data_dir1.path(), make_genesis, "TEST");
+      database db2;
+      db2.open(data_dir2.path(), make_genesis, "TEST");
+
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      vector<signed_block> blocks;
+      for( uint32_t i = 1; i <= 5; ++i )
+         blocks.push_back( db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1),
+                                              init_account_priv_key, database::skip_nothing) );
+
+      flat_map<uint32_t,block_id_type> checkpoints;
+      checkpoints[5] = blocks.back().id();
+      db2.add_checkpoints( checkpoints );
+      BOOST_CHECK( db2.checkpoint_skip_flags( 1 ) & database::skip_transaction_signatures );
+      BOOST_CHECK( db2.checkpoint_skip_flags( 5 ) & database::skip_witness_signature );
+      BOOST_CHECK( !( db2.checkpoint_skip_flags( 5 ) & database::skip_merkle_check ) );
+      BOOST_CHECK_EQUAL( db2.checkpoint_skip_flags( 6 ), uint32_t(database::skip_nothing) );
+
+      // the id does not cover the transactions, a block below the checkpoint must still match its merkle root
+      signed_block tampered = blocks.front();
+      tampered.transactions.emplace_back( signed_transaction() );
+      tampered.transactions.back().operations.emplace_back( transfer_operation() );
+      // unpacking drops the merkle root cached by generate_block
+      tampered = fc::raw::unpack<signed_block>( fc::raw::pack( tampered ) );
+      BOOST_CHECK( tampered.id() == blocks.front().id() );
+      GRAPHENE_CHECK_THROW( PUSH_BLOCK( db2, tampered ), fc::exception );
+      BOOST_CHECK_EQUAL( db2.head_block_num(), 0u );
+
+      for( const auto& b : blocks )
+         PUSH_BLOCK( db2, b );
+      BOOST_CHECK( db2.head_block_id() == db1.head_block_id() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( fork_blocks )
 {
    try {
@@ -476,6 +1009,62 @@ BOOST_AUTO_TEST_CASE( fork_blocks )
 }
 
 
+BOOST_AUTO_TEST_CASE( fork_db_branches )
+{
+   try {
+      fork_database fdb;
+      std::vector<signed_block> main_chain;
+      signed_block b;
+      fdb.start_block( b );
+      main_chain.push_back( b );
+      for( uint32_t i = 2; i <= 300; ++i )
+      {
+         signed_block next;
+         next.previous = main_chain.back().id();
+         fdb.push_block( next );
+         main_chain.push_back( next );
+      }
+      BOOST_REQUIRE_EQUAL( fdb.head()->num, 300u );
+
+      // fork off after block 100, distinguished from the main chain by its timestamps
+      block_id_type fork_head = main_chain[99].id();
+      for( uint32_t i = 101; i <= 250; ++i )
+      {
+         signed_block next;
+         next.previous = fork_head;
+         next.timestamp = fc::time_point_sec( i );
+         fdb.push_block( next );
+         fork_head = next.id();
+      }
+      BOOST_CHECK_EQUAL( fdb.head()->num, 300u );
+
+      for( uint32_t num : { 1u, 2u, 37u, 64u, 100u, 255u, 299u, 300u } )
+      {
+         auto ancestor = fdb.fetch_ancestor( fdb.head(), num );
+         BOOST_REQUIRE( ancestor );
+         BOOST_CHECK( ancestor->id == main_chain[num - 1].id() );
+      }
+      BOOST_CHECK( !fdb.fetch_ancestor( fdb.head(), 301 ) );
+
+      auto branches = fdb.fetch_branch_from( fdb.head()->id, fork_head );
+      BOOST_REQUIRE_EQUAL( branches.first.size(), 200u );
+      BOOST_REQUIRE_EQUAL( branches.second.size(), 150u );
+      BOOST_CHECK_EQUAL( branches.first.front()->num, 300u );
+      BOOST_CHECK_EQUAL( branches.second.front()->num, 250u );
+      BOOST_CHECK( branches.first.back()->id == main_chain[100].id() );
+      BOOST_CHECK( branches.first.back()->previous_id() == main_chain[99].id() );
+      BOOST_CHECK( branches.second.back()->previous_id() == main_chain[99].id() );
+      for( size_t i = 1; i < branches.second.size(); ++i )
+         BOOST_CHECK( branches.second[i-1]->previous_id() == branches.second[i]->id );
+
+      // one block is an ancestor of the other
+      branches = fdb.fetch_branch_from( fdb.head()->id, main_chain[149].id() );
+      BOOST_CHECK_EQUAL( branches.first.size(), 151u );
+      BOOST_REQUIRE_EQUAL( branches.second.size(), 1u );
+      BOOST_CHECK( branches.first.back() == branches.second.front() );
+   } FC_LOG_AND_RETHROW()
+}
+
 /**
  *  These test has been disabled, out of order blocks should result in the node getting disconnected.
  *  
@@ -496,11 +1085,11 @@ BOOST_AUTO_TEST_CASE( fork_db_tests )
         prev = b;
      }
      auto head = fdb.head();
-     FC_ASSERT( head && head->data.block_num() == 1799 );
+     FC_ASSERT( head && head->data->block_num() == 1799 );
 
      fdb.push_block(skipped_block);
      head = fdb.head();
-     FC_ASSERT( head && head->data.block_num() == 2001, "", ("head",head->data.block_num()) );
+     FC_ASSERT( head && head->data->block_num() == 2001, "", ("head",head->data->block_num()) );
   } FC_LOG_AND_RETHROW() 
 }
 BOOST_AUTO_TEST_CASE( out_of_order_blocks )
@@ -846,6 +1435,90 @@ BOOST_FIXTURE_TEST_CASE( optional_tapos, database_fixture )
    }
 }
 
+namespace {
+   /// a plugin that records the blocks its block consumer is given
+   class block_consumer_test_plugin : public graphene::app::plugin
+   {
+      public:
+         void start( uint32_t queue_size )
+         {
+            consume_blocks( [this]( const graphene::app::applied_block_data& b ) {
+               std::lock_guard<std::mutex> guard( mutex );
+               blocks.push_back( b.block.block_num() );
+               operations += b.operations.size();
+               if( b.block.block_num() % 3 == 0 )
+                  FC_THROW( "failing block" );
+            }, queue_size );
+         }
+         void stop() { stop_consuming_blocks(); }
+
+         std::mutex       mutex;
+         vector<uint32_t> blocks;
+         size_t           operations = 0;
+   };
+}
+
+BOOST_FIXTURE_TEST_CASE( block_consumer, database_fixture )
+{
+   try {
+      block_consumer_test_plugin consumer;
+      consumer.plugin_set_app( &app );
+      consumer.start( 2 );
+
+      const uint32_t first = db.head_block_num() + 1;
+      ACTOR( alice );
+      generate_blocks( 10 );
+      consumer.stop();
+      // not given blocks any more
+      generate_block();
+
+      BOOST_REQUIRE_EQUAL( consumer.blocks.size(), 10u );
+      for( uint32_t i = 0; i < consumer.blocks.size(); ++i )
+         BOOST_CHECK_EQUAL( consumer.blocks[i], first + i );
+      BOOST_CHECK_GT( consumer.operations, 0u );
+
+      const auto metrics = consumer.get_block_consumer_metrics();
+      BOOST_CHECK_EQUAL( metrics.blocks_processed + metrics.blocks_failed, 10u );
+      BOOST_CHECK_GT( metrics.blocks_failed, 0u );
+      BOOST_CHECK_EQUAL( metrics.backlog, 0u );
+      BOOST_CHECK_LE( metrics.max_backlog, 2u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( debug_fork_and_discard, database_fixture )
+{ try {
+   ACTORS( (alice) );
+   generate_block();
+   const uint32_t fork_point = db.head_block_num();
+   const block_id_type fork_point_id = db.head_block_id();
+   const int64_t alice_balance = get_balance( alice_id, asset_id_type() );
+
+   GRAPHENE_REQUIRE_THROW( db.debug_discard_fork(), fc::exception );
+   db.debug_start_fork();
+   GRAPHENE_REQUIRE_THROW( db.debug_start_fork(), fc::exception );
+
+   transfer( account_id_type(), alice_id, asset(1000) );
+   // more blocks than it takes to make the fork point irreversible
+   generate_blocks( 30 );
+   BOOST_CHECK_GT( db.get_dynamic_global_properties().last_irreversible_block_num, fork_point );
+   BOOST_CHECK_EQUAL( alice_balance + 1000, get_balance( alice_id, asset_id_type() ) );
+
+   BOOST_CHECK_EQUAL( 30u, db.debug_discard_fork() );
+   BOOST_CHECK_EQUAL( fork_point, db.head_block_num() );
+   BOOST_CHECK( fork_point_id == db.head_block_id() );
+   BOOST_CHECK_EQUAL( alice_balance, get_balance( alice_id, asset_id_type() ) );
+   BOOST_CHECK( !db.fetch_block_by_number( fork_point + 1 ).valid() );
+
+   // the chain goes on from the fork point
+   generate_block();
+   BOOST_CHECK_EQUAL( fork_point + 1, db.head_block_num() );
+   db.debug_start_fork();
+   BOOST_CHECK_EQUAL( 0u, db.debug_discard_fork() );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_FIXTURE_TEST_CASE( maintenance_interval, database_fixture )
 {
    try {
@@ -1847,6 +2520,41 @@ BOOST_FIXTURE_TEST_CASE( temp_account_balance, database_fixture )
    BOOST_CHECK( get_balance( GRAPHENE_TEMP_ACCOUNT, asset_id_type() ) > 0 );
 } FC_LOG_AND_RETHROW() }
 
+BOOST_FIXTURE_TEST_CASE( precheck_transaction, database_fixture )
+{ try {
+   ACTORS( (alice) );
+   fund( alice );
+
+   generate_block();
+   set_expiration( db, trx );
+
+   transfer_operation top;
+   top.amount = asset( 1000 );
+   top.from = alice_id;
+   top.to   = GRAPHENE_COMMITTEE_ACCOUNT;
+   trx.operations.push_back( top );
+   sign( trx, alice_private_key );
+
+   db.precheck_transaction( trx );
+   PUSH_TX( db, trx );
+
+   // the pending transaction is now a duplicate
+   GRAPHENE_REQUIRE_THROW( db.precheck_transaction( trx ), duplicate_transaction );
+
+   signed_transaction expired = trx;
+   expired.expiration = db.head_block_time() - fc::seconds(1);
+   GRAPHENE_REQUIRE_THROW( db.precheck_transaction( expired ), fc::exception );
+
+   signed_transaction too_far = trx;
+   too_far.expiration = db.head_block_time()
+                        + db.get_global_properties().parameters.maximum_time_until_expiration + 1;
+   GRAPHENE_REQUIRE_THROW( db.precheck_transaction( too_far ), fc::exception );
+
+   signed_transaction foreign = trx;
+   foreign.ref_block_prefix ^= 1;
+   GRAPHENE_REQUIRE_THROW( db.precheck_transaction( foreign ), fc::exception );
+} FC_LOG_AND_RETHROW() }
+
 ///
 /// This test case tries to
 /// * generate blocks when there are too many pending transactions,
@@ -1935,4 +2643,99 @@ BOOST_FIXTURE_TEST_CASE( block_size_test, database_fixture )
    }
 }
 
+BOOST_FIXTURE_TEST_CASE( evaluator_statistics_test, database_fixture )
+{
+   try {
+      ACTORS( (alice)(bob) );
+      if( !database::evaluator_profiling_enabled() )
+      {
+         BOOST_CHECK( db.get_evaluator_statistics().empty() );
+         return;
+      }
+
+      db.reset_evaluator_statistics();
+      BOOST_CHECK( db.get_evaluator_statistics().empty() );
+      transfer( account_id_type(), alice_id, asset( 10000 ) );
+      transfer( alice_id, bob_id, asset( 100 ) );
+      // fails in do_evaluate, which is counted but not applied
+      GRAPHENE_REQUIRE_THROW( transfer( bob_id, alice_id, asset( 1000 ) ), fc::exception );
+
+      const auto stats = db.get_evaluator_statistics();
+      BOOST_REQUIRE_EQUAL( 1u, stats.size() );
+      BOOST_CHECK_EQUAL( "graphene::protocol::transfer_operation", stats[0].operation );
+      BOOST_CHECK_EQUAL( 3u, stats[0].evaluations );
+      BOOST_CHECK_EQUAL( 2u, stats[0].applications );
+      BOOST_CHECK_LE( stats[0].evaluate_max_ns, stats[0].evaluate_total_ns );
+      BOOST_CHECK_LE( stats[0].apply_max_ns, stats[0].apply_total_ns );
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_FIXTURE_TEST_CASE( change_notifications_during_block, database_fixture )
+{
+   try {
+      ACTORS( (alice) );
+
+      uint32_t notifications = 0;
+      uint32_t notified_block = 0;
+      flat_set<account_id_type> impacted;
+      auto connection = db.changed_objects.connect( [&]( const vector<object_id_type>& ids,
+                                                         const flat_set<account_id_type>& accounts ) {
+         ++notifications;
+         notified_block = db.head_block_num();
+         impacted.insert( accounts.begin(), accounts.end() );
+      });
+
+      transfer( committee_account, alice_id, asset(1000) );
+      generate_block();
+      // the signal is emitted while the block is applied, with the state of that block
+      BOOST_CHECK_EQUAL( notifications, 1u );
+      BOOST_CHECK_EQUAL( notified_block, db.head_block_num() );
+      BOOST_CHECK( impacted.find( alice_id ) != impacted.end() );
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_FIXTURE_TEST_CASE( read_scope_refuses_writes, database_fixture )
+{
+   try {
+      {
+         graphene::chain::database::read_scope scope( db );
+         BOOST_CHECK( db.in_read_scope() );
+         GRAPHENE_REQUIRE_THROW( generate_block(), fc::exception );
+         {
+            graphene::chain::database::suspend_read_scope suspend( db );
+            BOOST_CHECK( !db.in_read_scope() );
+         }
+         BOOST_CHECK( db.in_read_scope() );
+      }
+      BOOST_CHECK( !db.in_read_scope() );
+      const uint32_t head = db.head_block_num();
+      generate_block();
+      BOOST_CHECK_EQUAL( db.head_block_num(), head + 1 );
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_FIXTURE_TEST_CASE( transaction_conflict_analysis, database_fixture )
+{
+   try {
+      ACTORS( (alice)(bob)(carol)(dave) );
+      transfer( committee_account, alice_id, asset(10000) );
+      transfer( committee_account, carol_id, asset(10000) );
+      generate_block();
+
+      db.enable_transaction_conflict_analysis( true );
+
+      // independent transfers only share the ID counters and the duplicate check, they can run in the same step
+      transfer( alice_id, bob_id, asset(100) );
+      transfer( carol_id, dave_id, asset(100) );
+      generate_block();
+      BOOST_CHECK_EQUAL( db.get_transaction_conflict_steps(), 1u );
+
+      // both transfers write the balance of bob
+      transfer( alice_id, bob_id, asset(100) );
+      transfer( bob_id, dave_id, asset(50) );
+      generate_block();
+      BOOST_CHECK_EQUAL( db.get_transaction_conflict_steps(), 2u );
+   } FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_SUITE_END()
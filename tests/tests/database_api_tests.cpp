@@ -24,11 +24,14 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <graphene/app/api.hpp>
 #include <graphene/app/database_api.hpp>
+#include <graphene/app/subscription_registry.hpp>
 #include <graphene/chain/hardfork.hpp>
 
 #include <fc/crypto/digest.hpp>
 #include <fc/crypto/hex.hpp>
+#include <fc/io/json.hpp>
 
 #include "../common/database_fixture.hpp"
 
@@ -75,6 +78,56 @@ BOOST_AUTO_TEST_CASE(is_registered)
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE( key_references_follow_key_changes )
+{
+   try {
+      fc::ecc::private_key old_key = generate_private_key("old");
+      fc::ecc::private_key new_key = generate_private_key("new");
+      public_key_type old_public( old_key.get_public_key() );
+      public_key_type new_public( new_key.get_public_key() );
+      const account_object& dan = create_account( "dan", old_public );
+      const account_id_type dan_id = dan.id;
+      create_account( "nathan", old_public );
+
+      graphene::app::database_api db_api(db, &(this->app.get_options()));
+      auto refs = db_api.get_key_references( { old_public, new_public } );
+      BOOST_REQUIRE_EQUAL( refs.size(), 2u );
+      BOOST_CHECK_EQUAL( refs[0].size(), 2u );
+      BOOST_CHECK( refs[0].find( dan_id ) != refs[0].end() );
+      BOOST_CHECK( refs[1].empty() );
+
+      account_update_operation op;
+      op.account = dan_id;
+      op.owner = authority( 1, new_public, 1 );
+      op.active = authority( 1, new_public, 1 );
+      op.new_options = dan.options;
+      op.new_options->memo_key = new_public;
+      trx.operations.push_back( op );
+      sign( trx, old_key );
+      PUSH_TX( db, trx, database::skip_transaction_dupe_check );
+      trx.clear();
+
+      refs = db_api.get_key_references( { old_public, new_public } );
+      BOOST_REQUIRE_EQUAL( refs[0].size(), 1u );
+      BOOST_CHECK( refs[0].find( dan_id ) == refs[0].end() );
+      BOOST_REQUIRE_EQUAL( refs[1].size(), 1u );
+      BOOST_CHECK( *refs[1].begin() == dan_id );
+
+      // a key that no account uses any longer is not registered
+      op.account = get_account( "nathan" ).id;
+      op.new_options = get_account( "nathan" ).options;
+      op.new_options->memo_key = new_public;
+      trx.operations.push_back( op );
+      sign( trx, old_key );
+      PUSH_TX( db, trx, database::skip_transaction_dupe_check );
+      trx.clear();
+
+      BOOST_CHECK( !db_api.is_public_key_registered( (string) old_public ) );
+      BOOST_CHECK( db_api.is_public_key_registered( (string) new_public ) );
+
+   } FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( get_potential_signatures_owner_and_active )
 {
    try {
@@ -786,6 +839,427 @@ BOOST_AUTO_TEST_CASE( subscription_key_collision_test )
    BOOST_CHECK_EQUAL( objects_changed, 0 ); // UIATEST did not change in this block, so no notification
 }
 
+BOOST_AUTO_TEST_CASE( shared_subscription_registry )
+{ try {
+   ACTORS( (alice)(bob) );
+   generate_block();
+
+   auto registry = std::make_shared<graphene::app::subscription_registry>( db );
+   graphene::app::database_api db_api1( db, &( app.get_options() ), nullptr, registry );
+   graphene::app::database_api db_api2( db, &( app.get_options() ), nullptr, registry );
+
+   uint32_t updates1 = 0;
+   uint32_t updates2 = 0;
+   db_api1.set_subscribe_callback( [&updates1]( const variant& ) { ++updates1; }, false );
+   db_api2.set_subscribe_callback( [&updates2]( const variant& ) { ++updates2; }, false );
+
+   db_api1.get_full_accounts( { "alice" }, true );
+   db_api2.get_objects( { bob_id } );
+   BOOST_CHECK_EQUAL( 2u, registry->subscribed_object_count() );
+
+   // only the session subscribed to alice is notified of the objects changed by a transfer to her
+   transfer( account_id_type(), alice_id, asset(1000) );
+   generate_block();
+   fc::usleep(fc::milliseconds(200)); // sleep a while to execute callback in another thread
+
+   BOOST_CHECK_GT( updates1, 0u );
+   BOOST_CHECK_EQUAL( 0u, updates2 );
+
+   db_api1.cancel_all_subscriptions();
+   BOOST_CHECK_EQUAL( 1u, registry->subscribed_object_count() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( shared_pending_transaction_notifications )
+{ try {
+   ACTORS( (alice) );
+   generate_block();
+
+   auto registry = std::make_shared<graphene::app::subscription_registry>( db );
+   graphene::app::database_api db_api1( db, &( app.get_options() ), nullptr, registry );
+   graphene::app::database_api db_api2( db, &( app.get_options() ), nullptr, registry );
+   graphene::app::database_api db_api3( db, &( app.get_options() ), nullptr, registry );
+
+   vector<variant> received1;
+   vector<variant> received2;
+   uint32_t received3 = 0;
+   db_api1.set_pending_transaction_callback( [&received1]( const variant& v ) { received1.push_back( v ); } );
+   db_api2.set_pending_transaction_callback( [&received2]( const variant& v ) { received2.push_back( v ); } );
+   db_api3.set_pending_transaction_callback( [&received3]( const variant& ) { ++received3; } );
+   db_api3.set_pending_transaction_callback( std::function<void(const variant&)>() );
+
+   transfer( account_id_type(), alice_id, asset(1000) );
+   fc::usleep(fc::milliseconds(200)); // sleep a while to execute callback in another thread
+
+   BOOST_REQUIRE_EQUAL( 1u, received1.size() );
+   BOOST_REQUIRE_EQUAL( 1u, received2.size() );
+   BOOST_CHECK_EQUAL( 0u, received3 );
+   BOOST_CHECK_EQUAL( fc::json::to_string( received1.front() ), fc::json::to_string( received2.front() ) );
+   signed_transaction received_trx = received1.front().as<signed_transaction>( GRAPHENE_MAX_NESTED_OBJECTS );
+   BOOST_REQUIRE_EQUAL( 1u, received_trx.operations.size() );
+   BOOST_CHECK( received_trx.operations.front().is_type<transfer_operation>() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( filtered_pending_transaction_notifications )
+{ try {
+   ACTORS( (alice)(bob) );
+   const asset_id_type uia_id = create_user_issued_asset( "PENDTEST" ).id;
+   generate_block();
+
+   auto registry = std::make_shared<graphene::app::subscription_registry>( db );
+   graphene::app::database_api by_account( db, &( app.get_options() ), nullptr, registry );
+   graphene::app::database_api by_type( db, &( app.get_options() ), nullptr, registry );
+   graphene::app::database_api by_asset( db, &( app.get_options() ), nullptr, registry );
+
+   uint32_t account_count = 0;
+   uint32_t type_count = 0;
+   uint32_t asset_count = 0;
+   graphene::app::pending_transaction_filter account_filter;
+   account_filter.accounts.insert( bob_id );
+   by_account.set_pending_transaction_callback( [&account_count]( const variant& ) { ++account_count; },
+                                                account_filter );
+   graphene::app::pending_transaction_filter type_filter;
+   type_filter.operation_types.insert( operation::tag<asset_issue_operation>::value );
+   by_type.set_pending_transaction_callback( [&type_count]( const variant& ) { ++type_count; }, type_filter );
+   graphene::app::pending_transaction_filter asset_filter;
+   asset_filter.assets.insert( uia_id );
+   by_asset.set_pending_transaction_callback( [&asset_count]( const variant& ) { ++asset_count; }, asset_filter );
+
+   transfer( account_id_type(), alice_id, asset(1000) );
+   fc::usleep(fc::milliseconds(200)); // sleep a while to execute callback in another thread
+   BOOST_CHECK_EQUAL( 0u, account_count );
+   BOOST_CHECK_EQUAL( 0u, type_count );
+   BOOST_CHECK_EQUAL( 0u, asset_count );
+
+   issue_uia( bob_id, asset( 100, uia_id ) );
+   fc::usleep(fc::milliseconds(200));
+   BOOST_CHECK_EQUAL( 1u, account_count );
+   BOOST_CHECK_EQUAL( 1u, type_count );
+   BOOST_CHECK_EQUAL( 1u, asset_count );
+
+   // without a filter all transactions are sent again
+   by_account.set_pending_transaction_callback( [&account_count]( const variant& ) { ++account_count; } );
+   transfer( account_id_type(), alice_id, asset(1000) );
+   fc::usleep(fc::milliseconds(200));
+   BOOST_CHECK_EQUAL( 2u, account_count );
+   BOOST_CHECK_EQUAL( 1u, type_count );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( get_objects_if_changed )
+{ try {
+   ACTORS( (alice) );
+   generate_block();
+
+   graphene::app::database_api db_api( db, &( app.get_options() ) );
+   const account_id_type missing( alice_id.instance.value + 1000 );
+   auto first = db_api.get_objects_if_changed( { alice_id, missing }, {} );
+   BOOST_REQUIRE_EQUAL( 2u, first.size() );
+   BOOST_CHECK( first[0].modified );
+   BOOST_CHECK_NE( 0u, first[0].version );
+   BOOST_CHECK_EQUAL( "alice", first[0].value["name"].as_string() );
+   BOOST_CHECK_EQUAL( 0u, first[1].version );
+   BOOST_CHECK( first[1].value.is_null() );
+
+   // the known version is not sent again
+   auto second = db_api.get_accounts_if_changed( { "alice" }, { first[0].version } );
+   BOOST_REQUIRE_EQUAL( 1u, second.size() );
+   BOOST_CHECK( !second[0].modified );
+   BOOST_CHECK_EQUAL( first[0].version, second[0].version );
+   BOOST_CHECK( second[0].value.is_null() );
+
+   upgrade_to_lifetime_member( alice_id );
+   auto third = db_api.get_objects_if_changed( { alice_id }, { first[0].version } );
+   BOOST_CHECK( third[0].modified );
+   BOOST_CHECK_NE( first[0].version, third[0].version );
+
+   // undoing a change gives the object yet another version
+   {
+      auto session = db._undo_db.start_undo_session();
+      db.modify( alice_id( db ), []( account_object& a ) { a.name = "undone"; } );
+      auto inside = db_api.get_objects_if_changed( { alice_id }, { third[0].version } );
+      BOOST_CHECK( inside[0].modified );
+      BOOST_CHECK_NE( third[0].version, inside[0].version );
+   }
+   auto undone = db_api.get_objects_if_changed( { alice_id }, { third[0].version } );
+   BOOST_CHECK( undone[0].modified );
+   BOOST_CHECK_EQUAL( "alice", undone[0].value["name"].as_string() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( market_depth_updates )
+{ try {
+   ACTORS( (alice)(bob) );
+   const asset_id_type uia_id = create_user_issued_asset( "DEPTHTEST" ).id;
+   issue_uia( alice_id, asset( 10000, uia_id ) );
+   transfer( committee_account, bob_id, asset( 10000 ) );
+   generate_block();
+
+   graphene::app::database_api db_api( db, &( app.get_options() ) );
+   vector<graphene::app::market_depth_update> updates;
+   db_api.subscribe_to_market_depth( [&updates]( const variant& v ) {
+      updates.push_back( v.as<graphene::app::market_depth_update>( GRAPHENE_MAX_NESTED_OBJECTS ) );
+   }, "DEPTHTEST", "1.3.0" );
+
+   // two bids at the same price are one level
+   create_sell_order( alice_id, asset( 100, uia_id ), asset( 200 ) );
+   create_sell_order( alice_id, asset( 50, uia_id ), asset( 100 ) );
+   generate_block();
+   fc::usleep(fc::milliseconds(200)); // sleep a while to execute callback in another thread
+
+   // the first update of a market holds the whole book
+   BOOST_REQUIRE_EQUAL( 1u, updates.size() );
+   BOOST_CHECK_EQUAL( 1u, updates[0].sequence );
+   BOOST_CHECK( updates[0].full );
+   BOOST_REQUIRE_EQUAL( 1u, updates[0].bids.size() );
+   BOOST_CHECK_EQUAL( uia_id(db).amount_to_string( share_type(150) ), updates[0].bids[0].base );
+   BOOST_CHECK( updates[0].asks.empty() );
+   BOOST_CHECK( updates[0].trades.empty() );
+
+   // bob takes 50 of the older bid
+   create_sell_order( bob_id, asset( 100 ), asset( 50, uia_id ) );
+   generate_block();
+   fc::usleep(fc::milliseconds(200));
+
+   BOOST_REQUIRE_EQUAL( 2u, updates.size() );
+   BOOST_CHECK_EQUAL( 2u, updates[1].sequence );
+   BOOST_REQUIRE_EQUAL( 1u, updates[1].bids.size() );
+   BOOST_CHECK_EQUAL( uia_id(db).amount_to_string( share_type(100) ), updates[1].bids[0].base );
+   BOOST_REQUIRE_EQUAL( 1u, updates[1].trades.size() );
+   BOOST_CHECK( updates[1].trades[0].side1_account_id == alice_id );
+   BOOST_CHECK( updates[1].trades[0].side2_account_id == bob_id );
+
+   graphene::app::market_depth_snapshot snapshot = db_api.get_market_depth( "DEPTHTEST", "1.3.0", 10 );
+   BOOST_CHECK_EQUAL( 2u, snapshot.sequence );
+   BOOST_REQUIRE_EQUAL( 1u, snapshot.bids.size() );
+   BOOST_CHECK_EQUAL( updates[1].bids[0].base, snapshot.bids[0].base );
+   BOOST_CHECK( snapshot.asks.empty() );
+
+   // the snapshot is of the last update, not of the pending transactions
+   create_sell_order( alice_id, asset( 10, uia_id ), asset( 20 ) );
+   snapshot = db_api.get_market_depth( "DEPTHTEST", "1.3.0", 10 );
+   BOOST_CHECK_EQUAL( 2u, snapshot.sequence );
+   BOOST_REQUIRE_EQUAL( 1u, snapshot.bids.size() );
+   BOOST_CHECK_EQUAL( updates[1].bids[0].base, snapshot.bids[0].base );
+
+   // replay
+   BOOST_CHECK_EQUAL( 2u, db_api.get_market_depth_updates( "DEPTHTEST", "1.3.0", 0 ).size() );
+   BOOST_CHECK_EQUAL( 1u, db_api.get_market_depth_updates( "DEPTHTEST", "1.3.0", 1 ).size() );
+   BOOST_CHECK( db_api.get_market_depth_updates( "DEPTHTEST", "1.3.0", 2 ).empty() );
+
+   db_api.unsubscribe_from_market_depth( "DEPTHTEST", "1.3.0" );
+   GRAPHENE_CHECK_THROW( db_api.get_market_depth_updates( "DEPTHTEST", "1.3.0", 0 ), fc::exception );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( ticker_best_prices )
+{ try {
+   ACTORS( (alice)(bob) );
+   const asset_id_type uia_id = create_user_issued_asset( "TICKTEST" ).id;
+   issue_uia( alice_id, asset( 10000, uia_id ) );
+   transfer( committee_account, bob_id, asset( 10000 ) );
+
+   // a trade creates the ticker
+   create_sell_order( alice_id, asset( 100, uia_id ), asset( 200 ) );
+   create_sell_order( bob_id, asset( 200 ), asset( 100, uia_id ) );
+   create_sell_order( alice_id, asset( 100, uia_id ), asset( 300 ) );
+   create_sell_order( alice_id, asset( 100, uia_id ), asset( 400 ) );
+   create_sell_order( bob_id, asset( 100 ), asset( 100, uia_id ) );
+   generate_block();
+
+   graphene::app::application_options options = app.get_options();
+   options.has_market_history_plugin = true;
+   graphene::app::database_api db_api( db, &options );
+
+   const graphene::app::order_book book = db_api.get_order_book( "1.3.0", "TICKTEST", 1 );
+   BOOST_REQUIRE_EQUAL( 1u, book.asks.size() );
+   BOOST_REQUIRE_EQUAL( 1u, book.bids.size() );
+   graphene::app::market_ticker ticker = db_api.get_ticker( "1.3.0", "TICKTEST" );
+   BOOST_CHECK_EQUAL( book.asks[0].price, ticker.lowest_ask );
+   BOOST_CHECK_EQUAL( book.bids[0].price, ticker.highest_bid );
+
+   const vector<graphene::app::market_ticker> top = db_api.get_top_markets( 1 );
+   BOOST_REQUIRE_EQUAL( 1u, top.size() );
+   BOOST_CHECK_EQUAL( ticker.lowest_ask, top[0].lowest_ask );
+   BOOST_CHECK_EQUAL( ticker.highest_bid, top[0].highest_bid );
+
+   // seen from the other side of the market
+   ticker = db_api.get_ticker( "TICKTEST", "1.3.0" );
+   const graphene::app::order_book reversed = db_api.get_order_book( "TICKTEST", "1.3.0", 1 );
+   BOOST_CHECK_EQUAL( reversed.asks[0].price, ticker.lowest_ask );
+   BOOST_CHECK_EQUAL( reversed.bids[0].price, ticker.highest_bid );
+
+   // the volume does not need the order books
+   BOOST_CHECK_EQUAL( ticker.base_volume, db_api.get_24_volume( "TICKTEST", "1.3.0" ).base_volume );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( api_profiler_counts_calls )
+{ try {
+   generate_blocks( 3 );
+
+   auto profiler = std::make_shared<graphene::app::api_profiler>( 0 );
+   fc::api<graphene::app::block_api> api = std::make_shared<graphene::app::block_api>( std::ref( db ) );
+   profiler->profile( api, "block_api" );
+
+   BOOST_CHECK_EQUAL( 3u, api->get_blocks( 1, 3 ).size() );
+   BOOST_CHECK_EQUAL( 1u, api->get_blocks( 2, 2 ).size() );
+   GRAPHENE_REQUIRE_THROW( api->get_blocks( 3, 2 ), fc::exception );
+
+   // a copy of the api shares the wrapped methods
+   fc::api<graphene::app::block_api> copy = api;
+   copy->get_blocks( 1, 1 );
+
+   const auto stats = profiler->get_method_statistics();
+   BOOST_REQUIRE_EQUAL( 1u, stats.size() );
+   BOOST_CHECK_EQUAL( "block_api", stats[0].api );
+   BOOST_CHECK_EQUAL( "get_blocks", stats[0].method );
+   BOOST_CHECK_EQUAL( 4u, stats[0].calls );
+   BOOST_CHECK_EQUAL( 1u, stats[0].failures );
+   BOOST_REQUIRE_EQUAL( graphene::app::api_profiler::histogram_buckets, stats[0].latency_histogram.size() );
+   uint64_t bucketed = 0;
+   for( uint64_t count : stats[0].latency_histogram )
+      bucketed += count;
+   BOOST_CHECK_EQUAL( 4u, bucketed );
+   BOOST_CHECK_GE( stats[0].total_time_us, stats[0].max_time_us );
+   // a threshold of 0 keeps no slow calls
+   BOOST_CHECK( profiler->get_slow_calls().empty() );
+
+   profiler->reset();
+   BOOST_CHECK( profiler->get_method_statistics().empty() );
+   api->get_blocks( 1, 1 );
+   BOOST_REQUIRE_EQUAL( 1u, profiler->get_method_statistics().size() );
+   BOOST_CHECK_EQUAL( 1u, profiler->get_method_statistics()[0].calls );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( block_tracer_statistics )
+{ try {
+   graphene::app::block_tracer tracer( 3, 0, fc::path() );
+   for( uint32_t i = 1; i <= 5; ++i )
+   {
+      graphene::app::block_trace trace;
+      trace.block_num = i;
+      trace.transactions_us = i * 1000;
+      trace.total_us = i * 2000;
+      tracer.record( trace );
+   }
+
+   // only the last 3 blocks are kept
+   const auto recent = tracer.get_recent_blocks( 10 );
+   BOOST_REQUIRE_EQUAL( 3u, recent.size() );
+   BOOST_CHECK_EQUAL( 5u, recent[0].block_num );
+   BOOST_CHECK_EQUAL( 3u, recent[2].block_num );
+   BOOST_CHECK_EQUAL( 1u, tracer.get_recent_blocks( 1 ).size() );
+
+   const auto stats = tracer.get_statistics();
+   const auto transactions = std::find_if( stats.begin(), stats.end(),
+         []( const graphene::app::block_stage_statistics& s ) { return s.stage == "transactions"; } );
+   BOOST_REQUIRE( transactions != stats.end() );
+   BOOST_CHECK_EQUAL( 3u, transactions->blocks );
+   BOOST_CHECK_EQUAL( 4000, transactions->average_us );
+   BOOST_CHECK_EQUAL( 5000, transactions->max_us );
+   BOOST_REQUIRE_EQUAL( size_t( graphene::app::block_tracer::histogram_buckets ),
+                        transactions->latency_histogram.size() );
+   BOOST_CHECK_EQUAL( 3u, transactions->latency_histogram[2] );
+
+   tracer.reset();
+   BOOST_CHECK( tracer.get_recent_blocks( 10 ).empty() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( trade_history_pages )
+{ try {
+   ACTORS( (alice)(bob) );
+   const asset_id_type uia_id = create_user_issued_asset( "TRADETEST" ).id;
+   issue_uia( alice_id, asset( 10000, uia_id ) );
+   transfer( committee_account, bob_id, asset( 10000 ) );
+
+   create_sell_order( alice_id, asset( 300, uia_id ), asset( 600 ) );
+   for( int i = 0; i < 3; ++i )
+   {
+      create_sell_order( bob_id, asset( 200 ), asset( 100, uia_id ) );
+      generate_block();
+   }
+
+   graphene::app::application_options options = app.get_options();
+   options.has_market_history_plugin = true;
+   graphene::app::database_api db_api( db, &options );
+
+   const vector<graphene::app::market_trade> trades = db_api.get_trade_history( "1.3.0", "TRADETEST",
+                                                         db.head_block_time() + 1, fc::time_point_sec(), 100 );
+   BOOST_REQUIRE_EQUAL( 3u, trades.size() );
+   for( const auto& trade : trades )
+   {
+      BOOST_CHECK_EQUAL( trades[0].price, trade.price );
+      BOOST_CHECK( trade.side1_account_id == alice_id ); // the maker
+      BOOST_CHECK( trade.side2_account_id == bob_id );
+      BOOST_CHECK_EQUAL( uia_id(db).amount_to_string( share_type(100) ), trade.amount );
+      BOOST_CHECK_EQUAL( asset_id_type()(db).amount_to_string( share_type(200) ), trade.value );
+   }
+   BOOST_CHECK_GT( trades[0].sequence, trades[1].sequence );
+
+   // the sequence of the last trade received continues the history
+   const vector<graphene::app::market_trade> rest = db_api.get_trade_history_by_sequence( "1.3.0", "TRADETEST",
+                                                       trades[0].sequence, fc::time_point_sec(), 100 );
+   BOOST_REQUIRE_EQUAL( 2u, rest.size() );
+   BOOST_CHECK_EQUAL( trades[1].sequence, rest[0].sequence );
+   BOOST_CHECK_EQUAL( trades[2].sequence, rest[1].sequence );
+   BOOST_CHECK_EQUAL( trades[1].date.sec_since_epoch(), rest[0].date.sec_since_epoch() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( applied_operations_notifications )
+{ try {
+   ACTORS( (alice)(bob) );
+   const asset_id_type uia_id = create_user_issued_asset( "OPSTEST" ).id;
+   issue_uia( alice_id, asset( 10000, uia_id ) );
+   transfer( committee_account, bob_id, asset( 10000 ) );
+   generate_block();
+
+   auto registry = std::make_shared<graphene::app::subscription_registry>( db );
+   graphene::app::database_api db_api1( db, &( app.get_options() ), nullptr, registry );
+   vector<graphene::app::applied_operations_notice> notices;
+   auto callback = [&notices]( const variant& v ) {
+      notices.push_back( v.as<graphene::app::applied_operations_notice>( GRAPHENE_MAX_NESTED_OBJECTS ) );
+   };
+   db_api1.set_applied_operations_callback( callback );
+
+   // the fills are virtual operations
+   create_sell_order( alice_id, asset( 100, uia_id ), asset( 200 ) );
+   create_sell_order( bob_id, asset( 200 ), asset( 100, uia_id ) );
+   generate_block();
+   const uint32_t fill_block_num = db.head_block_num();
+   generate_block();
+   fc::usleep(fc::milliseconds(200)); // sleep a while to execute callback in another thread
+
+   BOOST_REQUIRE_EQUAL( 2u, notices.size() );
+   BOOST_CHECK_EQUAL( fill_block_num, notices[0].block_num );
+   BOOST_CHECK( db.fetch_block_by_number( fill_block_num )->id() == notices[0].block_id );
+   size_t fills = 0;
+   for( const operation_history_object& op : notices[0].operations )
+   {
+      if( op.op.is_type<fill_order_operation>() )
+      {
+         ++fills;
+         BOOST_CHECK_GT( op.virtual_op, 0u );
+      }
+   }
+   BOOST_CHECK_EQUAL( 2u, fills );
+   BOOST_CHECK_EQUAL( fill_block_num + 1, notices[1].block_num );
+
+   // a second session resumes from the fill block
+   graphene::app::database_api db_api2( db, &( app.get_options() ), nullptr, registry );
+   vector<variant> resumed;
+   db_api2.set_applied_operations_callback( [&resumed]( const variant& v ) { resumed.push_back( v ); },
+                                            fill_block_num );
+   fc::usleep(fc::milliseconds(200));
+   BOOST_REQUIRE_EQUAL( 2u, resumed.size() );
+   BOOST_CHECK_EQUAL( fill_block_num, resumed[0].as<graphene::app::applied_operations_notice>(
+                                                     GRAPHENE_MAX_NESTED_OBJECTS ).block_num );
+
+   // blocks before the first subscription were not kept
+   GRAPHENE_CHECK_THROW( db_api2.set_applied_operations_callback( callback, 1 ), fc::exception );
+
+   db_api1.set_applied_operations_callback( std::function<void(const variant&)>() );
+   generate_block();
+   fc::usleep(fc::milliseconds(200));
+   BOOST_CHECK_EQUAL( 2u, notices.size() );
+   BOOST_CHECK_EQUAL( 3u, resumed.size() );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( subscription_notification_test )
 {
    try {
@@ -1085,6 +1559,48 @@ BOOST_AUTO_TEST_CASE( subscription_notification_test )
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE( get_required_fees_fixed_fees )
+{ try {
+   static_assert( has_fixed_fee<limit_order_create_operation>::value, "the fee of limit_order_create is fixed" );
+   static_assert( !has_fixed_fee<transfer_operation>::value, "the fee of a transfer depends on its memo" );
+   static_assert( !has_fixed_fee<proposal_create_operation>::value, "the fee of a proposal depends on its size" );
+
+   enable_fees();
+   graphene::app::database_api db_api( db, &( app.get_options() ) );
+
+   limit_order_create_operation create_op;
+   create_op.amount_to_sell = asset( 100 );
+   create_op.min_to_receive = asset( 100, asset_id_type(1) );
+   limit_order_create_operation other_create_op = create_op;
+   other_create_op.amount_to_sell = asset( 12345678 );
+   transfer_operation transfer_op;
+   proposal_create_operation proposal_op;
+   proposal_op.proposed_ops.emplace_back( create_op );
+   proposal_op.proposed_ops.emplace_back( other_create_op );
+
+   const vector<operation> ops = { create_op, transfer_op, other_create_op, proposal_op };
+   const vector<variant> fees = db_api.get_required_fees( ops, "1.3.0" );
+   BOOST_REQUIRE_EQUAL( fees.size(), 4u );
+
+   const fee_schedule& schedule = db.current_fee_schedule();
+   operation op = create_op;
+   const asset create_fee = schedule.set_fee( op );
+   BOOST_CHECK_GT( create_fee.amount.value, 0 );
+   BOOST_CHECK( fees[0].as<asset>( 1 ) == create_fee );
+   BOOST_CHECK( fees[2].as<asset>( 1 ) == create_fee );
+   op = transfer_op;
+   BOOST_CHECK( fees[1].as<asset>( 1 ) == schedule.set_fee( op ) );
+
+   // the fees of the proposed operations are set before the fee of the proposal is computed
+   auto proposal_fees = fees[3].as< std::pair< asset, fc::variants > >( 3 );
+   BOOST_REQUIRE_EQUAL( proposal_fees.second.size(), 2u );
+   BOOST_CHECK( proposal_fees.second[1].as<asset>( 1 ) == create_fee );
+   proposal_op.proposed_ops[0].op.get<limit_order_create_operation>().fee = create_fee;
+   proposal_op.proposed_ops[1].op.get<limit_order_create_operation>().fee = create_fee;
+   op = proposal_op;
+   BOOST_CHECK( proposal_fees.first == schedule.set_fee( op ) );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( lookup_vote_ids )
 { try {
    ACTORS( (connie)(whitney)(wolverine) );
@@ -1470,6 +1986,43 @@ BOOST_AUTO_TEST_CASE( get_assets_by_issuer ) {
    }
 }
 
+BOOST_AUTO_TEST_CASE( lookup_names_by_prefix ) {
+   try {
+      graphene::app::database_api db_api(db, &(this->app.get_options()));
+
+      ACTORS( (alice)(alicia)(alisa)(bob) );
+      create_bitasset("USD");
+      create_bitasset("USDT");
+      create_bitasset("UTF");
+
+      auto accounts = db_api.lookup_accounts_by_prefix( "ali", 10 );
+      BOOST_REQUIRE_EQUAL( accounts.size(), 3u );
+      BOOST_CHECK( accounts.begin()->first == "alice" );
+      BOOST_CHECK( accounts.begin()->second == alice_id );
+      BOOST_CHECK( accounts.count( "alisa" ) == 1 );
+      BOOST_CHECK( accounts.count( "bob" ) == 0 );
+
+      // the limit is applied to the matching names only
+      accounts = db_api.lookup_accounts_by_prefix( "alic", 1 );
+      BOOST_REQUIRE_EQUAL( accounts.size(), 1u );
+      BOOST_CHECK( accounts.begin()->first == "alice" );
+      BOOST_CHECK( db_api.lookup_accounts_by_prefix( "alz", 10 ).empty() );
+      GRAPHENE_CHECK_THROW( db_api.lookup_accounts_by_prefix( "ali", 1001 ), fc::exception );
+
+      auto symbols = db_api.lookup_asset_symbols_by_prefix( "USD", 10 );
+      BOOST_REQUIRE_EQUAL( symbols.size(), 2u );
+      BOOST_CHECK( symbols.count( "USD" ) == 1 );
+      BOOST_CHECK( symbols.count( "USDT" ) == 1 );
+      BOOST_CHECK( symbols.at( "USD" ) == get_asset( "USD" ).id );
+      BOOST_CHECK_EQUAL( db_api.lookup_asset_symbols_by_prefix( "", 100 ).size(),
+                         db_api.get_asset_count() );
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( get_call_orders_by_account ) {
 
    try {
@@ -1784,6 +2337,241 @@ BOOST_AUTO_TEST_CASE( asset_in_collateral )
    BOOST_CHECK_EQUAL( 0, assets[1].total_in_collateral->value );
    BOOST_CHECK_EQUAL( 1000, assets[1].total_backing_collateral->value );
 
+   // nathan's USDBIT position is 900 debt for 14500 CORE now, dan's is 100 for 2000
+   BOOST_REQUIRE( assets[0].total_debt.valid() );
+   BOOST_REQUIRE( assets[0].total_positions.valid() );
+   BOOST_CHECK_EQUAL( 1000, assets[0].total_debt->value );
+   BOOST_CHECK_EQUAL( 2u, *assets[0].total_positions );
+   BOOST_REQUIRE( assets[1].total_debt.valid() );
+   BOOST_CHECK_EQUAL( 5, assets[1].total_debt->value );
+   BOOST_CHECK_EQUAL( 1u, *assets[1].total_positions );
+   BOOST_CHECK( !db_api.get_assets( { GRAPHENE_SYMBOL } )[0]->total_debt.valid() );
+
+   graphene::app::asset_api asset_api( app );
+   auto positions = asset_api.get_collateral_positions( "USDBIT", 0, 10 );
+   BOOST_REQUIRE_EQUAL( 2u, positions.size() );
+   BOOST_CHECK( positions[0].borrower == nathan_id );
+   BOOST_CHECK_EQUAL( 900, positions[0].debt.value );
+   BOOST_CHECK_EQUAL( 14500, positions[0].collateral.value );
+   BOOST_CHECK( positions[1].borrower == dan_id );
+   positions = asset_api.get_collateral_positions( "USDBIT", 1, 10 );
+   BOOST_REQUIRE_EQUAL( 1u, positions.size() );
+   BOOST_CHECK( positions[0].borrower == dan_id );
+   BOOST_CHECK( asset_api.get_collateral_positions( "USDBIT", 2, 10 ).empty() );
+   GRAPHENE_CHECK_THROW( asset_api.get_collateral_positions( GRAPHENE_SYMBOL, 0, 10 ), fc::exception );
+
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( stream_blocks )
+{ try {
+   generate_blocks( 5 );
+   const uint32_t head_num = db.head_block_num();
+
+   auto block_api = std::make_shared< graphene::app::block_api >( std::ref( db ) );
+   vector<graphene::app::streamed_block> received;
+   auto callback = [&received]( const variant& v ) {
+      received.push_back( v.as<graphene::app::streamed_block>( GRAPHENE_MAX_NESTED_OBJECTS ) );
+   };
+
+   // the range ends at the head block
+   block_api->stream_blocks( callback, 2, head_num + 10, false );
+   BOOST_CHECK( received.empty() ); // blocks are sent asynchronously
+   fc::usleep( fc::milliseconds(200) );
+   BOOST_REQUIRE_EQUAL( received.size(), head_num - 1 );
+   for( uint32_t i = 0; i < received.size(); ++i )
+   {
+      BOOST_CHECK_EQUAL( received[i].block_num, i + 2 );
+      BOOST_REQUIRE( received[i].block.valid() );
+      BOOST_CHECK( !received[i].packed.valid() );
+      BOOST_CHECK( received[i].block->id() == db.fetch_block_by_number( i + 2 )->id() );
+   }
+
+   received.clear();
+   block_api->stream_blocks( callback, head_num, head_num, true );
+   fc::usleep( fc::milliseconds(200) );
+   BOOST_REQUIRE_EQUAL( received.size(), 1u );
+   BOOST_REQUIRE( received[0].packed.valid() );
+   BOOST_CHECK( fc::raw::unpack<signed_block>( *received[0].packed ).id() == db.head_block_id() );
+
+   GRAPHENE_CHECK_THROW( block_api->stream_blocks( callback, 3, 2, false ), fc::exception );
+
+   // the range and the number of streams running at a time are limited
+   graphene::app::application_options options;
+   options.api_limit_stream_blocks = 2;
+   options.api_limit_block_streams = 1;
+   auto limited_api = std::make_shared< graphene::app::block_api >( std::ref( db ), &options );
+   received.clear();
+   limited_api->stream_blocks( callback, 1, head_num, false );
+   GRAPHENE_CHECK_THROW( limited_api->stream_blocks( callback, 1, head_num, false ), fc::exception );
+   fc::usleep( fc::milliseconds(200) );
+   BOOST_REQUIRE_EQUAL( received.size(), 2u );
+   BOOST_CHECK_EQUAL( received[1].block_num, 2u );
+   // the first stream is done
+   limited_api->stream_blocks( callback, 1, 1, false );
+   fc::usleep( fc::milliseconds(200) );
+   BOOST_CHECK_EQUAL( received.size(), 3u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( get_objects_at_head_block )
+{ try {
+   ACTORS( (alice)(bob) );
+   transfer( account_id_type(), alice_id, asset(1000) );
+   generate_block();
+
+   graphene::app::database_api db_api( db );
+   const auto& balances = db.get_index_type< primary_index< account_balance_index > >()
+                            .get_secondary_index< balances_by_account_index >();
+   const object_id_type alice_bal_id = balances.get_account_balance( alice_id, asset_id_type() )->id;
+
+   // no pending transactions, both views are identical
+   BOOST_CHECK_EQUAL( 1000, db_api.get_objects( { alice_bal_id } )[0]["balance"].as_int64() );
+   BOOST_CHECK_EQUAL( 1000, db_api.get_objects_at_head_block( { alice_bal_id } )[0]["balance"].as_int64() );
+
+   // a pending transfer modifies alice's balance and creates bob's
+   transfer( alice_id, bob_id, asset(300) );
+   const object_id_type bob_bal_id = balances.get_account_balance( bob_id, asset_id_type() )->id;
+
+   auto pending = db_api.get_objects( { alice_bal_id, bob_bal_id } );
+   BOOST_CHECK_EQUAL( 700, pending[0]["balance"].as_int64() );
+   BOOST_CHECK_EQUAL( 300, pending[1]["balance"].as_int64() );
+
+   auto at_head = db_api.get_objects_at_head_block( { alice_bal_id, bob_bal_id } );
+   BOOST_CHECK_EQUAL( 1000, at_head[0]["balance"].as_int64() );
+   BOOST_CHECK( at_head[1].is_null() );
+
+   // once included in a block, the changes are visible in both views
+   generate_block();
+   at_head = db_api.get_objects_at_head_block( { alice_bal_id, bob_bal_id } );
+   BOOST_CHECK_EQUAL( 700, at_head[0]["balance"].as_int64() );
+   BOOST_CHECK_EQUAL( 300, at_head[1]["balance"].as_int64() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( get_objects_changed_since )
+{ try {
+   ACTORS( (alice)(bob) );
+   transfer( account_id_type(), alice_id, asset( 1000000 * GRAPHENE_BLOCKCHAIN_PRECISION ) );
+   generate_block();
+
+   graphene::app::application_options opt;
+   graphene::app::database_api db_api( db, &opt );
+   const uint8_t space = account_object::space_id;
+   const uint8_t type = account_object::type_id;
+   auto contains = []( const graphene::app::changed_objects& changed, account_id_type id ) {
+      return std::any_of( changed.objects.begin(), changed.objects.end(), [id]( const fc::variant& v ) {
+         return v["id"].as<account_id_type>( 1 ) == id;
+      });
+   };
+
+   auto changed = db_api.get_objects_changed_since( space, type, 0, 0, 0 );
+   const uint32_t stamp = changed.stamp;
+   BOOST_CHECK_EQUAL( db.head_block_num(), stamp );
+   BOOST_CHECK( contains( changed, alice_id ) );
+   BOOST_CHECK( contains( changed, bob_id ) );
+   BOOST_CHECK( db_api.get_objects_changed_since( space, type, 0, 0, stamp ).objects.empty() );
+
+   // a pending change is reported once it is included in a block
+   upgrade_to_lifetime_member( alice_id );
+   BOOST_CHECK( db_api.get_objects_changed_since( space, type, 0, 0, stamp ).objects.empty() );
+   generate_block();
+   changed = db_api.get_objects_changed_since( space, type, alice_id.instance.value, alice_id.instance.value + 1,
+                                               stamp );
+   BOOST_REQUIRE_EQUAL( 1u, changed.objects.size() );
+   BOOST_CHECK( changed.objects[0]["membership_expiration_date"].as<fc::time_point_sec>( 1 )
+                == fc::time_point_sec::maximum() );
+   BOOST_CHECK_EQUAL( db.head_block_num(), changed.stamp );
+   BOOST_CHECK( !contains( db_api.get_objects_changed_since( space, type, 0, 0, stamp ), bob_id ) );
+
+   // the examined range is limited
+   opt.api_limit_get_changed_objects = 1;
+   changed = db_api.get_objects_changed_since( space, type, alice_id.instance.value, 0, 0 );
+   BOOST_CHECK_EQUAL( 1u, changed.objects.size() );
+   BOOST_CHECK_EQUAL( alice_id.instance.value + 1, changed.next_instance );
+   opt.api_limit_get_changed_objects = 1000;
+
+   // objects restored by popping a block are stamped above it
+   const uint32_t popped = db.head_block_num();
+   db.pop_block();
+   changed = db_api.get_objects_changed_since( space, type, 0, 0, popped );
+   BOOST_CHECK( contains( changed, alice_id ) );
+   BOOST_CHECK_EQUAL( popped + 1, changed.stamp );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( get_index_memory_usage )
+{ try {
+   ACTORS( (alice)(bob) );
+   generate_block();
+
+   graphene::app::database_api db_api( db );
+   const auto usage = db_api.get_index_memory_usage();
+   const auto itr = std::find_if( usage.begin(), usage.end(), []( const graphene::db::index_memory_usage& u ) {
+      return u.space_id == account_object::space_id && u.type_id == account_object::type_id;
+   });
+   BOOST_REQUIRE( itr != usage.end() );
+   BOOST_CHECK_EQUAL( db.get_index_type< account_index >().indices().size(), itr->object_count );
+   BOOST_CHECK_GE( itr->object_bytes, itr->object_count * sizeof( account_object ) );
+   // account_member_index has entries for the keys of alice and bob
+   BOOST_CHECK_GT( itr->secondary_index_bytes, 0u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( full_account_cache )
+{ try {
+   ACTORS( (alice)(bob) );
+   transfer( account_id_type(), alice_id, asset(1000) );
+   generate_block();
+
+   auto cache = std::make_shared<graphene::app::full_account_cache>( db, 10 );
+   graphene::app::database_api db_api( db, &( app.get_options() ), cache );
+   auto alice_core_balance = [&db_api]() {
+      const auto full = db_api.get_full_accounts( { "alice" }, false ).at( "alice" );
+      BOOST_REQUIRE_EQUAL( 1u, full.balances.size() );
+      return full.balances[0].balance.value;
+   };
+
+   BOOST_CHECK_EQUAL( 1000, alice_core_balance() );
+   BOOST_CHECK_EQUAL( 1000, alice_core_balance() );
+   auto stats = db_api.get_full_account_cache_statistics();
+   BOOST_CHECK_EQUAL( 1u, stats.size );
+   BOOST_CHECK_EQUAL( 1u, stats.hits );
+   BOOST_CHECK_EQUAL( 1u, stats.misses );
+
+   // a pending transaction drops the entries of the accounts it impacts
+   transfer( alice_id, bob_id, asset(300) );
+   BOOST_CHECK_EQUAL( 700, alice_core_balance() );
+
+   // the entry built from the pending state is dropped with the block, the following one is kept
+   generate_block();
+   BOOST_CHECK_EQUAL( 700, alice_core_balance() );
+   generate_block();
+   BOOST_CHECK_EQUAL( 700, alice_core_balance() );
+
+   stats = db_api.get_full_account_cache_statistics();
+   BOOST_CHECK_EQUAL( 2u, stats.hits );
+   BOOST_CHECK_EQUAL( 3u, stats.misses );
+   BOOST_CHECK_EQUAL( 2u, stats.invalidations );
+
+   // without a cache the statistics are empty
+   graphene::app::database_api uncached_api( db, &( app.get_options() ) );
+   BOOST_CHECK_EQUAL( 0u, uncached_api.get_full_account_cache_statistics().capacity );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( get_upcoming_witnesses )
+{ try {
+   generate_block();
+
+   graphene::app::database_api db_api( db );
+   const size_t witness_count = db.get_witness_schedule_object().current_shuffled_witnesses.size();
+   const size_t blocks_left = witness_count - db.head_block_num() % witness_count;
+
+   auto upcoming = db_api.get_upcoming_witnesses( 1000 );
+   BOOST_REQUIRE_EQUAL( blocks_left, upcoming.size() );
+   for( uint32_t slot = 1; slot <= upcoming.size(); ++slot )
+   {
+      BOOST_CHECK( upcoming[slot-1].first == db.get_slot_time( slot ) );
+      BOOST_CHECK( upcoming[slot-1].second == db.get_scheduled_witness( slot ) );
+   }
+
+   BOOST_CHECK_EQUAL( 1u, db_api.get_upcoming_witnesses( 1 ).size() );
+   BOOST_CHECK( db_api.get_upcoming_witnesses( 0 ).empty() );
 } FC_LOG_AND_RETHROW() }
 
 BOOST_AUTO_TEST_SUITE_END()
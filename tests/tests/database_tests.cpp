@@ -27,7 +27,11 @@
 #include <graphene/chain/database.hpp>
 
 #include <graphene/chain/account_object.hpp>
+#include <graphene/chain/hardfork.hpp>
 #include <graphene/chain/proposal_object.hpp>
+#include <graphene/chain/transaction_history_object.hpp>
+
+#include <graphene/utilities/tempdir.hpp>
 
 #include <fc/crypto/digest.hpp>
 
@@ -138,6 +142,35 @@ BOOST_AUTO_TEST_CASE( merge_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( undo_history_bytes_test )
+{ try {
+   database db;
+   const size_t initial_bytes = db._undo_db.bytes();
+   {
+      auto outer = db._undo_db.start_undo_session( true );
+      const auto& obj = db.create<account_balance_object>( []( account_balance_object& obj ) {
+         obj.balance = 42;
+      });
+      const size_t created_bytes = db._undo_db.bytes();
+      BOOST_CHECK_GT( created_bytes, initial_bytes );
+      {
+         auto inner = db._undo_db.start_undo_session();
+         db.modify( obj, []( account_balance_object& obj ) { obj.balance = 43; } );
+         BOOST_CHECK_GE( db._undo_db.bytes(), created_bytes + sizeof( account_balance_object ) );
+         BOOST_CHECK_EQUAL( db.get_undo_history_usage().depth, db._undo_db.size() );
+         // new + upd -> new, the saved value is dropped
+         inner.merge();
+      }
+      BOOST_CHECK_EQUAL( db._undo_db.bytes(), created_bytes );
+      // new + del -> nop, only the saved next ID of the index remains
+      db.remove( obj );
+      BOOST_CHECK_LT( db._undo_db.bytes(), created_bytes );
+      BOOST_CHECK_GT( db._undo_db.bytes(), initial_bytes );
+   }
+   BOOST_CHECK_EQUAL( db._undo_db.bytes(), initial_bytes );
+   BOOST_CHECK_EQUAL( db.get_undo_history_usage().bytes, initial_bytes );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( direct_index_test )
 { try {
    try {
@@ -240,7 +273,9 @@ BOOST_AUTO_TEST_CASE( required_approval_index_test ) // see https://github.com/b
       prop.required_owner_approvals.insert( agnetha_id );
    });
 
-   BOOST_CHECK_EQUAL( 2u, required_approvals.size() );
+   // the proposer is mapped too
+   BOOST_CHECK_EQUAL( 3u, required_approvals.size() );
+   BOOST_REQUIRE( required_approvals.find( committee_account ) != required_approvals.end() );
    BOOST_REQUIRE( required_approvals.find( alice_id )   != required_approvals.end() );
    BOOST_REQUIRE( required_approvals.find( agnetha_id ) != required_approvals.end() );
    BOOST_CHECK_EQUAL( 1u, required_approvals.find(alice_id)->second.size() );
@@ -253,7 +288,7 @@ BOOST_AUTO_TEST_CASE( required_approval_index_test ) // see https://github.com/b
       prop.available_owner_approvals.insert( benny_id );
    });
 
-   BOOST_CHECK_EQUAL( 4u, required_approvals.size() );
+   BOOST_CHECK_EQUAL( 5u, required_approvals.size() );
    BOOST_REQUIRE( required_approvals.find( bob_id )   != required_approvals.end() );
    BOOST_REQUIRE( required_approvals.find( benny_id ) != required_approvals.end() );
    BOOST_CHECK_EQUAL( 1u, required_approvals.find(bob_id)->second.size() );
@@ -268,7 +303,7 @@ BOOST_AUTO_TEST_CASE( required_approval_index_test ) // see https://github.com/b
       prop.available_owner_approvals.erase( benny_id );
    });
 
-   BOOST_CHECK_EQUAL( 4u, required_approvals.size() );
+   BOOST_CHECK_EQUAL( 5u, required_approvals.size() );
    BOOST_REQUIRE( required_approvals.find( charlie_id ) != required_approvals.end() );
    BOOST_REQUIRE( required_approvals.find( carlos_id )  != required_approvals.end() );
    BOOST_CHECK_EQUAL( 1u, required_approvals.find(charlie_id)->second.size() );
@@ -284,7 +319,7 @@ BOOST_AUTO_TEST_CASE( required_approval_index_test ) // see https://github.com/b
    const_cast< primary_index< proposal_index >& >( reloaded_proposals ).load( serialized );
    const auto& prop2 = *reloaded_proposals.indices().begin();
 
-   BOOST_CHECK_EQUAL( 4u, reloaded_approvals.size() );
+   BOOST_CHECK_EQUAL( 5u, reloaded_approvals.size() );
    BOOST_REQUIRE( reloaded_approvals.find( charlie_id ) != reloaded_approvals.end() );
    BOOST_REQUIRE( reloaded_approvals.find( carlos_id )  != reloaded_approvals.end() );
    BOOST_CHECK_EQUAL( 1u, reloaded_approvals.find(charlie_id)->second.size() );
@@ -296,10 +331,25 @@ BOOST_AUTO_TEST_CASE( required_approval_index_test ) // see https://github.com/b
       prop.available_owner_approvals.clear();
    });
 
-   BOOST_CHECK_EQUAL( 2u, reloaded_approvals.size() );
+   BOOST_CHECK_EQUAL( 3u, reloaded_approvals.size() );
    BOOST_REQUIRE( reloaded_approvals.find( alice_id )   != reloaded_approvals.end() );
    BOOST_REQUIRE( reloaded_approvals.find( agnetha_id ) != reloaded_approvals.end() );
 
+   // a required account or the proposer withdrawing its approval stays mapped
+   db2.modify( prop2, [this,alice_id]( object& o ) {
+      proposal_object& prop = static_cast<proposal_object&>(o);
+      prop.available_active_approvals.insert( alice_id );
+      prop.available_active_approvals.insert( committee_account );
+   });
+   db2.modify( prop2, []( object& o ) {
+      proposal_object& prop = static_cast<proposal_object&>(o);
+      prop.available_active_approvals.clear();
+   });
+
+   BOOST_CHECK_EQUAL( 3u, reloaded_approvals.size() );
+   BOOST_REQUIRE( reloaded_approvals.find( alice_id ) != reloaded_approvals.end() );
+   BOOST_REQUIRE( reloaded_approvals.find( committee_account ) != reloaded_approvals.end() );
+
    db2.remove( prop2 );
 
    BOOST_CHECK_EQUAL( 0u, reloaded_approvals.size() );
@@ -310,4 +360,466 @@ BOOST_AUTO_TEST_CASE( required_approval_index_test ) // see https://github.com/b
 
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( unsaved_changes_test )
+{ try {
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const fc::path file = data_dir.path() / "accounts";
+
+   graphene::db::primary_index< account_index > my_accounts( db );
+   BOOST_CHECK( !my_accounts.has_unsaved_changes() );
+
+   account_object test_account;
+   test_account.id = account_id_type(1);
+   test_account.name = "account1";
+   // loading does not count as a change
+   my_accounts.load( fc::raw::pack( test_account ) );
+   BOOST_CHECK( !my_accounts.has_unsaved_changes() );
+
+   const object& acct0 = my_accounts.create( [] ( object& o ) {
+      static_cast< account_object& >( o ).name = "account0";
+   } );
+   BOOST_CHECK( my_accounts.has_unsaved_changes() );
+   my_accounts.save( file );
+   BOOST_CHECK( !my_accounts.has_unsaved_changes() );
+
+   my_accounts.modify( acct0, [] ( object& o ) {
+      static_cast< account_object& >( o ).referrer = account_id_type(1);
+   } );
+   BOOST_CHECK( my_accounts.has_unsaved_changes() );
+   my_accounts.save( file );
+
+   my_accounts.remove( acct0 );
+   BOOST_CHECK( my_accounts.has_unsaved_changes() );
+
+   graphene::db::primary_index< account_index > reloaded( db );
+   reloaded.open( file );
+   BOOST_CHECK( !reloaded.has_unsaved_changes() );
+   BOOST_CHECK_EQUAL( 2u, reloaded.indices().size() );
+   reloaded.set_next_id( reloaded.get_next_id() );
+   BOOST_CHECK( !reloaded.has_unsaved_changes() );
+   reloaded.use_next_id();
+   reloaded.set_next_id( account_id_type(1) );
+   BOOST_CHECK( reloaded.has_unsaved_changes() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( use_next_id_is_flushed )
+{ try {
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   {
+      graphene::db::object_database odb;
+      auto* ops = odb.add_index< graphene::db::primary_index< operation_history_index > >();
+      odb.open( data_dir.path() );
+      odb.flush();
+      // the history plugins skip ids this way with the undo database disabled
+      ops->use_next_id();
+      ops->use_next_id();
+      BOOST_CHECK( ops->has_unsaved_changes() );
+      odb.flush();
+      odb.close();
+   }
+   graphene::db::object_database reopened;
+   auto* ops = reopened.add_index< graphene::db::primary_index< operation_history_index > >();
+   reopened.open( data_dir.path() );
+   BOOST_CHECK( ops->get_next_id() == operation_history_id_type(2) );
+   reopened.close();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( digest_ranges_test )
+{ try {
+   graphene::db::primary_index< account_index > accounts_a( db );
+   graphene::db::primary_index< account_index > accounts_b( db );
+   for( uint64_t i = 0; i < 10; ++i )
+   {
+      account_object account;
+      account.id = account_id_type(i);
+      account.name = "account" + fc::to_string(i);
+      accounts_a.load( fc::raw::pack( account ) );
+      if( i == 7 )
+         account.name = "changed";
+      if( i != 3 )
+         accounts_b.load( fc::raw::pack( account ) );
+   }
+
+   auto a = accounts_a.digest_ranges( 0, 10, 1 );
+   BOOST_REQUIRE_EQUAL( 1u, a.size() );
+   BOOST_CHECK_EQUAL( 10u, a[0].count );
+   BOOST_CHECK( a[0].digest != accounts_b.digest_ranges( 0, 10, 1 )[0].digest );
+
+   // ranges of 3, 3, 2 and 2 instances
+   a = accounts_a.digest_ranges( 0, 10, 4 );
+   auto b = accounts_b.digest_ranges( 0, 10, 4 );
+   BOOST_REQUIRE_EQUAL( 4u, a.size() );
+   BOOST_REQUIRE_EQUAL( 4u, b.size() );
+   BOOST_CHECK_EQUAL( 6u, a[2].first );
+   BOOST_CHECK_EQUAL( 8u, a[2].last );
+   BOOST_CHECK( a[0].digest == b[0].digest );
+   BOOST_CHECK( a[1].digest != b[1].digest );
+   BOOST_CHECK_EQUAL( 3u, a[1].count );
+   BOOST_CHECK_EQUAL( 2u, b[1].count );
+   BOOST_CHECK( a[2].digest != b[2].digest );
+   BOOST_CHECK_EQUAL( 2u, b[2].count );
+   BOOST_CHECK( a[3].digest == b[3].digest );
+
+   // more parts than instances
+   BOOST_CHECK_EQUAL( 2u, accounts_a.digest_ranges( 8, 10, 16 ).size() );
+   BOOST_CHECK( accounts_a.digest_ranges( 10, 10, 16 ).empty() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( proposal_undo_snapshot_test )
+{ try {
+   ACTORS( (alice)(bob) );
+
+   transfer_operation top;
+   top.from = alice_id;
+   top.to = bob_id;
+   top.amount = asset(1);
+   const proposal_id_type prop_id = db.create<proposal_object>( [&]( proposal_object& p ) {
+      p.proposer = alice_id;
+      p.proposed_transaction.operations.push_back( top );
+      p.required_active_approvals.insert( alice_id );
+   }).id;
+
+   auto check_unchanged = [&]() {
+      BOOST_REQUIRE( db.find( prop_id ) != nullptr );
+      BOOST_CHECK( prop_id(db).available_active_approvals.empty() );
+      BOOST_CHECK( prop_id(db).fail_reason.empty() );
+      BOOST_CHECK_EQUAL( 1u, prop_id(db).required_active_approvals.size() );
+      BOOST_CHECK_EQUAL( 1u, prop_id(db).proposed_transaction.operations.size() );
+   };
+   auto approve = [&]() {
+      db.modify( prop_id(db), [&]( proposal_object& p ) {
+         p.available_active_approvals.insert( alice_id );
+         p.fail_reason = "test";
+      });
+   };
+
+   // modify + undo
+   {
+      auto session = db._undo_db.start_undo_session();
+      approve();
+      const auto& old_values = db._undo_db.head().old_values;
+      BOOST_REQUIRE( old_values.find( prop_id ) != old_values.end() );
+      const auto& snapshot = static_cast<const proposal_object&>( *old_values.find( prop_id )->second );
+      BOOST_CHECK( snapshot.proposed_transaction.operations.empty() );
+   }
+   check_unchanged();
+
+   // modify + remove + undo
+   {
+      auto session = db._undo_db.start_undo_session();
+      approve();
+      db.remove( prop_id(db) );
+      BOOST_CHECK( db.find( prop_id ) == nullptr );
+   }
+   check_unchanged();
+
+   // modify, then remove in a merged child session, then undo
+   {
+      auto session = db._undo_db.start_undo_session();
+      approve();
+      {
+         auto child = db._undo_db.start_undo_session();
+         db.remove( prop_id(db) );
+         child.merge();
+      }
+      BOOST_CHECK( db.find( prop_id ) == nullptr );
+   }
+   check_unchanged();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( account_statistics_undo_snapshot_test )
+{ try {
+   ACTORS( (alice) );
+   const account_statistics_id_type stats_id = alice_id(db).statistics;
+   const share_type fees_before = stats_id(db).pending_fees;
+
+   auto check_unchanged = [&]() {
+      BOOST_CHECK_EQUAL( "alice", stats_id(db).name );
+      BOOST_CHECK( stats_id(db).owner == alice_id );
+      BOOST_CHECK_EQUAL( fees_before.value, stats_id(db).pending_fees.value );
+   };
+
+   // modify + undo
+   {
+      auto session = db._undo_db.start_undo_session();
+      db.modify( stats_id(db), []( account_statistics_object& s ) {
+         s.pending_fees += 100;
+      });
+      const auto& old_values = db._undo_db.head().old_values;
+      BOOST_REQUIRE( old_values.find( stats_id ) != old_values.end() );
+      const auto& snapshot = static_cast<const account_statistics_object&>( *old_values.find( stats_id )->second );
+      BOOST_CHECK( snapshot.name.empty() );
+      BOOST_CHECK_EQUAL( fees_before.value, snapshot.pending_fees.value );
+   }
+   check_unchanged();
+
+   // modify + remove + undo
+   {
+      auto session = db._undo_db.start_undo_session();
+      db.modify( stats_id(db), []( account_statistics_object& s ) {
+         s.pending_fees += 100;
+      });
+      db.remove( stats_id(db) );
+      BOOST_CHECK( db.find( stats_id ) == nullptr );
+   }
+   check_unchanged();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( balances_by_account_index_test )
+{ try {
+   ACTORS( (alice) );
+   const auto& balances = db.get_index_type< primary_index< account_balance_index > >()
+                            .get_secondary_index< balances_by_account_index >();
+   BOOST_CHECK( balances.get_account_balances( alice_id ).empty() );
+
+   // inserted out of order, listed by asset
+   for( uint64_t instance : { 5, 1, 3 } )
+      db.create<account_balance_object>( [&]( account_balance_object& b ) {
+         b.owner = alice_id;
+         b.asset_type = asset_id_type( instance );
+         b.balance = instance;
+      });
+   const auto& alice_balances = balances.get_account_balances( alice_id );
+   BOOST_REQUIRE_EQUAL( 3u, alice_balances.size() );
+   vector<uint64_t> listed;
+   for( const auto& entry : alice_balances )
+   {
+      BOOST_CHECK( entry.first == entry.second->asset_type );
+      listed.push_back( entry.first.instance.value );
+   }
+   BOOST_CHECK( listed == vector<uint64_t>( { 1, 3, 5 } ) );
+
+   const account_balance_object* middle = balances.get_account_balance( alice_id, asset_id_type(3) );
+   BOOST_REQUIRE( middle != nullptr );
+   BOOST_CHECK_EQUAL( 3, middle->balance.value );
+   db.remove( *middle );
+   BOOST_CHECK( balances.get_account_balance( alice_id, asset_id_type(3) ) == nullptr );
+   BOOST_CHECK( balances.get_account_balance( alice_id, asset_id_type(5) ) != nullptr );
+   BOOST_CHECK_EQUAL( 2u, balances.get_account_balances( alice_id ).size() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( exact_name_index_test )
+{ try {
+   ACTORS( (alice) );
+   const auto& accounts = db.get_index_type< account_index >().indices().get< by_exact_name >();
+   BOOST_REQUIRE( accounts.find( "alice" ) != accounts.end() );
+   BOOST_CHECK( accounts.find( "alice" )->id == alice_id );
+   BOOST_CHECK( accounts.find( "alic" ) == accounts.end() );
+   BOOST_CHECK_EQUAL( accounts.size(), db.get_index_type< account_index >().indices().get< by_name >().size() );
+
+   const asset_id_type uia_id = create_user_issued_asset( "EXACT" ).id;
+   const auto& assets = db.get_index_type< asset_index >().indices().get< by_exact_symbol >();
+   BOOST_REQUIRE( assets.find( "EXACT" ) != assets.end() );
+   BOOST_CHECK( assets.find( "EXACT" )->id == uia_id );
+
+   // an undone rename is reflected in the hashed index
+   {
+      auto session = db._undo_db.start_undo_session();
+      db.modify( uia_id(db), []( asset_object& a ) { a.symbol = "RENAMED"; } );
+      BOOST_CHECK( assets.find( "EXACT" ) == assets.end() );
+      BOOST_CHECK( assets.find( "RENAMED" ) != assets.end() );
+   }
+   BOOST_CHECK( assets.find( "EXACT" ) != assets.end() );
+   BOOST_CHECK( assets.find( "RENAMED" ) == assets.end() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( maintenance_hardforks_test )
+{ try {
+   const auto& dgpo = db.get_dynamic_global_properties();
+   const time_point_sec original_maint_time = dgpo.next_maintenance_time;
+   auto check_flags = [this]( time_point_sec maint_time ) {
+      const auto& hardforks = db.get_maintenance_hardforks();
+      BOOST_CHECK( hardforks.next_maintenance_time == maint_time );
+      BOOST_CHECK_EQUAL( hardforks.before_core_hardfork_184, maint_time <= HARDFORK_CORE_184_TIME );
+      BOOST_CHECK_EQUAL( hardforks.before_core_hardfork_342, maint_time <= HARDFORK_CORE_342_TIME );
+      BOOST_CHECK_EQUAL( hardforks.before_core_hardfork_625, maint_time <= HARDFORK_CORE_625_TIME );
+      BOOST_CHECK_EQUAL( hardforks.before_core_hardfork_1270, maint_time <= HARDFORK_CORE_1270_TIME );
+   };
+   check_flags( original_maint_time );
+
+   // the flags follow next_maintenance_time, including the hardfork time itself and undo
+   {
+      auto session = db._undo_db.start_undo_session();
+      db.modify( dgpo, []( dynamic_global_property_object& p ) {
+         p.next_maintenance_time = HARDFORK_CORE_1270_TIME;
+      } );
+      check_flags( HARDFORK_CORE_1270_TIME );
+      BOOST_CHECK( db.get_maintenance_hardforks().before_core_hardfork_1270 );
+      db.modify( dgpo, []( dynamic_global_property_object& p ) {
+         p.next_maintenance_time = HARDFORK_CORE_1270_TIME + 1;
+      } );
+      BOOST_CHECK( !db.get_maintenance_hardforks().before_core_hardfork_1270 );
+   }
+   check_flags( original_maint_time );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( background_threads_test )
+{ try {
+   ACTORS( (alice) );
+   db.set_background_threads( 2 );
+   BOOST_CHECK_EQUAL( db.get_background_threads(), 2u );
+   BOOST_CHECK( db.run_in_background( [] () { return fc::thread::current().name(); } ).wait() != fc::thread::current().name() );
+
+   fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+   db.save_copy( dir.path() );
+   const auto& accounts = db.get_index_type< account_index >();
+   graphene::db::primary_index< account_index > copy( db );
+   copy.open( dir.path() / fc::to_string( account_object::space_id ) / fc::to_string( account_object::type_id ) );
+   BOOST_CHECK_EQUAL( copy.indices().size(), accounts.indices().size() );
+
+   db.set_background_threads( 0 );
+   BOOST_CHECK_EQUAL( db.get_background_threads(), 0u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( suspended_secondary_index_test )
+{ try {
+   const auto& members = db.get_index_type< account_index >().get_secondary_index< account_member_index >();
+   db.suspend_batched_indexes();
+   BOOST_CHECK( members.is_suspended() );
+
+   ACTORS( (alice) );
+   db.apply_batched_index_changes();
+   BOOST_CHECK_EQUAL( 0u, members.pending_changes() );
+   BOOST_CHECK( members.account_to_key_memberships.find( alice_public_key ) == members.account_to_key_memberships.end() );
+
+   db.rebuild_batched_indexes();
+   BOOST_CHECK( !members.is_suspended() );
+   auto itr = members.account_to_key_memberships.find( alice_public_key );
+   BOOST_REQUIRE( itr != members.account_to_key_memberships.end() );
+   BOOST_CHECK( itr->second.find( alice_id ) != itr->second.end() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( recent_transaction_index_test )
+{ try {
+   const auto& recent = db.get_index_type< transaction_index >().get_secondary_index< recent_transaction_index >();
+   const size_t initial_size = recent.size();
+   const time_point_sec now = db.head_block_time();
+
+   // enough transactions to grow the hash table several times, expiring over 10 seconds
+   vector< transaction_id_type > ids;
+   auto session = db._undo_db.start_undo_session();
+   for( uint16_t i = 0; i < 500; ++i )
+   {
+      signed_transaction trx;
+      trx.ref_block_num = i;
+      trx.expiration = now + ( i % 10 ) + 1;
+      ids.push_back( trx.id() );
+      db.create< transaction_history_object >( [&trx]( transaction_history_object& o ) {
+         o.trx = trx;
+         o.trx_id = trx.id();
+      });
+   }
+   BOOST_CHECK_EQUAL( initial_size + 500, recent.size() );
+   for( const auto& id : ids )
+   {
+      BOOST_REQUIRE( recent.find( id ) != nullptr );
+      BOOST_CHECK( recent.find( id )->trx_id == id );
+   }
+   BOOST_CHECK( recent.find( transaction_id_type() ) == nullptr );
+
+   // remove everything expiring within the first 5 seconds
+   while( const transaction_history_object* expired = recent.find_expired( now + 6 ) )
+   {
+      BOOST_REQUIRE( expired->get_expiration() < now + 6 );
+      db.remove( *expired );
+   }
+   BOOST_CHECK_EQUAL( initial_size + 250, recent.size() );
+   for( uint16_t i = 0; i < 500; ++i )
+      BOOST_CHECK_EQUAL( i % 10 >= 5, recent.find( ids[i] ) != nullptr );
+
+   // undo removes all of them again, including the ones that were already removed
+   session.undo();
+   BOOST_CHECK_EQUAL( initial_size, recent.size() );
+   for( const auto& id : ids )
+      BOOST_CHECK( recent.find( id ) == nullptr );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( typed_lookup_test )
+{ try {
+   ACTORS( (alice) );
+   // the typed lookup and the generic one through get_index() must agree
+   BOOST_CHECK( db.find( alice_id ) == db.find_object( alice_id ) );
+   BOOST_CHECK( &db.get( alice_id ) == &db.get_object( alice_id ) );
+   BOOST_CHECK( db.find( asset_id_type() ) == db.find_object( asset_id_type() ) );
+   BOOST_CHECK( db.find( dynamic_global_property_id_type() ) == db.find_object( dynamic_global_property_id_type() ) );
+
+   const account_id_type missing( alice_id.instance.value + 1000 );
+   BOOST_CHECK( db.find( missing ) == nullptr );
+   GRAPHENE_REQUIRE_THROW( db.get( missing ), fc::assert_exception );
+   GRAPHENE_REQUIRE_THROW( db.get_object( missing ), fc::assert_exception );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( background_load_test )
+{ try {
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const fc::path dir = data_dir.path() / "object_database" / fc::to_string( account_object::space_id );
+   fc::create_directories( dir );
+   {
+      graphene::db::primary_index< account_index > accounts( db );
+      for( int i = 0; i < 3; ++i )
+         accounts.create( [i] ( object& o ) {
+            static_cast< account_object& >( o ).name = "account" + fc::to_string(i);
+         } );
+      accounts.save( dir / fc::to_string( account_object::type_id ) );
+   }
+
+   graphene::db::object_database odb;
+   odb.add_index< graphene::db::primary_index< account_index > >();
+   odb.load_in_background( account_object::space_id, account_object::type_id );
+   odb.open( data_dir.path() );
+   // both lookups wait for the index to be loaded
+   BOOST_REQUIRE( odb.find( account_id_type(2) ) != nullptr );
+   BOOST_CHECK_EQUAL( odb.get( account_id_type(2) ).name, "account2" );
+   BOOST_CHECK_EQUAL( 3u, odb.get_index_type< account_index >().indices().size() );
+   odb.wait_for_background_loads();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( index_file_format_test )
+{ try {
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const fc::path file = data_dir.path() / "accounts";
+
+   graphene::db::primary_index< account_index > my_accounts( db );
+   for( int i = 0; i < 3; ++i )
+      my_accounts.create( [i] ( object& o ) {
+         static_cast< account_object& >( o ).name = "account" + fc::to_string(i);
+      } );
+   my_accounts.save( file );
+
+   {
+      graphene::db::primary_index< account_index > reloaded( db );
+      reloaded.open( file );
+      BOOST_CHECK_EQUAL( 3u, reloaded.indices().size() );
+      BOOST_CHECK( reloaded.get_next_id() == my_accounts.get_next_id() );
+   }
+
+   // flip the last byte, the chunk checksum no longer matches
+   {
+      std::fstream f( file.generic_string(), std::ios::in | std::ios::out | std::ios::binary );
+      f.seekg( -1, std::ios::end );
+      char c = f.get();
+      f.seekp( -1, std::ios::end );
+      f.put( c ^ 1 );
+   }
+   {
+      graphene::db::primary_index< account_index > reloaded( db );
+      GRAPHENE_REQUIRE_THROW( reloaded.open( file ), fc::assert_exception );
+   }
+
+   // files without chunks can still be opened
+   {
+      std::ofstream out( file.generic_string(), std::ofstream::binary | std::ofstream::trunc );
+      fc::raw::pack( out, my_accounts.get_next_id() );
+      fc::raw::pack( out, my_accounts.get_object_version() );
+      my_accounts.inspect_all_objects( [&out] ( const object& o ) {
+         auto packed = fc::raw::pack( fc::raw::pack( static_cast< const account_object& >( o ) ) );
+         out.write( packed.data(), packed.size() );
+      } );
+   }
+   graphene::db::primary_index< account_index > legacy( db );
+   legacy.open( file );
+   BOOST_CHECK_EQUAL( 3u, legacy.indices().size() );
+   BOOST_CHECK( legacy.get_next_id() == my_accounts.get_next_id() );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
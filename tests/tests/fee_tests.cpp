@@ -78,6 +78,48 @@ BOOST_AUTO_TEST_CASE( nonzero_fee_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( fee_schedule_lookup_table_test )
+{
+   try
+   {
+      // a schedule without the parameters of some operations, like older schedules on chain
+      fee_schedule schedule;
+      transfer_operation::fee_parameters_type transfer_fee;
+      transfer_fee.fee = 123;
+      transfer_fee.price_per_kbyte = 0;
+      schedule.parameters.insert( transfer_fee );
+      asset_update_operation::fee_parameters_type update_fee;
+      update_fee.fee = 456;
+      schedule.parameters.insert( update_fee );
+
+      transfer_operation xfer_op;
+      asset_update_issuer_operation update_issuer_op;
+      BOOST_CHECK_EQUAL( schedule.calculate_fee( xfer_op ).amount.value, 123 );
+      BOOST_CHECK_EQUAL( schedule.calculate_fee( update_issuer_op ).amount.value, 456 );
+
+      schedule.build_lookup_table();
+      BOOST_CHECK_EQUAL( schedule.calculate_fee( xfer_op ).amount.value, 123 );
+      BOOST_CHECK_EQUAL( schedule.calculate_fee( update_issuer_op ).amount.value, 456 );
+
+      // lookups through an outdated table still find the current parameters
+      asset_update_issuer_operation::fee_parameters_type update_issuer_fee;
+      update_issuer_fee.fee = 789;
+      schedule.parameters.insert( update_issuer_fee );
+      account_create_operation::fee_parameters_type create_fee;
+      schedule.parameters.insert( create_fee );
+      BOOST_CHECK_EQUAL( schedule.calculate_fee( xfer_op ).amount.value, 123 );
+      BOOST_CHECK_EQUAL( schedule.calculate_fee( update_issuer_op ).amount.value, 789 );
+
+      const fee_schedule copy = schedule;
+      BOOST_CHECK_EQUAL( copy.calculate_fee( update_issuer_op ).amount.value, 789 );
+
+      const auto& fees = db.current_fee_schedule();
+      BOOST_CHECK_EQUAL( fees.calculate_fee( xfer_op ).amount.value,
+                         fees.get<transfer_operation>().fee );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE(asset_claim_fees_test)
 {
    try
@@ -58,4 +58,46 @@ BOOST_AUTO_TEST_CASE(api_limit_get_grouped_limit_orders) {
     throw;
    }
 }
+
+BOOST_AUTO_TEST_CASE(get_grouped_limit_orders_by_bucket)
+{ try {
+   app.enable_plugin("grouped_orders");
+   graphene::app::orders_api orders_api(app);
+   optional<price> start;
+
+   ACTORS( (alice) );
+   fund( alice, asset(10000000) );
+   const asset_object& usd = create_user_issued_asset( "USDGROUP" );
+   const asset_id_type usd_id = usd.id;
+   const std::string core_str = std::string( static_cast<object_id_type>(asset_id_type()) );
+   const std::string usd_str = std::string( static_cast<object_id_type>(usd_id) );
+
+   // 1000 and 1050 are 5% apart, more than group 10 (0.1%) allows, 2001/2000 is 0.05% above 1000/1000
+   create_sell_order( alice_id, asset(1000), asset(1000, usd_id) );
+   const limit_order_object* high = create_sell_order( alice_id, asset(2001), asset(2000, usd_id) );
+   create_sell_order( alice_id, asset(1050), asset(1000, usd_id) );
+
+   vector< limit_order_group > orders = orders_api.get_grouped_limit_orders( core_str, usd_str, 10, start, 10 );
+   BOOST_REQUIRE_EQUAL( orders.size(), 2u );
+   BOOST_CHECK_EQUAL( orders[0].total_for_sale.value, 1050 );
+   BOOST_CHECK_EQUAL( orders[1].total_for_sale.value, 3001 );
+   BOOST_CHECK( orders[1].min_price == asset(1000) / asset(1000, usd_id) );
+   BOOST_CHECK( orders[1].max_price == asset(2001) / asset(2000, usd_id) );
+
+   // no orders in the other direction
+   BOOST_CHECK_EQUAL( orders_api.get_grouped_limit_orders( usd_str, core_str, 10, start, 10 ).size(), 0u );
+
+   start = asset(1) / asset(1, usd_id);
+   orders = orders_api.get_grouped_limit_orders( core_str, usd_str, 10, start, 10 );
+   BOOST_REQUIRE_EQUAL( orders.size(), 1u );
+   BOOST_CHECK_EQUAL( orders[0].total_for_sale.value, 3001 );
+
+   cancel_limit_order( *high );
+   start.reset();
+   orders = orders_api.get_grouped_limit_orders( core_str, usd_str, 10, start, 10 );
+   BOOST_REQUIRE_EQUAL( orders.size(), 2u );
+   BOOST_CHECK_EQUAL( orders[1].total_for_sale.value, 1000 );
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
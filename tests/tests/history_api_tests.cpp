@@ -25,6 +25,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include <graphene/app/api.hpp>
+#include <graphene/history_store/history_store_plugin.hpp>
 
 #include <graphene/utilities/tempdir.hpp>
 
@@ -32,6 +33,8 @@
 
 #include "../common/database_fixture.hpp"
 
+#include <algorithm>
+
 using namespace graphene::chain;
 using namespace graphene::chain::test;
 using namespace graphene::app;
@@ -83,6 +86,85 @@ BOOST_AUTO_TEST_CASE(get_account_history) {
       throw;
    }
 }
+BOOST_AUTO_TEST_CASE(account_history_archive) {
+   try {
+      app.enable_plugin( "account_history" );
+      graphene::app::history_api hist_api(app);
+      const auto* archive = app.get_plugin<graphene::account_history::account_history_plugin>( "account_history" )->archive();
+      BOOST_REQUIRE( archive != nullptr );
+
+      ACTOR(alice);
+      for( int i = 0; i < 20; ++i )
+      {
+         transfer( account_id_type(), alice_id, asset( 1000 + i ) );
+         generate_block();
+      }
+      // the transfers become irreversible, the next entry moves all but the last 5 to the archive
+      generate_blocks( 20 );
+      transfer( account_id_type(), alice_id, asset( 5000 ) );
+      generate_block();
+
+      const auto& stats = alice_id(db).statistics(db);
+      BOOST_CHECK_EQUAL( stats.total_ops, 22u );
+      BOOST_CHECK_EQUAL( stats.removed_ops, 17u );
+      BOOST_CHECK_GE( archive->size(), 17u );
+
+      // the history continues from memory into the archive
+      const vector<operation_history_object> all = hist_api.get_account_history( "alice", operation_history_id_type(),
+                                                                                  100, operation_history_id_type() );
+      BOOST_REQUIRE_EQUAL( all.size(), 22u );
+      for( size_t i = 1; i < all.size(); ++i )
+         BOOST_CHECK( all[i].id < all[i-1].id );
+      BOOST_CHECK_EQUAL( all.back().op.which(), operation::tag<account_create_operation>::value );
+
+      // page through it
+      vector<operation_history_object> paged;
+      operation_history_id_type start;
+      while( paged.size() < all.size() )
+      {
+         const auto page = hist_api.get_account_history( "alice", operation_history_id_type(), 10, start );
+         BOOST_REQUIRE( !page.empty() );
+         paged.insert( paged.end(), page.begin(), page.end() );
+         if( page.back().id.instance() == 0 )
+            break;
+         start = operation_history_id_type( page.back().id.instance() - 1 );
+      }
+      BOOST_REQUIRE_EQUAL( paged.size(), all.size() );
+      for( size_t i = 0; i < all.size(); ++i )
+         BOOST_CHECK( paged[i].id == all[i].id );
+
+      // and by sequence number, entry i of the full history has sequence 22 - i
+      auto relative = hist_api.get_relative_account_history( "alice", 0, 100, 0 );
+      BOOST_REQUIRE_EQUAL( relative.size(), 22u );
+      relative = hist_api.get_relative_account_history( "alice", 10, 100, 12 );
+      BOOST_REQUIRE_EQUAL( relative.size(), 3u );
+      BOOST_CHECK( relative[0].id == all[10].id );
+      BOOST_CHECK( relative[2].id == all[12].id );
+      relative = hist_api.get_relative_account_history( "alice", 3, 100, 7 );
+      BOOST_REQUIRE_EQUAL( relative.size(), 5u );
+      BOOST_CHECK( relative[0].id == all[15].id );
+      // across both tiers
+      relative = hist_api.get_relative_account_history( "alice", 16, 4, 19 );
+      BOOST_REQUIRE_EQUAL( relative.size(), 4u );
+      BOOST_CHECK( relative[0].id == all[3].id );
+      BOOST_CHECK( relative[3].id == all[6].id );
+
+      // an undone block moves its entries back into memory, the archive keeps them once
+      transfer( account_id_type(), alice_id, asset( 6000 ) );
+      generate_block();
+      const uint64_t archived = archive->size();
+      db.pop_block();
+      transfer( account_id_type(), alice_id, asset( 7000 ) );
+      generate_block();
+      BOOST_CHECK_EQUAL( archive->size(), archived );
+      BOOST_CHECK_EQUAL( hist_api.get_account_history( "alice", operation_history_id_type(), 100,
+                                                       operation_history_id_type() ).size(), 23u );
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE(get_account_history_additional) {
    try {
       graphene::app::history_api hist_api(app);
@@ -603,6 +685,92 @@ BOOST_AUTO_TEST_CASE(get_account_history_operations) {
       throw;
    }
 }
+
+BOOST_AUTO_TEST_CASE(account_history_by_type_after_restart) {
+   try {
+      graphene::app::history_api hist_api(app);
+
+      create_bitasset("CNY", account_id_type());
+      create_account("sam");
+      create_account("alice");
+      generate_block();
+
+      const int asset_create_op_id = operation::tag<asset_create_operation>::value;
+      const int account_create_op_id = operation::tag<account_create_operation>::value;
+      BOOST_CHECK_EQUAL( hist_api.get_account_history_operations( "committee-account", account_create_op_id,
+            operation_history_id_type(), operation_history_id_type(), 100 ).size(), 2u );
+
+      // A restart loads the indexes in parallel, so the operation objects may not be there yet when the
+      // history entries are inserted into the by-type index. Reopen the entries without them.
+      db.flush();
+      graphene::db::object_database reopened;
+      auto* entries = reopened.add_index< primary_index< account_transaction_history_index > >();
+      const auto* by_type = entries->add_secondary_index< graphene::account_history::account_history_by_type_index >();
+      reopened.open( db.get_data_dir() );
+
+      const std::set<operation_history_id_type>* ops = by_type->find( account_id_type(), account_create_op_id );
+      BOOST_REQUIRE( ops != nullptr );
+      BOOST_CHECK_EQUAL( ops->size(), 2u );
+      ops = by_type->find( account_id_type(), asset_create_op_id );
+      BOOST_REQUIRE( ops != nullptr );
+      BOOST_CHECK_EQUAL( ops->size(), 1u );
+      BOOST_CHECK( ops->begin()->instance.value == 0u );
+      ops = by_type->find( get_account("alice").id, account_create_op_id );
+      BOOST_REQUIRE( ops != nullptr );
+      BOOST_CHECK_EQUAL( ops->size(), 1u );
+      reopened.close();
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(get_account_history_operations_range) {
+   try {
+      graphene::app::history_api hist_api(app);
+      ACTORS((bob));
+
+      int transfer_op_id = operation::tag<transfer_operation>::value;
+      for(int i = 0; i < 5; ++i)
+      {
+         transfer(account_id_type(), bob_id, asset(1));
+         create_account("othertempacct" + std::to_string(i));
+      }
+      generate_block();
+      fc::usleep(fc::milliseconds(2000));
+
+      vector<operation_history_object> all = hist_api.get_account_history_operations(
+            "bob", transfer_op_id, operation_history_id_type(), operation_history_id_type(), 100);
+      BOOST_REQUIRE_EQUAL(all.size(), 5u);
+      for(size_t i = 0; i < all.size(); ++i)
+      {
+         BOOST_CHECK_EQUAL(all[i].op.which(), transfer_op_id);
+         if(i > 0)
+            BOOST_CHECK(all[i].id < all[i-1].id);
+      }
+
+      // start is included, stop is not
+      vector<operation_history_object> histories = hist_api.get_account_history_operations(
+            "bob", transfer_op_id, operation_history_id_type(all[1].id), operation_history_id_type(all[4].id), 100);
+      BOOST_REQUIRE_EQUAL(histories.size(), 3u);
+      BOOST_CHECK(histories[0].id == all[1].id);
+      BOOST_CHECK(histories[2].id == all[3].id);
+
+      histories = hist_api.get_account_history_operations(
+            "bob", transfer_op_id, operation_history_id_type(all[1].id), operation_history_id_type(all[4].id), 2);
+      BOOST_REQUIRE_EQUAL(histories.size(), 2u);
+      BOOST_CHECK(histories[1].id == all[2].id);
+
+      // bob was not part of the account creations
+      int account_create_op_id = operation::tag<account_create_operation>::value;
+      histories = hist_api.get_account_history_operations(
+            "bob", account_create_op_id, operation_history_id_type(), operation_history_id_type(), 100);
+      BOOST_CHECK_EQUAL(histories.size(), 1u);
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
 //new test case for increasing the limit based on the config file
 BOOST_AUTO_TEST_CASE(api_limit_get_account_history_operations) {
    try {
@@ -765,4 +933,360 @@ BOOST_AUTO_TEST_CASE(api_limit_get_account_history_by_operations) {
 }
 
 
+BOOST_AUTO_TEST_CASE(get_market_history_series) {
+   try {
+      graphene::app::history_api hist_api(app);
+      ACTORS( (alice)(bob) );
+      const asset_id_type uia_id = create_user_issued_asset( "CANDLE" ).id;
+      issue_uia( alice_id, asset( 10000, uia_id ) );
+      transfer( committee_account, bob_id, asset( 10000 ) );
+      generate_block();
+
+      // the fixture tracks buckets of 15 seconds, trade once in each of three buckets
+      auto trade = [&]( int64_t core_amount ) {
+         create_sell_order( alice_id, asset( 100, uia_id ), asset( core_amount ) );
+         create_sell_order( bob_id, asset( core_amount ), asset( 100, uia_id ) );
+         generate_block();
+         generate_blocks( db.head_block_time() + 15 );
+      };
+      trade( 100 );
+      trade( 110 );
+      trade( 120 );
+
+      const auto all = hist_api.get_market_history( "1.3.0", "CANDLE", 15, fc::time_point_sec(), db.head_block_time() );
+      BOOST_REQUIRE_EQUAL( all.size(), 3u );
+      BOOST_CHECK( all[0].key.open < all[1].key.open );
+      BOOST_CHECK( all[1].key.open < all[2].key.open );
+
+      // a slice starts at the first bucket opening at or after start, from either side of the market
+      const auto last = hist_api.get_market_history( "CANDLE", "1.3.0", 15, all[1].key.open, db.head_block_time() );
+      BOOST_REQUIRE_EQUAL( last.size(), 2u );
+      BOOST_CHECK( last[0].id == all[1].id );
+      BOOST_CHECK( last[1].id == all[2].id );
+      BOOST_CHECK( hist_api.get_market_history( "1.3.0", "CANDLE", 60,
+                                                fc::time_point_sec(), db.head_block_time() ).empty() );
+
+      // the series follow the buckets on undo
+      create_sell_order( alice_id, asset( 100, uia_id ), asset( 130 ) );
+      create_sell_order( bob_id, asset( 130 ), asset( 100, uia_id ) );
+      generate_block();
+      BOOST_CHECK_EQUAL( hist_api.get_market_history( "1.3.0", "CANDLE", 15,
+                                                      fc::time_point_sec(), db.head_block_time() ).size(), 4u );
+      db.pop_block();
+      BOOST_CHECK_EQUAL( hist_api.get_market_history( "1.3.0", "CANDLE", 15,
+                                                      fc::time_point_sec(), db.head_block_time() ).size(), 3u );
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(market_history_bucket_rollup) {
+   try {
+      graphene::app::history_api hist_api(app);
+      ACTORS( (alice)(bob) );
+      const asset_id_type uia_id = create_user_issued_asset( "ROLLUP" ).id;
+      issue_uia( alice_id, asset( 10000, uia_id ) );
+      transfer( committee_account, bob_id, asset( 10000 ) );
+      // start at the beginning of a 45 seconds bucket
+      generate_blocks( db.head_block_time() + ( 45 - db.head_block_time().sec_since_epoch() % 45 ) );
+
+      auto trade = [&]( int64_t core_amount ) {
+         create_sell_order( alice_id, asset( 100, uia_id ), asset( core_amount ) );
+         create_sell_order( bob_id, asset( core_amount ), asset( 100, uia_id ) );
+         generate_block();
+      };
+      auto buckets_of = [&]( uint32_t seconds ) {
+         return hist_api.get_market_history( "1.3.0", "ROLLUP", seconds, fc::time_point_sec(), db.head_block_time() );
+      };
+      const auto& bucket_idx = db.get_index_type<graphene::market_history::bucket_index>().indices();
+
+      trade( 200 );
+      generate_blocks( db.head_block_time() + 15 );
+      trade( 300 );
+      // only the 15 seconds buckets are stored, the open 45 seconds bucket is built on query
+      BOOST_CHECK_EQUAL( bucket_idx.size(), 2u );
+      auto large = buckets_of( 45 );
+      BOOST_REQUIRE_EQUAL( large.size(), 1u );
+      BOOST_CHECK( large[0].id == object_id_type() );
+      BOOST_CHECK_EQUAL( large[0].open_base.value, 200 );
+      BOOST_CHECK_EQUAL( large[0].close_base.value, 300 );
+      BOOST_CHECK_EQUAL( large[0].high_base.value, 300 );
+      BOOST_CHECK_EQUAL( large[0].low_base.value, 200 );
+      BOOST_CHECK_EQUAL( large[0].base_volume.value, 500 );
+      BOOST_CHECK_EQUAL( large[0].quote_volume.value, 200 );
+      const auto built = large[0];
+
+      // the next fill after it closed stores it
+      generate_blocks( db.head_block_time() + 45 );
+      trade( 250 );
+      large = buckets_of( 45 );
+      BOOST_REQUIRE_EQUAL( large.size(), 2u );
+      BOOST_CHECK( large[0].id != object_id_type() );
+      BOOST_CHECK( large[0].key == built.key );
+      BOOST_CHECK_EQUAL( large[0].close_base.value, built.close_base.value );
+      BOOST_CHECK_EQUAL( large[0].base_volume.value, built.base_volume.value );
+      BOOST_CHECK( large[1].id == object_id_type() );
+      BOOST_CHECK_EQUAL( buckets_of( 15 ).size(), 3u );
+
+      // after a long time without trades the open 45 seconds bucket is stored before the 15 seconds ones
+      // it is built from are beyond their history
+      const auto open_key = large[1].key;
+      generate_blocks( db.head_block_time() + 200 );
+      trade( 400 );
+      BOOST_CHECK_EQUAL( buckets_of( 15 ).size(), 1u );
+      large = buckets_of( 45 );
+      auto stored = std::find_if( large.begin(), large.end(),
+                                  [&open_key]( const graphene::market_history::bucket_object& b ) {
+                                     return b.key == open_key;
+                                  } );
+      BOOST_REQUIRE( stored != large.end() );
+      BOOST_CHECK( stored->id != object_id_type() );
+      BOOST_CHECK_EQUAL( stored->close_base.value, 250 );
+      BOOST_CHECK_EQUAL( stored->base_volume.value, 250 );
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(history_store) {
+   try {
+      using graphene::history_store::history_query;
+      using graphene::history_store::stored_operation;
+      app.enable_plugin( "history_store" );
+      graphene::app::history_api hist_api(app);
+
+      ACTORS( (alice)(bob) );
+      const asset_id_type usd_id = create_user_issued_asset( "USDSTORE" ).id;
+      generate_block();
+      const flat_set<int64_t> transfers = { operation::tag<transfer_operation>::value };
+      uint32_t first_transfer_block = 0;
+      fc::time_point_sec middle;
+      for( int i = 0; i < 20; ++i )
+      {
+         transfer( account_id_type(), i % 2 ? alice_id : bob_id, asset( 1000 + i ) );
+         generate_block();
+         if( i == 0 )
+            first_transfer_block = db.head_block_num();
+         if( i == 9 )
+            middle = db.head_block_time();
+      }
+      issue_uia( alice_id, asset( 100, usd_id ) );
+      generate_block();
+      // the blocks become irreversible
+      generate_blocks( 20 );
+
+      history_query q;
+      q.account = alice_id;
+      q.operation_types = transfers;
+      vector<stored_operation> ops = hist_api.query_history_store( q );
+      BOOST_REQUIRE_EQUAL( ops.size(), 10u );
+      for( size_t i = 1; i < ops.size(); ++i )
+         BOOST_CHECK_GT( ops[i-1].sequence, ops[i].sequence );
+      BOOST_CHECK_EQUAL( ops.front().operation.op.get<transfer_operation>().amount.amount.value, 1019 );
+      BOOST_CHECK_EQUAL( ops.back().operation.op.get<transfer_operation>().amount.amount.value, 1001 );
+
+      // in a time range
+      q.end_time = middle;
+      ops = hist_api.query_history_store( q );
+      BOOST_REQUIRE_EQUAL( ops.size(), 5u );
+      BOOST_CHECK_EQUAL( ops.front().operation.op.get<transfer_operation>().amount.amount.value, 1009 );
+      BOOST_CHECK( ops.front().block_time <= middle );
+
+      // page through them
+      q.end_time = fc::time_point_sec::maximum();
+      q.limit = 3;
+      vector<stored_operation> paged;
+      while( true )
+      {
+         const auto page = hist_api.query_history_store( q );
+         paged.insert( paged.end(), page.begin(), page.end() );
+         if( page.size() < q.limit )
+            break;
+         q.max_sequence = page.back().sequence - 1;
+      }
+      BOOST_REQUIRE_EQUAL( paged.size(), 10u );
+      for( size_t i = 1; i < paged.size(); ++i )
+         BOOST_CHECK_GT( paged[i-1].sequence, paged[i].sequence );
+
+      // by asset
+      history_query by_asset;
+      by_asset.asset = usd_id;
+      ops = hist_api.query_history_store( by_asset );
+      BOOST_REQUIRE_EQUAL( ops.size(), 2u );
+      BOOST_CHECK_EQUAL( ops[0].operation.op.which(), operation::tag<asset_issue_operation>::value );
+      BOOST_CHECK_EQUAL( ops[1].operation.op.which(), operation::tag<asset_create_operation>::value );
+
+      // by operation type
+      history_query by_type;
+      by_type.operation_type = operation::tag<transfer_operation>::value;
+      ops = hist_api.query_history_store( by_type );
+      BOOST_CHECK_EQUAL( ops.size(), 20u );
+
+      // by block, without an index
+      history_query by_block;
+      by_block.start_block = first_transfer_block;
+      by_block.end_block = first_transfer_block;
+      ops = hist_api.query_history_store( by_block );
+      BOOST_REQUIRE_EQUAL( ops.size(), 1u );
+      BOOST_CHECK_EQUAL( ops[0].operation.block_num, first_transfer_block );
+      BOOST_CHECK_EQUAL( ops[0].operation.op.get<transfer_operation>().to.instance.value, bob_id.instance.value );
+
+      history_query two_keys;
+      two_keys.account = alice_id;
+      two_keys.asset = usd_id;
+      GRAPHENE_REQUIRE_THROW( hist_api.query_history_store( two_keys ), fc::exception );
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(history_store_rebuild) {
+   try {
+      app.enable_plugin( "account_history" );
+      app.enable_plugin( "history_store" );
+      app.enable_plugin( "market_history" );
+      app.enable_plugin( "grouped_orders" );
+      graphene::app::history_api hist_api(app);
+
+      ACTORS( (alice)(bob) );
+      const asset_id_type usd_id = create_user_issued_asset( "USDREBUILD" ).id;
+      issue_uia( alice_id, asset( 1000, usd_id ) );
+      for( int i = 0; i < 10; ++i )
+      {
+         transfer( account_id_type(), i % 2 ? alice_id : bob_id, asset( 1000 + i ) );
+         generate_block();
+      }
+      create_sell_order( alice_id, asset( 100, usd_id ), asset( 200 ) );
+      create_sell_order( bob_id, asset( 200 ), asset( 100, usd_id ) );
+      generate_block();
+      const vector<operation_history_object> before = hist_api.get_account_history( "alice",
+            operation_history_id_type(), 100, operation_history_id_type() );
+      const uint64_t total_ops = alice_id(db).statistics(db).total_ops;
+      BOOST_REQUIRE_GE( before.size(), 6u );
+
+      auto hsplugin = app.get_plugin<graphene::history_store::history_store_plugin>( "history_store" );
+      hsplugin->rebuild_plugin( "account_history" );
+
+      BOOST_CHECK_EQUAL( alice_id(db).statistics(db).total_ops, total_ops );
+      vector<operation_history_object> after = hist_api.get_account_history( "alice",
+            operation_history_id_type(), 100, operation_history_id_type() );
+      BOOST_REQUIRE_EQUAL( after.size(), before.size() );
+      for( size_t i = 0; i < after.size(); ++i )
+      {
+         BOOST_CHECK_EQUAL( after[i].op.which(), before[i].op.which() );
+         BOOST_CHECK_EQUAL( after[i].block_num, before[i].block_num );
+         BOOST_CHECK_EQUAL( after[i].trx_in_block, before[i].trx_in_block );
+         BOOST_CHECK_EQUAL( after[i].op_in_trx, before[i].op_in_trx );
+      }
+
+      // the market history
+      auto market_history = [&hist_api,this]() {
+         return hist_api.get_market_history( "1.3.0", "USDREBUILD", 15, fc::time_point_sec(), db.head_block_time() );
+      };
+      const auto buckets = market_history();
+      BOOST_REQUIRE_EQUAL( buckets.size(), 1u );
+      hsplugin->rebuild_plugin( "market_history" );
+      const auto rebuilt_buckets = market_history();
+      BOOST_REQUIRE_EQUAL( rebuilt_buckets.size(), 1u );
+      BOOST_CHECK( rebuilt_buckets.front().key.open == buckets.front().key.open );
+      BOOST_CHECK_EQUAL( rebuilt_buckets.front().base_volume.value, buckets.front().base_volume.value );
+      BOOST_CHECK_EQUAL( rebuilt_buckets.front().quote_volume.value, buckets.front().quote_volume.value );
+
+      GRAPHENE_REQUIRE_THROW( hsplugin->rebuild_plugin( "grouped_orders" ), fc::exception );
+      GRAPHENE_REQUIRE_THROW( hsplugin->rebuild_plugin( "no_such_plugin" ), fc::exception );
+
+      // the history goes on from the rebuilt state
+      transfer( account_id_type(), alice_id, asset( 2000 ) );
+      generate_block();
+      after = hist_api.get_account_history( "alice", operation_history_id_type(), 100, operation_history_id_type() );
+      BOOST_REQUIRE_EQUAL( after.size(), before.size() + 1 );
+      BOOST_CHECK_EQUAL( after.front().op.get<transfer_operation>().amount.amount.value, 2000 );
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(history_store_reopen) {
+   try {
+      using graphene::history_store::history_query;
+      using graphene::history_store::history_store;
+      fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+      history_store::options_type options;
+      options.chunk_size = 5;
+      options.memtable_size = 20;
+      options.max_runs = 2;
+      auto make_transfer = []( uint64_t from, uint64_t to, int64_t amount ) {
+         transfer_operation t;
+         t.from = account_id_type( from );
+         t.to = account_id_type( to );
+         t.amount = asset( amount );
+         return operation_history_object( t );
+      };
+      const fc::time_point_sec start( 1500000000 );
+      {
+         history_store store( dir.path(), options );
+         for( uint32_t block = 1; block <= 30; ++block )
+            store.append_block( block, start + block * 3,
+                                { make_transfer( 10, 11, block ), make_transfer( 12, 10, block ) } );
+         BOOST_CHECK_EQUAL( store.size(), 60u );
+      }
+
+      // what was not written to a run is indexed again from the log
+      history_store store( dir.path(), options );
+      BOOST_CHECK_EQUAL( store.size(), 60u );
+      BOOST_CHECK_EQUAL( store.last_block(), 30u );
+      store.append_block( 30, start + 90, { make_transfer( 10, 11, 1 ) } );
+      BOOST_CHECK_EQUAL( store.size(), 60u );
+
+      history_query q;
+      q.account = account_id_type( 10 );
+      auto ops = store.query( q );
+      BOOST_REQUIRE_EQUAL( ops.size(), 60u );
+      for( size_t i = 0; i < ops.size(); ++i )
+         BOOST_CHECK_EQUAL( ops[i].sequence, 59u - i );
+
+      q.account = account_id_type( 11 );
+      q.start_block = 11;
+      q.end_block = 20;
+      ops = store.query( q );
+      BOOST_REQUIRE_EQUAL( ops.size(), 10u );
+      BOOST_CHECK_EQUAL( ops.front().operation.op.get<transfer_operation>().amount.amount.value, 20 );
+      BOOST_CHECK_EQUAL( ops.back().operation.op.get<transfer_operation>().amount.amount.value, 11 );
+
+      q.start_block = 0;
+      q.end_block = std::numeric_limits<uint32_t>::max();
+      q.start_time = start + 15;
+      q.end_time = start + 21;
+      ops = store.query( q );
+      BOOST_REQUIRE_EQUAL( ops.size(), 3u );
+      BOOST_CHECK( ops.front().block_time == start + 21 );
+
+      history_query by_block;
+      by_block.start_block = 7;
+      by_block.end_block = 7;
+      ops = store.query( by_block );
+      BOOST_REQUIRE_EQUAL( ops.size(), 2u );
+      BOOST_CHECK_EQUAL( ops[0].operation.op.get<transfer_operation>().from.instance.value, 12u );
+      BOOST_CHECK_EQUAL( ops[1].operation.op.get<transfer_operation>().from.instance.value, 10u );
+
+      // the blocks in order, across chunks and the open chunk
+      vector<uint32_t> blocks;
+      store.for_each_block( 12, 30, [&blocks]( uint32_t block_num, fc::time_point_sec,
+                                               const std::vector<operation_history_object>& block_ops ) {
+         BOOST_CHECK_EQUAL( block_ops.size(), 2u );
+         blocks.push_back( block_num );
+      } );
+      BOOST_REQUIRE_EQUAL( blocks.size(), 19u );
+      for( size_t i = 0; i < blocks.size(); ++i )
+         BOOST_CHECK_EQUAL( blocks[i], 12u + i );
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -355,6 +355,93 @@ BOOST_AUTO_TEST_CASE(asset_rewards_test)
    FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE(batched_market_fees_test)
+{
+   try
+   {
+      ACTORS((registrar)(alicereferrer)(bobreferrer)(izzy));
+
+      auto register_account = [&](const string& name, const account_object& referrer) -> const account_object&
+      {
+         uint16_t referrer_percent = GRAPHENE_1_PERCENT;
+         fc::ecc::private_key _private_key = generate_private_key(name);
+         public_key_type _public_key = _private_key.get_public_key();
+         return create_account(name, registrar, referrer, referrer_percent, _public_key);
+      };
+
+      upgrade_to_lifetime_member(registrar);
+      upgrade_to_lifetime_member(alicereferrer);
+      upgrade_to_lifetime_member(bobreferrer);
+
+      auto alice = register_account("alice", alicereferrer);
+      auto bob = register_account("bob", bobreferrer);
+
+      transfer( committee_account, alice.id, core_asset(1000000) );
+      transfer( committee_account, bob.id, core_asset(1000000) );
+      transfer( committee_account, izzy_id, core_asset(1000000) );
+
+      constexpr auto izzycoin_reward_percent = 10*GRAPHENE_1_PERCENT;
+      constexpr auto izzycoin_market_percent = 10*GRAPHENE_1_PERCENT;
+
+      asset_id_type izzycoin_id = create_bitasset( "IZZYCOIN", izzy_id, izzycoin_market_percent ).id;
+
+      generate_blocks_past_hf1268();
+
+      update_asset(izzy_id, izzy_private_key, izzycoin_id, izzycoin_reward_percent);
+
+      const share_type izzy_prec = asset::scaled_precision( asset_id_type(izzycoin_id)(db).precision );
+      auto _izzy = [&]( int64_t x ) -> asset
+      {   return asset( x*izzy_prec, izzycoin_id );   };
+
+      update_feed_producers( izzycoin_id(db), { izzy_id } );
+
+      price_feed feed;
+      feed.settlement_price = price( _izzy(1), core_asset(100) );
+      feed.maintenance_collateral_ratio = 175 * GRAPHENE_COLLATERAL_RATIO_DENOM / 100;
+      feed.maximum_short_squeeze_ratio = 150 * GRAPHENE_COLLATERAL_RATIO_DENOM / 100;
+      publish_feed( izzycoin_id(db), izzy, feed );
+
+      enable_fees();
+
+      borrow( alice.id, _izzy(1500), core_asset(600000) );
+
+      // Bob's order crosses both of Alice's, so his fees of both fills are paid within one market fee batch
+      create_sell_order( alice.id, _izzy(100), core_asset(10000) );
+      create_sell_order( alice.id, _izzy(200), core_asset(20000) );
+      const share_type fees_before = izzycoin_id(db).dynamic_asset_data_id(db).accumulated_fees;
+      BOOST_CHECK( create_sell_order( bob.id, core_asset(30000), _izzy(300) ) == nullptr );
+
+      auto calculate_percent = [](const share_type& value, uint16_t percent)
+      {
+         auto a(value.value);
+         a *= percent;
+         a /= GRAPHENE_100_PERCENT;
+         return a;
+      };
+
+      // Rounding is still done fill by fill
+      share_type market_fees = 0;
+      share_type rewards = 0;
+      share_type referrer_rewards = 0;
+      for( const auto& fill : { _izzy(100), _izzy(200) } )
+      {
+         const auto fee = calculate_percent( fill.amount, izzycoin_market_percent );
+         const auto reward = calculate_percent( fee, izzycoin_reward_percent );
+         market_fees += fee;
+         rewards += reward;
+         referrer_rewards += calculate_percent( reward, bob.referrer_rewards_percentage );
+      }
+
+      const share_type bob_referrer_reward = get_market_fee_reward( bob.referrer, izzycoin_id );
+      const share_type bob_registrar_reward = get_market_fee_reward( bob.registrar, izzycoin_id );
+      BOOST_CHECK_EQUAL( referrer_rewards.value, bob_referrer_reward.value );
+      BOOST_CHECK_EQUAL( rewards.value, ( bob_referrer_reward + bob_registrar_reward ).value );
+      BOOST_CHECK_EQUAL( ( market_fees - rewards ).value,
+                         ( izzycoin_id(db).dynamic_asset_data_id(db).accumulated_fees - fees_before ).value );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE(asset_claim_reward_test)
 {
    try
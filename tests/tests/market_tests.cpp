@@ -1890,4 +1890,111 @@ BOOST_AUTO_TEST_CASE(target_cr_test_call_limit_after_hf1270)
 } FC_LOG_AND_RETHROW() }
 
 
+BOOST_AUTO_TEST_CASE( limit_order_book_index_test )
+{ try {
+   ACTORS((alice)(bob));
+   const auto& test = create_user_issued_asset( "TEST" );
+   const asset_id_type test_id = test.id;
+   const asset_id_type core_id;
+   issue_uia( bob, test.amount( 1000 ) );
+   transfer( committee_account, alice_id, asset( 10000 ) );
+
+   const limit_order_id_type o1 = create_sell_order( alice_id, asset( 100 ), asset( 10, test_id ) )->id;
+   const limit_order_id_type o2 = create_sell_order( alice_id, asset( 100 ), asset( 20, test_id ) )->id;
+   const limit_order_id_type o3 = create_sell_order( alice_id, asset( 100 ), asset( 10, test_id ) )->id;
+   generate_block();
+
+   auto book_ids = [this]( asset_id_type sell, asset_id_type receive ) {
+      vector< object_id_type > result;
+      for( const auto& e : db.get_limit_order_books().get_book( sell, receive ) )
+      {
+         BOOST_CHECK( e.order->id == e.id );
+         result.push_back( e.id );
+      }
+      return result;
+   };
+   // best price first, then the older order
+   BOOST_CHECK( book_ids( core_id, test_id ) == vector< object_id_type >( { o1, o3, o2 } ) );
+   BOOST_CHECK( book_ids( test_id, core_id ).empty() );
+
+   // fills o1
+   BOOST_CHECK( create_sell_order( bob_id, asset( 10, test_id ), asset( 100 ) ) == nullptr );
+   BOOST_CHECK( book_ids( core_id, test_id ) == vector< object_id_type >( { o3, o2 } ) );
+   // partially fills o3, which stays in place
+   BOOST_CHECK( create_sell_order( bob_id, asset( 5, test_id ), asset( 50 ) ) == nullptr );
+   BOOST_CHECK_EQUAL( 50, o3(db).for_sale.value );
+   BOOST_CHECK( book_ids( core_id, test_id ) == vector< object_id_type >( { o3, o2 } ) );
+   // does not match
+   const limit_order_id_type o4 = create_sell_order( bob_id, asset( 5, test_id ), asset( 100 ) )->id;
+   BOOST_CHECK( book_ids( test_id, core_id ) == vector< object_id_type >( { o4 } ) );
+   generate_block();
+
+   db.pop_block();
+   BOOST_CHECK( book_ids( core_id, test_id ) == vector< object_id_type >( { o1, o3, o2 } ) );
+   BOOST_CHECK( book_ids( test_id, core_id ).empty() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( price_sort_key_test )
+{ try {
+   const asset_id_type a;
+   const asset_id_type b( 1 );
+   auto make = [a,b]( int64_t base, int64_t quote ) { return price( asset( base, a ), asset( quote, b ) ); };
+   const int64_t max = GRAPHENE_MAX_SHARE_SUPPLY;
+   const vector< price > prices = { make( 1, max ), make( 1, max - 1 ), make( 1, 3 ), make( 1, 2 ),
+                                    make( max - 1, max ), make( 1, 1 ), make( max, max - 1 ), make( 3, 2 ),
+                                    make( max - 1, 1 ), make( max, 1 ) };
+   for( size_t i = 0; i < prices.size(); ++i )
+      for( size_t j = 0; j < prices.size(); ++j )
+      {
+         BOOST_CHECK_EQUAL( prices[i] < prices[j], price_sort_key( prices[i] ) < price_sort_key( prices[j] ) );
+         BOOST_CHECK_EQUAL( prices[i] == prices[j], price_sort_key( prices[i] ) == price_sort_key( prices[j] ) );
+      }
+   BOOST_CHECK( price_sort_key( make( 2, 4 ) ) == price_sort_key( make( 1, 2 ) ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( call_order_book_index_test )
+{ try {
+   ACTORS((alice)(bob)(feeder));
+   const auto& bitusd = create_bitasset( "USDBIT", feeder_id );
+   const asset_id_type usd_id = bitusd.id;
+   const asset_id_type core_id;
+   transfer( committee_account, alice_id, asset( 100000 ) );
+   transfer( committee_account, bob_id, asset( 100000 ) );
+   update_feed_producers( bitusd, { feeder_id } );
+   price_feed feed;
+   feed.maintenance_collateral_ratio = 1750;
+   feed.maximum_short_squeeze_ratio = 1100;
+   feed.settlement_price = bitusd.amount( 1 ) / asset( 5 );
+   publish_feed( bitusd, feeder, feed );
+
+   const call_order_id_type alice_call = borrow( alice_id, asset( 100, usd_id ), asset( 1500 ) )->id;
+   const call_order_id_type bob_call = borrow( bob_id, asset( 100, usd_id ), asset( 1000 ) )->id;
+
+   auto book_ids = [this,usd_id,core_id]() {
+      vector< object_id_type > result;
+      for( const auto& e : db.get_call_order_books().get_book( usd_id, core_id ) )
+      {
+         BOOST_CHECK( e.order->id == e.id );
+         result.push_back( e.id );
+      }
+      // same order as the by_collateral index
+      vector< object_id_type > expected;
+      for( const auto& o : db.get_index_type<call_order_index>().indices().get<by_collateral>() )
+         if( o.debt_type() == usd_id )
+            expected.push_back( o.id );
+      BOOST_CHECK( result == expected );
+      return result;
+   };
+   BOOST_CHECK( book_ids() == vector< object_id_type >( { bob_call, alice_call } ) );
+   BOOST_CHECK( db.get_call_order_books().get_book( core_id, usd_id ).empty() );
+
+   // bob adds collateral and is no longer the least collateralized
+   borrow( bob_id, asset( 0, usd_id ), asset( 1000 ) );
+   BOOST_CHECK( book_ids() == vector< object_id_type >( { alice_call, bob_call } ) );
+
+   // closing a position removes it
+   cover( alice_id, asset( 100, usd_id ), asset( 1500 ) );
+   BOOST_CHECK( book_ids() == vector< object_id_type >( { bob_call } ) );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
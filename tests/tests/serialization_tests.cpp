@@ -24,6 +24,7 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <graphene/app/rpc_connection.hpp>
 #include <graphene/chain/database.hpp>
 
 
@@ -33,6 +34,8 @@
 
 #include "../common/database_fixture.hpp"
 
+#include <algorithm>
+
 using namespace graphene::chain;
 
 BOOST_FIXTURE_TEST_SUITE( operation_unit_tests, database_fixture )
@@ -74,6 +77,43 @@ BOOST_AUTO_TEST_CASE( serialization_json_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( binary_rpc_encoding_test )
+{
+   try {
+      transfer_operation op;
+      op.from = account_id_type(1);
+      op.to = account_id_type(2);
+      op.amount = asset(100);
+      trx.operations.push_back( op );
+      fc::rpc::request request{ fc::optional<uint64_t>( 7 ), "call",
+                                { 2, "broadcast_transaction",
+                                  fc::variants{ fc::variant( trx, GRAPHENE_MAX_NESTED_OBJECTS ) } } };
+      const std::string encoded = graphene::app::rpc_connection::encode_binary(
+                                        fc::variant( request, GRAPHENE_MAX_NESTED_OBJECTS ), GRAPHENE_MAX_NESTED_OBJECTS );
+      // sent in websocket text frames, which have to be valid UTF-8
+      BOOST_CHECK( std::all_of( encoded.begin(), encoded.end(), []( char c ) { return c > ' ' && c <= '~'; } ) );
+      const fc::variant decoded = graphene::app::rpc_connection::decode_binary( encoded, GRAPHENE_MAX_NESTED_OBJECTS );
+      const auto unpacked = decoded.as<fc::rpc::request>( GRAPHENE_MAX_NESTED_OBJECTS );
+      BOOST_REQUIRE( unpacked.id.valid() );
+      BOOST_CHECK_EQUAL( 7u, *unpacked.id );
+      BOOST_CHECK_EQUAL( "call", unpacked.method );
+      BOOST_REQUIRE_EQUAL( 3u, unpacked.params.size() );
+      signed_transaction unpacked_trx = unpacked.params[2].get_array()[0].as<signed_transaction>(
+                                                                                    GRAPHENE_MAX_NESTED_OBJECTS );
+      BOOST_CHECK( digest(trx) == digest(unpacked_trx) );
+
+      // trailing garbage and truncated messages are rejected
+      GRAPHENE_CHECK_THROW( graphene::app::rpc_connection::decode_binary( encoded + "x", GRAPHENE_MAX_NESTED_OBJECTS ),
+                            fc::exception );
+      GRAPHENE_CHECK_THROW( graphene::app::rpc_connection::decode_binary( encoded.substr( 0, encoded.size() / 2 ),
+                                                                          GRAPHENE_MAX_NESTED_OBJECTS ),
+                            fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( json_tests )
 {
    try {
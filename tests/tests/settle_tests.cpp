@@ -1510,11 +1510,11 @@ BOOST_AUTO_TEST_CASE( global_settle_ticker_test )
    try {
       generate_block();
 
-      const auto& meta_idx = db.get_index_type<simple_index<graphene::market_history::market_ticker_meta_object>>();
+      const auto& window_idx = db.get_index_type<graphene::market_history::market_ticker_window_index>().indices();
       const auto& ticker_idx = db.get_index_type<graphene::market_history::market_ticker_index>().indices();
       const auto& history_idx = db.get_index_type<graphene::market_history::history_index>().indices();
 
-      BOOST_CHECK_EQUAL( meta_idx.size(), 0 );
+      BOOST_CHECK_EQUAL( window_idx.size(), 0 );
       BOOST_CHECK_EQUAL( ticker_idx.size(), 0 );
       BOOST_CHECK_EQUAL( history_idx.size(), 0 );
 
@@ -1537,16 +1537,16 @@ BOOST_AUTO_TEST_CASE( global_settle_ticker_test )
       fc::usleep(fc::milliseconds(200)); // sleep a while to execute callback in another thread
 
       {
-         BOOST_CHECK_EQUAL( meta_idx.size(), 1 );
+         BOOST_CHECK_EQUAL( window_idx.size(), 1 );
          BOOST_CHECK_EQUAL( ticker_idx.size(), 1 );
          BOOST_CHECK_EQUAL( history_idx.size(), 1 );
 
-         const auto& meta = *meta_idx.begin();
+         const auto& window = *window_idx.begin();
          const auto& tick = *ticker_idx.begin();
          const auto& hist = *history_idx.begin();
 
-         BOOST_CHECK( meta.rolling_min_order_his_id == hist.id );
-         BOOST_CHECK( meta.skip_min_order_his_id == false );
+         BOOST_CHECK( window.minute <= hist.time );
+         BOOST_CHECK( window.base_volume == 1000 );
 
          BOOST_CHECK( tick.base_volume == 1000 );
          BOOST_CHECK( tick.quote_volume == 1000 );
@@ -1557,16 +1557,16 @@ BOOST_AUTO_TEST_CASE( global_settle_ticker_test )
 
       // nothing changes
       {
-         BOOST_CHECK_EQUAL( meta_idx.size(), 1 );
+         BOOST_CHECK_EQUAL( window_idx.size(), 1 );
          BOOST_CHECK_EQUAL( ticker_idx.size(), 1 );
          BOOST_CHECK_EQUAL( history_idx.size(), 1 );
 
-         const auto& meta = *meta_idx.begin();
+         const auto& window = *window_idx.begin();
          const auto& tick = *ticker_idx.begin();
          const auto& hist = *history_idx.begin();
 
-         BOOST_CHECK( meta.rolling_min_order_his_id == hist.id );
-         BOOST_CHECK( meta.skip_min_order_his_id == false );
+         BOOST_CHECK( window.minute <= hist.time );
+         BOOST_CHECK( window.base_volume == 1000 );
 
          BOOST_CHECK( tick.base_volume == 1000 );
          BOOST_CHECK( tick.quote_volume == 1000 );
@@ -1577,16 +1577,11 @@ BOOST_AUTO_TEST_CASE( global_settle_ticker_test )
 
       // the history is rolled out, new 24h volume should be 0
       {
-         BOOST_CHECK_EQUAL( meta_idx.size(), 1 );
+         BOOST_CHECK_EQUAL( window_idx.size(), 0 );
          BOOST_CHECK_EQUAL( ticker_idx.size(), 1 );
          BOOST_CHECK_EQUAL( history_idx.size(), 1 );
 
-         const auto& meta = *meta_idx.begin();
          const auto& tick = *ticker_idx.begin();
-         const auto& hist = *history_idx.begin();
-
-         BOOST_CHECK( meta.rolling_min_order_his_id == hist.id );
-         BOOST_CHECK( meta.skip_min_order_his_id == true ); // the order should be skipped on next roll
 
          BOOST_CHECK( tick.base_volume == 0 );
          BOOST_CHECK( tick.quote_volume == 0 );
@@ -1597,16 +1592,11 @@ BOOST_AUTO_TEST_CASE( global_settle_ticker_test )
 
       // nothing changes
       {
-         BOOST_CHECK_EQUAL( meta_idx.size(), 1 );
+         BOOST_CHECK_EQUAL( window_idx.size(), 0 ); // the minute is rolled out only once
          BOOST_CHECK_EQUAL( ticker_idx.size(), 1 );
          BOOST_CHECK_EQUAL( history_idx.size(), 1 );
 
-         const auto& meta = *meta_idx.begin();
          const auto& tick = *ticker_idx.begin();
-         const auto& hist = *history_idx.begin();
-
-         BOOST_CHECK( meta.rolling_min_order_his_id == hist.id );
-         BOOST_CHECK( meta.skip_min_order_his_id == true );
 
          BOOST_CHECK( tick.base_volume == 0 );
          BOOST_CHECK( tick.quote_volume == 0 );
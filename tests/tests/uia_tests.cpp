@@ -210,6 +210,55 @@ BOOST_AUTO_TEST_CASE( issue_whitelist_uia )
    }
 }
 
+BOOST_AUTO_TEST_CASE( authorized_asset_cache_test )
+{
+   try {
+      ACTORS( (izzy)(nathan) );
+      upgrade_to_lifetime_member( izzy_id );
+      const asset_id_type uia_id = create_user_issued_asset( "ADVANCED", izzy_id(db), white_list ).id;
+
+      BOOST_CHECK( is_authorized_asset( db, nathan_id(db), uia_id(db) ) );
+
+      asset_update_operation uop;
+      uop.issuer = izzy_id;
+      uop.asset_to_update = uia_id;
+      uop.new_options = uia_id(db).options;
+      uop.new_options.whitelist_authorities.insert( izzy_id );
+      trx.operations.push_back( uop );
+      set_expiration( db, trx );
+      PUSH_TX( db, trx, ~0 );
+      trx.clear();
+
+      BOOST_CHECK( !is_authorized_asset( db, nathan_id(db), uia_id(db) ) );
+      BOOST_CHECK( db.get_authorized_asset_cache().find( nathan_id, uia_id ) != nullptr );
+
+      {
+         // the cached result follows the whitelist, also when the change is undone
+         auto session = db._undo_db.start_undo_session();
+         account_whitelist_operation wop;
+         wop.authorizing_account = izzy_id;
+         wop.account_to_list = nathan_id;
+         wop.new_listing = account_whitelist_operation::white_listed;
+         trx.operations.push_back( wop );
+         set_expiration( db, trx );
+         PUSH_TX( db, trx, ~0 );
+         trx.clear();
+         BOOST_CHECK( is_authorized_asset( db, nathan_id(db), uia_id(db) ) );
+      }
+      BOOST_CHECK( !is_authorized_asset( db, nathan_id(db), uia_id(db) ) );
+
+      // changes to other fields of the asset keep the cached results
+      uop.new_options = uia_id(db).options;
+      uop.new_options.description = "whitelisted";
+      trx.operations.push_back( uop );
+      set_expiration( db, trx );
+      PUSH_TX( db, trx, ~0 );
+      trx.clear();
+      BOOST_CHECK( db.get_authorized_asset_cache().find( nathan_id, uia_id ) != nullptr );
+      BOOST_CHECK( !is_authorized_asset( db, nathan_id(db), uia_id(db) ) );
+   } FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( transfer_whitelist_uia )
 {
    try {